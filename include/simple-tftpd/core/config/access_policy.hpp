@@ -0,0 +1,223 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Lock-free readable holder of an immutable value
+ *
+ * Readers pin one of two slots with a counter and copy its pointer; the
+ * writer fills the idle slot once its readers have drained, then flips.
+ * Readers never block; a reader racing a flip simply retries. Writers are
+ * serialized and wait only for readers of the slot they overwrite.
+ *
+ * @tparam T Value type, shared as const once published
+ */
+template <typename T>
+class TftpAtomicSnapshot {
+public:
+    /**
+     * @brief Constructor
+     * @param initial Initially published value, may be null
+     */
+    explicit TftpAtomicSnapshot(std::shared_ptr<const T> initial = nullptr) : current_(0) {
+        slots_[0] = std::move(initial);
+        readers_[0].store(0);
+        readers_[1].store(0);
+    }
+
+    TftpAtomicSnapshot(const TftpAtomicSnapshot&) = delete;
+    TftpAtomicSnapshot& operator=(const TftpAtomicSnapshot&) = delete;
+
+    /**
+     * @brief Get the published value
+     * @return Value, kept alive by the caller's reference
+     */
+    std::shared_ptr<const T> load() const {
+        for (;;) {
+            unsigned index = current_.load();
+            readers_[index].fetch_add(1);
+            if (current_.load() == index) {
+                std::shared_ptr<const T> value = slots_[index];
+                readers_[index].fetch_sub(1);
+                return value;
+            }
+            readers_[index].fetch_sub(1);
+        }
+    }
+
+    /**
+     * @brief Publish a new value; later loads see it
+     * @param value Value to publish
+     */
+    void store(std::shared_ptr<const T> value) {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        unsigned next = current_.load() ^ 1u;
+        while (readers_[next].load() != 0) {
+            std::this_thread::yield();
+        }
+        slots_[next] = std::move(value);
+        current_.store(next);
+    }
+
+private:
+    std::array<std::shared_ptr<const T>, 2> slots_;
+    mutable std::array<std::atomic<uint32_t>, 2> readers_;
+    std::atomic<unsigned> current_;
+    std::mutex writer_mutex_;
+};
+
+/**
+ * @brief Binary radix trie of IPv6 prefixes
+ *
+ * IPv4 prefixes are stored in the IPv4-mapped range (::ffff:0:0/96), so one
+ * walk of at most 128 bits answers a lookup for either family.
+ */
+class TftpAddressTrie {
+public:
+    using Address = std::array<uint8_t, 16>;
+
+    TftpAddressTrie();
+
+    /**
+     * @brief Add a prefix
+     * @param address Network address (bits past the prefix are ignored)
+     * @param prefix_length Prefix length in bits, 0-128
+     */
+    void insert(const Address& address, unsigned prefix_length);
+
+    /**
+     * @brief Check if any stored prefix covers an address
+     * @param address Address to test
+     * @return true on a match; costs at most one step per prefix bit
+     */
+    bool contains(const Address& address) const;
+
+    /**
+     * @brief Number of distinct prefixes stored
+     */
+    size_t size() const { return prefixes_; }
+
+    /**
+     * @brief Bytes held by the trie nodes
+     */
+    size_t memoryUsage() const { return nodes_.capacity() * sizeof(Node); }
+
+private:
+    struct Node {
+        uint32_t child[2] = {0, 0};  // 0 means absent (the root is never a child)
+        bool terminal = false;
+    };
+
+    std::vector<Node> nodes_;
+    size_t prefixes_;
+};
+
+/**
+ * @brief Access rules compiled from the configuration
+ *
+ * Immutable once built: client rules ("*", "addr" or "addr/len", IPv4 or
+ * IPv6) live in a radix trie, allowed directories and extensions in hash
+ * sets. Empty lists allow everything, as in the configuration.
+ */
+class TftpAccessPolicy {
+public:
+    /**
+     * @brief Compile the rules
+     * @param clients Allowed client rules
+     * @param directories Allowed directories (a directory also allows its subdirectories)
+     * @param extensions Allowed extensions, with or without the leading dot
+     */
+    TftpAccessPolicy(const std::vector<std::string>& clients,
+                     const std::vector<std::string>& directories,
+                     const std::vector<std::string>& extensions);
+
+    TftpAccessPolicy(const TftpAccessPolicy&) = delete;
+    TftpAccessPolicy& operator=(const TftpAccessPolicy&) = delete;
+
+    /**
+     * @brief Check a client given as text
+     * @param address IPv4 or IPv6 address (IPv4-mapped and scoped forms accepted)
+     * @return true if allowed; unparsable addresses are only allowed without rules
+     */
+    bool isClientAllowed(const std::string& address) const;
+
+    /**
+     * @brief Check a client given as a socket address
+     * @param address Peer address from recvfrom
+     * @return true if allowed
+     */
+    bool isClientAllowed(const struct sockaddr_storage& address) const;
+
+    /**
+     * @brief Check a directory
+     * @param dir Directory path
+     * @return true if it or one of its parents is allowed
+     */
+    bool isDirectoryAllowed(const std::string& dir) const;
+
+    /**
+     * @brief Check a file extension (case-insensitive, leading dot optional)
+     * @param extension File extension
+     * @return true if allowed
+     */
+    bool isExtensionAllowed(const std::string& extension) const;
+
+    /**
+     * @brief Client rules that could not be parsed (and match nothing)
+     */
+    const std::vector<std::string>& getRejectedClients() const { return rejected_clients_; }
+
+    /**
+     * @brief Number of distinct client prefixes compiled
+     */
+    size_t clientRuleCount() const { return clients_.size(); }
+
+    /**
+     * @brief Parse a client rule
+     * @param rule "addr" or "addr/len"
+     * @param address Receives the address, IPv4 mapped into IPv6
+     * @param prefix_length Receives the prefix length over 128 bits
+     * @return false if the rule is malformed
+     */
+    static bool parseClientRule(const std::string& rule, TftpAddressTrie::Address& address,
+                                unsigned& prefix_length);
+
+private:
+    bool restrict_clients_;
+    bool allow_all_clients_;
+    TftpAddressTrie clients_;
+    std::vector<std::string> rejected_clients_;
+
+    std::vector<std::string> directory_storage_;
+    std::unordered_set<std::string_view> directories_;  // Views into directory_storage_
+    std::unordered_set<std::string> extensions_;
+};
+
+} // namespace simple_tftpd
@@ -18,6 +18,8 @@
 
 #include "simple-tftpd/core/utils/platform.hpp"
 #include "simple-tftpd/core/utils/logger.hpp"
+#include "simple-tftpd/core/config/access_policy.hpp"
+#include "simple-tftpd/core/config/remap_rules.hpp"
 #include <string>
 #include <vector>
 #include <memory>
@@ -145,10 +147,112 @@ public:
     /**
      * @brief Check if directory is allowed
      * @param dir Directory path to check
-     * @return true if directory is allowed
+     * @return true if the directory or one of its parents is allowed
      */
     bool isDirectoryAllowed(const std::string& dir) const;
     
+    /**
+     * @brief Enable/disable serving compressed copies of missing files
+     * @param enable Whether to look for .zst/.gz copies of requested files
+     */
+    void setCompressedFilesEnabled(bool enable);
+    
+    /**
+     * @brief Check if compressed copies of missing files are served
+     * @return true if the compressed store is enabled
+     */
+    bool isCompressedFilesEnabled() const;
+    
+    /**
+     * @brief Set directory holding the compressed copies
+     * @param directory Tree mirroring the root directory, empty for siblings
+     */
+    void setCompressedDirectory(const std::string& directory);
+    
+    /**
+     * @brief Get directory holding the compressed copies
+     * @return Compressed store directory, empty when copies sit next to the originals
+     */
+    std::string getCompressedDirectory() const;
+    
+    /**
+     * @brief Enable/disable case-insensitive, backslash-tolerant filename lookup
+     * @param enable Whether read requests are resolved through the filename index
+     */
+    void setCaseInsensitive(bool enable);
+    
+    /**
+     * @brief Check if read requests are resolved through the filename index
+     * @return true if filenames are matched ignoring case and separator style
+     */
+    bool isCaseInsensitive() const;
+    
+    /**
+     * @brief Set filename remap rules in tftpd-hpa map file syntax
+     * @param rules Rule lines, applied in order after those of the remap file
+     */
+    void setRemapRules(const std::vector<std::string>& rules);
+    
+    /**
+     * @brief Get filename remap rules as configured
+     * @return Rule lines
+     */
+    std::vector<std::string> getRemapRules() const;
+    
+    /**
+     * @brief Set a tftpd-hpa remap file to load rules from
+     * @param path Map file path, empty for none
+     */
+    void setRemapFile(const std::string& path);
+    
+    /**
+     * @brief Get the tftpd-hpa remap file
+     * @return Map file path, empty for none
+     */
+    std::string getRemapFile() const;
+    
+    /**
+     * @brief Get the compiled remap rules
+     * @return Immutable rule set, rebuilt whenever the rules or remap file change
+     */
+    std::shared_ptr<const TftpRemapRules> getFilenameRemap() const;
+    
+    /**
+     * @brief Set the HTTP origin that files missing from the root are fetched from
+     * @param url Base URL (http://host[:port][/path]), empty to serve the root alone
+     */
+    void setOriginUrl(const std::string& url);
+    
+    /**
+     * @brief Get the HTTP origin
+     * @return Base URL, empty when origin pull is disabled
+     */
+    std::string getOriginUrl() const;
+    
+    /**
+     * @brief Set how long a fetched or revalidated file is served before asking the origin again
+     * @param seconds Revalidation interval, 0 to revalidate on every request
+     */
+    void setOriginRevalidateInterval(uint32_t seconds);
+    
+    /**
+     * @brief Get the origin revalidation interval
+     * @return Interval in seconds
+     */
+    uint32_t getOriginRevalidateInterval() const;
+    
+    /**
+     * @brief Set the origin connect and stall timeout
+     * @param seconds Timeout in seconds
+     */
+    void setOriginTimeout(uint32_t seconds);
+    
+    /**
+     * @brief Get the origin connect and stall timeout
+     * @return Timeout in seconds
+     */
+    uint32_t getOriginTimeout() const;
+    
     /**
      * @brief Set allowed file extensions
      * @param extensions List of extensions (without dot)
@@ -219,7 +323,7 @@ public:
     
     /**
      * @brief Set allowed client addresses
-     * @param clients List of IPv4/IPv6 addresses
+     * @param clients List of IPv4/IPv6 addresses or CIDR prefixes ("*" allows all)
      */
     void setAllowedClients(const std::vector<std::string>& clients);
     
@@ -236,6 +340,12 @@ public:
      */
     bool isClientAllowed(const std::string& address) const;
     
+    /**
+     * @brief Get the compiled client, directory and extension rules
+     * @return Immutable policy, rebuilt whenever those lists change
+     */
+    std::shared_ptr<const TftpAccessPolicy> getAccessPolicy() const;
+    
     // Performance configuration
     /**
      * @brief Set block size
@@ -285,6 +395,138 @@ public:
      */
     uint16_t getMaxRetries() const;
     
+    /**
+     * @brief Set byte budget of the shared DATA block cache
+     * @param bytes Cache size in bytes (0 disables the cache)
+     */
+    void setBlockCacheSize(size_t bytes);
+    
+    /**
+     * @brief Get byte budget of the shared DATA block cache
+     * @return Cache size in bytes
+     */
+    size_t getBlockCacheSize() const;
+    
+    /**
+     * @brief Set byte budget of the shared netascii conversion cache
+     * @param bytes Cache size in bytes (0 disables the cache)
+     */
+    void setNetasciiCacheSize(size_t bytes);
+    
+    /**
+     * @brief Get byte budget of the shared netascii conversion cache
+     * @return Cache size in bytes
+     */
+    size_t getNetasciiCacheSize() const;
+    
+    /**
+     * @brief Set how many missing paths are remembered
+     * @param entries Entry bound (0 disables the negative cache)
+     */
+    void setNegativeCacheEntries(size_t entries);
+    
+    /**
+     * @brief Get how many missing paths are remembered
+     * @return Entry bound
+     */
+    size_t getNegativeCacheEntries() const;
+    
+    /**
+     * @brief Set how long a missing path is remembered
+     * @param seconds Entry lifetime
+     */
+    void setNegativeCacheTtl(uint32_t seconds);
+    
+    /**
+     * @brief Get how long a missing path is remembered
+     * @return Entry lifetime in seconds
+     */
+    uint32_t getNegativeCacheTtl() const;
+    
+    /**
+     * @brief Set how many files have their metadata cached
+     * @param entries Entry bound (0 disables the metadata cache)
+     */
+    void setMetadataCacheEntries(size_t entries);
+    
+    /**
+     * @brief Get how many files have their metadata cached
+     * @return Entry bound
+     */
+    size_t getMetadataCacheEntries() const;
+    
+    /**
+     * @brief Set how many worker processes the datacenter build forks
+     * @param workers Worker count (1 runs the server in the supervisor's place)
+     */
+    void setWorkers(uint32_t workers);
+    
+    /**
+     * @brief Get how many worker processes the datacenter build forks
+     * @return Worker count
+     */
+    uint32_t getWorkers() const;
+    
+    /**
+     * @brief Set byte budget of the content cache shared by worker processes
+     * @param bytes Cache size in bytes (0 disables the cache)
+     */
+    void setSharedCacheSize(size_t bytes);
+    
+    /**
+     * @brief Get byte budget of the content cache shared by worker processes
+     * @return Cache size in bytes
+     */
+    size_t getSharedCacheSize() const;
+    
+    /**
+     * @brief Set how many threads set up new transfers off the listener thread
+     * @param threads Thread count (0 sets transfers up on the listener thread)
+     */
+    void setSetupThreads(uint32_t threads);
+    
+    /**
+     * @brief Get how many threads set up new transfers off the listener thread
+     * @return Thread count
+     */
+    uint32_t getSetupThreads() const;
+    
+    /**
+     * @brief Set how many requests may wait for a setup thread
+     * @param limit Queue bound; further requests are refused as busy
+     */
+    void setSetupQueueLimit(size_t limit);
+    
+    /**
+     * @brief Get how many requests may wait for a setup thread
+     * @return Queue bound
+     */
+    size_t getSetupQueueLimit() const;
+    
+    /**
+     * @brief Set whether octet reads of plain files retransmit by re-reading the file
+     * @param enable true to keep only the offset of each block in flight instead of a copy
+     */
+    void setRetransmitFromFile(bool enable);
+    
+    /**
+     * @brief Check whether octet reads of plain files retransmit by re-reading the file
+     * @return true if enabled
+     */
+    bool isRetransmitFromFileEnabled() const;
+    
+    /**
+     * @brief Set whether windowed reads send their DATA packets with UDP GSO
+     * @param enable true to hand each window to the kernel in one send where supported
+     */
+    void setUdpGso(bool enable);
+    
+    /**
+     * @brief Check whether windowed reads send their DATA packets with UDP GSO
+     * @return true if enabled
+     */
+    bool isUdpGsoEnabled() const;
+    
     // Logging configuration
     /**
      * @brief Set log level
@@ -321,6 +563,132 @@ public:
      * @return true if console logging is enabled
      */
     bool isConsoleLoggingEnabled() const;
+    
+    // Monitoring configuration
+    
+    /**
+     * @brief Set path of the live connections status file
+     * @param path Status file path (empty disables the snapshot)
+     */
+    void setConnectionsFile(const std::string& path);
+    
+    /**
+     * @brief Get path of the live connections status file
+     * @return Status file path, empty if disabled
+     */
+    std::string getConnectionsFile() const;
+    
+    // Multicast configuration (RFC 2090)
+    
+    /**
+     * @brief Enable/disable multicast transfers
+     * @param enable Whether RRQs with the multicast option may join a group
+     */
+    void setMulticastEnabled(bool enable);
+    
+    /**
+     * @brief Check if multicast transfers are enabled
+     * @return true if multicast transfers are enabled
+     */
+    bool isMulticastEnabled() const;
+    
+    /**
+     * @brief Set multicast group address
+     * @param address IPv4 group address shared by all multicast sessions
+     */
+    void setMulticastGroupAddress(const std::string& address);
+    
+    /**
+     * @brief Get multicast group address
+     * @return IPv4 group address
+     */
+    std::string getMulticastGroupAddress() const;
+    
+    /**
+     * @brief Set first group port; each concurrent file uses the next free port
+     * @param port First group port
+     */
+    void setMulticastBasePort(port_t port);
+    
+    /**
+     * @brief Get first group port
+     * @return First group port
+     */
+    port_t getMulticastBasePort() const;
+    
+    /**
+     * @brief Set maximum number of concurrent multicast sessions
+     * @param count Number of group ports starting at the base port
+     */
+    void setMulticastMaxSessions(uint16_t count);
+    
+    /**
+     * @brief Get maximum number of concurrent multicast sessions
+     * @return Maximum session count
+     */
+    uint16_t getMulticastMaxSessions() const;
+    
+    /**
+     * @brief Set multicast TTL
+     * @param ttl Hop limit for group traffic
+     */
+    void setMulticastTtl(uint8_t ttl);
+    
+    /**
+     * @brief Get multicast TTL
+     * @return Hop limit for group traffic
+     */
+    uint8_t getMulticastTtl() const;
+    
+    /**
+     * @brief Set outgoing multicast interface
+     * @param address IPv4 address of the interface (empty for the routing default)
+     */
+    void setMulticastInterface(const std::string& address);
+    
+    /**
+     * @brief Get outgoing multicast interface
+     * @return Interface address, empty for the routing default
+     */
+    std::string getMulticastInterface() const;
+    
+    // Cluster configuration
+    
+    /**
+     * @brief Set cluster membership
+     * @param nodes Peer endpoints ("host:port") of every node, this one included; empty disables cluster mode
+     */
+    void setClusterNodes(const std::vector<std::string>& nodes);
+    
+    /**
+     * @brief Get cluster membership
+     * @return Peer endpoints of every node
+     */
+    std::vector<std::string> getClusterNodes() const;
+    
+    /**
+     * @brief Set this node's entry in the membership list
+     * @param node Peer endpoint ("host:port") this node listens on for its peers
+     */
+    void setClusterNode(const std::string& node);
+    
+    /**
+     * @brief Get this node's entry in the membership list
+     * @return Peer endpoint
+     */
+    std::string getClusterNode() const;
+    
+    /**
+     * @brief Set the number of points each node has on the hash ring
+     * @param count Virtual nodes per node
+     */
+    void setClusterVirtualNodes(uint32_t count);
+    
+    /**
+     * @brief Get the number of points each node has on the hash ring
+     * @return Virtual nodes per node
+     */
+    uint32_t getClusterVirtualNodes() const;
 
 private:
     // Network settings
@@ -332,6 +700,14 @@ private:
     std::string root_directory_;
     std::vector<std::string> allowed_directories_;
     std::vector<std::string> allowed_extensions_;
+    bool compressed_files_enabled_;
+    std::string compressed_directory_;
+    bool case_insensitive_;
+    std::vector<std::string> remap_rules_;
+    std::string remap_file_;
+    std::string origin_url_;
+    uint32_t origin_revalidate_interval_;
+    uint32_t origin_timeout_;
     
     // Security settings
     bool read_enabled_;
@@ -345,12 +721,43 @@ private:
     uint16_t timeout_;
     uint16_t window_size_;
     uint16_t max_retries_;
+    size_t block_cache_size_;
+    size_t netascii_cache_size_;
+    size_t negative_cache_entries_;
+    uint32_t negative_cache_ttl_;
+    size_t metadata_cache_entries_;
+    uint32_t workers_;
+    size_t shared_cache_size_;
+    uint32_t setup_threads_;
+    size_t setup_queue_limit_;
+    bool retransmit_from_file_;
+    bool udp_gso_;
     
     // Logging settings
     LogLevel log_level_;
     std::string log_file_;
     bool console_logging_;
     
+    // Monitoring settings
+    std::string connections_file_;
+    
+    // Multicast settings
+    bool multicast_enabled_;
+    std::string multicast_group_address_;
+    port_t multicast_base_port_;
+    uint16_t multicast_max_sessions_;
+    uint8_t multicast_ttl_;
+    std::string multicast_interface_;
+    
+    // Cluster settings
+    std::vector<std::string> cluster_nodes_;
+    std::string cluster_node_;
+    uint32_t cluster_virtual_nodes_;
+    
+    // Compiled allowed_* lists, read without locks
+    TftpAtomicSnapshot<TftpAccessPolicy> access_policy_;
+    TftpAtomicSnapshot<TftpRemapRules> filename_remap_;
+    
     /**
      * @brief Set default values
      */
@@ -362,6 +769,16 @@ private:
      * @return true if parsed successfully, false otherwise
      */
     bool parseJson(const Json::Value& json_config);
+    
+    /**
+     * @brief Recompile and publish the access policy
+     */
+    void compileAccessPolicy();
+    
+    /**
+     * @brief Recompile and publish the remap rules
+     */
+    void compileRemapRules();
 };
 
 } // namespace simple_tftpd
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <atomic>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Ordered filename rewrite rules in tftpd-hpa map file syntax
+ *
+ * Each rule is "flags regex [replacement]". The regex is POSIX extended
+ * syntax; the flags are:
+ *   r  rewrite the match with the replacement
+ *   g  rewrite every match, not only the first
+ *   i  match ignoring case
+ *   e  stop processing if this rule matches
+ *   s  start over from the first rule if this rule matches
+ *   a  deny the request if this rule matches
+ *   G  read requests only, P  write requests only
+ *   ~  the rule matches when the regex does not
+ * The replacement may use \0 (whole match), \1 to \9 (groups), \i (client
+ * address) and \x (client address in hex).
+ *
+ * All regexes are compiled into one automaton, determinized lazily and
+ * shared by every request, so one pass over the filename finds every rule
+ * that matches it. Capture groups are only extracted for rules that rewrite,
+ * by the system's regexec() like tftpd-hpa, so a match is leftmost-longest
+ * and an alternation captures what it would there. Where regcomp() is not
+ * available or rejects the regex, the built-in matcher captures instead,
+ * taking the first alternative that matches.
+ * Immutable once constructed apart from that cache, so one instance is
+ * shared by all connections.
+ */
+class TftpRemapRules {
+public:
+    /**
+     * @brief Compile rules; malformed rules are dropped and reported
+     * @param rules Rule lines in order; blank lines and '#' comments are ignored
+     */
+    explicit TftpRemapRules(const std::vector<std::string>& rules = {});
+
+    ~TftpRemapRules();
+
+    TftpRemapRules(const TftpRemapRules&) = delete;
+    TftpRemapRules& operator=(const TftpRemapRules&) = delete;
+
+    /**
+     * @brief Apply the rules to a requested filename
+     * @param filename Name as requested
+     * @param client_address Client address for \i and \x
+     * @param for_write true for write requests (selects G/P rules)
+     * @param result Receives the rewritten name (the request itself if no rule rewrites)
+     * @return false if an 'a' rule denies the request or the rules loop
+     */
+    bool remap(const std::string& filename, const std::string& client_address, bool for_write,
+               std::string& result) const;
+
+    /**
+     * @brief Check if there are no usable rules
+     */
+    bool empty() const { return rules_.empty(); }
+
+    /**
+     * @brief Number of compiled rules
+     */
+    size_t ruleCount() const { return rules_.size(); }
+
+    /**
+     * @brief Rules that could not be compiled, with the reason
+     */
+    const std::vector<std::string>& getRejectedRules() const { return rejected_; }
+
+    /**
+     * @brief Number of automaton states built so far
+     */
+    size_t stateCount() const { return static_cast<size_t>(state_count_.load(std::memory_order_acquire)); }
+
+private:
+    using CharSet = std::bitset<256>;
+
+    struct Inst {
+        enum Op : uint8_t { SET, SPLIT, JMP, SAVE, MATCH, BEGIN, END };
+        Op op;
+        int x = 0;    // Next instruction (preferred branch for SPLIT)
+        int y = 0;    // Other branch of SPLIT
+        int arg = 0;  // Charset for SET, slot for SAVE, rule for MATCH
+    };
+
+    struct PosixRegex;
+
+    struct Rule {
+        std::string replacement;
+        bool rewrite = false;
+        bool global = false;
+        bool end = false;
+        bool restart = false;
+        bool abort = false;
+        bool invert = false;
+        bool reads = true;
+        bool writes = true;
+        bool anchored = false;  // Can only match at the start of the name
+        bool filtered = false;  // Matches always start with a byte in first
+        CharSet first;
+        std::vector<Inst> code;  // Program with captures, for rewriting
+        int slots = 2;
+        std::shared_ptr<const PosixRegex> posix;  // Same regex for regexec(), rewriting rules only
+    };
+
+    struct State {
+        std::vector<int> pcs;          // Live SET and END instructions beyond the restart set, sorted
+        std::vector<int> accepts;      // Rules matched on entering this state
+        std::vector<int> end_accepts;  // Rules matched if the input ends here
+    };
+
+    std::vector<Rule> rules_;
+    std::vector<std::string> rejected_;
+    std::vector<CharSet> sets_;
+
+    // Every rule's program back to back, for the combined automaton
+    std::vector<Inst> code_;
+    std::vector<int> starts_;
+    std::vector<int> restart_pcs_;  // Unanchored match starts, implied in every state
+    std::vector<char> in_restart_;
+
+    // Rule masks, one bit per rule
+    std::vector<uint64_t> always_;  // Rules matching the empty string anywhere
+    std::vector<uint64_t> invert_mask_;
+    std::vector<uint64_t> read_mask_;
+    std::vector<uint64_t> write_mask_;
+
+    // Lazily built DFA; transitions are published with release stores so
+    // lookups never lock, and only a missing transition takes mutex_
+    uint8_t byte_class_[256];
+    int classes_;
+    int capacity_;
+    std::unique_ptr<State[]> states_;
+    std::unique_ptr<std::atomic<int32_t>[]> transitions_;
+    mutable std::atomic<int32_t> state_count_;
+    mutable std::map<std::vector<int>, int> state_ids_;
+    mutable std::mutex mutex_;
+
+    bool compileRule(const std::string& line, std::string& error);
+    void buildAutomaton();
+    int transition(int state, uint8_t byte) const;
+
+    void closure(int pc, bool at_begin, bool at_end, std::vector<int>& pcs, std::vector<int>& accepts,
+                 std::vector<char>& seen) const;
+    void normalize(State& state) const;
+    void step(const State& state, uint8_t byte, State& next) const;
+    void finish(State& state, bool at_begin) const;
+    void scan(const std::string& text, std::vector<uint64_t>& matched) const;
+    size_t nextRule(const std::vector<uint64_t>& matched, size_t from, bool for_write) const;
+
+    bool search(const Rule& rule, const std::string& text, size_t from, std::vector<int>& slots) const;
+    bool backtrack(const Rule& rule, const std::string& text, size_t from, std::vector<int>& slots) const;
+    bool simulate(const Rule& rule, const std::string& text, size_t from, std::vector<int>& slots) const;
+    std::string rewrite(const Rule& rule, const std::string& text, const std::string& client_address) const;
+};
+
+} // namespace simple_tftpd
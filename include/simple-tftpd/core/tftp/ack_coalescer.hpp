@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief The ACK kept for one session in a receive batch
+ */
+struct TftpPendingAck {
+    std::string key;    ///< Connection key of the sender
+    uint16_t block = 0;
+    size_t packet = 0;  ///< Position of the ACK's datagram in the batch
+};
+
+/**
+ * @brief ACKs of one receive batch, collapsed to one per session
+ *
+ * An ACK is cumulative (RFC 7440), so of several ACKs from one session in
+ * the same batch only the newest needs handling: it releases everything
+ * the others would, and the window is refilled once instead of once per
+ * ACK. Another packet from the session ends its run, so the pending ACK is
+ * taken and handled first and the session sees its packets in order.
+ *
+ * A batch holds a few dozen datagrams, so sessions are found by a linear
+ * scan, and the vector keeps its capacity from one batch to the next.
+ */
+class TftpAckCoalescer {
+public:
+    /**
+     * @brief Add an ACK from the batch
+     * @param key Connection key of the sender
+     * @param block Acknowledged block
+     * @param packet Position of the datagram in the batch
+     * @return true if the session already had an ACK pending and one of the two was dropped
+     */
+    bool add(const std::string& key, uint16_t block, size_t packet);
+
+    /**
+     * @brief Remove the ACK pending for a session
+     * @param key Connection key
+     * @param ack Receives the ACK
+     * @return false if none was pending
+     */
+    bool take(const std::string& key, TftpPendingAck& ack);
+
+    /// ACKs still pending, in the order their sessions first appeared in the batch
+    const std::vector<TftpPendingAck>& pending() const { return pending_; }
+
+    /**
+     * @brief Forget the pending ACKs before the next batch
+     */
+    void clear() { pending_.clear(); }
+
+private:
+    std::vector<TftpPendingAck> pending_;
+};
+
+} // namespace simple_tftpd
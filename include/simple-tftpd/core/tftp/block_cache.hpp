@@ -0,0 +1,346 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Identity of a cached transfer stream
+ *
+ * Size and modification time stand in for the file version, so a rewritten
+ * file gets a new entry and the stale one ages out of the LRU.
+ */
+struct TftpBlockCacheKey {
+    std::string path;
+    uint64_t file_size = 0;
+    int64_t modified = 0;
+    uint16_t block_size = 512;
+    TftpMode mode = TftpMode::OCTET;
+
+    bool operator<(const TftpBlockCacheKey& other) const {
+        return std::tie(path, file_size, modified, block_size, mode) <
+               std::tie(other.path, other.file_size, other.modified, other.block_size, other.mode);
+    }
+};
+
+/**
+ * @brief Counters common to the transfer caches
+ */
+struct TftpCacheStats {
+    uint64_t hits = 0;            ///< Lookups answered by a ready or in-flight entry
+    uint64_t misses = 0;          ///< Lookups that produced the entry
+    uint64_t evictions = 0;
+    uint64_t entries = 0;
+    uint64_t bytes_used = 0;
+    uint64_t capacity = 0;
+};
+
+/**
+ * @brief Block cache counters
+ */
+struct TftpBlockCacheStats : TftpCacheStats {
+    uint64_t blocks_cached = 0;   ///< DATA blocks sent without disk reads or transcoding
+    uint64_t blocks_uncached = 0; ///< DATA blocks read (and transcoded) for one client
+
+    /**
+     * @brief Fraction of DATA blocks served straight from the cache
+     * @return Ratio in [0, 1], 0 when nothing was sent
+     */
+    double hitRatio() const {
+        uint64_t total = blocks_cached + blocks_uncached;
+        return total == 0 ? 0.0 : static_cast<double>(blocks_cached) / static_cast<double>(total);
+    }
+};
+
+/**
+ * @brief Byte-budgeted LRU cache with single-flight population
+ *
+ * Concurrent cold lookups for the same key collapse into one call of the
+ * producer: the first caller runs it, the others wait for its result.
+ * Entries are evicted least recently used once the budget is exceeded;
+ * holders of an evicted entry keep it alive until they release it.
+ *
+ * @tparam Value Immutable value type providing memoryUsage()
+ */
+template <typename Value>
+class TftpSingleFlightCache {
+public:
+    using Producer = std::function<std::shared_ptr<const Value>()>;
+
+    /**
+     * @brief Constructor
+     * @param capacity Byte budget, 0 disables caching
+     */
+    explicit TftpSingleFlightCache(size_t capacity) : capacity_(capacity), bytes_used_(0) {}
+
+    /**
+     * @brief Look up a value, producing it once if absent
+     * @param key Value identity
+     * @param size_hint Lower bound of the value size, used to skip hopeless loads
+     * @param produce Called at most once per key while it stays cached; an exception counts as failure
+     * @param was_cached Set when no production was needed by this caller
+     * @return Value, or nullptr if disabled, too large or production failed
+     */
+    std::shared_ptr<const Value> acquire(const TftpBlockCacheKey& key, uint64_t size_hint,
+                                         const Producer& produce, bool& was_cached) {
+        was_cached = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = slots_.find(key);
+        if (it != slots_.end()) {
+            stats_.hits++;
+            was_cached = true;
+            if (it->second.ready) {
+                lru_.splice(lru_.begin(), lru_, it->second.lru);
+                return it->second.value;
+            }
+
+            // Another caller is producing this key; share its result
+            auto pending = it->second.pending;
+            lock.unlock();
+            auto value = pending.get();
+            was_cached = value != nullptr;
+            return value;
+        }
+
+        if (capacity_ == 0 || size_hint > capacity_) {
+            return nullptr;
+        }
+
+        std::promise<std::shared_ptr<const Value>> promise;
+        slots_[key].pending = promise.get_future().share();
+        stats_.misses++;
+        lock.unlock();
+
+        std::shared_ptr<const Value> value;
+        try {
+            value = produce();
+        } catch (...) {
+            // Waiters and later callers fall back to reading the file themselves
+            value = nullptr;
+        }
+
+        lock.lock();
+        it = slots_.find(key);
+        if (value && value->memoryUsage() <= capacity_) {
+            it->second.value = value;
+            it->second.ready = true;
+            lru_.push_front(key);
+            it->second.lru = lru_.begin();
+            bytes_used_ += value->memoryUsage();
+            evictLocked();
+        } else {
+            slots_.erase(it);
+        }
+        lock.unlock();
+
+        promise.set_value(value);
+        return value;
+    }
+
+    /**
+     * @brief Change the byte budget, evicting as needed
+     * @param capacity Byte budget, 0 disables caching
+     */
+    void setCapacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity;
+        evictLocked();
+    }
+
+    /**
+     * @brief Drop all ready entries
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& key : lru_) {
+            slots_.erase(key);
+            stats_.evictions++;
+        }
+        lru_.clear();
+        bytes_used_ = 0;
+    }
+
+    /**
+     * @brief Get cache counters
+     * @return Cache statistics
+     */
+    TftpCacheStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TftpCacheStats stats = stats_;
+        stats.entries = lru_.size();
+        stats.bytes_used = bytes_used_;
+        stats.capacity = capacity_;
+        return stats;
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<const Value> value;
+        std::shared_future<std::shared_ptr<const Value>> pending;
+        typename std::list<TftpBlockCacheKey>::iterator lru;
+        bool ready = false;
+    };
+
+    size_t capacity_;
+    size_t bytes_used_;
+    std::map<TftpBlockCacheKey, Slot> slots_;
+    /** Most recently used first; ready entries only */
+    std::list<TftpBlockCacheKey> lru_;
+    TftpCacheStats stats_;
+    mutable std::mutex mutex_;
+
+    void evictLocked() {
+        // The newest entry always fits on its own (checked in acquire)
+        while (bytes_used_ > capacity_ && !lru_.empty()) {
+            auto it = slots_.find(lru_.back());
+            bytes_used_ -= it->second.value->memoryUsage();
+            slots_.erase(it);
+            lru_.pop_back();
+            stats_.evictions++;
+        }
+    }
+};
+
+/**
+ * @brief Immutable, ready-to-send DATA frames of one transfer stream
+ *
+ * Frames are stored back to back with their 4-byte header already written.
+ * Block numbers follow from the position (block n + 1 wraps like the wire
+ * field), so readers send frames as-is and share one copy.
+ */
+class TftpBlockStream {
+public:
+    /**
+     * @brief Build frames from the (already transcoded) stream bytes
+     * @param stream Bytes sent to the client
+     * @param block_size Negotiated block size
+     */
+    TftpBlockStream(const std::vector<uint8_t>& stream, uint16_t block_size);
+
+    /**
+     * @brief Number of DATA frames, including the final short one
+     */
+    size_t frameCount() const { return frame_count_; }
+
+    /**
+     * @brief Total payload bytes across all frames
+     */
+    uint64_t streamSize() const { return stream_size_; }
+
+    /**
+     * @brief Bytes held by the frames
+     */
+    size_t memoryUsage() const { return frames_.size(); }
+
+    /**
+     * @brief Get a complete DATA frame
+     * @param index Zero-based block index (block number index + 1)
+     * @return View of header and payload, empty when out of range
+     */
+    ByteView frame(size_t index) const;
+
+private:
+    std::vector<uint8_t> frames_;
+    uint16_t block_size_;
+    uint64_t stream_size_;
+    size_t frame_count_;
+};
+
+/**
+ * @brief Server-wide cache of DATA frames keyed by file, blksize and mode
+ */
+class TftpBlockCache {
+public:
+    /**
+     * @brief Produce the stream bytes for a key (disk read plus transcoding)
+     * @return true on success
+     */
+    using Loader = std::function<bool(std::vector<uint8_t>& stream)>;
+
+    /**
+     * @brief Constructor
+     * @param capacity Byte budget, 0 disables caching
+     */
+    explicit TftpBlockCache(size_t capacity);
+
+    /**
+     * @brief Look up a stream, loading it once if absent
+     * @param key Stream identity
+     * @param loader Called at most once per key while it stays cached
+     * @param was_cached Set when no load was needed by this caller
+     * @return Frames, or nullptr if disabled, too large or the load failed
+     */
+    std::shared_ptr<const TftpBlockStream> acquire(const TftpBlockCacheKey& key, const Loader& loader,
+                                                   bool& was_cached);
+
+    /**
+     * @brief Account DATA blocks sent by a transfer
+     * @param count Number of new (non-retransmitted) blocks
+     * @param cached Whether they came from a cache entry
+     */
+    void recordBlocks(uint64_t count, bool cached);
+
+    /**
+     * @brief Change the byte budget, evicting as needed
+     * @param capacity Byte budget, 0 disables caching
+     */
+    void setCapacity(size_t capacity);
+
+    /**
+     * @brief Drop all ready entries
+     */
+    void clear();
+
+    /**
+     * @brief Get cache counters
+     * @return Cache statistics
+     */
+    TftpBlockCacheStats getStats() const;
+
+private:
+    TftpSingleFlightCache<TftpBlockStream> frames_;
+    std::atomic<uint64_t> blocks_cached_;
+    std::atomic<uint64_t> blocks_uncached_;
+};
+
+/**
+ * @brief Whole-file netascii conversion shared by all block sizes
+ */
+struct TftpConvertedStream {
+    std::vector<uint8_t> bytes;
+
+    size_t memoryUsage() const { return bytes.size(); }
+};
+
+/** Netascii conversions keyed by file version (block_size 0) */
+using TftpNetasciiCache = TftpSingleFlightCache<TftpConvertedStream>;
+
+} // namespace simple_tftpd
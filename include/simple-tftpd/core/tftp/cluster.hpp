@@ -0,0 +1,215 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/config/access_policy.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/tftp/origin_store.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include "simple-tftpd/core/utils/logger.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Cluster counters
+ */
+struct TftpClusterStats {
+    uint64_t owned_misses = 0;      ///< Misses for files this node owns (filled from the origin)
+    uint64_t peer_fetches = 0;      ///< Misses streamed from the owning node
+    uint64_t peer_failures = 0;     ///< Owner unreachable or failing; the origin was asked instead
+    uint64_t requests_served = 0;   ///< Peer requests answered
+    uint64_t requests_refused = 0;  ///< Peer connections from outside the membership list
+    uint64_t bytes_served = 0;      ///< Body bytes sent to peers
+};
+
+/**
+ * @brief Consistent hash ring mapping file names to cluster nodes
+ *
+ * Each node is placed at virtual_nodes points of a 64-bit ring, and a name
+ * belongs to the node at the first point at or after the name's hash.
+ * Adding or removing a node moves only the names on the arcs it gains or
+ * loses (about 1/N of them); every other name keeps its owner, so the
+ * other nodes' caches stay valid across membership changes.
+ */
+class TftpHashRing {
+public:
+    /**
+     * @brief Constructor
+     * @param nodes Node names; the ring is empty if there are none
+     * @param virtual_nodes Points per node
+     */
+    TftpHashRing(std::vector<std::string> nodes, uint32_t virtual_nodes);
+
+    /**
+     * @brief Get the node owning a name
+     * @param name File name below the root
+     * @return Index into getNodes(); 0 for an empty ring
+     */
+    size_t owner(const std::string& name) const;
+
+    /**
+     * @brief Get the node names
+     */
+    const std::vector<std::string>& getNodes() const { return nodes_; }
+
+    bool empty() const { return nodes_.empty(); }
+
+    /**
+     * @brief Hash used for names and points (FNV-1a with a final mix)
+     */
+    static uint64_t hash(const std::string& text);
+
+private:
+    std::vector<std::string> nodes_;
+    std::vector<std::pair<uint64_t, uint32_t>> points_;  // Sorted by hash, node index
+};
+
+/**
+ * @brief Cluster mode: files are cached on the node their name hashes to
+ *
+ * With cluster.nodes set, every node holds the same membership list and
+ * hashes each name to one owner. A miss for a file another node owns is
+ * streamed from that node over the peer protocol instead of the origin,
+ * and is not kept; the owner serves it from its root, filling it from
+ * the origin first if needed. Each file is therefore cached once in the
+ * fleet, and the cache capacity grows with the number of nodes. When the
+ * owner cannot be reached the origin is asked directly.
+ *
+ * The peer protocol is the subset of HTTP/1.1 the origin store speaks:
+ * GET of a percent-encoded name, answered with Content-Length. Only
+ * addresses in the membership list may connect, and the peer listener
+ * never forwards a request, so a disagreement about the membership costs
+ * an origin fetch rather than a loop.
+ */
+class TftpCluster {
+public:
+    /**
+     * @brief Constructor
+     * @param config Server configuration
+     * @param logger Logger instance
+     * @param origin Origin store used for peer downloads and owned misses
+     */
+    TftpCluster(std::shared_ptr<TftpConfig> config, std::shared_ptr<Logger> logger, TftpOriginStore& origin);
+
+    /**
+     * @brief Destructor
+     */
+    ~TftpCluster();
+
+    TftpCluster(const TftpCluster&) = delete;
+    TftpCluster& operator=(const TftpCluster&) = delete;
+
+    /**
+     * @brief Start the peer listener on this node's endpoint; does nothing without cluster.nodes
+     * @param root Supplies the served root for each peer request
+     * @return false if the listener could not be bound
+     */
+    bool start(std::function<std::shared_ptr<const TftpRootHandle>()> root);
+
+    /**
+     * @brief Stop the peer listener and wait for peer requests in progress
+     */
+    void stop();
+
+    /**
+     * @brief Use a reloaded configuration; the membership is rebuilt, the peer endpoint needs a restart
+     * @param config Server configuration
+     */
+    void setConfig(std::shared_ptr<TftpConfig> config);
+
+    /**
+     * @brief Check if cluster mode is configured
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief Get the node owning a name
+     * @param name File name below the root
+     * @return Peer endpoint of the owner, empty when cluster mode is off
+     */
+    std::string ownerOf(const std::string& name) const;
+
+    /**
+     * @brief Look up a file missing from the root
+     *
+     * Files owned by another node are streamed from it; files this node
+     * owns, and files whose owner failed, are fetched from the origin.
+     * @param root Served root
+     * @param name Name below the root
+     * @param fetch Receives the download for FETCHING
+     * @return As TftpOriginStore::fetch()
+     */
+    TftpOriginStore::Result fetch(const std::shared_ptr<const TftpRootHandle>& root, const std::string& name,
+                                  std::shared_ptr<const TftpOriginFetch>& fetch);
+
+    /**
+     * @brief Get the bound peer port (0 when not listening)
+     */
+    port_t getPeerPort() const { return peer_port_.load(); }
+
+    /**
+     * @brief Get cluster counters
+     */
+    TftpClusterStats getStats() const;
+
+private:
+    struct Membership {
+        TftpHashRing ring;
+        size_t self;                     // Index of this node in the ring
+        std::vector<std::string> hosts;  // Numeric addresses allowed to connect
+    };
+
+    std::shared_ptr<TftpConfig> config_;
+    std::shared_ptr<Logger> logger_;
+    TftpOriginStore& origin_;
+    TftpAtomicSnapshot<Membership> membership_;
+    std::function<std::shared_ptr<const TftpRootHandle>()> root_;
+
+    socket_t listen_socket_;
+    std::atomic<port_t> peer_port_;
+    std::atomic<bool> running_;
+    std::thread accept_thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable idle_;
+    std::set<socket_t> active_;  // Peer connections being answered
+
+    std::atomic<uint64_t> owned_misses_;
+    std::atomic<uint64_t> peer_fetches_;
+    std::atomic<uint64_t> peer_failures_;
+    std::atomic<uint64_t> requests_served_;
+    std::atomic<uint64_t> requests_refused_;
+    std::atomic<uint64_t> bytes_served_;
+
+    static std::shared_ptr<const Membership> buildMembership(const TftpConfig& config);
+    void acceptLoop();
+    void servePeer(socket_t socket);
+    bool sendFile(socket_t socket, const std::shared_ptr<const TftpRootHandle>& root, const std::string& name);
+    void logEvent(LogLevel level, const std::string& message) const;
+};
+
+} // namespace simple_tftpd
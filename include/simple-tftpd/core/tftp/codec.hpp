@@ -0,0 +1,288 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Non-owning view over a byte range (C++17 stand-in for std::span<const uint8_t>)
+ */
+struct ByteView {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    constexpr ByteView() = default;
+    constexpr ByteView(const uint8_t* bytes, size_t length) : data(bytes), size(length) {}
+
+    constexpr const uint8_t* begin() const { return data; }
+    constexpr const uint8_t* end() const { return data + size; }
+    constexpr bool empty() const { return size == 0; }
+};
+
+/**
+ * @brief Wire format limits for one opcode
+ */
+struct TftpOpcodeInfo {
+    TftpOpcode opcode;
+    const char* name;
+    size_t min_size;
+    size_t max_size;
+};
+
+/**
+ * @brief Opcode table indexed by opcode - 1 (RFC 1350, RFC 2347)
+ */
+constexpr TftpOpcodeInfo TFTP_OPCODE_TABLE[] = {
+    {TftpOpcode::RRQ,   "RRQ",   6, TFTP_MAX_DATAGRAM_SIZE},  // opcode, name, NUL, mode, NUL
+    {TftpOpcode::WRQ,   "WRQ",   6, TFTP_MAX_DATAGRAM_SIZE},
+    {TftpOpcode::DATA,  "DATA",  4, TFTP_MAX_DATAGRAM_SIZE},  // opcode, block, 0..blksize bytes
+    {TftpOpcode::ACK,   "ACK",   4, 4},
+    {TftpOpcode::ERROR, "ERROR", 5, TFTP_MAX_DATAGRAM_SIZE},  // opcode, code, message
+    {TftpOpcode::OACK,  "OACK",  2, TFTP_MAX_DATAGRAM_SIZE},
+};
+
+/**
+ * @brief Look up wire limits for a raw opcode value
+ * @param value Opcode as read from the wire
+ * @return Table entry, or nullptr for unknown opcodes
+ */
+constexpr const TftpOpcodeInfo* findOpcodeInfo(uint16_t value) {
+    return (value >= 1 && value <= 6) ? &TFTP_OPCODE_TABLE[value - 1] : nullptr;
+}
+
+/**
+ * @brief ASCII case-insensitive comparison (RFC 1350 modes, RFC 2347 option names)
+ */
+constexpr bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        char a = lhs[i];
+        char b = rhs[i];
+        if (a >= 'A' && a <= 'Z') {
+            a = static_cast<char>(a - 'A' + 'a');
+        }
+        if (b >= 'A' && b <= 'Z') {
+            b = static_cast<char>(b - 'A' + 'a');
+        }
+        if (a != b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Transfer mode names as they appear on the wire
+ */
+struct TftpModeInfo {
+    TftpMode mode;
+    std::string_view name;
+};
+
+constexpr TftpModeInfo TFTP_MODE_TABLE[] = {
+    {TftpMode::NETASCII, "netascii"},
+    {TftpMode::OCTET,    "octet"},
+    {TftpMode::MAIL,     "mail"},
+};
+
+/**
+ * @brief Wire name of a transfer mode
+ * @param mode Transfer mode
+ * @return Mode string without terminator
+ */
+constexpr std::string_view modeToWireName(TftpMode mode) {
+    for (const auto& entry : TFTP_MODE_TABLE) {
+        if (entry.mode == mode) {
+            return entry.name;
+        }
+    }
+    return "octet";
+}
+
+/**
+ * @brief Decoded RRQ/WRQ; all views point into the receive buffer
+ */
+struct TftpRequestView {
+    TftpOpcode opcode = TftpOpcode::RRQ;
+    std::string_view filename;
+    TftpMode mode = TftpMode::OCTET;
+    /** Raw option name/value pairs following the mode (may be empty) */
+    ByteView options;
+};
+
+/**
+ * @brief Decoded DATA; payload points into the receive buffer
+ */
+struct TftpDataView {
+    uint16_t block = 0;
+    ByteView payload;
+};
+
+/**
+ * @brief Decoded ACK
+ */
+struct TftpAckView {
+    uint16_t block = 0;
+};
+
+/**
+ * @brief Decoded ERROR; message points into the receive buffer
+ */
+struct TftpErrorView {
+    uint16_t code = 0;
+    std::string_view message;
+};
+
+/**
+ * @brief Allocation-free TFTP wire codec
+ *
+ * Decoders fill views that borrow the caller's buffer and never copy;
+ * the buffer must outlive the view. Encoders write into caller-provided
+ * storage and return the number of bytes written, or 0 when the output
+ * does not fit.
+ */
+class TftpCodec {
+public:
+    /** Opcode plus block number / error code */
+    static constexpr size_t HEADER_SIZE = 4;
+
+    /** Upper bound for the option pairs written by encodeRequest()/encodeOptionAck() */
+    static constexpr size_t MAX_OPTIONS_SIZE = 128;
+
+    /**
+     * @brief Read and validate the opcode and datagram size
+     * @param data Raw packet data
+     * @param size Size of data
+     * @param opcode Receives the opcode
+     * @return true if the opcode is known and the size is within its limits
+     */
+    static bool peekOpcode(const uint8_t* data, size_t size, TftpOpcode& opcode);
+
+    /**
+     * @brief Decode RRQ/WRQ
+     * @return true if filename and mode are present, terminated and the mode is
+     *         known (matched case-insensitively)
+     */
+    static bool decodeRequest(const uint8_t* data, size_t size, TftpRequestView& view);
+
+    /**
+     * @brief Decode the option name/value pairs of a request (RFC 2347)
+     *
+     * Single pass over the borrowed bytes; never throws or allocates. Names
+     * match case-insensitively, unknown names and unparsable values are
+     * skipped, and the last occurrence of a repeated option wins.
+     * @param options Raw option region (TftpRequestView::options)
+     * @param result Receives recognised options; starts from defaults
+     * @return false if the region ends inside a name/value pair (pairs before it are kept)
+     */
+    static bool decodeOptions(ByteView options, TftpOptions& result);
+
+    /**
+     * @brief Decode DATA
+     */
+    static bool decodeData(const uint8_t* data, size_t size, TftpDataView& view);
+
+    /**
+     * @brief Decode ACK (exactly four bytes)
+     */
+    static bool decodeAck(const uint8_t* data, size_t size, TftpAckView& view);
+
+    /**
+     * @brief Decode ERROR; an unterminated message runs to the end of the datagram
+     */
+    static bool decodeError(const uint8_t* data, size_t size, TftpErrorView& view);
+
+    /**
+     * @brief Encode RRQ/WRQ with the options flagged in @p options
+     * @return Bytes written, 0 if @p capacity is too small
+     */
+    static size_t encodeRequest(uint8_t* out, size_t capacity, TftpOpcode opcode,
+                                std::string_view filename, TftpMode mode,
+                                const TftpOptions& options);
+
+    /**
+     * @brief Encode a DATA header; the caller places the payload at out + HEADER_SIZE
+     * @return HEADER_SIZE, 0 if @p capacity is too small
+     */
+    static size_t encodeDataHeader(uint8_t* out, size_t capacity, uint16_t block);
+
+    /**
+     * @brief Encode DATA with payload copied from @p payload
+     * @return Bytes written, 0 if @p capacity is too small
+     */
+    static size_t encodeData(uint8_t* out, size_t capacity, uint16_t block, ByteView payload);
+
+    /**
+     * @brief Encode ACK
+     * @return HEADER_SIZE, 0 if @p capacity is too small
+     */
+    static size_t encodeAck(uint8_t* out, size_t capacity, uint16_t block);
+
+    /**
+     * @brief Encode ERROR with a NUL-terminated message
+     * @return Bytes written, 0 if @p capacity is too small
+     */
+    static size_t encodeError(uint8_t* out, size_t capacity, TftpError code, std::string_view message);
+
+    /**
+     * @brief Encode OACK with the options flagged in @p options
+     * @return Bytes written, 0 if @p capacity is too small
+     */
+    static size_t encodeOptionAck(uint8_t* out, size_t capacity, const TftpOptions& options);
+};
+
+/**
+ * @brief Streaming local-to-netascii encoder (LF becomes CRLF)
+ *
+ * Carries the previous byte across calls, so a file converted chunk by
+ * chunk yields exactly the bytes of a whole-file conversion; an LF already
+ * preceded by CR is left alone.
+ */
+class NetasciiEncoder {
+public:
+    /**
+     * @brief Append the encoding of @p input to @p out
+     * @param input Next chunk of local text
+     * @param out Receives the converted bytes
+     */
+    void encode(ByteView input, std::vector<uint8_t>& out);
+
+    /**
+     * @brief Count the bytes encode() would produce, advancing the same state
+     * @param input Next chunk of local text
+     * @return Converted length of the chunk
+     */
+    uint64_t measure(ByteView input);
+
+    /**
+     * @brief Forget the carried byte before a new stream
+     */
+    void reset() { previous_cr_ = false; }
+
+private:
+    bool previous_cr_ = false;
+};
+
+} // namespace simple_tftpd
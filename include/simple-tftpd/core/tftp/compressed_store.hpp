@@ -0,0 +1,256 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Compression format of a stored file
+ */
+enum class TftpCompression {
+    GZIP,
+    ZSTD
+};
+
+/**
+ * @brief Compressed store counters
+ *
+ * Disk bytes saved is bytes_decompressed - compressed_bytes_read; the CPU
+ * paid for it is decompress_time_us.
+ */
+struct TftpCompressionStats {
+    uint64_t files_opened = 0;
+    uint64_t compressed_bytes_read = 0;   ///< Bytes read from storage
+    uint64_t bytes_decompressed = 0;      ///< Bytes produced for transfers
+    uint64_t decompress_time_us = 0;      ///< Time spent inside the decoders
+    uint64_t size_scans = 0;              ///< Full decompressions needed to learn a size
+
+    /**
+     * @brief Storage reads avoided by serving the compressed copy
+     */
+    uint64_t bytesSaved() const {
+        return bytes_decompressed > compressed_bytes_read ? bytes_decompressed - compressed_bytes_read : 0;
+    }
+};
+
+class TftpCompressedStore;
+
+/**
+ * @brief A compressed copy found by TftpCompressedStore::resolve()
+ */
+struct TftpCompressedCopy {
+    std::shared_ptr<const TftpRootHandle> directory;  ///< Directory the copy is opened beneath
+    std::string name;                                 ///< Path of the copy below @c directory
+    std::string path;                                 ///< Full path, for logs and cache keys
+    TftpCompression codec = TftpCompression::GZIP;
+    TftpFileMetadata metadata;                        ///< The copy as found, not its contents
+};
+
+/**
+ * @brief Streaming decompressor over one compressed file
+ *
+ * Concatenated gzip members and zstd frames are decoded back to back, as
+ * the command-line tools do.
+ */
+class TftpCompressedReader {
+public:
+    /**
+     * @brief Constructor
+     * @param codec Compression format
+     * @param store Store receiving the counters, may be null
+     */
+    TftpCompressedReader(TftpCompression codec, TftpCompressedStore* store);
+
+    /**
+     * @brief Destructor
+     */
+    ~TftpCompressedReader();
+
+    TftpCompressedReader(const TftpCompressedReader&) = delete;
+    TftpCompressedReader& operator=(const TftpCompressedReader&) = delete;
+
+    /**
+     * @brief Take over an open compressed file
+     * @param file Compressed file
+     * @return true if the file is open and the codec is available
+     */
+    bool open(TftpFileHandle file);
+
+    /**
+     * @brief Fail instead of producing more than a given size
+     * @param size Decompressed bytes the file was advertised with
+     */
+    void limitTo(uint64_t size) { limit_ = size; }
+
+    /**
+     * @brief Decompress the next bytes
+     * @param out Destination
+     * @param size Bytes wanted
+     * @return Bytes written; fewer than @p size only at the end or on error
+     */
+    size_t read(uint8_t* out, size_t size);
+
+    /**
+     * @brief Restart from the beginning of the file
+     * @return true on success
+     */
+    bool rewind();
+
+    /**
+     * @brief Check if the whole file was decompressed
+     */
+    bool eof() const { return eof_; }
+
+    /**
+     * @brief Check if reading or decoding failed (corrupt or truncated input)
+     */
+    bool failed() const { return failed_; }
+
+private:
+    struct Decoder;
+
+    TftpCompression codec_;
+    TftpCompressedStore* store_;
+    std::unique_ptr<Decoder> decoder_;
+    TftpFileHandle file_;
+    std::vector<uint8_t> input_;
+    size_t input_pos_;
+    size_t input_len_;
+    uint64_t unreported_input_;  // Compressed bytes read since the last report to store_
+    uint64_t produced_;          // Decompressed bytes since the start
+    uint64_t limit_;
+    bool frame_done_;
+    bool eof_;
+    bool failed_;
+
+    bool fillInput();
+};
+
+/**
+ * @brief Finds and opens compressed copies of requested files
+ *
+ * A request for "name" that does not exist as stored is served from
+ * "name.zst" or "name.gz", next to it or in a directory mirroring the root.
+ * Copies are looked up and opened beneath that directory's handle, so a
+ * symlinked copy cannot lead outside it.
+ * The decompressed size comes from a "<copy>.size" sidecar holding the
+ * decimal byte count (ignored when older than the copy), else the sizes
+ * recorded in the headers of every zstd frame, else one counting pass.
+ * Sizes not from a sidecar are remembered per file version.
+ */
+class TftpCompressedStore {
+public:
+    /**
+     * @brief Constructor
+     * @param config Server configuration
+     */
+    explicit TftpCompressedStore(std::shared_ptr<TftpConfig> config);
+
+    /**
+     * @brief Use a reloaded configuration
+     * @param config Server configuration
+     */
+    void setConfig(std::shared_ptr<TftpConfig> config);
+
+    /**
+     * @brief Check if a format can be decoded by this build
+     * @param codec Compression format
+     * @return true if the library for @p codec was compiled in
+     */
+    static bool isSupported(TftpCompression codec);
+
+    /**
+     * @brief Find the compressed copy of a requested file
+     * @param root Served root, holding the copies unless a compressed directory is configured
+     * @param filename Requested path relative to the root directory
+     * @param copy Receives the copy
+     * @return false if the store is disabled or no supported copy exists
+     */
+    bool resolve(const std::shared_ptr<const TftpRootHandle>& root, const std::string& filename,
+                 TftpCompressedCopy& copy);
+
+    /**
+     * @brief Filesystem probes a failed resolve() costs
+     * @return Number of candidate copies checked, 0 when the store is disabled
+     */
+    uint32_t resolveProbes() const;
+
+    /**
+     * @brief Determine the decompressed size of a compressed copy
+     * @param copy Copy from resolve()
+     * @param size Receives the decompressed size
+     * @return false if the copy is unreadable or corrupt
+     */
+    bool contentSize(const TftpCompressedCopy& copy, uint64_t& size);
+
+    /**
+     * @brief Open a reader on a compressed copy
+     * @param copy Copy from resolve()
+     * @param content_size Size advertised for the copy; the reader fails rather than produce more
+     * @return Reader, or nullptr if it cannot be opened
+     */
+    std::unique_ptr<TftpCompressedReader> open(const TftpCompressedCopy& copy, uint64_t content_size);
+
+    /**
+     * @brief Account work done by a reader
+     * @param compressed_bytes Bytes read from storage
+     * @param decompressed_bytes Bytes produced
+     * @param decode_time Time spent inside the decoder
+     */
+    void recordDecompression(uint64_t compressed_bytes, uint64_t decompressed_bytes,
+                             std::chrono::nanoseconds decode_time);
+
+    /**
+     * @brief Get store counters
+     * @return Compression statistics
+     */
+    TftpCompressionStats getStats() const;
+
+private:
+    using SizeKey = std::pair<std::string, int64_t>;
+
+    std::shared_ptr<TftpConfig> config_;
+    /** Decompressed sizes learnt from frame headers or by counting, per path and modification time */
+    std::map<SizeKey, uint64_t> scanned_sizes_;
+    /** Handle on the configured compressed directory, opened on first use */
+    std::shared_ptr<const TftpRootHandle> directory_;
+    mutable std::mutex mutex_;
+
+    std::atomic<uint64_t> files_opened_;
+    std::atomic<uint64_t> compressed_bytes_read_;
+    std::atomic<uint64_t> bytes_decompressed_;
+    std::atomic<uint64_t> decompress_time_ns_;
+    std::atomic<uint64_t> size_scans_;
+
+    std::shared_ptr<const TftpRootHandle> compressedDirectory(const std::string& path);
+    bool readSidecarSize(const TftpCompressedCopy& copy, uint64_t& size) const;
+    bool readFrameSizes(const TftpCompressedCopy& copy, uint64_t& size) const;
+};
+
+} // namespace simple_tftpd
@@ -18,6 +18,14 @@
 
 #include "simple-tftpd/core/utils/platform.hpp"
 #include "simple-tftpd/core/tftp/packet.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include "simple-tftpd/core/tftp/block_cache.hpp"
+#include "simple-tftpd/core/tftp/compressed_store.hpp"
+#include "simple-tftpd/core/tftp/origin_store.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include "simple-tftpd/core/tftp/send_window.hpp"
+#include "simple-tftpd/core/tftp/receive_window.hpp"
+#include "simple-tftpd/core/tftp/shared_cache.hpp"
 #include "simple-tftpd/core/config/config.hpp"
 #include "simple-tftpd/core/utils/logger.hpp"
 #include <memory>
@@ -27,6 +35,7 @@
 #include <chrono>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <vector>
 
 namespace simple_tftpd {
@@ -55,6 +64,53 @@ enum class TftpTransferDirection {
     WRITE   // Client writing to server
 };
 
+/**
+ * @brief Get string representation of a connection state
+ * @param state Connection state
+ * @return Lower-case state name
+ */
+std::string connectionStateToString(TftpConnectionState state);
+
+/**
+ * @brief Get string representation of a transfer direction
+ * @param direction Transfer direction
+ * @return "read" or "write"
+ */
+std::string transferDirectionToString(TftpTransferDirection direction);
+
+/**
+ * @brief Point-in-time view of a connection's transfer telemetry
+ *
+ * Produced by TftpConnection::getTelemetry() from lock-free counters,
+ * so it can be taken at any time without stalling the transfer.
+ */
+struct TftpConnectionTelemetry {
+    std::string client_address;
+    port_t client_port = 0;
+    std::string filename;
+    TftpConnectionState state = TftpConnectionState::INITIALIZED;
+    TftpTransferDirection direction = TftpTransferDirection::READ;
+    uint64_t bytes_transferred = 0;     // Acknowledged (read) or written (write) bytes
+    uint64_t total_bytes = 0;           // Expected size from tsize, 0 if unknown
+    double percent_complete = -1.0;     // -1 when the total size is unknown
+    double throughput_bps = 0.0;        // EWMA of bytes per second
+    uint16_t block_size = 0;
+    uint16_t effective_window = 0;
+    uint32_t in_flight = 0;
+    uint64_t retransmits = 0;
+    uint64_t retransmit_buffer_bytes = 0;  // Payload copies held for retransmission
+    uint64_t duplicate_acks = 0;        // ACKs for blocks already acknowledged (read)
+    uint64_t duplicate_data = 0;        // DATA blocks already written or held (write)
+    uint64_t rtt_us = 0;                // Smoothed round-trip time, 0 until sampled
+    uint64_t duration_ms = 0;
+
+    /**
+     * @brief Serialize telemetry as a JSON object
+     * @return JSON string
+     */
+    std::string toJson() const;
+};
+
 /**
  * @brief TFTP connection class
  *
@@ -148,7 +204,16 @@ public:
     std::chrono::seconds getDuration() const;
 
     /**
-     * @brief Handle incoming packet
+     * @brief Get a snapshot of transfer telemetry
+     * @return Telemetry snapshot (safe to call from any thread)
+     */
+    TftpConnectionTelemetry getTelemetry() const;
+
+    /**
+     * @brief Handle a DATA, ACK or ERROR packet of this transfer
+     *
+     * Packets arriving while the request is still being set up are kept
+     * and handled, in order, when setUp() finishes.
      * @param packet_data Raw packet data
      * @param packet_size Size of packet data
      * @param sender_addr Sender address
@@ -236,63 +301,130 @@ public:
     bool handleFileError(const std::string& operation, const std::string& filename);
 
 private:
-    struct InFlightBlock {
-        std::vector<uint8_t> payload;
-        bool is_final = false;
-        std::chrono::steady_clock::time_point last_sent;
-        size_t retries = 0;
-    };
-
     friend class TftpServer;
 
     TftpServer& server_;
+
+    // Hot transfer state, read or written for every packet and worker tick.
+    // Kept together on its own cache lines, away from the strings, callbacks
+    // and streams below, which are only used at setup and on rare paths
+    alignas(64) TftpSendWindow send_window_;  // Read transfers: blocks sent and not yet acknowledged
+    TftpReceiveWindow reorder_;               // Write transfers: blocks received ahead of a gap
+    uint16_t current_block_;
+    uint16_t expected_block_;
+    uint16_t next_block_to_send_;
+    uint16_t last_ack_block_;
+    uint16_t final_block_number_;
+    uint16_t negotiated_block_size_;
+    uint16_t negotiated_window_size_;
+    uint16_t max_retries_;
+    uint16_t gso_segments_;  // DATA frames per segmented send, 0 when UDP GSO is not used
+    bool awaiting_data_;
+    bool sent_option_ack_;
+    bool awaiting_oack_ack_;
+    bool final_block_sent_;
+    bool retransmit_from_file_;  // Blocks in flight keep their file offset, not a copy
+    bool gso_batching_;          // DATA frames are queued in gso_buffer_ instead of sent
+    bool gap_pending_;           // An ACK stopped short of the blocks sent; resend from it at gap_deadline_
+    bool resent_any_;            // resent_through_ is set
+    uint16_t resent_through_;    // Newest block retransmitted; ACKs up to it may answer the copies
+    std::atomic<bool> active_;
+    std::chrono::seconds timeout_;
+    std::chrono::steady_clock::time_point last_activity_;
+    std::chrono::steady_clock::time_point last_ack_time_;
+    std::chrono::steady_clock::time_point last_data_time_;  // Write transfers: last block taken in sequence
+    std::chrono::steady_clock::time_point gap_deadline_;
+    size_t bytes_transferred_;
+    size_t ack_retry_count_;
+    size_t next_frame_index_;  // Next frame of cached_stream_
+    uint64_t current_file_size_;
+    uint64_t advertised_file_size_;
+    uint64_t send_offset_;  // File offset of the next block, with retransmit_from_file_
+
     std::string client_addr_;
     port_t client_port_;
     std::shared_ptr<TftpConfig> config_;
     std::shared_ptr<Logger> logger_;
 
-    TftpConnectionState state_;
-    TftpTransferDirection direction_;
+    std::atomic<TftpConnectionState> state_;
+    std::atomic<TftpTransferDirection> direction_;
     std::string filename_;
     TftpMode mode_;
     TftpMode transfer_mode_;
     TftpOptions options_;
-
-    size_t bytes_transferred_;
-    uint16_t current_block_;
-    uint16_t expected_block_;
-
     std::chrono::steady_clock::time_point start_time_;
-    std::chrono::steady_clock::time_point last_activity_;
-    std::chrono::seconds timeout_;
 
-    std::atomic<bool> active_;
     std::thread worker_thread_;
+    // Taken by the setup job, the packet handlers and the worker's tick, so
+    // the transfer state is only ever touched by one thread at a time
+    std::mutex mutex_;
+    // Set while the request is queued or running on the server's setup pool;
+    // packets received meanwhile wait in deferred_packets_ (bounded)
+    mutable std::mutex setup_mutex_;
+    bool setting_up_;
+    std::vector<std::vector<uint8_t>> deferred_packets_;
     std::function<void(TftpConnectionState, const std::string&)> callback_;
 
-    // File handling
-    std::ifstream read_file_;
-    std::ofstream write_file_;
+    // File handling; files are opened beneath root_, the paths are for the caches and logs
+    std::shared_ptr<const TftpRootHandle> root_;
+    TftpFileHandle read_file_;
+    TftpFileHandle write_file_;
+    std::string read_path_;
+    std::string read_name_;  // read_path_ below the root
+    std::string write_path_;
+    uint64_t read_file_size_;  // Size on disk; advertised_file_size_ is the size on the wire
+    int64_t read_modified_;    // Modification time (ns) from the metadata lookup
+    // read_file_ is opened on first use, so transfers served from a shared
+    // stream never open the file at all
+    bool read_open_pending_;
+    // Set when read_path_ is a compressed copy; replaces read_file_ and
+    // read_file_size_ is the decompressed size
+    std::unique_ptr<TftpCompressedReader> compressed_reader_;
+    TftpCompressedCopy compressed_copy_;
+    bool read_compressed_;
+    // Set while the file is still arriving from the origin; replaces read_file_
+    std::unique_ptr<TftpOriginReader> origin_reader_;
+    // Prefork workers: plain files are read in chunks shared by all workers,
+    // at source_offset_, and read_file_ is opened only to fill a missing chunk
+    uint64_t source_offset_;
+    std::vector<uint8_t> shared_chunk_;
+
+    // Netascii/mail reads: whole-file conversion shared through the server's cache,
+    // or (when uncached) an encoder refilling netascii_pending_ from read_file_
+    std::shared_ptr<const TftpConvertedStream> netascii_stream_;
+    uint64_t netascii_offset_;
+    NetasciiEncoder netascii_encoder_;
+    std::vector<uint8_t> netascii_pending_;
+
+    // Shared pre-serialized DATA frames; when set, read_file_ is not used
+    std::shared_ptr<const TftpBlockStream> cached_stream_;
+    bool cached_stream_shared_;  // Loaded by another transfer, so no disk I/O here
 
     // Security manager (optional, for production builds)
     std::shared_ptr<ProductionSecurityManager> security_manager_;
 
-    // Reliability + retransmission tracking
-    std::map<uint16_t, InFlightBlock> in_flight_blocks_;
-    uint16_t next_block_to_send_;
-    uint16_t last_ack_block_;
-    uint16_t max_retries_;
-    bool awaiting_data_;
-    bool sent_option_ack_;
-    bool awaiting_oack_ack_;
-    bool final_block_sent_;
-    uint16_t final_block_number_;
-    uint16_t negotiated_block_size_;
-    uint16_t negotiated_window_size_;
-    uint64_t current_file_size_;
-    uint64_t advertised_file_size_;
-    size_t ack_retry_count_;
-    std::chrono::steady_clock::time_point last_ack_time_;
+    // DATA encode buffer, grown once to the largest block and then reused
+    std::vector<uint8_t> tx_buffer_;
+    // Write transfers: contiguous payloads received since the last ACK, written in one call
+    std::vector<uint8_t> write_run_;
+    // Read transfers with UDP GSO: DATA frames back to back, sent in one call
+    std::vector<uint8_t> gso_buffer_;
+    size_t gso_frames_;
+
+    // Lock-free telemetry (written on the transfer path, read by getTelemetry())
+    std::atomic<uint64_t> progress_bytes_;
+    std::atomic<uint64_t> expected_bytes_;
+    std::atomic<uint64_t> throughput_bps_;
+    std::atomic<uint64_t> unsampled_bytes_;
+    std::atomic<uint64_t> retransmit_count_;
+    std::atomic<uint64_t> retransmit_buffer_bytes_;
+    std::atomic<uint64_t> duplicate_ack_count_;
+    std::atomic<uint64_t> duplicate_data_count_;
+    std::atomic<uint64_t> smoothed_rtt_us_;
+    std::atomic<uint32_t> in_flight_count_;
+    std::atomic<uint16_t> effective_window_;
+    std::atomic<uint16_t> effective_block_size_;
+    std::chrono::steady_clock::time_point last_throughput_sample_;
 
     /**
      * @brief Main connection worker thread
@@ -302,6 +434,128 @@ private:
     bool fillSendWindow();
     bool resendBlock(uint16_t block_number);
 
+    /**
+     * @brief Resend every block in flight, from the oldest, after the client reported a gap
+     *
+     * RFC 7440: an ACK short of the blocks sent means the block after it was
+     * lost, and the sender carries on from there. Frames join the open batch.
+     * @return false if a resend failed
+     */
+    bool resendFromGap();
+
+    /**
+     * @brief Check if an ACK may answer a copy this side retransmitted
+     * @param block_number Acknowledged block
+     */
+    bool answersResend(uint16_t block_number) const;
+    bool transmitDataBlock(uint16_t block_number, const std::vector<uint8_t>& payload);
+
+    /**
+     * @brief Read a block of the file at an offset into the encode buffer and send it
+     * @param block_number Block number
+     * @param offset Position of the payload in the file
+     * @param size Payload bytes wanted
+     * @param exact Send nothing unless exactly @p size bytes were read (retransmits)
+     * @return Payload bytes sent, -1 if the read failed or -2 if the send failed
+     */
+    int64_t transmitFileBlock(uint16_t block_number, uint64_t offset, size_t size, bool exact);
+
+    /**
+     * @brief Check the file being retransmitted from still has the size and modification time it was opened with
+     * @return false if it changed or can no longer be inspected
+     */
+    bool readFileUnchanged();
+
+    /**
+     * @brief Send an encoded DATA frame, or queue it while a frame batch is open
+     * @param frame Frame data
+     * @param size Frame size
+     * @return false if a send failed
+     */
+    bool emitFrame(const uint8_t* frame, size_t size);
+
+    /**
+     * @brief Queue the DATA frames sent until endFrameBatch(), if the transfer uses UDP GSO
+     */
+    void beginFrameBatch();
+
+    /**
+     * @brief Send the queued DATA frames and stop queueing
+     * @return false if a send failed
+     */
+    bool endFrameBatch();
+
+    /**
+     * @brief Drop the queued DATA frames and stop queueing, before an error ends the transfer
+     */
+    void discardFrames();
+
+    /**
+     * @brief Send the queued DATA frames in one segmented send
+     * @return false if the send failed
+     */
+    bool flushFrames();
+
+    /**
+     * @brief Mark the connection as active and waiting for its request to be set up
+     *
+     * Called by the listener before it hands the request to the setup pool;
+     * packets for the connection are kept until setUp() has finished. The
+     * worker thread is not started here but by setUp(), off the listener.
+     */
+    void beginSetup();
+
+    /**
+     * @brief Check if the request is still being set up and the client has sent nothing since
+     *
+     * Another request from the client in this state is a retransmission. Once
+     * the client has answered a reply, its next request starts a new transfer
+     * even if the answer is still waiting for setup to finish.
+     * @return true until setUp() has returned or a packet arrived
+     */
+    bool isRequestPending() const;
+
+    /**
+     * @brief Set up the transfer: start the worker, validate, open the file and send the first reply
+     *
+     * Runs on a setup pool thread, or on the listener when the pool is disabled.
+     * An invalid request only starts the worker.
+     * @param packet Read or write request
+     */
+    void setUp(const TftpRequestPacket& packet);
+
+    /**
+     * @brief Enter CONNECTED and start the worker thread
+     *
+     * Called with mutex_ held.
+     */
+    void startWorker();
+
+    /**
+     * @brief Refuse the request without setting it up, ending the connection
+     *
+     * Used when the setup pool cannot take the request. Sends an ERROR with
+     * code 0 and the message.
+     * @param message Error message for the client
+     */
+    void reject(const std::string& message);
+
+    /**
+     * @brief Handle the packets deferred during setup and clear the setup flag
+     *
+     * Called with mutex_ held.
+     */
+    void endSetup();
+
+    /**
+     * @brief Decode a DATA, ACK or ERROR packet and pass it to its handler
+     *
+     * Called with mutex_ held.
+     * @param packet_data Raw packet data
+     * @param packet_size Size of packet data
+     */
+    void dispatchPacket(const uint8_t* packet_data, size_t packet_size);
+
     /**
      * @brief Handle read request
      * @param packet Read request packet
@@ -316,15 +570,32 @@ private:
 
     /**
      * @brief Handle data packet
-     * @param packet Data packet
+     * @param packet Decoded DATA (payload borrows the receive buffer)
      */
-    void handleDataPacket(const TftpDataPacket& packet);
+    void handleDataPacket(const TftpDataView& packet);
+
+    /**
+     * @brief Convert, check and queue the payload of the next block of a write transfer
+     *
+     * Sends an error and returns false if the block breaks a size limit or
+     * cannot be written.
+     * @param payload Block payload as received
+     * @param write_now Write it now instead of adding it to write_run_
+     * @return true if the block was accepted
+     */
+    bool acceptDataBlock(ByteView payload, bool write_now);
+
+    /**
+     * @brief Write the blocks queued in write_run_ to the file
+     * @return true if written; an error has been sent otherwise
+     */
+    bool flushWriteRun();
 
     /**
      * @brief Handle acknowledgment packet
-     * @param packet Acknowledgment packet
+     * @param packet Decoded ACK
      */
-    void handleAckPacket(const TftpAckPacket& packet);
+    void handleAckPacket(const TftpAckView& packet);
 
     /**
      * @brief Handle error packet
@@ -362,10 +633,10 @@ private:
 
     /**
      * @brief Open file for reading
-     * @param filename Filename to open
+     * @param requested Filename as requested by the client
      * @return true if opened successfully, false otherwise
      */
-    bool openReadFile(const std::string& filename);
+    bool openReadFile(const std::string& requested);
 
     /**
      * @brief Open file for writing
@@ -379,6 +650,24 @@ private:
      */
     void closeFiles();
 
+    /**
+     * @brief Get the served root handle for this transfer
+     *
+     * Uses the server's handle when it serves the configured root, otherwise
+     * (server not started, or mid reload) opens one for this transfer.
+     * @return Handle, possibly not open if the root is missing
+     */
+    const TftpRootHandle& rootHandle();
+
+    /**
+     * @brief Apply the configured remap rules to a requested filename
+     * @param requested Filename from the request
+     * @param for_write Whether this is a write request
+     * @param filename Receives the name to serve
+     * @return false if a rule denies the request
+     */
+    bool remapFilename(const std::string& requested, bool for_write, std::string& filename);
+
     /**
      * @brief Validate file access
      * @param filename Filename to validate
@@ -412,7 +701,131 @@ private:
      */
     void logEvent(LogLevel level, const std::string& message);
 
+    /**
+     * @brief Record acknowledged/written payload bytes for telemetry
+     * @param bytes Number of payload bytes
+     */
+    void recordProgress(size_t bytes);
+
+    /**
+     * @brief Fold a round-trip sample into the smoothed RTT estimate
+     * @param sample Measured round-trip time
+     */
+    void recordRttSample(std::chrono::steady_clock::duration sample);
+
+    /**
+     * @brief Update the throughput EWMA (called from the worker tick)
+     * @param now Current time
+     */
+    void sampleThroughput(std::chrono::steady_clock::time_point now);
+
     bool applyRequestOptions(const TftpOptions& request_options, bool is_read_request);
+
+    /**
+     * @brief Hand an RRQ with the RFC 2090 multicast option to the server's group sessions
+     * @param request_options Options from the client's RRQ
+     * @return true if the client joined a group, false to continue with unicast
+     */
+    bool joinMulticastGroup(const TftpOptions& request_options);
+
+    /**
+     * @brief Serve the read transfer from the server's block cache if possible
+     *
+     * Must run after option negotiation; falls back to per-block file reads
+     * when the cache is disabled or the file does not fit.
+     */
+    void attachCachedStream();
+
+    /**
+     * @brief Prepare the netascii form of the opened file and its exact size
+     *
+     * Converts the file once per version through the server's netascii cache
+     * so tsize advertises the converted length. When the cache is disabled or
+     * too small, counts the converted length in a streaming pass instead.
+     */
+    void prepareNetasciiStream();
+
+    /**
+     * @brief Build the cache identity of the opened read file
+     * @param block_size Block size component (0 for whole-stream entries)
+     * @param key Receives the key
+     * @return false if the file's modification time is unavailable
+     */
+    bool makeCacheKey(uint16_t block_size, TftpBlockCacheKey& key) const;
+
+    /**
+     * @brief Read the next uncached netascii block of exactly the negotiated size
+     * @param payload Receives the converted bytes
+     * @return false on a read error
+     */
+    bool readNetasciiBlock(std::vector<uint8_t>& payload);
+
+    /**
+     * @brief Open the compressed copy of a file missing from the root directory
+     * @param filename Requested filename
+     * @return true if a compressed copy was opened
+     */
+    bool openCompressedFile(const std::string& filename);
+
+    /**
+     * @brief Serve the file from an origin download
+     * @param fetch Download shared with other requests
+     * @return false if the download failed before its size was known or the file is too large
+     */
+    bool openOriginFetch(std::shared_ptr<const TftpOriginFetch> fetch);
+
+    /**
+     * @brief Read the next bytes of the opened file, decompressed if needed
+     * @param out Destination
+     * @param size Bytes wanted
+     * @return Bytes read (fewer than @p size only at the end), -1 on a read error
+     */
+    std::streamsize readSource(uint8_t* out, size_t size);
+
+    /**
+     * @brief Read bytes of the opened plain file at an offset, leaving the read position alone
+     * @param offset Position in the file
+     * @param out Destination
+     * @param size Bytes wanted
+     * @return Bytes read (fewer than @p size only at the end), -1 on a read error
+     */
+    std::streamsize readSourceAt(uint64_t offset, uint8_t* out, size_t size);
+
+    /**
+     * @brief Check if readSource() copies from the server's shared content cache
+     * @return true for files in the root when the server has a shared cache
+     */
+    bool readsThroughSharedCache() const;
+
+    /**
+     * @brief readSource() for the shared content cache, filling missing chunks from the file
+     * @param cache Cache shared with the other workers
+     * @param out Destination
+     * @param size Bytes wanted
+     * @return Bytes read (fewer than @p size only at the end), -1 on a read error
+     */
+    std::streamsize readSharedSource(TftpSharedContentCache& cache, uint8_t* out, size_t size);
+
+    /**
+     * @brief Open read_file_ if openReadFile() deferred it
+     * @return true if read_file_ is open
+     */
+    bool openPendingReadFile();
+
+    /**
+     * @brief Restart the opened file from the beginning
+     * @return true on success
+     */
+    bool rewindSource();
+
+    /**
+     * @brief Stream the whole file through an independent reader
+     *
+     * Used by the cache loaders so the transfer's own reader keeps its position.
+     * @param sink Receives each chunk in order
+     * @return true if exactly read_file_size_ bytes were delivered
+     */
+    bool readWholeSource(const std::function<void(ByteView)>& sink) const;
 };
 
 } // namespace simple_tftpd
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Change notifications for directories of the served tree
+ *
+ * Uses inotify on Linux; elsewhere start() fails and callers fall back to
+ * their own expiry. Watches are per directory (not recursive) and are added
+ * on demand by the caches that need them.
+ */
+class TftpDirectoryWatcher {
+public:
+    /**
+     * @brief Change callback
+     *
+     * Called from the watcher thread with the watched directory and the
+     * entry name inside it. An empty name means the directory itself
+     * changed; an empty directory means events were lost and everything
+     * must be considered changed.
+     */
+    using Listener = std::function<void(const std::string& directory, const std::string& name)>;
+
+    TftpDirectoryWatcher();
+
+    /**
+     * @brief Destructor, stops the watcher thread
+     */
+    ~TftpDirectoryWatcher();
+
+    TftpDirectoryWatcher(const TftpDirectoryWatcher&) = delete;
+    TftpDirectoryWatcher& operator=(const TftpDirectoryWatcher&) = delete;
+
+    /**
+     * @brief Start delivering notifications
+     * @return false if change notifications are unavailable
+     */
+    bool start();
+
+    /**
+     * @brief Stop the watcher thread and drop all watches
+     */
+    void stop();
+
+    /**
+     * @brief Check if notifications are being delivered
+     */
+    bool isActive() const { return running_.load(); }
+
+    /**
+     * @brief Register a change callback (before start)
+     * @param listener Callback for every change
+     */
+    void addListener(Listener listener);
+
+    /**
+     * @brief Watch a directory, or its nearest existing ancestor
+     * @param directory Directory whose entries should be watched
+     * @param stop_at Do not climb above this directory
+     * @return Directory actually watched, empty if none could be
+     */
+    std::string watch(const std::string& directory, const std::string& stop_at);
+
+    /**
+     * @brief Number of directories being watched
+     */
+    size_t watchCount() const;
+
+    /**
+     * @brief Number of change events delivered
+     */
+    uint64_t eventCount() const { return events_.load(std::memory_order_relaxed); }
+
+private:
+    int fd_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> events_;
+    std::thread thread_;
+    std::vector<Listener> listeners_;
+
+    std::map<int, std::string> directories_;  // Watch descriptor to path
+    std::map<std::string, int> watches_;      // Path to watch descriptor
+    mutable std::mutex mutex_;
+
+    void run();
+    void notify(const std::string& directory, const std::string& name);
+};
+
+} // namespace simple_tftpd
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/tftp/directory_watcher.hpp"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Filename index counters
+ */
+struct TftpFilenameIndexStats {
+    uint64_t files = 0;
+    uint64_t directories = 0;
+    uint64_t unwatched_directories = 0;  ///< Directories whose changes will not be seen
+    uint64_t lookups = 0;
+    uint64_t resolved = 0;
+    uint64_t updates = 0;                ///< Change notifications applied
+    uint64_t builds = 0;
+    uint64_t build_time_ms = 0;          ///< Duration of the last build
+};
+
+/**
+ * @brief Case-insensitive map from requested names to stored files
+ *
+ * Windows Deployment Services clients and some firmware ask for names like
+ * "Boot\x64\wdsnbp.com" in whatever case they please. The served tree is
+ * indexed by case-folded, slash-normalized relative path so such a request
+ * resolves with one hash probe. The tree is scanned in parallel by build()
+ * and kept current from change notifications; without them it reflects the
+ * tree as of the last build.
+ */
+class TftpFilenameIndex {
+public:
+    /**
+     * @brief Constructor
+     * @param watcher Change notifications, may be null (no incremental updates)
+     */
+    explicit TftpFilenameIndex(TftpDirectoryWatcher* watcher);
+
+    /**
+     * @brief Scan a tree, replacing the current index once complete
+     * @param root Served root directory
+     * @param threads Scanning threads, 0 for one per core (at most 8)
+     * @return Number of files indexed
+     */
+    size_t build(const std::string& root, size_t threads = 0);
+
+    /**
+     * @brief Drop the index; resolve() fails until the next build
+     */
+    void clear();
+
+    /**
+     * @brief Check if a build() has completed since the last clear()
+     */
+    bool isBuilt() const;
+
+    /**
+     * @brief Find the stored file for a requested name
+     *
+     * If several stored names differ only in case, the one spelled exactly
+     * as requested wins, otherwise the first in byte order.
+     *
+     * @param filename Requested name, any case, '/' or '\' separated
+     * @param resolved Receives the stored path relative to the root
+     * @return false if no stored file matches
+     */
+    bool resolve(const std::string& filename, std::string& resolved);
+
+    /**
+     * @brief Get index counters
+     * @return Filename index statistics
+     */
+    TftpFilenameIndexStats getStats() const;
+
+    /**
+     * @brief Normalize separators of a relative name
+     * @param filename Name with '/' or '\' separators, possibly "." and empty segments
+     * @return '/'-separated name without leading, doubled or "." segments
+     */
+    static std::string normalizeName(const std::string& filename);
+
+    /**
+     * @brief Index key of a relative name
+     * @param filename Name as requested or stored
+     * @return normalizeName() with ASCII letters lowercased
+     */
+    static std::string fold(const std::string& filename);
+
+private:
+    using FileMap = std::unordered_map<std::string, std::vector<std::string>>;
+
+    struct Scan {
+        std::vector<std::pair<std::string, std::string>> files;  // Folded and stored name
+        std::vector<std::string> directories;
+        uint64_t unwatched = 0;
+    };
+
+    TftpDirectoryWatcher* watcher_;
+    std::string root_;  // Normalized absolute root, empty when not built
+    bool building_;
+    std::vector<std::string> pending_;  // Changes seen while building, replayed after
+
+    // Folded name to stored names (more than one only when names differ in case)
+    FileMap files_;
+    std::unordered_set<std::string> directories_;
+    TftpFilenameIndexStats stats_;
+    mutable std::mutex mutex_;
+
+    void onChange(const std::string& directory, const std::string& name);
+    void refresh(const std::string& relative);
+    void listDirectory(const std::string& root, const std::string& relative, Scan& scan,
+                       std::vector<std::string>& subdirectories) const;
+    void mergeLocked(const Scan& scan);
+    void addFileLocked(const std::string& key, const std::string& relative);
+    void removeLocked(const std::string& relative);
+
+    static bool insertName(FileMap& files, const std::string& key, const std::string& relative);
+    static std::string lowercase(std::string name);
+};
+
+} // namespace simple_tftpd
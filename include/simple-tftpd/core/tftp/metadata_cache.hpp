@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/tftp/directory_watcher.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Metadata cache counters
+ */
+struct TftpMetadataCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t invalidations = 0;
+    uint64_t evictions = 0;
+    uint64_t entries = 0;
+    uint64_t stat_calls = 0;   ///< Filesystem stat() calls made for lookups
+    uint64_t file_opens = 0;   ///< Files opened by transfers (reported by connections)
+
+    /**
+     * @brief Fraction of lookups answered from the cache
+     * @return Ratio in [0, 1], 0 before any lookup
+     */
+    double hitRatio() const {
+        uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+    }
+};
+
+/**
+ * @brief Stat results for existing files, kept coherent by change notifications
+ *
+ * Entries are only kept while the file's directory is watched, so any
+ * change to the file drops its entry; without notifications every lookup
+ * goes to the filesystem. Files are examined through the root handle, so
+ * the cache never describes anything an open would refuse. Missing files
+ * are left to TftpNegativeCache.
+ */
+class TftpMetadataCache {
+public:
+    /**
+     * @brief Constructor
+     * @param max_entries Size bound, 0 disables caching
+     * @param watcher Change notifications, may be null (no caching)
+     */
+    TftpMetadataCache(size_t max_entries, TftpDirectoryWatcher* watcher);
+
+    /**
+     * @brief Change the size bound, dropping the oldest entries as needed
+     * @param max_entries Size bound, 0 disables caching
+     */
+    void setMaxEntries(size_t max_entries);
+
+    /**
+     * @brief Get the metadata of an existing file
+     * @param root Served root; the file is examined beneath it and directory watches never climb above it
+     * @param relative Name below the root
+     * @param metadata Receives the metadata
+     * @return false if the file does not exist, lies outside the root or cannot be examined
+     */
+    bool lookup(const TftpRootHandle& root, const std::string& relative, TftpFileMetadata& metadata);
+
+    /**
+     * @brief Forget a path and everything below it
+     * @param path Full path that changed
+     */
+    void invalidate(const std::string& path);
+
+    /**
+     * @brief Drop all entries
+     */
+    void clear();
+
+    /**
+     * @brief Account a file opened for a transfer
+     */
+    void recordOpen() { file_opens_.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Get cache counters
+     * @return Metadata cache statistics
+     */
+    TftpMetadataCacheStats getStats() const;
+
+private:
+    struct Entry {
+        TftpFileMetadata metadata;
+        std::list<std::string>::iterator order;
+    };
+
+    size_t max_entries_;
+    TftpDirectoryWatcher* watcher_;
+
+    std::map<std::string, Entry> entries_;
+    std::list<std::string> order_;  // Oldest insertion first
+    TftpMetadataCacheStats stats_;
+    uint64_t generation_;           // Bumped by every invalidation
+    std::atomic<uint64_t> file_opens_;
+    mutable std::mutex mutex_;
+
+    void eraseLocked(std::map<std::string, Entry>::iterator it);
+    void invalidateLocked(const std::string& path);
+};
+
+} // namespace simple_tftpd
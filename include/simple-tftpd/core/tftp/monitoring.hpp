@@ -166,6 +166,17 @@ public:
      */
     void updateActiveConnections(size_t count);
     
+    /**
+     * @brief Add another process's metrics to these
+     *
+     * Used by the prefork supervisor to present its workers as one server.
+     * Counters are summed, the average transfer time is weighted by transfer
+     * counts, peaks are summed (an upper bound, as workers peak at different
+     * times) and the earlier start time is kept.
+     * @param other Metrics of one worker
+     */
+    void mergeMetrics(const ServerMetrics& other);
+    
     /**
      * @brief Get metrics as JSON string
      * @return JSON representation of metrics
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include "simple-tftpd/core/utils/logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Multicast transfer counters
+ */
+struct TftpMulticastStats {
+    uint64_t sessions_created = 0;
+    uint64_t clients_joined = 0;
+    uint64_t clients_completed = 0;
+    uint64_t blocks_sent = 0;
+    uint64_t bytes_sent = 0;
+};
+
+/**
+ * @brief Parameters shared by every client of one multicast session
+ */
+struct TftpMulticastSessionConfig {
+    std::string path;
+    std::string name;                            // Below the root, for opening through root
+    std::shared_ptr<const TftpRootHandle> root;  // Null to open path directly
+    uint64_t file_size = 0;
+    uint16_t block_size = 512;
+    std::chrono::seconds timeout{5};
+    int max_retries = 5;
+    std::string group_address;
+    port_t group_port = 0;
+    uint8_t ttl = 1;
+    std::string interface_address;
+};
+
+/**
+ * @brief One file streamed to a multicast group (RFC 2090)
+ *
+ * The session owns a socket whose port is the server TID for all of its
+ * clients. DATA goes to the group once, paced by the master client's ACKs;
+ * the other clients listen. When the master has the whole file it leaves,
+ * the next client is promoted with an OACK (mc=1) and re-requests the
+ * blocks it missed, so late joiners catch up from the same stream.
+ */
+class TftpMulticastSession {
+public:
+    /**
+     * @brief Constructor
+     * @param config Session parameters
+     * @param logger Logger instance
+     */
+    TftpMulticastSession(TftpMulticastSessionConfig config, std::shared_ptr<Logger> logger);
+
+    /**
+     * @brief Destructor
+     */
+    ~TftpMulticastSession();
+
+    TftpMulticastSession(const TftpMulticastSession&) = delete;
+    TftpMulticastSession& operator=(const TftpMulticastSession&) = delete;
+
+    /**
+     * @brief Open the file and session socket and start the worker thread
+     * @return true if started successfully, false otherwise
+     */
+    bool start();
+
+    /**
+     * @brief Stop the worker thread and release the socket
+     */
+    void stop();
+
+    /**
+     * @brief Add a client and send it the OACK
+     * @param client_addr Client IPv4 address
+     * @param client_port Client port
+     * @param request_options Options from the client's RRQ
+     * @return true if joined, false if the session is shutting down
+     */
+    bool addClient(const std::string& client_addr, port_t client_port, const TftpOptions& request_options);
+
+    /**
+     * @brief Check if the session has served all its clients
+     * @return true once the last client left
+     */
+    bool isFinished() const;
+
+    /**
+     * @brief Get session parameters
+     * @return Session configuration
+     */
+    const TftpMulticastSessionConfig& getConfig() const;
+
+    /**
+     * @brief Get number of clients in the group
+     * @return Client count
+     */
+    size_t getClientCount() const;
+
+    /**
+     * @brief Get port of the session socket (the server TID)
+     * @return Local port, 0 before start()
+     */
+    port_t getLocalPort() const;
+
+    /**
+     * @brief Get session counters
+     * @return Session statistics
+     */
+    TftpMulticastStats getStats() const;
+
+private:
+    struct Client {
+        struct sockaddr_in address;
+        std::string key;
+        TftpOptions request_options;
+    };
+
+    TftpMulticastSessionConfig config_;
+    std::shared_ptr<Logger> logger_;
+
+    socket_t socket_;
+    port_t local_port_;
+    struct sockaddr_in group_addr_;
+    TftpFileHandle file_;
+    uint64_t total_blocks_;
+    std::vector<uint8_t> tx_buffer_;
+
+    std::thread worker_thread_;
+    std::atomic<bool> active_;
+    bool finished_;
+    mutable std::mutex mutex_;
+
+    /** Front entry is the master client */
+    std::deque<Client> clients_;
+    bool master_acked_;
+    uint64_t current_block_;
+    int retry_count_;
+    std::chrono::steady_clock::time_point last_send_;
+
+    TftpMulticastStats stats_;
+
+    void workerThread();
+    void handleDatagram(const uint8_t* data, size_t size, const struct sockaddr_in& sender);
+    void handleMasterAck(uint16_t block);
+    void handleTimeoutTick();
+    void promoteNextMaster();
+    void removeClient(size_t index, bool completed);
+    bool sendOptionAck(const Client& client, bool master);
+    bool sendBlock(uint64_t block);
+    bool sendTo(const uint8_t* data, size_t size, const struct sockaddr_in& address);
+    uint64_t unwrapBlock(uint16_t block) const;
+    void logEvent(LogLevel level, const std::string& message);
+};
+
+/**
+ * @brief Shares multicast sessions between clients requesting the same file
+ *
+ * Each concurrent session gets its own group port from the configured
+ * range, so egress grows with the number of distinct files, not clients.
+ */
+class TftpMulticastManager {
+public:
+    /**
+     * @brief Constructor
+     * @param config Server configuration
+     * @param logger Logger instance
+     */
+    TftpMulticastManager(std::shared_ptr<TftpConfig> config, std::shared_ptr<Logger> logger);
+
+    /**
+     * @brief Destructor
+     */
+    ~TftpMulticastManager();
+
+    /**
+     * @brief Join a client to the session for a file, creating it if needed
+     * @param client_addr Client address (IPv4 or IPv4-mapped IPv6)
+     * @param client_port Client port
+     * @param path Full path of the validated file
+     * @param file_size File size in bytes
+     * @param block_size Negotiated block size
+     * @param request_options Options from the client's RRQ
+     * @param root Served root to open the file beneath, null to open path directly
+     * @param name Name of the file below root
+     * @return true if joined, false if the caller should fall back to unicast
+     */
+    bool join(const std::string& client_addr, port_t client_port, const std::string& path,
+              uint64_t file_size, uint16_t block_size, const TftpOptions& request_options,
+              std::shared_ptr<const TftpRootHandle> root = nullptr, const std::string& name = "");
+
+    /**
+     * @brief Use a reloaded configuration for new sessions
+     * @param config Server configuration
+     */
+    void setConfig(std::shared_ptr<TftpConfig> config);
+
+    /**
+     * @brief Stop and drop finished sessions
+     */
+    void cleanup();
+
+    /**
+     * @brief Stop all sessions
+     */
+    void stopAll();
+
+    /**
+     * @brief Get number of live sessions
+     * @return Session count
+     */
+    size_t getSessionCount() const;
+
+    /**
+     * @brief Get counters summed over live and finished sessions
+     * @return Multicast statistics
+     */
+    TftpMulticastStats getStats() const;
+
+private:
+    using SessionKey = std::pair<std::string, uint16_t>;
+
+    std::shared_ptr<TftpConfig> config_;
+    std::shared_ptr<Logger> logger_;
+
+    std::map<SessionKey, std::shared_ptr<TftpMulticastSession>> sessions_;
+    /** Session creations plus counters of sessions already stopped */
+    TftpMulticastStats retired_stats_;
+    mutable std::mutex mutex_;
+
+    bool allocateGroupPort(port_t& port) const;
+    void retire(const std::shared_ptr<TftpMulticastSession>& session);
+};
+
+} // namespace simple_tftpd
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/tftp/directory_watcher.hpp"
+#include <chrono>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Negative cache counters
+ */
+struct TftpNegativeCacheStats {
+    uint64_t hits = 0;            ///< Requests answered as missing without touching the filesystem
+    uint64_t misses = 0;          ///< Lookups that had to go to the filesystem
+    uint64_t insertions = 0;
+    uint64_t evictions = 0;       ///< Entries dropped to stay within the size bound
+    uint64_t expirations = 0;     ///< Entries dropped because their TTL ran out
+    uint64_t invalidations = 0;   ///< Entries dropped by change notifications or writes
+    uint64_t syscalls_saved = 0;  ///< Filesystem probes the hits did not repeat
+    uint64_t entries = 0;
+
+    /**
+     * @brief Fraction of lookups answered from the cache
+     * @return Ratio in [0, 1], 0 before any lookup
+     */
+    double hitRatio() const {
+        uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+    }
+};
+
+/**
+ * @brief Bounded TTL cache of paths known not to exist
+ *
+ * Boot clients probe many names that are never there (PXELINUX walks
+ * pxelinux.cfg/01-<mac> and hex IP prefixes down to "default"). Remembered
+ * misses are answered without filesystem access until they expire, the
+ * size bound pushes out the oldest entry, or a change notification for the
+ * watched directory (or an upload) drops them.
+ */
+class TftpNegativeCache {
+public:
+    /**
+     * @brief Constructor
+     * @param max_entries Size bound, 0 disables the cache
+     * @param ttl Lifetime of an entry
+     * @param watcher Change notifications, may be null (TTL only)
+     */
+    TftpNegativeCache(size_t max_entries, std::chrono::milliseconds ttl, TftpDirectoryWatcher* watcher);
+
+    /**
+     * @brief Change the bounds, dropping entries as needed
+     * @param max_entries Size bound, 0 disables the cache
+     * @param ttl Lifetime of later entries
+     */
+    void setLimits(size_t max_entries, std::chrono::milliseconds ttl);
+
+    /**
+     * @brief Check if a path is known to be missing
+     * @param path Full path of the requested file
+     * @return true if the request can be answered FILE_NOT_FOUND right away
+     */
+    bool contains(const std::string& path);
+
+    /**
+     * @brief Current invalidation generation, taken before probing the filesystem
+     * @return Value to pass to insert()
+     */
+    uint64_t generation() const;
+
+    /**
+     * @brief Remember a missing path
+     *
+     * Skipped if anything was invalidated since @p generation was taken, as
+     * the file may have been created after the probe.
+     *
+     * @param path Full path that was not found
+     * @param root Served root; directory watches never climb above it
+     * @param probes Filesystem calls the miss cost, credited on each hit
+     * @param generation Result of generation() before the probe
+     */
+    void insert(const std::string& path, const std::string& root, uint32_t probes, uint64_t generation);
+
+    /**
+     * @brief Forget a path and everything below it
+     * @param path Full path that may now exist
+     */
+    void invalidate(const std::string& path);
+
+    /**
+     * @brief Drop all entries
+     */
+    void clear();
+
+    /**
+     * @brief Get cache counters
+     * @return Negative cache statistics
+     */
+    TftpNegativeCacheStats getStats() const;
+
+    /**
+     * @brief Normalize a path for use as a key
+     * @param path Path with possible "//" and "/./" segments
+     * @return Path with single separators and no "." segments
+     */
+    static std::string normalize(const std::string& path);
+
+private:
+    struct Entry {
+        std::chrono::steady_clock::time_point expires;
+        uint32_t probes = 0;
+        std::list<std::string>::iterator order;
+    };
+
+    size_t max_entries_;
+    std::chrono::milliseconds ttl_;
+    TftpDirectoryWatcher* watcher_;
+
+    std::map<std::string, Entry> entries_;
+    std::list<std::string> order_;  // Oldest insertion first
+    TftpNegativeCacheStats stats_;
+    uint64_t generation_;  // Bumped by every invalidation
+    mutable std::mutex mutex_;
+
+    void eraseLocked(std::map<std::string, Entry>::iterator it);
+    void invalidateLocked(const std::string& path);
+};
+
+} // namespace simple_tftpd
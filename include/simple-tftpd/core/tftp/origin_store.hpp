@@ -0,0 +1,273 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Origin pull counters
+ */
+struct TftpOriginStats {
+    uint64_t fetches = 0;        ///< Downloads started (misses and changed files)
+    uint64_t joined = 0;         ///< Requests that shared a download already in flight
+    uint64_t revalidations = 0;  ///< Conditional requests for files held locally
+    uint64_t not_modified = 0;   ///< Revalidations answered 304
+    uint64_t not_found = 0;      ///< Files the origin does not have
+    uint64_t errors = 0;         ///< Unreachable origin, bad responses and aborted downloads
+    uint64_t bytes_fetched = 0;  ///< Body bytes received
+    uint64_t in_flight = 0;      ///< Downloads currently running
+};
+
+class TftpOriginStore;
+
+/**
+ * @brief One download from the origin, shared by every request for the file
+ *
+ * The body is written to a hidden temporary file beside the target as it
+ * arrives, and readers follow the write position, so a transfer can send
+ * its first block as soon as the origin sends the first bytes. The file is
+ * renamed into place once complete.
+ */
+class TftpOriginFetch {
+public:
+    ~TftpOriginFetch();
+
+    TftpOriginFetch(const TftpOriginFetch&) = delete;
+    TftpOriginFetch& operator=(const TftpOriginFetch&) = delete;
+
+    /**
+     * @brief Get the file size
+     *
+     * Known from Content-Length at once; chunked responses have to finish first.
+     * @param size Receives the size in bytes
+     * @return false if the download failed before the size was known
+     */
+    bool waitForSize(uint64_t& size) const;
+
+    /**
+     * @brief Read downloaded bytes, waiting for them to arrive
+     * @param offset Offset in the file
+     * @param out Destination
+     * @param size Bytes wanted
+     * @return Bytes read, short only at the end of the file, or -1 if the download failed or stalled
+     */
+    int64_t readAt(uint64_t offset, uint8_t* out, size_t size) const;
+
+    /**
+     * @brief Check if the whole file was received and stored
+     */
+    bool complete() const;
+
+    /**
+     * @brief Name of the file below the root
+     */
+    const std::string& name() const { return name_; }
+
+private:
+    friend class TftpOriginStore;
+
+    TftpOriginFetch(std::string name, std::chrono::seconds stall_timeout);
+
+    std::string name_;
+    std::chrono::seconds stall_timeout_;
+    TftpFileHandle data_;  // Read side of the temporary file
+    socket_t socket_;
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable progress_;
+    uint64_t received_;
+    uint64_t size_;
+    bool size_known_;
+    bool complete_;
+    bool failed_;
+    bool missing_;  // The origin answered 404; set with failed_
+};
+
+/**
+ * @brief Sequential reader over an origin download
+ */
+class TftpOriginReader {
+public:
+    explicit TftpOriginReader(std::shared_ptr<const TftpOriginFetch> fetch) : fetch_(std::move(fetch)), offset_(0) {}
+
+    /**
+     * @brief Read the next bytes, waiting for the download where needed
+     * @return Bytes read, short only at the end of the file, or -1 on failure
+     */
+    int64_t read(uint8_t* out, size_t size);
+
+    /**
+     * @brief Restart from the beginning of the file
+     */
+    void rewind() { offset_ = 0; }
+
+    const std::shared_ptr<const TftpOriginFetch>& fetch() const { return fetch_; }
+
+private:
+    std::shared_ptr<const TftpOriginFetch> fetch_;
+    uint64_t offset_;
+};
+
+/**
+ * @brief Edge cache filled on demand from an HTTP origin
+ *
+ * With filesystem.origin_url set, the root directory is a partial copy of
+ * the origin. A file missing locally is requested from the origin and
+ * streamed to the requesting transfer while it is written to the root;
+ * concurrent requests for the same file share one download. Files held
+ * locally are revalidated with If-None-Match / If-Modified-Since once per
+ * revalidation interval, and a changed file is downloaded again and
+ * replaces the old copy when complete. Stored files carry the origin's
+ * Last-Modified time, so revalidation survives restarts. When the origin
+ * is unreachable the local copy is served as is.
+ *
+ * Only plain http:// origins are supported.
+ */
+class TftpOriginStore {
+public:
+    /**
+     * @brief Outcome of a lookup
+     */
+    enum class Result {
+        FRESH,      ///< Serve the local copy
+        FETCHING,   ///< Serve from the returned download
+        NOT_FOUND,  ///< Neither the root nor the origin has the file
+        TOO_LARGE,  ///< The origin's copy exceeds transfer.max_file_size
+        FAILED      ///< The origin could not be asked; serve the local copy if there is one
+    };
+
+    /**
+     * @brief Constructor
+     * @param config Server configuration
+     */
+    explicit TftpOriginStore(std::shared_ptr<TftpConfig> config);
+
+    /**
+     * @brief Destructor; aborts running downloads and waits for them
+     */
+    ~TftpOriginStore();
+
+    TftpOriginStore(const TftpOriginStore&) = delete;
+    TftpOriginStore& operator=(const TftpOriginStore&) = delete;
+
+    /**
+     * @brief Use a reloaded configuration; remembered validators are dropped if the origin changed
+     * @param config Server configuration
+     */
+    void setConfig(std::shared_ptr<TftpConfig> config);
+
+    /**
+     * @brief Set the function told about each file stored in the root
+     * @param callback Receives the full path of the stored file
+     */
+    void setStoredCallback(std::function<void(const std::string&)> callback);
+
+    /**
+     * @brief Check if an origin is configured
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief Look up a file missing from the root
+     * @param root Served root the file is stored beneath
+     * @param name Name below the root
+     * @param fetch Receives the download for FETCHING
+     * @return FETCHING, NOT_FOUND, TOO_LARGE or FAILED
+     */
+    Result fetch(const std::shared_ptr<const TftpRootHandle>& root, const std::string& name,
+                 std::shared_ptr<const TftpOriginFetch>& fetch);
+
+    /**
+     * @brief Check a file held locally against the origin if its revalidation is due
+     * @param root Served root the file is stored beneath
+     * @param name Name below the root
+     * @param modified Modification time of the local copy (ns since the epoch)
+     * @param fetch Receives the download for FETCHING
+     * @return FRESH, FETCHING, TOO_LARGE or FAILED
+     */
+    Result revalidate(const std::shared_ptr<const TftpRootHandle>& root, const std::string& name, int64_t modified,
+                      std::shared_ptr<const TftpOriginFetch>& fetch);
+
+    /**
+     * @brief Stream a file from another cluster node without keeping it
+     *
+     * Works like fetch() against the peer's base URL, but the temporary
+     * file is removed when the download ends, so the file stays cached
+     * only on the node that owns it. Runs whether or not an origin is set.
+     * @param peer Base URL of the owning node
+     * @param root Served root the temporary file is written beneath
+     * @param name Name below the root
+     * @param fetch Receives the download for FETCHING
+     * @return FETCHING, NOT_FOUND, TOO_LARGE or FAILED
+     */
+    Result fetchFromPeer(const std::string& peer, const std::shared_ptr<const TftpRootHandle>& root,
+                         const std::string& name, std::shared_ptr<const TftpOriginFetch>& fetch);
+
+    /**
+     * @brief Get origin counters
+     */
+    TftpOriginStats getStats() const;
+
+private:
+    struct Validator {
+        std::string etag;
+        std::string last_modified;
+        std::chrono::steady_clock::time_point checked;
+    };
+
+    struct Response;
+
+    std::shared_ptr<TftpConfig> config_;
+    std::string origin_;  // URL the validators were learnt from
+    std::function<void(const std::string&)> stored_callback_;
+    std::map<std::string, Validator> validators_;
+    std::map<std::string, std::shared_ptr<TftpOriginFetch>> in_flight_;
+    mutable std::mutex mutex_;
+    std::condition_variable idle_;
+    bool stopping_;
+    uint32_t temporary_counter_;
+
+    std::atomic<uint64_t> fetches_;
+    std::atomic<uint64_t> joined_;
+    std::atomic<uint64_t> revalidations_;
+    std::atomic<uint64_t> not_modified_;
+    std::atomic<uint64_t> not_found_;
+    std::atomic<uint64_t> errors_;
+    std::atomic<uint64_t> bytes_fetched_;
+
+    Result request(const std::shared_ptr<const TftpRootHandle>& root, const std::string& name, bool cached,
+                   int64_t modified, const std::string& peer, std::shared_ptr<const TftpOriginFetch>& fetch);
+    bool startDownload(const std::shared_ptr<const TftpRootHandle>& root, const std::string& name,
+                       std::unique_ptr<Response> response, bool keep, std::shared_ptr<TftpOriginFetch>& fetch);
+    void download(std::shared_ptr<TftpOriginFetch> fetch, std::shared_ptr<const TftpRootHandle> root,
+                  std::unique_ptr<Response> response, TftpFileHandle file, std::string temporary, bool keep);
+    void finishDownload(const std::shared_ptr<TftpOriginFetch>& fetch, bool stored);
+};
+
+} // namespace simple_tftpd
@@ -28,6 +28,9 @@ namespace simple_tftpd {
  * 
  * Provides common functionality for all TFTP packet types.
  * TFTP packets are simple UDP packets with a specific format.
+ *
+ * The packet classes are an owning convenience layer over TftpCodec
+ * (codec.hpp); per-packet server paths use the codec views directly.
  */
 class TftpPacket {
 public:
@@ -220,7 +223,7 @@ public:
 
 private:
     std::string filename_;
-    TftpMode mode_;
+    TftpMode mode_ = TftpMode::OCTET;
     TftpOptions options_;
     
     /**
@@ -231,12 +234,6 @@ private:
      * @return true if options parsed successfully, false otherwise
      */
     bool parseOptions(const uint8_t* data, size_t offset, size_t size);
-    
-    /**
-     * @brief Serialize options to raw data
-     * @param data Vector to append serialized options to
-     */
-    void serializeOptions(std::vector<uint8_t>& data) const;
 };
 
 /**
@@ -311,22 +308,8 @@ public:
     std::string getTypeString() const override;
 
 private:
-    uint16_t block_number_;
+    uint16_t block_number_ = 0;
     std::vector<uint8_t> file_data_;
-    
-    /**
-     * @brief Parse block number from raw data
-     * @param data Raw packet data
-     * @param offset Offset to start parsing from
-     * @return true if block number parsed successfully, false otherwise
-     */
-    bool parseBlockNumber(const uint8_t* data, size_t offset);
-    
-    /**
-     * @brief Serialize block number to raw data
-     * @param data Vector to append serialized block number to
-     */
-    void serializeBlockNumber(std::vector<uint8_t>& data) const;
 };
 
 /**
@@ -388,21 +371,7 @@ public:
     std::string getTypeString() const override;
 
 private:
-    uint16_t block_number_;
-    
-    /**
-     * @brief Parse block number from raw data
-     * @param data Raw packet data
-     * @param offset Offset to start parsing from
-     * @return true if block number parsed successfully, false otherwise
-     */
-    bool parseBlockNumber(const uint8_t* data, size_t offset);
-    
-    /**
-     * @brief Serialize block number to raw data
-     * @param data Vector to append serialized block number to
-     */
-    void serializeBlockNumber(std::vector<uint8_t>& data) const;
+    uint16_t block_number_ = 0;
 };
 
 /**
@@ -477,22 +446,8 @@ public:
     std::string getTypeString() const override;
 
 private:
-    TftpError error_code_;
+    TftpError error_code_ = TftpError::SUCCESS;
     std::string error_message_;
-    
-    /**
-     * @brief Parse error code from raw data
-     * @param data Raw packet data
-     * @param offset Offset to start parsing from
-     * @return true if error code parsed successfully, false otherwise
-     */
-    bool parseErrorCode(const uint8_t* data, size_t offset);
-    
-    /**
-     * @brief Serialize error code to raw data
-     * @param data Vector to append serialized error code to
-     */
-    void serializeErrorCode(std::vector<uint8_t>& data) const;
 };
 
 } // namespace simple_tftpd
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/tftp/monitoring.hpp"
+#include "simple-tftpd/core/utils/logger.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Supervisor of the datacenter build's prefork worker processes
+ *
+ * Each worker runs a complete server with its own listener thread and
+ * connections, binding the TFTP port with SO_REUSEPORT so the kernel
+ * spreads clients across them. A crash or a read stuck on a slow disk
+ * therefore only affects the clients of one worker, and the supervisor
+ * starts a replacement. Note that Linux hashes clients over the sockets
+ * currently bound, so while a worker is being replaced, transfers in
+ * progress on the other workers may see some of their packets delivered
+ * to the wrong process and retry or time out.
+ *
+ * Workers publish their Monitoring counters to a page of shared memory,
+ * one seqlock-protected slot per worker, and getMetrics() sums them. The
+ * counters of a worker that exited are kept, so totals never go back.
+ *
+ * Not available on Windows; start() fails there.
+ */
+class TftpPreforkSupervisor {
+public:
+    /**
+     * @brief Body of a worker process
+     * @param index Worker slot, 0 to the worker count - 1
+     * @return Process exit code
+     */
+    using Worker = std::function<int(size_t index)>;
+
+    /**
+     * @brief Constructor
+     * @param workers Number of worker processes
+     * @param logger Logger instance
+     */
+    TftpPreforkSupervisor(size_t workers, std::shared_ptr<Logger> logger);
+
+    /**
+     * @brief Destructor; stops the workers if still running
+     */
+    ~TftpPreforkSupervisor();
+
+    TftpPreforkSupervisor(const TftpPreforkSupervisor&) = delete;
+    TftpPreforkSupervisor& operator=(const TftpPreforkSupervisor&) = delete;
+
+    /**
+     * @brief Fork the workers
+     *
+     * Call before the supervisor starts any thread of its own: a forked
+     * child only has the thread that called fork().
+     * @param worker Run in each child, which exits with its result
+     * @return false if the statistics page could not be mapped or no worker could be forked
+     */
+    bool start(Worker worker);
+
+    /**
+     * @brief Reap exited workers and start their replacements
+     *
+     * Called periodically from the supervisor's main loop. A worker that
+     * keeps exiting within a second of starting is restarted once a second.
+     */
+    void supervise();
+
+    /**
+     * @brief Ask every worker to reload its configuration (SIGHUP)
+     */
+    void reload();
+
+    /**
+     * @brief Stop the workers: SIGTERM, then SIGKILL for any still running after the grace period
+     * @param grace Time allowed for a clean shutdown
+     */
+    void stop(std::chrono::milliseconds grace = std::chrono::seconds(5));
+
+    /**
+     * @brief Publish a worker's counters; called inside the worker
+     * @param index Worker slot passed to the Worker function
+     * @param metrics Current metrics of the worker's server
+     */
+    void publish(size_t index, const ServerMetrics& metrics);
+
+    /**
+     * @brief Get the counters of all workers, past and present, summed
+     */
+    ServerMetrics getMetrics() const;
+
+    /**
+     * @brief Get the summed counters as the JSON of Monitoring::getMetricsJson()
+     */
+    std::string getMetricsJson() const;
+
+    /**
+     * @brief Get the process IDs of the running workers (0 for a slot waiting for a restart)
+     */
+    std::vector<int> getWorkerPids() const;
+
+    /**
+     * @brief Get how many times a worker was replaced
+     */
+    uint64_t getRestarts() const { return restarts_.load(); }
+
+private:
+    struct Slot;
+
+    struct Process {
+        int pid = 0;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point restart_at;
+        uint32_t quick_exits = 0;  // Consecutive exits within a second of starting
+    };
+
+    size_t workers_;
+    std::shared_ptr<Logger> logger_;
+    Worker worker_;
+    Slot* slots_;  // Shared with the workers
+    size_t slots_size_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    mutable std::mutex mutex_;
+    std::vector<Process> processes_;
+    ServerMetrics retired_;  // Counters of workers that exited
+    std::atomic<bool> stopping_;
+    std::atomic<uint64_t> restarts_;
+
+    bool spawn(size_t index);
+    void reaped(size_t index, int status);
+    ServerMetrics readSlot(size_t index) const;
+    void collect(Monitoring& view) const;
+    void logEvent(LogLevel level, const std::string& message) const;
+};
+
+} // namespace simple_tftpd
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief DATA blocks of a write transfer that arrived ahead of a gap
+ *
+ * A windowed sender (RFC 7440) may deliver the blocks of a window out of
+ * order. Those past the next expected block wait here until the gap is
+ * filled, instead of being dropped and sent again. Every held block lies
+ * within one window of the next expected block, so the blocks live in a
+ * fixed array of slots, block modulo capacity, and a slot's buffer is
+ * reused by the blocks that follow it.
+ */
+class TftpReceiveWindow {
+public:
+    /**
+     * @brief Drop all held blocks and size the window for a transfer
+     * @param capacity Most blocks held at once (the negotiated windowsize)
+     */
+    void reset(uint16_t capacity);
+
+    /**
+     * @brief Hold a copy of a block
+     * @param block Block number
+     * @param payload Block payload
+     * @return false if the block, or one a window away from it, is already held
+     */
+    bool store(uint16_t block, ByteView payload);
+
+    /**
+     * @brief Find a held block
+     * @param block Block number
+     * @return Payload, or null if the block is not held
+     */
+    const std::vector<uint8_t>* find(uint16_t block) const;
+
+    /**
+     * @brief Stop holding a block; its payload stays readable until the slot is reused
+     * @param block Block number
+     */
+    void release(uint16_t block);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+private:
+    struct Slot {
+        std::vector<uint8_t> payload;  // Capacity is reused
+        uint16_t block = 0;
+        bool held = false;
+    };
+
+    std::vector<Slot> slots_;  // Power-of-two count, allocated on first store()
+    uint16_t mask_ = 0;
+    uint32_t capacity_ = 1;
+    uint32_t count_ = 0;
+};
+
+} // namespace simple_tftpd
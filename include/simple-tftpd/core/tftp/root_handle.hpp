@@ -0,0 +1,201 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <string>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief What one stat() of a served file tells
+ */
+struct TftpFileMetadata {
+    bool regular = false;     ///< Regular file (not a directory or device)
+    uint64_t size = 0;
+    int64_t modified = 0;     ///< Modification time in nanoseconds since the epoch
+    uint64_t inode = 0;
+    uint64_t device = 0;
+    uint32_t permissions = 0; ///< Permission bits (st_mode & 07777)
+};
+
+/**
+ * @brief Owned file descriptor with whole-buffer reads and writes
+ */
+class TftpFileHandle {
+public:
+    TftpFileHandle() = default;
+    explicit TftpFileHandle(int fd) : fd_(fd) {}
+    ~TftpFileHandle();
+
+    TftpFileHandle(TftpFileHandle&& other) noexcept;
+    TftpFileHandle& operator=(TftpFileHandle&& other) noexcept;
+    TftpFileHandle(const TftpFileHandle&) = delete;
+    TftpFileHandle& operator=(const TftpFileHandle&) = delete;
+
+    /**
+     * @brief Open a file by path, without containment
+     * @param path File path
+     * @return Handle, not open on failure
+     */
+    static TftpFileHandle openPath(const std::string& path);
+
+    bool isOpen() const { return fd_ >= 0; }
+    int get() const { return fd_; }
+    void close();
+
+    /**
+     * @brief Read up to size bytes from the current offset
+     * @return Bytes read, short only at end of file, or -1 on error
+     */
+    int64_t read(void* buffer, size_t size);
+
+    /**
+     * @brief Read up to size bytes at an offset, leaving the current offset alone
+     * @return Bytes read, short only at end of file, or -1 on error
+     */
+    int64_t readAt(uint64_t offset, void* buffer, size_t size) const;
+
+    /**
+     * @brief Write all of data at the current offset
+     */
+    bool write(const void* data, size_t size);
+
+    /**
+     * @brief Seek back to the start of the file
+     */
+    bool rewind();
+
+    /**
+     * @brief Describe the open file
+     * @param metadata Receives the metadata
+     * @return false if the file cannot be examined
+     */
+    bool stat(TftpFileMetadata& metadata) const;
+
+private:
+    int fd_ = -1;
+};
+
+/**
+ * @brief Served root (and allowed directories) held open as directory handles
+ *
+ * Files are opened relative to these handles rather than by full path, so
+ * only the components below the root are looked up per request, and the
+ * kernel refuses any lookup that leaves the directory, including through
+ * symlinks. On Linux 5.6 and later this uses openat2(RESOLVE_BENEATH);
+ * older kernels and other POSIX systems walk the path one component at a
+ * time, expanding symlinks in userspace under the same rules. Absolute
+ * symlinks are refused either way. Windows opens by full path and relies
+ * on the request checks alone.
+ *
+ * When allowed directories are configured, a file is opened beneath the
+ * deepest one containing it, so a symlink cannot lead from an allowed
+ * directory into a disallowed one.
+ *
+ * Immutable once opened; one instance is shared by all connections and
+ * replaced on reload.
+ */
+class TftpRootHandle {
+public:
+    enum class Resolution {
+        AUTO,       // openat2 where the kernel has it
+        USERSPACE   // Always walk components, for tests and benchmarks
+    };
+
+    explicit TftpRootHandle(Resolution resolution = Resolution::AUTO);
+    ~TftpRootHandle();
+
+    TftpRootHandle(const TftpRootHandle&) = delete;
+    TftpRootHandle& operator=(const TftpRootHandle&) = delete;
+
+    /**
+     * @brief Open the root and the allowed directories below it
+     * @param root Served root directory
+     * @param allowed_directories Absolute allowed directories; those outside root are ignored
+     * @return false if the root cannot be opened
+     */
+    bool open(const std::string& root, const std::vector<std::string>& allowed_directories = {});
+
+    /**
+     * @brief Open a file for reading
+     * @param relative Name below the root
+     * @return Handle, not open on failure with errno set (EXDEV for escapes)
+     */
+    TftpFileHandle openRead(const std::string& relative) const;
+
+    /**
+     * @brief Create or truncate a file for writing, creating missing parent directories
+     * @param relative Name below the root
+     * @return Handle, not open on failure with errno set (EXDEV for escapes)
+     */
+    TftpFileHandle openWrite(const std::string& relative) const;
+
+    /**
+     * @brief Create a file that must not exist yet, creating missing parent directories
+     * @param relative Name below the root
+     * @return Handle, not open on failure with errno set (EEXIST if the name is taken, EXDEV for escapes)
+     */
+    TftpFileHandle openCreate(const std::string& relative) const;
+
+    /**
+     * @brief Examine a file the way openRead() would reach it, without reading it
+     * @param relative Name below the root
+     * @param metadata Receives the metadata
+     * @return false if missing, outside the root or not examinable, with errno set
+     */
+    bool stat(const std::string& relative, TftpFileMetadata& metadata) const;
+
+    bool isOpen() const { return !anchors_.empty(); }
+    const std::string& getRoot() const { return root_; }
+
+    /**
+     * @brief Directories held open, the root included
+     */
+    size_t anchorCount() const { return anchors_.size(); }
+
+    /**
+     * @brief Allowed directories that could not be opened beneath the root
+     */
+    const std::vector<std::string>& getRejectedDirectories() const { return rejected_; }
+
+    /**
+     * @brief Check if lookups are confined by the kernel rather than in userspace
+     */
+    bool usesKernelResolution() const { return kernel_; }
+
+private:
+    struct Anchor {
+        std::string prefix;  // Path below the root with a trailing '/', empty for the root
+        TftpFileHandle directory;
+    };
+
+    Resolution resolution_;
+    bool kernel_;
+    std::string root_;
+    std::vector<Anchor> anchors_;  // Deepest first, the root last
+    std::vector<std::string> rejected_;
+
+    TftpFileHandle openFile(const std::string& relative, int flags, bool create_parents) const;
+    const Anchor& anchorFor(const std::string& relative, std::string& remainder) const;
+    int openBeneath(int directory, const std::string& path, int flags) const;
+    int walkBeneath(int directory, const std::string& path, int flags) const;
+    bool createParents(int directory, const std::string& path) const;
+};
+
+} // namespace simple_tftpd
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief A DATA block sent and not yet acknowledged
+ */
+struct TftpInFlightBlock {
+    std::vector<uint8_t> payload;  ///< Copy for retransmission, unless frame or from_file is set; capacity is reused
+    ByteView frame;                ///< Complete DATA frame in a shared block stream
+    uint64_t offset = 0;           ///< Position of the payload in the file, when from_file is set
+    uint32_t payload_size = 0;
+    uint16_t retries = 0;
+    bool is_final = false;
+    bool from_file = false;        ///< A retransmit reads payload_size bytes at offset again
+    std::chrono::steady_clock::time_point last_sent;
+};
+
+/**
+ * @brief Blocks released by one acknowledgement
+ */
+struct TftpWindowAck {
+    size_t blocks = 0;   ///< 0 if the block was not in flight (duplicate or stale ACK)
+    uint64_t bytes = 0;  ///< Payload bytes of the released blocks
+    bool final = false;  ///< The last block of the file was among them
+};
+
+/**
+ * @brief Blocks in flight on a read transfer, as a ring indexed by block number
+ *
+ * The blocks in flight are always a contiguous run starting at base(), so
+ * they live in a fixed array of slots, block modulo capacity, allocated
+ * once per transfer. Sending, acknowledging and looking up a block are
+ * constant time and never allocate, and a slot's payload buffer is reused
+ * by the blocks that follow it.
+ *
+ * An ACK is cumulative (RFC 7440): acknowledging a block releases it and
+ * every block before it. Block numbers wrap at 65536 like the protocol's.
+ *
+ * The window also keeps a lower bound on the oldest send time, so a timer
+ * tick can tell that nothing has expired without visiting the blocks.
+ */
+class TftpSendWindow {
+public:
+    /**
+     * @brief Empty the window and size it for a transfer
+     * @param capacity Most blocks in flight at once (the negotiated windowsize)
+     * @param first_block Number of the first block to be sent
+     */
+    void reset(uint16_t capacity, uint16_t first_block);
+
+    /**
+     * @brief Get the slot for the next block, base() + size(), without adding it
+     *
+     * Fill it in, then push() it once it is sent. Requires !full().
+     */
+    TftpInFlightBlock& next() { return slots_[static_cast<uint16_t>(base_ + count_) & mask_]; }
+
+    /**
+     * @brief Add the block prepared in next() to the window
+     */
+    void push();
+
+    /**
+     * @brief Release a block and all blocks before it
+     * @param block Acknowledged block number
+     * @return What was released
+     */
+    TftpWindowAck acknowledge(uint16_t block);
+
+    /**
+     * @brief Find a block in flight
+     * @param block Block number
+     * @return Entry, or null if the block is not in the window
+     */
+    TftpInFlightBlock* find(uint16_t block);
+
+    /**
+     * @brief Get a block by position, 0 being the oldest
+     * @param index Position, less than size()
+     */
+    TftpInFlightBlock& at(size_t index) { return slots_[static_cast<uint16_t>(base_ + index) & mask_]; }
+
+    /**
+     * @brief Check if any block may have waited at least the timeout
+     *
+     * Exact after refreshOldest(), conservative (true too early) otherwise.
+     * @param now Current time
+     * @param timeout Retransmission timeout
+     */
+    bool mayHaveExpired(std::chrono::steady_clock::time_point now,
+                        std::chrono::steady_clock::duration timeout) const {
+        return count_ > 0 && now - oldest_sent_ >= timeout;
+    }
+
+    /**
+     * @brief Recompute the oldest send time after blocks were resent
+     */
+    void refreshOldest();
+
+    /// Oldest unacknowledged block (the next block to send when empty)
+    uint16_t base() const { return base_; }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ >= capacity_; }
+
+private:
+    std::vector<TftpInFlightBlock> slots_;  // Power-of-two count
+    uint16_t base_ = 1;
+    uint16_t mask_ = 0;
+    uint32_t count_ = 0;
+    uint32_t capacity_ = 0;
+    std::chrono::steady_clock::time_point oldest_sent_;
+};
+
+} // namespace simple_tftpd
@@ -18,7 +18,20 @@
 
 #include "simple-tftpd/core/utils/platform.hpp"
 #include "simple-tftpd/core/tftp/connection.hpp"
+#include "simple-tftpd/core/tftp/ack_coalescer.hpp"
 #include "simple-tftpd/core/tftp/monitoring.hpp"
+#include "simple-tftpd/core/tftp/multicast.hpp"
+#include "simple-tftpd/core/tftp/block_cache.hpp"
+#include "simple-tftpd/core/tftp/cluster.hpp"
+#include "simple-tftpd/core/tftp/compressed_store.hpp"
+#include "simple-tftpd/core/tftp/directory_watcher.hpp"
+#include "simple-tftpd/core/tftp/filename_index.hpp"
+#include "simple-tftpd/core/tftp/metadata_cache.hpp"
+#include "simple-tftpd/core/tftp/negative_cache.hpp"
+#include "simple-tftpd/core/tftp/origin_store.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include "simple-tftpd/core/tftp/setup_pool.hpp"
+#include "simple-tftpd/core/tftp/shared_cache.hpp"
 #include "simple-tftpd/core/config/config.hpp"
 #include "simple-tftpd/core/utils/logger.hpp"
 #include <memory>
@@ -55,6 +68,37 @@ struct TftpServerStats {
                         total_bytes_transferred(0), total_errors(0) {}
 };
 
+/**
+ * @brief Listener thread counters
+ *
+ * Time the listener spent blocked on the connection table is time no
+ * datagram was received, so it is the stall caused by other threads.
+ */
+struct TftpListenerStats {
+    uint64_t packets = 0;           ///< Datagrams routed
+    uint64_t batches = 0;           ///< Receive calls that returned datagrams
+    uint64_t acks_coalesced = 0;    ///< ACKs dropped for a newer ACK from the same session in the batch
+    uint64_t table_waits = 0;       ///< Times the connection table was held by another thread
+    uint64_t table_wait_ns = 0;     ///< Total time spent waiting for it
+    uint64_t max_table_wait_ns = 0; ///< Longest single wait
+    uint64_t reclaimed = 0;         ///< Connections stopped and released by the cleanup thread
+    uint64_t pending_reclaim = 0;   ///< Connections unlinked from the table, not yet stopped
+};
+
+/**
+ * @brief Datagram send counters
+ *
+ * datagrams / calls is the number of packets per system call, which UDP
+ * GSO raises above 1 for windowed reads.
+ */
+struct TftpSendStats {
+    uint64_t datagrams = 0;      ///< Datagrams sent
+    uint64_t calls = 0;          ///< System calls that sent them
+    uint64_t gso_sends = 0;      ///< Calls that carried several datagrams for the kernel to split
+    uint64_t gso_fallbacks = 0;  ///< Segmented sends that failed and went out one datagram at a time
+    bool gso_enabled = false;    ///< performance.udp_gso is set and the kernel supports it
+};
+
 /**
  * @brief TFTP server class
  *
@@ -134,6 +178,12 @@ public:
      */
     void setConfigFile(const std::string& config_file);
 
+    /**
+     * @brief Append a suffix to monitoring.connections_file, so worker processes write separate files
+     * @param suffix Appended to the configured path (kept across reloads)
+     */
+    void setConnectionsFileSuffix(const std::string& suffix);
+
     /**
      * @brief Get server statistics
      * @return Server statistics
@@ -145,6 +195,18 @@ public:
      */
     void resetStats();
 
+    /**
+     * @brief Get listener thread statistics
+     * @return Packets routed, time blocked on the connection table and connections reclaimed
+     */
+    TftpListenerStats getListenerStats() const;
+
+    /**
+     * @brief Get datagram send statistics
+     * @return Datagrams, system calls and UDP GSO use
+     */
+    TftpSendStats getSendStats() const;
+
     /**
      * @brief Perform health check
      * @return Health check result
@@ -180,6 +242,185 @@ public:
     bool sendPacket(const uint8_t* packet_data, size_t packet_size,
                    const std::string& client_addr, port_t client_port);
 
+    /**
+     * @brief Send consecutive datagrams of one size to a client
+     *
+     * With UDP GSO they leave in one system call; otherwise, or if the
+     * segmented send fails, one at a time.
+     * @param data Datagrams, back to back; only the last may be shorter than @p segment_size
+     * @param size Total bytes, at most getGsoSegmentsPerSend(segment_size) datagrams
+     * @param segment_size Bytes per datagram
+     * @param client_addr Client address
+     * @param client_port Client port
+     * @return true if all were sent
+     */
+    bool sendSegments(const uint8_t* data, size_t size, size_t segment_size,
+                      const std::string& client_addr, port_t client_port);
+
+    /**
+     * @brief Get how many datagrams a transfer should pass to one sendSegments() call
+     * @param segment_size Bytes per datagram
+     * @return 0 when UDP GSO is off or unavailable
+     */
+    size_t getGsoSegmentsPerSend(size_t segment_size) const;
+
+    /**
+     * @brief Hand a validated read request over to a multicast session
+     * @param client_addr Client address
+     * @param client_port Client port
+     * @param path Full path of the file to send
+     * @param name Name of the file below the root, opened through the root handle
+     * @param file_size File size in bytes
+     * @param block_size Negotiated block size
+     * @param request_options Options from the client's RRQ
+     * @return true if the client joined a group, false to continue with unicast
+     */
+    bool joinMulticastTransfer(const std::string& client_addr, port_t client_port,
+                               const std::string& path, const std::string& name, uint64_t file_size,
+                               uint16_t block_size, const TftpOptions& request_options);
+
+    /**
+     * @brief Get number of active multicast sessions
+     * @return Number of files currently streamed to a group
+     */
+    size_t getMulticastSessionCount() const;
+
+    /**
+     * @brief Get multicast transfer statistics
+     * @return Counters summed over all multicast sessions
+     */
+    TftpMulticastStats getMulticastStats() const;
+
+    /**
+     * @brief Get the shared DATA block cache
+     * @return Block cache used by read transfers
+     */
+    TftpBlockCache& getBlockCache();
+
+    /**
+     * @brief Get block cache statistics
+     * @return Cache counters including the cached-block ratio
+     */
+    TftpBlockCacheStats getBlockCacheStats() const;
+
+    /**
+     * @brief Get the shared netascii conversion cache
+     * @return Converted streams used by netascii/mail read transfers
+     */
+    TftpNetasciiCache& getNetasciiCache();
+
+    /**
+     * @brief Get netascii cache statistics
+     * @return Cache counters; misses count whole-file conversions
+     */
+    TftpCacheStats getNetasciiCacheStats() const;
+
+    /**
+     * @brief Get the cache of paths known to be missing
+     * @return Negative cache consulted before opening requested files
+     */
+    TftpNegativeCache& getNegativeCache();
+
+    /**
+     * @brief Get negative cache statistics
+     * @return Hit rate and filesystem probes saved
+     */
+    TftpNegativeCacheStats getNegativeCacheStats() const;
+
+    /**
+     * @brief Get the cache of served file metadata
+     * @return Stat results consulted instead of probing requested files
+     */
+    TftpMetadataCache& getMetadataCache();
+
+    /**
+     * @brief Get metadata cache statistics
+     * @return Hit rate, stat() calls and file opens
+     */
+    TftpMetadataCacheStats getMetadataCacheStats() const;
+
+    /**
+     * @brief Get the change notifications for the served tree
+     * @return Watcher feeding the negative and metadata caches
+     */
+    TftpDirectoryWatcher& getDirectoryWatcher();
+
+    /**
+     * @brief Get the case-insensitive filename index
+     * @return Index consulted by read requests when filesystem.case_insensitive is set
+     */
+    TftpFilenameIndex& getFilenameIndex();
+
+    /**
+     * @brief Get filename index statistics
+     * @return Indexed files and lookups resolved
+     */
+    TftpFilenameIndexStats getFilenameIndexStats() const;
+
+    /**
+     * @brief Get the edge cache filling the root from the HTTP origin
+     * @return Origin store consulted by read requests when filesystem.origin_url is set
+     */
+    TftpOriginStore& getOriginStore();
+
+    /**
+     * @brief Get origin pull statistics
+     * @return Downloads, revalidations and bytes fetched
+     */
+    TftpOriginStats getOriginStats() const;
+
+    /**
+     * @brief Get the cluster membership and peer listener
+     * @return Cluster consulted by read requests for files missing from the root
+     */
+    TftpCluster& getCluster();
+
+    /**
+     * @brief Get cluster statistics
+     * @return Peer fetches and peer requests served
+     */
+    TftpClusterStats getClusterStats() const;
+
+    /**
+     * @brief Use a content cache shared with other worker processes
+     *
+     * Set by the prefork supervisor's workers before start(). Octet reads of
+     * files in the root then copy from the shared chunks instead of each
+     * process keeping its own streams in the block cache.
+     * @param cache Cache mapped before the workers were forked, or null
+     */
+    void setSharedCache(std::shared_ptr<TftpSharedContentCache> cache);
+
+    /**
+     * @brief Get the content cache shared between worker processes
+     * @return Cache, or null when this server runs alone
+     */
+    TftpSharedContentCache* getSharedCache() const;
+
+    /**
+     * @brief Get statistics of the pool setting up new transfers
+     * @return Queue depth, requests set up and requests refused as busy
+     */
+    TftpSetupPoolStats getSetupPoolStats() const;
+
+    /**
+     * @brief Get the served root held open for anchored lookups
+     * @return Handle opened at start and on reload, null before start or if the root could not be opened
+     */
+    std::shared_ptr<const TftpRootHandle> getRootHandle() const;
+
+    /**
+     * @brief Get the store serving compressed copies of missing files
+     * @return Compressed store used by read transfers
+     */
+    TftpCompressedStore& getCompressedStore();
+
+    /**
+     * @brief Get compressed store statistics
+     * @return Storage bytes read and saved, and decoding time
+     */
+    TftpCompressionStats getCompressionStats() const;
+
     /**
      * @brief Get server uptime
      * @return Server uptime in seconds
@@ -227,20 +468,51 @@ public:
 
     /**
      * @brief List all active connections
-     * @return Vector of connection information strings
+     * @return Vector of connection information strings (one JSON object each)
      */
     std::vector<std::string> listConnections() const;
 
+    /**
+     * @brief Get telemetry snapshots for all active connections
+     * @return Vector of per-connection telemetry
+     */
+    std::vector<TftpConnectionTelemetry> getConnectionTelemetry() const;
+
+    /**
+     * @brief Get live connections view as JSON string
+     * @return JSON document with a timestamp and a "connections" array
+     */
+    std::string getConnectionsJson() const;
+
+    /**
+     * @brief Write the live connections view to the configured status file
+     * @return true if written (or no status file configured), false on error
+     */
+    bool writeConnectionsSnapshot() const;
+
     /**
      * @brief Set security manager
      * @param security_manager Security manager instance
      */
     void setSecurityManager(std::shared_ptr<ProductionSecurityManager> security_manager);
 
+    /** Active transfers keyed by client TID (see generateConnectionKey) */
+    using ConnectionTable = std::map<std::string, std::shared_ptr<TftpConnection>>;
+
+    /**
+     * @brief Generate connection key
+     * @param client_addr Client address
+     * @param client_port Client port
+     * @return Connection key string
+     */
+    static std::string generateConnectionKey(const std::string& client_addr, port_t client_port);
+
 private:
     std::shared_ptr<TftpConfig> config_;
     std::shared_ptr<Logger> logger_;
     std::shared_ptr<class ProductionSecurityManager> security_manager_; // Optional, for production builds
+    TftpAtomicSnapshot<TftpAccessPolicy> access_policy_;  // Client ACL checked per packet
+    TftpAtomicSnapshot<TftpRootHandle> root_handle_;      // Served root, replaced on reload
 
     std::atomic<bool> running_;
     std::atomic<bool> shutdown_requested_;
@@ -250,26 +522,98 @@ private:
     port_t listen_port_;
     bool ipv6_enabled_;
     std::string config_file_path_;
+    std::string connections_file_suffix_;
 
     std::thread listener_thread_;
     std::thread cleanup_thread_;
 
-    std::map<std::string, std::shared_ptr<TftpConnection>> connections_;
+    ConnectionTable connections_;
+    // Unlinked from connections_ but not yet stopped; stop() joins the worker
+    // thread, so it is left to the cleanup thread outside the lock
+    std::vector<std::shared_ptr<TftpConnection>> retired_connections_;
     mutable std::mutex connections_mutex_;
 
+    std::atomic<uint64_t> listener_packets_;
+    std::atomic<uint64_t> listener_batches_;
+    std::atomic<uint64_t> listener_acks_coalesced_;
+    std::atomic<uint64_t> listener_table_waits_;
+    std::atomic<uint64_t> listener_table_wait_ns_;
+    std::atomic<uint64_t> listener_max_table_wait_ns_;
+    std::atomic<uint64_t> reclaimed_connections_;
+    std::atomic<uint64_t> sent_datagrams_;
+    std::atomic<uint64_t> send_calls_;
+    std::atomic<uint64_t> gso_sends_;
+    std::atomic<uint64_t> gso_fallbacks_;
+    std::atomic<bool> gso_enabled_;  // Cleared for good if the kernel cannot segment after all
+
+    /**
+     * @brief Lock the connection table on the listener thread, recording any wait
+     * @return Held lock
+     */
+    std::unique_lock<std::mutex> lockConnectionTable();
+
+    /**
+     * @brief Copy the current connection set without holding the lock afterwards
+     * @return Snapshot of active connections
+     */
+    std::vector<std::shared_ptr<TftpConnection>> snapshotConnections() const;
+
     TftpServerStats stats_;
     mutable std::mutex stats_mutex_;
 
     std::unique_ptr<Monitoring> monitoring_;
+    std::unique_ptr<TftpMulticastManager> multicast_manager_;
+    std::unique_ptr<TftpBlockCache> block_cache_;
+    std::unique_ptr<TftpNetasciiCache> netascii_cache_;
+    std::unique_ptr<TftpCompressedStore> compressed_store_;
+    std::unique_ptr<TftpDirectoryWatcher> directory_watcher_;  // Before the caches subscribed to it
+    std::unique_ptr<TftpNegativeCache> negative_cache_;
+    std::unique_ptr<TftpMetadataCache> metadata_cache_;
+    std::unique_ptr<TftpFilenameIndex> filename_index_;
+    std::unique_ptr<TftpOriginStore> origin_store_;  // After the caches its downloads invalidate
+    std::unique_ptr<TftpCluster> cluster_;           // After the origin store it downloads through
+    std::shared_ptr<TftpSharedContentCache> shared_cache_;  // Shared with the other workers
+    std::unique_ptr<TftpSetupPool> setup_pool_;             // Runs request setup off the listener thread
 
     std::function<void(TftpConnectionState, const std::string&)> connection_callback_;
     std::function<void(const std::string&, const std::string&)> server_callback_;
 
+    /**
+     * @brief One datagram of a listener receive batch
+     */
+    struct ListenerDatagram {
+        struct sockaddr_storage from;
+        size_t size = 0;
+        std::string address;
+        port_t port = 0;
+    };
+
     /**
      * @brief Main listener thread
      */
     void listenerThread();
 
+    /**
+     * @brief Take the datagrams queued on the socket, without waiting
+     * @param buffer One TFTP_MAX_DATAGRAM_SIZE slot per entry of @p batch
+     * @param batch Receives the sender and size of each datagram
+     * @return Datagrams received, 0 if none were queued, -1 on a socket error
+     */
+    int receiveBatch(uint8_t* buffer, std::vector<ListenerDatagram>& batch);
+
+    /**
+     * @brief Route the datagrams of a batch, handling one ACK per session
+     *
+     * Of several ACKs from one session, only the newest is handled, after
+     * the session's other packets that came before it.
+     * @param buffer Datagram slots filled by receiveBatch()
+     * @param batch Datagrams received
+     * @param count Number of datagrams in @p batch
+     * @param acks Scratch space reused across batches
+     */
+    void routeBatch(const uint8_t* buffer, std::vector<ListenerDatagram>& batch, size_t count,
+                    TftpAckCoalescer& acks);
+
     /**
      * @brief Connection cleanup thread
      */
@@ -286,6 +630,17 @@ private:
      */
     void closeSocket();
 
+    /**
+     * @brief Build the socket address of a client
+     * @param client_addr Client address
+     * @param client_port Client port
+     * @param addr Receives the address
+     * @param addr_len Receives its size
+     * @return false if the address does not parse for the socket's family
+     */
+    bool resolveClientAddress(const std::string& client_addr, port_t client_port,
+                              struct sockaddr_storage& addr, socklen_t& addr_len);
+
     /**
      * @brief Accept incoming connection
      * @return true if connection accepted, false otherwise
@@ -313,6 +668,13 @@ private:
     std::shared_ptr<TftpConnection> createConnection(const std::string& client_addr,
                                                     port_t client_port);
 
+    /**
+     * @brief Find the connection a DATA, ACK or ERROR packet belongs to (listener thread)
+     * @param connection_key Key from generateConnectionKey()
+     * @return Connection, or null if there is none
+     */
+    std::shared_ptr<TftpConnection> findConnection(const std::string& connection_key);
+
     /**
      * @brief Remove connection
      * @param client_addr Client address
@@ -325,6 +687,13 @@ private:
      */
     void cleanupInactiveConnections();
 
+    /**
+     * @brief Stop and release the connections unlinked from the table
+     *
+     * Runs on the cleanup thread, never under connections_mutex_.
+     */
+    void reclaimConnections();
+
     /**
      * @brief Update server statistics
      * @param connection_state Connection state change
@@ -340,12 +709,23 @@ private:
     void logEvent(LogLevel level, const std::string& message);
 
     /**
-     * @brief Generate connection key
-     * @param client_addr Client address
-     * @param client_port Client port
-     * @return Connection key string
+     * @brief Index the served tree for case-insensitive lookup and log the result
+     * @param root Served root directory
      */
-    static std::string generateConnectionKey(const std::string& client_addr, port_t client_port);
+    void buildFilenameIndex(const std::string& root);
+
+    /**
+     * @brief Log the loaded filename remap rules and any that were rejected
+     * @param config Configuration holding the rules
+     */
+    void reportRemapRules(const TftpConfig& config);
+
+    /**
+     * @brief Open the served root and allowed directories
+     * @param config Configuration naming the directories
+     * @return Handle to publish in root_handle_, null if the root cannot be opened
+     */
+    std::shared_ptr<const TftpRootHandle> openRootHandle(const TftpConfig& config);
 
     /**
      * @brief Check if address is valid
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Setup pool counters
+ */
+struct TftpSetupPoolStats {
+    uint64_t submitted = 0;    ///< Jobs accepted
+    uint64_t completed = 0;    ///< Jobs run to the end
+    uint64_t rejected = 0;     ///< Jobs refused because the queue was full
+    uint64_t dropped = 0;      ///< Queued jobs discarded by stop()
+    uint64_t queued = 0;       ///< Jobs waiting for a thread
+    uint64_t peak_queued = 0;  ///< Most jobs ever waiting at once
+    uint64_t threads = 0;
+};
+
+/**
+ * @brief Bounded pool of threads setting up new transfers
+ *
+ * Setting up a transfer validates the path and opens, stats and sometimes
+ * reads the file before the first reply is sent. On a slow filesystem that
+ * can take far longer than receiving a packet, so the listener hands each
+ * request to this pool and goes back to receiving. The queue is bounded:
+ * once it is full, submit() fails and the request is refused rather than
+ * left to wait behind a stalled disk.
+ */
+class TftpSetupPool {
+public:
+    /// A unit of work
+    using Job = std::function<void()>;
+
+    /**
+     * @brief Constructor
+     * @param threads Number of threads (0 leaves the pool unusable; submit() fails)
+     * @param queue_limit Jobs that may wait for a thread
+     */
+    TftpSetupPool(size_t threads, size_t queue_limit);
+
+    /**
+     * @brief Destructor; stops the threads
+     */
+    ~TftpSetupPool();
+
+    TftpSetupPool(const TftpSetupPool&) = delete;
+    TftpSetupPool& operator=(const TftpSetupPool&) = delete;
+
+    /**
+     * @brief Start the threads
+     */
+    void start();
+
+    /**
+     * @brief Wait for running jobs and stop the threads, discarding queued jobs
+     */
+    void stop();
+
+    /**
+     * @brief Queue a job
+     * @param job Run once on a pool thread
+     * @return false if the pool is not running or its queue is full
+     */
+    bool submit(Job job);
+
+    /**
+     * @brief Check if the pool runs jobs
+     * @return true between start() and stop() when it has threads
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Get pool counters
+     * @return Setup pool statistics
+     */
+    TftpSetupPoolStats getStats() const;
+
+private:
+    size_t thread_count_;
+    size_t queue_limit_;
+    std::vector<std::thread> threads_;
+    std::deque<Job> queue_;
+    bool running_;
+    TftpSetupPoolStats stats_;
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+
+    void run();
+};
+
+} // namespace simple_tftpd
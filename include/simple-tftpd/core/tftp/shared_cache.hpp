@@ -0,0 +1,133 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace simple_tftpd {
+
+/**
+ * @brief Identity of a cached file version
+ *
+ * As with the block cache, size and modification time stand in for the
+ * version, so chunks of a rewritten file are never returned for the new one.
+ */
+struct TftpSharedCacheKey {
+    std::string path;
+    uint64_t file_size = 0;
+    int64_t modified = 0;
+};
+
+/**
+ * @brief Shared content cache counters (summed over all processes)
+ */
+struct TftpSharedCacheStats {
+    uint64_t hits = 0;        ///< Reads answered from a cached chunk
+    uint64_t misses = 0;      ///< Reads that had to go to the file
+    uint64_t insertions = 0;  ///< Chunks stored
+    uint64_t evictions = 0;   ///< Chunks replaced to make room
+    uint64_t recoveries = 0;  ///< Stripes cleared after their lock holder died
+    uint64_t chunks = 0;      ///< Chunk slots in the mapping
+    uint64_t capacity = 0;    ///< Bytes of file data the mapping holds
+};
+
+/**
+ * @brief File content cache in memory shared by the prefork workers
+ *
+ * The mapping is created by the supervisor before it forks, so every
+ * worker inherits it and a hot image is held in RAM once instead of once
+ * per worker. Files are cached as fixed CHUNK_SIZE pieces, so clients at
+ * different block sizes share the same chunks and a large image needs
+ * only its hot parts resident.
+ *
+ * Slots are split into stripes of 64, each guarded by a process-shared
+ * robust mutex, and a chunk always lives in the stripe its key hashes to.
+ * Within a stripe slots are replaced by the CLOCK algorithm. A worker that
+ * dies holding a stripe lock may have left a half-copied chunk, so the
+ * next process to take the lock clears that stripe before using it.
+ *
+ * Only available on Linux; create() returns null elsewhere.
+ */
+class TftpSharedContentCache {
+public:
+    /// Size of a cached piece of a file
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * @brief Map a new shared cache
+     * @param bytes Byte budget for file data, rounded down to whole chunks
+     * @return Cache, or nullptr if disabled (less than one chunk), unsupported or the mapping failed
+     */
+    static std::shared_ptr<TftpSharedContentCache> create(size_t bytes);
+
+    /**
+     * @brief Destructor; unmaps this process's view
+     */
+    ~TftpSharedContentCache();
+
+    TftpSharedContentCache(const TftpSharedContentCache&) = delete;
+    TftpSharedContentCache& operator=(const TftpSharedContentCache&) = delete;
+
+    /**
+     * @brief Copy cached bytes of a file
+     * @param key File version
+     * @param offset Position in the file
+     * @param out Destination
+     * @param size Bytes wanted; fewer are returned at the end of a chunk
+     * @return Bytes copied (0 at the end of the file), -1 if the chunk is not cached
+     */
+    int64_t read(const TftpSharedCacheKey& key, uint64_t offset, void* out, size_t size);
+
+    /**
+     * @brief Store one chunk of a file
+     * @param key File version
+     * @param chunk Chunk index (offset / CHUNK_SIZE)
+     * @param data Chunk contents
+     * @param length CHUNK_SIZE, or less for the last chunk of the file
+     */
+    void insert(const TftpSharedCacheKey& key, uint64_t chunk, const void* data, size_t length);
+
+    /**
+     * @brief Get counters shared by all processes using the mapping
+     */
+    TftpSharedCacheStats getStats() const;
+
+private:
+    struct Header;
+    struct Stripe;
+    struct Slot;
+
+    TftpSharedContentCache(void* base, size_t length, uint32_t stripes, uint32_t slots);
+
+    void* base_;
+    size_t length_;
+    Header* header_;
+    Stripe* stripes_;
+    Slot* slots_;
+    uint8_t* data_;
+
+    bool lockStripe(uint32_t stripe);
+    void unlockStripe(uint32_t stripe);
+    uint32_t stripeOf(uint64_t name, uint64_t chunk) const;
+    Slot* find(uint32_t stripe, uint64_t name, uint64_t check, const TftpSharedCacheKey& key, uint64_t chunk);
+};
+
+} // namespace simple_tftpd
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_tftpd {
+
+/// Most datagrams the kernel splits one send into (UDP_MAX_SEGMENTS)
+constexpr size_t TFTP_GSO_MAX_SEGMENTS = 64;
+
+/// Largest buffer for one send: the payload of one IPv4 UDP datagram
+constexpr size_t TFTP_GSO_MAX_BYTES = 65507;
+
+/**
+ * @brief Check if the kernel can segment UDP sends on a socket (Linux 4.18+)
+ * @param socket UDP socket
+ * @return false on other platforms, or when UDP_SEGMENT is not known
+ */
+bool isUdpGsoSupported(socket_t socket);
+
+/**
+ * @brief Get how many datagrams of a size fit in one segmented send
+ * @param segment_size Bytes per datagram
+ * @return Datagrams per send, at least 1
+ */
+size_t udpGsoSegmentsPerSend(size_t segment_size);
+
+/**
+ * @brief Send consecutive datagrams in one system call, split by the kernel
+ *
+ * Every datagram is @p segment_size bytes except the last, which may be
+ * shorter. UDP sends are all or nothing, so a short count never occurs.
+ * @param socket UDP socket
+ * @param data Datagrams, back to back
+ * @param size Total bytes, at most TFTP_GSO_MAX_BYTES
+ * @param segment_size Bytes per datagram
+ * @param addr Destination
+ * @param addr_len Size of @p addr
+ * @return Bytes sent, or -1 with the error in errno
+ */
+ssize_t sendUdpSegments(socket_t socket, const uint8_t* data, size_t size, size_t segment_size,
+                        const struct sockaddr* addr, socklen_t addr_len);
+
+/**
+ * @brief Check if a send error means segmentation is unavailable, not that one send failed
+ * @param error errno from sendUdpSegments()
+ * @return true if later segmented sends would fail the same way
+ */
+bool isUdpGsoUnsupportedError(int error);
+
+} // namespace simple_tftpd
@@ -83,6 +83,7 @@ using ipv6_addr_t = uint8_t[16];
 // Platform-independent constants
 constexpr port_t TFTP_DEFAULT_PORT = 69;
 constexpr size_t TFTP_MAX_PACKET_SIZE = 512;
+constexpr size_t TFTP_MAX_DATAGRAM_SIZE = 65468; // blksize 65464 (RFC 2348) + 4-byte header
 constexpr size_t TFTP_MAX_FILENAME_LENGTH = 512;
 constexpr size_t TFTP_MAX_MODE_LENGTH = 10;
 
@@ -128,6 +129,7 @@ struct TftpOptions {
     bool multicast = false;
     std::string multicast_ip;
     uint16_t multicast_port = 0;
+    bool multicast_master = false;
     bool has_blksize = false;
     bool has_timeout = false;
     bool has_tsize = false;
@@ -14,7 +14,6 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <mutex>
 #include <set>
 
 namespace simple_tftpd {
@@ -30,6 +29,9 @@ namespace simple_tftpd {
  * - Overwrite protection
  * - File size limits
  * - Read/write permission enforcement
+ *
+ * Checks take no locks: the configuration and its compiled access policy
+ * are immutable snapshots, replaced atomically on reload.
  */
 class ProductionSecurityManager {
 public:
@@ -59,7 +61,7 @@ public:
 
     /**
      * @brief Check if client address is allowed
-     * @param address Client IP address
+     * @param address Client IP address (matched against addresses and CIDR prefixes)
      * @return true if allowed, false otherwise
      */
     bool isClientAllowed(const std::string& address) const;
@@ -106,10 +108,22 @@ public:
      */
     bool reloadConfiguration();
 
+    /**
+     * @brief Switch to a reloaded configuration
+     * @param config New server configuration
+     * @return true if reloaded successfully
+     */
+    bool reloadConfiguration(std::shared_ptr<TftpConfig> config);
+
 private:
-    std::shared_ptr<TftpConfig> config_;
+    TftpAtomicSnapshot<TftpConfig> config_;
     std::shared_ptr<Logger> logger_;
-    mutable std::mutex mutex_;
+
+    /**
+     * @brief Log client rules the policy could not parse
+     * @param config Configuration to report on
+     */
+    void reportPolicy(const TftpConfig& config) const;
 
     /**
      * @brief Check for path traversal attacks
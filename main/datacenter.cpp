@@ -6,10 +6,297 @@
  * @license BSL 1.1
  */
 
-// Datacenter version main - placeholder
-// This will include datacenter-specific initialization
+#include <iostream>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <signal.h>
+#include <csignal>
+#include "simple-tftpd/core/tftp/server.hpp"
+#include "simple-tftpd/core/tftp/prefork.hpp"
+#include "simple-tftpd/core/tftp/shared_cache.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/utils/logger.hpp"
 
-int main(int argc, char* argv[]) {
-    // Datacenter version implementation coming soon
+#ifdef PLATFORM_LINUX
+#include <sys/prctl.h>
+#endif
+
+using namespace simple_tftpd;
+
+// Signal handlers only set flags; the supervisor and worker loops act on them
+std::shared_ptr<Logger> g_logger;
+std::atomic<bool> g_shutdown_requested(false);
+std::atomic<bool> g_reload_requested(false);
+std::atomic<bool> g_metrics_requested(false);
+std::string g_config_file;
+
+/**
+ * @brief Signal handler shared by the supervisor and its workers
+ * @param signal Signal number
+ */
+void signalHandler(int signal) {
+#ifdef SIGHUP
+    if (signal == SIGHUP) {
+        g_reload_requested.store(true);
+        return;
+    }
+#endif
+#ifdef SIGUSR1
+    if (signal == SIGUSR1) {
+        g_metrics_requested.store(true);
+        return;
+    }
+#endif
+    if (g_shutdown_requested.exchange(true)) {
+        // Already shutting down, force exit
+        std::_Exit(1);
+    }
+}
+
+/**
+ * @brief Initialize signal handlers
+ */
+void initializeSignalHandlers() {
+    signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
+#ifdef SIGQUIT
+    signal(SIGQUIT, signalHandler);
+#endif
+#ifdef SIGHUP
+    signal(SIGHUP, signalHandler);
+#endif
+#ifdef SIGUSR1
+    signal(SIGUSR1, signalHandler);
+#endif
+}
+
+/**
+ * @brief Print usage information
+ */
+void printUsage() {
+    std::cout << "\nUsage: simple-tftpd [OPTIONS]" << std::endl;
+    std::cout << "\nOptions:" << std::endl;
+    std::cout << "  --help, -h           Show this help message" << std::endl;
+    std::cout << "  --version, -v        Show version information" << std::endl;
+    std::cout << "  --config, -c FILE    Use specified configuration file" << std::endl;
+    std::cout << "  --verbose, -V        Enable verbose logging" << std::endl;
+    std::cout << "  --test-config        Test configuration file" << std::endl;
+    std::cout << "  --listen ADDR        Listen on specific address" << std::endl;
+    std::cout << "  --port PORT          Listen on specific port" << std::endl;
+    std::cout << "  --root DIR           Set root directory for file operations" << std::endl;
+    std::cout << "  --workers N          Worker processes sharing the port (performance.workers)" << std::endl;
+
+    std::cout << "\nSignals:" << std::endl;
+    std::cout << "  SIGHUP               Reload the configuration in every worker" << std::endl;
+    std::cout << "  SIGUSR1              Log the metrics summed over all workers" << std::endl;
+
+    std::cout << "\nExamples:" << std::endl;
+    std::cout << "  simple-tftpd --config /etc/simple-tftpd/config.json" << std::endl;
+    std::cout << "  simple-tftpd --workers 8 --listen 0.0.0.0 --port 69 --root /var/tftp" << std::endl;
+}
+
+/**
+ * @brief Print version information
+ */
+void printVersion() {
+    std::cout << "simple-tftpd v0.3.0 (datacenter)" << std::endl;
+    std::cout << "Simple TFTP Daemon for Linux, macOS, and Windows" << std::endl;
+    std::cout << "Copyright (c) 2024 SimpleDaemons" << std::endl;
+}
+
+/**
+ * @brief Parse command line arguments
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @param config Configuration object to populate
+ * @return true if the server should be started, false otherwise
+ */
+bool parseArguments(int argc, char* argv[], std::shared_ptr<TftpConfig>& config) {
+    std::string config_file;
+    bool test_config = false;
+    int workers = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return false;
+        } else if (arg == "--version" || arg == "-v") {
+            printVersion();
+            return false;
+        } else if ((arg == "--config" || arg == "-c") && has_value) {
+            config_file = argv[++i];
+        } else if (arg == "--verbose" || arg == "-V") {
+            config->setLogLevel(LogLevel::DEBUG);
+        } else if (arg == "--test-config") {
+            test_config = true;
+        } else if (arg == "--listen" && has_value) {
+            config->setListenAddress(argv[++i]);
+        } else if ((arg == "--port" || arg == "--workers") && has_value) {
+            try {
+                int value = std::stoi(argv[++i]);
+                if (arg == "--port") {
+                    config->setListenPort(static_cast<port_t>(value));
+                } else {
+                    workers = value;
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Error: Invalid number for " << arg << ": " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--root" && has_value) {
+            config->setRootDirectory(argv[++i]);
+        } else {
+            std::cerr << "Error: Unknown option or missing value: " << arg << std::endl;
+            printUsage();
+            return false;
+        }
+    }
+
+    if (!config_file.empty()) {
+        if (!config->loadFromFile(config_file)) {
+            std::cerr << "Error: Failed to load configuration file: " << config_file << std::endl;
+            return false;
+        }
+        g_config_file = config_file;
+    }
+    // The command line wins over the file
+    if (workers > 0) {
+        config->setWorkers(static_cast<uint32_t>(workers));
+    }
+
+    if (test_config) {
+        std::cout << (config->validate() ? "Configuration is valid" : "Configuration is invalid") << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Run one server until shutdown is requested
+ * @param config Server configuration
+ * @param shared_cache Content cache shared with the other workers, or null
+ * @param connections_suffix Appended to monitoring.connections_file
+ * @param publish Called periodically with the server's metrics
+ * @return Exit code
+ */
+int runServer(std::shared_ptr<TftpConfig> config, std::shared_ptr<TftpSharedContentCache> shared_cache,
+              const std::string& connections_suffix, const std::function<void(const ServerMetrics&)>& publish) {
+    auto server = std::make_shared<TftpServer>(config, g_logger);
+    if (!g_config_file.empty()) {
+        server->setConfigFile(g_config_file);
+    }
+    server->setSharedCache(shared_cache);
+    server->setConnectionsFileSuffix(connections_suffix);
+
+    if (!server->start()) {
+        g_logger->error("Failed to start TFTP server");
+        return 1;
+    }
+
+    while (!g_shutdown_requested && server->isRunning()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (g_reload_requested.exchange(false)) {
+            if (server->reloadConfig()) {
+                g_logger->info("Configuration reloaded successfully");
+            } else {
+                g_logger->error("Failed to reload configuration");
+            }
+        }
+        if (g_metrics_requested.exchange(false)) {
+            g_logger->info("Metrics: " + server->getMetricsJson());
+        }
+        publish(server->getMetrics());
+    }
+
+    server->stop();
+    publish(server->getMetrics());
     return 0;
 }
+
+/**
+ * @brief Main function
+ * @param argc Argument count
+ * @param argv Argument vector
+ * @return Exit code
+ */
+int main(int argc, char* argv[]) {
+    try {
+        auto config = std::make_shared<TftpConfig>();
+        if (!parseArguments(argc, argv, config)) {
+            return 0;
+        }
+        if (!config->validate()) {
+            std::cerr << "Error: Invalid configuration" << std::endl;
+            return 1;
+        }
+
+        g_logger = std::make_shared<Logger>(config->getLogFile(), config->getLogLevel(),
+                                            config->isConsoleLoggingEnabled());
+        g_logger->info("Starting simple-tftpd v0.3.0 (datacenter)");
+        initializeSignalHandlers();
+
+        size_t workers = config->getWorkers();
+        if (workers <= 1) {
+            return runServer(config, nullptr, "", [](const ServerMetrics&) {});
+        }
+
+        // Mapped before forking so every worker shares the same pages
+        std::shared_ptr<TftpSharedContentCache> shared_cache =
+            TftpSharedContentCache::create(config->getSharedCacheSize());
+        if (shared_cache) {
+            g_logger->info("Shared content cache: " + std::to_string(shared_cache->getStats().capacity) + " bytes");
+        } else if (config->getSharedCacheSize() > 0) {
+            g_logger->warning("Shared content cache unavailable; each worker uses its own block cache");
+        }
+
+        TftpPreforkSupervisor supervisor(workers, g_logger);
+        bool started = supervisor.start([&](size_t index) {
+#ifdef PLATFORM_LINUX
+            // Do not outlive a supervisor that was killed outright
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+            return runServer(config, shared_cache, "." + std::to_string(index),
+                             [&supervisor, index](const ServerMetrics& metrics) {
+                                 supervisor.publish(index, metrics);
+                             });
+        });
+        if (!started) {
+            g_logger->error("Failed to start worker processes");
+            return 1;
+        }
+        g_logger->info("Listening on " + config->getListenAddress() + ":" +
+                       std::to_string(config->getListenPort()) + " with " + std::to_string(workers) + " workers");
+
+        while (!g_shutdown_requested) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            supervisor.supervise();
+            if (g_reload_requested.exchange(false)) {
+                g_logger->info("Received SIGHUP, reloading configuration in all workers");
+                supervisor.reload();
+            }
+            if (g_metrics_requested.exchange(false)) {
+                g_logger->info("Metrics (" + std::to_string(workers) + " workers): " + supervisor.getMetricsJson());
+            }
+        }
+
+        g_logger->info("Stopping worker processes");
+        supervisor.stop();
+        g_logger->info("Metrics (" + std::to_string(workers) + " workers): " + supervisor.getMetricsJson());
+        return 0;
+
+    } catch (const std::exception& e) {
+        if (g_logger) {
+            g_logger->fatal("Fatal error: " + std::string(e.what()));
+        } else {
+            std::cerr << "Fatal error: " << e.what() << std::endl;
+        }
+        return 1;
+    }
+}
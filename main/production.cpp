@@ -18,8 +18,14 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
 #include <signal.h>
 #include <csignal>
+#include <json/json.h>
 #include "simple-tftpd/core/tftp/server.hpp"
 #include "simple-tftpd/core/config/config.hpp"
 #include "simple-tftpd/core/utils/logger.hpp"
@@ -90,12 +96,159 @@ void printUsage() {
     std::cout << "  test                 Test server configuration" << std::endl;
     std::cout << "  stats                Show server statistics" << std::endl;
     std::cout << "  connections          List active connections" << std::endl;
+    std::cout << "    --watch            Refresh the connection table continuously" << std::endl;
+    std::cout << "    --interval SECS    Refresh interval for --watch (default: 1)" << std::endl;
+    std::cout << "    --status-file FILE Read the status file instead of monitoring.connections_file" << std::endl;
 
     std::cout << "\nExamples:" << std::endl;
     std::cout << "  simple-tftpd start --config /etc/simple-tftpd/config.json" << std::endl;
     std::cout << "  simple-tftpd start --listen 0.0.0.0 --port 69 --root /var/tftp" << std::endl;
     std::cout << "  simple-tftpd --daemon start" << std::endl;
     std::cout << "  simple-tftpd status" << std::endl;
+    std::cout << "  simple-tftpd --config /etc/simple-tftpd/config.json connections --watch" << std::endl;
+}
+
+/**
+ * @brief Format a byte count for the connections table
+ * @param bytes Byte count
+ * @return Human readable size
+ */
+std::string formatBytes(double bytes) {
+    static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    size_t unit = 0;
+    while (bytes >= 1024.0 && unit < 4) {
+        bytes /= 1024.0;
+        ++unit;
+    }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << units[unit];
+    return ss.str();
+}
+
+/**
+ * @brief Render one frame of the connections table from a status file
+ * @param status_file Path to the connections status file written by the server
+ * @return true if the file was read and rendered, false otherwise
+ */
+bool renderConnections(const std::string& status_file) {
+    std::ifstream file(status_file);
+    if (!file.is_open()) {
+        std::cerr << "Error: Cannot open connections status file: " << status_file << std::endl;
+        return false;
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errors;
+    if (!Json::parseFromStream(builder, file, &root, &errors)) {
+        std::cerr << "Error: Invalid connections status file: " << errors << std::endl;
+        return false;
+    }
+
+    std::vector<Json::Value> connections;
+    for (const auto& entry : root["connections"]) {
+        connections.push_back(entry);
+    }
+
+    // Slowest active transfers first - those are the ones worth looking at during an incident
+    std::sort(connections.begin(), connections.end(), [](const Json::Value& a, const Json::Value& b) {
+        return a["throughput_bps"].asDouble() < b["throughput_bps"].asDouble();
+    });
+
+    auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    auto age_s = (now_ms - root["timestamp_ms"].asInt64()) / 1000;
+
+    std::cout << "simple-tftpd connections: " << connections.size() << " active, uptime "
+              << root["uptime_seconds"].asUInt64() << "s";
+    if (age_s > 5) {
+        std::cout << " (status is " << age_s << "s old, server may be down)";
+    }
+    std::cout << std::endl << std::endl;
+
+    std::cout << std::left << std::setw(22) << "CLIENT" << std::setw(6) << "DIR"
+              << std::setw(13) << "STATE" << std::right << std::setw(7) << "DONE"
+              << std::setw(11) << "BYTES" << std::setw(12) << "RATE/s" << std::setw(6) << "BLK"
+              << std::setw(5) << "WIN" << std::setw(5) << "INF" << std::setw(7) << "RETX"
+              << std::setw(7) << "DUPACK" << std::setw(7) << "DUPDAT" << std::setw(9) << "RTT(ms)" << "  " << std::left << "FILE"
+              << std::endl;
+
+    for (const auto& c : connections) {
+        double percent = c["percent_complete"].asDouble();
+        std::ostringstream done;
+        if (percent < 0) {
+            done << "?";
+        } else {
+            done << std::fixed << std::setprecision(1) << percent << "%";
+        }
+        std::ostringstream rtt;
+        rtt << std::fixed << std::setprecision(2) << c["rtt_us"].asDouble() / 1000.0;
+
+        std::cout << std::left << std::setw(22) << c["client"].asString()
+                  << std::setw(6) << c["direction"].asString()
+                  << std::setw(13) << c["state"].asString()
+                  << std::right << std::setw(7) << done.str()
+                  << std::setw(11) << formatBytes(c["bytes_transferred"].asDouble())
+                  << std::setw(12) << formatBytes(c["throughput_bps"].asDouble())
+                  << std::setw(6) << c["block_size"].asUInt()
+                  << std::setw(5) << c["effective_window"].asUInt()
+                  << std::setw(5) << c["in_flight"].asUInt()
+                  << std::setw(7) << c["retransmits"].asUInt64()
+                  << std::setw(7) << c["duplicate_acks"].asUInt64()
+                  << std::setw(7) << c["duplicate_data"].asUInt64()
+                  << std::setw(9) << rtt.str()
+                  << "  " << std::left << c["filename"].asString() << std::endl;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Run the connections command
+ * @param config Loaded configuration
+ * @param args Arguments following the command
+ * @return Process exit code
+ */
+int runConnectionsCommand(const std::shared_ptr<TftpConfig>& config, const std::vector<std::string>& args) {
+    bool watch = false;
+    int interval = 1;
+    std::string status_file = config->getConnectionsFile();
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--watch" || args[i] == "-w") {
+            watch = true;
+        } else if (args[i] == "--interval" && i + 1 < args.size()) {
+            try {
+                interval = std::max(1, std::stoi(args[++i]));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Invalid interval: " << args[i] << std::endl;
+                return 1;
+            }
+        } else if (args[i] == "--status-file" && i + 1 < args.size()) {
+            status_file = args[++i];
+        } else {
+            std::cerr << "Error: Unknown connections option: " << args[i] << std::endl;
+            return 1;
+        }
+    }
+
+    if (status_file.empty()) {
+        std::cerr << "Error: No status file; set monitoring.connections_file or pass --status-file" << std::endl;
+        return 1;
+    }
+
+    if (!watch) {
+        return renderConnections(status_file) ? 0 : 1;
+    }
+
+    while (!g_shutdown_requested.load()) {
+        // Clear screen and home the cursor, like top
+        std::cout << "\033[2J\033[H";
+        renderConnections(status_file);
+        std::cout << std::flush;
+        std::this_thread::sleep_for(std::chrono::seconds(interval));
+    }
+    return 0;
 }
 
 /**
@@ -113,15 +266,17 @@ void printVersion() {
  * @param argc Argument count
  * @param argv Argument vector
  * @param config Configuration object to populate
- * @return true if parsed successfully, false otherwise
+ * @param exit_code Set when a command ran to completion without starting the server
+ * @return true if the server should be started, false otherwise
  */
-bool parseArguments(int argc, char* argv[], std::shared_ptr<TftpConfig>& config) {
+bool parseArguments(int argc, char* argv[], std::shared_ptr<TftpConfig>& config, int& exit_code) {
     std::string config_file;
     bool run_daemon = false;
     bool run_foreground = false;
     bool test_config = false;
     bool validate_config = false;
     std::string command;
+    std::vector<std::string> command_args;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -179,6 +334,7 @@ bool parseArguments(int argc, char* argv[], std::shared_ptr<TftpConfig>& config)
         } else if (arg[0] != '-') {
             // This is a command
             command = arg;
+            command_args.assign(argv + i + 1, argv + argc);
             break;
         } else {
             std::cerr << "Error: Unknown option: " << arg << std::endl;
@@ -215,6 +371,12 @@ bool parseArguments(int argc, char* argv[], std::shared_ptr<TftpConfig>& config)
         return false;
     }
 
+    if (command == "connections") {
+        signal(SIGINT, [](int) { g_shutdown_requested.store(true); });
+        exit_code = runConnectionsCommand(config, command_args);
+        return false;
+    }
+
     return true;
 }
 
@@ -246,8 +408,9 @@ int main(int argc, char* argv[]) {
         auto config = std::make_shared<TftpConfig>();
 
         // Parse command line arguments
-        if (!parseArguments(argc, argv, config)) {
-            return 0;
+        int exit_code = 0;
+        if (!parseArguments(argc, argv, config, exit_code)) {
+            return exit_code;
         }
 
         // Create logger
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+# Benchmark Regression Check
+# Copyright 2024 SimpleDaemons
+# Licensed under Apache License 2.0
+#
+# Compares two Google Benchmark JSON files (--benchmark_out_format=json)
+# and flags benchmarks whose time grew by more than the threshold.
+#
+# Usage: compare-benchmarks.py BASELINE.json CANDIDATE.json [--threshold 10]
+#            [--metric real_time|cpu_time] [--filter REGEX]
+#
+# Exit status: 0 no regressions, 1 regressions found, 2 usage/input error.
+
+import argparse
+import json
+import re
+import sys
+
+UNIT_TO_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load_results(path, metric):
+    """Return {benchmark name: time in ns}.
+
+    With repetitions the median aggregate is used; otherwise the single
+    iteration entry. Error/skipped entries are ignored.
+    """
+    try:
+        with open(path, "r", encoding="utf-8") as handle:
+            document = json.load(handle)
+    except (OSError, ValueError) as exc:
+        print(f"error: cannot read {path}: {exc}", file=sys.stderr)
+        sys.exit(2)
+
+    iterations = {}
+    medians = {}
+    for entry in document.get("benchmarks", []):
+        if entry.get("error_occurred") or metric not in entry:
+            continue
+        name = entry.get("run_name", entry["name"])
+        value = entry[metric] * UNIT_TO_NS.get(entry.get("time_unit", "ns"), 1.0)
+        if entry.get("run_type") == "aggregate":
+            if entry.get("aggregate_name") == "median":
+                medians[name] = value
+        else:
+            iterations.setdefault(name, []).append(value)
+
+    results = {}
+    for name, values in iterations.items():
+        values.sort()
+        results[name] = values[len(values) // 2]
+    results.update(medians)
+    return results
+
+
+def format_ns(value):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if value >= scale:
+            return f"{value / scale:.2f} {unit}"
+    return f"{value:.1f} ns"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag regressions between two benchmark runs")
+    parser.add_argument("baseline", help="JSON output of the reference run")
+    parser.add_argument("candidate", help="JSON output of the run under test")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent slowdown that counts as a regression (default: 10)")
+    parser.add_argument("--metric", choices=("real_time", "cpu_time"), default="cpu_time",
+                        help="timing field to compare (default: cpu_time)")
+    parser.add_argument("--filter", default=None, help="only compare names matching REGEX")
+    args = parser.parse_args()
+
+    baseline = load_results(args.baseline, args.metric)
+    candidate = load_results(args.candidate, args.metric)
+    pattern = re.compile(args.filter) if args.filter else None
+
+    names = sorted(set(baseline) | set(candidate))
+    if pattern:
+        names = [name for name in names if pattern.search(name)]
+    if not names:
+        print("error: no benchmarks to compare", file=sys.stderr)
+        return 2
+
+    width = max(len(name) for name in names)
+    print(f"{'Benchmark':<{width}}  {'Baseline':>12}  {'Candidate':>12}  {'Change':>8}")
+    print("-" * (width + 40))
+
+    regressions = []
+    for name in names:
+        old = baseline.get(name)
+        new = candidate.get(name)
+        if old is None or new is None:
+            status = "only in candidate" if old is None else "only in baseline"
+            print(f"{name:<{width}}  {status}")
+            continue
+
+        change = (new - old) / old * 100.0 if old > 0 else 0.0
+        marker = ""
+        if change > args.threshold:
+            marker = "  REGRESSION"
+            regressions.append((name, change))
+        elif change < -args.threshold:
+            marker = "  improved"
+        print(f"{name:<{width}}  {format_ns(old):>12}  {format_ns(new):>12}  {change:+7.1f}%{marker}")
+
+    print()
+    if regressions:
+        print(f"{len(regressions)} regression(s) above {args.threshold:.1f}%:")
+        for name, change in regressions:
+            print(f"  {name}: {change:+.1f}%")
+        return 1
+
+    print(f"No regressions above {args.threshold:.1f}%")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
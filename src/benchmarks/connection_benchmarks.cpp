@@ -0,0 +1,304 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <benchmark/benchmark.h>
+#include "simple-tftpd/core/tftp/connection.hpp"
+#include "simple-tftpd/core/tftp/server.hpp"
+#include "simple-tftpd/core/tftp/send_window.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/utils/logger.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace simple_tftpd;
+
+namespace {
+
+/**
+ * @brief Server/connection pair that is never started (no sockets, no threads)
+ */
+struct ConnectionFixture {
+    std::shared_ptr<TftpConfig> config = std::make_shared<TftpConfig>();
+    std::shared_ptr<Logger> logger = std::make_shared<Logger>("", LogLevel::FATAL, false);
+    TftpServer server{config, logger};
+    TftpConnection connection{server, "127.0.0.1", 40000, config, logger};
+};
+
+/**
+ * @brief Config-file style text: ~40 byte lines, LF or CRLF terminated
+ */
+std::vector<uint8_t> makeText(size_t size, bool crlf) {
+    static const char line[] = "label linux\n  kernel vmlinuz initrd=init.img\n";
+    std::vector<uint8_t> text;
+    text.reserve(size + size / 16);
+    while (text.size() < size) {
+        for (const char* p = line; *p != '\0' && text.size() < size; ++p) {
+            if (*p == '\n' && crlf) {
+                text.push_back('\r');
+            }
+            text.push_back(static_cast<uint8_t>(*p));
+        }
+    }
+    return text;
+}
+
+constexpr size_t WINDOW_SESSIONS = 10000;
+constexpr uint16_t WINDOW_SIZE = 64;
+
+/**
+ * @brief In-flight tracking as it was before TftpSendWindow: one map node
+ * and one payload vector per block. Kept as the baseline for comparison.
+ */
+struct MapInFlightBlock {
+    std::vector<uint8_t> payload;
+    size_t payload_size = 0;
+    bool is_final = false;
+    std::chrono::steady_clock::time_point last_sent;
+    size_t retries = 0;
+};
+using MapWindow = std::map<uint16_t, MapInFlightBlock>;
+
+// Payload buffers start empty; the ACK benchmarks fill them as they go
+std::vector<TftpSendWindow> makeRingSessions(uint16_t block_size) {
+    std::vector<TftpSendWindow> sessions(WINDOW_SESSIONS);
+    auto now = std::chrono::steady_clock::now();
+    for (auto& window : sessions) {
+        window.reset(WINDOW_SIZE, 1);
+        for (uint16_t i = 0; i < WINDOW_SIZE; ++i) {
+            TftpInFlightBlock& block = window.next();
+            block.payload_size = block_size;
+            block.last_sent = now;
+            window.push();
+        }
+    }
+    return sessions;
+}
+
+std::vector<MapWindow> makeMapSessions(uint16_t block_size) {
+    std::vector<MapWindow> sessions(WINDOW_SESSIONS);
+    auto now = std::chrono::steady_clock::now();
+    for (auto& window : sessions) {
+        for (uint16_t block = 1; block <= WINDOW_SIZE; ++block) {
+            MapInFlightBlock& entry = window[block];
+            entry.payload_size = block_size;
+            entry.last_sent = now;
+        }
+    }
+    return sessions;
+}
+
+} // namespace
+
+static void BM_ProcessDataOctet(benchmark::State& state) {
+    ConnectionFixture fixture;
+    const std::vector<uint8_t> block = makeText(static_cast<size_t>(state.range(0)), false);
+    for (auto _ : state) {
+        std::vector<uint8_t> out = fixture.connection.processDataForMode(block, TftpMode::OCTET, true);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ProcessDataOctet)->Arg(512)->Arg(1428)->Arg(8192);
+
+static void BM_ProcessDataNetasciiSend(benchmark::State& state) {
+    ConnectionFixture fixture;
+    const std::vector<uint8_t> block = makeText(static_cast<size_t>(state.range(0)), false);
+    for (auto _ : state) {
+        std::vector<uint8_t> out = fixture.connection.processDataForMode(block, TftpMode::NETASCII, true);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ProcessDataNetasciiSend)->Arg(512)->Arg(1428)->Arg(8192);
+
+static void BM_ProcessDataNetasciiReceive(benchmark::State& state) {
+    ConnectionFixture fixture;
+    const std::vector<uint8_t> block = makeText(static_cast<size_t>(state.range(0)), true);
+    for (auto _ : state) {
+        std::vector<uint8_t> out = fixture.connection.processDataForMode(block, TftpMode::NETASCII, false);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_ProcessDataNetasciiReceive)->Arg(512)->Arg(1428)->Arg(8192);
+
+/**
+ * @brief Per-packet connection lookup as done by the listener: build the
+ * TID key, take the table lock and find the entry. Arg is the table size.
+ */
+static void BM_ConnectionTableLookup(benchmark::State& state) {
+    ConnectionFixture fixture;
+    const size_t count = static_cast<size_t>(state.range(0));
+
+    TftpServer::ConnectionTable table;
+    std::vector<std::pair<std::string, port_t>> peers;
+    peers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string addr = "10.0." + std::to_string((i >> 8) & 0xff) + "." + std::to_string(i & 0xff);
+        port_t port = static_cast<port_t>(49152 + (i % 16384));
+        peers.emplace_back(addr, port);
+        table[TftpServer::generateConnectionKey(addr, port)] =
+            std::make_shared<TftpConnection>(fixture.server, addr, port, fixture.config, fixture.logger);
+    }
+    std::mutex table_mutex;
+
+    size_t next = 0;
+    for (auto _ : state) {
+        const auto& peer = peers[next];
+        next = (next + 7919) % count;
+        std::string key = TftpServer::generateConnectionKey(peer.first, peer.second);
+        std::lock_guard<std::mutex> lock(table_mutex);
+        auto it = table.find(key);
+        benchmark::DoNotOptimize(it);
+    }
+}
+BENCHMARK(BM_ConnectionTableLookup)->Arg(16)->Arg(1024)->Arg(16384);
+
+/**
+ * @brief Warm block cache lookup for a popular file, as done per RRQ.
+ * Threads model simultaneous readers of the same image.
+ */
+static void BM_BlockCacheAcquireHit(benchmark::State& state) {
+    static TftpBlockCache cache(64 * 1024 * 1024);
+    TftpBlockCacheKey key;
+    key.path = "/srv/tftp/vmlinuz";
+    key.file_size = 4 * 1024 * 1024;
+    key.block_size = 1428;
+    auto loader = [&key](std::vector<uint8_t>& stream) {
+        stream.assign(static_cast<size_t>(key.file_size), 0x5A);
+        return true;
+    };
+
+    bool was_cached = false;
+    for (auto _ : state) {
+        auto stream = cache.acquire(key, loader, was_cached);
+        benchmark::DoNotOptimize(stream.get());
+    }
+}
+BENCHMARK(BM_BlockCacheAcquireHit)->ThreadRange(1, 8)->UseRealTime();
+
+/**
+ * @brief Per-block cost on a cache hit: fetch the ready frame (the send
+ * itself is excluded). Compare with BM_ProcessDataNetasciiSend plus
+ * BM_CodecEncodeData for the uncached path.
+ */
+static void BM_BlockCacheFrame(benchmark::State& state) {
+    const uint16_t block_size = static_cast<uint16_t>(state.range(0));
+    TftpBlockStream stream(makeText(1024 * 1024, false), block_size);
+
+    size_t index = 0;
+    for (auto _ : state) {
+        ByteView frame = stream.frame(index);
+        benchmark::DoNotOptimize(frame.data);
+        index = (index + 1) % stream.frameCount();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * block_size);
+}
+BENCHMARK(BM_BlockCacheFrame)->Arg(512)->Arg(1428)->Arg(8192);
+
+/**
+ * @brief One worker tick over 10k sessions with full 64-block windows,
+ * none expired: the ring checks its oldest send time only
+ */
+static void BM_SendWindowTimerScan(benchmark::State& state) {
+    std::vector<TftpSendWindow> sessions = makeRingSessions(512);
+    const auto timeout = std::chrono::seconds(5);
+    for (auto _ : state) {
+        auto now = std::chrono::steady_clock::now();
+        size_t expired = 0;
+        for (const auto& window : sessions) {
+            expired += window.mayHaveExpired(now, timeout) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(expired);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * WINDOW_SESSIONS));
+}
+BENCHMARK(BM_SendWindowTimerScan)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief The same tick with the map baseline, which visits every block
+ */
+static void BM_SendWindowTimerScanMap(benchmark::State& state) {
+    std::vector<MapWindow> sessions = makeMapSessions(512);
+    const auto timeout = std::chrono::seconds(5);
+    for (auto _ : state) {
+        auto now = std::chrono::steady_clock::now();
+        size_t expired = 0;
+        for (const auto& window : sessions) {
+            for (const auto& entry : window) {
+                auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - entry.second.last_sent);
+                expired += elapsed >= timeout ? 1 : 0;
+            }
+        }
+        benchmark::DoNotOptimize(expired);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * WINDOW_SESSIONS));
+}
+BENCHMARK(BM_SendWindowTimerScanMap)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief ACK one block and send the next, round-robin over 10k sessions
+ * with 64-block windows of 512-byte payloads (payload copy included)
+ */
+static void BM_SendWindowAck(benchmark::State& state) {
+    std::vector<TftpSendWindow> sessions = makeRingSessions(512);
+    const std::vector<uint8_t> payload(512, 0xA5);
+    size_t next = 0;
+    for (auto _ : state) {
+        TftpSendWindow& window = sessions[next];
+        next = (next + 1) % sessions.size();
+        TftpWindowAck ack = window.acknowledge(window.base());
+        TftpInFlightBlock& block = window.next();
+        block.payload.assign(payload.begin(), payload.end());
+        block.payload_size = static_cast<uint32_t>(payload.size());
+        block.last_sent = std::chrono::steady_clock::now();
+        window.push();
+        benchmark::DoNotOptimize(ack.bytes);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_SendWindowAck);
+
+/**
+ * @brief The same ACK and send with the map baseline
+ */
+static void BM_SendWindowAckMap(benchmark::State& state) {
+    std::vector<MapWindow> sessions = makeMapSessions(512);
+    std::vector<uint16_t> bases(sessions.size(), 1);
+    const std::vector<uint8_t> payload(512, 0xA5);
+    size_t next = 0;
+    for (auto _ : state) {
+        MapWindow& window = sessions[next];
+        uint16_t& base = bases[next];
+        next = (next + 1) % sessions.size();
+        auto it = window.find(base);
+        size_t bytes = it->second.payload_size;
+        window.erase(it);
+        MapInFlightBlock block;
+        block.payload = payload;
+        block.payload_size = payload.size();
+        block.last_sent = std::chrono::steady_clock::now();
+        window[static_cast<uint16_t>(base + WINDOW_SIZE)] = std::move(block);
+        ++base;
+        benchmark::DoNotOptimize(bytes);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_SendWindowAckMap);
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <benchmark/benchmark.h>
+#include "simple-tftpd/core/tftp/packet.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+using namespace simple_tftpd;
+
+namespace {
+
+/**
+ * @brief Build DATA block payloads with a non-trivial byte pattern
+ */
+std::vector<uint8_t> makePayload(size_t size) {
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; ++i) {
+        payload[i] = static_cast<uint8_t>((i * 31u) ^ (i >> 8));
+    }
+    return payload;
+}
+
+/**
+ * @brief RRQ as sent by PXE/iPXE clients: blksize, tsize and windowsize
+ */
+std::vector<uint8_t> makeRequestWithOptions() {
+    TftpRequestPacket request(TftpOpcode::RRQ, "pxelinux.cfg/01-aa-bb-cc-dd-ee-ff", TftpMode::OCTET);
+    TftpOptions options;
+    options.blksize = 1428;
+    options.has_blksize = true;
+    options.tsize = 0;
+    options.has_tsize = true;
+    options.windowsize = 8;
+    options.has_windowsize = true;
+    options.timeout = 3;
+    options.has_timeout = true;
+    request.setOptions(options);
+    return request.serialize();
+}
+
+} // namespace
+
+static void BM_RequestParseWithOptions(benchmark::State& state) {
+    const std::vector<uint8_t> wire = makeRequestWithOptions();
+    for (auto _ : state) {
+        TftpRequestPacket request(wire.data(), wire.size());
+        benchmark::DoNotOptimize(request.getOptions().blksize);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(wire.size()));
+}
+BENCHMARK(BM_RequestParseWithOptions);
+
+static void BM_RequestSerializeWithOptions(benchmark::State& state) {
+    const std::vector<uint8_t> wire = makeRequestWithOptions();
+    TftpRequestPacket request(wire.data(), wire.size());
+    for (auto _ : state) {
+        std::vector<uint8_t> out = request.serialize();
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_RequestSerializeWithOptions);
+
+static void BM_DataSerialize(benchmark::State& state) {
+    const std::vector<uint8_t> payload = makePayload(static_cast<size_t>(state.range(0)));
+    uint16_t block = 1;
+    for (auto _ : state) {
+        TftpDataPacket packet(block++, payload);
+        std::vector<uint8_t> out = packet.serialize();
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_DataSerialize)->Arg(512)->Arg(1428)->Arg(8192);
+
+static void BM_DataParse(benchmark::State& state) {
+    const std::vector<uint8_t> wire =
+        TftpDataPacket(42, makePayload(static_cast<size_t>(state.range(0)))).serialize();
+    for (auto _ : state) {
+        TftpDataPacket packet(wire.data(), wire.size());
+        benchmark::DoNotOptimize(packet.getFileData().data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_DataParse)->Arg(512)->Arg(1428)->Arg(8192);
+
+static void BM_AckRoundTrip(benchmark::State& state) {
+    uint16_t block = 1;
+    for (auto _ : state) {
+        std::vector<uint8_t> wire = TftpAckPacket(block++).serialize();
+        TftpAckPacket parsed(wire.data(), wire.size());
+        benchmark::DoNotOptimize(parsed.getBlockNumber());
+    }
+}
+BENCHMARK(BM_AckRoundTrip);
+
+// TftpCodec: same operations on views and caller-owned buffers (no allocation)
+
+static void BM_CodecDecodeRequest(benchmark::State& state) {
+    const std::vector<uint8_t> wire = makeRequestWithOptions();
+    for (auto _ : state) {
+        TftpRequestView view;
+        bool ok = TftpCodec::decodeRequest(wire.data(), wire.size(), view);
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(view.options.size);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(wire.size()));
+}
+BENCHMARK(BM_CodecDecodeRequest);
+
+static void BM_CodecEncodeRequest(benchmark::State& state) {
+    const std::vector<uint8_t> wire = makeRequestWithOptions();
+    TftpRequestPacket request(wire.data(), wire.size());
+    const std::string filename = request.getFilename();
+    const TftpOptions options = request.getOptions();
+    std::vector<uint8_t> out(512);
+    for (auto _ : state) {
+        size_t length = TftpCodec::encodeRequest(out.data(), out.size(), TftpOpcode::RRQ,
+                                                 filename, TftpMode::OCTET, options);
+        benchmark::DoNotOptimize(length);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_CodecEncodeRequest);
+
+static void BM_CodecEncodeData(benchmark::State& state) {
+    const std::vector<uint8_t> payload = makePayload(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> out(TftpCodec::HEADER_SIZE + payload.size());
+    uint16_t block = 1;
+    for (auto _ : state) {
+        size_t length = TftpCodec::encodeData(out.data(), out.size(), block++,
+                                              ByteView(payload.data(), payload.size()));
+        benchmark::DoNotOptimize(length);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_CodecEncodeData)->Arg(512)->Arg(1428)->Arg(8192);
+
+static void BM_CodecDecodeData(benchmark::State& state) {
+    const std::vector<uint8_t> wire =
+        TftpDataPacket(42, makePayload(static_cast<size_t>(state.range(0)))).serialize();
+    for (auto _ : state) {
+        TftpDataView view;
+        bool ok = TftpCodec::decodeData(wire.data(), wire.size(), view);
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(view.payload.data);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+}
+BENCHMARK(BM_CodecDecodeData)->Arg(512)->Arg(1428)->Arg(8192);
+
+static void BM_CodecAckRoundTrip(benchmark::State& state) {
+    uint8_t wire[TftpCodec::HEADER_SIZE];
+    uint16_t block = 1;
+    for (auto _ : state) {
+        size_t length = TftpCodec::encodeAck(wire, sizeof(wire), block++);
+        TftpAckView view;
+        TftpCodec::decodeAck(wire, length, view);
+        benchmark::DoNotOptimize(view.block);
+    }
+}
+BENCHMARK(BM_CodecAckRoundTrip);
+
+static void BM_CodecDecodeOptions(benchmark::State& state) {
+    const std::vector<uint8_t> wire = makeRequestWithOptions();
+    TftpRequestView view;
+    TftpCodec::decodeRequest(wire.data(), wire.size(), view);
+    for (auto _ : state) {
+        TftpOptions options;
+        TftpCodec::decodeOptions(view.options, options);
+        benchmark::DoNotOptimize(options);
+    }
+}
+BENCHMARK(BM_CodecDecodeOptions);
+
+/**
+ * @brief Request padded with malformed and unknown options, as sent by a
+ * misbehaving client; must stay linear and exception-free
+ */
+static void BM_RequestParseMalformedOptions(benchmark::State& state) {
+    std::vector<uint8_t> wire = makeRequestWithOptions();
+    static const char junk[][16] = {"BLKSIZE", "12abc", "tsize", "-1", "rollover", "0", "timeout", ""};
+    while (wire.size() < 1400) {
+        for (const char* token : junk) {
+            wire.insert(wire.end(), token, token + std::strlen(token));
+            wire.push_back(0);
+        }
+    }
+    for (auto _ : state) {
+        TftpRequestPacket request(wire.data(), wire.size());
+        benchmark::DoNotOptimize(request.getOptions().blksize);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(wire.size()));
+}
+BENCHMARK(BM_RequestParseMalformedOptions);
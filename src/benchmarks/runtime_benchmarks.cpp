@@ -0,0 +1,358 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <benchmark/benchmark.h>
+#include "simple-tftpd/core/config/access_policy.hpp"
+#include "simple-tftpd/core/config/remap_rules.hpp"
+#include "simple-tftpd/core/tftp/cluster.hpp"
+#include "simple-tftpd/core/tftp/filename_index.hpp"
+#include "simple-tftpd/core/tftp/metadata_cache.hpp"
+#include "simple-tftpd/core/tftp/monitoring.hpp"
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include "simple-tftpd/core/utils/logger.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace simple_tftpd;
+
+static void BM_MonitoringRecordTransfer(benchmark::State& state) {
+    static Monitoring* monitoring = nullptr;
+    if (state.thread_index() == 0) {
+        monitoring = new Monitoring();
+    }
+    for (auto _ : state) {
+        monitoring->recordTransfer(1428, true, 3);
+    }
+    if (state.thread_index() == 0) {
+        delete monitoring;
+        monitoring = nullptr;
+    }
+}
+BENCHMARK(BM_MonitoringRecordTransfer)->ThreadRange(1, 8)->UseRealTime();
+
+static void BM_MonitoringRecordConnection(benchmark::State& state) {
+    Monitoring monitoring;
+    for (auto _ : state) {
+        monitoring.recordConnection(true);
+        monitoring.updateActiveConnections(32);
+    }
+}
+BENCHMARK(BM_MonitoringRecordConnection);
+
+static void BM_MonitoringMetricsJson(benchmark::State& state) {
+    Monitoring monitoring;
+    monitoring.recordTransfer(1 << 20, true, 250);
+    for (auto _ : state) {
+        std::string json = monitoring.getMetricsJson();
+        benchmark::DoNotOptimize(json.data());
+    }
+}
+BENCHMARK(BM_MonitoringMetricsJson);
+
+/**
+ * @brief Per-packet DEBUG call site with DEBUG disabled (the common case):
+ * the message is still built before the level check
+ */
+static void BM_LoggerFilteredDebug(benchmark::State& state) {
+    Logger logger("", LogLevel::INFO, false);
+    uint16_t block = 0;
+    for (auto _ : state) {
+        logger.debug("Handling ACK packet for block " + std::to_string(block++));
+    }
+}
+BENCHMARK(BM_LoggerFilteredDebug);
+
+static void BM_LoggerFileInfo(benchmark::State& state) {
+    char path[] = "/tmp/simple-tftpd-bench-log-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        state.SkipWithError("mkstemp failed");
+        return;
+    }
+    close(fd);
+    {
+        Logger logger(path, LogLevel::INFO, false);
+        for (auto _ : state) {
+            logger.info("Handling read request for file: pxelinux.0");
+        }
+    }
+    std::remove(path);
+}
+BENCHMARK(BM_LoggerFileInfo);
+
+static void BM_LoggerTimestamp(benchmark::State& state) {
+    for (auto _ : state) {
+        std::string ts = Logger::getTimestamp();
+        benchmark::DoNotOptimize(ts.data());
+    }
+}
+BENCHMARK(BM_LoggerTimestamp);
+
+/**
+ * @brief Allowlist of @p count host and /24 rules spread over 10.0.0.0/8
+ */
+static std::vector<std::string> makeClientRules(size_t count) {
+    std::mt19937 rng(42);
+    std::vector<std::string> rules;
+    rules.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = rng();
+        std::string rule = "10." + std::to_string((value >> 16) & 0xFF) + "." +
+                           std::to_string((value >> 8) & 0xFF) + ".";
+        rules.push_back(i % 4 == 0 ? rule + "0/24" : rule + std::to_string(value & 0xFF));
+    }
+    return rules;
+}
+
+static void BM_AccessPolicyCompile(benchmark::State& state) {
+    auto rules = makeClientRules(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        TftpAccessPolicy policy(rules, {}, {});
+        benchmark::DoNotOptimize(policy.clientRuleCount());
+    }
+}
+BENCHMARK(BM_AccessPolicyCompile)->Arg(10000);
+
+/**
+ * @brief Per-packet ACL check on the peer address, alternating hits and misses
+ */
+static void BM_AccessPolicyClientLookup(benchmark::State& state) {
+    auto rules = makeClientRules(static_cast<size_t>(state.range(0)));
+    TftpAccessPolicy policy(rules, {}, {});
+
+    std::vector<struct sockaddr_storage> peers(256);
+    std::mt19937 rng(7);
+    for (size_t i = 0; i < peers.size(); ++i) {
+        auto* peer = reinterpret_cast<struct sockaddr_in*>(&peers[i]);
+        peer->sin_family = AF_INET;
+        const std::string& rule = rules[i % rules.size()];
+        std::string address = (i % 2 == 0) ? rule.substr(0, rule.find('/'))
+                                           : "192.0.2." + std::to_string(rng() & 0xFF);
+        inet_pton(AF_INET, address.c_str(), &peer->sin_addr);
+    }
+
+    size_t index = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(policy.isClientAllowed(peers[index++ & 0xFF]));
+    }
+}
+BENCHMARK(BM_AccessPolicyClientLookup)->Arg(100)->Arg(10000);
+
+static void BM_AccessPolicySnapshotLoad(benchmark::State& state) {
+    static TftpAtomicSnapshot<TftpAccessPolicy> snapshot(
+        std::make_shared<const TftpAccessPolicy>(makeClientRules(10000), std::vector<std::string>{},
+                                                 std::vector<std::string>{}));
+    struct sockaddr_storage peer = {};
+    auto* peer4 = reinterpret_cast<struct sockaddr_in*>(&peer);
+    peer4->sin_family = AF_INET;
+    inet_pton(AF_INET, "192.0.2.1", &peer4->sin_addr);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(snapshot.load()->isClientAllowed(peer));
+    }
+}
+BENCHMARK(BM_AccessPolicySnapshotLoad)->ThreadRange(1, 8)->UseRealTime();
+
+/**
+ * @brief Filesystem work to set up a read of an existing file
+ *
+ * Arg 0 is the sequence openReadFile() used before the metadata cache: an
+ * existence probe, an open to tellg() the size, the transfer's own open and
+ * a last_write_time() for the block cache key. Arg 1 is a metadata lookup
+ * with the cache disabled, Arg 2 with it enabled, each followed by the one
+ * open the transfer makes when it is not served from the block cache.
+ */
+static void BM_ReadRequestSetup(benchmark::State& state) {
+    char directory[] = "/tmp/simple-tftpd-bench-meta-XXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+    std::string path = std::string(directory) + "/pxelinux.0";
+    std::ofstream(path, std::ios::binary) << std::string(42 * 1024, 'x');
+
+    TftpRootHandle root;
+    root.open(directory);
+    TftpDirectoryWatcher watcher;
+    TftpMetadataCache cache(state.range(0) == 2 ? 16 : 0, &watcher);
+    watcher.start();
+
+    uint64_t stats = 0;
+    uint64_t opens = 0;
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            std::ifstream probe(path);
+            benchmark::DoNotOptimize(probe.good());
+            std::ifstream sized(path, std::ios::binary | std::ios::ate);
+            benchmark::DoNotOptimize(sized.tellg());
+            std::ifstream file(path, std::ios::binary);
+            std::error_code error;
+            benchmark::DoNotOptimize(std::filesystem::last_write_time(path, error));
+            stats += 1;
+            opens += 3;
+        } else {
+            TftpFileMetadata metadata;
+            benchmark::DoNotOptimize(cache.lookup(root, "pxelinux.0", metadata));
+            std::ifstream file(path, std::ios::binary);
+            cache.recordOpen();
+        }
+    }
+    if (state.range(0) != 0) {
+        TftpMetadataCacheStats cache_stats = cache.getStats();
+        stats = cache_stats.stat_calls;
+        opens = cache_stats.file_opens;
+    }
+    state.counters["stat_calls"] = benchmark::Counter(static_cast<double>(stats), benchmark::Counter::kAvgIterations);
+    state.counters["file_opens"] = benchmark::Counter(static_cast<double>(opens), benchmark::Counter::kAvgIterations);
+
+    watcher.stop();
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+}
+BENCHMARK(BM_ReadRequestSetup)->Arg(0)->Arg(1)->Arg(2);
+
+/**
+ * @brief Boot-server-like tree of 200 directories with 100 files each, built once
+ */
+static const std::string& indexTree() {
+    struct Tree {
+        std::string root;
+        Tree() {
+            char directory[] = "/tmp/simple-tftpd-bench-index-XXXXXX";
+            if (mkdtemp(directory) == nullptr) {
+                return;
+            }
+            root = directory;
+            for (int d = 0; d < 200; ++d) {
+                std::string dir = root + "/Boot/Images" + std::to_string(d);
+                std::filesystem::create_directories(dir);
+                for (int f = 0; f < 100; ++f) {
+                    std::ofstream(dir + "/Driver" + std::to_string(f) + ".SYS");
+                }
+            }
+        }
+        ~Tree() {
+            std::error_code error;
+            std::filesystem::remove_all(root, error);
+        }
+    };
+    static Tree tree;
+    return tree.root;
+}
+
+static void BM_FilenameIndexBuild(benchmark::State& state) {
+    const std::string& root = indexTree();
+    if (root.empty()) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+    TftpFilenameIndex index(nullptr);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.build(root, static_cast<size_t>(state.range(0))));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * 20000);
+}
+BENCHMARK(BM_FilenameIndexBuild)->Arg(1)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_FilenameIndexResolve(benchmark::State& state) {
+    const std::string& root = indexTree();
+    if (root.empty()) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+    TftpFilenameIndex index(nullptr);
+    index.build(root);
+    std::string resolved;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.resolve("boot\\images137\\DRIVER42.sys", resolved));
+    }
+}
+BENCHMARK(BM_FilenameIndexResolve);
+
+// Remap cost per request with 1,000 migration rules: Arg 0 matches none,
+// Arg 1 rewrites a legacy path, Arg 2 normalizes backslashes first
+static void BM_RemapRules(benchmark::State& state) {
+    std::vector<std::string> lines = {"rg \\\\ /"};
+    for (int i = 1; i < 1000; ++i) {
+        std::string n = std::to_string(i);
+        if (i % 10 == 0) {
+            lines.push_back("r \\.old" + n + "$ .new" + n);
+        } else {
+            lines.push_back("re ^legacy/host" + n + "/(.*)$ hosts/" + n + "/\\1");
+        }
+    }
+    TftpRemapRules rules(lines);
+
+    const char* names[] = {"pxelinux.cfg/01-aa-bb-cc-dd-ee-ff", "legacy/host537/pxelinux.0",
+                           "legacy\\host537\\pxelinux.0"};
+    std::string filename = names[state.range(0)];
+    std::string result;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rules.remap(filename, "192.168.1.10", false, result));
+    }
+    state.counters["states"] = static_cast<double>(rules.stateCount());
+}
+BENCHMARK(BM_RemapRules)->Arg(0)->Arg(1)->Arg(2);
+
+// Opening a file in a root eight levels deep: Arg 0 by full path, Arg 1
+// beneath the held root handle (openat2 where available), Arg 2 with the
+// userspace component walk
+static void BM_RootHandleOpen(benchmark::State& state) {
+    char directory[] = "/tmp/simple-tftpd-bench-root-XXXXXX";
+    if (mkdtemp(directory) == nullptr) {
+        state.SkipWithError("mkdtemp failed");
+        return;
+    }
+    std::string root = std::string(directory) + "/srv/tftp/images/site/a/b/c/d";
+    std::filesystem::create_directories(root + "/boot/x64");
+    std::ofstream(root + "/boot/x64/wdsnbp.com") << "wds";
+
+    TftpRootHandle handle(state.range(0) == 2 ? TftpRootHandle::Resolution::USERSPACE
+                                              : TftpRootHandle::Resolution::AUTO);
+    handle.open(root);
+    std::string full_path = root + "/boot/x64/wdsnbp.com";
+    for (auto _ : state) {
+        TftpFileHandle file = state.range(0) == 0 ? TftpFileHandle::openPath(full_path)
+                                                  : handle.openRead("boot/x64/wdsnbp.com");
+        benchmark::DoNotOptimize(file.get());
+    }
+    state.counters["kernel"] = handle.usesKernelResolution() ? 1 : 0;
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+}
+BENCHMARK(BM_RootHandleOpen)->Arg(0)->Arg(1)->Arg(2);
+
+// Finding the owner of a name in a cluster of Arg nodes (128 points each)
+static void BM_HashRingOwner(benchmark::State& state) {
+    std::vector<std::string> nodes;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        nodes.push_back("10.0." + std::to_string(i / 250) + "." + std::to_string(i % 250 + 1) + ":7600");
+    }
+    TftpHashRing ring(nodes, 128);
+    std::string name = "images/ubuntu-24.04/casper/initrd";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ring.owner(name));
+    }
+}
+BENCHMARK(BM_HashRingOwner)->Arg(3)->Arg(64);
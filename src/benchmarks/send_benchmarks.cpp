@@ -0,0 +1,133 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include "simple-tftpd/core/tftp/udp_gso.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include <algorithm>
+#include <ctime>
+#include <vector>
+
+using namespace simple_tftpd;
+
+namespace {
+
+/**
+ * @brief UDP socket pair on loopback: a sender and a sink that is never read
+ *
+ * Once the sink's buffer is full the kernel drops at the socket, after
+ * the send path being measured.
+ */
+struct LoopbackPair {
+    socket_t sender = INVALID_SOCKET_VALUE;
+    socket_t sink = INVALID_SOCKET_VALUE;
+    struct sockaddr_in sink_addr {};
+
+    LoopbackPair() {
+        sink = socket(AF_INET, SOCK_DGRAM, 0);
+        sink_addr.sin_family = AF_INET;
+        sink_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(sink_addr);
+        bind(sink, reinterpret_cast<struct sockaddr*>(&sink_addr), length);
+        getsockname(sink, reinterpret_cast<struct sockaddr*>(&sink_addr), &length);
+        sender = socket(AF_INET, SOCK_DGRAM, 0);
+    }
+
+    ~LoopbackPair() {
+        CLOSE_SOCKET(sender);
+        CLOSE_SOCKET(sink);
+    }
+};
+
+/**
+ * @brief One window of DATA frames back to back, each a full block
+ */
+std::vector<uint8_t> makeWindow(size_t block_size, size_t window) {
+    std::vector<uint8_t> payload(block_size, 0xA5);
+    size_t frame_size = TftpCodec::HEADER_SIZE + block_size;
+    std::vector<uint8_t> frames(frame_size * window);
+    for (size_t i = 0; i < window; ++i) {
+        TftpCodec::encodeData(frames.data() + i * frame_size, frame_size, static_cast<uint16_t>(i + 1),
+                              ByteView(payload.data(), payload.size()));
+    }
+    return frames;
+}
+
+double threadCpuNs() {
+    struct timespec now {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) * 1e9 + static_cast<double>(now.tv_nsec);
+}
+
+void reportSend(benchmark::State& state, double cpu_ns, size_t window_bytes, size_t datagrams, size_t calls) {
+    int64_t bytes = static_cast<int64_t>(state.iterations() * window_bytes);
+    state.SetBytesProcessed(bytes);
+    state.counters["packets_per_call"] = calls > 0 ? static_cast<double>(datagrams) / static_cast<double>(calls) : 0;
+    state.counters["cpu_ms_per_GB"] = bytes > 0 ? cpu_ns / 1e6 / (static_cast<double>(bytes) / 1e9) : 0;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Sending a window: one sendto per DATA packet vs one UDP GSO send
+// Args: blksize, windowsize
+// ---------------------------------------------------------------------------
+
+static void BM_SendWindowPerDatagram(benchmark::State& state) {
+    LoopbackPair pair;
+    size_t block_size = static_cast<size_t>(state.range(0));
+    size_t window = static_cast<size_t>(state.range(1));
+    size_t frame_size = TftpCodec::HEADER_SIZE + block_size;
+    std::vector<uint8_t> frames = makeWindow(block_size, window);
+
+    size_t calls = 0;
+    double started = threadCpuNs();
+    for (auto _ : state) {
+        for (size_t i = 0; i < window; ++i) {
+            sendto(pair.sender, reinterpret_cast<const char*>(frames.data() + i * frame_size), frame_size, 0,
+                   reinterpret_cast<struct sockaddr*>(&pair.sink_addr), sizeof(pair.sink_addr));
+        }
+        calls += window;
+    }
+    reportSend(state, threadCpuNs() - started, frames.size(), calls, calls);
+}
+BENCHMARK(BM_SendWindowPerDatagram)->Args({512, 16})->Args({512, 64})->Args({1428, 16})->Args({1428, 64});
+
+static void BM_SendWindowGso(benchmark::State& state) {
+    LoopbackPair pair;
+    if (!isUdpGsoSupported(pair.sender)) {
+        state.SkipWithError("UDP GSO is not supported on this system");
+        return;
+    }
+    size_t block_size = static_cast<size_t>(state.range(0));
+    size_t window = static_cast<size_t>(state.range(1));
+    size_t frame_size = TftpCodec::HEADER_SIZE + block_size;
+    size_t per_send = std::min(window, udpGsoSegmentsPerSend(frame_size));
+    std::vector<uint8_t> frames = makeWindow(block_size, window);
+
+    size_t calls = 0;
+    double started = threadCpuNs();
+    for (auto _ : state) {
+        for (size_t first = 0; first < window; first += per_send) {
+            size_t count = std::min(per_send, window - first);
+            sendUdpSegments(pair.sender, frames.data() + first * frame_size, count * frame_size, frame_size,
+                            reinterpret_cast<struct sockaddr*>(&pair.sink_addr), sizeof(pair.sink_addr));
+            ++calls;
+        }
+    }
+    reportSend(state, threadCpuNs() - started, frames.size(), state.iterations() * window, calls);
+}
+BENCHMARK(BM_SendWindowGso)->Args({512, 16})->Args({512, 64})->Args({1428, 16})->Args({1428, 64});
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/config/access_policy.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace simple_tftpd {
+
+namespace {
+
+constexpr unsigned IPV4_MAPPED_PREFIX = 96;
+
+inline unsigned addressBit(const TftpAddressTrie::Address& address, unsigned bit) {
+    return (address[bit / 8] >> (7 - bit % 8)) & 1u;
+}
+
+void mapIpv4(const void* ipv4, TftpAddressTrie::Address& address) {
+    address.fill(0);
+    address[10] = 0xFF;
+    address[11] = 0xFF;
+    std::memcpy(address.data() + 12, ipv4, 4);
+}
+
+/**
+ * @brief Parse a bare address, IPv4 mapped into IPv6
+ * @return Width of the written family in bits (32 or 128), 0 if malformed
+ */
+unsigned parseAddress(const std::string& text, TftpAddressTrie::Address& address) {
+    struct in_addr ipv4;
+    if (inet_pton(AF_INET, text.c_str(), &ipv4) == 1) {
+        mapIpv4(&ipv4, address);
+        return 32;
+    }
+    struct in6_addr ipv6;
+    if (inet_pton(AF_INET6, text.c_str(), &ipv6) == 1) {
+        std::memcpy(address.data(), &ipv6, address.size());
+        return 128;
+    }
+    return 0;
+}
+
+std::string normalizeExtension(const std::string& ext) {
+    std::string normalized = (!ext.empty() && ext.front() == '.') ? ext.substr(1) : ext;
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return normalized;
+}
+
+} // namespace
+
+TftpAddressTrie::TftpAddressTrie() : nodes_(1), prefixes_(0) {}
+
+void TftpAddressTrie::insert(const Address& address, unsigned prefix_length) {
+    prefix_length = std::min(prefix_length, 128u);
+
+    uint32_t node = 0;
+    for (unsigned bit = 0; bit < prefix_length; ++bit) {
+        if (nodes_[node].terminal) {
+            return;  // Already covered by a shorter prefix
+        }
+        unsigned branch = addressBit(address, bit);
+        if (nodes_[node].child[branch] == 0) {
+            nodes_[node].child[branch] = static_cast<uint32_t>(nodes_.size());
+            nodes_.emplace_back();
+        }
+        node = nodes_[node].child[branch];
+    }
+
+    if (!nodes_[node].terminal) {
+        nodes_[node].terminal = true;
+        prefixes_++;
+    }
+}
+
+bool TftpAddressTrie::contains(const Address& address) const {
+    uint32_t node = 0;
+    for (unsigned bit = 0; bit < 128; ++bit) {
+        if (nodes_[node].terminal) {
+            return true;
+        }
+        node = nodes_[node].child[addressBit(address, bit)];
+        if (node == 0) {
+            return false;
+        }
+    }
+    return nodes_[node].terminal;
+}
+
+TftpAccessPolicy::TftpAccessPolicy(const std::vector<std::string>& clients,
+                                   const std::vector<std::string>& directories,
+                                   const std::vector<std::string>& extensions)
+    : restrict_clients_(!clients.empty()), allow_all_clients_(false) {
+    for (const auto& rule : clients) {
+        if (rule == "*") {
+            allow_all_clients_ = true;
+            continue;
+        }
+        TftpAddressTrie::Address address;
+        unsigned prefix_length = 0;
+        if (parseClientRule(rule, address, prefix_length)) {
+            clients_.insert(address, prefix_length);
+        } else {
+            rejected_clients_.push_back(rule);
+        }
+    }
+
+    // Trailing slashes would never match a normalized path
+    directory_storage_.reserve(directories.size());
+    for (const auto& dir : directories) {
+        std::string normalized = dir;
+        while (normalized.size() > 1 && normalized.back() == '/') {
+            normalized.pop_back();
+        }
+        directory_storage_.push_back(std::move(normalized));
+    }
+    directories_.reserve(directory_storage_.size());
+    for (const auto& dir : directory_storage_) {
+        directories_.insert(dir);
+    }
+
+    extensions_.reserve(extensions.size());
+    for (const auto& ext : extensions) {
+        std::string normalized = normalizeExtension(ext);
+        if (!normalized.empty()) {
+            extensions_.insert(std::move(normalized));
+        }
+    }
+}
+
+bool TftpAccessPolicy::parseClientRule(const std::string& rule, TftpAddressTrie::Address& address,
+                                       unsigned& prefix_length) {
+    std::string::size_type slash = rule.find('/');
+    unsigned width = parseAddress(rule.substr(0, slash), address);
+    if (width == 0) {
+        return false;
+    }
+
+    if (slash == std::string::npos) {
+        prefix_length = 128;
+        return true;
+    }
+
+    std::string length = rule.substr(slash + 1);
+    if (length.empty() || length.size() > 3 ||
+        !std::all_of(length.begin(), length.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        return false;
+    }
+    unsigned value = static_cast<unsigned>(std::stoul(length));
+    if (value > width) {
+        return false;
+    }
+    prefix_length = width == 32 ? IPV4_MAPPED_PREFIX + value : value;
+    return true;
+}
+
+bool TftpAccessPolicy::isClientAllowed(const std::string& address) const {
+    if (!restrict_clients_ || allow_all_clients_) {
+        return true;
+    }
+
+    // Scoped IPv6 (fe80::1%eth0) matches on the address alone
+    TftpAddressTrie::Address parsed;
+    if (parseAddress(address.substr(0, address.find('%')), parsed) == 0) {
+        return false;
+    }
+    return clients_.contains(parsed);
+}
+
+bool TftpAccessPolicy::isClientAllowed(const struct sockaddr_storage& address) const {
+    if (!restrict_clients_ || allow_all_clients_) {
+        return true;
+    }
+
+    TftpAddressTrie::Address parsed;
+    if (address.ss_family == AF_INET) {
+        mapIpv4(&reinterpret_cast<const struct sockaddr_in*>(&address)->sin_addr, parsed);
+    } else if (address.ss_family == AF_INET6) {
+        std::memcpy(parsed.data(), &reinterpret_cast<const struct sockaddr_in6*>(&address)->sin6_addr,
+                    parsed.size());
+    } else {
+        return false;
+    }
+    return clients_.contains(parsed);
+}
+
+bool TftpAccessPolicy::isDirectoryAllowed(const std::string& dir) const {
+    if (directories_.empty()) {
+        return true;
+    }
+
+    // The directory itself, then each parent: one hash probe per component
+    std::string_view path(dir);
+    while (!path.empty()) {
+        if (directories_.count(path) != 0) {
+            return true;
+        }
+        std::string_view::size_type slash = path.find_last_of('/');
+        if (slash == std::string_view::npos || slash == 0) {
+            break;
+        }
+        path = path.substr(0, slash);
+    }
+    return false;
+}
+
+bool TftpAccessPolicy::isExtensionAllowed(const std::string& extension) const {
+    if (extensions_.empty()) {
+        return true;
+    }
+    return extensions_.count(normalizeExtension(extension)) != 0;
+}
+
+} // namespace simple_tftpd
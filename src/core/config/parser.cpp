@@ -43,6 +43,8 @@ std::string normalizeExtension(const std::string& ext) {
 
 TftpConfig::TftpConfig() {
     setDefaults();
+    compileAccessPolicy();
+    compileRemapRules();
 }
 
 TftpConfig::~TftpConfig() = default;
@@ -57,6 +59,14 @@ void TftpConfig::setDefaults() {
     root_directory_ = "/var/tftp";
     allowed_directories_.clear();
     allowed_extensions_.clear();
+    compressed_files_enabled_ = false;
+    compressed_directory_ = "";
+    case_insensitive_ = false;
+    remap_rules_.clear();
+    remap_file_ = "";
+    origin_url_ = "";
+    origin_revalidate_interval_ = 300;
+    origin_timeout_ = 5;
     
     // Security settings
     read_enabled_ = true;
@@ -70,11 +80,38 @@ void TftpConfig::setDefaults() {
     timeout_ = 5;
     window_size_ = 1;
     max_retries_ = 5;
+    block_cache_size_ = 64 * 1024 * 1024; // 64MB
+    netascii_cache_size_ = 16 * 1024 * 1024; // 16MB
+    negative_cache_entries_ = 4096;
+    negative_cache_ttl_ = 30;
+    metadata_cache_entries_ = 16384;
+    workers_ = 1;
+    shared_cache_size_ = 256 * 1024 * 1024; // 256MB
+    setup_threads_ = 4;
+    setup_queue_limit_ = 1024;
+    retransmit_from_file_ = false;
+    udp_gso_ = false;
     
     // Logging settings
     log_level_ = LogLevel::INFO;
     log_file_ = "";
     console_logging_ = true;
+    
+    // Monitoring settings
+    connections_file_ = "";
+    
+    // Multicast settings
+    multicast_enabled_ = false;
+    multicast_group_address_ = "239.255.68.1";
+    multicast_base_port_ = 1758;
+    multicast_max_sessions_ = 16;
+    multicast_ttl_ = 1;
+    multicast_interface_ = "";
+    
+    // Cluster settings
+    cluster_nodes_.clear();
+    cluster_node_ = "";
+    cluster_virtual_nodes_ = 128;
 }
 
 bool TftpConfig::loadFromFile(const std::string& config_file) {
@@ -101,7 +138,10 @@ bool TftpConfig::loadFromJson(const std::string& json_config) {
             return false;
         }
         
-        return parseJson(root);
+        bool parsed = parseJson(root);
+        compileAccessPolicy();
+        compileRemapRules();
+        return parsed;
     } catch (const std::exception& e) {
         return false;
     }
@@ -130,6 +170,16 @@ std::string TftpConfig::toJson() const {
     for (const auto& dir : allowed_directories_) {
         filesystem["allowed_directories"].append(dir);
     }
+    filesystem["compressed_files"] = compressed_files_enabled_;
+    filesystem["compressed_directory"] = compressed_directory_;
+    filesystem["case_insensitive"] = case_insensitive_;
+    for (const auto& rule : remap_rules_) {
+        filesystem["remap_rules"].append(rule);
+    }
+    filesystem["remap_file"] = remap_file_;
+    filesystem["origin_url"] = origin_url_;
+    filesystem["origin_revalidate_interval"] = origin_revalidate_interval_;
+    filesystem["origin_timeout"] = origin_timeout_;
     
     auto& security = root["security"];
     security["read_enabled"] = read_enabled_;
@@ -148,12 +198,42 @@ std::string TftpConfig::toJson() const {
     performance["timeout"] = timeout_;
     performance["window_size"] = window_size_;
     performance["max_retries"] = max_retries_;
+    performance["block_cache_size"] = static_cast<Json::UInt64>(block_cache_size_);
+    performance["netascii_cache_size"] = static_cast<Json::UInt64>(netascii_cache_size_);
+    performance["negative_cache_entries"] = static_cast<Json::UInt64>(negative_cache_entries_);
+    performance["negative_cache_ttl"] = negative_cache_ttl_;
+    performance["metadata_cache_entries"] = static_cast<Json::UInt64>(metadata_cache_entries_);
+    performance["workers"] = workers_;
+    performance["shared_cache_size"] = static_cast<Json::UInt64>(shared_cache_size_);
+    performance["setup_threads"] = setup_threads_;
+    performance["setup_queue_limit"] = static_cast<Json::UInt64>(setup_queue_limit_);
+    performance["retransmit_from_file"] = retransmit_from_file_;
+    performance["udp_gso"] = udp_gso_;
     
     auto& logging = root["logging"];
     logging["level"] = Logger::levelToString(log_level_);
     logging["log_file"] = log_file_;
     logging["console_logging"] = console_logging_;
     
+    auto& monitoring = root["monitoring"];
+    monitoring["connections_file"] = connections_file_;
+    
+    auto& multicast = root["multicast"];
+    multicast["enabled"] = multicast_enabled_;
+    multicast["group_address"] = multicast_group_address_;
+    multicast["base_port"] = multicast_base_port_;
+    multicast["max_sessions"] = multicast_max_sessions_;
+    multicast["ttl"] = multicast_ttl_;
+    multicast["interface"] = multicast_interface_;
+    
+    auto& cluster = root["cluster"];
+    cluster["nodes"] = Json::Value(Json::arrayValue);
+    for (const auto& node : cluster_nodes_) {
+        cluster["nodes"].append(node);
+    }
+    cluster["node"] = cluster_node_;
+    cluster["virtual_nodes"] = cluster_virtual_nodes_;
+    
     Json::StreamWriterBuilder builder;
     builder["indentation"] = "  ";
     return Json::writeString(builder, root);
@@ -182,6 +262,53 @@ bool TftpConfig::validate() const {
         return false;
     }
     
+    if (workers_ == 0 || workers_ > 256) {
+        return false;
+    }
+    
+    if (setup_threads_ > 256 || (setup_threads_ > 0 && setup_queue_limit_ == 0)) {
+        return false;
+    }
+    
+    if (!remap_file_.empty() && !std::ifstream(remap_file_).is_open()) {
+        return false;
+    }
+    
+    if (!origin_url_.empty() && (origin_url_.compare(0, 7, "http://") != 0 || origin_url_.size() == 7 ||
+                                 origin_timeout_ == 0)) {
+        return false;
+    }
+    
+    if (multicast_enabled_) {
+        // RFC 2090 groups are IPv4 multicast (224.0.0.0/4)
+        struct in_addr group;
+        if (inet_pton(AF_INET, multicast_group_address_.c_str(), &group) != 1 ||
+            !IN_MULTICAST(ntohl(group.s_addr))) {
+            return false;
+        }
+        if (multicast_base_port_ == 0 || multicast_max_sessions_ == 0 ||
+            static_cast<uint32_t>(multicast_base_port_) + multicast_max_sessions_ - 1 > 65535) {
+            return false;
+        }
+    }
+    
+    if (!cluster_nodes_.empty()) {
+        // Every member is host:port, and this node is one of them
+        for (const auto& node : cluster_nodes_) {
+            size_t colon = node.rfind(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == node.size() ||
+                node.find_first_not_of("0123456789", colon + 1) != std::string::npos ||
+                node.size() - colon > 6 || std::stoul(node.substr(colon + 1)) == 0 ||
+                std::stoul(node.substr(colon + 1)) > 65535) {
+                return false;
+            }
+        }
+        if (std::find(cluster_nodes_.begin(), cluster_nodes_.end(), cluster_node_) == cluster_nodes_.end() ||
+            cluster_virtual_nodes_ == 0) {
+            return false;
+        }
+    }
+    
     return true;
 }
 
@@ -221,6 +348,7 @@ std::string TftpConfig::getRootDirectory() const {
 
 void TftpConfig::setAllowedDirectories(const std::vector<std::string>& dirs) {
     allowed_directories_ = dirs;
+    compileAccessPolicy();
 }
 
 std::vector<std::string> TftpConfig::getAllowedDirectories() const {
@@ -228,17 +356,90 @@ std::vector<std::string> TftpConfig::getAllowedDirectories() const {
 }
 
 bool TftpConfig::isDirectoryAllowed(const std::string& dir) const {
-    if (allowed_directories_.empty()) {
-        return true; // If no restrictions, allow all
-    }
-    
-    for (const auto& allowed_dir : allowed_directories_) {
-        if (dir.find(allowed_dir) == 0) {
-            return true;
+    return access_policy_.load()->isDirectoryAllowed(dir);
+}
+
+void TftpConfig::setCompressedFilesEnabled(bool enable) {
+    compressed_files_enabled_ = enable;
+}
+
+bool TftpConfig::isCompressedFilesEnabled() const {
+    return compressed_files_enabled_;
+}
+
+void TftpConfig::setCompressedDirectory(const std::string& directory) {
+    compressed_directory_ = directory;
+}
+
+std::string TftpConfig::getCompressedDirectory() const {
+    return compressed_directory_;
+}
+
+void TftpConfig::setCaseInsensitive(bool enable) {
+    case_insensitive_ = enable;
+}
+
+bool TftpConfig::isCaseInsensitive() const {
+    return case_insensitive_;
+}
+
+void TftpConfig::setRemapRules(const std::vector<std::string>& rules) {
+    remap_rules_ = rules;
+    compileRemapRules();
+}
+
+std::vector<std::string> TftpConfig::getRemapRules() const {
+    return remap_rules_;
+}
+
+void TftpConfig::setRemapFile(const std::string& path) {
+    remap_file_ = path;
+    compileRemapRules();
+}
+
+std::string TftpConfig::getRemapFile() const {
+    return remap_file_;
+}
+
+std::shared_ptr<const TftpRemapRules> TftpConfig::getFilenameRemap() const {
+    return filename_remap_.load();
+}
+
+void TftpConfig::setOriginUrl(const std::string& url) {
+    origin_url_ = url;
+}
+
+std::string TftpConfig::getOriginUrl() const {
+    return origin_url_;
+}
+
+void TftpConfig::setOriginRevalidateInterval(uint32_t seconds) {
+    origin_revalidate_interval_ = seconds;
+}
+
+uint32_t TftpConfig::getOriginRevalidateInterval() const {
+    return origin_revalidate_interval_;
+}
+
+void TftpConfig::setOriginTimeout(uint32_t seconds) {
+    origin_timeout_ = seconds;
+}
+
+uint32_t TftpConfig::getOriginTimeout() const {
+    return origin_timeout_;
+}
+
+void TftpConfig::compileRemapRules() {
+    std::vector<std::string> rules;
+    if (!remap_file_.empty()) {
+        std::ifstream file(remap_file_);
+        std::string line;
+        while (std::getline(file, line)) {
+            rules.push_back(line);
         }
     }
-    
-    return false;
+    rules.insert(rules.end(), remap_rules_.begin(), remap_rules_.end());
+    filename_remap_.store(std::make_shared<const TftpRemapRules>(rules));
 }
 
 void TftpConfig::setAllowedExtensions(const std::vector<std::string>& extensions) {
@@ -250,6 +451,7 @@ void TftpConfig::setAllowedExtensions(const std::vector<std::string>& extensions
             allowed_extensions_.push_back(normalized);
         }
     }
+    compileAccessPolicy();
 }
 
 std::vector<std::string> TftpConfig::getAllowedExtensions() const {
@@ -257,12 +459,7 @@ std::vector<std::string> TftpConfig::getAllowedExtensions() const {
 }
 
 bool TftpConfig::isExtensionAllowed(const std::string& extension) const {
-    if (allowed_extensions_.empty()) {
-        return true;
-    }
-    
-    auto normalized = normalizeExtension(extension);
-    return std::find(allowed_extensions_.begin(), allowed_extensions_.end(), normalized) != allowed_extensions_.end();
+    return access_policy_.load()->isExtensionAllowed(extension);
 }
 
 // Security configuration
@@ -300,6 +497,7 @@ bool TftpConfig::isOverwriteProtectionEnabled() const {
 
 void TftpConfig::setAllowedClients(const std::vector<std::string>& clients) {
     allowed_clients_ = clients;
+    compileAccessPolicy();
 }
 
 std::vector<std::string> TftpConfig::getAllowedClients() const {
@@ -307,17 +505,16 @@ std::vector<std::string> TftpConfig::getAllowedClients() const {
 }
 
 bool TftpConfig::isClientAllowed(const std::string& address) const {
-    if (allowed_clients_.empty()) {
-        return true;
-    }
-    
-    for (const auto& allowed : allowed_clients_) {
-        if (allowed == "*" || allowed == address) {
-            return true;
-        }
-    }
-    
-    return false;
+    return access_policy_.load()->isClientAllowed(address);
+}
+
+std::shared_ptr<const TftpAccessPolicy> TftpConfig::getAccessPolicy() const {
+    return access_policy_.load();
+}
+
+void TftpConfig::compileAccessPolicy() {
+    access_policy_.store(std::make_shared<const TftpAccessPolicy>(
+        allowed_clients_, allowed_directories_, allowed_extensions_));
 }
 
 // Performance configuration
@@ -353,6 +550,94 @@ uint16_t TftpConfig::getMaxRetries() const {
     return max_retries_;
 }
 
+void TftpConfig::setBlockCacheSize(size_t bytes) {
+    block_cache_size_ = bytes;
+}
+
+size_t TftpConfig::getBlockCacheSize() const {
+    return block_cache_size_;
+}
+
+void TftpConfig::setNetasciiCacheSize(size_t bytes) {
+    netascii_cache_size_ = bytes;
+}
+
+size_t TftpConfig::getNetasciiCacheSize() const {
+    return netascii_cache_size_;
+}
+
+void TftpConfig::setNegativeCacheEntries(size_t entries) {
+    negative_cache_entries_ = entries;
+}
+
+size_t TftpConfig::getNegativeCacheEntries() const {
+    return negative_cache_entries_;
+}
+
+void TftpConfig::setNegativeCacheTtl(uint32_t seconds) {
+    negative_cache_ttl_ = seconds;
+}
+
+uint32_t TftpConfig::getNegativeCacheTtl() const {
+    return negative_cache_ttl_;
+}
+
+void TftpConfig::setMetadataCacheEntries(size_t entries) {
+    metadata_cache_entries_ = entries;
+}
+
+size_t TftpConfig::getMetadataCacheEntries() const {
+    return metadata_cache_entries_;
+}
+
+void TftpConfig::setWorkers(uint32_t workers) {
+    workers_ = workers;
+}
+
+uint32_t TftpConfig::getWorkers() const {
+    return workers_;
+}
+
+void TftpConfig::setSharedCacheSize(size_t bytes) {
+    shared_cache_size_ = bytes;
+}
+
+size_t TftpConfig::getSharedCacheSize() const {
+    return shared_cache_size_;
+}
+
+void TftpConfig::setSetupThreads(uint32_t threads) {
+    setup_threads_ = threads;
+}
+
+uint32_t TftpConfig::getSetupThreads() const {
+    return setup_threads_;
+}
+
+void TftpConfig::setSetupQueueLimit(size_t limit) {
+    setup_queue_limit_ = limit;
+}
+
+size_t TftpConfig::getSetupQueueLimit() const {
+    return setup_queue_limit_;
+}
+
+void TftpConfig::setRetransmitFromFile(bool enable) {
+    retransmit_from_file_ = enable;
+}
+
+bool TftpConfig::isRetransmitFromFileEnabled() const {
+    return retransmit_from_file_;
+}
+
+void TftpConfig::setUdpGso(bool enable) {
+    udp_gso_ = enable;
+}
+
+bool TftpConfig::isUdpGsoEnabled() const {
+    return udp_gso_;
+}
+
 // Logging configuration
 void TftpConfig::setLogLevel(LogLevel level) {
     log_level_ = level;
@@ -378,6 +663,89 @@ bool TftpConfig::isConsoleLoggingEnabled() const {
     return console_logging_;
 }
 
+// Monitoring configuration
+void TftpConfig::setConnectionsFile(const std::string& path) {
+    connections_file_ = path;
+}
+
+std::string TftpConfig::getConnectionsFile() const {
+    return connections_file_;
+}
+
+// Multicast configuration
+void TftpConfig::setMulticastEnabled(bool enable) {
+    multicast_enabled_ = enable;
+}
+
+bool TftpConfig::isMulticastEnabled() const {
+    return multicast_enabled_;
+}
+
+void TftpConfig::setMulticastGroupAddress(const std::string& address) {
+    multicast_group_address_ = address;
+}
+
+std::string TftpConfig::getMulticastGroupAddress() const {
+    return multicast_group_address_;
+}
+
+void TftpConfig::setMulticastBasePort(port_t port) {
+    multicast_base_port_ = port;
+}
+
+port_t TftpConfig::getMulticastBasePort() const {
+    return multicast_base_port_;
+}
+
+void TftpConfig::setMulticastMaxSessions(uint16_t count) {
+    multicast_max_sessions_ = count;
+}
+
+uint16_t TftpConfig::getMulticastMaxSessions() const {
+    return multicast_max_sessions_;
+}
+
+void TftpConfig::setMulticastTtl(uint8_t ttl) {
+    multicast_ttl_ = ttl;
+}
+
+uint8_t TftpConfig::getMulticastTtl() const {
+    return multicast_ttl_;
+}
+
+void TftpConfig::setMulticastInterface(const std::string& address) {
+    multicast_interface_ = address;
+}
+
+std::string TftpConfig::getMulticastInterface() const {
+    return multicast_interface_;
+}
+
+// Cluster configuration
+void TftpConfig::setClusterNodes(const std::vector<std::string>& nodes) {
+    cluster_nodes_ = nodes;
+}
+
+std::vector<std::string> TftpConfig::getClusterNodes() const {
+    return cluster_nodes_;
+}
+
+void TftpConfig::setClusterNode(const std::string& node) {
+    cluster_node_ = node;
+}
+
+std::string TftpConfig::getClusterNode() const {
+    return cluster_node_;
+}
+
+void TftpConfig::setClusterVirtualNodes(uint32_t count) {
+    cluster_virtual_nodes_ = count;
+}
+
+uint32_t TftpConfig::getClusterVirtualNodes() const {
+    return cluster_virtual_nodes_;
+}
+
 bool TftpConfig::parseJson(const Json::Value& root) {
     try {
         // Parse network settings
@@ -412,6 +780,41 @@ bool TftpConfig::parseJson(const Json::Value& root) {
                     allowed_directories_.push_back(dir.asString());
                 }
             }
+            
+            if (filesystem.isMember("compressed_files")) {
+                compressed_files_enabled_ = filesystem["compressed_files"].asBool();
+            }
+            
+            if (filesystem.isMember("compressed_directory")) {
+                compressed_directory_ = filesystem["compressed_directory"].asString();
+            }
+            
+            if (filesystem.isMember("case_insensitive")) {
+                case_insensitive_ = filesystem["case_insensitive"].asBool();
+            }
+            
+            if (filesystem.isMember("remap_rules")) {
+                remap_rules_.clear();
+                for (const auto& rule : filesystem["remap_rules"]) {
+                    remap_rules_.push_back(rule.asString());
+                }
+            }
+            
+            if (filesystem.isMember("remap_file")) {
+                remap_file_ = filesystem["remap_file"].asString();
+            }
+            
+            if (filesystem.isMember("origin_url")) {
+                origin_url_ = filesystem["origin_url"].asString();
+            }
+            
+            if (filesystem.isMember("origin_revalidate_interval")) {
+                origin_revalidate_interval_ = filesystem["origin_revalidate_interval"].asUInt();
+            }
+            
+            if (filesystem.isMember("origin_timeout")) {
+                origin_timeout_ = filesystem["origin_timeout"].asUInt();
+            }
         }
         
         // Parse security settings
@@ -471,6 +874,50 @@ bool TftpConfig::parseJson(const Json::Value& root) {
             if (performance.isMember("max_retries")) {
                 max_retries_ = static_cast<uint16_t>(performance["max_retries"].asUInt());
             }
+            
+            if (performance.isMember("block_cache_size")) {
+                block_cache_size_ = static_cast<size_t>(performance["block_cache_size"].asUInt64());
+            }
+            
+            if (performance.isMember("netascii_cache_size")) {
+                netascii_cache_size_ = static_cast<size_t>(performance["netascii_cache_size"].asUInt64());
+            }
+            
+            if (performance.isMember("negative_cache_entries")) {
+                negative_cache_entries_ = static_cast<size_t>(performance["negative_cache_entries"].asUInt64());
+            }
+            
+            if (performance.isMember("negative_cache_ttl")) {
+                negative_cache_ttl_ = performance["negative_cache_ttl"].asUInt();
+            }
+            
+            if (performance.isMember("metadata_cache_entries")) {
+                metadata_cache_entries_ = static_cast<size_t>(performance["metadata_cache_entries"].asUInt64());
+            }
+            
+            if (performance.isMember("workers")) {
+                workers_ = performance["workers"].asUInt();
+            }
+            
+            if (performance.isMember("shared_cache_size")) {
+                shared_cache_size_ = static_cast<size_t>(performance["shared_cache_size"].asUInt64());
+            }
+            
+            if (performance.isMember("setup_threads")) {
+                setup_threads_ = performance["setup_threads"].asUInt();
+            }
+            
+            if (performance.isMember("setup_queue_limit")) {
+                setup_queue_limit_ = static_cast<size_t>(performance["setup_queue_limit"].asUInt64());
+            }
+            
+            if (performance.isMember("retransmit_from_file")) {
+                retransmit_from_file_ = performance["retransmit_from_file"].asBool();
+            }
+            
+            if (performance.isMember("udp_gso")) {
+                udp_gso_ = performance["udp_gso"].asBool();
+            }
         }
         
         // Parse logging settings
@@ -501,6 +948,64 @@ bool TftpConfig::parseJson(const Json::Value& root) {
             }
         }
         
+        // Parse monitoring settings
+        if (root.isMember("monitoring")) {
+            const Json::Value& monitoring = root["monitoring"];
+            
+            if (monitoring.isMember("connections_file")) {
+                connections_file_ = monitoring["connections_file"].asString();
+            }
+        }
+        
+        // Parse multicast settings
+        if (root.isMember("multicast")) {
+            const Json::Value& multicast = root["multicast"];
+            
+            if (multicast.isMember("enabled")) {
+                multicast_enabled_ = multicast["enabled"].asBool();
+            }
+            
+            if (multicast.isMember("group_address")) {
+                multicast_group_address_ = multicast["group_address"].asString();
+            }
+            
+            if (multicast.isMember("base_port")) {
+                multicast_base_port_ = static_cast<port_t>(multicast["base_port"].asUInt());
+            }
+            
+            if (multicast.isMember("max_sessions")) {
+                multicast_max_sessions_ = static_cast<uint16_t>(multicast["max_sessions"].asUInt());
+            }
+            
+            if (multicast.isMember("ttl")) {
+                multicast_ttl_ = static_cast<uint8_t>(multicast["ttl"].asUInt());
+            }
+            
+            if (multicast.isMember("interface")) {
+                multicast_interface_ = multicast["interface"].asString();
+            }
+        }
+        
+        // Parse cluster settings
+        if (root.isMember("cluster")) {
+            const Json::Value& cluster = root["cluster"];
+            
+            if (cluster.isMember("nodes")) {
+                cluster_nodes_.clear();
+                for (const auto& node : cluster["nodes"]) {
+                    cluster_nodes_.push_back(node.asString());
+                }
+            }
+            
+            if (cluster.isMember("node")) {
+                cluster_node_ = cluster["node"].asString();
+            }
+            
+            if (cluster.isMember("virtual_nodes")) {
+                cluster_virtual_nodes_ = cluster["virtual_nodes"].asUInt();
+            }
+        }
+        
         return true;
     } catch (const std::exception& e) {
         return false;
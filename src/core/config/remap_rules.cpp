@@ -0,0 +1,1269 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/config/remap_rules.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifdef PLATFORM_WINDOWS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <regex.h>
+#endif
+
+namespace simple_tftpd {
+
+#ifndef PLATFORM_WINDOWS
+struct TftpRemapRules::PosixRegex {
+    regex_t regex;
+    bool compiled = false;
+
+    PosixRegex(const std::string& pattern, bool icase) {
+        compiled = regcomp(&regex, pattern.c_str(), REG_EXTENDED | (icase ? REG_ICASE : 0)) == 0;
+    }
+
+    ~PosixRegex() {
+        if (compiled) {
+            regfree(&regex);
+        }
+    }
+};
+#else
+struct TftpRemapRules::PosixRegex {};
+#endif
+
+namespace {
+
+constexpr int REPEAT_LIMIT = 255;       // Largest {m,n} bound accepted
+constexpr int NESTING_LIMIT = 64;       // Group depth, bounds parser recursion
+constexpr size_t PROGRAM_LIMIT = 4096;  // Instructions per rule
+constexpr int PASS_LIMIT = 4096;        // Matching rules applied per request, guards 's' loops
+constexpr size_t TRANSITION_BUDGET = 1u << 20;  // Transition table entries
+constexpr size_t BACKTRACK_LIMIT = 256 * 1024;  // Instruction-position pairs tracked by the backtracker
+
+std::vector<std::string> tokenize(const std::string& line) {
+    std::vector<std::string> tokens;
+    std::string token;
+    bool in_token = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (c == '\\' && i + 1 < line.size()) {
+            // Escaped characters never split, the escape is kept for the parser
+            token += c;
+            token += line[++i];
+            in_token = true;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (in_token) {
+                tokens.push_back(token);
+                token.clear();
+                in_token = false;
+            }
+        } else if (c == '#' && !in_token) {
+            break;
+        } else {
+            token += c;
+            in_token = true;
+        }
+    }
+    if (in_token) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+std::string addressHex(const std::string& address) {
+    static const char digits[] = "0123456789ABCDEF";
+    unsigned char bytes[16];
+    size_t length = 0;
+    if (inet_pton(AF_INET, address.c_str(), bytes) == 1) {
+        length = 4;
+    } else if (inet_pton(AF_INET6, address.c_str(), bytes) == 1) {
+        length = 16;
+        static const unsigned char mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+        if (std::memcmp(bytes, mapped, sizeof(mapped)) == 0) {
+            std::memmove(bytes, bytes + 12, 4);
+            length = 4;
+        }
+    }
+
+    std::string hex;
+    for (size_t i = 0; i < length; ++i) {
+        hex += digits[bytes[i] >> 4];
+        hex += digits[bytes[i] & 0x0f];
+    }
+    return hex;
+}
+
+// POSIX extended regular expression parser producing a syntax tree
+struct Node {
+    enum Kind { EMPTY, SET, CAT, ALT, REPEAT, GROUP, BEGIN, END };
+    Kind kind = EMPTY;
+    int set = 0;
+    int min = 0;
+    int max = 0;  // -1 for unbounded
+    int group = 0;
+    std::vector<Node> children;
+};
+
+class Parser {
+public:
+    Parser(const std::string& pattern, bool icase, std::vector<std::bitset<256>>& sets)
+        : pattern_(pattern), icase_(icase), sets_(sets) {}
+
+    bool parse(Node& root, std::string& error) {
+        if (!parseAlternation(root)) {
+            error = error_;
+            return false;
+        }
+        return true;
+    }
+
+    int groups() const { return groups_; }
+
+private:
+    const std::string& pattern_;
+    bool icase_;
+    std::vector<std::bitset<256>>& sets_;
+    size_t pos_ = 0;
+    int groups_ = 0;
+    int depth_ = 0;
+    std::string error_;
+
+    bool fail(const std::string& error) {
+        error_ = error;
+        return false;
+    }
+
+    bool more() const { return pos_ < pattern_.size(); }
+    char peek() const { return pattern_[pos_]; }
+
+    int addSet(std::bitset<256> set) {
+        return findSet(icase_ ? fold(set) : set);
+    }
+
+    static std::bitset<256> fold(std::bitset<256> set) {
+        for (int c = 'a'; c <= 'z'; ++c) {
+            int upper = c - 'a' + 'A';
+            if (set[c] || set[upper]) {
+                set.set(c);
+                set.set(upper);
+            }
+        }
+        return set;
+    }
+
+    int findSet(const std::bitset<256>& set) {
+        for (size_t i = 0; i < sets_.size(); ++i) {
+            if (sets_[i] == set) {
+                return static_cast<int>(i);
+            }
+        }
+        sets_.push_back(set);
+        return static_cast<int>(sets_.size() - 1);
+    }
+
+    Node literal(unsigned char c) {
+        std::bitset<256> set;
+        set.set(c);
+        Node node;
+        node.kind = Node::SET;
+        node.set = addSet(set);
+        return node;
+    }
+
+    bool parseAlternation(Node& node) {
+        Node branch;
+        if (!parseConcatenation(branch)) {
+            return false;
+        }
+        if (!more() || peek() != '|') {
+            node = std::move(branch);
+            return true;
+        }
+        node.kind = Node::ALT;
+        node.children.push_back(std::move(branch));
+        while (more() && peek() == '|') {
+            pos_++;
+            Node next;
+            if (!parseConcatenation(next)) {
+                return false;
+            }
+            node.children.push_back(std::move(next));
+        }
+        return true;
+    }
+
+    bool parseConcatenation(Node& node) {
+        node.kind = Node::CAT;
+        while (more() && peek() != '|' && !(peek() == ')' && depth_ > 0)) {
+            Node atom;
+            if (!parseRepeat(atom)) {
+                return false;
+            }
+            node.children.push_back(std::move(atom));
+        }
+        if (node.children.size() == 1) {
+            Node only = std::move(node.children.front());
+            node = std::move(only);
+        }
+        return true;
+    }
+
+    bool parseBound(int& min, int& max) {
+        size_t start = pos_;
+        auto number = [this](int& value) {
+            size_t begin = pos_;
+            value = 0;
+            while (more() && std::isdigit(static_cast<unsigned char>(peek()))) {
+                value = std::min(value * 10 + (peek() - '0'), REPEAT_LIMIT + 1);
+                pos_++;
+            }
+            return pos_ > begin;
+        };
+
+        pos_++;  // '{'
+        if (!number(min)) {
+            pos_ = start;
+            return false;
+        }
+        max = min;
+        if (more() && peek() == ',') {
+            pos_++;
+            if (!number(max)) {
+                max = -1;
+            }
+        }
+        if (!more() || peek() != '}') {
+            pos_ = start;
+            return false;
+        }
+        pos_++;
+        return true;
+    }
+
+    bool parseRepeat(Node& node) {
+        if (!parseAtom(node)) {
+            return false;
+        }
+        while (more()) {
+            int min;
+            int max;
+            char c = peek();
+            if (c == '*') {
+                min = 0;
+                max = -1;
+                pos_++;
+            } else if (c == '+') {
+                min = 1;
+                max = -1;
+                pos_++;
+            } else if (c == '?') {
+                min = 0;
+                max = 1;
+                pos_++;
+            } else if (c == '{' && parseBound(min, max)) {
+                if (min > REPEAT_LIMIT || max > REPEAT_LIMIT || (max >= 0 && max < min)) {
+                    return fail("invalid repetition count");
+                }
+            } else {
+                break;
+            }
+            if (node.kind == Node::BEGIN || node.kind == Node::END) {
+                return fail("nothing to repeat");
+            }
+            Node repeat;
+            repeat.kind = Node::REPEAT;
+            repeat.min = min;
+            repeat.max = max;
+            repeat.children.push_back(std::move(node));
+            node = std::move(repeat);
+        }
+        return true;
+    }
+
+    bool parseAtom(Node& node) {
+        unsigned char c = static_cast<unsigned char>(pattern_[pos_++]);
+        switch (c) {
+        case '(': {
+            if (depth_ >= NESTING_LIMIT) {
+                return fail("groups nested too deeply");
+            }
+            node.kind = Node::GROUP;
+            node.group = ++groups_;
+            depth_++;
+            Node inner;
+            if (!parseAlternation(inner)) {
+                return false;
+            }
+            depth_--;
+            if (!more() || peek() != ')') {
+                return fail("unmatched (");
+            }
+            pos_++;
+            node.children.push_back(std::move(inner));
+            return true;
+        }
+        case '[':
+            return parseBracket(node);
+        case '.': {
+            std::bitset<256> set;
+            set.set();
+            node.kind = Node::SET;
+            node.set = addSet(set);
+            return true;
+        }
+        case '^':
+            node.kind = Node::BEGIN;
+            return true;
+        case '$':
+            node.kind = Node::END;
+            return true;
+        case '\\':
+            if (!more()) {
+                return fail("trailing backslash");
+            }
+            node = literal(static_cast<unsigned char>(pattern_[pos_++]));
+            return true;
+        case '*':
+        case '+':
+        case '?':
+            return fail("nothing to repeat");
+        default:
+            node = literal(c);
+            return true;
+        }
+    }
+
+    bool parseClass(const std::string& name, std::bitset<256>& set) {
+        static const struct {
+            const char* name;
+            int (*test)(int);
+        } classes[] = {
+            {"alnum", [](int c) { return std::isalnum(c); }}, {"alpha", [](int c) { return std::isalpha(c); }},
+            {"blank", [](int c) { return std::isblank(c); }}, {"cntrl", [](int c) { return std::iscntrl(c); }},
+            {"digit", [](int c) { return std::isdigit(c); }}, {"graph", [](int c) { return std::isgraph(c); }},
+            {"lower", [](int c) { return std::islower(c); }}, {"print", [](int c) { return std::isprint(c); }},
+            {"punct", [](int c) { return std::ispunct(c); }}, {"space", [](int c) { return std::isspace(c); }},
+            {"upper", [](int c) { return std::isupper(c); }}, {"xdigit", [](int c) { return std::isxdigit(c); }},
+        };
+        for (const auto& entry : classes) {
+            if (name == entry.name) {
+                for (int b = 0; b < 128; ++b) {
+                    if (entry.test(b)) {
+                        set.set(b);
+                    }
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseBracket(Node& node) {
+        std::bitset<256> set;
+        bool negate = false;
+        if (more() && peek() == '^') {
+            negate = true;
+            pos_++;
+        }
+
+        bool first = true;
+        for (;;) {
+            if (!more()) {
+                return fail("unmatched [");
+            }
+            unsigned char c = static_cast<unsigned char>(pattern_[pos_]);
+            if (c == ']' && !first) {
+                pos_++;
+                break;
+            }
+            first = false;
+
+            if (c == '[' && pos_ + 1 < pattern_.size() && pattern_[pos_ + 1] == ':') {
+                size_t end = pattern_.find(":]", pos_ + 2);
+                if (end == std::string::npos || !parseClass(pattern_.substr(pos_ + 2, end - pos_ - 2), set)) {
+                    return fail("unknown character class");
+                }
+                pos_ = end + 2;
+                continue;
+            }
+            if (c == '[' && pos_ + 1 < pattern_.size() && (pattern_[pos_ + 1] == '.' || pattern_[pos_ + 1] == '=')) {
+                return fail("collating elements are not supported");
+            }
+
+            pos_++;
+            if (pos_ + 1 < pattern_.size() && peek() == '-' && pattern_[pos_ + 1] != ']') {
+                unsigned char last = static_cast<unsigned char>(pattern_[pos_ + 1]);
+                if (last < c) {
+                    return fail("invalid range");
+                }
+                for (int b = c; b <= last; ++b) {
+                    set.set(static_cast<size_t>(b));
+                }
+                pos_ += 2;
+            } else {
+                set.set(c);
+            }
+        }
+
+        node.kind = Node::SET;
+        if (negate) {
+            // Case folding applies before the complement, as regcomp does
+            node.set = findSet(~(icase_ ? fold(set) : set));
+        } else {
+            node.set = addSet(set);
+        }
+        return true;
+    }
+};
+
+// Thompson construction of one rule's program
+
+template <typename Inst>
+class Compiler {
+public:
+    explicit Compiler(std::vector<Inst>& code) : code_(code) {}
+
+    bool emit(const Node& node) {
+        if (code_.size() > PROGRAM_LIMIT) {
+            return false;
+        }
+        switch (node.kind) {
+        case Node::EMPTY:
+            return true;
+        case Node::SET:
+            push(Inst::SET, node.set);
+            return true;
+        case Node::BEGIN:
+            push(Inst::BEGIN, 0);
+            return true;
+        case Node::END:
+            push(Inst::END, 0);
+            return true;
+        case Node::CAT:
+            for (const auto& child : node.children) {
+                if (!emit(child)) {
+                    return false;
+                }
+            }
+            return true;
+        case Node::GROUP:
+            push(Inst::SAVE, node.group * 2);
+            if (!emit(node.children.front())) {
+                return false;
+            }
+            push(Inst::SAVE, node.group * 2 + 1);
+            return true;
+        case Node::ALT: {
+            std::vector<size_t> exits;
+            for (size_t i = 0; i + 1 < node.children.size(); ++i) {
+                size_t split = push(Inst::SPLIT, 0);
+                if (!emit(node.children[i])) {
+                    return false;
+                }
+                exits.push_back(push(Inst::JMP, 0));
+                code_[split].y = static_cast<int>(code_.size());
+            }
+            if (!emit(node.children.back())) {
+                return false;
+            }
+            for (size_t exit : exits) {
+                code_[exit].x = static_cast<int>(code_.size());
+            }
+            return true;
+        }
+        case Node::REPEAT:
+            return emitRepeat(node);
+        }
+        return false;
+    }
+
+    size_t push(typename Inst::Op op, int arg) {
+        Inst inst;
+        inst.op = op;
+        inst.x = static_cast<int>(code_.size() + 1);
+        inst.arg = arg;
+        code_.push_back(inst);
+        return code_.size() - 1;
+    }
+
+private:
+    std::vector<Inst>& code_;
+
+    bool emitRepeat(const Node& node) {
+        const Node& child = node.children.front();
+        int required = node.max < 0 ? std::max(node.min - 1, 0) : node.min;
+        for (int i = 0; i < required; ++i) {
+            if (!emit(child)) {
+                return false;
+            }
+        }
+
+        if (node.max < 0) {
+            if (node.min > 0) {
+                // x+ : x then loop back while preferring another x
+                size_t loop = code_.size();
+                if (!emit(child)) {
+                    return false;
+                }
+                size_t split = push(Inst::SPLIT, 0);
+                code_[split].x = static_cast<int>(loop);
+                code_[split].y = static_cast<int>(code_.size());
+            } else {
+                size_t split = push(Inst::SPLIT, 0);
+                if (!emit(child)) {
+                    return false;
+                }
+                size_t jump = push(Inst::JMP, 0);
+                code_[jump].x = static_cast<int>(split);
+                code_[split].y = static_cast<int>(code_.size());
+            }
+            return true;
+        }
+
+        // Optional copies all skip to the end
+        std::vector<size_t> splits;
+        for (int i = node.min; i < node.max; ++i) {
+            splits.push_back(push(Inst::SPLIT, 0));
+            if (!emit(child)) {
+                return false;
+            }
+        }
+        for (size_t split : splits) {
+            code_[split].y = static_cast<int>(code_.size());
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+TftpRemapRules::TftpRemapRules(const std::vector<std::string>& rules)
+    : classes_(1), capacity_(0), state_count_(0) {
+    for (const auto& line : rules) {
+        std::string error;
+        if (!compileRule(line, error) && !error.empty()) {
+            rejected_.push_back(line + " (" + error + ")");
+        }
+    }
+    buildAutomaton();
+}
+
+TftpRemapRules::~TftpRemapRules() = default;
+
+bool TftpRemapRules::compileRule(const std::string& line, std::string& error) {
+    std::vector<std::string> tokens = tokenize(line);
+    if (tokens.empty()) {
+        return false;  // Blank or comment
+    }
+    if (tokens.size() < 2 || tokens.size() > 3) {
+        error = "expected: flags regex [replacement]";
+        return false;
+    }
+
+    Rule rule;
+    bool icase = false;
+    for (char flag : tokens[0]) {
+        switch (flag) {
+        case '-':
+            break;
+        case 'r':
+            rule.rewrite = true;
+            break;
+        case 'g':
+            rule.global = true;
+            break;
+        case 'i':
+            icase = true;
+            break;
+        case 'e':
+            rule.end = true;
+            break;
+        case 's':
+            rule.restart = true;
+            break;
+        case 'a':
+            rule.abort = true;
+            break;
+        case 'G':
+            rule.writes = false;
+            break;
+        case 'P':
+            rule.reads = false;
+            break;
+        case '~':
+            rule.invert = true;
+            break;
+        default:
+            error = std::string("unknown flag '") + flag + "'";
+            return false;
+        }
+    }
+    if (rule.rewrite && rule.invert) {
+        error = "'r' and '~' cannot be combined";
+        return false;
+    }
+    if (rule.rewrite != (tokens.size() == 3)) {
+        error = rule.rewrite ? "missing replacement" : "replacement without 'r'";
+        return false;
+    }
+    if (rule.rewrite) {
+        rule.replacement = tokens[2];
+    }
+
+    std::vector<CharSet> sets = sets_;
+    Parser parser(tokens[1], icase, sets);
+    Node root;
+    if (!parser.parse(root, error)) {
+        return false;
+    }
+
+    Compiler<Inst> compiler(rule.code);
+    compiler.push(Inst::SAVE, 0);
+    if (!compiler.emit(root) || rule.code.size() + 2 > PROGRAM_LIMIT) {
+        error = "regex too large";
+        return false;
+    }
+    compiler.push(Inst::SAVE, 1);
+    compiler.push(Inst::MATCH, static_cast<int>(rules_.size()));
+    rule.slots = (parser.groups() + 1) * 2;
+
+#ifndef PLATFORM_WINDOWS
+    // Which rules match does not depend on how a match is chosen, but what
+    // the groups capture does; regexec() captures them the way tftpd-hpa does
+    if (rule.rewrite) {
+        auto posix = std::make_shared<PosixRegex>(tokens[1], icase);
+        if (posix->compiled && posix->regex.re_nsub + 1 == static_cast<size_t>(parser.groups() + 1)) {
+            rule.posix = std::move(posix);
+        }
+    }
+#endif
+
+    sets_.swap(sets);
+    rules_.push_back(std::move(rule));
+    return true;
+}
+
+void TftpRemapRules::buildAutomaton() {
+    size_t words = (rules_.size() + 63) / 64;
+    invert_mask_.assign(words, 0);
+    read_mask_.assign(words, 0);
+    write_mask_.assign(words, 0);
+
+    for (size_t r = 0; r < rules_.size(); ++r) {
+        const Rule& rule = rules_[r];
+        uint64_t bit = uint64_t(1) << (r % 64);
+        invert_mask_[r / 64] |= rule.invert ? bit : 0;
+        read_mask_[r / 64] |= rule.reads ? bit : 0;
+        write_mask_[r / 64] |= rule.writes ? bit : 0;
+
+        int offset = static_cast<int>(code_.size());
+        starts_.push_back(offset);
+        for (Inst inst : rule.code) {
+            inst.x += offset;
+            inst.y += offset;
+            code_.push_back(inst);
+        }
+    }
+
+    // Bytes no character set tells apart share a transition column
+    std::fill(std::begin(byte_class_), std::end(byte_class_), 0);
+    classes_ = 1;
+    for (const auto& set : sets_) {
+        std::vector<int> split(static_cast<size_t>(classes_) * 2, -1);
+        int classes = 0;
+        for (int b = 0; b < 256; ++b) {
+            int& target = split[static_cast<size_t>(byte_class_[b]) * 2 + (set[static_cast<size_t>(b)] ? 1 : 0)];
+            if (target < 0) {
+                target = classes++;
+            }
+            byte_class_[b] = static_cast<uint8_t>(target);
+        }
+        classes_ = classes;
+    }
+
+    // Every position after the first may begin an unanchored match; those
+    // threads are implied in every state rather than stored in each one
+    in_restart_.assign(code_.size(), 0);
+    std::vector<char> seen(code_.size(), 0);
+    std::vector<int> accepts;
+    for (size_t r = 0; r < rules_.size(); ++r) {
+        size_t pcs = restart_pcs_.size();
+        size_t matches = accepts.size();
+        closure(starts_[r], false, false, restart_pcs_, accepts, seen);
+        rules_[r].anchored = restart_pcs_.size() == pcs && accepts.size() == matches;
+    }
+    for (int pc : restart_pcs_) {
+        in_restart_[static_cast<size_t>(pc)] = 1;
+    }
+
+    // Bytes a match can start with, so rewrites skip hopeless positions
+    std::vector<char> visited(code_.size(), 0);
+    for (size_t r = 0; r < rules_.size(); ++r) {
+        Rule& rule = rules_[r];
+        std::vector<int> pcs;
+        std::vector<int> matches;
+        closure(starts_[r], true, false, pcs, matches, visited);
+        rule.first.reset();
+        rule.filtered = matches.empty();
+        for (int pc : pcs) {
+            const Inst& inst = code_[static_cast<size_t>(pc)];
+            if (inst.op == Inst::SET) {
+                rule.first |= sets_[static_cast<size_t>(inst.arg)];
+            } else {
+                rule.filtered = false;  // '$' may match the empty string
+            }
+        }
+    }
+    std::sort(accepts.begin(), accepts.end());
+    accepts.erase(std::unique(accepts.begin(), accepts.end()), accepts.end());
+    always_.assign(words, 0);
+    for (int rule : accepts) {
+        always_[static_cast<size_t>(rule) / 64] |= uint64_t(1) << (rule % 64);
+    }
+
+    capacity_ = static_cast<int>(std::min<size_t>(8192, std::max<size_t>(64, TRANSITION_BUDGET / classes_)));
+    states_.reset(new State[static_cast<size_t>(capacity_)]);
+    transitions_.reset(new std::atomic<int32_t>[static_cast<size_t>(capacity_) * classes_]);
+    for (size_t i = 0; i < static_cast<size_t>(capacity_) * classes_; ++i) {
+        transitions_[i].store(-1, std::memory_order_relaxed);
+    }
+
+    // The start state also holds the anchored threads; it is never shared
+    // with a later state since '^' and '$' see different context there
+    State start;
+    std::fill(seen.begin(), seen.end(), 0);
+    for (int begin : starts_) {
+        closure(begin, true, false, start.pcs, start.accepts, seen);
+    }
+    normalize(start);
+    finish(start, true);
+    states_[0] = std::move(start);
+    state_count_.store(1, std::memory_order_release);
+}
+
+void TftpRemapRules::closure(int pc, bool at_begin, bool at_end, std::vector<int>& pcs, std::vector<int>& accepts,
+                             std::vector<char>& seen) const {
+    std::vector<int> stack(1, pc);
+    while (!stack.empty()) {
+        int next = stack.back();
+        stack.pop_back();
+        if (seen[static_cast<size_t>(next)]) {
+            continue;
+        }
+        seen[static_cast<size_t>(next)] = 1;
+
+        const Inst& inst = code_[static_cast<size_t>(next)];
+        switch (inst.op) {
+        case Inst::SET:
+            pcs.push_back(next);
+            break;
+        case Inst::SPLIT:
+            stack.push_back(inst.y);
+            stack.push_back(inst.x);
+            break;
+        case Inst::JMP:
+        case Inst::SAVE:
+            stack.push_back(inst.x);
+            break;
+        case Inst::BEGIN:
+            if (at_begin) {
+                stack.push_back(inst.x);
+            }
+            break;
+        case Inst::END:
+            if (at_end) {
+                stack.push_back(inst.x);
+            } else {
+                pcs.push_back(next);  // Decided when the input ends
+            }
+            break;
+        case Inst::MATCH:
+            accepts.push_back(inst.arg);
+            break;
+        }
+    }
+}
+
+void TftpRemapRules::normalize(State& state) const {
+    std::vector<int>& pcs = state.pcs;
+    pcs.erase(std::remove_if(pcs.begin(), pcs.end(),
+                             [this](int pc) { return in_restart_[static_cast<size_t>(pc)] != 0; }),
+              pcs.end());
+    std::sort(pcs.begin(), pcs.end());
+    pcs.erase(std::unique(pcs.begin(), pcs.end()), pcs.end());
+
+    std::vector<int>& accepts = state.accepts;
+    accepts.erase(std::remove_if(accepts.begin(), accepts.end(),
+                                 [this](int rule) { return (always_[static_cast<size_t>(rule) / 64] >> (rule % 64)) & 1; }),
+                  accepts.end());
+    std::sort(accepts.begin(), accepts.end());
+    accepts.erase(std::unique(accepts.begin(), accepts.end()), accepts.end());
+}
+
+void TftpRemapRules::step(const State& state, uint8_t byte, State& next) const {
+    next.pcs.clear();
+    next.accepts.clear();
+    next.end_accepts.clear();
+
+    std::vector<char> seen(code_.size(), 0);
+    auto advance = [&](int pc) {
+        const Inst& inst = code_[static_cast<size_t>(pc)];
+        if (inst.op == Inst::SET && sets_[static_cast<size_t>(inst.arg)][byte]) {
+            closure(inst.x, false, false, next.pcs, next.accepts, seen);
+        }
+    };
+    for (int pc : state.pcs) {
+        advance(pc);
+    }
+    for (int pc : restart_pcs_) {
+        advance(pc);
+    }
+    normalize(next);
+    finish(next, false);
+}
+
+void TftpRemapRules::finish(State& state, bool at_begin) const {
+    std::vector<char> seen(code_.size(), 0);
+    std::vector<int> pcs;
+    auto settle = [&](int pc) {
+        const Inst& inst = code_[static_cast<size_t>(pc)];
+        if (inst.op == Inst::END) {
+            closure(inst.x, at_begin, true, pcs, state.end_accepts, seen);
+        }
+    };
+    for (int pc : state.pcs) {
+        settle(pc);
+    }
+    for (int pc : restart_pcs_) {
+        settle(pc);
+    }
+    std::sort(state.end_accepts.begin(), state.end_accepts.end());
+    state.end_accepts.erase(std::unique(state.end_accepts.begin(), state.end_accepts.end()), state.end_accepts.end());
+}
+
+int TftpRemapRules::transition(int state, uint8_t byte) const {
+    std::atomic<int32_t>& slot = transitions_[static_cast<size_t>(state) * classes_ + byte_class_[byte]];
+    int32_t next = slot.load(std::memory_order_acquire);
+    if (next >= 0) {
+        return next;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    next = slot.load(std::memory_order_relaxed);
+    if (next >= 0) {
+        return next;
+    }
+
+    State target;
+    step(states_[state], byte, target);
+    std::vector<int> key = target.pcs;
+    key.push_back(-1);
+    key.insert(key.end(), target.accepts.begin(), target.accepts.end());
+
+    auto it = state_ids_.find(key);
+    if (it != state_ids_.end()) {
+        next = it->second;
+    } else {
+        int count = state_count_.load(std::memory_order_relaxed);
+        if (count >= capacity_) {
+            return -1;  // Cache full, the caller steps the automaton itself
+        }
+        states_[count] = std::move(target);
+        state_ids_.emplace(std::move(key), count);
+        state_count_.store(count + 1, std::memory_order_release);
+        next = count;
+    }
+    slot.store(next, std::memory_order_release);
+    return next;
+}
+
+void TftpRemapRules::scan(const std::string& text, std::vector<uint64_t>& matched) const {
+    matched = always_;
+    auto mark = [&matched](const std::vector<int>& rules) {
+        for (int rule : rules) {
+            matched[static_cast<size_t>(rule) / 64] |= uint64_t(1) << (rule % 64);
+        }
+    };
+
+    int current = 0;
+    mark(states_[0].accepts);
+    size_t i = 0;
+    for (; i < text.size(); ++i) {
+        int next = transition(current, static_cast<uint8_t>(text[i]));
+        if (next < 0) {
+            break;
+        }
+        current = next;
+        mark(states_[current].accepts);
+    }
+    if (i == text.size()) {
+        mark(states_[current].end_accepts);
+        return;
+    }
+
+    // Out of cached states: finish this input without caching
+    State state = states_[current];
+    State next;
+    for (; i < text.size(); ++i) {
+        step(state, static_cast<uint8_t>(text[i]), next);
+        mark(next.accepts);
+        std::swap(state, next);
+    }
+    mark(state.end_accepts);
+}
+
+size_t TftpRemapRules::nextRule(const std::vector<uint64_t>& matched, size_t from, bool for_write) const {
+    const std::vector<uint64_t>& applies = for_write ? write_mask_ : read_mask_;
+    for (size_t word = from / 64; word < matched.size(); ++word) {
+        uint64_t bits = (matched[word] ^ invert_mask_[word]) & applies[word];
+        if (word == from / 64) {
+            bits &= ~uint64_t(0) << (from % 64);
+        }
+        if (bits != 0) {
+            size_t rule = word * 64;
+            while ((bits & 1) == 0) {
+                bits >>= 1;
+                rule++;
+            }
+            return rule < rules_.size() ? rule : rules_.size();
+        }
+    }
+    return rules_.size();
+}
+
+bool TftpRemapRules::remap(const std::string& filename, const std::string& client_address, bool for_write,
+                           std::string& result) const {
+    result = filename;
+    if (rules_.empty()) {
+        return true;
+    }
+
+    thread_local std::vector<uint64_t> matched;
+    scan(result, matched);
+    size_t index = 0;
+    for (int passes = 0;; ++passes) {
+        index = nextRule(matched, index, for_write);
+        if (index >= rules_.size()) {
+            return true;
+        }
+        if (passes >= PASS_LIMIT) {
+            return false;  // Rules rewrite each other forever
+        }
+
+        const Rule& rule = rules_[index];
+        if (rule.abort) {
+            return false;
+        }
+        if (rule.rewrite) {
+            std::string rewritten = rewrite(rule, result, client_address);
+            if (rewritten != result) {
+                result.swap(rewritten);
+                scan(result, matched);
+            }
+        }
+        if (rule.end) {
+            return true;
+        }
+        index = rule.restart ? 0 : index + 1;
+    }
+}
+
+bool TftpRemapRules::search(const Rule& rule, const std::string& text, size_t from,
+                            std::vector<int>& slots) const {
+#ifndef PLATFORM_WINDOWS
+    if (rule.posix) {
+        thread_local std::vector<regmatch_t> matches;
+        size_t groups = static_cast<size_t>(rule.slots / 2);
+        matches.resize(groups);
+        // The text before from is still there: ^ must not match at from
+        if (regexec(&rule.posix->regex, text.c_str() + from, groups, matches.data(), from > 0 ? REG_NOTBOL : 0) != 0) {
+            return false;
+        }
+        slots.assign(static_cast<size_t>(rule.slots), -1);
+        for (size_t i = 0; i < groups; ++i) {
+            if (matches[i].rm_so >= 0) {
+                slots[i * 2] = static_cast<int>(from + static_cast<size_t>(matches[i].rm_so));
+                slots[i * 2 + 1] = static_cast<int>(from + static_cast<size_t>(matches[i].rm_eo));
+            }
+        }
+        return true;
+    }
+#endif
+    if (rule.code.size() * (text.size() + 1) <= BACKTRACK_LIMIT) {
+        return backtrack(rule, text, from, slots);
+    }
+    return simulate(rule, text, from, slots);
+}
+
+bool TftpRemapRules::backtrack(const Rule& rule, const std::string& text, size_t from,
+                               std::vector<int>& slots) const {
+    // Depth-first in priority order; each (instruction, position) pair is
+    // tried once, since a pair that failed fails again whatever the captures
+    struct Job {
+        int pc;     // Instruction to run, or -1 to restore a capture
+        int slot;
+        int value;  // Position, or capture value to restore
+    };
+    struct Scratch {
+        std::vector<uint64_t> visited;
+        std::vector<int> caps;
+        std::vector<Job> jobs;
+    };
+    thread_local Scratch scratch;
+    std::vector<uint64_t>& visited = scratch.visited;
+    std::vector<int>& caps = scratch.caps;
+    std::vector<Job>& jobs = scratch.jobs;
+
+    const std::vector<Inst>& code = rule.code;
+    const size_t length = text.size();
+    visited.assign((code.size() * (length + 1) + 63) / 64, 0);
+    caps.resize(static_cast<size_t>(rule.slots));
+
+    for (size_t start = from; start <= length; ++start) {
+        if (rule.filtered && (start == length || !rule.first[static_cast<uint8_t>(text[start])])) {
+            if (rule.anchored) {
+                break;
+            }
+            continue;
+        }
+        std::fill(caps.begin(), caps.end(), -1);
+        jobs.clear();
+        jobs.push_back(Job{0, 0, static_cast<int>(start)});
+        while (!jobs.empty()) {
+            Job job = jobs.back();
+            jobs.pop_back();
+            if (job.pc < 0) {
+                caps[static_cast<size_t>(job.slot)] = job.value;
+                continue;
+            }
+
+            int pc = job.pc;
+            size_t pos = static_cast<size_t>(job.value);
+            for (;;) {
+                size_t bit = static_cast<size_t>(pc) * (length + 1) + pos;
+                if (visited[bit / 64] & (uint64_t(1) << (bit % 64))) {
+                    break;
+                }
+                visited[bit / 64] |= uint64_t(1) << (bit % 64);
+
+                const Inst& inst = code[static_cast<size_t>(pc)];
+                if (inst.op == Inst::SET) {
+                    if (pos == length || !sets_[static_cast<size_t>(inst.arg)][static_cast<uint8_t>(text[pos])]) {
+                        break;
+                    }
+                    pos++;
+                } else if (inst.op == Inst::SPLIT) {
+                    jobs.push_back(Job{inst.y, 0, static_cast<int>(pos)});
+                } else if (inst.op == Inst::SAVE) {
+                    jobs.push_back(Job{-1, inst.arg, caps[static_cast<size_t>(inst.arg)]});
+                    caps[static_cast<size_t>(inst.arg)] = static_cast<int>(pos);
+                } else if (inst.op == Inst::BEGIN) {
+                    if (pos != 0) {
+                        break;
+                    }
+                } else if (inst.op == Inst::END) {
+                    if (pos != length) {
+                        break;
+                    }
+                } else if (inst.op == Inst::MATCH) {
+                    slots.assign(caps.begin(), caps.end());
+                    return true;
+                }
+                pc = inst.x;
+            }
+        }
+        if (rule.anchored) {
+            break;
+        }
+    }
+    return false;
+}
+
+bool TftpRemapRules::simulate(const Rule& rule, const std::string& text, size_t from,
+                              std::vector<int>& slots) const {
+    // Pike VM: threads in priority order, so the first to match is the
+    // leftmost match with the preferred alternatives. Captures live in flat
+    // per-thread buffers reused across calls, so a search does not allocate.
+    struct Threads {
+        std::vector<int> pcs;   // In priority order
+        std::vector<int> caps;  // Indexed by pc, one thread per pc
+    };
+    struct Frame {
+        int pc;     // Instruction to visit, or -1 to restore a capture
+        int slot;
+        int value;
+    };
+    struct Scratch {
+        Threads current;
+        Threads next;
+        std::vector<int> caps;
+        std::vector<size_t> added;
+        std::vector<Frame> stack;
+    };
+    thread_local Scratch scratch;
+    Threads* current = &scratch.current;
+    Threads* next = &scratch.next;
+    std::vector<int>& caps = scratch.caps;
+    std::vector<size_t>& added = scratch.added;
+    std::vector<Frame>& stack = scratch.stack;
+
+    const std::vector<Inst>& code = rule.code;
+    const size_t width = static_cast<size_t>(rule.slots);
+    current->pcs.clear();
+    current->caps.resize(code.size() * width);
+    next->caps.resize(code.size() * width);
+    caps.resize(width);
+    added.assign(code.size(), SIZE_MAX);
+    bool found = false;
+
+    // Follows empty transitions from pc with the captures in caps
+    auto add = [&](Threads& list, int pc, size_t pos) {
+        stack.push_back(Frame{pc, 0, 0});
+        while (!stack.empty()) {
+            Frame frame = stack.back();
+            stack.pop_back();
+            if (frame.pc < 0) {
+                caps[static_cast<size_t>(frame.slot)] = frame.value;
+                continue;
+            }
+            if (added[static_cast<size_t>(frame.pc)] == pos) {
+                continue;
+            }
+            added[static_cast<size_t>(frame.pc)] = pos;
+
+            const Inst& inst = code[static_cast<size_t>(frame.pc)];
+            switch (inst.op) {
+            case Inst::SPLIT:
+                stack.push_back(Frame{inst.y, 0, 0});
+                stack.push_back(Frame{inst.x, 0, 0});
+                break;
+            case Inst::JMP:
+                stack.push_back(Frame{inst.x, 0, 0});
+                break;
+            case Inst::SAVE:
+                // Undone once the branch below is explored
+                stack.push_back(Frame{-1, inst.arg, caps[static_cast<size_t>(inst.arg)]});
+                caps[static_cast<size_t>(inst.arg)] = static_cast<int>(pos);
+                stack.push_back(Frame{inst.x, 0, 0});
+                break;
+            case Inst::BEGIN:
+                if (pos == 0) {
+                    stack.push_back(Frame{inst.x, 0, 0});
+                }
+                break;
+            case Inst::END:
+                if (pos == text.size()) {
+                    stack.push_back(Frame{inst.x, 0, 0});
+                }
+                break;
+            case Inst::SET:
+            case Inst::MATCH:
+                list.pcs.push_back(frame.pc);
+                std::copy(caps.begin(), caps.end(),
+                          list.caps.begin() + static_cast<std::ptrdiff_t>(static_cast<size_t>(frame.pc) * width));
+                break;
+            }
+        }
+    };
+
+    for (size_t pos = from;; ++pos) {
+        if (!found && (pos == from || !rule.anchored)) {
+            std::fill(caps.begin(), caps.end(), -1);
+            add(*current, 0, pos);
+        }
+        if (current->pcs.empty() && (found || rule.anchored)) {
+            break;
+        }
+
+        next->pcs.clear();
+        for (int pc : current->pcs) {
+            const Inst& inst = code[static_cast<size_t>(pc)];
+            auto thread_caps = current->caps.begin() + static_cast<std::ptrdiff_t>(static_cast<size_t>(pc) * width);
+            if (inst.op == Inst::MATCH) {
+                slots.assign(thread_caps, thread_caps + static_cast<std::ptrdiff_t>(width));
+                found = true;
+                break;  // Lower priority threads lose
+            }
+            if (pos < text.size() && sets_[static_cast<size_t>(inst.arg)][static_cast<uint8_t>(text[pos])]) {
+                std::copy(thread_caps, thread_caps + static_cast<std::ptrdiff_t>(width), caps.begin());
+                add(*next, inst.x, pos + 1);
+            }
+        }
+        std::swap(current, next);
+        if (pos >= text.size()) {
+            break;
+        }
+    }
+    return found;
+}
+
+std::string TftpRemapRules::rewrite(const Rule& rule, const std::string& text,
+                                    const std::string& client_address) const {
+    std::string result;
+    thread_local std::vector<int> slots;
+    size_t pos = 0;
+    while (pos <= text.size() && search(rule, text, pos, slots)) {
+        size_t start = static_cast<size_t>(slots[0]);
+        size_t end = static_cast<size_t>(slots[1]);
+        result.append(text, pos, start - pos);
+
+        const std::string& replacement = rule.replacement;
+        for (size_t i = 0; i < replacement.size(); ++i) {
+            char c = replacement[i];
+            if (c != '\\' || i + 1 == replacement.size()) {
+                result += c;
+                continue;
+            }
+            char escape = replacement[++i];
+            if (escape >= '0' && escape <= '9') {
+                size_t group = static_cast<size_t>(escape - '0') * 2;
+                if (group + 1 < slots.size() && slots[group] >= 0 && slots[group + 1] >= 0) {
+                    result.append(text, static_cast<size_t>(slots[group]),
+                                  static_cast<size_t>(slots[group + 1] - slots[group]));
+                }
+            } else if (escape == 'i') {
+                result += client_address;
+            } else if (escape == 'x') {
+                result += addressHex(client_address);
+            } else {
+                result += escape;
+            }
+        }
+
+        if (end == start) {
+            // Step over one character so empty matches make progress
+            if (end < text.size()) {
+                result += text[end];
+            }
+            pos = end + 1;
+        } else {
+            pos = end;
+        }
+        if (!rule.global) {
+            break;
+        }
+    }
+    if (pos < text.size()) {
+        result.append(text, pos, std::string::npos);
+    }
+    return result;
+}
+
+} // namespace simple_tftpd
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/ack_coalescer.hpp"
+
+namespace simple_tftpd {
+
+bool TftpAckCoalescer::add(const std::string& key, uint16_t block, size_t packet) {
+    for (TftpPendingAck& pending : pending_) {
+        if (pending.key != key) {
+            continue;
+        }
+        // Block numbers wrap, so the newer ACK is the one less than half the space ahead
+        uint16_t ahead = static_cast<uint16_t>(block - pending.block);
+        if (ahead != 0 && ahead < 0x8000) {
+            pending.block = block;
+            pending.packet = packet;
+        }
+        return true;
+    }
+    pending_.push_back(TftpPendingAck{key, block, packet});
+    return false;
+}
+
+bool TftpAckCoalescer::take(const std::string& key, TftpPendingAck& ack) {
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        if (pending_[i].key == key) {
+            ack = std::move(pending_[i]);
+            pending_.erase(pending_.begin() + static_cast<std::ptrdiff_t>(i));
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace simple_tftpd
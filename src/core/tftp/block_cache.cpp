@@ -0,0 +1,84 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/block_cache.hpp"
+#include <algorithm>
+
+namespace simple_tftpd {
+
+TftpBlockStream::TftpBlockStream(const std::vector<uint8_t>& stream, uint16_t block_size)
+    : block_size_(std::max<uint16_t>(block_size, 1)),
+      stream_size_(stream.size()),
+      frame_count_(stream.size() / block_size_ + 1) {
+    frames_.resize(frame_count_ * TftpCodec::HEADER_SIZE + stream.size());
+
+    size_t offset = 0;
+    for (size_t index = 0; index < frame_count_; ++index) {
+        size_t start = index * block_size_;
+        size_t length = std::min<size_t>(block_size_, stream.size() - start);
+        offset += TftpCodec::encodeData(frames_.data() + offset, frames_.size() - offset,
+                                        static_cast<uint16_t>((index + 1) & 0xFFFF),
+                                        ByteView(stream.data() + start, length));
+    }
+}
+
+ByteView TftpBlockStream::frame(size_t index) const {
+    if (index >= frame_count_) {
+        return ByteView();
+    }
+
+    // Every frame but the last is a full block
+    size_t full_frame = TftpCodec::HEADER_SIZE + block_size_;
+    size_t offset = index * full_frame;
+    size_t length = std::min(full_frame, frames_.size() - offset);
+    return ByteView(frames_.data() + offset, length);
+}
+
+TftpBlockCache::TftpBlockCache(size_t capacity)
+    : frames_(capacity), blocks_cached_(0), blocks_uncached_(0) {}
+
+std::shared_ptr<const TftpBlockStream> TftpBlockCache::acquire(const TftpBlockCacheKey& key, const Loader& loader,
+                                                               bool& was_cached) {
+    return frames_.acquire(key, key.file_size, [&key, &loader]() -> std::shared_ptr<const TftpBlockStream> {
+        std::vector<uint8_t> stream;
+        if (!loader(stream)) {
+            return nullptr;
+        }
+        return std::make_shared<const TftpBlockStream>(stream, key.block_size);
+    }, was_cached);
+}
+
+void TftpBlockCache::recordBlocks(uint64_t count, bool cached) {
+    (cached ? blocks_cached_ : blocks_uncached_).fetch_add(count, std::memory_order_relaxed);
+}
+
+void TftpBlockCache::setCapacity(size_t capacity) {
+    frames_.setCapacity(capacity);
+}
+
+void TftpBlockCache::clear() {
+    frames_.clear();
+}
+
+TftpBlockCacheStats TftpBlockCache::getStats() const {
+    TftpBlockCacheStats stats;
+    static_cast<TftpCacheStats&>(stats) = frames_.getStats();
+    stats.blocks_cached = blocks_cached_.load(std::memory_order_relaxed);
+    stats.blocks_uncached = blocks_uncached_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+} // namespace simple_tftpd
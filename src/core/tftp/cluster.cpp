@@ -0,0 +1,505 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/cluster.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+#ifndef PLATFORM_WINDOWS
+#include <netdb.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#endif
+
+namespace simple_tftpd {
+
+namespace {
+
+constexpr size_t HEADER_LIMIT = 16 * 1024;
+constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+// "host:port" or "[v6]:port"
+bool splitEndpoint(const std::string& endpoint, std::string& host, std::string& port) {
+    size_t colon = endpoint.rfind(':');
+    if (colon == std::string::npos || colon == 0) {
+        return false;
+    }
+    host = endpoint.substr(0, colon);
+    port = endpoint.substr(colon + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    return !port.empty();
+}
+
+std::string addressText(const struct sockaddr* address) {
+    char text[INET6_ADDRSTRLEN] = {0};
+    if (address->sa_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<const struct sockaddr_in*>(address)->sin_addr, text, sizeof(text));
+    } else if (address->sa_family == AF_INET6) {
+        inet_ntop(AF_INET6, &reinterpret_cast<const struct sockaddr_in6*>(address)->sin6_addr, text, sizeof(text));
+    }
+    std::string result = text;
+    // IPv4 peers on a dual-stack listener
+    if (result.compare(0, 7, "::ffff:") == 0 && result.find('.') != std::string::npos) {
+        result = result.substr(7);
+    }
+    return result;
+}
+
+bool decodeName(const std::string& path, std::string& name) {
+    name.clear();
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] != '%') {
+            name += path[i];
+            continue;
+        }
+        if (i + 2 >= path.size() || !std::isxdigit(static_cast<unsigned char>(path[i + 1])) ||
+            !std::isxdigit(static_cast<unsigned char>(path[i + 2]))) {
+            return false;
+        }
+        name += static_cast<char>(std::stoi(path.substr(i + 1, 2), nullptr, 16));
+        i += 2;
+    }
+    return !name.empty() && name.find('\0') == std::string::npos;
+}
+
+bool sendAll(socket_t socket, const char* data, size_t size) {
+    while (size > 0) {
+        auto count = send(socket, data, static_cast<int>(size), 0);
+        if (count <= 0) {
+            return false;
+        }
+        data += count;
+        size -= static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool sendStatus(socket_t socket, const std::string& status) {
+    std::string head = "HTTP/1.1 " + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    return sendAll(socket, head.data(), head.size());
+}
+
+bool sendHead(socket_t socket, uint64_t length) {
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(length) +
+                       "\r\nConnection: close\r\n\r\n";
+    return sendAll(socket, head.data(), head.size());
+}
+
+void setTimeouts(socket_t socket, uint32_t seconds) {
+#ifdef PLATFORM_WINDOWS
+    DWORD millis = static_cast<DWORD>(seconds * 1000);
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&millis), sizeof(millis));
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&millis), sizeof(millis));
+#else
+    struct timeval tv {};
+    tv.tv_sec = static_cast<time_t>(seconds);
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+void shutdownSocket(socket_t socket) {
+#ifdef PLATFORM_WINDOWS
+    shutdown(socket, SD_BOTH);
+#else
+    shutdown(socket, SHUT_RDWR);
+#endif
+}
+
+} // namespace
+
+TftpHashRing::TftpHashRing(std::vector<std::string> nodes, uint32_t virtual_nodes) : nodes_(std::move(nodes)) {
+    points_.reserve(nodes_.size() * virtual_nodes);
+    for (uint32_t node = 0; node < nodes_.size(); ++node) {
+        for (uint32_t point = 0; point < virtual_nodes; ++point) {
+            points_.emplace_back(hash(nodes_[node] + "#" + std::to_string(point)), node);
+        }
+    }
+    std::sort(points_.begin(), points_.end());
+}
+
+size_t TftpHashRing::owner(const std::string& name) const {
+    if (points_.empty()) {
+        return 0;
+    }
+    auto it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(hash(name), uint32_t(0)));
+    return it == points_.end() ? points_.front().second : it->second;
+}
+
+uint64_t TftpHashRing::hash(const std::string& text) {
+    uint64_t value = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+        value ^= c;
+        value *= 1099511628211ULL;
+    }
+    // FNV-1a alone clusters similar names (image-1, image-2, ...); the
+    // splitmix64 finalizer spreads them over the whole ring
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+TftpCluster::TftpCluster(std::shared_ptr<TftpConfig> config, std::shared_ptr<Logger> logger,
+                         TftpOriginStore& origin)
+    : config_(std::move(config)),
+      logger_(std::move(logger)),
+      origin_(origin),
+      membership_(config_ ? buildMembership(*config_) : nullptr),
+      listen_socket_(INVALID_SOCKET_VALUE),
+      peer_port_(0),
+      running_(false),
+      owned_misses_(0),
+      peer_fetches_(0),
+      peer_failures_(0),
+      requests_served_(0),
+      requests_refused_(0),
+      bytes_served_(0) {}
+
+TftpCluster::~TftpCluster() {
+    stop();
+}
+
+std::shared_ptr<const TftpCluster::Membership> TftpCluster::buildMembership(const TftpConfig& config) {
+    std::vector<std::string> nodes = config.getClusterNodes();
+    if (nodes.empty()) {
+        return nullptr;
+    }
+    auto self = std::find(nodes.begin(), nodes.end(), config.getClusterNode());
+    size_t self_index = self == nodes.end() ? 0 : static_cast<size_t>(self - nodes.begin());
+
+    std::vector<std::string> hosts;
+    for (const auto& node : nodes) {
+        std::string host, port;
+        if (!splitEndpoint(node, host, port)) {
+            continue;
+        }
+        struct addrinfo hints {};
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+            continue;
+        }
+        for (struct addrinfo* address = addresses; address; address = address->ai_next) {
+            hosts.push_back(addressText(address->ai_addr));
+        }
+        freeaddrinfo(addresses);
+    }
+
+    auto membership = std::make_shared<Membership>(
+        Membership{TftpHashRing(std::move(nodes), config.getClusterVirtualNodes()), self_index, std::move(hosts)});
+    return membership;
+}
+
+bool TftpCluster::start(std::function<std::shared_ptr<const TftpRootHandle>()> root) {
+    std::shared_ptr<const Membership> membership = membership_.load();
+    if (!membership || running_.load()) {
+        return true;
+    }
+    root_ = std::move(root);
+
+    std::string endpoint = membership->ring.getNodes()[membership->self];
+    std::string host, port;
+    struct addrinfo hints {};
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* addresses = nullptr;
+    if (!splitEndpoint(endpoint, host, port) || getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        logEvent(LogLevel::ERROR, "Invalid cluster peer endpoint: " + endpoint);
+        return false;
+    }
+
+    for (struct addrinfo* address = addresses; address && listen_socket_ == INVALID_SOCKET_VALUE;
+         address = address->ai_next) {
+        socket_t candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (candidate == INVALID_SOCKET_VALUE) {
+            continue;
+        }
+        int reuse = 1;
+        setsockopt(candidate, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+#ifdef SO_REUSEPORT
+        // Every prefork worker listens; a peer request can be answered by any of them
+        if (config_->getWorkers() > 1) {
+            setsockopt(candidate, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        }
+#endif
+        if (bind(candidate, address->ai_addr, static_cast<socklen_t>(address->ai_addrlen)) == 0 &&
+            listen(candidate, 64) == 0) {
+            listen_socket_ = candidate;
+        } else {
+            CLOSE_SOCKET(candidate);
+        }
+    }
+    freeaddrinfo(addresses);
+    if (listen_socket_ == INVALID_SOCKET_VALUE) {
+        logEvent(LogLevel::ERROR, "Failed to listen for cluster peers on " + endpoint);
+        return false;
+    }
+
+    struct sockaddr_storage bound {};
+    socklen_t length = sizeof(bound);
+    if (getsockname(listen_socket_, reinterpret_cast<struct sockaddr*>(&bound), &length) == 0) {
+        peer_port_.store(ntohs(bound.ss_family == AF_INET6
+                                   ? reinterpret_cast<struct sockaddr_in6*>(&bound)->sin6_port
+                                   : reinterpret_cast<struct sockaddr_in*>(&bound)->sin_port));
+    }
+
+    running_.store(true);
+    accept_thread_ = std::thread(&TftpCluster::acceptLoop, this);
+    logEvent(LogLevel::INFO, "Cluster node " + endpoint + " of " + std::to_string(membership->ring.getNodes().size()) +
+                                 ", listening for peers");
+    return true;
+}
+
+void TftpCluster::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    if (accept_thread_.joinable()) {
+        accept_thread_.join();
+    }
+    CLOSE_SOCKET(listen_socket_);
+    listen_socket_ = INVALID_SOCKET_VALUE;
+    peer_port_.store(0);
+
+    // Peer requests in progress end at their next send or receive
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (socket_t socket : active_) {
+        shutdownSocket(socket);
+    }
+    idle_.wait(lock, [this] { return active_.empty(); });
+}
+
+void TftpCluster::setConfig(std::shared_ptr<TftpConfig> config) {
+    std::shared_ptr<const Membership> previous = membership_.load();
+    std::shared_ptr<const Membership> next = config ? buildMembership(*config) : nullptr;
+    if (running_.load() && (!next || !previous ||
+                            next->ring.getNodes()[next->self] != previous->ring.getNodes()[previous->self])) {
+        logEvent(LogLevel::WARNING, "Cluster peer endpoint changed but cannot be applied without restart");
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = std::move(config);
+    }
+    membership_.store(std::move(next));
+}
+
+bool TftpCluster::isEnabled() const {
+    return membership_.load() != nullptr;
+}
+
+std::string TftpCluster::ownerOf(const std::string& name) const {
+    std::shared_ptr<const Membership> membership = membership_.load();
+    return membership ? membership->ring.getNodes()[membership->ring.owner(name)] : std::string();
+}
+
+TftpOriginStore::Result TftpCluster::fetch(const std::shared_ptr<const TftpRootHandle>& root,
+                                           const std::string& name,
+                                           std::shared_ptr<const TftpOriginFetch>& fetch) {
+    std::shared_ptr<const Membership> membership = membership_.load();
+    if (!membership) {
+        return origin_.fetch(root, name, fetch);
+    }
+    size_t owner = membership->ring.owner(name);
+    if (owner == membership->self) {
+        owned_misses_++;
+        return origin_.fetch(root, name, fetch);
+    }
+
+    const std::string& peer = membership->ring.getNodes()[owner];
+    TftpOriginStore::Result result = origin_.fetchFromPeer("http://" + peer, root, name, fetch);
+    if (result == TftpOriginStore::Result::FAILED) {
+        peer_failures_++;
+        logEvent(LogLevel::WARNING, "Owner " + peer + " of " + name + " unavailable, asking the origin");
+        return origin_.fetch(root, name, fetch);
+    }
+    if (result == TftpOriginStore::Result::FETCHING) {
+        peer_fetches_++;
+    }
+    return result;
+}
+
+TftpClusterStats TftpCluster::getStats() const {
+    TftpClusterStats stats;
+    stats.owned_misses = owned_misses_.load();
+    stats.peer_fetches = peer_fetches_.load();
+    stats.peer_failures = peer_failures_.load();
+    stats.requests_served = requests_served_.load();
+    stats.requests_refused = requests_refused_.load();
+    stats.bytes_served = bytes_served_.load();
+    return stats;
+}
+
+void TftpCluster::acceptLoop() {
+    while (running_.load()) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(listen_socket_, &readable);
+        struct timeval tv {};
+        tv.tv_usec = 200000;
+        if (select(static_cast<int>(listen_socket_) + 1, &readable, nullptr, nullptr, &tv) <= 0) {
+            continue;
+        }
+
+        struct sockaddr_storage address {};
+        socklen_t length = sizeof(address);
+        socket_t socket = accept(listen_socket_, reinterpret_cast<struct sockaddr*>(&address), &length);
+        if (socket == INVALID_SOCKET_VALUE) {
+            continue;
+        }
+        std::shared_ptr<const Membership> membership = membership_.load();
+        std::string peer = addressText(reinterpret_cast<struct sockaddr*>(&address));
+        if (!membership || std::find(membership->hosts.begin(), membership->hosts.end(), peer) ==
+                               membership->hosts.end()) {
+            requests_refused_++;
+            logEvent(LogLevel::WARNING, "Refused cluster peer connection from " + peer);
+            CLOSE_SOCKET(socket);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_.insert(socket);
+        }
+        std::thread(&TftpCluster::servePeer, this, socket).detach();
+    }
+}
+
+void TftpCluster::servePeer(socket_t socket) {
+    uint32_t timeout = 5;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (config_) {
+            timeout = config_->getOriginTimeout();
+        }
+    }
+    setTimeouts(socket, timeout);
+
+    // One request per connection; only the request line matters
+    std::string head;
+    std::vector<char> buffer(4096);
+    while (head.find("\r\n\r\n") == std::string::npos && head.size() < HEADER_LIMIT) {
+        auto count = recv(socket, buffer.data(), static_cast<int>(buffer.size()), 0);
+        if (count <= 0) {
+            break;
+        }
+        head.append(buffer.data(), static_cast<size_t>(count));
+    }
+
+    std::string line = head.substr(0, head.find("\r\n"));
+    size_t first = line.find(' ');
+    size_t second = first == std::string::npos ? std::string::npos : line.find(' ', first + 1);
+    std::string name;
+    std::shared_ptr<const TftpRootHandle> root = root_ ? root_() : nullptr;
+    if (head.find("\r\n\r\n") == std::string::npos || second == std::string::npos) {
+        sendStatus(socket, "400 Bad Request");
+    } else if (line.compare(0, first, "GET") != 0) {
+        sendStatus(socket, "405 Method Not Allowed");
+    } else if (line[first + 1] != '/' || !decodeName(line.substr(first + 2, second - first - 2), name)) {
+        sendStatus(socket, "400 Bad Request");
+    } else if (!root || !root->isOpen()) {
+        sendStatus(socket, "503 Service Unavailable");
+    } else {
+        requests_served_++;
+        sendFile(socket, root, name);
+    }
+
+    // Last use of the cluster from this thread; stop() may return as soon as this unlocks
+    std::lock_guard<std::mutex> lock(mutex_);
+    CLOSE_SOCKET(socket);
+    active_.erase(socket);
+    idle_.notify_all();
+}
+
+bool TftpCluster::sendFile(socket_t socket, const std::shared_ptr<const TftpRootHandle>& root,
+                           const std::string& name) {
+    std::vector<uint8_t> buffer(BUFFER_SIZE);
+    const char* data = reinterpret_cast<const char*>(buffer.data());
+
+    // Held here: straight from the root
+    TftpFileHandle file = root->openRead(name);
+    if (file.isOpen()) {
+#ifndef PLATFORM_WINDOWS
+        struct stat info {};
+        if (fstat(file.get(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            return sendStatus(socket, "404 Not Found");
+        }
+        uint64_t remaining = static_cast<uint64_t>(info.st_size);
+#else
+        uint64_t remaining = 0;
+#endif
+        if (!sendHead(socket, remaining)) {
+            return false;
+        }
+        while (remaining > 0) {
+            size_t wanted = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+            int64_t count = file.read(buffer.data(), wanted);
+            if (count <= 0 || !sendAll(socket, data, static_cast<size_t>(count))) {
+                return false;
+            }
+            remaining -= static_cast<uint64_t>(count);
+            bytes_served_ += static_cast<uint64_t>(count);
+        }
+        return true;
+    }
+
+    // Owned but missing: fill from the origin and stream it on
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    owned_misses_++;
+    switch (origin_.fetch(root, name, fetch)) {
+    case TftpOriginStore::Result::FETCHING:
+        break;
+    case TftpOriginStore::Result::TOO_LARGE:
+        return sendStatus(socket, "413 Payload Too Large");
+    case TftpOriginStore::Result::FAILED:
+        return sendStatus(socket, "502 Bad Gateway");
+    default:
+        return sendStatus(socket, "404 Not Found");
+    }
+    uint64_t size = 0;
+    if (!fetch->waitForSize(size)) {
+        return sendStatus(socket, "502 Bad Gateway");
+    }
+    if (!sendHead(socket, size)) {
+        return false;
+    }
+    TftpOriginReader reader(fetch);
+    uint64_t sent = 0;
+    while (sent < size) {
+        size_t wanted = static_cast<size_t>(std::min<uint64_t>(size - sent, buffer.size()));
+        int64_t count = reader.read(buffer.data(), wanted);
+        if (count <= 0 || !sendAll(socket, data, static_cast<size_t>(count))) {
+            return false;  // The peer sees a short body and fails its download
+        }
+        sent += static_cast<uint64_t>(count);
+        bytes_served_ += static_cast<uint64_t>(count);
+    }
+    return true;
+}
+
+void TftpCluster::logEvent(LogLevel level, const std::string& message) const {
+    if (logger_) {
+        logger_->log(level, "[Cluster] " + message);
+    }
+}
+
+} // namespace simple_tftpd
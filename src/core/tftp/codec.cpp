@@ -0,0 +1,443 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <system_error>
+
+namespace simple_tftpd {
+
+namespace {
+
+inline uint16_t readU16(const uint8_t* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+inline void writeU16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>((value >> 8) & 0xFF);
+    out[1] = static_cast<uint8_t>(value & 0xFF);
+}
+
+/**
+ * @brief Find the NUL terminating a string starting at @p offset
+ * @return Index of the NUL, or @p size when unterminated
+ */
+inline size_t findTerminator(const uint8_t* data, size_t offset, size_t size) {
+    const void* nul = std::memchr(data + offset, 0, size - offset);
+    return nul ? static_cast<size_t>(static_cast<const uint8_t*>(nul) - data) : size;
+}
+
+/**
+ * @brief Bounded writer over caller storage; sticky failure on overflow
+ */
+class WireWriter {
+public:
+    WireWriter(uint8_t* out, size_t capacity) : out_(out), capacity_(capacity) {}
+
+    void u16(uint16_t value) {
+        if (reserve(2)) {
+            writeU16(out_ + length_, value);
+            length_ += 2;
+        }
+    }
+
+    void string(std::string_view value) {
+        if (reserve(value.size() + 1)) {
+            std::memcpy(out_ + length_, value.data(), value.size());
+            length_ += value.size();
+            out_[length_++] = 0;
+        }
+    }
+
+    void number(uint32_t value) {
+        char digits[10];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        string(std::string_view(digits, static_cast<size_t>(result.ptr - digits)));
+    }
+
+    void bytes(ByteView value) {
+        if (reserve(value.size)) {
+            if (value.size > 0) {
+                std::memcpy(out_ + length_, value.data, value.size);
+            }
+            length_ += value.size;
+        }
+    }
+
+    void option(std::string_view name, uint32_t value) {
+        string(name);
+        number(value);
+    }
+
+    size_t finish() const {
+        return failed_ ? 0 : length_;
+    }
+
+private:
+    bool reserve(size_t count) {
+        if (failed_ || !out_ || capacity_ - length_ < count) {
+            failed_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    uint8_t* out_;
+    size_t capacity_;
+    size_t length_ = 0;
+    bool failed_ = false;
+};
+
+/**
+ * @brief Parse a plain decimal option value
+ *
+ * Negotiated sizes are upper bounds (RFC 2348, RFC 7440), so with
+ * @p saturate an oversized request is answered with @p limit instead of
+ * being dropped. Signs, spaces and trailing characters are rejected.
+ */
+template <typename T>
+bool parseDecimal(std::string_view text, T limit, bool saturate, T& value) {
+    if (text.empty()) {
+        return false;
+    }
+
+    uint64_t parsed = 0;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (result.ptr != text.data() + text.size()) {
+        return false;
+    }
+    if (result.ec == std::errc::result_out_of_range || (result.ec == std::errc() && parsed > limit)) {
+        if (!saturate) {
+            return false;
+        }
+        parsed = limit;
+    } else if (result.ec != std::errc()) {
+        return false;
+    }
+
+    value = static_cast<T>(parsed);
+    return true;
+}
+
+bool parseBlksizeOption(std::string_view text, TftpOptions& options) {
+    if (!parseDecimal<uint16_t>(text, 65535, true, options.blksize)) {
+        return false;
+    }
+    options.has_blksize = true;
+    return true;
+}
+
+bool parseTimeoutOption(std::string_view text, TftpOptions& options) {
+    if (!parseDecimal<uint16_t>(text, 255, true, options.timeout)) {
+        return false;
+    }
+    options.has_timeout = true;
+    return true;
+}
+
+bool parseTsizeOption(std::string_view text, TftpOptions& options) {
+    // A transfer size is exact; saturating it would corrupt the size check
+    if (!parseDecimal<uint32_t>(text, UINT32_MAX, false, options.tsize)) {
+        return false;
+    }
+    options.has_tsize = true;
+    return true;
+}
+
+bool parseWindowsizeOption(std::string_view text, TftpOptions& options) {
+    if (!parseDecimal<uint16_t>(text, 65535, true, options.windowsize)) {
+        return false;
+    }
+    options.has_windowsize = true;
+    return true;
+}
+
+/**
+ * @brief RFC 2090: empty in a request, "addr,port,mc" in an OACK
+ *
+ * The address and port may be empty in OACKs that only hand over the
+ * master role, so only the mc flag is mandatory.
+ */
+bool parseMulticastOption(std::string_view text, TftpOptions& options) {
+    if (text.empty()) {
+        options.multicast = true;
+        return true;
+    }
+
+    size_t first = text.find(',');
+    size_t second = first == std::string_view::npos ? first : text.find(',', first + 1);
+    if (second == std::string_view::npos) {
+        return false;
+    }
+
+    std::string_view address = text.substr(0, first);
+    std::string_view port = text.substr(first + 1, second - first - 1);
+    std::string_view master = text.substr(second + 1);
+    uint16_t port_value = 0;
+    if (address.size() > 15 || (!port.empty() && !parseDecimal<uint16_t>(port, 65535, false, port_value)) ||
+        (master != "0" && master != "1")) {
+        return false;
+    }
+
+    options.multicast = true;
+    options.multicast_ip.assign(address.data(), address.size());
+    options.multicast_port = port_value;
+    options.multicast_master = master == "1";
+    return true;
+}
+
+/**
+ * @brief Known request options; adding one is a row here plus a TftpOptions field
+ */
+struct TftpOptionSpec {
+    std::string_view name;
+    bool (*parse)(std::string_view text, TftpOptions& options);
+};
+
+constexpr TftpOptionSpec TFTP_OPTION_TABLE[] = {
+    {"blksize",    parseBlksizeOption},     // RFC 2348
+    {"timeout",    parseTimeoutOption},     // RFC 2349
+    {"tsize",      parseTsizeOption},       // RFC 2349
+    {"windowsize", parseWindowsizeOption},  // RFC 7440
+    {"multicast",  parseMulticastOption},   // RFC 2090
+};
+
+void writeOptions(WireWriter& writer, const TftpOptions& options) {
+    if (options.has_blksize) {
+        writer.option("blksize", options.blksize);
+    }
+    if (options.has_timeout) {
+        writer.option("timeout", options.timeout);
+    }
+    if (options.has_tsize) {
+        writer.option("tsize", options.tsize);
+    }
+    if (options.has_windowsize) {
+        writer.option("windowsize", options.windowsize);
+    }
+    if (options.multicast) {
+        writer.string("multicast");
+        if (options.multicast_ip.empty() && options.multicast_port == 0 && !options.multicast_master) {
+            writer.string("");
+        } else {
+            // addr (max 15) + ',' + port (max 5) + ',' + mc
+            char value[24];
+            char* end = value;
+            std::memcpy(end, options.multicast_ip.data(), std::min<size_t>(options.multicast_ip.size(), 15));
+            end += std::min<size_t>(options.multicast_ip.size(), 15);
+            *end++ = ',';
+            if (options.multicast_port != 0) {
+                end = std::to_chars(end, value + sizeof(value), options.multicast_port).ptr;
+            }
+            *end++ = ',';
+            *end++ = options.multicast_master ? '1' : '0';
+            writer.string(std::string_view(value, static_cast<size_t>(end - value)));
+        }
+    }
+}
+
+} // namespace
+
+bool TftpCodec::peekOpcode(const uint8_t* data, size_t size, TftpOpcode& opcode) {
+    if (!data || size < 2) {
+        return false;
+    }
+
+    const TftpOpcodeInfo* info = findOpcodeInfo(readU16(data));
+    if (!info || size < info->min_size || size > info->max_size) {
+        return false;
+    }
+
+    opcode = info->opcode;
+    return true;
+}
+
+bool TftpCodec::decodeRequest(const uint8_t* data, size_t size, TftpRequestView& view) {
+    TftpOpcode opcode;
+    if (!peekOpcode(data, size, opcode) ||
+        (opcode != TftpOpcode::RRQ && opcode != TftpOpcode::WRQ)) {
+        return false;
+    }
+
+    size_t filename_end = findTerminator(data, 2, size);
+    if (filename_end == 2 || filename_end >= size) {
+        return false;
+    }
+
+    size_t mode_start = filename_end + 1;
+    size_t mode_end = findTerminator(data, mode_start, size);
+    if (mode_end == mode_start || mode_end >= size) {
+        return false;
+    }
+
+    std::string_view mode_name(reinterpret_cast<const char*>(data + mode_start), mode_end - mode_start);
+    const TftpModeInfo* mode = nullptr;
+    for (const auto& entry : TFTP_MODE_TABLE) {
+        if (equalsIgnoreCase(entry.name, mode_name)) {
+            mode = &entry;
+            break;
+        }
+    }
+    if (!mode) {
+        return false;
+    }
+
+    view.opcode = opcode;
+    view.filename = std::string_view(reinterpret_cast<const char*>(data + 2), filename_end - 2);
+    view.mode = mode->mode;
+    view.options = ByteView(data + mode_end + 1, size - mode_end - 1);
+    return true;
+}
+
+bool TftpCodec::decodeOptions(ByteView options, TftpOptions& result) {
+    result = TftpOptions{};
+
+    const uint8_t* data = options.data;
+    size_t size = options.size;
+    size_t offset = 0;
+    while (offset < size) {
+        size_t name_end = findTerminator(data, offset, size);
+        if (name_end >= size) {
+            return false;
+        }
+        size_t value_end = findTerminator(data, name_end + 1, size);
+        if (value_end >= size) {
+            return false;
+        }
+
+        std::string_view name(reinterpret_cast<const char*>(data + offset), name_end - offset);
+        std::string_view value(reinterpret_cast<const char*>(data + name_end + 1), value_end - name_end - 1);
+        offset = value_end + 1;
+
+        for (const auto& spec : TFTP_OPTION_TABLE) {
+            if (equalsIgnoreCase(spec.name, name)) {
+                spec.parse(value, result);
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool TftpCodec::decodeData(const uint8_t* data, size_t size, TftpDataView& view) {
+    TftpOpcode opcode;
+    if (!peekOpcode(data, size, opcode) || opcode != TftpOpcode::DATA) {
+        return false;
+    }
+
+    view.block = readU16(data + 2);
+    view.payload = ByteView(data + HEADER_SIZE, size - HEADER_SIZE);
+    return true;
+}
+
+bool TftpCodec::decodeAck(const uint8_t* data, size_t size, TftpAckView& view) {
+    TftpOpcode opcode;
+    if (!peekOpcode(data, size, opcode) || opcode != TftpOpcode::ACK) {
+        return false;
+    }
+
+    view.block = readU16(data + 2);
+    return true;
+}
+
+bool TftpCodec::decodeError(const uint8_t* data, size_t size, TftpErrorView& view) {
+    TftpOpcode opcode;
+    if (!peekOpcode(data, size, opcode) || opcode != TftpOpcode::ERROR) {
+        return false;
+    }
+
+    size_t message_end = findTerminator(data, HEADER_SIZE, size);
+    view.code = readU16(data + 2);
+    view.message = std::string_view(reinterpret_cast<const char*>(data + HEADER_SIZE), message_end - HEADER_SIZE);
+    return true;
+}
+
+size_t TftpCodec::encodeRequest(uint8_t* out, size_t capacity, TftpOpcode opcode,
+                                std::string_view filename, TftpMode mode,
+                                const TftpOptions& options) {
+    WireWriter writer(out, capacity);
+    writer.u16(static_cast<uint16_t>(opcode));
+    writer.string(filename);
+    writer.string(modeToWireName(mode));
+    writeOptions(writer, options);
+    return writer.finish();
+}
+
+size_t TftpCodec::encodeDataHeader(uint8_t* out, size_t capacity, uint16_t block) {
+    WireWriter writer(out, capacity);
+    writer.u16(static_cast<uint16_t>(TftpOpcode::DATA));
+    writer.u16(block);
+    return writer.finish();
+}
+
+size_t TftpCodec::encodeData(uint8_t* out, size_t capacity, uint16_t block, ByteView payload) {
+    WireWriter writer(out, capacity);
+    writer.u16(static_cast<uint16_t>(TftpOpcode::DATA));
+    writer.u16(block);
+    writer.bytes(payload);
+    return writer.finish();
+}
+
+size_t TftpCodec::encodeAck(uint8_t* out, size_t capacity, uint16_t block) {
+    WireWriter writer(out, capacity);
+    writer.u16(static_cast<uint16_t>(TftpOpcode::ACK));
+    writer.u16(block);
+    return writer.finish();
+}
+
+size_t TftpCodec::encodeError(uint8_t* out, size_t capacity, TftpError code, std::string_view message) {
+    WireWriter writer(out, capacity);
+    writer.u16(static_cast<uint16_t>(TftpOpcode::ERROR));
+    writer.u16(static_cast<uint16_t>(code));
+    writer.string(message);
+    return writer.finish();
+}
+
+size_t TftpCodec::encodeOptionAck(uint8_t* out, size_t capacity, const TftpOptions& options) {
+    WireWriter writer(out, capacity);
+    writer.u16(static_cast<uint16_t>(TftpOpcode::OACK));
+    writeOptions(writer, options);
+    return writer.finish();
+}
+
+void NetasciiEncoder::encode(ByteView input, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + input.size + input.size / 8);
+    for (size_t i = 0; i < input.size; ++i) {
+        uint8_t byte = input.data[i];
+        if (byte == '\n' && !previous_cr_) {
+            out.push_back('\r');
+        }
+        out.push_back(byte);
+        previous_cr_ = byte == '\r';
+    }
+}
+
+uint64_t NetasciiEncoder::measure(ByteView input) {
+    uint64_t length = input.size;
+    for (size_t i = 0; i < input.size; ++i) {
+        uint8_t byte = input.data[i];
+        if (byte == '\n' && !previous_cr_) {
+            ++length;
+        }
+        previous_cr_ = byte == '\r';
+    }
+    return length;
+}
+
+} // namespace simple_tftpd
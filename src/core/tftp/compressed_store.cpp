@@ -0,0 +1,564 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/compressed_store.hpp"
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace simple_tftpd {
+
+namespace {
+
+constexpr size_t INPUT_BUFFER_SIZE = 64 * 1024;
+constexpr size_t MAX_SCANNED_SIZES = 4096;
+// A sidecar holds one decimal count
+constexpr size_t MAX_SIDECAR_SIZE = 64;
+
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+// zstd frame format (RFC 8878)
+constexpr uint32_t FRAME_MAGIC = 0xFD2FB528;
+constexpr uint32_t SKIPPABLE_MAGIC = 0x184D2A50;
+constexpr uint32_t SKIPPABLE_MASK = 0xFFFFFFF0;
+constexpr size_t FRAME_HEADER_MAX = 18;
+
+uint32_t readLittleEndian(const uint8_t* data, size_t bytes) {
+    uint32_t value = 0;
+    for (size_t i = bytes; i > 0; --i) {
+        value = (value << 8) | data[i - 1];
+    }
+    return value;
+}
+#endif
+
+} // namespace
+
+/**
+ * @brief Codec state behind the reader, keeping library headers out of the interface
+ */
+struct TftpCompressedReader::Decoder {
+    TftpCompression codec;
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+    z_stream zlib{};
+    bool zlib_ready = false;
+#endif
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+    ZSTD_DCtx* zstd = nullptr;
+#endif
+
+    explicit Decoder(TftpCompression format) : codec(format) {}
+
+    ~Decoder() {
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+        if (zlib_ready) {
+            inflateEnd(&zlib);
+        }
+#endif
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+        ZSTD_freeDCtx(zstd);
+#endif
+    }
+
+    bool init() {
+        switch (codec) {
+            case TftpCompression::GZIP:
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+                // 15 + 32: maximum window, accept gzip or zlib headers
+                zlib_ready = inflateInit2(&zlib, 15 + 32) == Z_OK;
+                return zlib_ready;
+#else
+                return false;
+#endif
+            case TftpCompression::ZSTD:
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+                zstd = ZSTD_createDCtx();
+                return zstd != nullptr;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    bool reset() {
+        switch (codec) {
+            case TftpCompression::GZIP:
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+                return inflateReset(&zlib) == Z_OK;
+#else
+                return false;
+#endif
+            case TftpCompression::ZSTD:
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+                return !ZSTD_isError(ZSTD_DCtx_reset(zstd, ZSTD_reset_session_only));
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    /**
+     * @brief Decode as much as fits
+     * @return false on corrupt input; frame_done is set when a member or frame ended
+     */
+    bool decode([[maybe_unused]] const uint8_t* in, [[maybe_unused]] size_t in_size, size_t& consumed,
+                [[maybe_unused]] uint8_t* out, [[maybe_unused]] size_t out_size, size_t& produced,
+                bool& frame_done) {
+        consumed = 0;
+        produced = 0;
+        frame_done = false;
+        switch (codec) {
+            case TftpCompression::GZIP: {
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+                zlib.next_in = const_cast<Bytef*>(in);
+                zlib.avail_in = static_cast<uInt>(in_size);
+                zlib.next_out = out;
+                zlib.avail_out = static_cast<uInt>(out_size);
+                int result = inflate(&zlib, Z_NO_FLUSH);
+                consumed = in_size - zlib.avail_in;
+                produced = out_size - zlib.avail_out;
+                frame_done = result == Z_STREAM_END;
+                return result == Z_OK || result == Z_STREAM_END || result == Z_BUF_ERROR;
+#else
+                return false;
+#endif
+            }
+            case TftpCompression::ZSTD: {
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+                ZSTD_inBuffer input{in, in_size, 0};
+                ZSTD_outBuffer output{out, out_size, 0};
+                size_t result = ZSTD_decompressStream(zstd, &output, &input);
+                consumed = input.pos;
+                produced = output.pos;
+                if (ZSTD_isError(result)) {
+                    return false;
+                }
+                frame_done = result == 0;
+                return true;
+#else
+                return false;
+#endif
+            }
+        }
+        return false;
+    }
+};
+
+TftpCompressedReader::TftpCompressedReader(TftpCompression codec, TftpCompressedStore* store)
+    : codec_(codec),
+      store_(store),
+      input_pos_(0),
+      input_len_(0),
+      unreported_input_(0),
+      produced_(0),
+      limit_(std::numeric_limits<uint64_t>::max()),
+      frame_done_(false),
+      eof_(false),
+      failed_(false) {}
+
+TftpCompressedReader::~TftpCompressedReader() = default;
+
+bool TftpCompressedReader::open(TftpFileHandle file) {
+    if (!TftpCompressedStore::isSupported(codec_)) {
+        return false;
+    }
+
+    decoder_ = std::make_unique<Decoder>(codec_);
+    if (!decoder_->init()) {
+        decoder_.reset();
+        return false;
+    }
+
+    file_ = std::move(file);
+    if (!file_.isOpen()) {
+        return false;
+    }
+    input_.resize(INPUT_BUFFER_SIZE);
+    return true;
+}
+
+size_t TftpCompressedReader::read(uint8_t* out, size_t size) {
+    if (!decoder_) {
+        failed_ = true;
+        return 0;
+    }
+
+    size_t total = 0;
+    std::chrono::nanoseconds decode_time{0};
+    while (total < size && !eof_ && !failed_) {
+        if (input_pos_ == input_len_ && !fillInput()) {
+            // Input may only end between members/frames
+            if (frame_done_ && !failed_) {
+                eof_ = true;
+            } else {
+                failed_ = true;
+            }
+            break;
+        }
+
+        if (frame_done_) {
+            // Another member or frame follows the one that just ended
+            if (!decoder_->reset()) {
+                failed_ = true;
+                break;
+            }
+            frame_done_ = false;
+        }
+
+        size_t consumed = 0;
+        size_t produced = 0;
+        bool done = false;
+        auto started = std::chrono::steady_clock::now();
+        bool ok = decoder_->decode(input_.data() + input_pos_, input_len_ - input_pos_, consumed,
+                                   out + total, size - total, produced, done);
+        decode_time += std::chrono::steady_clock::now() - started;
+
+        if (!ok || (consumed == 0 && produced == 0 && !done)) {
+            failed_ = true;
+            break;
+        }
+        input_pos_ += consumed;
+        frame_done_ = done;
+        if (produced > limit_ - produced_) {
+            // The copy holds more than the size advertised for it
+            total += static_cast<size_t>(limit_ - produced_);
+            produced_ = limit_;
+            failed_ = true;
+            break;
+        }
+        produced_ += produced;
+        total += produced;
+    }
+
+    if (store_) {
+        store_->recordDecompression(unreported_input_, total, decode_time);
+    }
+    unreported_input_ = 0;
+    return total;
+}
+
+bool TftpCompressedReader::rewind() {
+    if (!decoder_ || !decoder_->reset()) {
+        return false;
+    }
+    input_pos_ = 0;
+    input_len_ = 0;
+    produced_ = 0;
+    frame_done_ = false;
+    eof_ = false;
+    failed_ = false;
+    return file_.rewind();
+}
+
+bool TftpCompressedReader::fillInput() {
+    int64_t count = file_.read(input_.data(), input_.size());
+    input_pos_ = 0;
+    if (count < 0) {
+        failed_ = true;
+        input_len_ = 0;
+        return false;
+    }
+    input_len_ = static_cast<size_t>(count);
+    unreported_input_ += input_len_;
+    return input_len_ > 0;
+}
+
+TftpCompressedStore::TftpCompressedStore(std::shared_ptr<TftpConfig> config)
+    : config_(std::move(config)),
+      files_opened_(0),
+      compressed_bytes_read_(0),
+      bytes_decompressed_(0),
+      decompress_time_ns_(0),
+      size_scans_(0) {}
+
+void TftpCompressedStore::setConfig(std::shared_ptr<TftpConfig> config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = std::move(config);
+}
+
+bool TftpCompressedStore::isSupported(TftpCompression codec) {
+    switch (codec) {
+        case TftpCompression::GZIP:
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case TftpCompression::ZSTD:
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool TftpCompressedStore::resolve(const std::shared_ptr<const TftpRootHandle>& root, const std::string& filename,
+                                  TftpCompressedCopy& copy) {
+    std::shared_ptr<TftpConfig> config;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+    }
+    if (!config || !config->isCompressedFilesEnabled()) {
+        return false;
+    }
+
+    std::string base = config->getCompressedDirectory();
+    std::shared_ptr<const TftpRootHandle> directory = base.empty() ? root : compressedDirectory(base);
+    if (!directory || !directory->isOpen()) {
+        return false;
+    }
+
+    // zstd first: it decodes several times faster than gzip at similar ratios
+    static const std::pair<const char*, TftpCompression> candidates[] = {
+        {".zst", TftpCompression::ZSTD},
+        {".gz", TftpCompression::GZIP},
+    };
+    for (const auto& candidate : candidates) {
+        if (!isSupported(candidate.second)) {
+            continue;
+        }
+        std::string name = filename + candidate.first;
+        TftpFileMetadata metadata;
+        if (directory->stat(name, metadata) && metadata.regular) {
+            copy.directory = directory;
+            copy.name = name;
+            copy.path = directory->getRoot() + "/" + name;
+            copy.codec = candidate.second;
+            copy.metadata = metadata;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const TftpRootHandle> TftpCompressedStore::compressedDirectory(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (directory_ && directory_->getRoot() == path) {
+            return directory_;
+        }
+    }
+
+    // Opened outside the lock; a racing resolve() may open its own, either is fine
+    auto handle = std::make_shared<TftpRootHandle>();
+    if (!handle->open(path)) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = handle;
+    return handle;
+}
+
+uint32_t TftpCompressedStore::resolveProbes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!config_ || !config_->isCompressedFilesEnabled()) {
+        return 0;
+    }
+    return (isSupported(TftpCompression::ZSTD) ? 1u : 0u) + (isSupported(TftpCompression::GZIP) ? 1u : 0u);
+}
+
+bool TftpCompressedStore::contentSize(const TftpCompressedCopy& copy, uint64_t& size) {
+    if (readSidecarSize(copy, size)) {
+        return true;
+    }
+
+    SizeKey key(copy.path, copy.metadata.modified);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = scanned_sizes_.find(key);
+        if (it != scanned_sizes_.end()) {
+            size = it->second;
+            return true;
+        }
+    }
+
+    uint64_t total = 0;
+    if (!readFrameSizes(copy, total)) {
+        // No recorded size: decompress once and count
+        TftpCompressedReader reader(copy.codec, this);
+        if (!reader.open(copy.directory->openRead(copy.name))) {
+            return false;
+        }
+        std::vector<uint8_t> buffer(INPUT_BUFFER_SIZE);
+        while (!reader.eof() && !reader.failed()) {
+            total += reader.read(buffer.data(), buffer.size());
+        }
+        size_scans_.fetch_add(1, std::memory_order_relaxed);
+        if (reader.failed()) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (scanned_sizes_.size() >= MAX_SCANNED_SIZES) {
+        scanned_sizes_.clear();
+    }
+    scanned_sizes_[key] = total;
+    size = total;
+    return true;
+}
+
+std::unique_ptr<TftpCompressedReader> TftpCompressedStore::open(const TftpCompressedCopy& copy,
+                                                                uint64_t content_size) {
+    if (!copy.directory) {
+        return nullptr;
+    }
+    auto reader = std::make_unique<TftpCompressedReader>(copy.codec, this);
+    if (!reader->open(copy.directory->openRead(copy.name))) {
+        return nullptr;
+    }
+    reader->limitTo(content_size);
+    files_opened_.fetch_add(1, std::memory_order_relaxed);
+    return reader;
+}
+
+void TftpCompressedStore::recordDecompression(uint64_t compressed_bytes, uint64_t decompressed_bytes,
+                                              std::chrono::nanoseconds decode_time) {
+    compressed_bytes_read_.fetch_add(compressed_bytes, std::memory_order_relaxed);
+    bytes_decompressed_.fetch_add(decompressed_bytes, std::memory_order_relaxed);
+    decompress_time_ns_.fetch_add(static_cast<uint64_t>(decode_time.count()), std::memory_order_relaxed);
+}
+
+TftpCompressionStats TftpCompressedStore::getStats() const {
+    TftpCompressionStats stats;
+    stats.files_opened = files_opened_.load(std::memory_order_relaxed);
+    stats.compressed_bytes_read = compressed_bytes_read_.load(std::memory_order_relaxed);
+    stats.bytes_decompressed = bytes_decompressed_.load(std::memory_order_relaxed);
+    stats.decompress_time_us = decompress_time_ns_.load(std::memory_order_relaxed) / 1000;
+    stats.size_scans = size_scans_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool TftpCompressedStore::readSidecarSize(const TftpCompressedCopy& copy, uint64_t& size) const {
+    std::string sidecar = copy.name + ".size";
+    TftpFileMetadata metadata;
+    if (!copy.directory->stat(sidecar, metadata) || !metadata.regular || metadata.size > MAX_SIDECAR_SIZE ||
+        metadata.modified < copy.metadata.modified) {
+        return false;
+    }
+
+    TftpFileHandle file = copy.directory->openRead(sidecar);
+    char buffer[MAX_SIDECAR_SIZE];
+    int64_t count = file.isOpen() ? file.read(buffer, sizeof(buffer)) : -1;
+    if (count < 0) {
+        return false;
+    }
+    std::string text(buffer, static_cast<size_t>(count));
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) {
+        ++begin;
+    }
+    while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) {
+        --end;
+    }
+
+    uint64_t value = 0;
+    auto result = std::from_chars(text.data() + begin, text.data() + end, value);
+    if (begin == end || result.ec != std::errc() || result.ptr != text.data() + end) {
+        return false;
+    }
+    size = value;
+    return true;
+}
+
+bool TftpCompressedStore::readFrameSizes([[maybe_unused]] const TftpCompressedCopy& copy,
+                                         [[maybe_unused]] uint64_t& size) const {
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+    if (copy.codec != TftpCompression::ZSTD) {
+        return false;
+    }
+    TftpFileHandle file = copy.directory->openRead(copy.name);
+    TftpFileMetadata metadata;
+    if (!file.isOpen() || !file.stat(metadata)) {
+        return false;
+    }
+
+    // pzstd output and concatenated files hold several frames, and the reader
+    // decodes them all, so every frame has to record its size. Frames are
+    // skipped by their block headers: a few bytes read per block, no decoding
+    uint64_t offset = 0;
+    uint64_t total = 0;
+    while (offset < metadata.size) {
+        uint8_t header[FRAME_HEADER_MAX];
+        int64_t count = file.readAt(offset, header, sizeof(header));
+        if (count < 8) {
+            return false;
+        }
+        uint32_t magic = readLittleEndian(header, 4);
+        if ((magic & SKIPPABLE_MASK) == SKIPPABLE_MAGIC) {
+            offset += 8 + static_cast<uint64_t>(readLittleEndian(header + 4, 4));
+            continue;
+        }
+        unsigned long long content_size = ZSTD_getFrameContentSize(header, static_cast<size_t>(count));
+        if (magic != FRAME_MAGIC || content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+            content_size == ZSTD_CONTENTSIZE_ERROR) {
+            return false;
+        }
+        total += static_cast<uint64_t>(content_size);
+
+        // Frame header: magic, descriptor, window byte unless single segment,
+        // dictionary ID and content size fields sized by the descriptor
+        uint8_t descriptor = header[4];
+        bool single_segment = (descriptor & 0x20) != 0;
+        static const uint64_t dictionary_sizes[] = {0, 1, 2, 4};
+        static const uint64_t content_sizes[] = {0, 2, 4, 8};
+        uint64_t content_field = content_sizes[descriptor >> 6];
+        if (content_field == 0 && single_segment) {
+            content_field = 1;
+        }
+        offset += 5 + (single_segment ? 0 : 1) + dictionary_sizes[descriptor & 0x03] + content_field;
+
+        for (bool last = false; !last;) {
+            uint8_t block[3];
+            if (file.readAt(offset, block, sizeof(block)) != static_cast<int64_t>(sizeof(block))) {
+                return false;
+            }
+            uint32_t block_header = readLittleEndian(block, 3);
+            uint32_t type = (block_header >> 1) & 0x03;
+            if (type == 3) {
+                return false;  // Reserved
+            }
+            last = (block_header & 0x01) != 0;
+            // An RLE block stores its one repeated byte
+            offset += 3 + (type == 1 ? 1 : static_cast<uint64_t>(block_header >> 3));
+        }
+        if (descriptor & 0x04) {
+            offset += 4;  // Content checksum
+        }
+    }
+    if (offset != metadata.size) {
+        return false;
+    }
+    size = total;
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace simple_tftpd
@@ -20,43 +20,153 @@
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
+#include <cstring>
 #include <limits>
+#include <sstream>
+#include <iomanip>
 
 namespace simple_tftpd {
 
+namespace {
+
+// Packets kept for a connection whose request is still being set up; the
+// client sends one answer to the first reply, so this only absorbs duplicates
+constexpr size_t MAX_DEFERRED_PACKETS = 8;
+
+// Failures from transmitFileBlock(); a retransmit reports the two differently
+constexpr int64_t TRANSMIT_READ_FAILED = -1;
+constexpr int64_t TRANSMIT_SEND_FAILED = -2;
+
+std::string escapeJsonString(const std::string& value) {
+    std::ostringstream escaped;
+    for (char c : value) {
+        switch (c) {
+            case '"': escaped << "\\\""; break;
+            case '\\': escaped << "\\\\"; break;
+            case '\n': escaped << "\\n"; break;
+            case '\r': escaped << "\\r"; break;
+            case '\t': escaped << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                            << static_cast<int>(static_cast<unsigned char>(c)) << std::dec;
+                } else {
+                    escaped << c;
+                }
+        }
+    }
+    return escaped.str();
+}
+
+} // namespace
+
+std::string connectionStateToString(TftpConnectionState state) {
+    switch (state) {
+        case TftpConnectionState::INITIALIZED: return "initialized";
+        case TftpConnectionState::CONNECTED: return "connected";
+        case TftpConnectionState::TRANSFERRING: return "transferring";
+        case TftpConnectionState::COMPLETED: return "completed";
+        case TftpConnectionState::ERROR: return "error";
+        case TftpConnectionState::CLOSED: return "closed";
+    }
+    return "unknown";
+}
+
+std::string transferDirectionToString(TftpTransferDirection direction) {
+    return direction == TftpTransferDirection::READ ? "read" : "write";
+}
+
+std::string TftpConnectionTelemetry::toJson() const {
+    std::ostringstream json;
+    json << "{";
+    json << "\"client\":\"" << client_address << ":" << client_port << "\",";
+    json << "\"client_address\":\"" << client_address << "\",";
+    json << "\"client_port\":" << client_port << ",";
+    json << "\"filename\":\"" << escapeJsonString(filename) << "\",";
+    json << "\"state\":\"" << connectionStateToString(state) << "\",";
+    json << "\"direction\":\"" << transferDirectionToString(direction) << "\",";
+    json << "\"bytes_transferred\":" << bytes_transferred << ",";
+    json << "\"total_bytes\":" << total_bytes << ",";
+    json << "\"percent_complete\":" << std::fixed << std::setprecision(1) << percent_complete << ",";
+    json << "\"throughput_bps\":" << std::setprecision(0) << throughput_bps << ",";
+    json << "\"block_size\":" << block_size << ",";
+    json << "\"effective_window\":" << effective_window << ",";
+    json << "\"in_flight\":" << in_flight << ",";
+    json << "\"retransmits\":" << retransmits << ",";
+    json << "\"retransmit_buffer_bytes\":" << retransmit_buffer_bytes << ",";
+    json << "\"duplicate_acks\":" << duplicate_acks << ",";
+    json << "\"duplicate_data\":" << duplicate_data << ",";
+    json << "\"rtt_us\":" << rtt_us << ",";
+    json << "\"duration_ms\":" << duration_ms;
+    json << "}";
+    return json.str();
+}
+
 TftpConnection::TftpConnection(TftpServer& server,
                              const std::string& client_addr,
                              port_t client_port,
                              std::shared_ptr<TftpConfig> config,
                              std::shared_ptr<Logger> logger)
     : server_(server),
-      client_addr_(client_addr),
-      client_port_(client_port),
-      config_(config),
-      logger_(logger),
-      state_(TftpConnectionState::INITIALIZED),
-      direction_(TftpTransferDirection::READ),
-      bytes_transferred_(0),
       current_block_(0),
       expected_block_(0),
-      start_time_(std::chrono::steady_clock::now()),
-      last_activity_(start_time_),
-      timeout_(std::chrono::seconds(config ? config->getTimeout() : 5)),
-      active_(false),
       next_block_to_send_(1),
       last_ack_block_(0),
+      final_block_number_(0),
+      negotiated_block_size_(config ? config->getBlockSize() : 512),
+      negotiated_window_size_(config ? config->getWindowSize() : 1),
       max_retries_(config ? config->getMaxRetries() : 5),
+      gso_segments_(0),
       awaiting_data_(false),
       sent_option_ack_(false),
       awaiting_oack_ack_(false),
       final_block_sent_(false),
-      final_block_number_(0),
-      negotiated_block_size_(config ? config->getBlockSize() : 512),
-      negotiated_window_size_(config ? config->getWindowSize() : 1),
+      retransmit_from_file_(false),
+      gso_batching_(false),
+      gap_pending_(false),
+      resent_any_(false),
+      resent_through_(0),
+      active_(false),
+      timeout_(std::chrono::seconds(config ? config->getTimeout() : 5)),
+      last_activity_(std::chrono::steady_clock::now()),
+      last_ack_time_(last_activity_),
+      last_data_time_(last_activity_),
+      gap_deadline_(last_activity_),
+      bytes_transferred_(0),
+      ack_retry_count_(0),
+      next_frame_index_(0),
       current_file_size_(0),
       advertised_file_size_(0),
-      ack_retry_count_(0),
-      last_ack_time_(start_time_) {}
+      send_offset_(0),
+      client_addr_(client_addr),
+      client_port_(client_port),
+      config_(config),
+      logger_(logger),
+      state_(TftpConnectionState::INITIALIZED),
+      direction_(TftpTransferDirection::READ),
+      start_time_(last_activity_),
+      setting_up_(false),
+      read_file_size_(0),
+      read_modified_(0),
+      read_open_pending_(false),
+      read_compressed_(false),
+      source_offset_(0),
+      netascii_offset_(0),
+      cached_stream_shared_(false),
+      gso_frames_(0),
+      progress_bytes_(0),
+      expected_bytes_(0),
+      throughput_bps_(0),
+      unsampled_bytes_(0),
+      retransmit_count_(0),
+      retransmit_buffer_bytes_(0),
+      duplicate_ack_count_(0),
+      duplicate_data_count_(0),
+      smoothed_rtt_us_(0),
+      in_flight_count_(0),
+      effective_window_(negotiated_window_size_),
+      effective_block_size_(negotiated_block_size_),
+      last_throughput_sample_(start_time_) {}
 
 TftpConnection::~TftpConnection() {
     stop();
@@ -68,12 +178,14 @@ bool TftpConnection::start() {
     }
 
     active_.store(true);
-    setState(TftpConnectionState::CONNECTED, "Connection started");
+    std::lock_guard<std::mutex> lock(mutex_);
+    startWorker();
+    return true;
+}
 
-    // Start worker thread
+void TftpConnection::startWorker() {
+    setState(TftpConnectionState::CONNECTED, "Connection started");
     worker_thread_ = std::thread(&TftpConnection::workerThread, this);
-
-    return true;
 }
 
 void TftpConnection::stop() {
@@ -85,13 +197,20 @@ void TftpConnection::stop() {
         setState(TftpConnectionState::CLOSED, "Connection stopped");
     }
 
-    // Close files
-    closeFiles();
-
-    // Wait for worker thread to finish
-    if (worker_thread_.joinable()) {
-        worker_thread_.join();
+    // setUp() starts the worker under mutex_ and only while active, so once
+    // active_ is cleared the thread taken here is the only one there will be
+    std::thread worker;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        worker.swap(worker_thread_);
     }
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    // Close files once no setup job or packet handler is using them
+    std::lock_guard<std::mutex> lock(mutex_);
+    closeFiles();
 }
 
 bool TftpConnection::isActive() const {
@@ -131,14 +250,56 @@ std::chrono::seconds TftpConnection::getDuration() const {
     return std::chrono::duration_cast<std::chrono::seconds>(now - start_time_);
 }
 
+TftpConnectionTelemetry TftpConnection::getTelemetry() const {
+    TftpConnectionTelemetry telemetry;
+    telemetry.client_address = client_addr_;
+    telemetry.client_port = client_port_;
+    telemetry.state = state_.load();
+    telemetry.direction = direction_.load();
+    if (telemetry.state != TftpConnectionState::INITIALIZED &&
+        telemetry.state != TftpConnectionState::CONNECTED) {
+        // filename_ is assigned before the transfer leaves CONNECTED
+        telemetry.filename = filename_;
+    }
+    telemetry.bytes_transferred = progress_bytes_.load(std::memory_order_relaxed);
+    telemetry.total_bytes = expected_bytes_.load(std::memory_order_relaxed);
+    if (telemetry.total_bytes > 0) {
+        telemetry.percent_complete = std::min(100.0,
+            100.0 * static_cast<double>(telemetry.bytes_transferred) / static_cast<double>(telemetry.total_bytes));
+    } else if (telemetry.state == TftpConnectionState::COMPLETED) {
+        telemetry.percent_complete = 100.0;
+    }
+    telemetry.throughput_bps = static_cast<double>(throughput_bps_.load(std::memory_order_relaxed));
+    telemetry.block_size = effective_block_size_.load(std::memory_order_relaxed);
+    telemetry.effective_window = effective_window_.load(std::memory_order_relaxed);
+    telemetry.in_flight = in_flight_count_.load(std::memory_order_relaxed);
+    telemetry.retransmits = retransmit_count_.load(std::memory_order_relaxed);
+    telemetry.retransmit_buffer_bytes = retransmit_buffer_bytes_.load(std::memory_order_relaxed);
+    telemetry.duplicate_acks = duplicate_ack_count_.load(std::memory_order_relaxed);
+    telemetry.duplicate_data = duplicate_data_count_.load(std::memory_order_relaxed);
+    telemetry.rtt_us = smoothed_rtt_us_.load(std::memory_order_relaxed);
+    telemetry.duration_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time_).count());
+    return telemetry;
+}
+
 void TftpConnection::handlePacket(const uint8_t* packet_data,
                                 size_t packet_size,
                                 const std::string& sender_addr,
                                 port_t sender_port) {
-    // Basic packet handling - just log for now
-    logEvent(LogLevel::DEBUG, "Received packet of size " + std::to_string(packet_size));
+    {
+        std::lock_guard<std::mutex> lock(setup_mutex_);
+        if (setting_up_) {
+            // The first reply may already be out, so this can be its answer
+            if (deferred_packets_.size() < MAX_DEFERRED_PACKETS) {
+                deferred_packets_.emplace_back(packet_data, packet_data + packet_size);
+            }
+            return;
+        }
+    }
 
-    updateActivity();
+    std::lock_guard<std::mutex> lock(mutex_);
+    dispatchPacket(packet_data, packet_size);
 }
 
 bool TftpConnection::sendPacket(const TftpPacket& packet) {
@@ -177,6 +338,11 @@ void TftpConnection::setCallback(std::function<void(TftpConnectionState, const s
 void TftpConnection::workerThread() {
     while (active_.load()) {
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!active_.load()) {
+            break;
+        }
+        sampleThroughput(std::chrono::steady_clock::now());
         if (!handleTimeoutTick()) {
             break;
         }
@@ -189,38 +355,157 @@ void TftpConnection::workerThread() {
     }
 }
 
+void TftpConnection::beginSetup() {
+    std::lock_guard<std::mutex> lock(setup_mutex_);
+    setting_up_ = true;
+    active_.store(true);
+}
+
+bool TftpConnection::isRequestPending() const {
+    std::lock_guard<std::mutex> lock(setup_mutex_);
+    return setting_up_ && deferred_packets_.empty();
+}
+
+void TftpConnection::setUp(const TftpRequestPacket& packet) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Stopped while the request waited in the queue
+    if (active_.load()) {
+        startWorker();
+    }
+    if (active_.load() && packet.isValid()) {
+        if (packet.getOpcode() == TftpOpcode::RRQ) {
+            handleReadRequest(packet);
+        } else {
+            handleWriteRequest(packet);
+        }
+    }
+    endSetup();
+}
+
+void TftpConnection::reject(const std::string& message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Code 0: not defined, see the message
+    sendError(TftpError::SUCCESS, message);
+    endSetup();
+}
+
+void TftpConnection::endSetup() {
+    for (;;) {
+        std::vector<std::vector<uint8_t>> deferred;
+        {
+            std::lock_guard<std::mutex> lock(setup_mutex_);
+            if (deferred_packets_.empty()) {
+                setting_up_ = false;
+                return;
+            }
+            deferred.swap(deferred_packets_);
+        }
+        for (const auto& packet : deferred) {
+            if (active_.load()) {
+                dispatchPacket(packet.data(), packet.size());
+            }
+        }
+    }
+}
+
+void TftpConnection::dispatchPacket(const uint8_t* packet_data, size_t packet_size) {
+    if (packet_size < 2) {
+        return;
+    }
+
+    switch (static_cast<TftpOpcode>((packet_data[0] << 8) | packet_data[1])) {
+        case TftpOpcode::DATA: {
+            TftpDataView data_packet;
+            if (TftpCodec::decodeData(packet_data, packet_size, data_packet)) {
+                handleDataPacket(data_packet);
+            }
+            break;
+        }
+
+        case TftpOpcode::ACK: {
+            TftpAckView ack_packet;
+            if (TftpCodec::decodeAck(packet_data, packet_size, ack_packet)) {
+                handleAckPacket(ack_packet);
+            }
+            break;
+        }
+
+        case TftpOpcode::ERROR: {
+            TftpErrorPacket error_packet(packet_data, packet_size);
+            if (error_packet.isValid()) {
+                handleErrorPacket(error_packet);
+            }
+            break;
+        }
+
+        default:
+            logEvent(LogLevel::DEBUG, "Ignoring packet with opcode " +
+                     std::to_string((packet_data[0] << 8) | packet_data[1]));
+            break;
+    }
+}
+
 void TftpConnection::handleReadRequest(const TftpRequestPacket& packet) {
     logEvent(LogLevel::INFO, "Handling read request for file: " + packet.getFilename());
 
     // Set transfer direction and mode
     direction_ = TftpTransferDirection::READ;
     transfer_mode_ = packet.getMode();
+    if (!remapFilename(packet.getFilename(), false, filename_)) {
+        sendError(TftpError::ACCESS_VIOLATION, "Access denied");
+        return;
+    }
 
     // Validate file access
-    if (!validateFileAccess(packet.getFilename(), false)) {
+    if (!validateFileAccess(filename_, false)) {
         sendError(TftpError::ACCESS_VIOLATION, "Access denied");
         return;
     }
 
     // Open file for reading
-    if (!openReadFile(packet.getFilename())) {
+    if (!openReadFile(filename_)) {
         sendError(TftpError::FILE_NOT_FOUND, "File not found");
         return;
     }
+    if (transfer_mode_ != TftpMode::OCTET) {
+        prepareNetasciiStream();
+    }
 
-    in_flight_blocks_.clear();
     next_block_to_send_ = 1;
     last_ack_block_ = 0;
     final_block_sent_ = false;
     final_block_number_ = 0;
     awaiting_data_ = false;
     ack_retry_count_ = 0;
+    gap_pending_ = false;
+    resent_any_ = false;
 
     // Process TFTP options
     TftpOptions options = packet.getOptions();
+    if (options.multicast && joinMulticastGroup(options)) {
+        return;
+    }
     if (!applyRequestOptions(options, true)) {
         return;
     }
+    send_window_.reset(negotiated_window_size_, next_block_to_send_);
+    in_flight_count_.store(0, std::memory_order_relaxed);
+    attachCachedStream();
+    if (!cached_stream_ && !netascii_stream_ && !compressed_reader_ && !origin_reader_ && !openPendingReadFile()) {
+        sendError(TftpError::ACCESS_VIOLATION, "Access denied");
+        return;
+    }
+    // Only octet blocks of a plain file can be read again at their offset
+    retransmit_from_file_ = config_ && config_->isRetransmitFromFileEnabled() && !cached_stream_ &&
+                            transfer_mode_ == TftpMode::OCTET && !compressed_reader_ && !origin_reader_;
+    send_offset_ = 0;
+    // A window's frames, all a full block but the last, go to the kernel in as few sends as it takes
+    size_t gso_segments = config_ && config_->isUdpGsoEnabled() && negotiated_window_size_ > 1
+        ? server_.getGsoSegmentsPerSend(TftpCodec::HEADER_SIZE + negotiated_block_size_) : 0;
+    gso_segments_ = static_cast<uint16_t>(std::min<size_t>(gso_segments, negotiated_window_size_));
+    if (gso_segments_ < 2) {
+        gso_segments_ = 0;
+    }
 
     setState(TftpConnectionState::TRANSFERRING, "Starting file transfer");
 
@@ -240,15 +525,19 @@ void TftpConnection::handleWriteRequest(const TftpRequestPacket& packet) {
     // Set transfer direction and mode
     direction_ = TftpTransferDirection::WRITE;
     transfer_mode_ = packet.getMode();
+    if (!remapFilename(packet.getFilename(), true, filename_)) {
+        sendError(TftpError::ACCESS_VIOLATION, "Access denied");
+        return;
+    }
 
     // Validate file access
-    if (!validateFileAccess(packet.getFilename(), true)) {
+    if (!validateFileAccess(filename_, true)) {
         sendError(TftpError::ACCESS_VIOLATION, "Access denied");
         return;
     }
 
     // Open file for writing
-    if (!openWriteFile(packet.getFilename())) {
+    if (!openWriteFile(filename_)) {
         sendError(TftpError::FILE_EXISTS, "File already exists or cannot be created");
         return;
     }
@@ -271,6 +560,8 @@ void TftpConnection::handleWriteRequest(const TftpRequestPacket& packet) {
     ack_retry_count_ = 0;
     last_ack_block_ = 0;
     last_ack_time_ = std::chrono::steady_clock::now();
+    reorder_.reset(negotiated_window_size_);
+    write_run_.clear();
     current_file_size_ = 0;
     if (options.has_tsize) {
         advertised_file_size_ = options.tsize;
@@ -286,86 +577,166 @@ void TftpConnection::handleWriteRequest(const TftpRequestPacket& packet) {
     }
 }
 
-void TftpConnection::handleDataPacket(const TftpDataPacket& packet) {
-    logEvent(LogLevel::DEBUG, "Handling data packet with block " + std::to_string(packet.getBlockNumber()));
+void TftpConnection::handleDataPacket(const TftpDataView& packet) {
+    logEvent(LogLevel::DEBUG, "Handling data packet with block " + std::to_string(packet.block));
 
     if (direction_ != TftpTransferDirection::WRITE) {
         sendError(TftpError::ILLEGAL_OPERATION, "Unexpected data packet");
         return;
     }
 
-    uint16_t block_number = packet.getBlockNumber();
-    const std::vector<uint8_t>& data = packet.getFileData();
+    uint16_t block_number = packet.block;
+    const ByteView& data = packet.payload;
+    uint16_t window = std::max<uint16_t>(negotiated_window_size_, 1);
+    // Distances wrap with the block numbers
+    uint16_t ahead = static_cast<uint16_t>(block_number - current_block_);
 
-    if (block_number <= current_block_) {
-        logEvent(LogLevel::DEBUG, "Duplicate DATA block " + std::to_string(block_number) + ", re-sending ACK");
-        sendAcknowledgment(block_number, false);
+    if (ahead == 0 || ahead >= 0x8000) {
+        duplicate_data_count_.fetch_add(1, std::memory_order_relaxed);
+        // The end of an acknowledged window arrived again, so the ACK was lost
+        if (block_number == last_ack_block_) {
+            logEvent(LogLevel::DEBUG, "Duplicate DATA block " + std::to_string(block_number) + ", re-sending ACK");
+            if (flushWriteRun()) {
+                sendAcknowledgment(current_block_);
+            }
+        }
         return;
     }
 
-    if (block_number != expected_block_) {
-        logEvent(LogLevel::WARNING, "Out of order block: " + std::to_string(block_number) +
+    uint16_t span = static_cast<uint16_t>(block_number - last_ack_block_);
+    if (span > window) {
+        logEvent(LogLevel::WARNING, "DATA block " + std::to_string(block_number) + " is beyond the window, ignored");
+        return;
+    }
+    bool final_block = data.size < negotiated_block_size_;
+
+    if (ahead > 1) {
+        // Hold the block until the gap before it is filled
+        if (!reorder_.store(block_number, data)) {
+            duplicate_data_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+        logEvent(LogLevel::DEBUG, "Out of order block: " + std::to_string(block_number) +
                 ", expected: " + std::to_string(expected_block_));
-        sendAcknowledgment(current_block_, false);
+        // The sender stops at the end of its window or file to wait for an
+        // ACK; the last block in sequence makes it resend from the gap
+        if ((span == window || final_block) && flushWriteRun() && !sendAcknowledgment(current_block_)) {
+            sendError(TftpError::NETWORK_ERROR, "Failed to send ACK");
+        }
+        return;
+    }
+
+    // In sequence: take the block and any held blocks that now follow it
+    ByteView payload = data;
+    for (;;) {
+        uint16_t block = static_cast<uint16_t>(current_block_ + 1);
+        const std::vector<uint8_t>* held = final_block ? nullptr : reorder_.find(static_cast<uint16_t>(block + 1));
+        bool window_end = static_cast<uint16_t>(block - last_ack_block_) >= window;
+        if (!acceptDataBlock(payload, (final_block || window_end) && !held)) {
+            return;
+        }
+        reorder_.release(block);
+        current_block_ = block;
+        if (!held) {
+            break;
+        }
+        payload = ByteView(held->data(), held->size());
+        final_block = payload.size < negotiated_block_size_;
+    }
+    expected_block_ = static_cast<uint16_t>(current_block_ + 1);
+
+    if (final_block) {
+        // The final ACK tells the client the file is stored, so flush it first
+        if (!flushWriteRun()) {
+            return;
+        }
+        closeFiles();
+        if (!sendAcknowledgment(current_block_)) {
+            sendError(TftpError::NETWORK_ERROR, "Failed to send ACK");
+            return;
+        }
+        awaiting_data_ = false;
+        setState(TftpConnectionState::COMPLETED, "File transfer completed");
+        active_.store(false);
         return;
     }
 
-    // Process data based on transfer mode
-    std::vector<uint8_t> processed_data = processDataForMode(data, transfer_mode_, false);
+    // RFC 7440: one ACK per window, written out as one run
+    if (static_cast<uint16_t>(current_block_ - last_ack_block_) >= window) {
+        if (!flushWriteRun()) {
+            return;
+        }
+        if (!sendAcknowledgment(current_block_)) {
+            sendError(TftpError::NETWORK_ERROR, "Failed to send ACK");
+        }
+    }
+}
+
+bool TftpConnection::acceptDataBlock(ByteView payload, bool write_now) {
+    std::vector<uint8_t> converted;
+    ByteView processed_data = payload;
+    if (transfer_mode_ != TftpMode::OCTET) {
+        converted = processDataForMode(std::vector<uint8_t>(payload.begin(), payload.end()), transfer_mode_, false);
+        processed_data = ByteView(converted.data(), converted.size());
+    }
 
-    current_file_size_ += processed_data.size();
+    current_file_size_ += processed_data.size;
     if (config_ && current_file_size_ > config_->getMaxFileSize()) {
         sendError(TftpError::DISK_FULL, "File exceeds configured size limit");
-        return;
+        return false;
     }
 
     if (advertised_file_size_ > 0 && current_file_size_ > advertised_file_size_) {
         sendError(TftpError::DISK_FULL, "Client exceeded advertised transfer size");
-        return;
+        return false;
     }
 
-    if (config_ && (bytes_transferred_ + processed_data.size()) > config_->getMaxFileSize()) {
+    if (config_ && (bytes_transferred_ + processed_data.size) > config_->getMaxFileSize()) {
         sendError(TftpError::DISK_FULL, "Maximum file size exceeded");
-        return;
+        return false;
     }
 
-    // Write data to file
-    if (write_file_.is_open()) {
-        write_file_.write(reinterpret_cast<const char*>(processed_data.data()), processed_data.size());
-        if (write_file_.fail()) {
+    // A block that is acknowledged on its own (windowsize 1) goes straight
+    // from the receive buffer to the file; others join the run
+    if (write_now && write_run_.empty()) {
+        if (write_file_.isOpen() && !write_file_.write(processed_data.data, processed_data.size)) {
             sendError(TftpError::DISK_FULL, "Failed to write data");
-            return;
+            return false;
         }
+    } else {
+        write_run_.insert(write_run_.end(), processed_data.begin(), processed_data.end());
     }
 
-    // Update counters
-    current_block_ = block_number;
-    expected_block_ = block_number + 1;
-    bytes_transferred_ += processed_data.size();
+    bytes_transferred_ += processed_data.size;
+    recordProgress(processed_data.size);
+    // A window can take longer than the timeout on a slow link; the client
+    // is only stalled once blocks stop arriving
+    last_data_time_ = std::chrono::steady_clock::now();
+    last_activity_ = last_data_time_;
+    return true;
+}
 
-    // Send ACK
-    if (!sendAcknowledgment(block_number)) {
-        sendError(TftpError::NETWORK_ERROR, "Failed to send ACK");
-        return;
+bool TftpConnection::flushWriteRun() {
+    if (write_run_.empty()) {
+        return true;
     }
-
-    if (processed_data.size() < negotiated_block_size_) {
-        awaiting_data_ = false;
-        setState(TftpConnectionState::COMPLETED, "File transfer completed");
-        closeFiles();
-        active_.store(false);
+    bool written = !write_file_.isOpen() || write_file_.write(write_run_.data(), write_run_.size());
+    write_run_.clear();
+    if (!written) {
+        sendError(TftpError::DISK_FULL, "Failed to write data");
+        return false;
     }
+    return true;
 }
 
-void TftpConnection::handleAckPacket(const TftpAckPacket& packet) {
-    logEvent(LogLevel::DEBUG, "Handling ACK packet for block " + std::to_string(packet.getBlockNumber()));
+void TftpConnection::handleAckPacket(const TftpAckView& packet) {
+    logEvent(LogLevel::DEBUG, "Handling ACK packet for block " + std::to_string(packet.block));
 
     if (direction_ != TftpTransferDirection::READ) {
         sendError(TftpError::ILLEGAL_OPERATION, "Unexpected ACK packet");
         return;
     }
 
-    uint16_t block_number = packet.getBlockNumber();
+    uint16_t block_number = packet.block;
 
     if (awaiting_oack_ack_) {
         if (block_number == 0) {
@@ -377,26 +748,57 @@ void TftpConnection::handleAckPacket(const TftpAckPacket& packet) {
         return;
     }
 
-    auto in_flight = in_flight_blocks_.find(block_number);
-    if (in_flight == in_flight_blocks_.end()) {
+    const TftpInFlightBlock* acked = send_window_.find(block_number);
+    if (!acked) {
+        duplicate_ack_count_.fetch_add(1, std::memory_order_relaxed);
         logEvent(LogLevel::DEBUG, "Duplicate ACK for block " + std::to_string(block_number));
+        // The client has nothing past the block it acknowledged last, so the
+        // oldest block in flight was lost; a copy of ours answered would
+        // only start the Sorcerer's Apprentice
+        if (block_number == last_ack_block_ && !send_window_.empty() && !answersResend(block_number)) {
+            beginFrameBatch();
+            if (!resendFromGap() || !endFrameBatch()) {
+                sendError(TftpError::NETWORK_ERROR, "Failed to send data");
+            }
+        }
         return;
     }
 
-    bool was_final = in_flight->second.is_final;
-    in_flight_blocks_.erase(in_flight);
+    // Karn's algorithm: only blocks that were never retransmitted give an unambiguous RTT
+    if (acked->retries == 0) {
+        recordRttSample(std::chrono::steady_clock::now() - acked->last_sent);
+    }
+
+    // ACKs are cumulative, so this also covers earlier blocks whose own ACK was lost
+    TftpWindowAck released = send_window_.acknowledge(block_number);
+    recordProgress(released.bytes);
+    in_flight_count_.store(static_cast<uint32_t>(send_window_.size()), std::memory_order_relaxed);
 
     last_ack_block_ = block_number;
     current_block_ = block_number;
 
-    if (was_final && in_flight_blocks_.empty()) {
+    if (released.final && send_window_.empty()) {
         setState(TftpConnectionState::COMPLETED, "File transfer completed");
         closeFiles();
         active_.store(false);
         return;
     }
 
-    if (!fillSendWindow() && in_flight_blocks_.empty() && final_block_sent_) {
+    // Blocks still in flight past an RFC 7440 window-end ACK were lost. A
+    // client that ACKs every block leaves them too, but keeps ACKing; so the
+    // gap is resent if no further ACK comes within a few round trips
+    bool answers_resend = answersResend(block_number);
+    // Past every copy resent, which also keeps the comparison within half the block space
+    resent_any_ = resent_any_ && answers_resend;
+    gap_pending_ = !send_window_.empty() && !answers_resend;
+    if (gap_pending_) {
+        auto holdoff = std::max<std::chrono::steady_clock::duration>(
+            std::chrono::microseconds(4 * smoothed_rtt_us_.load(std::memory_order_relaxed)),
+            std::chrono::milliseconds(20));
+        gap_deadline_ = std::chrono::steady_clock::now() + std::min<std::chrono::steady_clock::duration>(holdoff, timeout_);
+    }
+
+    if (!fillSendWindow() && send_window_.empty() && final_block_sent_) {
         // No more data to send; wait for outstanding ACKs
     }
 }
@@ -407,11 +809,10 @@ void TftpConnection::handleErrorPacket(const TftpErrorPacket& packet) {
     // Set connection state to error
     setState(TftpConnectionState::ERROR, packet.getErrorMessage());
 
-    // Close files and cleanup
+    // Close files; the server's cleanup stops the connection, as this runs
+    // under the lock the worker thread would need to finish
     closeFiles();
-
-    // Stop the connection
-    stop();
+    active_.store(false);
 }
 
 bool TftpConnection::processReadRequest(const TftpRequestPacket& packet) {
@@ -433,25 +834,45 @@ bool TftpConnection::handleTimeoutTick() {
         return false;
     }
 
-    for (auto& entry : in_flight_blocks_) {
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - entry.second.last_sent);
-        if (elapsed >= timeout_) {
-            if (entry.second.retries >= max_retries_) {
-                logEvent(LogLevel::ERROR, "Retry limit reached for block " + std::to_string(entry.first));
+    if (gap_pending_ && now >= gap_deadline_) {
+        beginFrameBatch();
+        if (!resendFromGap() || !endFrameBatch()) {
+            return false;
+        }
+    }
+
+    // Most ticks end here: no block in the window can have been waiting that long
+    if (send_window_.mayHaveExpired(now, timeout_)) {
+        // The expired blocks are resent together, like a window
+        beginFrameBatch();
+        for (size_t i = 0; i < send_window_.size(); ++i) {
+            const TftpInFlightBlock& entry = send_window_.at(i);
+            if (now - entry.last_sent < timeout_) {
+                continue;
+            }
+            uint16_t block_number = static_cast<uint16_t>(send_window_.base() + i);
+            if (entry.retries >= max_retries_) {
+                logEvent(LogLevel::ERROR, "Retry limit reached for block " + std::to_string(block_number));
+                discardFrames();
                 sendError(TftpError::TIMEOUT, "Retry limit exceeded");
                 active_.store(false);
                 setState(TftpConnectionState::ERROR, "Retry limit exceeded");
                 return false;
             }
 
-            if (!resendBlock(entry.first)) {
+            if (!resendBlock(block_number)) {
+                discardFrames();
                 return false;
             }
         }
+        if (!endFrameBatch()) {
+            return false;
+        }
+        send_window_.refreshOldest();
     }
 
     if (direction_ == TftpTransferDirection::WRITE && awaiting_data_) {
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - last_ack_time_);
+        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - std::max(last_ack_time_, last_data_time_));
         if (elapsed >= timeout_) {
             if (ack_retry_count_ >= max_retries_) {
                 logEvent(LogLevel::ERROR, "Retry limit reached while waiting for DATA");
@@ -462,6 +883,12 @@ bool TftpConnection::handleTimeoutTick() {
             }
 
             ++ack_retry_count_;
+            retransmit_count_.fetch_add(1, std::memory_order_relaxed);
+            if (!flushWriteRun()) {
+                return false;
+            }
+            // Blocks held past a gap are kept; the sender resends from the gap
+            last_ack_block_ = current_block_;
             logEvent(LogLevel::WARNING, "Resending ACK for block " + std::to_string(last_ack_block_));
             if (!sendAcknowledgment(last_ack_block_, false)) {
                 return false;
@@ -479,48 +906,87 @@ bool TftpConnection::sendDataBlock(uint16_t block_number, bool is_retry) {
         return resendBlock(block_number);
     }
 
-    if (!read_file_.is_open()) {
-        return false;
-    }
-
-    std::vector<uint8_t> buffer(negotiated_block_size_);
-    read_file_.read(reinterpret_cast<char*>(buffer.data()), negotiated_block_size_);
-    std::streamsize bytes_read = read_file_.gcount();
+    if (cached_stream_) {
+        ByteView frame = cached_stream_->frame(next_frame_index_);
+        if (frame.size < TftpCodec::HEADER_SIZE || !emitFrame(frame.data, frame.size)) {
+            logEvent(LogLevel::ERROR, "Failed to send data packet");
+            return false;
+        }
 
-    if (bytes_read < 0) {
-        logEvent(LogLevel::ERROR, "Failed to read from file");
-        return false;
+        TftpInFlightBlock& block = send_window_.next();
+        block.frame = frame;
+        block.payload_size = static_cast<uint32_t>(frame.size - TftpCodec::HEADER_SIZE);
+        block.is_final = ++next_frame_index_ == cached_stream_->frameCount();
+        block.last_sent = now;
+        block.retries = 0;
+        server_.getBlockCache().recordBlocks(1, cached_stream_shared_);
+
+        bytes_transferred_ += block.payload_size;
+        if (block.is_final) {
+            final_block_sent_ = true;
+            final_block_number_ = block_number;
+        }
+        send_window_.push();
+        in_flight_count_.store(static_cast<uint32_t>(send_window_.size()), std::memory_order_relaxed);
+        updateActivity();
+        next_block_to_send_ = block_number + 1;
+        return true;
     }
 
-    bool eof_block = static_cast<size_t>(bytes_read) < negotiated_block_size_;
-    if (bytes_read == 0 && !read_file_.eof()) {
-        logEvent(LogLevel::ERROR, "Unexpected zero-byte read");
+    if (!read_file_.isOpen() && !read_open_pending_ && !compressed_reader_ && !origin_reader_ && !netascii_stream_) {
         return false;
     }
 
-    std::vector<uint8_t> payload;
-    buffer.resize(static_cast<size_t>(bytes_read));
-    payload = processDataForMode(buffer, transfer_mode_, true);
+    TftpInFlightBlock& block = send_window_.next();
+    block.frame = ByteView();
+    block.from_file = retransmit_from_file_;
+    if (block.from_file) {
+        // Only the position is kept; a retransmit reads the same bytes again
+        int64_t sent = transmitFileBlock(block_number, send_offset_, negotiated_block_size_, false);
+        if (sent < 0) {
+            return false;
+        }
+        block.offset = send_offset_;
+        block.payload_size = static_cast<uint32_t>(sent);
+        send_offset_ += static_cast<uint64_t>(sent);
+    } else {
+        // Read straight into the window slot, whose buffer earlier blocks already grew
+        std::vector<uint8_t>& payload = block.payload;
+        size_t held = payload.capacity();
+        if (transfer_mode_ != TftpMode::OCTET) {
+            // Conversion grows the data, so blocks are cut from the converted stream
+            if (!readNetasciiBlock(payload)) {
+                return false;
+            }
+        } else {
+            payload.resize(negotiated_block_size_);
+            std::streamsize bytes_read = readSource(payload.data(), payload.size());
+            if (bytes_read < 0) {
+                logEvent(LogLevel::ERROR, "Failed to read from file");
+                return false;
+            }
+            payload.resize(static_cast<size_t>(bytes_read));
+        }
+        retransmit_buffer_bytes_.fetch_add(payload.capacity() - held, std::memory_order_relaxed);
+
+        if (!transmitDataBlock(block_number, payload)) {
+            logEvent(LogLevel::ERROR, "Failed to send data packet");
+            return false;
+        }
+        block.payload_size = static_cast<uint32_t>(payload.size());
+    }
 
-    InFlightBlock block;
-    block.payload = payload;
-    block.is_final = eof_block;
+    block.is_final = block.payload_size < negotiated_block_size_;
     block.last_sent = now;
     block.retries = 0;
 
-    TftpDataPacket data_packet(block_number, block.payload);
-    std::vector<uint8_t> packet_data = data_packet.serialize();
-
-    if (!server_.sendPacket(packet_data.data(), packet_data.size(), client_addr_, client_port_)) {
-        logEvent(LogLevel::ERROR, "Failed to send data packet");
-        return false;
-    }
-
-    in_flight_blocks_[block_number] = std::move(block);
-    bytes_transferred_ += payload.size();
+    send_window_.push();
+    in_flight_count_.store(static_cast<uint32_t>(send_window_.size()), std::memory_order_relaxed);
+    server_.getBlockCache().recordBlocks(1, false);
+    bytes_transferred_ += block.payload_size;
     updateActivity();
 
-    if (in_flight_blocks_[block_number].is_final) {
+    if (block.is_final) {
         final_block_sent_ = true;
         final_block_number_ = block_number;
     }
@@ -531,13 +997,14 @@ bool TftpConnection::sendDataBlock(uint16_t block_number, bool is_retry) {
 
 bool TftpConnection::fillSendWindow() {
     bool sent_any = false;
-    while (in_flight_blocks_.size() < negotiated_window_size_) {
+    beginFrameBatch();
+    while (send_window_.size() < negotiated_window_size_ && !send_window_.full()) {
         if (final_block_sent_ && next_block_to_send_ > final_block_number_) {
             break;
         }
 
         if (!sendDataBlock(next_block_to_send_, false)) {
-            return sent_any || !in_flight_blocks_.empty();
+            break;
         }
 
         sent_any = true;
@@ -546,35 +1013,173 @@ bool TftpConnection::fillSendWindow() {
             break;
         }
     }
-    return sent_any || !in_flight_blocks_.empty();
+    // Frames still queued are already in the window; if this send fails they time out and go again
+    endFrameBatch();
+    return sent_any || !send_window_.empty();
 }
 
 bool TftpConnection::resendBlock(uint16_t block_number) {
-    auto it = in_flight_blocks_.find(block_number);
-    if (it == in_flight_blocks_.end()) {
+    TftpInFlightBlock* block = send_window_.find(block_number);
+    if (!block) {
         return false;
     }
 
     auto now = std::chrono::steady_clock::now();
-    TftpDataPacket data_packet(block_number, it->second.payload);
-    std::vector<uint8_t> packet_data = data_packet.serialize();
+    if (block->from_file) {
+        // Blocks sent earlier came from the old contents; mixing in new bytes would corrupt the image
+        if (!readFileUnchanged()) {
+            // Code 0: not defined, see the message
+            sendError(TftpError::SUCCESS, "File changed during transfer");
+            return false;
+        }
+        int64_t sent = transmitFileBlock(block_number, block->offset, block->payload_size, true);
+        if (sent == TRANSMIT_READ_FAILED) {
+            // Code 0: not defined, see the message
+            sendError(TftpError::SUCCESS, "Failed to re-read file for retransmission");
+            return false;
+        }
+        if (sent < 0) {
+            logEvent(LogLevel::ERROR, "Failed to resend data packet");
+            return false;
+        }
+    } else {
+        bool sent = block->frame.data
+            ? emitFrame(block->frame.data, block->frame.size)
+            : transmitDataBlock(block_number, block->payload);
+        if (!sent) {
+            logEvent(LogLevel::ERROR, "Failed to resend data packet");
+            return false;
+        }
+    }
 
-    if (!server_.sendPacket(packet_data.data(), packet_data.size(), client_addr_, client_port_)) {
-        logEvent(LogLevel::ERROR, "Failed to resend data packet");
+    block->last_sent = now;
+    block->retries++;
+    if (!answersResend(block_number)) {
+        resent_through_ = block_number;
+        resent_any_ = true;
+    }
+    retransmit_count_.fetch_add(1, std::memory_order_relaxed);
+    updateActivity();
+    return true;
+}
+
+bool TftpConnection::resendFromGap() {
+    gap_pending_ = false;
+    logEvent(LogLevel::DEBUG, "Client reported a gap, resending from block " + std::to_string(send_window_.base()));
+    for (size_t i = 0; i < send_window_.size(); ++i) {
+        if (!resendBlock(static_cast<uint16_t>(send_window_.base() + i))) {
+            discardFrames();
+            return false;
+        }
+    }
+    send_window_.refreshOldest();
+    return true;
+}
+
+bool TftpConnection::answersResend(uint16_t block_number) const {
+    return resent_any_ && static_cast<uint16_t>(resent_through_ - block_number) < 0x8000;
+}
+
+bool TftpConnection::transmitDataBlock(uint16_t block_number, const std::vector<uint8_t>& payload) {
+    size_t needed = TftpCodec::HEADER_SIZE + payload.size();
+    if (tx_buffer_.size() < needed) {
+        tx_buffer_.resize(needed);
+    }
+
+    size_t length = TftpCodec::encodeData(tx_buffer_.data(), tx_buffer_.size(), block_number,
+                                          ByteView(payload.data(), payload.size()));
+    return length > 0 && emitFrame(tx_buffer_.data(), length);
+}
+
+int64_t TftpConnection::transmitFileBlock(uint16_t block_number, uint64_t offset, size_t size, bool exact) {
+    size_t needed = TftpCodec::HEADER_SIZE + size;
+    if (tx_buffer_.size() < needed) {
+        tx_buffer_.resize(needed);
+    }
+
+    std::streamsize bytes_read = readSourceAt(offset, tx_buffer_.data() + TftpCodec::HEADER_SIZE, size);
+    if (bytes_read < 0) {
+        logEvent(LogLevel::ERROR, "Failed to read from file");
+        return TRANSMIT_READ_FAILED;
+    }
+    if (exact && static_cast<size_t>(bytes_read) != size) {
+        logEvent(LogLevel::ERROR, "File shrank during transfer: block " + std::to_string(block_number) +
+                 " is no longer " + std::to_string(size) + " bytes at offset " + std::to_string(offset));
+        return TRANSMIT_READ_FAILED;
+    }
+
+    TftpCodec::encodeDataHeader(tx_buffer_.data(), TftpCodec::HEADER_SIZE, block_number);
+    size_t length = TftpCodec::HEADER_SIZE + static_cast<size_t>(bytes_read);
+    if (!emitFrame(tx_buffer_.data(), length)) {
+        logEvent(LogLevel::ERROR, "Failed to send data packet");
+        return TRANSMIT_SEND_FAILED;
+    }
+    return static_cast<int64_t>(bytes_read);
+}
+
+bool TftpConnection::readFileUnchanged() {
+    // The open file, not whatever the name leads to now
+    TftpFileMetadata current;
+    bool found = read_file_.isOpen() ? read_file_.stat(current) : root_ && root_->stat(read_name_, current);
+    if (!found) {
         return false;
     }
 
-    it->second.last_sent = now;
-    it->second.retries++;
-    updateActivity();
+    if (current.size != read_file_size_ || current.modified != read_modified_) {
+        logEvent(LogLevel::ERROR, "File changed during transfer: " + read_path_);
+        return false;
+    }
     return true;
 }
 
+bool TftpConnection::emitFrame(const uint8_t* frame, size_t size) {
+    size_t segment_size = TftpCodec::HEADER_SIZE + negotiated_block_size_;
+    if (!gso_batching_ || size > segment_size) {
+        return server_.sendPacket(frame, size, client_addr_, client_port_);
+    }
+
+    gso_buffer_.insert(gso_buffer_.end(), frame, frame + size);
+    // Only the last datagram of a segmented send may be short
+    if (++gso_frames_ >= gso_segments_ || size < segment_size) {
+        return flushFrames();
+    }
+    return true;
+}
+
+void TftpConnection::beginFrameBatch() {
+    gso_batching_ = gso_segments_ > 1;
+}
+
+bool TftpConnection::endFrameBatch() {
+    gso_batching_ = false;
+    return flushFrames();
+}
+
+void TftpConnection::discardFrames() {
+    gso_batching_ = false;
+    gso_buffer_.clear();
+    gso_frames_ = 0;
+}
+
+bool TftpConnection::flushFrames() {
+    if (gso_buffer_.empty()) {
+        return true;
+    }
+    bool sent = server_.sendSegments(gso_buffer_.data(), gso_buffer_.size(),
+                                     TftpCodec::HEADER_SIZE + negotiated_block_size_, client_addr_, client_port_);
+    gso_buffer_.clear();
+    gso_frames_ = 0;
+    if (!sent) {
+        logEvent(LogLevel::ERROR, "Failed to send data packets");
+    }
+    return sent;
+}
+
 bool TftpConnection::sendAcknowledgment(uint16_t block_number, bool track_state) {
-    TftpAckPacket ack_packet(block_number);
-    std::vector<uint8_t> packet_data = ack_packet.serialize();
+    uint8_t packet_data[TftpCodec::HEADER_SIZE];
+    size_t length = TftpCodec::encodeAck(packet_data, sizeof(packet_data), block_number);
 
-    if (!server_.sendPacket(packet_data.data(), packet_data.size(), client_addr_, client_port_)) {
+    if (!server_.sendPacket(packet_data, length, client_addr_, client_port_)) {
         logEvent(LogLevel::ERROR, "Failed to send ACK packet");
         return false;
     }
@@ -584,53 +1189,93 @@ bool TftpConnection::sendAcknowledgment(uint16_t block_number, bool track_state)
         ack_retry_count_ = 0;
     }
 
-    awaiting_data_ = track_state;
     last_ack_time_ = std::chrono::steady_clock::now();
     updateActivity();
     return true;
 }
 
-bool TftpConnection::openReadFile(const std::string& filename) {
-    if (!validateFileAccess(filename, false)) {
+bool TftpConnection::openReadFile(const std::string& requested) {
+    if (!validateFileAccess(requested, false)) {
         return false;
     }
 
+    // Case-insensitive deployments serve the stored spelling of the name,
+    // which has to pass the same checks as the request
+    std::string filename = requested;
+    if (config_->isCaseInsensitive() && server_.getFilenameIndex().resolve(requested, filename) &&
+        filename != requested) {
+        logEvent(LogLevel::DEBUG, "Resolved " + requested + " to " + filename);
+        if (!validateFileAccess(filename, false)) {
+            return false;
+        }
+    }
+
     // Build full path
     std::string full_path = config_->getRootDirectory() + "/" + filename;
 
-    // Check if file exists
-    std::ifstream test_file(full_path);
-    if (!test_file.good()) {
-        logEvent(LogLevel::WARNING, "File not found: " + full_path);
-        return false;
-    }
-    test_file.close();
+    // Pinned for the deferred open, the cache loaders and origin downloads
+    const TftpRootHandle& root = rootHandle();
 
-    // Check file size
-    std::ifstream file(full_path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        logEvent(LogLevel::ERROR, "Failed to open file for reading: " + full_path);
+    // Known misses (boot probe cascades) are answered without touching the filesystem
+    TftpNegativeCache& missing = server_.getNegativeCache();
+    if (missing.contains(full_path)) {
+        logEvent(LogLevel::DEBUG, "File not found (cached): " + full_path);
         return false;
     }
+    uint64_t generation = missing.generation();
+
+    // One stat (or none on a cache hit) replaces the existence and size probes
+    TftpFileMetadata metadata;
+    TftpOriginStore& origin = server_.getOriginStore();
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    if (!server_.getMetadataCache().lookup(root, filename, metadata) || !metadata.regular) {
+        if (openCompressedFile(filename)) {
+            return true;
+        }
 
-    std::streampos file_size = file.tellg();
-    if (file_size > static_cast<std::streampos>(config_->getMaxFileSize())) {
-        logEvent(LogLevel::WARNING, "File too large: " + std::to_string(file_size) + " bytes");
-        file.close();
+        // Edge mode: the transfer streams the file while it is stored;
+        // in a cluster, files other nodes own are streamed from them
+        TftpCluster& cluster = server_.getCluster();
+        switch (cluster.fetch(root_, filename, fetch)) {
+        case TftpOriginStore::Result::FETCHING:
+            return openOriginFetch(fetch);
+        case TftpOriginStore::Result::TOO_LARGE:
+            logEvent(LogLevel::WARNING, "File too large at origin: " + filename);
+            return false;
+        case TftpOriginStore::Result::FAILED:
+            logEvent(LogLevel::WARNING, "File not found and origin unavailable: " + full_path);
+            return false;
+        default:
+            break;
+        }
+
+        missing.insert(full_path, config_->getRootDirectory(),
+                       1 + server_.getCompressedStore().resolveProbes() +
+                           (origin.isEnabled() || cluster.isEnabled() ? 1 : 0),
+                       generation);
+        logEvent(LogLevel::WARNING, "File not found: " + full_path);
         return false;
     }
 
-    file.close();
-    advertised_file_size_ = static_cast<uint64_t>(file_size);
+    if (origin.isEnabled() &&
+        origin.revalidate(root_, filename, metadata.modified, fetch) == TftpOriginStore::Result::FETCHING) {
+        logEvent(LogLevel::INFO, "File changed at origin: " + filename);
+        return openOriginFetch(fetch);
+    }
 
-    // Open file for reading
-    read_file_.open(full_path, std::ios::binary);
-    if (!read_file_.is_open()) {
-        logEvent(LogLevel::ERROR, "Failed to open file for reading: " + full_path);
+    if (metadata.size > config_->getMaxFileSize()) {
+        logEvent(LogLevel::WARNING, "File too large: " + std::to_string(metadata.size) + " bytes");
         return false;
     }
 
-    logEvent(LogLevel::INFO, "Opened file for reading: " + full_path);
+    advertised_file_size_ = metadata.size;
+    read_file_size_ = metadata.size;
+    read_modified_ = metadata.modified;
+    read_path_ = full_path;
+    read_name_ = filename;
+    read_open_pending_ = true;
+
+    logEvent(LogLevel::INFO, "Found file for reading: " + full_path);
     return true;
 }
 
@@ -642,43 +1287,71 @@ bool TftpConnection::openWriteFile(const std::string& filename) {
     // Build full path
     std::string full_path = config_->getRootDirectory() + "/" + filename;
 
-    // Check if file already exists and overwrite protection is enabled
-    if (config_->isOverwriteProtectionEnabled()) {
-        std::ifstream test_file(full_path);
-        if (test_file.good()) {
+    // Open file for writing beneath the root, creating missing directories. With
+    // overwrite protection the create itself is the check, so neither a stale
+    // cache entry nor a concurrent upload of the same name can slip past it
+    bool protect = config_->isOverwriteProtectionEnabled();
+    write_file_ = protect ? rootHandle().openCreate(filename) : rootHandle().openWrite(filename);
+    if (!write_file_.isOpen()) {
+        if (protect && errno == EEXIST) {
             logEvent(LogLevel::WARNING, "File already exists and overwrite protection is enabled: " + full_path);
-            test_file.close();
             return false;
         }
-        test_file.close();
-    }
-
-    // Create directory if it doesn't exist
-    std::string dir_path = full_path.substr(0, full_path.find_last_of('/'));
-    if (!dir_path.empty()) {
-        std::filesystem::create_directories(dir_path);
-    }
-
-    // Open file for writing
-    write_file_.open(full_path, std::ios::binary | std::ios::out);
-    if (!write_file_.is_open()) {
-        logEvent(LogLevel::ERROR, "Failed to open file for writing: " + full_path);
+        logEvent(LogLevel::ERROR, "Failed to open file for writing: " + full_path + " (" + std::strerror(errno) + ")");
         return false;
     }
+    write_path_ = full_path;
+    server_.getNegativeCache().invalidate(full_path);
+    server_.getMetadataCache().invalidate(full_path);
 
     logEvent(LogLevel::INFO, "Opened file for writing: " + full_path);
     return true;
 }
 
 void TftpConnection::closeFiles() {
-    if (read_file_.is_open()) {
-        read_file_.close();
-    }
-    if (write_file_.is_open()) {
+    read_file_.close();
+    read_open_pending_ = false;
+    compressed_reader_.reset();
+    origin_reader_.reset();
+    if (write_file_.isOpen()) {
         write_file_.close();
+        // Do not wait for the change notification to drop the old size
+        server_.getMetadataCache().invalidate(write_path_);
     }
 }
 
+const TftpRootHandle& TftpConnection::rootHandle() {
+    if (root_ && root_->getRoot() == config_->getRootDirectory()) {
+        return *root_;
+    }
+    root_ = server_.getRootHandle();
+    if (!root_ || root_->getRoot() != config_->getRootDirectory()) {
+        auto handle = std::make_shared<TftpRootHandle>();
+        handle->open(config_->getRootDirectory(), config_->getAllowedDirectories());
+        root_ = handle;
+    }
+    return *root_;
+}
+
+bool TftpConnection::remapFilename(const std::string& requested, bool for_write, std::string& filename) {
+    filename = requested;
+    if (!config_) {
+        return true;
+    }
+    std::shared_ptr<const TftpRemapRules> remap = config_->getFilenameRemap();
+    if (remap->empty()) {
+        return true;
+    }
+    if (!remap->remap(requested, client_addr_, for_write, filename)) {
+        logEvent(LogLevel::WARNING, "Remap rules denied request for: " + requested);
+        return false;
+    }
+    if (filename != requested) {
+        logEvent(LogLevel::DEBUG, "Remapped " + requested + " to " + filename);
+    }
+    return true;
+}
+
 bool TftpConnection::validateFileAccess(const std::string& filename, bool for_write) {
     // Use production security manager if available
     if (security_manager_) {
@@ -714,6 +1387,14 @@ bool TftpConnection::validateFileAccess(const std::string& filename, bool for_wr
         return false;
     }
 
+    // Extension filtering
+    size_t dot = filename.find_last_of('.');
+    std::string extension = (dot == std::string::npos) ? std::string() : filename.substr(dot + 1);
+    if (!config_->isExtensionAllowed(extension)) {
+        logEvent(LogLevel::WARNING, "File extension not allowed: " + filename);
+        return false;
+    }
+
     return true;
 }
 
@@ -738,7 +1419,39 @@ void TftpConnection::setState(TftpConnectionState new_state, const std::string&
         callback_(new_state, message);
     }
 
-    logEvent(LogLevel::INFO, "State changed to " + std::to_string(static_cast<int>(new_state)) + ": " + message);
+    logEvent(LogLevel::INFO, "State changed to " + connectionStateToString(new_state) + ": " + message);
+}
+
+void TftpConnection::recordProgress(size_t bytes) {
+    progress_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    unsampled_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void TftpConnection::recordRttSample(std::chrono::steady_clock::duration sample) {
+    uint64_t sample_us = static_cast<uint64_t>(
+        std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(sample).count()));
+    uint64_t srtt = smoothed_rtt_us_.load(std::memory_order_relaxed);
+    // RFC 6298 smoothing: SRTT = 7/8 * SRTT + 1/8 * R
+    srtt = (srtt == 0) ? sample_us : (srtt * 7 + sample_us) / 8;
+    smoothed_rtt_us_.store(srtt, std::memory_order_relaxed);
+}
+
+void TftpConnection::sampleThroughput(std::chrono::steady_clock::time_point now) {
+    constexpr auto kSampleInterval = std::chrono::milliseconds(250);
+    constexpr double kAlpha = 0.3;
+
+    auto elapsed = now - last_throughput_sample_;
+    if (elapsed < kSampleInterval) {
+        return;
+    }
+    last_throughput_sample_ = now;
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double instant = static_cast<double>(unsampled_bytes_.exchange(0, std::memory_order_relaxed)) / seconds;
+    double previous = static_cast<double>(throughput_bps_.load(std::memory_order_relaxed));
+    // A stalled transfer decays towards zero instead of reporting its last good rate
+    double smoothed = (previous == 0.0) ? instant : (kAlpha * instant + (1.0 - kAlpha) * previous);
+    throughput_bps_.store(static_cast<uint64_t>(smoothed), std::memory_order_relaxed);
 }
 
 void TftpConnection::logEvent(LogLevel level, const std::string& message) {
@@ -755,12 +1468,7 @@ std::vector<uint8_t> TftpConnection::processDataForMode(const std::vector<uint8_
             if (is_sending) {
                 // Convert LF to CRLF for netascii mode
                 result.clear();
-                for (size_t i = 0; i < data.size(); ++i) {
-                    if (data[i] == '\n' && (i == 0 || data[i-1] != '\r')) {
-                        result.push_back('\r');
-                    }
-                    result.push_back(data[i]);
-                }
+                NetasciiEncoder().encode(ByteView(data.data(), data.size()), result);
             } else {
                 // Convert CRLF to LF for netascii mode
                 result.clear();
@@ -784,12 +1492,7 @@ std::vector<uint8_t> TftpConnection::processDataForMode(const std::vector<uint8_
             // For now, treat it the same as netascii
             if (is_sending) {
                 result.clear();
-                for (size_t i = 0; i < data.size(); ++i) {
-                    if (data[i] == '\n' && (i == 0 || data[i-1] != '\r')) {
-                        result.push_back('\r');
-                    }
-                    result.push_back(data[i]);
-                }
+                NetasciiEncoder().encode(ByteView(data.data(), data.size()), result);
             } else {
                 result.clear();
                 for (size_t i = 0; i < data.size(); ++i) {
@@ -808,43 +1511,11 @@ std::vector<uint8_t> TftpConnection::processDataForMode(const std::vector<uint8_
 }
 
 bool TftpConnection::sendOptionAck(const TftpOptions& options) {
-    // Create OACK packet (Option Acknowledgment)
-    std::vector<uint8_t> packet_data;
-
-    // Add opcode (OACK = 6)
-    packet_data.push_back(0);
-    packet_data.push_back(6);
-
-    auto appendString = [&packet_data](const std::string& value) {
-        packet_data.insert(packet_data.end(), value.begin(), value.end());
-    };
-
-    auto appendOption = [&](const std::string& key, const std::string& value) {
-        appendString(key);
-        packet_data.push_back(0);
-        appendString(value);
-        packet_data.push_back(0);
-    };
-
-    // Add options based on flags
-    if (options.has_blksize) {
-        appendOption("blksize", std::to_string(options.blksize));
-    }
-
-    if (options.has_timeout) {
-        appendOption("timeout", std::to_string(options.timeout));
-    }
-
-    if (options.has_tsize) {
-        appendOption("tsize", std::to_string(options.tsize));
-    }
-
-    if (options.has_windowsize) {
-        appendOption("windowsize", std::to_string(options.windowsize));
-    }
+    uint8_t packet_data[2 + TftpCodec::MAX_OPTIONS_SIZE];
+    size_t length = TftpCodec::encodeOptionAck(packet_data, sizeof(packet_data), options);
 
     // Send packet via server
-    if (!server_.sendPacket(packet_data.data(), packet_data.size(), client_addr_, client_port_)) {
+    if (length == 0 || !server_.sendPacket(packet_data, length, client_addr_, client_port_)) {
         logEvent(LogLevel::ERROR, "Failed to send OACK packet");
         return false;
     }
@@ -942,6 +1613,10 @@ bool TftpConnection::applyRequestOptions(const TftpOptions& request_options, boo
         response.tsize = static_cast<uint32_t>(std::min<uint64_t>(advertised_file_size_, std::numeric_limits<uint32_t>::max()));
     }
 
+    effective_block_size_.store(negotiated_block_size_, std::memory_order_relaxed);
+    effective_window_.store(negotiated_window_size_, std::memory_order_relaxed);
+    expected_bytes_.store(advertised_file_size_, std::memory_order_relaxed);
+
     if (!needs_oack) {
         sent_option_ack_ = false;
         awaiting_oack_ack_ = false;
@@ -953,4 +1628,376 @@ bool TftpConnection::applyRequestOptions(const TftpOptions& request_options, boo
     return sendOptionAck(response);
 }
 
+bool TftpConnection::joinMulticastGroup(const TftpOptions& request_options) {
+    // Group sessions stream the file as stored, so only uncompressed octet transfers qualify
+    if (!config_ || !config_->isMulticastEnabled() || transfer_mode_ != TftpMode::OCTET || read_compressed_ ||
+        origin_reader_) {
+        return false;
+    }
+
+    uint16_t block_size = config_->getBlockSize();
+    if (request_options.has_blksize) {
+        block_size = std::min<uint16_t>(std::clamp<uint16_t>(request_options.blksize, 8, 65464), block_size);
+    }
+
+    if (!server_.joinMulticastTransfer(client_addr_, client_port_, read_path_, read_name_, advertised_file_size_,
+                                       block_size, request_options)) {
+        logEvent(LogLevel::INFO, "Multicast unavailable, continuing with unicast transfer");
+        return false;
+    }
+
+    // The group session owns the transfer from here on
+    closeFiles();
+    setState(TftpConnectionState::COMPLETED, "Joined multicast group");
+    active_.store(false);
+    return true;
+}
+
+bool TftpConnection::makeCacheKey(uint16_t block_size, TftpBlockCacheKey& key) const {
+    // A file still arriving from the origin is streamed, not loaded whole
+    if (read_path_.empty() || origin_reader_) {
+        return false;
+    }
+
+    key.path = read_path_;
+    key.file_size = read_file_size_;
+    key.modified = read_modified_;
+    key.block_size = block_size;
+    key.mode = transfer_mode_;
+    return true;
+}
+
+void TftpConnection::attachCachedStream() {
+    cached_stream_.reset();
+    next_frame_index_ = 0;
+
+    // With prefork workers, octet data is shared between processes in chunks instead
+    if (transfer_mode_ == TftpMode::OCTET && readsThroughSharedCache()) {
+        return;
+    }
+
+    TftpBlockCacheKey key;
+    if (!makeCacheKey(negotiated_block_size_, key)) {
+        return;
+    }
+
+    // Runs once per key; concurrent readers of a cold file wait for this load
+    auto loader = [this](std::vector<uint8_t>& stream) {
+        if (netascii_stream_) {
+            // Already converted for another block size
+            stream = netascii_stream_->bytes;
+            return true;
+        }
+        stream.reserve(static_cast<size_t>(read_file_size_));
+        bool complete = readWholeSource([&stream](ByteView chunk) {
+            stream.insert(stream.end(), chunk.data, chunk.data + chunk.size);
+        });
+        if (!complete) {
+            return false;
+        }
+        if (transfer_mode_ != TftpMode::OCTET) {
+            stream = processDataForMode(stream, transfer_mode_, true);
+        }
+        return true;
+    };
+
+    cached_stream_ = server_.getBlockCache().acquire(key, loader, cached_stream_shared_);
+    if (cached_stream_) {
+        closeFiles();
+        logEvent(LogLevel::DEBUG, std::string("Serving from block cache (") + (cached_stream_shared_ ? "hit" : "loaded") + ")");
+    }
+}
+
+void TftpConnection::prepareNetasciiStream() {
+    netascii_stream_.reset();
+    netascii_offset_ = 0;
+    netascii_encoder_.reset();
+    netascii_pending_.clear();
+
+    constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    TftpBlockCacheKey key;
+    if (makeCacheKey(0, key)) {
+        // Runs once per file version; every block size and reader shares the result
+        auto convert = [this]() -> std::shared_ptr<const TftpConvertedStream> {
+            auto converted = std::make_shared<TftpConvertedStream>();
+            NetasciiEncoder encoder;
+            bool complete = readWholeSource([&encoder, &converted](ByteView chunk) {
+                encoder.encode(chunk, converted->bytes);
+            });
+            if (!complete) {
+                return nullptr;
+            }
+            converted->bytes.shrink_to_fit();
+            return converted;
+        };
+
+        bool was_cached = false;
+        netascii_stream_ = server_.getNetasciiCache().acquire(key, read_file_size_, convert, was_cached);
+        if (netascii_stream_) {
+            advertised_file_size_ = netascii_stream_->bytes.size();
+            closeFiles();
+            logEvent(LogLevel::DEBUG, std::string("Netascii conversion ") + (was_cached ? "shared" : "cached") +
+                     ", " + std::to_string(advertised_file_size_) + " bytes on the wire");
+            return;
+        }
+    }
+
+    // Uncached: count the converted length, then rewind for the transfer
+    NetasciiEncoder counter;
+    std::vector<uint8_t> chunk(CHUNK_SIZE);
+    uint64_t converted_size = 0;
+    std::streamsize bytes_read = 0;
+    do {
+        bytes_read = readSource(chunk.data(), chunk.size());
+        if (bytes_read > 0) {
+            converted_size += counter.measure(ByteView(chunk.data(), static_cast<size_t>(bytes_read)));
+        }
+    } while (bytes_read == static_cast<std::streamsize>(chunk.size()));
+    if (!rewindSource()) {
+        logEvent(LogLevel::ERROR, "Failed to rewind file after sizing netascii conversion");
+    }
+    advertised_file_size_ = converted_size;
+}
+
+bool TftpConnection::readNetasciiBlock(std::vector<uint8_t>& payload) {
+    size_t block_size = negotiated_block_size_;
+
+    if (netascii_stream_) {
+        const std::vector<uint8_t>& bytes = netascii_stream_->bytes;
+        size_t start = static_cast<size_t>(std::min<uint64_t>(netascii_offset_, bytes.size()));
+        size_t length = std::min(block_size, bytes.size() - start);
+        payload.assign(bytes.begin() + start, bytes.begin() + start + length);
+        netascii_offset_ += length;
+        return true;
+    }
+
+    // Encode raw reads until a full block is buffered or the file ends
+    std::vector<uint8_t> raw(block_size);
+    while (netascii_pending_.size() < block_size) {
+        std::streamsize bytes_read = readSource(raw.data(), raw.size());
+        if (bytes_read < 0) {
+            logEvent(LogLevel::ERROR, "Failed to read from file");
+            return false;
+        }
+        netascii_encoder_.encode(ByteView(raw.data(), static_cast<size_t>(bytes_read)), netascii_pending_);
+        if (static_cast<size_t>(bytes_read) < raw.size()) {
+            break;
+        }
+    }
+
+    size_t length = std::min(block_size, netascii_pending_.size());
+    payload.assign(netascii_pending_.begin(), netascii_pending_.begin() + length);
+    netascii_pending_.erase(netascii_pending_.begin(), netascii_pending_.begin() + length);
+    return true;
+}
+
+bool TftpConnection::openCompressedFile(const std::string& filename) {
+    TftpCompressedStore& store = server_.getCompressedStore();
+    TftpCompressedCopy copy;
+    if (!store.resolve(root_, filename, copy)) {
+        return false;
+    }
+
+    uint64_t size = 0;
+    if (!store.contentSize(copy, size)) {
+        logEvent(LogLevel::ERROR, "Unreadable compressed file: " + copy.path);
+        return false;
+    }
+    if (size > config_->getMaxFileSize()) {
+        logEvent(LogLevel::WARNING, "File too large: " + std::to_string(size) + " bytes");
+        return false;
+    }
+
+    compressed_reader_ = store.open(copy, size);
+    if (!compressed_reader_) {
+        logEvent(LogLevel::ERROR, "Failed to open compressed file for reading: " + copy.path);
+        return false;
+    }
+    server_.getMetadataCache().recordOpen();
+
+    read_compressed_ = true;
+    advertised_file_size_ = size;
+    read_file_size_ = size;
+    read_modified_ = copy.metadata.modified;
+    read_path_ = copy.path;
+    compressed_copy_ = std::move(copy);
+
+    logEvent(LogLevel::INFO, "Opened compressed file for reading: " + read_path_ + " (" + std::to_string(size) +
+             " bytes decompressed)");
+    return true;
+}
+
+bool TftpConnection::openOriginFetch(std::shared_ptr<const TftpOriginFetch> fetch) {
+    uint64_t size = 0;
+    if (!fetch->waitForSize(size)) {
+        logEvent(LogLevel::ERROR, "Origin download failed: " + fetch->name());
+        return false;
+    }
+    if (size > config_->getMaxFileSize()) {
+        logEvent(LogLevel::WARNING, "File too large: " + std::to_string(size) + " bytes");
+        return false;
+    }
+
+    advertised_file_size_ = size;
+    read_file_size_ = size;
+    read_modified_ = 0;
+    read_path_ = config_->getRootDirectory() + "/" + fetch->name();
+    read_name_ = fetch->name();
+    read_open_pending_ = false;
+    origin_reader_ = std::make_unique<TftpOriginReader>(std::move(fetch));
+
+    logEvent(LogLevel::INFO, "Streaming from origin: " + read_name_ + " (" + std::to_string(size) + " bytes)");
+    return true;
+}
+
+std::streamsize TftpConnection::readSource(uint8_t* out, size_t size) {
+    if (compressed_reader_) {
+        size_t count = compressed_reader_->read(out, size);
+        return compressed_reader_->failed() ? -1 : static_cast<std::streamsize>(count);
+    }
+    if (origin_reader_) {
+        return static_cast<std::streamsize>(origin_reader_->read(out, size));
+    }
+
+    if (readsThroughSharedCache()) {
+        return readSharedSource(*server_.getSharedCache(), out, size);
+    }
+
+    if (!openPendingReadFile()) {
+        return -1;
+    }
+    return static_cast<std::streamsize>(read_file_.read(out, size));
+}
+
+std::streamsize TftpConnection::readSourceAt(uint64_t offset, uint8_t* out, size_t size) {
+    if (readsThroughSharedCache()) {
+        uint64_t position = source_offset_;
+        source_offset_ = offset;
+        std::streamsize count = readSharedSource(*server_.getSharedCache(), out, size);
+        source_offset_ = position;
+        return count;
+    }
+
+    if (!openPendingReadFile()) {
+        return -1;
+    }
+    return static_cast<std::streamsize>(read_file_.readAt(offset, out, size));
+}
+
+bool TftpConnection::readsThroughSharedCache() const {
+    return server_.getSharedCache() && !read_path_.empty() && !read_compressed_ && !origin_reader_;
+}
+
+std::streamsize TftpConnection::readSharedSource(TftpSharedContentCache& cache, uint8_t* out, size_t size) {
+    constexpr size_t CHUNK_SIZE = TftpSharedContentCache::CHUNK_SIZE;
+    TftpSharedCacheKey key{read_path_, read_file_size_, read_modified_};
+
+    size_t filled = 0;
+    while (filled < size && source_offset_ < read_file_size_) {
+        int64_t count = cache.read(key, source_offset_, out + filled, size - filled);
+        if (count < 0) {
+            // Load the whole chunk once for every worker
+            if (!openPendingReadFile()) {
+                return -1;
+            }
+            uint64_t chunk_start = source_offset_ - source_offset_ % CHUNK_SIZE;
+            size_t length = static_cast<size_t>(std::min<uint64_t>(CHUNK_SIZE, read_file_size_ - chunk_start));
+            shared_chunk_.resize(length);
+            if (read_file_.readAt(chunk_start, shared_chunk_.data(), length) != static_cast<int64_t>(length)) {
+                return -1;
+            }
+            cache.insert(key, chunk_start / CHUNK_SIZE, shared_chunk_.data(), length);
+            size_t within = static_cast<size_t>(source_offset_ - chunk_start);
+            count = static_cast<int64_t>(std::min(size - filled, length - within));
+            std::memcpy(out + filled, shared_chunk_.data() + within, static_cast<size_t>(count));
+        } else if (count == 0) {
+            break;
+        }
+        filled += static_cast<size_t>(count);
+        source_offset_ += static_cast<uint64_t>(count);
+    }
+    return static_cast<std::streamsize>(filled);
+}
+
+bool TftpConnection::openPendingReadFile() {
+    if (!read_open_pending_) {
+        return read_file_.isOpen();
+    }
+    read_open_pending_ = false;
+
+    read_file_ = rootHandle().openRead(read_name_);
+    server_.getMetadataCache().recordOpen();
+    if (!read_file_.isOpen()) {
+        logEvent(errno == EXDEV ? LogLevel::WARNING : LogLevel::ERROR,
+                 "Failed to open file for reading: " + read_path_ + " (" +
+                 (errno == EXDEV ? std::string("resolves outside the root") : std::string(std::strerror(errno))) + ")");
+        return false;
+    }
+    logEvent(LogLevel::INFO, "Opened file for reading: " + read_path_);
+    return true;
+}
+
+bool TftpConnection::rewindSource() {
+    if (compressed_reader_) {
+        return compressed_reader_->rewind();
+    }
+    if (origin_reader_) {
+        origin_reader_->rewind();
+        return true;
+    }
+    if (readsThroughSharedCache()) {
+        source_offset_ = 0;
+        return true;
+    }
+    if (!openPendingReadFile()) {
+        return false;
+    }
+    return read_file_.rewind();
+}
+
+bool TftpConnection::readWholeSource(const std::function<void(ByteView)>& sink) const {
+    std::vector<uint8_t> chunk(64 * 1024);
+    uint64_t total = 0;
+
+    if (read_compressed_) {
+        TftpCompressedStore& store = server_.getCompressedStore();
+        std::unique_ptr<TftpCompressedReader> reader = store.open(compressed_copy_, read_file_size_);
+        server_.getMetadataCache().recordOpen();
+        if (!reader) {
+            return false;
+        }
+        while (!reader->eof() && !reader->failed()) {
+            size_t count = reader->read(chunk.data(), chunk.size());
+            sink(ByteView(chunk.data(), count));
+            total += count;
+        }
+        if (reader->failed()) {
+            return false;
+        }
+    } else {
+        if (!root_) {
+            return false;
+        }
+        TftpFileHandle file = root_->openRead(read_name_);
+        server_.getMetadataCache().recordOpen();
+        if (!file.isOpen()) {
+            return false;
+        }
+        for (;;) {
+            int64_t count = file.read(chunk.data(), chunk.size());
+            if (count < 0) {
+                return false;
+            }
+            sink(ByteView(chunk.data(), static_cast<size_t>(count)));
+            total += static_cast<uint64_t>(count);
+            if (static_cast<size_t>(count) < chunk.size()) {
+                break;
+            }
+        }
+    }
+
+    return total == read_file_size_;
+}
+
 } // namespace simple_tftpd
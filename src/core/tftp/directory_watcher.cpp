@@ -0,0 +1,173 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/directory_watcher.hpp"
+
+#ifdef PLATFORM_LINUX
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace simple_tftpd {
+
+#ifdef PLATFORM_LINUX
+namespace {
+
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+} // namespace
+#endif
+
+TftpDirectoryWatcher::TftpDirectoryWatcher() : fd_(-1), running_(false), events_(0) {}
+
+TftpDirectoryWatcher::~TftpDirectoryWatcher() {
+    stop();
+}
+
+bool TftpDirectoryWatcher::start() {
+#ifdef PLATFORM_LINUX
+    if (running_.load()) {
+        return true;
+    }
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ < 0) {
+        return false;
+    }
+    running_.store(true);
+    thread_ = std::thread(&TftpDirectoryWatcher::run, this);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void TftpDirectoryWatcher::stop() {
+    running_.store(false);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    directories_.clear();
+    watches_.clear();
+}
+
+void TftpDirectoryWatcher::addListener(Listener listener) {
+    listeners_.push_back(std::move(listener));
+}
+
+std::string TftpDirectoryWatcher::watch(const std::string& directory, const std::string& stop_at) {
+#ifdef PLATFORM_LINUX
+    if (!running_.load()) {
+        return std::string();
+    }
+
+    std::string path = directory;
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (;;) {
+        if (watches_.count(path) != 0) {
+            return path;
+        }
+
+        int wd = inotify_add_watch(fd_, path.c_str(), WATCH_MASK);
+        if (wd >= 0) {
+            watches_[path] = wd;
+            directories_[wd] = path;
+            return path;
+        }
+
+        // Only a missing directory is worth retrying one level up
+        std::string::size_type slash = path.find_last_of('/');
+        if ((errno != ENOENT && errno != ENOTDIR) || path == stop_at || slash == std::string::npos ||
+            slash == 0) {
+            return std::string();
+        }
+        path.erase(slash);
+    }
+#else
+    (void)directory;
+    (void)stop_at;
+    return std::string();
+#endif
+}
+
+size_t TftpDirectoryWatcher::watchCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return watches_.size();
+}
+
+void TftpDirectoryWatcher::notify(const std::string& directory, const std::string& name) {
+    events_.fetch_add(1, std::memory_order_relaxed);
+    for (const auto& listener : listeners_) {
+        listener(directory, name);
+    }
+}
+
+void TftpDirectoryWatcher::run() {
+#ifdef PLATFORM_LINUX
+    alignas(struct inotify_event) char buffer[16 * 1024];
+
+    while (running_.load()) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            continue;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                notify(std::string(), std::string());
+                continue;
+            }
+
+            std::string directory;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = directories_.find(event->wd);
+                if (it == directories_.end()) {
+                    continue;
+                }
+                directory = it->second;
+                if (event->mask & IN_IGNORED) {
+                    // The directory went away; a later watch() starts over
+                    watches_.erase(directory);
+                    directories_.erase(it);
+                    continue;
+                }
+            }
+            notify(directory, event->len > 0 ? std::string(event->name) : std::string());
+        }
+    }
+#endif
+}
+
+} // namespace simple_tftpd
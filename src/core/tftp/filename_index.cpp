@@ -0,0 +1,403 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/filename_index.hpp"
+#include "simple-tftpd/core/tftp/negative_cache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <thread>
+
+namespace simple_tftpd {
+
+namespace {
+
+std::string joinPath(const std::string& root, const std::string& relative) {
+    if (relative.empty()) {
+        return root;
+    }
+    return root == "/" ? root + relative : root + "/" + relative;
+}
+
+} // namespace
+
+TftpFilenameIndex::TftpFilenameIndex(TftpDirectoryWatcher* watcher) : watcher_(watcher), building_(false) {
+    if (watcher_) {
+        watcher_->addListener([this](const std::string& directory, const std::string& name) {
+            onChange(directory, name);
+        });
+    }
+}
+
+size_t TftpFilenameIndex::build(const std::string& root, size_t threads) {
+    auto started = std::chrono::steady_clock::now();
+    std::string base = TftpNegativeCache::normalize(root);
+    {
+        // Lookups keep using the previous index until the new one is complete
+        std::lock_guard<std::mutex> lock(mutex_);
+        root_ = base;
+        building_ = true;
+        pending_.clear();
+    }
+
+    if (threads == 0) {
+        threads = std::min<size_t>(8, std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    // Directories are shared out one at a time, so a single deep subtree
+    // still spreads over every worker
+    std::deque<std::string> queue(1, std::string());
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    size_t busy = 0;
+    std::vector<Scan> scans(threads);
+
+    auto worker = [&](Scan& scan) {
+        std::vector<std::string> subdirectories;
+        for (;;) {
+            std::string relative;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_ready.wait(lock, [&] { return !queue.empty() || busy == 0; });
+                if (queue.empty()) {
+                    return;
+                }
+                relative = std::move(queue.front());
+                queue.pop_front();
+                busy++;
+            }
+
+            subdirectories.clear();
+            listDirectory(base, relative, scan, subdirectories);
+
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                for (auto& subdirectory : subdirectories) {
+                    queue.push_back(std::move(subdirectory));
+                }
+                busy--;
+            }
+            queue_ready.notify_all();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker, std::ref(scans[i]));
+    }
+    worker(scans[0]);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    // Merged outside the lock, so lookups are only held up by the swap
+    FileMap files;
+    std::unordered_set<std::string> directories;
+    size_t count = 0;
+    uint64_t unwatched = 0;
+    size_t total = 0;
+    for (const auto& scan : scans) {
+        total += scan.files.size();
+    }
+    files.reserve(total);
+    for (const auto& scan : scans) {
+        for (const auto& file : scan.files) {
+            count += insertName(files, file.first, file.second) ? 1 : 0;
+        }
+        directories.insert(scan.directories.begin(), scan.directories.end());
+        unwatched += scan.unwatched;
+    }
+
+    std::vector<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_.swap(files);
+        directories_.swap(directories);
+        building_ = false;
+        pending.swap(pending_);
+        stats_.files = count;
+        stats_.unwatched_directories = unwatched;
+        stats_.builds++;
+        stats_.build_time_ms = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                         std::chrono::steady_clock::now() - started)
+                                                         .count());
+    }
+
+    // Changes made during the scan may have been missed by it
+    for (const auto& relative : pending) {
+        refresh(relative);
+    }
+    return count;
+}
+
+void TftpFilenameIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    root_.clear();
+    pending_.clear();
+    files_.clear();
+    directories_.clear();
+    stats_.files = 0;
+    stats_.unwatched_directories = 0;
+}
+
+bool TftpFilenameIndex::isBuilt() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !root_.empty() && !building_;
+}
+
+bool TftpFilenameIndex::resolve(const std::string& filename, std::string& resolved) {
+    std::string name = normalizeName(filename);
+    std::string key = lowercase(name);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.lookups++;
+    if (root_.empty()) {
+        return false;
+    }
+    auto it = files_.find(key);
+    if (it == files_.end()) {
+        return false;
+    }
+
+    const std::vector<std::string>& names = it->second;
+    resolved = std::binary_search(names.begin(), names.end(), name) ? name : names.front();
+    stats_.resolved++;
+    return true;
+}
+
+TftpFilenameIndexStats TftpFilenameIndex::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TftpFilenameIndexStats stats = stats_;
+    stats.directories = directories_.size();
+    return stats;
+}
+
+std::string TftpFilenameIndex::normalizeName(const std::string& filename) {
+    std::string normalized;
+    normalized.reserve(filename.size());
+
+    size_t start = 0;
+    while (start < filename.size()) {
+        size_t end = filename.find_first_of("/\\", start);
+        if (end == std::string::npos) {
+            end = filename.size();
+        }
+        if (end > start && !(end - start == 1 && filename[start] == '.')) {
+            if (!normalized.empty()) {
+                normalized += '/';
+            }
+            normalized.append(filename, start, end - start);
+        }
+        start = end + 1;
+    }
+    return normalized;
+}
+
+std::string TftpFilenameIndex::fold(const std::string& filename) {
+    return lowercase(normalizeName(filename));
+}
+
+std::string TftpFilenameIndex::lowercase(std::string name) {
+    for (char& c : name) {
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+    return name;
+}
+
+void TftpFilenameIndex::onChange(const std::string& directory, const std::string& name) {
+    std::string root;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        root = root_;
+    }
+    if (root.empty()) {
+        return;
+    }
+    if (directory.empty()) {
+        build(root);  // Events were lost
+        return;
+    }
+
+    std::string path = name.empty() ? directory : directory + "/" + name;
+    std::string prefix = root == "/" ? root : root + "/";
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        return;
+    }
+    std::string relative = path.substr(prefix.size());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (building_) {
+            pending_.push_back(relative);
+            return;
+        }
+    }
+    refresh(relative);
+}
+
+void TftpFilenameIndex::refresh(const std::string& relative) {
+    std::string root;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        root = root_;
+    }
+    if (root.empty() || relative.empty()) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::file_status status = std::filesystem::symlink_status(joinPath(root, relative), error);
+    if (std::filesystem::is_symlink(status)) {
+        status = std::filesystem::status(joinPath(root, relative), error);
+        if (std::filesystem::is_directory(status)) {
+            status = std::filesystem::file_status();  // Symlinked directories are not followed
+        }
+    }
+
+    if (std::filesystem::is_directory(status)) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (directories_.count(relative) != 0) {
+                return;
+            }
+        }
+
+        // A directory created or moved in: index everything below it
+        Scan scan;
+        scan.directories.push_back(relative);
+        std::vector<std::string> stack(1, relative);
+        std::vector<std::string> subdirectories;
+        while (!stack.empty()) {
+            std::string next = std::move(stack.back());
+            stack.pop_back();
+            subdirectories.clear();
+            listDirectory(root, next, scan, subdirectories);
+            stack.insert(stack.end(), subdirectories.begin(), subdirectories.end());
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (root_ == root) {
+            mergeLocked(scan);
+            stats_.updates++;
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (root_ != root) {
+        return;
+    }
+    if (std::filesystem::is_regular_file(status)) {
+        addFileLocked(lowercase(relative), relative);
+    } else {
+        removeLocked(relative);
+    }
+    stats_.updates++;
+}
+
+void TftpFilenameIndex::listDirectory(const std::string& root, const std::string& relative, Scan& scan,
+                                      std::vector<std::string>& subdirectories) const {
+    std::string absolute = joinPath(root, relative);
+
+    // Watch before listing, so entries created meanwhile are reported
+    if (watcher_ && watcher_->isActive() && watcher_->watch(absolute, absolute) != absolute) {
+        scan.unwatched++;
+    }
+
+    std::error_code error;
+    std::filesystem::directory_iterator it(absolute, std::filesystem::directory_options::skip_permission_denied,
+                                           error);
+    for (; !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+        std::string name = it->path().filename().string();
+        std::string entry = relative.empty() ? name : relative + "/" + name;
+
+        std::error_code type_error;
+        if (it->is_symlink(type_error)) {
+            // Symlinked files are served, symlinked directories are not walked
+            if (it->is_regular_file(type_error)) {
+                scan.files.emplace_back(lowercase(entry), entry);
+            }
+        } else if (it->is_directory(type_error)) {
+            scan.directories.push_back(entry);
+            subdirectories.push_back(entry);
+        } else if (it->is_regular_file(type_error)) {
+            scan.files.emplace_back(lowercase(entry), entry);
+        }
+    }
+}
+
+void TftpFilenameIndex::mergeLocked(const Scan& scan) {
+    directories_.insert(scan.directories.begin(), scan.directories.end());
+    for (const auto& file : scan.files) {
+        addFileLocked(file.first, file.second);
+    }
+    stats_.unwatched_directories += scan.unwatched;
+}
+
+void TftpFilenameIndex::addFileLocked(const std::string& key, const std::string& relative) {
+    if (insertName(files_, key, relative)) {
+        stats_.files++;
+    }
+}
+
+bool TftpFilenameIndex::insertName(FileMap& files, const std::string& key, const std::string& relative) {
+    std::vector<std::string>& names = files[key];
+    auto it = std::lower_bound(names.begin(), names.end(), relative);
+    if (it != names.end() && *it == relative) {
+        return false;
+    }
+    names.insert(it, relative);
+    return true;
+}
+
+void TftpFilenameIndex::removeLocked(const std::string& relative) {
+    auto it = files_.find(lowercase(relative));
+    if (it != files_.end()) {
+        std::vector<std::string>& names = it->second;
+        auto name = std::lower_bound(names.begin(), names.end(), relative);
+        if (name != names.end() && *name == relative) {
+            names.erase(name);
+            stats_.files--;
+            if (names.empty()) {
+                files_.erase(it);
+            }
+        }
+    }
+
+    if (directories_.erase(relative) == 0) {
+        return;
+    }
+
+    // A directory went away: drop everything that was below it
+    std::string prefix = relative + "/";
+    auto below = [&prefix](const std::string& path) { return path.compare(0, prefix.size(), prefix) == 0; };
+    for (auto dir = directories_.begin(); dir != directories_.end();) {
+        dir = below(*dir) ? directories_.erase(dir) : std::next(dir);
+    }
+    for (auto entry = files_.begin(); entry != files_.end();) {
+        std::vector<std::string>& names = entry->second;
+        size_t before = names.size();
+        names.erase(std::remove_if(names.begin(), names.end(), below), names.end());
+        stats_.files -= before - names.size();
+        entry = names.empty() ? files_.erase(entry) : std::next(entry);
+    }
+}
+
+} // namespace simple_tftpd
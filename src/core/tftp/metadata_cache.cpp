@@ -0,0 +1,140 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/metadata_cache.hpp"
+#include "simple-tftpd/core/tftp/negative_cache.hpp"
+
+namespace simple_tftpd {
+
+TftpMetadataCache::TftpMetadataCache(size_t max_entries, TftpDirectoryWatcher* watcher)
+    : max_entries_(max_entries), watcher_(watcher), generation_(0), file_opens_(0) {
+    if (watcher_) {
+        watcher_->addListener([this](const std::string& directory, const std::string& name) {
+            if (directory.empty()) {
+                clear();  // Events were lost
+            } else {
+                invalidate(name.empty() ? directory : directory + "/" + name);
+            }
+        });
+    }
+}
+
+void TftpMetadataCache::setMaxEntries(size_t max_entries) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_entries_ = max_entries;
+    while (entries_.size() > max_entries_) {
+        eraseLocked(entries_.find(order_.front()));
+        stats_.evictions++;
+    }
+}
+
+bool TftpMetadataCache::lookup(const TftpRootHandle& root, const std::string& relative, TftpFileMetadata& metadata) {
+    std::string key = TftpNegativeCache::normalize(root.getRoot() + "/" + relative);
+    bool cacheable;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            stats_.hits++;
+            metadata = it->second.metadata;
+            return true;
+        }
+        stats_.misses++;
+        stats_.stat_calls++;
+        cacheable = max_entries_ > 0 && watcher_ && watcher_->isActive();
+    }
+
+    // Watch before the stat, so a change after it is always reported
+    std::string::size_type slash = key.find_last_of('/');
+    if (cacheable && slash != std::string::npos && slash > 0) {
+        std::string parent = key.substr(0, slash);
+        cacheable = watcher_->watch(parent, TftpNegativeCache::normalize(root.getRoot())) == parent;
+    } else {
+        cacheable = false;
+    }
+
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = generation_;
+    }
+
+    if (!root.stat(relative, metadata)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!cacheable || max_entries_ == 0 || generation != generation_ || entries_.count(key) != 0) {
+        return true;
+    }
+    order_.push_back(key);
+    Entry& entry = entries_[key];
+    entry.metadata = metadata;
+    entry.order = std::prev(order_.end());
+
+    while (entries_.size() > max_entries_) {
+        eraseLocked(entries_.find(order_.front()));
+        stats_.evictions++;
+    }
+    return true;
+}
+
+void TftpMetadataCache::invalidate(const std::string& path) {
+    std::string key = TftpNegativeCache::normalize(path);
+    std::lock_guard<std::mutex> lock(mutex_);
+    invalidateLocked(key);
+}
+
+void TftpMetadataCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    stats_.invalidations += entries_.size();
+    entries_.clear();
+    order_.clear();
+}
+
+TftpMetadataCacheStats TftpMetadataCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TftpMetadataCacheStats stats = stats_;
+    stats.entries = entries_.size();
+    stats.file_opens = file_opens_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TftpMetadataCache::eraseLocked(std::map<std::string, Entry>::iterator it) {
+    order_.erase(it->second.order);
+    entries_.erase(it);
+}
+
+void TftpMetadataCache::invalidateLocked(const std::string& path) {
+    generation_++;
+    auto exact = entries_.find(path);
+    if (exact != entries_.end()) {
+        eraseLocked(exact);
+        stats_.invalidations++;
+    }
+
+    std::string prefix = path + "/";
+    auto it = entries_.lower_bound(prefix);
+    while (it != entries_.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+        auto next = std::next(it);
+        eraseLocked(it);
+        stats_.invalidations++;
+        it = next;
+    }
+}
+
+} // namespace simple_tftpd
@@ -156,6 +156,39 @@ void Monitoring::updateActiveConnections(size_t count) {
     }
 }
 
+void Monitoring::mergeMetrics(const ServerMetrics& other) {
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    
+    TransferStats& transfers = metrics_.transfers;
+    uint64_t total = transfers.total_transfers + other.transfers.total_transfers;
+    if (total > 0) {
+        transfers.average_transfer_time_ms =
+            (transfers.average_transfer_time_ms * transfers.total_transfers +
+             other.transfers.average_transfer_time_ms * other.transfers.total_transfers) / total;
+    }
+    transfers.total_transfers = total;
+    transfers.successful_transfers += other.transfers.successful_transfers;
+    transfers.failed_transfers += other.transfers.failed_transfers;
+    transfers.total_bytes_sent += other.transfers.total_bytes_sent;
+    transfers.total_bytes_received += other.transfers.total_bytes_received;
+    transfers.last_transfer_time = std::max(transfers.last_transfer_time, other.transfers.last_transfer_time);
+    
+    ConnectionStats& connections = metrics_.connections;
+    connections.total_connections += other.connections.total_connections;
+    connections.active_connections += other.connections.active_connections;
+    connections.peak_connections += other.connections.peak_connections;
+    connections.failed_connections += other.connections.failed_connections;
+    connections.last_connection_time = std::max(connections.last_connection_time,
+                                                other.connections.last_connection_time);
+    
+    metrics_.total_errors += other.total_errors;
+    metrics_.total_timeouts += other.total_timeouts;
+    if (other.server_start_time.time_since_epoch().count() != 0 &&
+        other.server_start_time < metrics_.server_start_time) {
+        metrics_.server_start_time = other.server_start_time;
+    }
+}
+
 std::string Monitoring::getMetricsJson() const {
     auto metrics = getMetrics();
     std::ostringstream oss;
@@ -0,0 +1,520 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/multicast.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace simple_tftpd {
+
+namespace {
+
+std::string addressKey(const struct sockaddr_in& address) {
+    char text[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &address.sin_addr, text, sizeof(text));
+    return std::string(text) + ":" + std::to_string(ntohs(address.sin_port));
+}
+
+} // namespace
+
+TftpMulticastSession::TftpMulticastSession(TftpMulticastSessionConfig config, std::shared_ptr<Logger> logger)
+    : config_(std::move(config)),
+      logger_(logger),
+      socket_(INVALID_SOCKET_VALUE),
+      local_port_(0),
+      group_addr_{},
+      total_blocks_(config_.file_size / config_.block_size + 1),
+      tx_buffer_(TftpCodec::HEADER_SIZE + config_.block_size),
+      active_(false),
+      finished_(false),
+      master_acked_(false),
+      current_block_(0),
+      retry_count_(0),
+      last_send_(std::chrono::steady_clock::now()) {}
+
+TftpMulticastSession::~TftpMulticastSession() {
+    stop();
+}
+
+bool TftpMulticastSession::start() {
+    group_addr_.sin_family = AF_INET;
+    group_addr_.sin_port = htons(config_.group_port);
+    if (inet_pton(AF_INET, config_.group_address.c_str(), &group_addr_.sin_addr) != 1) {
+        logEvent(LogLevel::ERROR, "Invalid multicast group address: " + config_.group_address);
+        return false;
+    }
+
+    file_ = config_.root ? config_.root->openRead(config_.name) : TftpFileHandle::openPath(config_.path);
+    if (!file_.isOpen()) {
+        logEvent(LogLevel::ERROR, "Failed to open file for multicast: " + config_.path);
+        return false;
+    }
+
+    socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_ == INVALID_SOCKET_VALUE) {
+        logEvent(LogLevel::ERROR, "Failed to create multicast socket: " + std::to_string(SOCKET_ERROR_CODE));
+        return false;
+    }
+
+    // Ephemeral port: the server TID shared by every client of the session
+    struct sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    socklen_t local_len = sizeof(local);
+    if (bind(socket_, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0 ||
+        getsockname(socket_, reinterpret_cast<struct sockaddr*>(&local), &local_len) < 0) {
+        logEvent(LogLevel::ERROR, "Failed to bind multicast socket: " + std::to_string(SOCKET_ERROR_CODE));
+        CLOSE_SOCKET(socket_);
+        socket_ = INVALID_SOCKET_VALUE;
+        return false;
+    }
+    local_port_ = ntohs(local.sin_port);
+
+    unsigned char ttl = config_.ttl;
+    if (setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_TTL,
+                   reinterpret_cast<const char*>(&ttl), sizeof(ttl)) < 0) {
+        logEvent(LogLevel::WARNING, "Failed to set IP_MULTICAST_TTL: " + std::to_string(SOCKET_ERROR_CODE));
+    }
+
+    // Clients on this host must see the group traffic too
+    unsigned char loop = 1;
+    if (setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_LOOP,
+                   reinterpret_cast<const char*>(&loop), sizeof(loop)) < 0) {
+        logEvent(LogLevel::WARNING, "Failed to set IP_MULTICAST_LOOP: " + std::to_string(SOCKET_ERROR_CODE));
+    }
+
+    if (!config_.interface_address.empty()) {
+        struct in_addr interface_addr;
+        if (inet_pton(AF_INET, config_.interface_address.c_str(), &interface_addr) != 1 ||
+            setsockopt(socket_, IPPROTO_IP, IP_MULTICAST_IF,
+                       reinterpret_cast<const char*>(&interface_addr), sizeof(interface_addr)) < 0) {
+            logEvent(LogLevel::WARNING, "Failed to set multicast interface: " + config_.interface_address);
+        }
+    }
+
+    // Short receive timeout so the worker can drive retransmissions
+    struct ::timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 10000;
+    if (setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO,
+                   reinterpret_cast<const char*>(&timeout), sizeof(timeout)) < 0) {
+        logEvent(LogLevel::WARNING, "Failed to set receive timeout: " + std::to_string(SOCKET_ERROR_CODE));
+    }
+
+    active_.store(true);
+    worker_thread_ = std::thread(&TftpMulticastSession::workerThread, this);
+
+    logEvent(LogLevel::INFO, "Multicast session started on port " + std::to_string(local_port_));
+    return true;
+}
+
+void TftpMulticastSession::stop() {
+    active_.store(false);
+    if (worker_thread_.joinable()) {
+        worker_thread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    clients_.clear();
+    if (socket_ != INVALID_SOCKET_VALUE) {
+        CLOSE_SOCKET(socket_);
+        socket_ = INVALID_SOCKET_VALUE;
+    }
+    file_.close();
+}
+
+bool TftpMulticastSession::addClient(const std::string& client_addr, port_t client_port,
+                                     const TftpOptions& request_options) {
+    Client client{};
+    client.address.sin_family = AF_INET;
+    client.address.sin_port = htons(client_port);
+    if (inet_pton(AF_INET, client_addr.c_str(), &client.address.sin_addr) != 1) {
+        return false;
+    }
+    client.key = addressKey(client.address);
+    client.request_options = request_options;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_ || !active_.load()) {
+        return false;
+    }
+
+    // A retransmitted RRQ only needs its OACK again
+    for (size_t i = 0; i < clients_.size(); ++i) {
+        if (clients_[i].key == client.key) {
+            return sendOptionAck(clients_[i], i == 0);
+        }
+    }
+
+    clients_.push_back(client);
+    stats_.clients_joined++;
+    logEvent(LogLevel::INFO, "Client " + client.key + " joined multicast group (" +
+             std::to_string(clients_.size()) + " clients)");
+
+    if (clients_.size() == 1) {
+        promoteNextMaster();
+        return true;
+    }
+    return sendOptionAck(clients_.back(), false);
+}
+
+bool TftpMulticastSession::isFinished() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_;
+}
+
+const TftpMulticastSessionConfig& TftpMulticastSession::getConfig() const {
+    return config_;
+}
+
+size_t TftpMulticastSession::getClientCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return clients_.size();
+}
+
+port_t TftpMulticastSession::getLocalPort() const {
+    return local_port_;
+}
+
+TftpMulticastStats TftpMulticastSession::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void TftpMulticastSession::workerThread() {
+    std::vector<uint8_t> buffer(TFTP_MAX_PACKET_SIZE);
+
+    while (active_.load()) {
+        struct sockaddr_in sender;
+        socklen_t sender_len = sizeof(sender);
+        ssize_t bytes_received = recvfrom(socket_,
+                                          reinterpret_cast<char*>(buffer.data()),
+                                          buffer.size(),
+                                          0,
+                                          reinterpret_cast<struct sockaddr*>(&sender),
+                                          &sender_len);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (bytes_received > 0 && sender.sin_family == AF_INET) {
+            handleDatagram(buffer.data(), static_cast<size_t>(bytes_received), sender);
+        }
+        handleTimeoutTick();
+
+        // Done once the clients that joined have all left
+        if (clients_.empty() && stats_.clients_joined > 0) {
+            finished_ = true;
+            break;
+        }
+    }
+
+    logEvent(LogLevel::INFO, "Multicast session finished: " + std::to_string(stats_.blocks_sent) +
+             " blocks sent for " + std::to_string(stats_.clients_completed) + " clients");
+}
+
+void TftpMulticastSession::handleDatagram(const uint8_t* data, size_t size, const struct sockaddr_in& sender) {
+    std::string key = addressKey(sender);
+    auto it = std::find_if(clients_.begin(), clients_.end(),
+                           [&key](const Client& client) { return client.key == key; });
+    if (it == clients_.end()) {
+        return;
+    }
+    size_t index = static_cast<size_t>(it - clients_.begin());
+
+    TftpAckView ack;
+    TftpErrorView error;
+    if (TftpCodec::decodeAck(data, size, ack)) {
+        if (index == 0) {
+            handleMasterAck(ack.block);
+        } else if (unwrapBlock(ack.block) >= total_blocks_) {
+            // A listener that already has the whole file may leave early
+            removeClient(index, true);
+        }
+    } else if (TftpCodec::decodeError(data, size, error)) {
+        logEvent(LogLevel::INFO, "Client " + key + " left multicast group: " + std::string(error.message));
+        removeClient(index, false);
+    }
+}
+
+void TftpMulticastSession::handleMasterAck(uint16_t block) {
+    uint64_t acked = unwrapBlock(block);
+
+    // Duplicate ACK for a block already answered; the timer covers real loss
+    if (master_acked_ && acked + 1 == current_block_) {
+        return;
+    }
+    master_acked_ = true;
+    retry_count_ = 0;
+
+    if (acked >= total_blocks_) {
+        removeClient(0, true);
+        return;
+    }
+
+    // A promoted master ACKs the last block it holds, which rewinds the
+    // stream to the first block it missed
+    current_block_ = acked + 1;
+    sendBlock(current_block_);
+}
+
+void TftpMulticastSession::handleTimeoutTick() {
+    if (clients_.empty()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_send_ < config_.timeout) {
+        return;
+    }
+
+    if (++retry_count_ > config_.max_retries) {
+        logEvent(LogLevel::WARNING, "Master client " + clients_.front().key + " timed out");
+        removeClient(0, false);
+        return;
+    }
+
+    if (!master_acked_) {
+        sendOptionAck(clients_.front(), true);
+        last_send_ = now;
+    } else {
+        sendBlock(current_block_);
+    }
+}
+
+void TftpMulticastSession::promoteNextMaster() {
+    master_acked_ = false;
+    retry_count_ = 0;
+    last_send_ = std::chrono::steady_clock::now();
+    if (!clients_.empty()) {
+        sendOptionAck(clients_.front(), true);
+    }
+}
+
+void TftpMulticastSession::removeClient(size_t index, bool completed) {
+    if (completed) {
+        stats_.clients_completed++;
+    }
+    clients_.erase(clients_.begin() + static_cast<long>(index));
+    if (index == 0) {
+        promoteNextMaster();
+    }
+}
+
+bool TftpMulticastSession::sendOptionAck(const Client& client, bool master) {
+    TftpOptions response;
+    if (client.request_options.has_blksize) {
+        response.has_blksize = true;
+        response.blksize = config_.block_size;
+    }
+    if (client.request_options.has_timeout && client.request_options.timeout == config_.timeout.count()) {
+        response.has_timeout = true;
+        response.timeout = client.request_options.timeout;
+    }
+    if (client.request_options.has_tsize) {
+        response.has_tsize = true;
+        response.tsize = static_cast<uint32_t>(std::min<uint64_t>(config_.file_size, UINT32_MAX));
+    }
+    response.multicast = true;
+    response.multicast_ip = config_.group_address;
+    response.multicast_port = config_.group_port;
+    response.multicast_master = master;
+
+    uint8_t packet_data[2 + TftpCodec::MAX_OPTIONS_SIZE];
+    size_t length = TftpCodec::encodeOptionAck(packet_data, sizeof(packet_data), response);
+    return length > 0 && sendTo(packet_data, length, client.address);
+}
+
+bool TftpMulticastSession::sendBlock(uint64_t block) {
+    int64_t count = file_.readAt((block - 1) * config_.block_size, tx_buffer_.data() + TftpCodec::HEADER_SIZE,
+                                 config_.block_size);
+    size_t payload = static_cast<size_t>(std::max<int64_t>(count, 0));
+
+    TftpCodec::encodeDataHeader(tx_buffer_.data(), tx_buffer_.size(), static_cast<uint16_t>(block & 0xFFFF));
+    last_send_ = std::chrono::steady_clock::now();
+    if (!sendTo(tx_buffer_.data(), TftpCodec::HEADER_SIZE + payload, group_addr_)) {
+        return false;
+    }
+
+    stats_.blocks_sent++;
+    stats_.bytes_sent += payload;
+    return true;
+}
+
+bool TftpMulticastSession::sendTo(const uint8_t* data, size_t size, const struct sockaddr_in& address) {
+    ssize_t bytes_sent = sendto(socket_,
+                                reinterpret_cast<const char*>(data),
+                                size,
+                                0,
+                                reinterpret_cast<const struct sockaddr*>(&address),
+                                sizeof(address));
+    if (bytes_sent < 0 || static_cast<size_t>(bytes_sent) != size) {
+        logEvent(LogLevel::ERROR, "Failed to send multicast packet to " + addressKey(address) +
+                 ": " + std::to_string(SOCKET_ERROR_CODE));
+        return false;
+    }
+    return true;
+}
+
+uint64_t TftpMulticastSession::unwrapBlock(uint16_t block) const {
+    // ACKs carry 16 bits; take the candidate nearest the current position
+    uint64_t candidate = (current_block_ & ~static_cast<uint64_t>(0xFFFF)) | block;
+    if (candidate > current_block_ + 0x8000 && candidate >= 0x10000) {
+        candidate -= 0x10000;
+    } else if (candidate + 0x8000 < current_block_) {
+        candidate += 0x10000;
+    }
+    return candidate;
+}
+
+void TftpMulticastSession::logEvent(LogLevel level, const std::string& message) {
+    if (logger_) {
+        logger_->log(level, "[Multicast " + config_.path + "] " + message);
+    }
+}
+
+TftpMulticastManager::TftpMulticastManager(std::shared_ptr<TftpConfig> config, std::shared_ptr<Logger> logger)
+    : config_(config), logger_(logger) {}
+
+TftpMulticastManager::~TftpMulticastManager() {
+    stopAll();
+}
+
+bool TftpMulticastManager::join(const std::string& client_addr, port_t client_port, const std::string& path,
+                                uint64_t file_size, uint16_t block_size, const TftpOptions& request_options,
+                                std::shared_ptr<const TftpRootHandle> root, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!config_ || !config_->isMulticastEnabled()) {
+        return false;
+    }
+
+    // RFC 2090 groups are IPv4; dual-stack sockets report v4-mapped peers
+    std::string address = client_addr;
+    if (address.rfind("::ffff:", 0) == 0) {
+        address = address.substr(7);
+    }
+    struct in_addr parsed;
+    if (inet_pton(AF_INET, address.c_str(), &parsed) != 1) {
+        return false;
+    }
+
+    SessionKey key(path, block_size);
+    auto it = sessions_.find(key);
+    if (it != sessions_.end()) {
+        if (it->second->addClient(address, client_port, request_options)) {
+            return true;
+        }
+        retire(it->second);
+        sessions_.erase(it);
+    }
+
+    TftpMulticastSessionConfig session_config;
+    session_config.path = path;
+    session_config.name = name;
+    session_config.root = std::move(root);
+    session_config.file_size = file_size;
+    session_config.block_size = block_size;
+    session_config.timeout = std::chrono::seconds(request_options.has_timeout
+        ? std::clamp<uint16_t>(request_options.timeout, 1, 255)
+        : config_->getTimeout());
+    session_config.max_retries = config_->getMaxRetries();
+    session_config.group_address = config_->getMulticastGroupAddress();
+    session_config.ttl = config_->getMulticastTtl();
+    session_config.interface_address = config_->getMulticastInterface();
+    if (!allocateGroupPort(session_config.group_port)) {
+        if (logger_) {
+            logger_->log(LogLevel::WARNING, "No free multicast group port for " + path);
+        }
+        return false;
+    }
+
+    auto session = std::make_shared<TftpMulticastSession>(session_config, logger_);
+    if (!session->start()) {
+        return false;
+    }
+    retired_stats_.sessions_created++;
+    sessions_[key] = session;
+    return session->addClient(address, client_port, request_options);
+}
+
+void TftpMulticastManager::setConfig(std::shared_ptr<TftpConfig> config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+}
+
+void TftpMulticastManager::cleanup() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = sessions_.begin(); it != sessions_.end();) {
+        if (it->second->isFinished()) {
+            retire(it->second);
+            it = sessions_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void TftpMulticastManager::stopAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : sessions_) {
+        retire(entry.second);
+    }
+    sessions_.clear();
+}
+
+size_t TftpMulticastManager::getSessionCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sessions_.size();
+}
+
+TftpMulticastStats TftpMulticastManager::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TftpMulticastStats total = retired_stats_;
+    for (const auto& entry : sessions_) {
+        TftpMulticastStats stats = entry.second->getStats();
+        total.clients_joined += stats.clients_joined;
+        total.clients_completed += stats.clients_completed;
+        total.blocks_sent += stats.blocks_sent;
+        total.bytes_sent += stats.bytes_sent;
+    }
+    return total;
+}
+
+bool TftpMulticastManager::allocateGroupPort(port_t& port) const {
+    uint32_t base = config_->getMulticastBasePort();
+    for (uint32_t offset = 0; offset < config_->getMulticastMaxSessions() && base + offset <= 65535; ++offset) {
+        port_t candidate = static_cast<port_t>(base + offset);
+        bool in_use = std::any_of(sessions_.begin(), sessions_.end(), [candidate](const auto& entry) {
+            return entry.second->getConfig().group_port == candidate;
+        });
+        if (!in_use) {
+            port = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TftpMulticastManager::retire(const std::shared_ptr<TftpMulticastSession>& session) {
+    session->stop();
+    TftpMulticastStats stats = session->getStats();
+    retired_stats_.clients_joined += stats.clients_joined;
+    retired_stats_.clients_completed += stats.clients_completed;
+    retired_stats_.blocks_sent += stats.blocks_sent;
+    retired_stats_.bytes_sent += stats.bytes_sent;
+}
+
+} // namespace simple_tftpd
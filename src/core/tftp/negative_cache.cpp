@@ -0,0 +1,180 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/negative_cache.hpp"
+
+namespace simple_tftpd {
+
+TftpNegativeCache::TftpNegativeCache(size_t max_entries, std::chrono::milliseconds ttl,
+                                     TftpDirectoryWatcher* watcher)
+    : max_entries_(max_entries), ttl_(ttl), watcher_(watcher), generation_(0) {
+    if (watcher_) {
+        watcher_->addListener([this](const std::string& directory, const std::string& name) {
+            if (directory.empty()) {
+                clear();  // Events were lost
+            } else {
+                invalidate(name.empty() ? directory : directory + "/" + name);
+            }
+        });
+    }
+}
+
+void TftpNegativeCache::setLimits(size_t max_entries, std::chrono::milliseconds ttl) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_entries_ = max_entries;
+    ttl_ = ttl;
+    while (entries_.size() > max_entries_) {
+        eraseLocked(entries_.find(order_.front()));
+        stats_.evictions++;
+    }
+}
+
+bool TftpNegativeCache::contains(const std::string& path) {
+    std::string key = normalize(path);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        stats_.misses++;
+        return false;
+    }
+    if (std::chrono::steady_clock::now() >= it->second.expires) {
+        eraseLocked(it);
+        stats_.expirations++;
+        stats_.misses++;
+        return false;
+    }
+
+    stats_.hits++;
+    stats_.syscalls_saved += it->second.probes;
+    return true;
+}
+
+uint64_t TftpNegativeCache::generation() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return generation_;
+}
+
+void TftpNegativeCache::insert(const std::string& path, const std::string& root, uint32_t probes,
+                               uint64_t generation) {
+    std::string key = normalize(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (max_entries_ == 0) {
+            return;
+        }
+    }
+
+    if (watcher_) {
+        std::string::size_type slash = key.find_last_of('/');
+        if (slash != std::string::npos && slash > 0) {
+            watcher_->watch(key.substr(0, slash), normalize(root));
+        }
+    }
+
+    // Any change seen since the probe may have created the file
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (max_entries_ == 0 || generation != generation_) {
+        return;
+    }
+
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        eraseLocked(it);
+    }
+    order_.push_back(key);
+    Entry& entry = entries_[key];
+    entry.expires = std::chrono::steady_clock::now() + ttl_;
+    entry.probes = probes;
+    entry.order = std::prev(order_.end());
+    stats_.insertions++;
+
+    while (entries_.size() > max_entries_) {
+        eraseLocked(entries_.find(order_.front()));
+        stats_.evictions++;
+    }
+}
+
+void TftpNegativeCache::invalidate(const std::string& path) {
+    std::string key = normalize(path);
+    std::lock_guard<std::mutex> lock(mutex_);
+    invalidateLocked(key);
+}
+
+void TftpNegativeCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    stats_.invalidations += entries_.size();
+    entries_.clear();
+    order_.clear();
+}
+
+TftpNegativeCacheStats TftpNegativeCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TftpNegativeCacheStats stats = stats_;
+    stats.entries = entries_.size();
+    return stats;
+}
+
+std::string TftpNegativeCache::normalize(const std::string& path) {
+    std::string normalized;
+    normalized.reserve(path.size());
+
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        std::string segment = path.substr(start, end - start);
+        if (!segment.empty() && segment != ".") {
+            normalized += '/';
+            normalized += segment;
+        }
+        start = end + 1;
+    }
+
+    // Relative paths stay relative
+    if (!path.empty() && path.front() != '/' && !normalized.empty()) {
+        normalized.erase(normalized.begin());
+    }
+    return normalized.empty() && !path.empty() && path.front() == '/' ? "/" : normalized;
+}
+
+void TftpNegativeCache::eraseLocked(std::map<std::string, Entry>::iterator it) {
+    order_.erase(it->second.order);
+    entries_.erase(it);
+}
+
+void TftpNegativeCache::invalidateLocked(const std::string& path) {
+    generation_++;
+    auto exact = entries_.find(path);
+    if (exact != entries_.end()) {
+        eraseLocked(exact);
+        stats_.invalidations++;
+    }
+
+    std::string prefix = path + "/";
+    auto it = entries_.lower_bound(prefix);
+    while (it != entries_.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+        auto next = std::next(it);
+        eraseLocked(it);
+        stats_.invalidations++;
+        it = next;
+    }
+}
+
+} // namespace simple_tftpd
@@ -0,0 +1,808 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/origin_store.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#ifdef PLATFORM_WINDOWS
+#include <process.h>
+#else
+#include <netdb.h>
+#include <sys/stat.h>
+#endif
+
+namespace simple_tftpd {
+
+namespace {
+
+constexpr size_t HEADER_LIMIT = 16 * 1024;
+constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+struct OriginUrl {
+    std::string host;
+    std::string port = "80";
+    std::string base;  // Path prefix without a trailing '/'
+};
+
+bool parseUrl(const std::string& url, OriginUrl& parsed) {
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        return false;
+    }
+    size_t slash = url.find('/', scheme.size());
+    std::string authority = url.substr(scheme.size(), slash == std::string::npos ? std::string::npos
+                                                                                 : slash - scheme.size());
+    parsed.base = slash == std::string::npos ? std::string() : url.substr(slash);
+    while (!parsed.base.empty() && parsed.base.back() == '/') {
+        parsed.base.pop_back();
+    }
+
+    size_t colon = authority.rfind(':');
+    if (!authority.empty() && authority.front() == '[') {
+        size_t close = authority.find(']');
+        if (close == std::string::npos) {
+            return false;
+        }
+        parsed.host = authority.substr(1, close - 1);
+        colon = authority.size() > close + 1 && authority[close + 1] == ':' ? close + 1 : std::string::npos;
+    } else {
+        parsed.host = authority.substr(0, colon);
+    }
+    if (colon != std::string::npos) {
+        parsed.port = authority.substr(colon + 1);
+        if (parsed.port.empty() || parsed.port.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+    }
+    return !parsed.host.empty();
+}
+
+std::string encodePath(const std::string& name) {
+    static const char* hex = "0123456789ABCDEF";
+    std::string encoded;
+    for (unsigned char c : name) {
+        if (std::isalnum(c) || c == '/' || c == '-' || c == '.' || c == '_' || c == '~') {
+            encoded += static_cast<char>(c);
+        } else {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 0xF];
+        }
+    }
+    return encoded;
+}
+
+// IMF-fixdate (RFC 7231), e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+const char* const MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+const char* const WEEKDAYS[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+    unsigned day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+bool parseHttpDate(const std::string& text, int64_t& seconds) {
+    int day = 0, year = 0, hour = 0, minute = 0, second = 0;
+    char month_name[4] = {0};
+    if (std::sscanf(text.c_str(), "%*3s, %d %3s %d %d:%d:%d GMT", &day, month_name, &year, &hour, &minute,
+                    &second) != 6) {
+        return false;
+    }
+    for (unsigned month = 0; month < 12; ++month) {
+        if (std::strcmp(month_name, MONTHS[month]) == 0) {
+            seconds = daysFromCivil(year, month + 1, static_cast<unsigned>(day)) * 86400 + hour * 3600 +
+                      minute * 60 + second;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string formatHttpDate(int64_t seconds) {
+    int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    int64_t rest = seconds - days * 86400;
+
+    // Inverse of daysFromCivil
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned day_of_era = static_cast<unsigned>(z - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned mp = (5 * day_of_year + 2) / 153;
+    unsigned day = day_of_year - (153 * mp + 2) / 5 + 1;
+    unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    int64_t year = static_cast<int64_t>(year_of_era) + era * 400 + (month <= 2);
+
+    char buffer[40];
+    std::snprintf(buffer, sizeof(buffer), "%s, %02u %s %04lld %02d:%02d:%02d GMT",
+                  WEEKDAYS[((days % 7) + 7) % 7], day, MONTHS[month - 1], static_cast<long long>(year),
+                  static_cast<int>(rest / 3600), static_cast<int>(rest / 60 % 60), static_cast<int>(rest % 60));
+    return buffer;
+}
+
+void closeSocket(socket_t& socket) {
+    if (socket != INVALID_SOCKET_VALUE) {
+        CLOSE_SOCKET(socket);
+        socket = INVALID_SOCKET_VALUE;
+    }
+}
+
+socket_t connectOrigin(const OriginUrl& url, std::chrono::seconds timeout) {
+    struct addrinfo hints {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    if (getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &addresses) != 0) {
+        return INVALID_SOCKET_VALUE;
+    }
+
+    socket_t result = INVALID_SOCKET_VALUE;
+    for (struct addrinfo* address = addresses; address && result == INVALID_SOCKET_VALUE; address = address->ai_next) {
+        socket_t candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (candidate == INVALID_SOCKET_VALUE) {
+            continue;
+        }
+        // Bounds connect, every send and every recv, so a stalled origin
+        // cannot hold a transfer (or shutdown) indefinitely
+#ifdef PLATFORM_WINDOWS
+        DWORD millis = static_cast<DWORD>(timeout.count() * 1000);
+        setsockopt(candidate, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&millis), sizeof(millis));
+        setsockopt(candidate, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&millis), sizeof(millis));
+#else
+        struct timeval tv {};
+        tv.tv_sec = static_cast<time_t>(timeout.count());
+        setsockopt(candidate, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(candidate, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+        if (connect(candidate, address->ai_addr, static_cast<socklen_t>(address->ai_addrlen)) == 0) {
+            result = candidate;
+        } else {
+            closeSocket(candidate);
+        }
+    }
+    freeaddrinfo(addresses);
+    return result;
+}
+
+bool sendAll(socket_t socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        auto count = send(socket, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+        if (count <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t");
+    size_t end = text.find_last_not_of(" \t\r");
+    return start == std::string::npos ? std::string() : text.substr(start, end - start + 1);
+}
+
+int64_t nowSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+/**
+ * @brief HTTP/1.1 response being read from the origin (one request per connection)
+ */
+struct TftpOriginStore::Response {
+    socket_t socket = INVALID_SOCKET_VALUE;
+    int status = 0;
+    std::map<std::string, std::string> headers;  // Lowercase names
+    bool chunked = false;
+    bool has_length = false;
+    uint64_t length = 0;
+
+    std::vector<char> buffer = std::vector<char>(BUFFER_SIZE);
+    size_t begin = 0;
+    size_t end = 0;
+    uint64_t body_read = 0;
+    uint64_t chunk_left = 0;
+    bool body_done = false;
+
+    ~Response() { closeSocket(socket); }
+
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? std::string() : it->second;
+    }
+
+    bool fill() {
+        if (begin == end) {
+            begin = end = 0;
+        } else if (end == buffer.size()) {
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+        auto count = recv(socket, buffer.data() + end, static_cast<int>(buffer.size() - end), 0);
+        if (count <= 0) {
+            return false;
+        }
+        end += static_cast<size_t>(count);
+        return true;
+    }
+
+    bool readLine(std::string& line) {
+        for (;;) {
+            const char* start = buffer.data() + begin;
+            const char* newline = static_cast<const char*>(std::memchr(start, '\n', end - begin));
+            if (newline) {
+                line.assign(start, newline);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                begin += static_cast<size_t>(newline - start) + 1;
+                return true;
+            }
+            if (end - begin >= HEADER_LIMIT || !fill()) {
+                return false;
+            }
+        }
+    }
+
+    bool readHead() {
+        std::string line;
+        if (!readLine(line) || line.compare(0, 5, "HTTP/") != 0) {
+            return false;
+        }
+        size_t space = line.find(' ');
+        if (space == std::string::npos) {
+            return false;
+        }
+        status = std::atoi(line.c_str() + space + 1);
+
+        size_t header_bytes = 0;
+        while (readLine(line) && !line.empty()) {
+            header_bytes += line.size();
+            if (header_bytes > HEADER_LIMIT) {
+                return false;
+            }
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                headers[lowercase(trim(line.substr(0, colon)))] = trim(line.substr(colon + 1));
+            }
+        }
+        if (!line.empty()) {
+            return false;
+        }
+
+        chunked = lowercase(header("transfer-encoding")).find("chunked") != std::string::npos;
+        std::string content_length = header("content-length");
+        if (!chunked && !content_length.empty()) {
+            char* parse_end = nullptr;
+            length = std::strtoull(content_length.c_str(), &parse_end, 10);
+            has_length = parse_end && *parse_end == '\0';
+        }
+        return true;
+    }
+
+    /**
+     * @return Bytes copied, 0 at the end of the body, -1 on a malformed or truncated body
+     */
+    int64_t readBody(uint8_t* out, size_t size) {
+        if (body_done) {
+            return 0;
+        }
+        if (chunked && chunk_left == 0) {
+            std::string line;
+            if (body_read > 0 && (!readLine(line) || !line.empty())) {
+                return -1;  // CRLF closing the previous chunk
+            }
+            if (!readLine(line)) {
+                return -1;
+            }
+            char* parse_end = nullptr;
+            chunk_left = std::strtoull(line.c_str(), &parse_end, 16);
+            if (parse_end == line.c_str()) {
+                return -1;
+            }
+            if (chunk_left == 0) {
+                while (readLine(line) && !line.empty()) {
+                    // Trailers are ignored
+                }
+                body_done = true;
+                return 0;
+            }
+        }
+        uint64_t limit = chunked ? chunk_left : has_length ? length - body_read : UINT64_MAX;
+        if (limit == 0) {
+            body_done = true;
+            return 0;
+        }
+        if (begin == end && !fill()) {
+            if (!chunked && !has_length) {
+                body_done = true;  // Body delimited by the connection closing
+                return 0;
+            }
+            return -1;
+        }
+        size_t count = static_cast<size_t>(std::min<uint64_t>({limit, size, end - begin}));
+        std::memcpy(out, buffer.data() + begin, count);
+        begin += count;
+        body_read += count;
+        if (chunked) {
+            chunk_left -= count;
+        }
+        return static_cast<int64_t>(count);
+    }
+};
+
+TftpOriginFetch::TftpOriginFetch(std::string name, std::chrono::seconds stall_timeout)
+    : name_(std::move(name)),
+      stall_timeout_(stall_timeout),
+      socket_(INVALID_SOCKET_VALUE),
+      received_(0),
+      size_(0),
+      size_known_(false),
+      complete_(false),
+      failed_(false),
+      missing_(false) {}
+
+TftpOriginFetch::~TftpOriginFetch() = default;
+
+bool TftpOriginFetch::waitForSize(uint64_t& size) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    progress_.wait(lock, [this] { return size_known_ || failed_; });
+    size = size_;
+    return size_known_;
+}
+
+int64_t TftpOriginFetch::readAt(uint64_t offset, uint8_t* out, size_t size) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t wanted = offset + size;
+    uint64_t seen = received_;
+    for (;;) {
+        if (failed_) {
+            return -1;
+        }
+        if (received_ >= wanted || complete_) {
+            break;
+        }
+        if (!progress_.wait_for(lock, stall_timeout_, [this, wanted, seen] {
+                return failed_ || complete_ || received_ >= wanted || received_ > seen;
+            })) {
+            return -1;  // No progress for a whole timeout
+        }
+        seen = received_;
+    }
+    uint64_t available = received_;
+    lock.unlock();
+
+    if (offset >= available) {
+        return 0;
+    }
+    size_t count = static_cast<size_t>(std::min<uint64_t>(size, available - offset));
+    return data_.readAt(offset, out, count) == static_cast<int64_t>(count) ? static_cast<int64_t>(count) : -1;
+}
+
+bool TftpOriginFetch::complete() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return complete_;
+}
+
+int64_t TftpOriginReader::read(uint8_t* out, size_t size) {
+    int64_t count = fetch_->readAt(offset_, out, size);
+    if (count > 0) {
+        offset_ += static_cast<uint64_t>(count);
+    }
+    return count;
+}
+
+TftpOriginStore::TftpOriginStore(std::shared_ptr<TftpConfig> config)
+    : config_(std::move(config)),
+      origin_(config_ ? config_->getOriginUrl() : std::string()),
+      stopping_(false),
+      temporary_counter_(0),
+      fetches_(0),
+      joined_(0),
+      revalidations_(0),
+      not_modified_(0),
+      not_found_(0),
+      errors_(0),
+      bytes_fetched_(0) {}
+
+TftpOriginStore::~TftpOriginStore() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopping_ = true;
+    for (auto& entry : in_flight_) {
+        std::lock_guard<std::mutex> fetch_lock(entry.second->mutex_);
+        if (entry.second->socket_ != INVALID_SOCKET_VALUE) {
+#ifdef PLATFORM_WINDOWS
+            shutdown(entry.second->socket_, SD_BOTH);
+#else
+            shutdown(entry.second->socket_, SHUT_RDWR);
+#endif
+        }
+    }
+    idle_.wait(lock, [this] { return in_flight_.empty(); });
+}
+
+void TftpOriginStore::setConfig(std::shared_ptr<TftpConfig> config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = std::move(config);
+    std::string origin = config_ ? config_->getOriginUrl() : std::string();
+    if (origin != origin_) {
+        validators_.clear();
+        origin_ = origin;
+    }
+}
+
+void TftpOriginStore::setStoredCallback(std::function<void(const std::string&)> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stored_callback_ = std::move(callback);
+}
+
+bool TftpOriginStore::isEnabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !origin_.empty();
+}
+
+TftpOriginStore::Result TftpOriginStore::fetch(const std::shared_ptr<const TftpRootHandle>& root,
+                                               const std::string& name,
+                                               std::shared_ptr<const TftpOriginFetch>& fetch) {
+    return request(root, name, false, 0, std::string(), fetch);
+}
+
+TftpOriginStore::Result TftpOriginStore::revalidate(const std::shared_ptr<const TftpRootHandle>& root,
+                                                    const std::string& name, int64_t modified,
+                                                    std::shared_ptr<const TftpOriginFetch>& fetch) {
+    return request(root, name, true, modified, std::string(), fetch);
+}
+
+TftpOriginStore::Result TftpOriginStore::fetchFromPeer(const std::string& peer,
+                                                       const std::shared_ptr<const TftpRootHandle>& root,
+                                                       const std::string& name,
+                                                       std::shared_ptr<const TftpOriginFetch>& fetch) {
+    return request(root, name, false, 0, peer, fetch);
+}
+
+TftpOriginStore::Result TftpOriginStore::request(const std::shared_ptr<const TftpRootHandle>& root,
+                                                 const std::string& name, bool cached, int64_t modified,
+                                                 const std::string& peer,
+                                                 std::shared_ptr<const TftpOriginFetch>& fetch) {
+    std::shared_ptr<TftpConfig> config;
+    std::shared_ptr<TftpOriginFetch> pending;
+    std::string source;
+    Validator validator;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        source = peer.empty() ? origin_ : peer;
+        if (source.empty() || !config_ || stopping_ || !root || !root->isOpen()) {
+            return cached ? Result::FRESH : Result::NOT_FOUND;
+        }
+        config = config_;
+
+        // Single flight: later requests wait for the first one's answer
+        auto running = in_flight_.find(name);
+        if (running != in_flight_.end()) {
+            std::shared_ptr<TftpOriginFetch> shared = running->second;
+            joined_++;
+            lock.unlock();
+            uint64_t size = 0;
+            if (shared->waitForSize(size) || shared->complete()) {
+                fetch = shared;
+                return Result::FETCHING;
+            }
+            std::lock_guard<std::mutex> fetch_lock(shared->mutex_);
+            return cached ? Result::FRESH : shared->missing_ ? Result::NOT_FOUND : Result::FAILED;
+        }
+
+        auto known = validators_.find(name);
+        if (known != validators_.end()) {
+            validator = known->second;
+            if (cached && std::chrono::steady_clock::now() - validator.checked <
+                              std::chrono::seconds(config->getOriginRevalidateInterval())) {
+                return Result::FRESH;
+            }
+        }
+        pending.reset(new TftpOriginFetch(name, std::chrono::seconds(config->getOriginTimeout())));
+        in_flight_[name] = pending;
+    }
+
+    // Answers other than a download end the request for everyone who joined it
+    auto settle = [this, &pending, cached, &name](Result result, bool checked) {
+        {
+            std::lock_guard<std::mutex> fetch_lock(pending->mutex_);
+            pending->failed_ = true;
+            pending->missing_ = result == Result::NOT_FOUND;
+            pending->socket_ = INVALID_SOCKET_VALUE;
+        }
+        pending->progress_.notify_all();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (checked && cached) {
+            validators_[name].checked = std::chrono::steady_clock::now();
+        }
+        in_flight_.erase(name);
+        idle_.notify_all();
+        return result;
+    };
+
+    OriginUrl url;
+    if (!parseUrl(source, url)) {
+        errors_++;
+        return settle(cached ? Result::FRESH : Result::FAILED, false);
+    }
+    if (cached) {
+        revalidations_++;
+    }
+
+    std::unique_ptr<Response> response(new Response());
+    response->socket = connectOrigin(url, std::chrono::seconds(config->getOriginTimeout()));
+    {
+        std::lock_guard<std::mutex> fetch_lock(pending->mutex_);
+        pending->socket_ = response->socket;
+    }
+
+    std::string head = "GET " + url.base + "/" + encodePath(name) + " HTTP/1.1\r\n"
+                       "Host: " + (url.host.find(':') != std::string::npos ? "[" + url.host + "]" : url.host) +
+                       (url.port == "80" ? "" : ":" + url.port) + "\r\n"
+                       "User-Agent: simple-tftpd\r\n"
+                       "Connection: close\r\n";
+    if (cached) {
+        if (!validator.etag.empty()) {
+            head += "If-None-Match: " + validator.etag + "\r\n";
+        }
+        head += "If-Modified-Since: " +
+                (validator.last_modified.empty() ? formatHttpDate(modified / 1000000000) : validator.last_modified) +
+                "\r\n";
+    }
+    head += "\r\n";
+
+    if (response->socket == INVALID_SOCKET_VALUE || !sendAll(response->socket, head) || !response->readHead()) {
+        // Origin down: keep serving what the root has, and ask again next interval
+        errors_++;
+        return settle(cached ? Result::FRESH : Result::FAILED, true);
+    }
+
+    if (response->status == 304 && cached) {
+        not_modified_++;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Validator& stored = validators_[name];
+            if (!response->header("etag").empty()) {
+                stored.etag = response->header("etag");
+            }
+            if (!response->header("last-modified").empty()) {
+                stored.last_modified = response->header("last-modified");
+            }
+        }
+        return settle(Result::FRESH, true);
+    }
+    if (response->status == 404 || response->status == 410) {
+        // Files only the root has are served as they are
+        not_found_++;
+        return settle(cached ? Result::FRESH : Result::NOT_FOUND, true);
+    }
+    if (response->status != 200) {
+        errors_++;
+        return settle(cached ? Result::FRESH : Result::FAILED, true);
+    }
+    if (response->has_length && response->length > config->getMaxFileSize()) {
+        return settle(Result::TOO_LARGE, true);
+    }
+
+    if (!startDownload(root, name, std::move(response), peer.empty(), pending)) {
+        errors_++;
+        return settle(cached ? Result::FRESH : Result::FAILED, false);
+    }
+    fetch = pending;
+    return Result::FETCHING;
+}
+
+bool TftpOriginStore::startDownload(const std::shared_ptr<const TftpRootHandle>& root, const std::string& name,
+                                    std::unique_ptr<Response> response, bool keep,
+                                    std::shared_ptr<TftpOriginFetch>& fetch) {
+    // Hidden name beside the target, so the final rename stays in one
+    // directory; files that are not kept do not create directories
+    size_t slash = name.find_last_of('/');
+    std::string directory = slash == std::string::npos || !keep ? std::string() : name.substr(0, slash + 1);
+    std::string base = slash == std::string::npos ? name : name.substr(slash + 1);
+    uint32_t counter;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        counter = ++temporary_counter_;
+    }
+#ifdef PLATFORM_WINDOWS
+    int pid = _getpid();
+#else
+    int pid = static_cast<int>(getpid());
+#endif
+    std::string temporary = directory + "." + base + "." + std::to_string(pid) + "-" + std::to_string(counter) +
+                            (keep ? ".origin" : ".peer");
+
+    TftpFileHandle file = root->openWrite(temporary);
+    if (!file.isOpen()) {
+        return false;
+    }
+    fetch->data_ = root->openRead(temporary);
+    if (!fetch->data_.isOpen()) {
+        std::error_code error;
+        std::filesystem::remove(root->getRoot() + "/" + temporary, error);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(fetch->mutex_);
+        fetch->size_known_ = response->has_length;
+        fetch->size_ = response->length;
+    }
+    fetch->progress_.notify_all();
+    fetches_++;
+
+    std::thread(&TftpOriginStore::download, this, fetch, root, std::move(response), std::move(file),
+                std::move(temporary), keep)
+        .detach();
+    return true;
+}
+
+void TftpOriginStore::download(std::shared_ptr<TftpOriginFetch> fetch, std::shared_ptr<const TftpRootHandle> root,
+                               std::unique_ptr<Response> response, TftpFileHandle file, std::string temporary,
+                               bool keep) {
+    uint64_t max_size = UINT64_MAX;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (config_) {
+            max_size = config_->getMaxFileSize();
+        }
+    }
+
+    std::vector<uint8_t> chunk(BUFFER_SIZE);
+    bool ok = true;
+    for (;;) {
+        int64_t count = response->readBody(chunk.data(), chunk.size());
+        if (count < 0) {
+            ok = false;
+            break;
+        }
+        if (count == 0) {
+            break;
+        }
+        if (!file.write(chunk.data(), static_cast<size_t>(count))) {
+            ok = false;
+            break;
+        }
+        bytes_fetched_ += static_cast<uint64_t>(count);
+        {
+            std::lock_guard<std::mutex> lock(fetch->mutex_);
+            fetch->received_ += static_cast<uint64_t>(count);
+            if (fetch->received_ > max_size) {
+                ok = false;
+            }
+        }
+        fetch->progress_.notify_all();
+        if (!ok) {
+            break;
+        }
+    }
+    if (ok && response->has_length && response->body_read != response->length) {
+        ok = false;
+    }
+
+    std::string last_modified = response->header("last-modified");
+    std::string etag = response->header("etag");
+    {
+        std::lock_guard<std::mutex> lock(fetch->mutex_);
+        fetch->socket_ = INVALID_SOCKET_VALUE;
+        closeSocket(response->socket);
+    }
+
+    // The origin's Last-Modified becomes the local mtime, so If-Modified-Since
+    // works from the file alone after a restart
+    int64_t origin_time = 0;
+    if (ok && keep && parseHttpDate(last_modified, origin_time)) {
+#ifndef PLATFORM_WINDOWS
+        struct timespec times[2];
+        times[0].tv_sec = static_cast<time_t>(nowSeconds());
+        times[0].tv_nsec = 0;
+        times[1].tv_sec = static_cast<time_t>(origin_time);
+        times[1].tv_nsec = 0;
+        futimens(file.get(), times);
+#endif
+    }
+    file.close();
+
+    std::string temporary_path = root->getRoot() + "/" + temporary;
+    std::string path = root->getRoot() + "/" + fetch->name_;
+    std::error_code error;
+    if (ok && keep) {
+        std::filesystem::rename(temporary_path, path, error);
+        ok = !error;
+    }
+    if (!ok || !keep) {
+        // Readers of a file that is not kept go on through their open handle
+        std::filesystem::remove(temporary_path, error);
+    }
+    if (!ok) {
+        errors_++;
+    }
+
+    std::function<void(const std::string&)> callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (ok && keep) {
+            Validator& validator = validators_[fetch->name_];
+            validator.etag = etag;
+            validator.last_modified = last_modified;
+            validator.checked = std::chrono::steady_clock::now();
+        }
+        callback = stored_callback_;
+    }
+    if (ok && keep && callback) {
+        callback(path);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(fetch->mutex_);
+        if (ok) {
+            fetch->size_ = fetch->received_;
+            fetch->size_known_ = true;
+            fetch->complete_ = true;
+        } else {
+            fetch->failed_ = true;
+        }
+    }
+    fetch->progress_.notify_all();
+    finishDownload(fetch, ok);
+}
+
+void TftpOriginStore::finishDownload(const std::shared_ptr<TftpOriginFetch>& fetch, bool) {
+    // Last use of the store from the download thread; the destructor may run as soon as this unlocks
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = in_flight_.find(fetch->name_);
+    if (it != in_flight_.end() && it->second == fetch) {
+        in_flight_.erase(it);
+    }
+    idle_.notify_all();
+}
+
+TftpOriginStats TftpOriginStore::getStats() const {
+    TftpOriginStats stats;
+    stats.fetches = fetches_.load();
+    stats.joined = joined_.load();
+    stats.revalidations = revalidations_.load();
+    stats.not_modified = not_modified_.load();
+    stats.not_found = not_found_.load();
+    stats.errors = errors_.load();
+    stats.bytes_fetched = bytes_fetched_.load();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.in_flight = in_flight_.size();
+    return stats;
+}
+
+} // namespace simple_tftpd
@@ -15,6 +15,7 @@
  */
 
 #include "simple-tftpd/core/tftp/packet.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
 #include <cstring>
 
 namespace simple_tftpd {
@@ -27,7 +28,9 @@ TftpPacket::TftpPacket(TftpOpcode opcode) : opcode_(opcode) {}
 TftpPacket::TftpPacket(const uint8_t* data, size_t size) : opcode_(TftpOpcode::ERROR) {
     parsed_size_ = size;
     from_raw_data_ = true;
-    parse(data, size);
+    // Only the opcode here: virtual dispatch does not reach subclasses from the
+    // base constructor, so each subclass constructor runs its own parse() once
+    parseOpcode(data, size);
 }
 
 TftpPacket::~TftpPacket() = default;
@@ -82,7 +85,7 @@ std::string TftpPacket::getTypeString() const {
 }
 
 bool TftpPacket::parseOpcode(const uint8_t* data, size_t size) {
-    if (size < 2) {
+    if (!data || size < 2) {
         return false;
     }
     
@@ -136,82 +139,26 @@ bool TftpRequestPacket::parse(const uint8_t* data, size_t size) {
         return false;
     }
     
-    if (size < 4) { // Minimum: opcode(2) + filename(1) + mode(1)
+    TftpRequestView view;
+    if (!TftpCodec::decodeRequest(data, size, view)) {
         return false;
     }
     
-    size_t offset = 2; // Skip opcode
-    
-    // Parse filename (null-terminated string)
-    std::string filename;
-    while (offset < size && data[offset] != 0) {
-        filename += static_cast<char>(data[offset]);
-        offset++;
-    }
-    
-    if (offset >= size || filename.empty()) {
-        return false;
-    }
-    
-    filename_ = filename;
-    offset++; // Skip null terminator
-    
-    // Parse mode (null-terminated string)
-    std::string mode_str;
-    while (offset < size && data[offset] != 0) {
-        mode_str += static_cast<char>(data[offset]);
-        offset++;
-    }
-    
-    if (offset >= size || mode_str.empty()) {
-        return false;
-    }
-    
-    // Convert mode string to enum
-    if (mode_str == "netascii") {
-        mode_ = TftpMode::NETASCII;
-    } else if (mode_str == "octet") {
-        mode_ = TftpMode::OCTET;
-    } else if (mode_str == "mail") {
-        mode_ = TftpMode::MAIL;
-    } else {
-        return false; // Invalid mode
-    }
+    filename_.assign(view.filename);
+    mode_ = view.mode;
     
     // Parse options if present
-    if (offset < size) {
-        parseOptions(data, offset, size);
+    if (!view.options.empty()) {
+        parseOptions(data, static_cast<size_t>(view.options.data - data), size);
     }
     
     return true;
 }
 
 std::vector<uint8_t> TftpRequestPacket::serialize() const {
-    std::vector<uint8_t> result = TftpPacket::serialize();
-    
-    // Add filename
-    result.insert(result.end(), filename_.begin(), filename_.end());
-    result.push_back(0); // null terminator
-    
-    // Add mode string
-    std::string mode_str;
-    switch (mode_) {
-        case TftpMode::NETASCII:
-            mode_str = "netascii";
-            break;
-        case TftpMode::OCTET:
-            mode_str = "octet";
-            break;
-        case TftpMode::MAIL:
-            mode_str = "mail";
-            break;
-    }
-    result.insert(result.end(), mode_str.begin(), mode_str.end());
-    result.push_back(0); // null terminator
-    
-    // Add options if present
-    serializeOptions(result);
-    
+    // opcode + filename + NUL + longest mode ("netascii") + NUL + options
+    std::vector<uint8_t> result(2 + filename_.size() + 1 + 9 + TftpCodec::MAX_OPTIONS_SIZE);
+    result.resize(TftpCodec::encodeRequest(result.data(), result.size(), opcode_, filename_, mode_, options_));
     return result;
 }
 
@@ -224,99 +171,7 @@ std::string TftpRequestPacket::getTypeString() const {
 }
 
 bool TftpRequestPacket::parseOptions(const uint8_t* data, size_t offset, size_t size) {
-    // Reset options to defaults
-    options_ = TftpOptions{};
-    
-    while (offset < size) {
-        // Parse option name (null-terminated string)
-        std::string option_name;
-        while (offset < size && data[offset] != 0) {
-            option_name += static_cast<char>(data[offset]);
-            offset++;
-        }
-        
-        if (offset >= size) {
-            break; // No more data
-        }
-        
-        offset++; // Skip null terminator
-        
-        // Parse option value (null-terminated string)
-        std::string option_value;
-        while (offset < size && data[offset] != 0) {
-            option_value += static_cast<char>(data[offset]);
-            offset++;
-        }
-        
-        if (offset >= size) {
-            break; // No more data
-        }
-        
-        offset++; // Skip null terminator
-        
-        // Process known options
-        if (option_name == "blksize") {
-            try {
-                options_.blksize = static_cast<uint16_t>(std::stoi(option_value));
-                options_.has_blksize = true;
-            } catch (...) {
-                // Invalid blksize value, ignore
-            }
-        } else if (option_name == "timeout") {
-            try {
-                options_.timeout = static_cast<uint16_t>(std::stoi(option_value));
-                options_.has_timeout = true;
-            } catch (...) {
-                // Invalid timeout value, ignore
-            }
-        } else if (option_name == "tsize") {
-            try {
-                options_.tsize = static_cast<uint32_t>(std::stoul(option_value));
-                options_.has_tsize = true;
-            } catch (...) {
-                // Invalid tsize value, ignore
-            }
-        } else if (option_name == "windowsize") {
-            try {
-                options_.windowsize = static_cast<uint16_t>(std::stoi(option_value));
-                options_.has_windowsize = true;
-            } catch (...) {
-                // Invalid windowsize value, ignore
-            }
-        }
-        // Unknown options are ignored
-    }
-    
-    return true;
-}
-
-void TftpRequestPacket::serializeOptions(std::vector<uint8_t>& data) const {
-    auto appendString = [&data](const std::string& value) {
-        data.insert(data.end(), value.begin(), value.end());
-    };
-    
-    auto appendOption = [&](const std::string& key, const std::string& value) {
-        appendString(key);
-        data.push_back(0);
-        appendString(value);
-        data.push_back(0);
-    };
-    
-    if (options_.has_blksize) {
-        appendOption("blksize", std::to_string(options_.blksize));
-    }
-    
-    if (options_.has_timeout) {
-        appendOption("timeout", std::to_string(options_.timeout));
-    }
-    
-    if (options_.has_tsize) {
-        appendOption("tsize", std::to_string(options_.tsize));
-    }
-    
-    if (options_.has_windowsize) {
-        appendOption("windowsize", std::to_string(options_.windowsize));
-    }
+    return TftpCodec::decodeOptions(ByteView(data + offset, size - offset), options_);
 }
 
 // TftpDataPacket implementation
@@ -349,32 +204,20 @@ bool TftpDataPacket::parse(const uint8_t* data, size_t size) {
         return false;
     }
     
-    if (opcode_ != TftpOpcode::DATA) {
-        return false;
-    }
-    
-    if (size < 4) { // Minimum: opcode(2) + block_number(2)
-        return false;
-    }
-    
-    if (!parseBlockNumber(data, 2)) {
+    TftpDataView view;
+    if (!TftpCodec::decodeData(data, size, view)) {
         return false;
     }
     
-    // Extract file data (everything after block number)
-    if (size > 4) {
-        file_data_.assign(data + 4, data + size);
-    } else {
-        file_data_.clear();
-    }
-    
+    block_number_ = view.block;
+    file_data_.assign(view.payload.begin(), view.payload.end());
     return true;
 }
 
 std::vector<uint8_t> TftpDataPacket::serialize() const {
-    std::vector<uint8_t> result = TftpPacket::serialize();
-    serializeBlockNumber(result);
-    result.insert(result.end(), file_data_.begin(), file_data_.end());
+    std::vector<uint8_t> result(TftpCodec::HEADER_SIZE + file_data_.size());
+    TftpCodec::encodeData(result.data(), result.size(), block_number_,
+                          ByteView(file_data_.data(), file_data_.size()));
     return result;
 }
 
@@ -387,20 +230,6 @@ std::string TftpDataPacket::getTypeString() const {
     return "TFTP_DATA";
 }
 
-bool TftpDataPacket::parseBlockNumber(const uint8_t* data, size_t offset) {
-    if (offset + 1 >= 512) { // Basic bounds check
-        return false;
-    }
-    
-    block_number_ = (data[offset] << 8) | data[offset + 1];
-    return true;
-}
-
-void TftpDataPacket::serializeBlockNumber(std::vector<uint8_t>& data) const {
-    data.push_back((block_number_ >> 8) & 0xFF);
-    data.push_back(block_number_ & 0xFF);
-}
-
 // TftpAckPacket implementation
 TftpAckPacket::TftpAckPacket(uint16_t block_number)
     : TftpPacket(TftpOpcode::ACK), block_number_(block_number) {}
@@ -423,20 +252,18 @@ bool TftpAckPacket::parse(const uint8_t* data, size_t size) {
         return false;
     }
     
-    if (opcode_ != TftpOpcode::ACK) {
+    TftpAckView view;
+    if (!TftpCodec::decodeAck(data, size, view)) {
         return false;
     }
     
-    if (size != 4) { // ACK packets are exactly 4 bytes: opcode(2) + block_number(2)
-        return false;
-    }
-    
-    return parseBlockNumber(data, 2);
+    block_number_ = view.block;
+    return true;
 }
 
 std::vector<uint8_t> TftpAckPacket::serialize() const {
-    std::vector<uint8_t> result = TftpPacket::serialize();
-    serializeBlockNumber(result);
+    std::vector<uint8_t> result(TftpCodec::HEADER_SIZE);
+    TftpCodec::encodeAck(result.data(), result.size(), block_number_);
     return result;
 }
 
@@ -449,20 +276,6 @@ std::string TftpAckPacket::getTypeString() const {
     return "TFTP_ACK";
 }
 
-bool TftpAckPacket::parseBlockNumber(const uint8_t* data, size_t offset) {
-    if (offset + 1 >= 4) { // ACK packets are only 4 bytes total
-        return false;
-    }
-    
-    block_number_ = (data[offset] << 8) | data[offset + 1];
-    return true;
-}
-
-void TftpAckPacket::serializeBlockNumber(std::vector<uint8_t>& data) const {
-    data.push_back((block_number_ >> 8) & 0xFF);
-    data.push_back(block_number_ & 0xFF);
-}
-
 // TftpErrorPacket implementation
 TftpErrorPacket::TftpErrorPacket(TftpError error_code, const std::string& error_message)
     : TftpPacket(TftpOpcode::ERROR), error_code_(error_code), error_message_(error_message) {}
@@ -493,34 +306,24 @@ bool TftpErrorPacket::parse(const uint8_t* data, size_t size) {
         return false;
     }
     
-    if (opcode_ != TftpOpcode::ERROR) {
+    TftpErrorView view;
+    if (!TftpCodec::decodeError(data, size, view)) {
         return false;
     }
     
-    if (size < 5) { // Minimum: opcode(2) + error_code(2) + error_message(1)
-        return false;
-    }
-    
-    if (!parseErrorCode(data, 2)) {
+    // Validate error code is within known range
+    if (view.code > static_cast<uint16_t>(TftpError::PLATFORM_ERROR)) {
         return false;
     }
     
-    // Parse error message (null-terminated string)
-    size_t offset = 4;
-    error_message_.clear();
-    while (offset < size && data[offset] != 0) {
-        error_message_ += static_cast<char>(data[offset]);
-        offset++;
-    }
-    
+    error_code_ = static_cast<TftpError>(view.code);
+    error_message_.assign(view.message);
     return true;
 }
 
 std::vector<uint8_t> TftpErrorPacket::serialize() const {
-    std::vector<uint8_t> result = TftpPacket::serialize();
-    serializeErrorCode(result);
-    result.insert(result.end(), error_message_.begin(), error_message_.end());
-    result.push_back(0); // null terminator
+    std::vector<uint8_t> result(TftpCodec::HEADER_SIZE + error_message_.size() + 1);
+    TftpCodec::encodeError(result.data(), result.size(), error_code_, error_message_);
     return result;
 }
 
@@ -532,26 +335,4 @@ std::string TftpErrorPacket::getTypeString() const {
     return "TFTP_ERROR";
 }
 
-bool TftpErrorPacket::parseErrorCode(const uint8_t* data, size_t offset) {
-    if (offset + 1 >= 512) { // Basic bounds check
-        return false;
-    }
-    
-    uint16_t error_code_value = (data[offset] << 8) | data[offset + 1];
-    
-    // Validate error code is within known range
-    if (error_code_value > static_cast<uint16_t>(TftpError::PLATFORM_ERROR)) {
-        return false;
-    }
-    
-    error_code_ = static_cast<TftpError>(error_code_value);
-    return true;
-}
-
-void TftpErrorPacket::serializeErrorCode(std::vector<uint8_t>& data) const {
-    uint16_t error_code_value = static_cast<uint16_t>(error_code_);
-    data.push_back((error_code_value >> 8) & 0xFF);
-    data.push_back(error_code_value & 0xFF);
-}
-
 } // namespace simple_tftpd
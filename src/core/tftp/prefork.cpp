@@ -0,0 +1,353 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/prefork.hpp"
+#include <new>
+#include <thread>
+
+#ifndef PLATFORM_WINDOWS
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
+
+namespace simple_tftpd {
+
+namespace {
+
+enum Field {
+    TRANSFERS,
+    SUCCESSFUL,
+    FAILED,
+    BYTES_SENT,
+    BYTES_RECEIVED,
+    AVERAGE_TIME_MS,
+    CONNECTIONS,
+    ACTIVE,
+    PEAK,
+    FAILED_CONNECTIONS,
+    ERRORS,
+    TIMEOUTS,
+    FIELD_COUNT
+};
+
+constexpr auto QUICK_EXIT = std::chrono::seconds(1);
+
+} // namespace
+
+// One worker's counters; odd sequence numbers mark a publish in progress
+struct TftpPreforkSupervisor::Slot {
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint64_t> values[FIELD_COUNT];
+};
+
+TftpPreforkSupervisor::TftpPreforkSupervisor(size_t workers, std::shared_ptr<Logger> logger)
+    : workers_(workers == 0 ? 1 : workers), logger_(std::move(logger)), slots_(nullptr), slots_size_(0),
+      start_time_(std::chrono::steady_clock::now()), processes_(workers_), stopping_(false), restarts_(0) {}
+
+TftpPreforkSupervisor::~TftpPreforkSupervisor() {
+    stop();
+#ifndef PLATFORM_WINDOWS
+    if (slots_) {
+        munmap(slots_, slots_size_);
+    }
+#endif
+}
+
+bool TftpPreforkSupervisor::start(Worker worker) {
+#ifdef PLATFORM_WINDOWS
+    (void)worker;
+    logEvent(LogLevel::ERROR, "Worker processes are not supported on this platform");
+    return false;
+#else
+    worker_ = std::move(worker);
+    slots_size_ = workers_ * sizeof(Slot);
+    void* page = mmap(nullptr, slots_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        logEvent(LogLevel::ERROR, "Failed to map worker statistics");
+        return false;
+    }
+    slots_ = static_cast<Slot*>(page);
+    for (size_t i = 0; i < workers_; ++i) {
+        new (&slots_[i]) Slot();
+    }
+
+    size_t started = 0;
+    for (size_t i = 0; i < workers_; ++i) {
+        started += spawn(i) ? 1 : 0;
+    }
+    if (started == 0) {
+        return false;
+    }
+    logEvent(LogLevel::INFO, "Started " + std::to_string(started) + " of " + std::to_string(workers_) +
+             " worker processes");
+    return true;
+#endif
+}
+
+void TftpPreforkSupervisor::supervise() {
+#ifndef PLATFORM_WINDOWS
+    auto now = std::chrono::steady_clock::now();
+    std::vector<size_t> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < processes_.size(); ++i) {
+            Process& process = processes_[i];
+            int status = 0;
+            if (process.pid > 0 && waitpid(process.pid, &status, WNOHANG) == process.pid) {
+                reaped(i, status);
+            }
+            if (process.pid == 0 && !stopping_ && now >= process.restart_at) {
+                due.push_back(i);
+            }
+        }
+    }
+    for (size_t index : due) {
+        if (spawn(index)) {
+            restarts_++;
+        }
+    }
+#endif
+}
+
+void TftpPreforkSupervisor::reload() {
+#ifndef PLATFORM_WINDOWS
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& process : processes_) {
+        if (process.pid > 0) {
+            kill(process.pid, SIGHUP);
+        }
+    }
+#endif
+}
+
+void TftpPreforkSupervisor::stop(std::chrono::milliseconds grace) {
+#ifndef PLATFORM_WINDOWS
+    stopping_ = true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& process : processes_) {
+        if (process.pid > 0) {
+            kill(process.pid, SIGTERM);
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + grace;
+    for (;;) {
+        bool running = false;
+        for (size_t i = 0; i < processes_.size(); ++i) {
+            int status = 0;
+            if (processes_[i].pid > 0 && waitpid(processes_[i].pid, &status, WNOHANG) == processes_[i].pid) {
+                reaped(i, status);
+            }
+            running = running || processes_[i].pid > 0;
+        }
+        if (!running) {
+            return;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (size_t i = 0; i < processes_.size(); ++i) {
+        if (processes_[i].pid > 0) {
+            logEvent(LogLevel::WARNING, "Worker " + std::to_string(i) + " did not stop, killing it");
+            kill(processes_[i].pid, SIGKILL);
+            int status = 0;
+            waitpid(processes_[i].pid, &status, 0);
+            reaped(i, status);
+        }
+    }
+#else
+    (void)grace;
+#endif
+}
+
+void TftpPreforkSupervisor::publish(size_t index, const ServerMetrics& metrics) {
+    if (!slots_ || index >= workers_) {
+        return;
+    }
+    uint64_t values[FIELD_COUNT];
+    values[TRANSFERS] = metrics.transfers.total_transfers;
+    values[SUCCESSFUL] = metrics.transfers.successful_transfers;
+    values[FAILED] = metrics.transfers.failed_transfers;
+    values[BYTES_SENT] = metrics.transfers.total_bytes_sent;
+    values[BYTES_RECEIVED] = metrics.transfers.total_bytes_received;
+    values[AVERAGE_TIME_MS] = metrics.transfers.average_transfer_time_ms;
+    values[CONNECTIONS] = metrics.connections.total_connections;
+    values[ACTIVE] = metrics.connections.active_connections;
+    values[PEAK] = metrics.connections.peak_connections;
+    values[FAILED_CONNECTIONS] = metrics.connections.failed_connections;
+    values[ERRORS] = metrics.total_errors;
+    values[TIMEOUTS] = metrics.total_timeouts;
+
+    // Only this worker writes its slot
+    Slot& slot = slots_[index];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < FIELD_COUNT; ++i) {
+        slot.values[i].store(values[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+ServerMetrics TftpPreforkSupervisor::getMetrics() const {
+    Monitoring view;
+    collect(view);
+    return view.getMetrics();
+}
+
+std::string TftpPreforkSupervisor::getMetricsJson() const {
+    Monitoring view;
+    collect(view);
+    return view.getMetricsJson();
+}
+
+std::vector<int> TftpPreforkSupervisor::getWorkerPids() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<int> pids;
+    for (const auto& process : processes_) {
+        pids.push_back(process.pid);
+    }
+    return pids;
+}
+
+bool TftpPreforkSupervisor::spawn(size_t index) {
+#ifndef PLATFORM_WINDOWS
+    if (stopping_) {
+        return false;
+    }
+    int pid = fork();
+    if (pid < 0) {
+        logEvent(LogLevel::ERROR, "Failed to fork worker " + std::to_string(index));
+        std::lock_guard<std::mutex> lock(mutex_);
+        processes_[index].restart_at = std::chrono::steady_clock::now() + QUICK_EXIT;
+        return false;
+    }
+    if (pid == 0) {
+        int code = 1;
+        try {
+            code = worker_(index);
+        } catch (...) {
+        }
+        // Skips the supervisor's atexit handlers and static destructors
+        _exit(code);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    processes_[index].pid = pid;
+    processes_[index].started = std::chrono::steady_clock::now();
+    logEvent(LogLevel::DEBUG, "Worker " + std::to_string(index) + " started as process " + std::to_string(pid));
+    return true;
+#else
+    (void)index;
+    return false;
+#endif
+}
+
+void TftpPreforkSupervisor::reaped(size_t index, int status) {
+#ifndef PLATFORM_WINDOWS
+    Process& process = processes_[index];
+    auto now = std::chrono::steady_clock::now();
+    if (!stopping_) {
+        std::string reason = WIFSIGNALED(status) ? "killed by signal " + std::to_string(WTERMSIG(status))
+                                                 : "exited with status " + std::to_string(WEXITSTATUS(status));
+        logEvent(LogLevel::WARNING, "Worker " + std::to_string(index) + " (process " + std::to_string(process.pid) +
+                 ") " + reason + ", restarting");
+    }
+
+    // Keep what it counted; it no longer has connections
+    ServerMetrics last = readSlot(index);
+    last.connections.active_connections = 0;
+    last.connections.peak_connections = 0;
+    Monitoring total;
+    total.mergeMetrics(retired_);
+    total.mergeMetrics(last);
+    retired_ = total.getMetrics();
+    for (auto& value : slots_[index].values) {
+        value.store(0, std::memory_order_relaxed);
+    }
+
+    process.quick_exits = now - process.started < QUICK_EXIT ? process.quick_exits + 1 : 0;
+    process.restart_at = process.quick_exits > 1 ? now + QUICK_EXIT : now;
+    process.pid = 0;
+#else
+    (void)index;
+    (void)status;
+#endif
+}
+
+ServerMetrics TftpPreforkSupervisor::readSlot(size_t index) const {
+    ServerMetrics metrics;
+    if (!slots_) {
+        return metrics;
+    }
+    const Slot& slot = slots_[index];
+    uint64_t values[FIELD_COUNT] = {};
+    for (int attempt = 0; attempt < 1000; ++attempt) {
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < FIELD_COUNT; ++i) {
+            values[i] = slot.values[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            break;
+        }
+    }
+
+    metrics.transfers.total_transfers = values[TRANSFERS];
+    metrics.transfers.successful_transfers = values[SUCCESSFUL];
+    metrics.transfers.failed_transfers = values[FAILED];
+    metrics.transfers.total_bytes_sent = values[BYTES_SENT];
+    metrics.transfers.total_bytes_received = values[BYTES_RECEIVED];
+    metrics.transfers.average_transfer_time_ms = values[AVERAGE_TIME_MS];
+    metrics.connections.total_connections = values[CONNECTIONS];
+    metrics.connections.active_connections = values[ACTIVE];
+    metrics.connections.peak_connections = values[PEAK];
+    metrics.connections.failed_connections = values[FAILED_CONNECTIONS];
+    metrics.total_errors = values[ERRORS];
+    metrics.total_timeouts = values[TIMEOUTS];
+    return metrics;
+}
+
+void TftpPreforkSupervisor::collect(Monitoring& view) const {
+    // Uptime is the supervisor's
+    ServerMetrics base;
+    base.server_start_time = start_time_;
+    view.mergeMetrics(base);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    view.mergeMetrics(retired_);
+    for (size_t i = 0; i < workers_; ++i) {
+        if (processes_[i].pid > 0) {
+            view.mergeMetrics(readSlot(i));
+        }
+    }
+}
+
+void TftpPreforkSupervisor::logEvent(LogLevel level, const std::string& message) const {
+    if (logger_) {
+        logger_->log(level, "[Prefork] " + message);
+    }
+}
+
+} // namespace simple_tftpd
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/receive_window.hpp"
+#include <algorithm>
+
+namespace simple_tftpd {
+
+void TftpReceiveWindow::reset(uint16_t capacity) {
+    capacity_ = std::max<uint32_t>(capacity, 1);
+    for (Slot& slot : slots_) {
+        slot.held = false;
+    }
+    count_ = 0;
+}
+
+bool TftpReceiveWindow::store(uint16_t block, ByteView payload) {
+    // Most transfers never reorder, so the slots are only allocated when one does
+    if (slots_.size() < capacity_) {
+        size_t slots = 1;
+        while (slots < capacity_) {
+            slots <<= 1;
+        }
+        slots_.assign(slots, Slot());
+        mask_ = static_cast<uint16_t>(slots - 1);
+    }
+
+    Slot& slot = slots_[block & mask_];
+    if (slot.held) {
+        return false;
+    }
+    slot.payload.assign(payload.begin(), payload.end());
+    slot.block = block;
+    slot.held = true;
+    ++count_;
+    return true;
+}
+
+const std::vector<uint8_t>* TftpReceiveWindow::find(uint16_t block) const {
+    if (count_ == 0) {
+        return nullptr;
+    }
+    const Slot& slot = slots_[block & mask_];
+    return slot.held && slot.block == block ? &slot.payload : nullptr;
+}
+
+void TftpReceiveWindow::release(uint16_t block) {
+    if (count_ == 0) {
+        return;
+    }
+    Slot& slot = slots_[block & mask_];
+    if (slot.held && slot.block == block) {
+        slot.held = false;
+        --count_;
+    }
+}
+
+} // namespace simple_tftpd
@@ -0,0 +1,532 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include <algorithm>
+#include <deque>
+#include <filesystem>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#ifdef PLATFORM_LINUX
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#endif
+
+namespace simple_tftpd {
+
+namespace {
+
+// Same bound the kernel puts on symlinks in one lookup
+constexpr int SYMLINK_LIMIT = 40;
+
+#ifdef PLATFORM_WINDOWS
+constexpr int READ_FLAGS = _O_RDONLY | _O_BINARY;
+constexpr int WRITE_FLAGS = _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY;
+constexpr int CREATE_FLAGS = _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY;
+#else
+constexpr int READ_FLAGS = O_RDONLY | O_CLOEXEC;
+constexpr int WRITE_FLAGS = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+// O_EXCL also refuses a symlink in the last component, dangling or not
+constexpr int CREATE_FLAGS = O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC;
+#ifdef O_PATH
+constexpr int DIRECTORY_FLAGS = O_PATH | O_DIRECTORY | O_CLOEXEC;
+constexpr int STAT_FLAGS = O_PATH | O_CLOEXEC;
+#else
+constexpr int DIRECTORY_FLAGS = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+// Without O_PATH the file is opened; O_NONBLOCK keeps a FIFO from blocking
+constexpr int STAT_FLAGS = O_RDONLY | O_NONBLOCK | O_CLOEXEC;
+#endif
+#endif
+
+#ifdef PLATFORM_WINDOWS
+using StatBuffer = struct _stat64;
+#else
+using StatBuffer = struct stat;
+#endif
+
+void describe(const StatBuffer& st, TftpFileMetadata& metadata) {
+    metadata = TftpFileMetadata();
+    metadata.size = static_cast<uint64_t>(st.st_size);
+#ifdef PLATFORM_WINDOWS
+    metadata.regular = (st.st_mode & _S_IFMT) == _S_IFREG;
+    metadata.modified = static_cast<int64_t>(st.st_mtime) * 1000000000LL;
+#else
+    metadata.regular = S_ISREG(st.st_mode);
+#ifdef PLATFORM_LINUX
+    metadata.modified = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    metadata.modified = static_cast<int64_t>(st.st_mtime) * 1000000000LL;
+#endif
+#endif
+    metadata.inode = static_cast<uint64_t>(st.st_ino);
+    metadata.device = static_cast<uint64_t>(st.st_dev);
+    metadata.permissions = static_cast<uint32_t>(st.st_mode) & 07777;
+}
+
+std::string normalizeDirectory(const std::string& path) {
+    std::string normal = std::filesystem::path(path).lexically_normal().generic_string();
+    while (normal.size() > 1 && normal.back() == '/') {
+        normal.pop_back();
+    }
+    return normal;
+}
+
+void splitComponents(const std::string& path, std::deque<std::string>& out, bool front) {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > start) {
+            parts.push_back(path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    if (front) {
+        out.insert(out.begin(), parts.begin(), parts.end());
+    } else {
+        out.insert(out.end(), parts.begin(), parts.end());
+    }
+}
+
+} // namespace
+
+TftpFileHandle::~TftpFileHandle() {
+    close();
+}
+
+TftpFileHandle::TftpFileHandle(TftpFileHandle&& other) noexcept : fd_(other.fd_) {
+    other.fd_ = -1;
+}
+
+TftpFileHandle& TftpFileHandle::operator=(TftpFileHandle&& other) noexcept {
+    if (this != &other) {
+        close();
+        fd_ = other.fd_;
+        other.fd_ = -1;
+    }
+    return *this;
+}
+
+TftpFileHandle TftpFileHandle::openPath(const std::string& path) {
+#ifdef PLATFORM_WINDOWS
+    return TftpFileHandle(_open(path.c_str(), READ_FLAGS));
+#else
+    return TftpFileHandle(::open(path.c_str(), READ_FLAGS));
+#endif
+}
+
+void TftpFileHandle::close() {
+    if (fd_ >= 0) {
+#ifdef PLATFORM_WINDOWS
+        _close(fd_);
+#else
+        ::close(fd_);
+#endif
+        fd_ = -1;
+    }
+}
+
+int64_t TftpFileHandle::read(void* buffer, size_t size) {
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t total = 0;
+    while (total < size) {
+#ifdef PLATFORM_WINDOWS
+        int count = _read(fd_, out + total, static_cast<unsigned int>(std::min<size_t>(size - total, 1 << 30)));
+#else
+        ssize_t count = ::read(fd_, out + total, size - total);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (count < 0) {
+            return -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        total += static_cast<size_t>(count);
+    }
+    return static_cast<int64_t>(total);
+}
+
+int64_t TftpFileHandle::readAt(uint64_t offset, void* buffer, size_t size) const {
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t total = 0;
+    while (total < size) {
+#ifdef PLATFORM_WINDOWS
+        // No positional read on CRT descriptors; sessions own their handle
+        if (_lseeki64(fd_, static_cast<__int64>(offset + total), SEEK_SET) < 0) {
+            return -1;
+        }
+        int count = _read(fd_, out + total, static_cast<unsigned int>(std::min<size_t>(size - total, 1 << 30)));
+#else
+        ssize_t count = ::pread(fd_, out + total, size - total, static_cast<off_t>(offset + total));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (count < 0) {
+            return -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        total += static_cast<size_t>(count);
+    }
+    return static_cast<int64_t>(total);
+}
+
+bool TftpFileHandle::write(const void* data, size_t size) {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    size_t total = 0;
+    while (total < size) {
+#ifdef PLATFORM_WINDOWS
+        int count = _write(fd_, in + total, static_cast<unsigned int>(std::min<size_t>(size - total, 1 << 30)));
+#else
+        ssize_t count = ::write(fd_, in + total, size - total);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (count <= 0) {
+            return false;
+        }
+        total += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool TftpFileHandle::rewind() {
+#ifdef PLATFORM_WINDOWS
+    return _lseeki64(fd_, 0, SEEK_SET) == 0;
+#else
+    return ::lseek(fd_, 0, SEEK_SET) == 0;
+#endif
+}
+
+bool TftpFileHandle::stat(TftpFileMetadata& metadata) const {
+    StatBuffer st;
+#ifdef PLATFORM_WINDOWS
+    if (_fstat64(fd_, &st) != 0) {
+#else
+    if (::fstat(fd_, &st) != 0) {
+#endif
+        return false;
+    }
+    describe(st, metadata);
+    return true;
+}
+
+TftpRootHandle::TftpRootHandle(Resolution resolution) : resolution_(resolution), kernel_(false) {
+}
+
+TftpRootHandle::~TftpRootHandle() = default;
+
+bool TftpRootHandle::open(const std::string& root, const std::vector<std::string>& allowed_directories) {
+    anchors_.clear();
+    rejected_.clear();
+    kernel_ = false;
+    root_ = root;
+
+#ifdef PLATFORM_WINDOWS
+    (void)allowed_directories;
+    std::error_code ec;
+    if (!std::filesystem::is_directory(root, ec)) {
+        return false;
+    }
+    anchors_.push_back(Anchor{std::string(), TftpFileHandle()});
+    return true;
+#else
+    Anchor base{std::string(), TftpFileHandle(::open(root.c_str(), DIRECTORY_FLAGS))};
+    if (!base.directory.isOpen()) {
+        return false;
+    }
+
+#ifdef PLATFORM_LINUX
+    // Probe once per handle; old kernels answer ENOSYS and some seccomp
+    // profiles EPERM, both of which leave the userspace walk in charge
+    if (resolution_ == Resolution::AUTO) {
+        struct open_how how {};
+        how.flags = static_cast<uint64_t>(DIRECTORY_FLAGS);
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        long fd = syscall(SYS_openat2, base.directory.get(), ".", &how, sizeof(how));
+        if (fd >= 0) {
+            ::close(static_cast<int>(fd));
+            kernel_ = true;
+        }
+    }
+#endif
+
+    std::string normal_root = normalizeDirectory(root);
+    std::string root_prefix = normal_root == "/" ? normal_root : normal_root + "/";
+    for (const auto& directory : allowed_directories) {
+        std::string normal = normalizeDirectory(directory);
+        if (normal == normal_root || normal.compare(0, root_prefix.size(), root_prefix) != 0) {
+            continue;
+        }
+        std::string relative = normal.substr(root_prefix.size());
+        bool duplicate = std::any_of(anchors_.begin(), anchors_.end(),
+                                     [&relative](const Anchor& anchor) { return anchor.prefix == relative + "/"; });
+        if (duplicate) {
+            continue;
+        }
+        TftpFileHandle handle(openBeneath(base.directory.get(), relative, DIRECTORY_FLAGS));
+        if (!handle.isOpen()) {
+            rejected_.push_back(directory);
+            continue;
+        }
+        anchors_.push_back(Anchor{relative + "/", std::move(handle)});
+    }
+
+    std::sort(anchors_.begin(), anchors_.end(),
+              [](const Anchor& a, const Anchor& b) { return a.prefix.size() > b.prefix.size(); });
+    anchors_.push_back(std::move(base));
+    return true;
+#endif
+}
+
+TftpFileHandle TftpRootHandle::openRead(const std::string& relative) const {
+    return openFile(relative, READ_FLAGS, false);
+}
+
+TftpFileHandle TftpRootHandle::openWrite(const std::string& relative) const {
+    return openFile(relative, WRITE_FLAGS, true);
+}
+
+TftpFileHandle TftpRootHandle::openCreate(const std::string& relative) const {
+    return openFile(relative, CREATE_FLAGS, true);
+}
+
+bool TftpRootHandle::stat(const std::string& relative, TftpFileMetadata& metadata) const {
+#ifdef PLATFORM_WINDOWS
+    // Directories cannot be opened through the CRT, so go by path
+    size_t skip = relative.find_first_not_of('/');
+    std::string path = root_ + "/" + (skip == std::string::npos ? std::string() : relative.substr(skip));
+    StatBuffer st;
+    if (anchors_.empty() || _stat64(path.c_str(), &st) != 0) {
+        return false;
+    }
+    describe(st, metadata);
+    return true;
+#else
+    // Resolved exactly like a read, so nothing outside the root is described
+    TftpFileHandle file = openFile(relative, STAT_FLAGS, false);
+    return file.isOpen() && file.stat(metadata);
+#endif
+}
+
+const TftpRootHandle::Anchor& TftpRootHandle::anchorFor(const std::string& relative, std::string& remainder) const {
+    for (const auto& anchor : anchors_) {
+        if (relative.compare(0, anchor.prefix.size(), anchor.prefix) == 0) {
+            remainder = relative.substr(anchor.prefix.size());
+            return anchor;
+        }
+    }
+    remainder = relative;
+    return anchors_.back();
+}
+
+TftpFileHandle TftpRootHandle::openFile(const std::string& relative, int flags, bool create_parents) const {
+    if (anchors_.empty()) {
+        errno = EBADF;
+        return TftpFileHandle();
+    }
+
+    // Requests may lead with separators; they are still below the root
+    size_t skip = relative.find_first_not_of('/');
+    std::string name = skip == std::string::npos ? std::string() : relative.substr(skip);
+
+#ifdef PLATFORM_WINDOWS
+    std::string path = root_ + "/" + name;
+    int fd = _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+    if (fd < 0 && errno == ENOENT && create_parents) {
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+        fd = _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+    }
+    return TftpFileHandle(fd);
+#else
+    std::string remainder;
+    const Anchor& anchor = anchorFor(name, remainder);
+    int fd = openBeneath(anchor.directory.get(), remainder, flags);
+    if (fd < 0 && errno == ENOENT && create_parents && createParents(anchor.directory.get(), remainder)) {
+        fd = openBeneath(anchor.directory.get(), remainder, flags);
+    }
+    return TftpFileHandle(fd);
+#endif
+}
+
+#ifdef PLATFORM_WINDOWS
+
+int TftpRootHandle::openBeneath(int, const std::string&, int) const {
+    errno = ENOSYS;
+    return -1;
+}
+
+int TftpRootHandle::walkBeneath(int, const std::string&, int) const {
+    errno = ENOSYS;
+    return -1;
+}
+
+bool TftpRootHandle::createParents(int, const std::string&) const {
+    return false;
+}
+
+#else
+
+int TftpRootHandle::openBeneath(int directory, const std::string& path, int flags) const {
+    if (path.empty()) {
+        if (flags & O_CREAT) {
+            errno = EISDIR;
+            return -1;
+        }
+        return ::openat(directory, ".", flags);
+    }
+
+#ifdef PLATFORM_LINUX
+    if (kernel_) {
+        struct open_how how {};
+        how.flags = static_cast<uint64_t>(flags);
+        how.mode = (flags & O_CREAT) ? 0666 : 0;
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        long fd;
+        do {
+            fd = syscall(SYS_openat2, directory, path.c_str(), &how, sizeof(how));
+        } while (fd < 0 && (errno == EINTR || errno == EAGAIN));
+        return static_cast<int>(fd);
+    }
+#endif
+    return walkBeneath(directory, path, flags);
+}
+
+int TftpRootHandle::walkBeneath(int directory, const std::string& path, int flags) const {
+    std::deque<std::string> components;
+    splitComponents(path, components, false);
+    if (!path.empty() && path.front() == '/') {
+        errno = EXDEV;
+        return -1;
+    }
+
+    // Directories entered so far; empty means the anchor itself
+    std::vector<TftpFileHandle> stack;
+    int symlinks = 0;
+
+    while (!components.empty()) {
+        std::string name = std::move(components.front());
+        components.pop_front();
+        if (name == ".") {
+            continue;
+        }
+        if (name == "..") {
+            if (stack.empty()) {
+                errno = EXDEV;
+                return -1;
+            }
+            stack.pop_back();
+            continue;
+        }
+
+        int parent = stack.empty() ? directory : stack.back().get();
+        bool last = components.empty();
+        int fd = last ? ::openat(parent, name.c_str(), flags | O_NOFOLLOW, 0666)
+                      : ::openat(parent, name.c_str(), DIRECTORY_FLAGS | O_NOFOLLOW);
+#ifdef O_PATH
+        // O_PATH with O_NOFOLLOW opens a symlink itself instead of refusing it
+        struct stat link;
+        if (fd >= 0 && last && (flags & O_PATH) && ::fstat(fd, &link) == 0 && S_ISLNK(link.st_mode)) {
+            ::close(fd);
+            fd = -1;
+            errno = ELOOP;
+        }
+#endif
+        if (fd >= 0) {
+            if (last) {
+                return fd;
+            }
+            stack.emplace_back(fd);
+            continue;
+        }
+
+        // A symlink refuses O_NOFOLLOW; expand it in place of the component
+        int error = errno;
+        if (error != ELOOP && error != ENOTDIR && error != EMLINK) {
+            return -1;
+        }
+        char target[4096];
+        ssize_t length = ::readlinkat(parent, name.c_str(), target, sizeof(target));
+        if (length < 0 || static_cast<size_t>(length) >= sizeof(target)) {
+            errno = error;
+            return -1;
+        }
+        if (++symlinks > SYMLINK_LIMIT) {
+            errno = ELOOP;
+            return -1;
+        }
+        if (target[0] == '/') {
+            errno = EXDEV;
+            return -1;
+        }
+        size_t before = components.size();
+        splitComponents(std::string(target, static_cast<size_t>(length)), components, true);
+        if (components.size() == before) {
+            errno = ENOENT;
+            return -1;
+        }
+    }
+
+    // The path named a directory already entered (or the anchor)
+    if (flags & O_CREAT) {
+        errno = EISDIR;
+        return -1;
+    }
+    return ::openat(stack.empty() ? directory : stack.back().get(), ".", flags);
+}
+
+bool TftpRootHandle::createParents(int directory, const std::string& path) const {
+    size_t slash = path.find('/');
+    while (slash != std::string::npos) {
+        // Each level is created inside a parent opened under the same rules,
+        // so a symlink planted mid-path cannot redirect the mkdir
+        size_t start = path.find_last_of('/', slash == 0 ? 0 : slash - 1);
+        start = start == std::string::npos ? 0 : start + 1;
+        std::string parent_path = path.substr(0, start);
+        std::string name = path.substr(start, slash - start);
+        if (!name.empty() && name != "." && name != "..") {
+            TftpFileHandle parent(openBeneath(directory, parent_path, DIRECTORY_FLAGS));
+            if (!parent.isOpen()) {
+                return false;
+            }
+            if (::mkdirat(parent.get(), name.c_str(), 0777) != 0 && errno != EEXIST) {
+                return false;
+            }
+        }
+        slash = path.find('/', slash + 1);
+    }
+    return true;
+}
+
+#endif
+
+} // namespace simple_tftpd
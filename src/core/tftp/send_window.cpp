@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/send_window.hpp"
+#include <algorithm>
+
+namespace simple_tftpd {
+
+void TftpSendWindow::reset(uint16_t capacity, uint16_t first_block) {
+    capacity_ = std::max<uint32_t>(capacity, 1);
+    size_t slots = 1;
+    while (slots < capacity_) {
+        slots <<= 1;
+    }
+    // A new transfer at the same size keeps the payload buffers
+    if (slots_.size() != slots) {
+        slots_.assign(slots, TftpInFlightBlock());
+    }
+    mask_ = static_cast<uint16_t>(slots - 1);
+    base_ = first_block;
+    count_ = 0;
+}
+
+void TftpSendWindow::push() {
+    const TftpInFlightBlock& block = next();
+    if (count_ == 0 || block.last_sent < oldest_sent_) {
+        oldest_sent_ = block.last_sent;
+    }
+    ++count_;
+}
+
+TftpWindowAck TftpSendWindow::acknowledge(uint16_t block) {
+    TftpWindowAck ack;
+    uint16_t offset = static_cast<uint16_t>(block - base_);
+    if (offset >= count_) {
+        return ack;
+    }
+
+    ack.blocks = static_cast<size_t>(offset) + 1;
+    for (size_t i = 0; i < ack.blocks; ++i) {
+        TftpInFlightBlock& released = at(i);
+        ack.bytes += released.payload_size;
+        ack.final = ack.final || released.is_final;
+        released.frame = ByteView();
+    }
+    base_ = static_cast<uint16_t>(block + 1);
+    count_ -= static_cast<uint32_t>(ack.blocks);
+    // oldest_sent_ stays a lower bound; the next timer scan tightens it
+    return ack;
+}
+
+TftpInFlightBlock* TftpSendWindow::find(uint16_t block) {
+    uint16_t offset = static_cast<uint16_t>(block - base_);
+    return offset < count_ ? &at(offset) : nullptr;
+}
+
+void TftpSendWindow::refreshOldest() {
+    if (count_ == 0) {
+        return;
+    }
+    oldest_sent_ = at(0).last_sent;
+    for (size_t i = 1; i < count_; ++i) {
+        oldest_sent_ = std::min(oldest_sent_, at(i).last_sent);
+    }
+}
+
+} // namespace simple_tftpd
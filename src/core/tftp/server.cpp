@@ -16,16 +16,29 @@
 
 #include "simple-tftpd/core/tftp/server.hpp"
 #include "simple-tftpd/core/tftp/monitoring.hpp"
+#include "simple-tftpd/core/tftp/udp_gso.hpp"
 #include "simple-tftpd/production/security/manager.hpp"
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <cstring>
+#include <cstdio>
+#include <iomanip>
+#include <algorithm>
 
 namespace simple_tftpd {
 
+namespace {
+
+// Datagrams taken from the socket per receive call
+constexpr size_t LISTENER_BATCH_SIZE = 16;
+
+} // namespace
+
 TftpServer::TftpServer(std::shared_ptr<TftpConfig> config, std::shared_ptr<Logger> logger)
     : config_(config),
       logger_(logger),
+      access_policy_(config->getAccessPolicy()),
       running_(false),
       shutdown_requested_(false),
       server_socket_(INVALID_SOCKET_VALUE),
@@ -33,9 +46,40 @@ TftpServer::TftpServer(std::shared_ptr<TftpConfig> config, std::shared_ptr<Logge
       listen_port_(config->getListenPort()),
       ipv6_enabled_(config->isIpv6Enabled()),
       config_file_path_(""),
-      monitoring_(std::make_unique<Monitoring>()) {
+      listener_packets_(0),
+      listener_batches_(0),
+      listener_acks_coalesced_(0),
+      listener_table_waits_(0),
+      listener_table_wait_ns_(0),
+      listener_max_table_wait_ns_(0),
+      reclaimed_connections_(0),
+      sent_datagrams_(0),
+      send_calls_(0),
+      gso_sends_(0),
+      gso_fallbacks_(0),
+      gso_enabled_(false),
+      monitoring_(std::make_unique<Monitoring>()),
+      multicast_manager_(std::make_unique<TftpMulticastManager>(config, logger)),
+      block_cache_(std::make_unique<TftpBlockCache>(config->getBlockCacheSize())),
+      netascii_cache_(std::make_unique<TftpNetasciiCache>(config->getNetasciiCacheSize())),
+      compressed_store_(std::make_unique<TftpCompressedStore>(config)),
+      directory_watcher_(std::make_unique<TftpDirectoryWatcher>()),
+      negative_cache_(std::make_unique<TftpNegativeCache>(
+          config->getNegativeCacheEntries(), std::chrono::seconds(config->getNegativeCacheTtl()),
+          directory_watcher_.get())),
+      metadata_cache_(std::make_unique<TftpMetadataCache>(config->getMetadataCacheEntries(),
+                                                          directory_watcher_.get())),
+      filename_index_(std::make_unique<TftpFilenameIndex>(directory_watcher_.get())),
+      origin_store_(std::make_unique<TftpOriginStore>(config)),
+      cluster_(std::make_unique<TftpCluster>(config, logger, *origin_store_)),
+      setup_pool_(std::make_unique<TftpSetupPool>(config->getSetupThreads(), config->getSetupQueueLimit())) {
 
     stats_.start_time = std::chrono::steady_clock::now();
+    // Do not wait for the change notification to serve a freshly stored file
+    origin_store_->setStoredCallback([this](const std::string& path) {
+        negative_cache_->invalidate(path);
+        metadata_cache_->invalidate(path);
+    });
 }
 
 TftpServer::~TftpServer() {
@@ -76,8 +120,37 @@ bool TftpServer::start() {
         return false;
     }
 
+    gso_enabled_.store(config_->isUdpGsoEnabled() && isUdpGsoSupported(server_socket_));
+    if (gso_enabled_.load()) {
+        logEvent(LogLevel::INFO, "Sending windowed reads with UDP GSO");
+    } else if (config_->isUdpGsoEnabled()) {
+        logEvent(LogLevel::WARNING, "UDP GSO is not supported by this system; sending datagrams one at a time");
+    }
+
+    // Peers ask for files by name, so the listener reads the root current at each request
+    if (!cluster_->start([this] { return getRootHandle(); })) {
+        logEvent(LogLevel::ERROR, "Failed to start cluster peer listener");
+        closeSocket();
+        return false;
+    }
+
     running_.store(true);
 
+    if (!directory_watcher_->start()) {
+        logEvent(LogLevel::INFO, "Directory change notifications unavailable; negative cache entries expire by TTL only and file metadata is not cached");
+    }
+    if (config_->isCaseInsensitive()) {
+        buildFilenameIndex(config_->getRootDirectory());
+    }
+    reportRemapRules(*config_);
+    root_handle_.store(openRootHandle(*config_));
+    if (!config_->getOriginUrl().empty()) {
+        logEvent(LogLevel::INFO, "Fetching files missing from the root from origin " + config_->getOriginUrl());
+    }
+
+    // Requests are set up on the pool so a slow open never stalls the listener
+    setup_pool_->start();
+
     // Start listener thread
     listener_thread_ = std::thread(&TftpServer::listenerThread, this);
 
@@ -111,9 +184,20 @@ void TftpServer::stop() {
     if (cleanup_thread_.joinable()) {
         cleanup_thread_.join();
     }
+    // Requests still queued are dropped; closeAllConnections() ends their connections
+    setup_pool_->stop();
+    cluster_->stop();
+
+    // Without notifications remembered misses and metadata could go stale
+    directory_watcher_->stop();
+    negative_cache_->clear();
+    metadata_cache_->clear();
+    filename_index_->clear();
 
     // Close all connections
     closeAllConnections();
+    multicast_manager_->stopAll();
+    writeConnectionsSnapshot();
 
     logEvent(LogLevel::INFO, "TFTP server stopped");
 }
@@ -130,6 +214,75 @@ std::string TftpServer::getStatus() const {
     ss << "  Listen Port: " << listen_port_ << std::endl;
     ss << "  IPv6 Enabled: " << (ipv6_enabled_ ? "Yes" : "No") << std::endl;
     ss << "  Active Connections: " << getActiveConnectionCount() << std::endl;
+    ss << "  Multicast Sessions: " << getMulticastSessionCount() << std::endl;
+    TftpBlockCacheStats cache = getBlockCacheStats();
+    ss << "  Block Cache: " << cache.entries << " files, " << cache.bytes_used << "/" << cache.capacity
+       << " bytes, " << std::fixed << std::setprecision(1) << cache.hitRatio() * 100.0
+       << "% of blocks served from cache" << std::endl;
+    TftpCacheStats netascii = getNetasciiCacheStats();
+    ss << "  Netascii Cache: " << netascii.entries << " files, " << netascii.bytes_used << "/"
+       << netascii.capacity << " bytes, " << netascii.hits << " hits, " << netascii.misses << " conversions"
+       << std::endl;
+    TftpCompressionStats compression = getCompressionStats();
+    ss << "  Compressed Store: " << compression.files_opened << " files, " << compression.compressed_bytes_read
+       << " bytes read for " << compression.bytes_decompressed << " served (" << compression.bytesSaved()
+       << " saved), " << compression.decompress_time_us / 1000 << " ms decoding" << std::endl;
+    TftpNegativeCacheStats negative = getNegativeCacheStats();
+    ss << "  Negative Cache: " << negative.entries << " paths, " << std::fixed << std::setprecision(1)
+       << negative.hitRatio() * 100.0 << "% of lookups answered, " << negative.syscalls_saved
+       << " filesystem calls saved" << std::endl;
+    TftpMetadataCacheStats metadata = getMetadataCacheStats();
+    ss << "  Metadata Cache: " << metadata.entries << " files, " << std::fixed << std::setprecision(1)
+       << metadata.hitRatio() * 100.0 << "% of lookups answered, " << metadata.stat_calls << " stat calls, "
+       << metadata.file_opens << " file opens" << std::endl;
+    if (origin_store_->isEnabled()) {
+        TftpOriginStats origin = getOriginStats();
+        ss << "  Origin: " << origin.fetches << " downloads (" << origin.joined << " joined, " << origin.in_flight
+           << " running), " << origin.not_modified << "/" << origin.revalidations << " revalidations unchanged, "
+           << origin.bytes_fetched << " bytes fetched, " << origin.errors << " errors" << std::endl;
+    }
+    if (cluster_->isEnabled()) {
+        TftpClusterStats cluster = getClusterStats();
+        ss << "  Cluster: " << config_->getClusterNodes().size() << " nodes, " << cluster.peer_fetches
+           << " files streamed from owners (" << cluster.peer_failures << " owner failures), "
+           << cluster.requests_served << " peer requests served (" << cluster.bytes_served << " bytes)"
+           << std::endl;
+    }
+    if (shared_cache_) {
+        TftpSharedCacheStats shared = shared_cache_->getStats();
+        ss << "  Shared Cache: " << shared.capacity << " bytes in " << shared.chunks << " chunks for "
+           << config_->getWorkers() << " workers, " << shared.hits << "/" << (shared.hits + shared.misses)
+           << " reads answered, " << shared.evictions << " evictions" << std::endl;
+    }
+    TftpListenerStats listener = getListenerStats();
+    ss << "  Listener: " << listener.packets << " packets in " << listener.batches << " batches, "
+       << listener.acks_coalesced << " ACKs coalesced, waited " << listener.table_waits
+       << " times for the connection table (max " << listener.max_table_wait_ns / 1000 << " us, total "
+       << listener.table_wait_ns / 1000 << " us), " << listener.reclaimed << " connections reclaimed" << std::endl;
+    TftpSendStats send = getSendStats();
+    ss << "  Send: " << send.datagrams << " datagrams in " << send.calls << " calls";
+    if (send.gso_enabled || send.gso_sends > 0) {
+        ss << " (UDP GSO " << (send.gso_enabled ? "on" : "off") << ", " << send.gso_sends << " segmented sends, "
+           << send.gso_fallbacks << " fallbacks)";
+    }
+    ss << std::endl;
+    if (config_->getSetupThreads() > 0) {
+        TftpSetupPoolStats setup = getSetupPoolStats();
+        ss << "  Setup Pool: " << setup.threads << " threads, " << setup.queued << " queued (peak "
+           << setup.peak_queued << "), " << setup.completed << " requests set up, " << setup.rejected
+           << " refused as busy" << std::endl;
+    }
+    std::shared_ptr<const TftpRootHandle> root = getRootHandle();
+    if (root) {
+        ss << "  Root Handle: " << root->anchorCount() << " directories held open, "
+           << (root->usesKernelResolution() ? "openat2" : "userspace") << " path resolution" << std::endl;
+    }
+    if (config_->isCaseInsensitive()) {
+        TftpFilenameIndexStats index = getFilenameIndexStats();
+        ss << "  Filename Index: " << index.files << " files in " << index.directories << " directories ("
+           << index.unwatched_directories << " unwatched), " << index.resolved << "/" << index.lookups
+           << " lookups resolved" << std::endl;
+    }
     ss << "  Uptime: " << getUptime().count() << " seconds" << std::endl;
 
     return ss.str();
@@ -152,6 +305,10 @@ void TftpServer::setConfigFile(const std::string& config_file) {
     config_file_path_ = config_file;
 }
 
+void TftpServer::setConnectionsFileSuffix(const std::string& suffix) {
+    connections_file_suffix_ = suffix;
+}
+
 bool TftpServer::reloadConfig(const std::string& config_file) {
     std::string file_to_load = config_file.empty() ? config_file_path_ : config_file;
 
@@ -180,10 +337,39 @@ bool TftpServer::reloadConfig(const std::string& config_file) {
         logEvent(LogLevel::WARNING, "Please restart the server to apply network configuration changes");
     }
 
+    // Scanning the tree can take seconds, so it happens before the table
+    // lock; the index swaps in its result itself and lookups meanwhile use
+    // the previous one
+    if (new_config->isCaseInsensitive()) {
+        buildFilenameIndex(new_config->getRootDirectory());
+    }
+    // Opened here for the same reason: open() on a hung mount must not stall routing
+    std::shared_ptr<const TftpRootHandle> root_handle = openRootHandle(*new_config);
+
     // Update config (thread-safe)
     {
         std::lock_guard<std::mutex> lock(connections_mutex_);
         config_ = new_config;
+        access_policy_.store(new_config->getAccessPolicy());
+        if (security_manager_) {
+            security_manager_->reloadConfiguration(new_config);
+        }
+        multicast_manager_->setConfig(new_config);
+        block_cache_->setCapacity(new_config->getBlockCacheSize());
+        netascii_cache_->setCapacity(new_config->getNetasciiCacheSize());
+        compressed_store_->setConfig(new_config);
+        origin_store_->setConfig(new_config);
+        cluster_->setConfig(new_config);
+        negative_cache_->setLimits(new_config->getNegativeCacheEntries(),
+                                   std::chrono::seconds(new_config->getNegativeCacheTtl()));
+        negative_cache_->clear();
+        metadata_cache_->setMaxEntries(new_config->getMetadataCacheEntries());
+        metadata_cache_->clear();
+        if (!new_config->isCaseInsensitive()) {
+            filename_index_->clear();
+        }
+        reportRemapRules(*new_config);
+        root_handle_.store(root_handle);
 
         // Update active connections with new config values
         for (auto& pair : connections_) {
@@ -217,6 +403,30 @@ TftpServerStats TftpServer::getStats() const {
     return stats_;
 }
 
+TftpSendStats TftpServer::getSendStats() const {
+    TftpSendStats stats;
+    stats.datagrams = sent_datagrams_.load(std::memory_order_relaxed);
+    stats.calls = send_calls_.load(std::memory_order_relaxed);
+    stats.gso_sends = gso_sends_.load(std::memory_order_relaxed);
+    stats.gso_fallbacks = gso_fallbacks_.load(std::memory_order_relaxed);
+    stats.gso_enabled = gso_enabled_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+TftpListenerStats TftpServer::getListenerStats() const {
+    TftpListenerStats stats;
+    stats.packets = listener_packets_.load(std::memory_order_relaxed);
+    stats.batches = listener_batches_.load(std::memory_order_relaxed);
+    stats.acks_coalesced = listener_acks_coalesced_.load(std::memory_order_relaxed);
+    stats.table_waits = listener_table_waits_.load(std::memory_order_relaxed);
+    stats.table_wait_ns = listener_table_wait_ns_.load(std::memory_order_relaxed);
+    stats.max_table_wait_ns = listener_max_table_wait_ns_.load(std::memory_order_relaxed);
+    stats.reclaimed = reclaimed_connections_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    stats.pending_reclaim = retired_connections_.size();
+    return stats;
+}
+
 void TftpServer::resetStats() {
     std::lock_guard<std::mutex> lock(stats_mutex_);
     stats_ = TftpServerStats();
@@ -285,99 +495,164 @@ void TftpServer::broadcastMessage(const std::string& message) {
 bool TftpServer::closeConnection(const std::string& client_addr, port_t client_port) {
     std::string key = generateConnectionKey(client_addr, client_port);
 
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    auto it = connections_.find(key);
-    if (it != connections_.end()) {
-        it->second->stop();
+    std::shared_ptr<TftpConnection> connection;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        auto it = connections_.find(key);
+        if (it == connections_.end()) {
+            return false;
+        }
+        connection = std::move(it->second);
         connections_.erase(it);
-        return true;
     }
 
-    return false;
+    // Joins the worker thread, so not under the lock
+    connection->stop();
+    updateStats(connection->getState(), connection->getBytesTransferred());
+    return true;
 }
 
 void TftpServer::closeAllConnections() {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    for (auto& connection : connections_) {
+    ConnectionTable connections;
+    std::vector<std::shared_ptr<TftpConnection>> retired;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        connections.swap(connections_);
+        retired.swap(retired_connections_);
+    }
+    for (auto& connection : connections) {
         connection.second->stop();
     }
-    connections_.clear();
+    for (auto& connection : retired) {
+        connection->stop();
+    }
 }
 
 std::string TftpServer::getConnectionInfo(const std::string& client_addr, port_t client_port) const {
     std::string key = generateConnectionKey(client_addr, client_port);
 
-    std::lock_guard<std::mutex> lock(connections_mutex_);
-    auto it = connections_.find(key);
-    if (it != connections_.end()) {
-        auto conn = it->second;
-        std::stringstream ss;
-        ss << "Connection: " << client_addr << ":" << client_port << std::endl;
-        ss << "  State: " << static_cast<int>(conn->getState()) << std::endl;
-        ss << "  Filename: " << conn->getFilename() << std::endl;
-        ss << "  Bytes Transferred: " << conn->getBytesTransferred() << std::endl;
-        ss << "  Duration: " << conn->getDuration().count() << " seconds" << std::endl;
-        return ss.str();
+    std::shared_ptr<TftpConnection> conn;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        auto it = connections_.find(key);
+        if (it != connections_.end()) {
+            conn = it->second;
+        }
+    }
+
+    if (!conn) {
+        return "Connection not found";
     }
 
-    return "Connection not found";
+    TftpConnectionTelemetry telemetry = conn->getTelemetry();
+    std::stringstream ss;
+    ss << "Connection: " << client_addr << ":" << client_port << std::endl;
+    ss << "  State: " << connectionStateToString(telemetry.state) << std::endl;
+    ss << "  Direction: " << transferDirectionToString(telemetry.direction) << std::endl;
+    ss << "  Filename: " << telemetry.filename << std::endl;
+    ss << "  Bytes Transferred: " << telemetry.bytes_transferred;
+    if (telemetry.total_bytes > 0) {
+        ss << " / " << telemetry.total_bytes;
+    }
+    ss << std::endl;
+    ss << "  Throughput: " << static_cast<uint64_t>(telemetry.throughput_bps) << " bytes/s" << std::endl;
+    ss << "  Retransmits: " << telemetry.retransmits << std::endl;
+    ss << "  Duration: " << conn->getDuration().count() << " seconds" << std::endl;
+    return ss.str();
 }
 
 std::vector<std::string> TftpServer::listConnections() const {
     std::vector<std::string> result;
 
+    // getTelemetry() is lock-free, so the map lock is not held while formatting
+    for (const auto& telemetry : getConnectionTelemetry()) {
+        result.push_back(telemetry.toJson());
+    }
+
+    return result;
+}
+
+std::vector<std::shared_ptr<TftpConnection>> TftpServer::snapshotConnections() const {
+    std::vector<std::shared_ptr<TftpConnection>> snapshot;
+
     std::lock_guard<std::mutex> lock(connections_mutex_);
+    snapshot.reserve(connections_.size());
     for (const auto& connection : connections_) {
-        result.push_back(getConnectionInfo(connection.second->getClientAddress(),
-                                         connection.second->getClientPort()));
+        snapshot.push_back(connection.second);
+    }
+
+    return snapshot;
+}
+
+std::vector<TftpConnectionTelemetry> TftpServer::getConnectionTelemetry() const {
+    std::vector<TftpConnectionTelemetry> result;
+
+    for (const auto& connection : snapshotConnections()) {
+        result.push_back(connection->getTelemetry());
     }
 
     return result;
 }
 
-void TftpServer::listenerThread() {
-    logEvent(LogLevel::INFO, "Listener thread started");
+std::string TftpServer::getConnectionsJson() const {
+    auto now = std::chrono::system_clock::now();
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+
+    std::ostringstream json;
+    json << "{";
+    json << "\"timestamp_ms\":" << timestamp << ",";
+    json << "\"uptime_seconds\":" << getUptime().count() << ",";
+    json << "\"connections\":[";
+    bool first = true;
+    for (const auto& entry : listConnections()) {
+        if (!first) {
+            json << ",";
+        }
+        json << entry;
+        first = false;
+    }
+    json << "]";
+    json << "}";
+    return json.str();
+}
 
-    uint8_t buffer[TFTP_MAX_PACKET_SIZE];
+bool TftpServer::writeConnectionsSnapshot() const {
+    std::string path = config_ ? config_->getConnectionsFile() : std::string();
+    if (path.empty()) {
+        return true;
+    }
+    path += connections_file_suffix_;
 
-    while (running_.load() && !shutdown_requested_.load()) {
-        struct sockaddr_storage client_addr;
-        socklen_t client_addr_len = sizeof(client_addr);
+    // Write to a temporary file and rename so readers never see a partial document
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::out | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << getConnectionsJson() << std::endl;
+        if (!file) {
+            return false;
+        }
+    }
 
-        ssize_t bytes_received = recvfrom(server_socket_,
-                                        reinterpret_cast<char*>(buffer),
-                                        sizeof(buffer),
-                                        0,
-                                        reinterpret_cast<struct sockaddr*>(&client_addr),
-                                        &client_addr_len);
-
-        if (bytes_received > 0) {
-            // Convert client address to string
-            std::string client_addr_str;
-            port_t client_port = 0;
-
-            if (client_addr.ss_family == AF_INET) {
-                struct sockaddr_in* addr4 = reinterpret_cast<struct sockaddr_in*>(&client_addr);
-                char addr_str[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &addr4->sin_addr, addr_str, INET_ADDRSTRLEN);
-                client_addr_str = addr_str;
-                client_port = ntohs(addr4->sin_port);
-            } else if (client_addr.ss_family == AF_INET6) {
-                struct sockaddr_in6* addr6 = reinterpret_cast<struct sockaddr_in6*>(&client_addr);
-                char addr_str[INET6_ADDRSTRLEN];
-                inet_ntop(AF_INET6, &addr6->sin6_addr, addr_str, INET6_ADDRSTRLEN);
-                client_addr_str = addr_str;
-                client_port = ntohs(addr6->sin6_port);
-            }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
 
-            if (config_ && !config_->isClientAllowed(client_addr_str)) {
-                logEvent(LogLevel::WARNING, "Rejected packet from unauthorized client " + client_addr_str);
-                continue;
-            }
+void TftpServer::listenerThread() {
+    logEvent(LogLevel::INFO, "Listener thread started");
+
+    // One slot per datagram of a batch, each large enough for DATA at the maximum negotiated blksize
+    std::vector<uint8_t> buffer(LISTENER_BATCH_SIZE * TFTP_MAX_DATAGRAM_SIZE);
+    std::vector<ListenerDatagram> batch(LISTENER_BATCH_SIZE);
+    TftpAckCoalescer acks;
 
-            // Handle the received packet
-            handlePacket(buffer, static_cast<size_t>(bytes_received), client_addr_str, client_port);
-        } else if (bytes_received < 0) {
+    while (running_.load() && !shutdown_requested_.load()) {
+        int received = receiveBatch(buffer.data(), batch);
+        if (received > 0) {
+            routeBatch(buffer.data(), batch, static_cast<size_t>(received), acks);
+            continue;
+        } else if (received < 0) {
 #ifdef PLATFORM_WINDOWS
             int error = WSAGetLastError();
             if (error != WSAEWOULDBLOCK && error != WSAETIMEDOUT) {
@@ -390,13 +665,129 @@ void TftpServer::listenerThread() {
 #endif
         }
 
-        // Small sleep to prevent busy waiting
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        // Once the socket is drained, wait for the next datagram rather than
+        // sleeping, so it is picked up as soon as it arrives
+        socket_t socket = server_socket_;
+        if (socket == INVALID_SOCKET_VALUE) {
+            break;
+        }
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(socket, &readable);
+        struct timeval tv {};
+        tv.tv_usec = 100000;
+        select(static_cast<int>(socket) + 1, &readable, nullptr, nullptr, &tv);
     }
 
     logEvent(LogLevel::INFO, "Listener thread stopped");
 }
 
+int TftpServer::receiveBatch(uint8_t* buffer, std::vector<ListenerDatagram>& batch) {
+#ifdef PLATFORM_LINUX
+    // One system call for everything queued, up to the batch size
+    struct mmsghdr messages[LISTENER_BATCH_SIZE];
+    struct iovec slots[LISTENER_BATCH_SIZE];
+    size_t capacity = std::min(batch.size(), LISTENER_BATCH_SIZE);
+    for (size_t i = 0; i < capacity; ++i) {
+        slots[i].iov_base = buffer + i * TFTP_MAX_DATAGRAM_SIZE;
+        slots[i].iov_len = TFTP_MAX_DATAGRAM_SIZE;
+        std::memset(&messages[i], 0, sizeof(messages[i]));
+        messages[i].msg_hdr.msg_iov = &slots[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_name = &batch[i].from;
+        messages[i].msg_hdr.msg_namelen = sizeof(batch[i].from);
+    }
+    int received = recvmmsg(server_socket_, messages, static_cast<unsigned int>(capacity), MSG_DONTWAIT, nullptr);
+    for (int i = 0; i < received; ++i) {
+        batch[i].size = messages[i].msg_len;
+    }
+    return received;
+#else
+    // The socket is non-blocking, so this stops at the first empty read
+    int received = 0;
+    while (static_cast<size_t>(received) < batch.size()) {
+        ListenerDatagram& datagram = batch[received];
+        socklen_t from_len = sizeof(datagram.from);
+        ssize_t bytes_received = recvfrom(server_socket_,
+                                          reinterpret_cast<char*>(buffer + received * TFTP_MAX_DATAGRAM_SIZE),
+                                          TFTP_MAX_DATAGRAM_SIZE,
+                                          0,
+                                          reinterpret_cast<struct sockaddr*>(&datagram.from),
+                                          &from_len);
+        if (bytes_received < 0) {
+            return received > 0 ? received : -1;
+        }
+        datagram.size = static_cast<size_t>(bytes_received);
+        ++received;
+    }
+    return received;
+#endif
+}
+
+void TftpServer::routeBatch(const uint8_t* buffer, std::vector<ListenerDatagram>& batch, size_t count,
+                            TftpAckCoalescer& acks) {
+    listener_batches_.fetch_add(1, std::memory_order_relaxed);
+    acks.clear();
+    auto route = [&](size_t index) {
+        const ListenerDatagram& datagram = batch[index];
+        handlePacket(buffer + index * TFTP_MAX_DATAGRAM_SIZE, datagram.size, datagram.address, datagram.port);
+    };
+
+    TftpPendingAck earlier;
+    for (size_t i = 0; i < count; ++i) {
+        ListenerDatagram& datagram = batch[i];
+        if (datagram.size == 0) {
+            continue;
+        }
+
+        // Convert client address to string
+        datagram.address.clear();
+        datagram.port = 0;
+        if (datagram.from.ss_family == AF_INET) {
+            struct sockaddr_in* addr4 = reinterpret_cast<struct sockaddr_in*>(&datagram.from);
+            char addr_str[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &addr4->sin_addr, addr_str, INET_ADDRSTRLEN);
+            datagram.address = addr_str;
+            datagram.port = ntohs(addr4->sin_port);
+        } else if (datagram.from.ss_family == AF_INET6) {
+            struct sockaddr_in6* addr6 = reinterpret_cast<struct sockaddr_in6*>(&datagram.from);
+            char addr_str[INET6_ADDRSTRLEN];
+            inet_ntop(AF_INET6, &addr6->sin6_addr, addr_str, INET6_ADDRSTRLEN);
+            datagram.address = addr_str;
+            datagram.port = ntohs(addr6->sin6_port);
+        }
+
+        if (!access_policy_.load()->isClientAllowed(datagram.from)) {
+            logEvent(LogLevel::WARNING, "Rejected packet from unauthorized client " + datagram.address);
+            continue;
+        }
+        listener_packets_.fetch_add(1, std::memory_order_relaxed);
+
+        // ACKs wait for the end of the batch, where the newest one per session is handled
+        const uint8_t* packet = buffer + i * TFTP_MAX_DATAGRAM_SIZE;
+        std::string key = generateConnectionKey(datagram.address, datagram.port);
+        TftpOpcode opcode;
+        TftpAckView ack;
+        if (TftpCodec::peekOpcode(packet, datagram.size, opcode) && opcode == TftpOpcode::ACK &&
+            TftpCodec::decodeAck(packet, datagram.size, ack)) {
+            if (acks.add(key, ack.block, i)) {
+                listener_acks_coalesced_.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        // Any other packet is handled after the session's earlier ACK
+        if (acks.take(key, earlier)) {
+            route(earlier.packet);
+        }
+        route(i);
+    }
+
+    for (const TftpPendingAck& pending : acks.pending()) {
+        route(pending.packet);
+    }
+}
+
 void TftpServer::cleanupThread() {
     logEvent(LogLevel::INFO, "Cleanup thread started");
 
@@ -405,6 +796,11 @@ void TftpServer::cleanupThread() {
         std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 
         cleanupInactiveConnections();
+        multicast_manager_->cleanup();
+
+        if (!writeConnectionsSnapshot()) {
+            logEvent(LogLevel::WARNING, "Failed to write connections status file: " + config_->getConnectionsFile());
+        }
     }
 
     logEvent(LogLevel::INFO, "Cleanup thread stopped");
@@ -463,61 +859,52 @@ void TftpServer::handlePacket(const uint8_t* packet_data,
     switch (static_cast<TftpOpcode>(opcode)) {
         case TftpOpcode::RRQ:
         case TftpOpcode::WRQ: {
-            // Create new connection for request
-            auto connection = createConnection(sender_addr, sender_port);
-            if (connection) {
-                std::lock_guard<std::mutex> lock(connections_mutex_);
-                connections_[connection_key] = connection;
-                connection->start();
-
-                // Parse and handle the request
-                TftpRequestPacket request(packet_data, packet_size);
-                if (request.isValid()) {
-                    if (opcode == static_cast<uint16_t>(TftpOpcode::RRQ)) {
-                        connection->handleReadRequest(request);
-                    } else {
-                        connection->handleWriteRequest(request);
-                    }
+            {
+                // The client retransmitted its request before the first reply
+                auto lock = lockConnectionTable();
+                auto it = connections_.find(connection_key);
+                if (it != connections_.end() && it->second->isRequestPending()) {
+                    break;
                 }
             }
-            break;
-        }
 
-        case TftpOpcode::DATA: {
-            // Find existing connection
-            std::lock_guard<std::mutex> lock(connections_mutex_);
-            auto it = connections_.find(connection_key);
-            if (it != connections_.end()) {
-                TftpDataPacket data_packet(packet_data, packet_size);
-                if (data_packet.isValid()) {
-                    it->second->handleDataPacket(data_packet);
+            // Create new connection for request
+            auto connection = createConnection(sender_addr, sender_port);
+            if (!connection) {
+                break;
+            }
+            TftpRequestPacket request(packet_data, packet_size);
+            connection->beginSetup();
+            {
+                auto lock = lockConnectionTable();
+                std::shared_ptr<TftpConnection>& entry = connections_[connection_key];
+                if (entry) {
+                    // A new request from the same TID replaces the old transfer, which
+                    // is stopped and destroyed by the cleanup thread, not here
+                    retired_connections_.push_back(std::move(entry));
                 }
+                entry = connection;
             }
-            break;
-        }
 
-        case TftpOpcode::ACK: {
-            // Find existing connection
-            std::lock_guard<std::mutex> lock(connections_mutex_);
-            auto it = connections_.find(connection_key);
-            if (it != connections_.end()) {
-                TftpAckPacket ack_packet(packet_data, packet_size);
-                if (ack_packet.isValid()) {
-                    it->second->handleAckPacket(ack_packet);
-                }
+            // Starting the worker, validation and file access run on the setup
+            // pool; this thread only parses and routes
+            if (!setup_pool_->isRunning()) {
+                connection->setUp(request);
+            } else if (!setup_pool_->submit([connection, request] { connection->setUp(request); })) {
+                logEvent(LogLevel::WARNING, "Setup queue full, refusing request from " + sender_addr + ":" +
+                         std::to_string(sender_port));
+                connection->reject("Server busy, try again later");
             }
             break;
         }
 
+        case TftpOpcode::DATA:
+        case TftpOpcode::ACK:
         case TftpOpcode::ERROR: {
-            // Find existing connection
-            std::lock_guard<std::mutex> lock(connections_mutex_);
-            auto it = connections_.find(connection_key);
-            if (it != connections_.end()) {
-                TftpErrorPacket error_packet(packet_data, packet_size);
-                if (error_packet.isValid()) {
-                    it->second->handleErrorPacket(error_packet);
-                }
+            // Handled under the connection's lock, or kept until its setup is done
+            auto connection = findConnection(connection_key);
+            if (connection) {
+                connection->handlePacket(packet_data, packet_size, sender_addr, sender_port);
             }
             break;
         }
@@ -543,6 +930,30 @@ std::shared_ptr<TftpConnection> TftpServer::createConnection(const std::string&
     return connection;
 }
 
+std::shared_ptr<TftpConnection> TftpServer::findConnection(const std::string& connection_key) {
+    auto lock = lockConnectionTable();
+    auto it = connections_.find(connection_key);
+    return it == connections_.end() ? nullptr : it->second;
+}
+
+std::unique_lock<std::mutex> TftpServer::lockConnectionTable() {
+    std::unique_lock<std::mutex> lock(connections_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        // Only a contended lock is timed, so the common case reads no clock
+        auto started = std::chrono::steady_clock::now();
+        lock.lock();
+        uint64_t waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count());
+        listener_table_waits_.fetch_add(1, std::memory_order_relaxed);
+        listener_table_wait_ns_.fetch_add(waited, std::memory_order_relaxed);
+        uint64_t longest = listener_max_table_wait_ns_.load(std::memory_order_relaxed);
+        while (waited > longest &&
+               !listener_max_table_wait_ns_.compare_exchange_weak(longest, waited, std::memory_order_relaxed)) {
+        }
+    }
+    return lock;
+}
+
 void TftpServer::setSecurityManager(std::shared_ptr<ProductionSecurityManager> security_manager) {
     security_manager_ = security_manager;
 }
@@ -551,21 +962,51 @@ void TftpServer::removeConnection(const std::string& client_addr, port_t client_
     std::string key = generateConnectionKey(client_addr, client_port);
 
     std::lock_guard<std::mutex> lock(connections_mutex_);
-    connections_.erase(key);
+    auto it = connections_.find(key);
+    if (it != connections_.end()) {
+        retired_connections_.push_back(std::move(it->second));
+        connections_.erase(it);
+    }
 }
 
 void TftpServer::cleanupInactiveConnections() {
-    std::lock_guard<std::mutex> lock(connections_mutex_);
+    size_t active = 0;
+    {
+        // Only unlink under the lock; the listener routes packets through it
+        std::lock_guard<std::mutex> lock(connections_mutex_);
 
-    auto it = connections_.begin();
-    while (it != connections_.end()) {
-        if (!it->second->isActive()) {
-            it->second->stop();
-            it = connections_.erase(it);
-        } else {
-            ++it;
+        auto it = connections_.begin();
+        while (it != connections_.end()) {
+            if (!it->second->isActive()) {
+                retired_connections_.push_back(std::move(it->second));
+                it = connections_.erase(it);
+            } else {
+                ++it;
+            }
         }
+        active = connections_.size();
     }
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.active_connections = active;
+    }
+    reclaimConnections();
+}
+
+void TftpServer::reclaimConnections() {
+    std::vector<std::shared_ptr<TftpConnection>> retired;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        retired.swap(retired_connections_);
+    }
+
+    // Finished transfers feed the metrics prefork workers publish to the supervisor
+    for (const auto& connection : retired) {
+        connection->stop();
+        updateStats(connection->getState(), connection->getBytesTransferred());
+    }
+    reclaimed_connections_.fetch_add(retired.size(), std::memory_order_relaxed);
 }
 
 void TftpServer::updateStats(TftpConnectionState connection_state, size_t bytes_transferred) {
@@ -620,6 +1061,16 @@ bool TftpServer::setSocketOptions() {
         logEvent(LogLevel::WARNING, "Failed to set SO_REUSEADDR: " + std::to_string(SOCKET_ERROR_CODE));
     }
 
+#ifdef SO_REUSEPORT
+    // Prefork workers each bind the port; the kernel spreads clients across them by address hash
+    if (config_->getWorkers() > 1 &&
+        setsockopt(server_socket_, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&reuse),
+                   sizeof(reuse)) < 0) {
+        logEvent(LogLevel::ERROR, "Failed to set SO_REUSEPORT: " + std::to_string(SOCKET_ERROR_CODE));
+        return false;
+    }
+#endif
+
     // Set socket receive timeout
     struct ::timeval timeout;
     timeout.tv_sec = 1;  // 1 second timeout
@@ -669,16 +1120,16 @@ bool TftpServer::bindSocket() {
                 ipv6_enabled_ = false;
                 // Close IPv6 socket and create IPv4 socket
                 closeSocket();
-                if (!initializeSocket()) {
+                if (!initializeSocket() || !setSocketOptions()) {
                     logEvent(LogLevel::ERROR, "Failed to create IPv4 socket for fallback");
                     return false;
                 }
                 // Fall through to IPv4 binding
             }
         } else {
-            // Invalid IPv6 address, close socket and create IPv4 socket
+            // Invalid IPv6 address, close socket and create IPv4 socket (with the same options)
             closeSocket();
-            if (!initializeSocket()) {
+            if (!initializeSocket() || !setSocketOptions()) {
                 logEvent(LogLevel::ERROR, "Failed to create IPv4 socket for fallback");
                 return false;
             }
@@ -755,6 +1206,150 @@ bool TftpServer::setNonBlocking() {
     return true;
 }
 
+bool TftpServer::joinMulticastTransfer(const std::string& client_addr, port_t client_port,
+                                       const std::string& path, const std::string& name, uint64_t file_size,
+                                       uint16_t block_size, const TftpOptions& request_options) {
+    if (!running_.load()) {
+        return false;
+    }
+    // A handle from before a root change would resolve name in the wrong tree
+    std::shared_ptr<const TftpRootHandle> root = root_handle_.load();
+    if (root && path.compare(0, root->getRoot().size(), root->getRoot()) != 0) {
+        root.reset();
+    }
+    return multicast_manager_->join(client_addr, client_port, path, file_size, block_size, request_options,
+                                    root, name);
+}
+
+TftpBlockCache& TftpServer::getBlockCache() {
+    return *block_cache_;
+}
+
+TftpBlockCacheStats TftpServer::getBlockCacheStats() const {
+    return block_cache_->getStats();
+}
+
+TftpNetasciiCache& TftpServer::getNetasciiCache() {
+    return *netascii_cache_;
+}
+
+TftpCacheStats TftpServer::getNetasciiCacheStats() const {
+    return netascii_cache_->getStats();
+}
+
+TftpNegativeCache& TftpServer::getNegativeCache() {
+    return *negative_cache_;
+}
+
+TftpNegativeCacheStats TftpServer::getNegativeCacheStats() const {
+    return negative_cache_->getStats();
+}
+
+TftpMetadataCache& TftpServer::getMetadataCache() {
+    return *metadata_cache_;
+}
+
+TftpMetadataCacheStats TftpServer::getMetadataCacheStats() const {
+    return metadata_cache_->getStats();
+}
+
+TftpDirectoryWatcher& TftpServer::getDirectoryWatcher() {
+    return *directory_watcher_;
+}
+
+TftpFilenameIndex& TftpServer::getFilenameIndex() {
+    return *filename_index_;
+}
+
+TftpFilenameIndexStats TftpServer::getFilenameIndexStats() const {
+    return filename_index_->getStats();
+}
+
+void TftpServer::buildFilenameIndex(const std::string& root) {
+    size_t files = filename_index_->build(root);
+    TftpFilenameIndexStats stats = filename_index_->getStats();
+    logEvent(LogLevel::INFO, "Indexed " + std::to_string(files) + " files in " + std::to_string(stats.directories) +
+             " directories for case-insensitive lookup (" + std::to_string(stats.build_time_ms) + " ms)");
+    if (stats.unwatched_directories > 0) {
+        logEvent(LogLevel::WARNING, std::to_string(stats.unwatched_directories) +
+                 " directories could not be watched; files added there are only found by exact name");
+    }
+}
+
+void TftpServer::reportRemapRules(const TftpConfig& config) {
+    std::shared_ptr<const TftpRemapRules> remap = config.getFilenameRemap();
+    for (const auto& rule : remap->getRejectedRules()) {
+        logEvent(LogLevel::WARNING, "Ignoring invalid remap rule: " + rule);
+    }
+    if (!remap->empty()) {
+        logEvent(LogLevel::INFO, "Loaded " + std::to_string(remap->ruleCount()) + " filename remap rules");
+    }
+}
+
+TftpOriginStore& TftpServer::getOriginStore() {
+    return *origin_store_;
+}
+
+TftpOriginStats TftpServer::getOriginStats() const {
+    return origin_store_->getStats();
+}
+
+TftpCluster& TftpServer::getCluster() {
+    return *cluster_;
+}
+
+TftpClusterStats TftpServer::getClusterStats() const {
+    return cluster_->getStats();
+}
+
+void TftpServer::setSharedCache(std::shared_ptr<TftpSharedContentCache> cache) {
+    shared_cache_ = std::move(cache);
+}
+
+TftpSharedContentCache* TftpServer::getSharedCache() const {
+    return shared_cache_.get();
+}
+
+TftpSetupPoolStats TftpServer::getSetupPoolStats() const {
+    return setup_pool_->getStats();
+}
+
+std::shared_ptr<const TftpRootHandle> TftpServer::getRootHandle() const {
+    return root_handle_.load();
+}
+
+std::shared_ptr<const TftpRootHandle> TftpServer::openRootHandle(const TftpConfig& config) {
+    auto handle = std::make_shared<TftpRootHandle>();
+    if (!handle->open(config.getRootDirectory(), config.getAllowedDirectories())) {
+        logEvent(LogLevel::WARNING, "Cannot open root directory " + config.getRootDirectory() +
+                 "; transfers will fail until it exists");
+        return nullptr;
+    }
+    for (const auto& directory : handle->getRejectedDirectories()) {
+        logEvent(LogLevel::WARNING, "Cannot open allowed directory beneath the root: " + directory);
+    }
+    logEvent(LogLevel::INFO, "Serving " + config.getRootDirectory() + " through " +
+             std::to_string(handle->anchorCount()) + " directory handles (" +
+             (handle->usesKernelResolution() ? "openat2" : "userspace") + " path resolution)");
+    return handle;
+}
+
+TftpCompressedStore& TftpServer::getCompressedStore() {
+    return *compressed_store_;
+}
+
+TftpCompressionStats TftpServer::getCompressionStats() const {
+    return compressed_store_->getStats();
+}
+
+size_t TftpServer::getMulticastSessionCount() const {
+    return multicast_manager_->getSessionCount();
+}
+
+TftpMulticastStats TftpServer::getMulticastStats() const {
+    return multicast_manager_->getStats();
+}
+
 bool TftpServer::sendPacket(const uint8_t* packet_data, size_t packet_size,
                            const std::string& client_addr, port_t client_port) {
     if (!packet_data || packet_size == 0) {
@@ -763,7 +1358,76 @@ bool TftpServer::sendPacket(const uint8_t* packet_data, size_t packet_size,
 
     struct sockaddr_storage addr;
     socklen_t addr_len;
+    if (!resolveClientAddress(client_addr, client_port, addr, addr_len)) {
+        return false;
+    }
+
+    ssize_t bytes_sent = sendto(server_socket_,
+                              reinterpret_cast<const char*>(packet_data),
+                              packet_size,
+                              0,
+                              reinterpret_cast<struct sockaddr*>(&addr),
+                              addr_len);
+
+    if (bytes_sent < 0 || static_cast<size_t>(bytes_sent) != packet_size) {
+        logEvent(LogLevel::ERROR, "Failed to send packet to " + client_addr + ":" + std::to_string(client_port) +
+                " - Error: " + std::to_string(SOCKET_ERROR_CODE));
+        return false;
+    }
+
+    sent_datagrams_.fetch_add(1, std::memory_order_relaxed);
+    send_calls_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
 
+bool TftpServer::sendSegments(const uint8_t* data, size_t size, size_t segment_size,
+                              const std::string& client_addr, port_t client_port) {
+    if (!data || segment_size == 0) {
+        return false;
+    }
+
+    if (size > segment_size && gso_enabled_.load(std::memory_order_relaxed)) {
+        struct sockaddr_storage addr;
+        socklen_t addr_len;
+        if (!resolveClientAddress(client_addr, client_port, addr, addr_len)) {
+            return false;
+        }
+
+        ssize_t bytes_sent = sendUdpSegments(server_socket_, data, size, segment_size,
+                                             reinterpret_cast<struct sockaddr*>(&addr), addr_len);
+        if (bytes_sent >= 0 && static_cast<size_t>(bytes_sent) == size) {
+            sent_datagrams_.fetch_add((size + segment_size - 1) / segment_size, std::memory_order_relaxed);
+            send_calls_.fetch_add(1, std::memory_order_relaxed);
+            gso_sends_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        int error = errno;
+        gso_fallbacks_.fetch_add(1, std::memory_order_relaxed);
+        if (isUdpGsoUnsupportedError(error) && gso_enabled_.exchange(false)) {
+            logEvent(LogLevel::WARNING, "UDP GSO send failed (error " + std::to_string(error) +
+                     "); sending datagrams one at a time from now on");
+        }
+    }
+
+    for (size_t offset = 0; offset < size; offset += segment_size) {
+        if (!sendPacket(data + offset, std::min(segment_size, size - offset), client_addr, client_port)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t TftpServer::getGsoSegmentsPerSend(size_t segment_size) const {
+    if (!gso_enabled_.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    size_t segments = udpGsoSegmentsPerSend(segment_size);
+    return segments > 1 ? segments : 0;
+}
+
+bool TftpServer::resolveClientAddress(const std::string& client_addr, port_t client_port,
+                                      struct sockaddr_storage& addr, socklen_t& addr_len) {
     if (ipv6_enabled_) {
         // IPv6 address
         struct sockaddr_in6* addr6 = reinterpret_cast<struct sockaddr_in6*>(&addr);
@@ -791,20 +1455,6 @@ bool TftpServer::sendPacket(const uint8_t* packet_data, size_t packet_size,
 
         addr_len = sizeof(*addr4);
     }
-
-    ssize_t bytes_sent = sendto(server_socket_,
-                              reinterpret_cast<const char*>(packet_data),
-                              packet_size,
-                              0,
-                              reinterpret_cast<struct sockaddr*>(&addr),
-                              addr_len);
-
-    if (bytes_sent < 0 || static_cast<size_t>(bytes_sent) != packet_size) {
-        logEvent(LogLevel::ERROR, "Failed to send packet to " + client_addr + ":" + std::to_string(client_port) +
-                " - Error: " + std::to_string(SOCKET_ERROR_CODE));
-        return false;
-    }
-
     return true;
 }
 
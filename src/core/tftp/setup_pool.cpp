@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/setup_pool.hpp"
+#include <algorithm>
+
+namespace simple_tftpd {
+
+TftpSetupPool::TftpSetupPool(size_t threads, size_t queue_limit)
+    : thread_count_(threads), queue_limit_(queue_limit), running_(false) {
+    stats_.threads = threads;
+}
+
+TftpSetupPool::~TftpSetupPool() {
+    stop();
+}
+
+void TftpSetupPool::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ || thread_count_ == 0) {
+        return;
+    }
+    running_ = true;
+    for (size_t i = 0; i < thread_count_; ++i) {
+        threads_.emplace_back(&TftpSetupPool::run, this);
+    }
+}
+
+void TftpSetupPool::stop() {
+    std::vector<std::thread> threads;
+    std::deque<Job> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        threads.swap(threads_);
+        discarded.swap(queue_);
+        stats_.dropped += discarded.size();
+        stats_.queued = 0;
+    }
+    ready_.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Destroyed outside the lock: a job may own the last reference to a connection
+    discarded.clear();
+}
+
+bool TftpSetupPool::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return false;
+        }
+        if (queue_.size() >= queue_limit_) {
+            stats_.rejected++;
+            return false;
+        }
+        queue_.push_back(std::move(job));
+        stats_.submitted++;
+        stats_.queued = queue_.size();
+        stats_.peak_queued = std::max(stats_.peak_queued, stats_.queued);
+    }
+    ready_.notify_one();
+    return true;
+}
+
+bool TftpSetupPool::isRunning() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_;
+}
+
+TftpSetupPoolStats TftpSetupPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void TftpSetupPool::run() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] { return !running_ || !queue_.empty(); });
+            if (!running_) {
+                return;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+            stats_.queued = queue_.size();
+        }
+
+        job();
+        job = nullptr;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.completed++;
+    }
+}
+
+} // namespace simple_tftpd
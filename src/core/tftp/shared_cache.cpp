@@ -0,0 +1,271 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/shared_cache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+#ifdef PLATFORM_LINUX
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+namespace simple_tftpd {
+
+namespace {
+
+constexpr uint32_t SLOTS_PER_STRIPE = 64;
+constexpr size_t PAGE = 4096;
+
+// FNV-1a; two bases give the 128 bits that identify a path
+uint64_t hashPath(const std::string& path, uint64_t basis) {
+    uint64_t hash = basis;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+struct TftpSharedContentCache::Header {
+    uint32_t stripes;
+    uint32_t slots;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> insertions;
+    std::atomic<uint64_t> evictions;
+    std::atomic<uint64_t> recoveries;
+};
+
+struct TftpSharedContentCache::Stripe {
+#ifdef PLATFORM_LINUX
+    pthread_mutex_t mutex;
+#endif
+    uint32_t hand;  // CLOCK position within the stripe
+};
+
+struct TftpSharedContentCache::Slot {
+    uint64_t name;   // Path hashes
+    uint64_t check;
+    uint64_t file_size;
+    int64_t modified;
+    uint64_t chunk;
+    uint32_t length;
+    uint8_t used;
+    uint8_t referenced;
+};
+
+std::shared_ptr<TftpSharedContentCache> TftpSharedContentCache::create(size_t bytes) {
+#ifdef PLATFORM_LINUX
+    size_t slots = bytes / CHUNK_SIZE;
+    if (slots == 0 || slots > UINT32_MAX) {
+        return nullptr;
+    }
+    size_t stripes = (slots + SLOTS_PER_STRIPE - 1) / SLOTS_PER_STRIPE;
+    size_t metadata = sizeof(Header) + stripes * sizeof(Stripe) + slots * sizeof(Slot);
+    size_t length = alignUp(metadata, PAGE) + slots * CHUNK_SIZE;
+
+    // Anonymous shared pages start zeroed, survive fork() and go away with the last process
+    void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    std::shared_ptr<TftpSharedContentCache> cache(
+        new TftpSharedContentCache(base, length, static_cast<uint32_t>(stripes), static_cast<uint32_t>(slots)));
+
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+    bool initialized = true;
+    for (size_t i = 0; i < stripes && initialized; ++i) {
+        initialized = pthread_mutex_init(&cache->stripes_[i].mutex, &attributes) == 0;
+    }
+    pthread_mutexattr_destroy(&attributes);
+    return initialized ? cache : nullptr;
+#else
+    (void)bytes;
+    return nullptr;
+#endif
+}
+
+TftpSharedContentCache::TftpSharedContentCache(void* base, size_t length, uint32_t stripes, uint32_t slots)
+    : base_(base), length_(length) {
+    uint8_t* bytes = static_cast<uint8_t*>(base);
+    header_ = new (bytes) Header();
+    header_->stripes = stripes;
+    header_->slots = slots;
+    stripes_ = reinterpret_cast<Stripe*>(bytes + sizeof(Header));
+    slots_ = reinterpret_cast<Slot*>(bytes + sizeof(Header) + stripes * sizeof(Stripe));
+    data_ = bytes + alignUp(sizeof(Header) + stripes * sizeof(Stripe) + slots * sizeof(Slot), PAGE);
+}
+
+TftpSharedContentCache::~TftpSharedContentCache() {
+#ifdef PLATFORM_LINUX
+    munmap(base_, length_);
+#endif
+}
+
+int64_t TftpSharedContentCache::read(const TftpSharedCacheKey& key, uint64_t offset, void* out, size_t size) {
+    if (offset >= key.file_size) {
+        return 0;
+    }
+    uint64_t name = hashPath(key.path, 0xcbf29ce484222325ULL);
+    uint64_t check = hashPath(key.path, 0x84222325cbf29ce4ULL);
+    uint64_t chunk = offset / CHUNK_SIZE;
+    uint32_t stripe = stripeOf(name, chunk);
+    if (!lockStripe(stripe)) {
+        return -1;
+    }
+
+    int64_t copied = -1;
+    Slot* slot = find(stripe, name, check, key, chunk);
+    size_t within = static_cast<size_t>(offset % CHUNK_SIZE);
+    if (slot && within < slot->length) {
+        size_t count = std::min<size_t>(size, slot->length - within);
+        std::memcpy(out, data_ + static_cast<size_t>(slot - slots_) * CHUNK_SIZE + within, count);
+        slot->referenced = 1;
+        copied = static_cast<int64_t>(count);
+    }
+    unlockStripe(stripe);
+
+    (copied < 0 ? header_->misses : header_->hits).fetch_add(1, std::memory_order_relaxed);
+    return copied;
+}
+
+void TftpSharedContentCache::insert(const TftpSharedCacheKey& key, uint64_t chunk, const void* data,
+                                    size_t length) {
+    if (length == 0 || length > CHUNK_SIZE) {
+        return;
+    }
+    uint64_t name = hashPath(key.path, 0xcbf29ce484222325ULL);
+    uint64_t check = hashPath(key.path, 0x84222325cbf29ce4ULL);
+    uint32_t stripe = stripeOf(name, chunk);
+    if (!lockStripe(stripe)) {
+        return;
+    }
+
+    // Another worker may have loaded the same chunk meanwhile
+    if (!find(stripe, name, check, key, chunk)) {
+        uint32_t first = stripe * SLOTS_PER_STRIPE;
+        uint32_t count = std::min(SLOTS_PER_STRIPE, header_->slots - first);
+        Stripe& clock = stripes_[stripe];
+        Slot* victim = nullptr;
+        while (!victim) {
+            Slot& candidate = slots_[first + clock.hand];
+            clock.hand = (clock.hand + 1) % count;
+            if (candidate.used && candidate.referenced) {
+                candidate.referenced = 0;
+            } else {
+                victim = &candidate;
+            }
+        }
+        if (victim->used) {
+            header_->evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Marked unused while copying, so a holder dying here leaves no half chunk behind
+        victim->used = 0;
+        std::memcpy(data_ + static_cast<size_t>(victim - slots_) * CHUNK_SIZE, data, length);
+        victim->name = name;
+        victim->check = check;
+        victim->file_size = key.file_size;
+        victim->modified = key.modified;
+        victim->chunk = chunk;
+        victim->length = static_cast<uint32_t>(length);
+        victim->referenced = 1;
+        victim->used = 1;
+        header_->insertions.fetch_add(1, std::memory_order_relaxed);
+    }
+    unlockStripe(stripe);
+}
+
+TftpSharedCacheStats TftpSharedContentCache::getStats() const {
+    TftpSharedCacheStats stats;
+    stats.hits = header_->hits.load(std::memory_order_relaxed);
+    stats.misses = header_->misses.load(std::memory_order_relaxed);
+    stats.insertions = header_->insertions.load(std::memory_order_relaxed);
+    stats.evictions = header_->evictions.load(std::memory_order_relaxed);
+    stats.recoveries = header_->recoveries.load(std::memory_order_relaxed);
+    stats.chunks = header_->slots;
+    stats.capacity = static_cast<uint64_t>(header_->slots) * CHUNK_SIZE;
+    return stats;
+}
+
+bool TftpSharedContentCache::lockStripe(uint32_t stripe) {
+#ifdef PLATFORM_LINUX
+    int result = pthread_mutex_lock(&stripes_[stripe].mutex);
+    if (result == EOWNERDEAD) {
+        // The previous holder died inside read() or insert(); distrust the whole stripe
+        uint32_t first = stripe * SLOTS_PER_STRIPE;
+        uint32_t count = std::min(SLOTS_PER_STRIPE, header_->slots - first);
+        for (uint32_t i = 0; i < count; ++i) {
+            slots_[first + i].used = 0;
+        }
+        stripes_[stripe].hand = 0;
+        header_->recoveries.fetch_add(1, std::memory_order_relaxed);
+        return pthread_mutex_consistent(&stripes_[stripe].mutex) == 0;
+    }
+    return result == 0;
+#else
+    (void)stripe;
+    return false;
+#endif
+}
+
+void TftpSharedContentCache::unlockStripe(uint32_t stripe) {
+#ifdef PLATFORM_LINUX
+    pthread_mutex_unlock(&stripes_[stripe].mutex);
+#else
+    (void)stripe;
+#endif
+}
+
+uint32_t TftpSharedContentCache::stripeOf(uint64_t name, uint64_t chunk) const {
+    return static_cast<uint32_t>(mix(name ^ (chunk * 0x9e3779b97f4a7c15ULL)) % header_->stripes);
+}
+
+TftpSharedContentCache::Slot* TftpSharedContentCache::find(uint32_t stripe, uint64_t name, uint64_t check,
+                                                           const TftpSharedCacheKey& key, uint64_t chunk) {
+    uint32_t first = stripe * SLOTS_PER_STRIPE;
+    uint32_t count = std::min(SLOTS_PER_STRIPE, header_->slots - first);
+    for (uint32_t i = 0; i < count; ++i) {
+        Slot& slot = slots_[first + i];
+        if (slot.used && slot.name == name && slot.check == check && slot.chunk == chunk &&
+            slot.file_size == key.file_size && slot.modified == key.modified) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace simple_tftpd
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple-tftpd/core/tftp/udp_gso.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef PLATFORM_LINUX
+#include <netinet/udp.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(PLATFORM_LINUX) && defined(UDP_SEGMENT)
+#define TFTP_HAVE_UDP_GSO 1
+#endif
+
+namespace simple_tftpd {
+
+bool isUdpGsoSupported(socket_t socket) {
+#ifdef TFTP_HAVE_UDP_GSO
+    // Kernels without UDP GSO reject the option itself
+    int segment = 0;
+    socklen_t length = sizeof(segment);
+    return getsockopt(socket, SOL_UDP, UDP_SEGMENT, &segment, &length) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+size_t udpGsoSegmentsPerSend(size_t segment_size) {
+    if (segment_size == 0) {
+        return 1;
+    }
+    return std::max<size_t>(1, std::min(TFTP_GSO_MAX_SEGMENTS, TFTP_GSO_MAX_BYTES / segment_size));
+}
+
+ssize_t sendUdpSegments(socket_t socket, const uint8_t* data, size_t size, size_t segment_size,
+                        const struct sockaddr* addr, socklen_t addr_len) {
+#ifdef TFTP_HAVE_UDP_GSO
+    struct iovec buffer;
+    buffer.iov_base = const_cast<uint8_t*>(data);
+    buffer.iov_len = size;
+
+    // The segment size travels with this send only, so other sends on the socket are unaffected
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))];
+    std::memset(control, 0, sizeof(control));
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_name = const_cast<struct sockaddr*>(addr);
+    message.msg_namelen = addr_len;
+    message.msg_iov = &buffer;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_UDP;
+    header->cmsg_type = UDP_SEGMENT;
+    header->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segment = static_cast<uint16_t>(segment_size);
+    std::memcpy(CMSG_DATA(header), &segment, sizeof(segment));
+
+    return sendmsg(socket, &message, 0);
+#else
+    (void)socket;
+    (void)data;
+    (void)size;
+    (void)segment_size;
+    (void)addr;
+    (void)addr_len;
+    errno = EOPNOTSUPP;
+    return -1;
+#endif
+}
+
+bool isUdpGsoUnsupportedError(int error) {
+    // EIO: the outgoing device cannot checksum the segments. EINVAL is left
+    // out, as it also means this send's segments exceed the path MTU
+    return error == EIO || error == ENOPROTOOPT || error == EOPNOTSUPP;
+}
+
+} // namespace simple_tftpd
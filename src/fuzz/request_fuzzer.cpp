@@ -0,0 +1,81 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Fuzz target for RRQ/WRQ decoding and RFC 2347 option parsing.
+ *
+ * Checks that malformed input never crashes, and that anything accepted
+ * re-encodes to a request that decodes to the same filename, mode and
+ * options.
+ */
+
+#include "simple-tftpd/core/tftp/codec.hpp"
+#include "simple-tftpd/core/tftp/packet.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+using namespace simple_tftpd;
+
+namespace {
+
+bool sameOptions(const TftpOptions& a, const TftpOptions& b) {
+    return a.has_blksize == b.has_blksize && (!a.has_blksize || a.blksize == b.blksize) &&
+           a.has_timeout == b.has_timeout && (!a.has_timeout || a.timeout == b.timeout) &&
+           a.has_tsize == b.has_tsize && (!a.has_tsize || a.tsize == b.tsize) &&
+           a.has_windowsize == b.has_windowsize && (!a.has_windowsize || a.windowsize == b.windowsize) &&
+           a.multicast == b.multicast && a.multicast_ip == b.multicast_ip &&
+           a.multicast_port == b.multicast_port && a.multicast_master == b.multicast_master;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    // The owning packet class must agree with the codec on acceptance
+    TftpRequestPacket packet(data, size);
+
+    TftpRequestView view;
+    if (!TftpCodec::decodeRequest(data, size, view)) {
+        if (packet.isValid()) {
+            std::abort();
+        }
+        return 0;
+    }
+
+    TftpOptions options;
+    TftpCodec::decodeOptions(view.options, options);
+    if (!sameOptions(options, packet.getOptions()) || view.filename != packet.getFilename()) {
+        std::abort();
+    }
+
+    std::vector<uint8_t> wire(2 + view.filename.size() + 1 + 9 + TftpCodec::MAX_OPTIONS_SIZE);
+    size_t length = TftpCodec::encodeRequest(wire.data(), wire.size(), view.opcode, view.filename, view.mode, options);
+    if (length == 0) {
+        std::abort();
+    }
+
+    TftpRequestView again;
+    TftpOptions again_options;
+    if (!TftpCodec::decodeRequest(wire.data(), length, again) ||
+        !TftpCodec::decodeOptions(again.options, again_options) ||
+        again.opcode != view.opcode || again.filename != view.filename || again.mode != view.mode ||
+        !sameOptions(again_options, options)) {
+        std::abort();
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Standalone driver for fuzz targets when libFuzzer is not available
+ * (GCC builds). Replays files given on the command line; with no
+ * arguments it runs a fixed-seed mutation loop over built-in seeds so the
+ * target still gets exercised in CTest.
+ *
+ * Usage: <target> [--runs N] [FILE...]
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+
+std::vector<uint8_t> bytes(const char* text, size_t length) {
+    return std::vector<uint8_t>(text, text + length);
+}
+
+#define SEED(literal) bytes(literal, sizeof(literal) - 1)
+
+std::vector<std::vector<uint8_t>> builtinSeeds() {
+    return {
+        SEED("\x00\x01pxelinux.0\x00octet\x00"),
+        SEED("\x00\x01boot/grub.cfg\x00NetASCII\x00blksize\x00" "1428\x00tsize\x00" "0\x00"),
+        SEED("\x00\x02upload.bin\x00octet\x00tsize\x00" "1048576\x00windowsize\x00" "16\x00timeout\x00" "3\x00"),
+        SEED("\x00\x01" "a\x00" "octet\x00" "BLKSIZE\x00" "99999999999999999999\x00" "utimeout\x00" "500\x00"),
+        SEED("\x00\x01" "a\x00" "octet\x00" "tsize\x00" "-1\x00" "blksize\x00"),
+        SEED("\x00\x01" "image.img\x00" "octet\x00" "multicast\x00\x00" "multicast\x00" "239.255.68.1,1758,1\x00"),
+    };
+}
+
+void mutate(std::vector<uint8_t>& input, std::mt19937& rng) {
+    static const char tokens[][12] = {"blksize", "tsize", "timeout", "windowsize", "multicast", ",1758,1", "0", "65535",
+                                      "4294967296", ""};
+    switch (rng() % 6) {
+        case 0:  // flip a byte
+            if (!input.empty()) {
+                input[rng() % input.size()] ^= static_cast<uint8_t>(1u << (rng() % 8));
+            }
+            break;
+        case 1:  // truncate
+            if (!input.empty()) {
+                input.resize(rng() % input.size());
+            }
+            break;
+        case 2:  // insert NUL
+            input.insert(input.begin() + static_cast<long>(input.empty() ? 0 : rng() % input.size()), 0);
+            break;
+        case 3: {  // append an option token
+            const char* token = tokens[rng() % (sizeof(tokens) / sizeof(tokens[0]))];
+            input.insert(input.end(), token, token + std::strlen(token));
+            input.push_back(0);
+            break;
+        }
+        case 4:  // random byte
+            input.push_back(static_cast<uint8_t>(rng()));
+            break;
+        default:  // upper-case a byte
+            if (!input.empty()) {
+                uint8_t& byte = input[rng() % input.size()];
+                if (byte >= 'a' && byte <= 'z') {
+                    byte = static_cast<uint8_t>(byte - 'a' + 'A');
+                }
+            }
+            break;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    long runs = 200000;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = std::strtol(argv[++i], nullptr, 10);
+        } else {
+            files.emplace_back(argv[i]);
+        }
+    }
+
+    if (!files.empty()) {
+        for (const auto& path : files) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                std::cerr << "Cannot open " << path << std::endl;
+                return 2;
+            }
+            std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            LLVMFuzzerTestOneInput(input.data(), input.size());
+        }
+        std::cout << "Replayed " << files.size() << " input(s)" << std::endl;
+        return 0;
+    }
+
+    std::mt19937 rng(1);
+    std::vector<std::vector<uint8_t>> seeds = builtinSeeds();
+    for (long run = 0; run < runs; ++run) {
+        std::vector<uint8_t> input = seeds[static_cast<size_t>(run) % seeds.size()];
+        int rounds = 1 + static_cast<int>(rng() % 8);
+        for (int r = 0; r < rounds; ++r) {
+            mutate(input, rng);
+        }
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    std::cout << "Executed " << runs << " mutated input(s)" << std::endl;
+    return 0;
+}
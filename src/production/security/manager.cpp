@@ -19,6 +19,9 @@ ProductionSecurityManager::ProductionSecurityManager(std::shared_ptr<TftpConfig>
     if (logger_) {
         logger_->log(LogLevel::INFO, "Production Security Manager initialized");
     }
+    if (config) {
+        reportPolicy(*config);
+    }
 }
 
 ProductionSecurityManager::~ProductionSecurityManager() = default;
@@ -26,17 +29,17 @@ ProductionSecurityManager::~ProductionSecurityManager() = default;
 bool ProductionSecurityManager::validateFileAccess(const std::string& filename,
                                                    const std::string& client_address,
                                                    bool for_write) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-
-    if (!config_) {
+    auto config = config_.load();
+    if (!config) {
         if (logger_) {
             logger_->log(LogLevel::ERROR, "Security validation failed: no configuration");
         }
         return false;
     }
+    auto policy = config->getAccessPolicy();
 
     // Check client IP address
-    if (!isClientAllowed(client_address)) {
+    if (!policy->isClientAllowed(client_address)) {
         if (logger_) {
             logger_->log(LogLevel::WARNING, "Client not allowed: " + client_address);
         }
@@ -44,14 +47,14 @@ bool ProductionSecurityManager::validateFileAccess(const std::string& filename,
     }
 
     // Check if operation is allowed
-    if (for_write && !config_->isWriteEnabled()) {
+    if (for_write && !config->isWriteEnabled()) {
         if (logger_) {
             logger_->log(LogLevel::WARNING, "Write operations are disabled");
         }
         return false;
     }
 
-    if (!for_write && !config_->isReadEnabled()) {
+    if (!for_write && !config->isReadEnabled()) {
         if (logger_) {
             logger_->log(LogLevel::WARNING, "Read operations are disabled");
         }
@@ -79,9 +82,9 @@ bool ProductionSecurityManager::validateFileAccess(const std::string& filename,
     std::string::size_type last_slash = normalized_path.find_last_of('/');
     std::string dir_path = (last_slash != std::string::npos)
         ? normalized_path.substr(0, last_slash)
-        : config_->getRootDirectory();
+        : config->getRootDirectory();
 
-    if (!isDirectoryAllowed(dir_path)) {
+    if (!policy->isDirectoryAllowed(dir_path)) {
         if (logger_) {
             logger_->log(LogLevel::WARNING, "Directory not allowed: " + dir_path);
         }
@@ -94,7 +97,7 @@ bool ProductionSecurityManager::validateFileAccess(const std::string& filename,
         ? std::string()
         : filename.substr(dot_pos + 1);
 
-    if (!isExtensionAllowed(extension)) {
+    if (!policy->isExtensionAllowed(extension)) {
         if (logger_) {
             logger_->log(LogLevel::WARNING, "File extension not allowed: " + filename);
         }
@@ -105,77 +108,32 @@ bool ProductionSecurityManager::validateFileAccess(const std::string& filename,
 }
 
 bool ProductionSecurityManager::isClientAllowed(const std::string& address) const {
-    if (!config_) {
+    auto config = config_.load();
+    if (!config) {
         return true; // Default allow if no config
     }
-
-    const auto& allowed_clients = config_->getAllowedClients();
-    if (allowed_clients.empty()) {
-        return true; // No restrictions
-    }
-
-    // Check exact match
-    for (const auto& allowed : allowed_clients) {
-        if (address == allowed) {
-            return true;
-        }
-
-        // Check CIDR notation (basic implementation)
-        if (allowed.find('/') != std::string::npos) {
-            // TODO: Implement CIDR matching
-            // For now, check if address starts with the prefix
-            std::string prefix = allowed.substr(0, allowed.find('/'));
-            if (address.find(prefix) == 0) {
-                return true;
-            }
-        }
-    }
-
-    return false;
+    return config->getAccessPolicy()->isClientAllowed(address);
 }
 
 bool ProductionSecurityManager::isDirectoryAllowed(const std::string& dir_path) const {
-    if (!config_) {
+    auto config = config_.load();
+    if (!config) {
         return true;
     }
-
-    const auto& allowed_dirs = config_->getAllowedDirectories();
-    if (allowed_dirs.empty()) {
-        return true; // No restrictions
-    }
-
-    // Check if directory is in allowed list
-    for (const auto& allowed : allowed_dirs) {
-        if (dir_path == allowed || dir_path.find(allowed + "/") == 0) {
-            return true;
-        }
-    }
-
-    return false;
+    return config->getAccessPolicy()->isDirectoryAllowed(dir_path);
 }
 
 bool ProductionSecurityManager::isExtensionAllowed(const std::string& extension) const {
-    if (!config_) {
+    auto config = config_.load();
+    if (!config) {
         return true;
     }
-
-    const auto& allowed_extensions = config_->getAllowedExtensions();
-    if (allowed_extensions.empty()) {
-        return true; // No restrictions
-    }
-
-    // Check if extension is in allowed list
-    for (const auto& allowed : allowed_extensions) {
-        if (extension == allowed) {
-            return true;
-        }
-    }
-
-    return false;
+    return config->getAccessPolicy()->isExtensionAllowed(extension);
 }
 
 bool ProductionSecurityManager::normalizePath(const std::string& filename, std::string& normalized_path) const {
-    if (!config_) {
+    auto config = config_.load();
+    if (!config) {
         return false;
     }
 
@@ -185,7 +143,7 @@ bool ProductionSecurityManager::normalizePath(const std::string& filename, std::
     }
 
     // Build full path
-    std::string root_dir = config_->getRootDirectory();
+    std::string root_dir = config->getRootDirectory();
     std::string full_path = root_dir + "/" + filename;
 
     // Normalize path (remove double slashes, etc.)
@@ -212,11 +170,12 @@ bool ProductionSecurityManager::normalizePath(const std::string& filename, std::
 }
 
 bool ProductionSecurityManager::isFileSizeAllowed(size_t file_size) const {
-    if (!config_) {
+    auto config = config_.load();
+    if (!config) {
         return true;
     }
 
-    size_t max_size = config_->getMaxFileSize();
+    size_t max_size = config->getMaxFileSize();
     if (max_size == 0) {
         return true; // No limit
     }
@@ -225,22 +184,43 @@ bool ProductionSecurityManager::isFileSizeAllowed(size_t file_size) const {
 }
 
 bool ProductionSecurityManager::isOverwriteAllowed(const std::string& filename) const {
-    if (!config_) {
+    auto config = config_.load();
+    if (!config) {
         return true;
     }
 
-    return !config_->isOverwriteProtectionEnabled();
+    return !config->isOverwriteProtectionEnabled();
 }
 
 bool ProductionSecurityManager::reloadConfiguration() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    // Configuration is managed externally, just log reload
+    // The configuration recompiles its policy whenever its lists change
+    auto config = config_.load();
+    if (config) {
+        reportPolicy(*config);
+    }
     if (logger_) {
         logger_->log(LogLevel::INFO, "Security configuration reloaded");
     }
     return true;
 }
 
+bool ProductionSecurityManager::reloadConfiguration(std::shared_ptr<TftpConfig> config) {
+    if (!config) {
+        return false;
+    }
+    config_.store(config);
+    return reloadConfiguration();
+}
+
+void ProductionSecurityManager::reportPolicy(const TftpConfig& config) const {
+    if (!logger_) {
+        return;
+    }
+    for (const auto& rule : config.getAccessPolicy()->getRejectedClients()) {
+        logger_->log(LogLevel::WARNING, "Ignoring invalid allowed_clients entry: " + rule);
+    }
+}
+
 bool ProductionSecurityManager::checkPathTraversal(const std::string& path) const {
     // Check for path traversal patterns
     if (path.find("..") != std::string::npos) {
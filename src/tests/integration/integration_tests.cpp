@@ -10,19 +10,362 @@
 
 #include <gtest/gtest.h>
 #include "simple-tftpd/core/tftp/server.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
 #include "simple-tftpd/core/config/config.hpp"
 #include "simple-tftpd/core/utils/logger.hpp"
 #include "tftp_client.hpp"
 #include "../utils/test_helpers.hpp"
+#include "../utils/http_origin.hpp"
 #include <thread>
 #include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <vector>
 #include <string>
+#include <map>
+#include <set>
+#include <cstring>
 
 using namespace simple_tftpd;
 using namespace simple_tftpd::test;
 
+namespace {
+
+/**
+ * @brief Minimal RFC 2090 client: RRQ and ACKs over unicast, DATA from the group
+ */
+class MulticastTestClient {
+public:
+    MulticastTestClient(port_t server_port, std::string filename)
+        : server_port_(server_port), filename_(std::move(filename)) {}
+
+    ~MulticastTestClient() {
+        if (unicast_socket_ >= 0) {
+            close(unicast_socket_);
+        }
+        if (group_socket_ >= 0) {
+            close(group_socket_);
+        }
+    }
+
+    /** Send the RRQ and join the group advertised in the OACK */
+    bool join() {
+        unicast_socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+        struct timeval timeout{2, 0};
+        setsockopt(unicast_socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        TftpOptions options;
+        options.multicast = true;
+        options.has_tsize = true;
+        uint8_t request[128];
+        size_t length = TftpCodec::encodeRequest(request, sizeof(request), TftpOpcode::RRQ,
+                                                 filename_, TftpMode::OCTET, options);
+        struct sockaddr_in server{};
+        server.sin_family = AF_INET;
+        server.sin_port = htons(server_port_);
+        inet_pton(AF_INET, "127.0.0.1", &server.sin_addr);
+        sendto(unicast_socket_, request, length, 0, reinterpret_cast<struct sockaddr*>(&server), sizeof(server));
+
+        uint8_t buffer[512];
+        socklen_t server_len = sizeof(session_);
+        ssize_t received = recvfrom(unicast_socket_, buffer, sizeof(buffer), 0,
+                                    reinterpret_cast<struct sockaddr*>(&session_), &server_len);
+        if (received < 2 || buffer[1] != static_cast<uint8_t>(TftpOpcode::OACK) || !applyOptionAck(buffer, received)) {
+            return false;
+        }
+        total_blocks_ = tsize_ / 512 + 1;
+
+        group_socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+        int reuse = 1;
+        setsockopt(group_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(group_port_);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        struct ip_mreq membership{};
+        inet_pton(AF_INET, group_address_.c_str(), &membership.imr_multiaddr);
+        inet_pton(AF_INET, "127.0.0.1", &membership.imr_interface);
+        return bind(group_socket_, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) == 0 &&
+               setsockopt(group_socket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) == 0;
+    }
+
+    /** Drain both sockets; the master ACKs the highest contiguous block */
+    void pump() {
+        if (done_) {
+            return;
+        }
+
+        uint8_t buffer[TftpCodec::HEADER_SIZE + 512];
+        ssize_t received;
+        while ((received = recv(group_socket_, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            TftpDataView data;
+            if (TftpCodec::decodeData(buffer, static_cast<size_t>(received), data) && data.block != 0) {
+                blocks_.emplace(data.block, std::vector<uint8_t>(data.payload.data, data.payload.data + data.payload.size));
+            }
+        }
+        while ((received = recv(unicast_socket_, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            if (buffer[1] == static_cast<uint8_t>(TftpOpcode::OACK) && applyOptionAck(buffer, received) && master_) {
+                acked_ = -1;  // promoted: report what we hold
+            }
+        }
+
+        int contiguous = 0;
+        while (blocks_.count(static_cast<uint16_t>(contiguous + 1))) {
+            ++contiguous;
+        }
+        if (contiguous == total_blocks_) {
+            // Every client leaves with an ACK of the final block
+            sendAck(static_cast<uint16_t>(contiguous));
+            done_ = true;
+        } else if (master_ && contiguous != acked_) {
+            sendAck(static_cast<uint16_t>(contiguous));
+            acked_ = contiguous;
+        }
+    }
+
+    bool isDone() const { return done_; }
+    bool wasMaster() const { return master_; }
+    size_t blockCount() const { return blocks_.size(); }
+
+    std::vector<uint8_t> data() const {
+        std::vector<uint8_t> result;
+        for (const auto& block : blocks_) {
+            result.insert(result.end(), block.second.begin(), block.second.end());
+        }
+        return result;
+    }
+
+private:
+    bool applyOptionAck(const uint8_t* buffer, ssize_t size) {
+        TftpOptions options;
+        if (!TftpCodec::decodeOptions(ByteView(buffer + 2, static_cast<size_t>(size) - 2), options) ||
+            !options.multicast) {
+            return false;
+        }
+        if (!options.multicast_ip.empty()) {
+            group_address_ = options.multicast_ip;
+            group_port_ = options.multicast_port;
+        }
+        if (options.has_tsize) {
+            tsize_ = options.tsize;
+        }
+        master_ = options.multicast_master;
+        return true;
+    }
+
+    void sendAck(uint16_t block) {
+        uint8_t ack[TftpCodec::HEADER_SIZE];
+        TftpCodec::encodeAck(ack, sizeof(ack), block);
+        sendto(unicast_socket_, ack, sizeof(ack), 0, reinterpret_cast<struct sockaddr*>(&session_), sizeof(session_));
+    }
+
+    port_t server_port_;
+    std::string filename_;
+    int unicast_socket_ = -1;
+    int group_socket_ = -1;
+    struct sockaddr_in session_{};
+    std::string group_address_;
+    port_t group_port_ = 0;
+    uint32_t tsize_ = 0;
+    int total_blocks_ = 0;
+    bool master_ = false;
+    int acked_ = -1;
+    bool done_ = false;
+    std::map<uint16_t, std::vector<uint8_t>> blocks_;
+};
+
+bool pumpUntilDone(std::vector<MulticastTestClient*> clients, std::chrono::seconds limit) {
+    auto deadline = std::chrono::steady_clock::now() + limit;
+    while (std::chrono::steady_clock::now() < deadline) {
+        bool all_done = true;
+        for (auto* client : clients) {
+            client->pump();
+            all_done = all_done && client->isDone();
+        }
+        if (all_done) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+/**
+ * @brief RFC 7440 reader that ACKs only the last block of each window
+ * @param port Server port
+ * @param filename File to read
+ * @param windowsize Window to request
+ * @param data Receives the file
+ * @param duplicates Receives the number of DATA packets received twice or out of order
+ * @param drop Blocks whose first copy is ignored, as if lost
+ * @param timeout Timeout option to request in seconds, 0 for none
+ * @param ack_each At the end of a window, ACK each of its blocks in a burst instead
+ * @param report_gaps On the first block past a gap, ACK the last block in sequence (RFC 7440)
+ * @return true if the final block arrived
+ */
+bool readAckingWindowEnds(port_t port, const std::string& filename, uint16_t windowsize,
+                          std::vector<uint8_t>& data, int& duplicates,
+                          const std::set<uint16_t>& drop = {}, uint8_t timeout = 0, bool ack_each = false,
+                          bool report_gaps = false) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval wait{3, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+
+    TftpOptions options;
+    options.has_windowsize = true;
+    options.windowsize = windowsize;
+    options.has_timeout = timeout > 0;
+    options.timeout = timeout;
+    uint8_t packet[1024];
+    size_t length = TftpCodec::encodeRequest(packet, sizeof(packet), TftpOpcode::RRQ, filename,
+                                             TftpMode::OCTET, options);
+    struct sockaddr_in peer{};
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &peer.sin_addr);
+    sendto(sock, packet, length, 0, reinterpret_cast<struct sockaddr*>(&peer), sizeof(peer));
+
+    duplicates = 0;
+    std::set<uint16_t> lost;
+    uint16_t expected = 1;
+    uint16_t reported = 0;
+    bool done = false;
+    while (!done) {
+        socklen_t peer_len = sizeof(peer);
+        ssize_t received = recvfrom(sock, packet, sizeof(packet), 0, reinterpret_cast<struct sockaddr*>(&peer),
+                                    &peer_len);
+        if (received < 4) {
+            break;
+        }
+        uint8_t ack[TftpCodec::HEADER_SIZE];
+        TftpOpcode opcode;
+        TftpDataView view;
+        if (TftpCodec::peekOpcode(packet, static_cast<size_t>(received), opcode) && opcode == TftpOpcode::OACK) {
+            TftpCodec::encodeAck(ack, sizeof(ack), 0);
+            sendto(sock, ack, sizeof(ack), 0, reinterpret_cast<struct sockaddr*>(&peer), sizeof(peer));
+            continue;
+        }
+        if (!TftpCodec::decodeData(packet, static_cast<size_t>(received), view)) {
+            break;
+        }
+        if (drop.count(view.block) > 0 && lost.insert(view.block).second) {
+            continue;
+        }
+        if (view.block != expected) {
+            duplicates++;
+            if (report_gaps && view.block > expected && reported != expected) {
+                reported = expected;
+                TftpCodec::encodeAck(ack, sizeof(ack), static_cast<uint16_t>(expected - 1));
+                sendto(sock, ack, sizeof(ack), 0, reinterpret_cast<struct sockaddr*>(&peer), sizeof(peer));
+            }
+            continue;
+        }
+        data.insert(data.end(), view.payload.begin(), view.payload.end());
+        done = view.payload.size < 512;
+        if (done || expected % windowsize == 0) {
+            uint16_t first = ack_each ? static_cast<uint16_t>((expected - 1) / windowsize * windowsize + 1) : expected;
+            for (uint16_t block = first; block <= expected; ++block) {
+                TftpCodec::encodeAck(ack, sizeof(ack), block);
+                sendto(sock, ack, sizeof(ack), 0, reinterpret_cast<struct sockaddr*>(&peer), sizeof(peer));
+            }
+        }
+        expected++;
+    }
+    close(sock);
+    return done;
+}
+
+/**
+ * @brief RFC 7440 writer that sends the third and fourth block of each window swapped
+ * @param port Server port
+ * @param filename File to write
+ * @param data File contents, sent in 512-byte blocks
+ * @param windowsize Window to request
+ * @param acks Receives the number of ACKs for DATA blocks
+ * @param drop Blocks whose first copy is not sent, as if lost
+ * @param pace Pause after each block, as on a slow link
+ * @return true if the final block was acknowledged
+ */
+bool writeSwappingBlocks(port_t port, const std::string& filename, const std::vector<uint8_t>& data,
+                         uint16_t windowsize, int& acks, const std::set<uint16_t>& drop = {},
+                         std::chrono::milliseconds pace = std::chrono::milliseconds(0)) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct timeval wait{3, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+
+    TftpOptions options;
+    options.has_windowsize = true;
+    options.windowsize = windowsize;
+    uint8_t packet[1024];
+    size_t length = TftpCodec::encodeRequest(packet, sizeof(packet), TftpOpcode::WRQ, filename,
+                                             TftpMode::OCTET, options);
+    struct sockaddr_in peer{};
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &peer.sin_addr);
+    sendto(sock, packet, length, 0, reinterpret_cast<struct sockaddr*>(&peer), sizeof(peer));
+
+    uint16_t blocks = static_cast<uint16_t>(data.size() / 512 + 1);
+    std::set<uint16_t> lost;
+    auto sendBlock = [&](uint16_t block) {
+        if (drop.count(block) > 0 && lost.insert(block).second) {
+            return;
+        }
+        size_t offset = static_cast<size_t>(block - 1) * 512;
+        ByteView payload(data.data() + offset, std::min<size_t>(512, data.size() - offset));
+        size_t frame = TftpCodec::encodeData(packet, sizeof(packet), block, payload);
+        sendto(sock, packet, frame, 0, reinterpret_cast<struct sockaddr*>(&peer), sizeof(peer));
+        std::this_thread::sleep_for(pace);
+    };
+
+    acks = 0;
+    uint16_t acked = 0;
+    bool started = false;
+    while (acked < blocks) {
+        socklen_t peer_len = sizeof(peer);
+        ssize_t received = recvfrom(sock, packet, sizeof(packet), 0, reinterpret_cast<struct sockaddr*>(&peer),
+                                    &peer_len);
+        if (received < 4) {
+            break;
+        }
+        TftpOpcode opcode;
+        TftpAckView ack;
+        if (!TftpCodec::peekOpcode(packet, static_cast<size_t>(received), opcode)) {
+            break;
+        }
+        if (opcode != TftpOpcode::OACK &&
+            (opcode != TftpOpcode::ACK || !TftpCodec::decodeAck(packet, static_cast<size_t>(received), ack))) {
+            break;
+        }
+        // The OACK or ACK 0 starts the transfer; later ACKs must move it forward
+        if (started && ack.block <= acked) {
+            continue;
+        }
+        if (ack.block > acked) {
+            acks++;
+            acked = ack.block;
+        }
+        started = true;
+
+        // Go back N from the ACK, with two blocks of the window out of order
+        uint16_t last = static_cast<uint16_t>(std::min<uint32_t>(blocks, acked + windowsize));
+        for (uint16_t block = acked + 1; block <= last; ++block) {
+            uint16_t position = block - acked;
+            if (position == 3 && block < last) {
+                sendBlock(block + 1);
+            } else if (position == 4) {
+                sendBlock(block - 1);
+            } else {
+                sendBlock(block);
+            }
+        }
+    }
+    close(sock);
+    return acked == blocks;
+}
+
+} // namespace
+
 class IntegrationTestFixture : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -217,6 +560,228 @@ TEST_F(IntegrationTestFixture, WindowsizeOption) {
     ASSERT_EQ(received.size(), data.size());
 }
 
+TEST_F(IntegrationTestFixture, WindowAcknowledgedByLastBlock) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(10 * 512 + 100);
+    helpers_->createTestFile("window_ends.bin", std::string(data.begin(), data.end()));
+
+    config_->setWindowSize(4);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // One ACK per window releases the whole window, so nothing waits for a timeout
+    auto started = std::chrono::steady_clock::now();
+    std::vector<uint8_t> received;
+    int duplicates = 0;
+    ASSERT_TRUE(readAckingWindowEnds(test_port_, "window_ends.bin", 4, received, duplicates));
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+    EXPECT_EQ(received, data);
+    EXPECT_EQ(duplicates, 0);
+}
+
+TEST_F(IntegrationTestFixture, WindowedWriteReordersAndAcksPerWindow) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(40 * 512 + 100);
+    config_->setWindowSize(8);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Blocks swapped within a window are held, not dropped, and each window gets one ACK
+    int acks = 0;
+    ASSERT_TRUE(writeSwappingBlocks(test_port_, "reordered.bin", data, 8, acks));
+    EXPECT_EQ(acks, 6);
+    std::string written = helpers_->readFile(test_dir_ + "/reordered.bin");
+    EXPECT_EQ(std::vector<uint8_t>(written.begin(), written.end()), data);
+
+    // A lost block is reported at the end of its window, without waiting for a timeout
+    auto started = std::chrono::steady_clock::now();
+    ASSERT_TRUE(writeSwappingBlocks(test_port_, "gap.bin", data, 8, acks, {5, 30}));
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+    EXPECT_EQ(acks, 8);
+    written = helpers_->readFile(test_dir_ + "/gap.bin");
+    EXPECT_EQ(std::vector<uint8_t>(written.begin(), written.end()), data);
+}
+
+TEST_F(IntegrationTestFixture, SlowWindowedWriteNotAckedEarly) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(16 * 512 + 40);
+    config_->setWindowSize(8);
+    config_->setTimeout(1);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Each window takes 1.6 s to arrive, longer than the timeout, but blocks
+    // keep coming, so the server ACKs only at window ends
+    int acks = 0;
+    ASSERT_TRUE(writeSwappingBlocks(test_port_, "slow.bin", data, 8, acks, {}, std::chrono::milliseconds(200)));
+    EXPECT_EQ(acks, 3);
+    std::string written = helpers_->readFile(test_dir_ + "/slow.bin");
+    EXPECT_EQ(std::vector<uint8_t>(written.begin(), written.end()), data);
+}
+
+TEST_F(IntegrationTestFixture, BurstOfAcksCoalesced) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(64 * 16 * 512 + 7);
+    helpers_->createTestFile("ack_burst.bin", std::string(data.begin(), data.end()));
+    config_->setWindowSize(16);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Each window is answered by 16 ACKs sent back to back; those found in
+    // one receive batch are handled as the newest of them
+    std::vector<uint8_t> received;
+    int duplicates = 0;
+    ASSERT_TRUE(readAckingWindowEnds(test_port_, "ack_burst.bin", 16, received, duplicates, {}, 0, true));
+    EXPECT_EQ(received, data);
+    EXPECT_EQ(duplicates, 0);
+
+    TftpListenerStats stats = server_->getListenerStats();
+    EXPECT_GT(stats.acks_coalesced, 0u);
+    EXPECT_LT(stats.batches, stats.packets);
+}
+
+TEST_F(IntegrationTestFixture, UdpGsoWindowedRead) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(100 * 512 + 33);
+    helpers_->createTestFile("gso.bin", std::string(data.begin(), data.end()));
+    config_->setWindowSize(16);
+    config_->setUdpGso(true);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Block 40 is lost once and resent after the 1 s timeout, with the rest of its window
+    std::vector<uint8_t> received;
+    int duplicates = 0;
+    ASSERT_TRUE(readAckingWindowEnds(test_port_, "gso.bin", 16, received, duplicates, {40}, 1));
+    EXPECT_EQ(received, data);
+
+    // Without kernel support the same datagrams go out one per call
+    TftpSendStats stats = server_->getSendStats();
+    EXPECT_GE(stats.datagrams, 101u);
+    if (stats.gso_enabled) {
+        EXPECT_GT(stats.gso_sends, 0u);
+        EXPECT_GT(stats.datagrams, 4 * stats.calls);
+    } else {
+        EXPECT_EQ(stats.gso_sends, 0u);
+        EXPECT_EQ(stats.datagrams, stats.calls);
+    }
+}
+
+TEST_F(IntegrationTestFixture, GapAckResendsWithoutTimeout) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(40 * 512 + 17);
+    helpers_->createTestFile("gap_ack.bin", std::string(data.begin(), data.end()));
+    config_->setWindowSize(8);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Blocks 5 and 20 are lost once; the client's ACK for the block before
+    // each gap brings the rest of the window again, long before the 5 s timeout
+    auto started = std::chrono::steady_clock::now();
+    std::vector<uint8_t> received;
+    int duplicates = 0;
+    ASSERT_TRUE(readAckingWindowEnds(test_port_, "gap_ack.bin", 8, received, duplicates, {5, 20}, 5, false, true));
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+    EXPECT_EQ(received, data);
+}
+
+TEST_F(IntegrationTestFixture, RetransmitFromFileUnderLoss) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(40 * 512 + 17);
+    helpers_->createTestFile("lossy.bin", std::string(data.begin(), data.end()));
+    config_->setWindowSize(8);
+    // Read from the file, not from frames shared through the block cache
+    config_->setBlockCacheSize(0);
+
+    // Blocks 5 and 20 are lost once; the server resends them after the 1 s timeout
+    auto lossyRead = [&](bool from_file, uint64_t& buffered, uint64_t& retransmits) {
+        config_->setRetransmitFromFile(from_file);
+        server_->stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        server_ = std::make_shared<TftpServer>(config_, logger_);
+        ASSERT_TRUE(server_->start());
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        std::vector<uint8_t> received;
+        int duplicates = 0;
+        std::atomic<bool> done{false};
+        bool complete = false;
+        std::thread reader([&] {
+            complete = readAckingWindowEnds(test_port_, "lossy.bin", 8, received, duplicates, {5, 20}, 1);
+            done = true;
+        });
+        buffered = 0;
+        retransmits = 0;
+        while (!done) {
+            for (const auto& telemetry : server_->getConnectionTelemetry()) {
+                buffered = std::max(buffered, telemetry.retransmit_buffer_bytes);
+                retransmits = std::max(retransmits, telemetry.retransmits);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        reader.join();
+        EXPECT_TRUE(complete);
+        EXPECT_EQ(received, data);
+    };
+
+    // Blocks in flight only record their offset: nothing is held per block
+    uint64_t buffered = 0;
+    uint64_t retransmits = 0;
+    lossyRead(true, buffered, retransmits);
+    EXPECT_EQ(buffered, 0u);
+    EXPECT_GT(retransmits, 0u);
+
+    // By default each block in flight keeps a copy of its payload
+    lossyRead(false, buffered, retransmits);
+    EXPECT_GE(buffered, 8u * 512);
+    EXPECT_GT(retransmits, 0u);
+}
+
+TEST_F(IntegrationTestFixture, RetransmitFromFileRewrittenInPlace) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(40 * 512 + 17);
+    std::string path = helpers_->createTestFile("rewritten.bin", std::string(data.begin(), data.end()));
+    config_->setWindowSize(8);
+    config_->setBlockCacheSize(0);
+    config_->setRetransmitFromFile(true);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Block 5 is lost; before its 1 s timeout the file is overwritten at the same size
+    std::vector<uint8_t> received;
+    int duplicates = 0;
+    bool complete = true;
+    std::thread reader([&] {
+        complete = readAckingWindowEnds(test_port_, "rewritten.bin", 8, received, duplicates, {5}, 1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        std::string replacement(data.size(), 'x');
+        file.write(replacement.data(), static_cast<std::streamsize>(replacement.size()));
+    }
+    std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(1));
+    reader.join();
+
+    // The retransmit is refused rather than mixing new bytes into the old image
+    EXPECT_FALSE(complete);
+    EXPECT_EQ(received.size(), 4u * 512);
+    EXPECT_TRUE(std::equal(received.begin(), received.end(), data.begin()));
+}
+
 TEST_F(IntegrationTestFixture, MultipleOptions) {
     std::string content = "Test multiple options";
     helpers_->createTestFile("multiopt_test.txt", content);
@@ -403,3 +968,543 @@ TEST_F(IntegrationTestFixture, SpecialCharactersInFilename) {
     ASSERT_TRUE(client_->isSuccess());
 }
 
+TEST_F(IntegrationTestFixture, RepeatedReadsServedFromBlockCache) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(20 * 512 + 17);
+    helpers_->createTestFile("cached.bin", std::string(data.begin(), data.end()));
+
+    for (int i = 0; i < 3; ++i) {
+        TftpClient reader("127.0.0.1", test_port_);
+        std::vector<uint8_t> received = reader.readFile("cached.bin", "octet");
+        ASSERT_TRUE(reader.isSuccess()) << "Read failed: " << reader.getLastError();
+        ASSERT_EQ(received, data);
+    }
+
+    // Only the first reader loaded the file; the others sent cached frames
+    TftpBlockCacheStats stats = server_->getBlockCacheStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_NEAR(stats.hitRatio(), 2.0 / 3.0, 0.01);
+}
+
+// Finished connections are stopped by the cleanup thread, outside the table lock
+TEST_F(IntegrationTestFixture, FinishedConnectionsReclaimedOffListener) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(4 * 512 + 9);
+    helpers_->createTestFile("reclaim.bin", std::string(data.begin(), data.end()));
+
+    for (int i = 0; i < 5; ++i) {
+        TftpClient reader("127.0.0.1", test_port_);
+        ASSERT_EQ(reader.readFile("reclaim.bin", "octet"), data);
+        ASSERT_TRUE(reader.isSuccess()) << "Read failed: " << reader.getLastError();
+    }
+    for (int i = 0; i < 300 && server_->getListenerStats().reclaimed < 5; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // Each transfer is an RRQ and one ACK per block
+    TftpListenerStats stats = server_->getListenerStats();
+    EXPECT_EQ(stats.reclaimed, 5u);
+    EXPECT_EQ(stats.pending_reclaim, 0u);
+    EXPECT_EQ(stats.packets, 5u * 6);
+    EXPECT_LE(stats.max_table_wait_ns, stats.table_wait_ns);
+    EXPECT_EQ(server_->getActiveConnectionCount(), 0u);
+    EXPECT_EQ(server_->getMetrics().transfers.successful_transfers, 5u);
+    EXPECT_NE(server_->getStatus().find("Listener: 30 packets"), std::string::npos);
+}
+
+TEST_F(IntegrationTestFixture, NetasciiTsizeIsConvertedLength) {
+    // Mixed endings: bare LFs grow by one byte, the CRLF stays as is
+    std::string content;
+    for (int i = 0; i < 300; ++i) {
+        content += "line " + std::to_string(i) + (i % 10 == 0 ? "\r\n" : "\n");
+    }
+    helpers_->createTestFile("lines.txt", content);
+
+    std::string expected;
+    for (size_t i = 0; i < content.size(); ++i) {
+        if (content[i] == '\n' && (i == 0 || content[i - 1] != '\r')) {
+            expected += '\r';
+        }
+        expected += content[i];
+    }
+
+    for (uint16_t blksize : {512, 1024}) {
+        TftpOptions options;
+        options.has_tsize = true;
+        options.has_blksize = true;
+        options.blksize = blksize;
+
+        TftpClient reader("127.0.0.1", test_port_);
+        std::vector<uint8_t> received = reader.readFile("lines.txt", "netascii", options);
+        ASSERT_TRUE(reader.isSuccess()) << "Read failed: " << reader.getLastError();
+        EXPECT_EQ(std::string(received.begin(), received.end()), expected);
+        ASSERT_TRUE(reader.getNegotiatedOptions().has_tsize);
+        EXPECT_EQ(reader.getNegotiatedOptions().tsize, expected.size());
+    }
+
+    // One conversion served both block sizes
+    TftpCacheStats stats = server_->getNetasciiCacheStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.bytes_used, expected.size());
+}
+
+TEST_F(IntegrationTestFixture, NetasciiUncachedBlocksAreFull) {
+    server_->getNetasciiCache().setCapacity(0);
+    server_->getBlockCache().setCapacity(0);
+
+    // Exactly two converted blocks, so the transfer ends with an empty block
+    std::string content(511, 'a');
+    content += '\n';
+    content += std::string(511, 'b');
+    helpers_->createTestFile("exact.txt", content);
+
+    TftpOptions options;
+    options.has_tsize = true;
+    TftpClient reader("127.0.0.1", test_port_);
+    std::vector<uint8_t> received = reader.readFile("exact.txt", "netascii", options);
+    ASSERT_TRUE(reader.isSuccess()) << "Read failed: " << reader.getLastError();
+    ASSERT_EQ(received.size(), 1024u);
+    EXPECT_EQ(reader.getNegotiatedOptions().tsize, 1024u);
+    EXPECT_EQ(received[511], '\r');
+    EXPECT_EQ(received[512], '\n');
+    EXPECT_EQ(server_->getNetasciiCacheStats().misses, 0u);
+}
+
+TEST_F(IntegrationTestFixture, CompressedSiblingServedTransparently) {
+    if (!TftpCompressedStore::isSupported(TftpCompression::GZIP)) {
+        GTEST_SKIP() << "Built without zlib";
+    }
+    config_->setCompressedFilesEnabled(true);
+
+    std::string text;
+    for (int i = 0; i < 2000; ++i) {
+        text += "firmware record " + std::to_string(i % 50) + "\n";
+    }
+    std::vector<uint8_t> data(text.begin(), text.end());
+    std::vector<uint8_t> compressed = helpers_->gzipData(data);
+    helpers_->createTestFile("firmware.img.gz", std::string(compressed.begin(), compressed.end()));
+
+    TftpOptions options;
+    options.has_tsize = true;
+    TftpClient reader("127.0.0.1", test_port_);
+    std::vector<uint8_t> received = reader.readFile("firmware.img", "octet", options);
+    ASSERT_TRUE(reader.isSuccess()) << "Read failed: " << reader.getLastError();
+    EXPECT_EQ(received, data);
+    EXPECT_EQ(reader.getNegotiatedOptions().tsize, data.size());
+
+    // The repeat read is served from cached frames without decompressing again
+    TftpClient again("127.0.0.1", test_port_);
+    ASSERT_EQ(again.readFile("firmware.img", "octet"), data);
+    EXPECT_EQ(server_->getBlockCacheStats().hits, 1u);
+
+    // Netascii conversion works on the decompressed stream
+    TftpClient text_reader("127.0.0.1", test_port_);
+    std::vector<uint8_t> converted = text_reader.readFile("firmware.img", "netascii", options);
+    ASSERT_TRUE(text_reader.isSuccess()) << "Read failed: " << text_reader.getLastError();
+    EXPECT_EQ(converted.size(), data.size() + 2000);
+    EXPECT_EQ(text_reader.getNegotiatedOptions().tsize, data.size() + 2000);
+
+    // Without caches blocks are decompressed as they are sent
+    server_->getBlockCache().setCapacity(0);
+    server_->getNetasciiCache().setCapacity(0);
+    TftpClient streamed("127.0.0.1", test_port_);
+    EXPECT_EQ(streamed.readFile("firmware.img", "octet"), data);
+    TftpClient streamed_text("127.0.0.1", test_port_);
+    EXPECT_EQ(streamed_text.readFile("firmware.img", "netascii"), converted);
+
+    TftpCompressionStats stats = server_->getCompressionStats();
+    EXPECT_GT(stats.bytesSaved(), 0u);
+    EXPECT_LT(stats.compressed_bytes_read, stats.bytes_decompressed);
+}
+
+// Overwrite protection holds even when the negative cache still says the name is free
+TEST_F(IntegrationTestFixture, OverwriteProtectionIgnoresStaleNegativeEntry) {
+    config_->setOverwriteProtection(true);
+    std::string path = helpers_->createTestFile("protected.cfg", "original");
+
+    // As left by a miss before the file was copied in with no notification
+    TftpNegativeCache& missing = server_->getNegativeCache();
+    missing.insert(path, test_dir_, 1, missing.generation());
+    ASSERT_TRUE(missing.contains(path));
+
+    TftpClient writer("127.0.0.1", test_port_);
+    EXPECT_FALSE(writer.writeFile("protected.cfg", helpers_->generateRandomData(700), "octet"));
+    EXPECT_EQ(helpers_->readFile(path), "original");
+
+    // New names are still accepted
+    std::vector<uint8_t> data = helpers_->generateRandomData(700);
+    TftpClient fresh("127.0.0.1", test_port_);
+    EXPECT_TRUE(fresh.writeFile("fresh.cfg", data, "octet"));
+    EXPECT_EQ(helpers_->readFile(test_dir_ + "/fresh.cfg"), std::string(data.begin(), data.end()));
+}
+
+// PXE probe cascades are answered from the negative cache until the file appears
+TEST_F(IntegrationTestFixture, MissingFilesServedFromNegativeCache) {
+    TftpClient first("127.0.0.1", test_port_);
+    first.readFile("pxelinux.cfg/01-52-54-00-12-34-56", "octet");
+    ASSERT_FALSE(first.isSuccess());
+
+    TftpClient repeat("127.0.0.1", test_port_);
+    repeat.readFile("pxelinux.cfg/01-52-54-00-12-34-56", "octet");
+    ASSERT_FALSE(repeat.isSuccess());
+    TftpNegativeCacheStats stats = server_->getNegativeCacheStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_GE(stats.syscalls_saved, 1u);
+
+    // An upload makes the name readable right away
+    TftpClient missing("127.0.0.1", test_port_);
+    missing.readFile("uploaded.cfg", "octet");
+    ASSERT_FALSE(missing.isSuccess());
+    std::vector<uint8_t> data = helpers_->generateRandomData(700);
+    TftpClient writer("127.0.0.1", test_port_);
+    ASSERT_TRUE(writer.writeFile("uploaded.cfg", data, "octet"));
+    TftpClient reader("127.0.0.1", test_port_);
+    EXPECT_EQ(reader.readFile("uploaded.cfg", "octet"), data);
+
+#ifdef PLATFORM_LINUX
+    // Files copied in behind the server's back invalidate via change notifications
+    std::filesystem::create_directories(test_dir_ + "/pxelinux.cfg");
+    helpers_->createTestFile("pxelinux.cfg/01-52-54-00-12-34-56", "default linux");
+    std::vector<uint8_t> config;
+    for (int attempt = 0; attempt < 50 && config.empty(); ++attempt) {
+        TftpClient poll("127.0.0.1", test_port_);
+        config = poll.readFile("pxelinux.cfg/01-52-54-00-12-34-56", "octet");
+        if (config.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    EXPECT_EQ(std::string(config.begin(), config.end()), "default linux");
+#endif
+}
+
+TEST_F(IntegrationTestFixture, ReadSetupUsesMetadataCache) {
+    std::vector<uint8_t> data = helpers_->generateRandomData(3000);
+    helpers_->createTestFile("kernel.img", std::string(data.begin(), data.end()));
+
+    for (int i = 0; i < 3; ++i) {
+        TftpClient client("127.0.0.1", test_port_);
+        EXPECT_EQ(client.readFile("kernel.img", "octet"), data);
+    }
+    TftpMetadataCacheStats stats = server_->getMetadataCacheStats();
+    EXPECT_EQ(stats.file_opens, 1u);  // Loaded into the block cache once, no probes
+
+#ifdef PLATFORM_LINUX
+    EXPECT_EQ(stats.stat_calls, 1u);
+    EXPECT_EQ(stats.hits, 2u);
+
+    // A changed file is never served with its old size
+    std::vector<uint8_t> updated = helpers_->generateRandomData(1200);
+    helpers_->createTestFile("kernel.img", std::string(updated.begin(), updated.end()));
+    std::vector<uint8_t> received;
+    for (int attempt = 0; attempt < 50 && received != updated; ++attempt) {
+        TftpClient poll("127.0.0.1", test_port_);
+        received = poll.readFile("kernel.img", "octet");
+        if (received != updated) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    EXPECT_EQ(received, updated);
+#endif
+}
+
+TEST_F(IntegrationTestFixture, CaseInsensitiveBackslashRequests) {
+    std::filesystem::create_directories(test_dir_ + "/Boot/x64");
+    std::vector<uint8_t> data = helpers_->generateRandomData(1500);
+    helpers_->createTestFile("Boot/x64/wdsnbp.com", std::string(data.begin(), data.end()));
+
+    TftpClient exact_only("127.0.0.1", test_port_);
+    exact_only.readFile("boot\\x64\\WDSNBP.COM", "octet");
+    EXPECT_FALSE(exact_only.isSuccess());
+
+    config_->setCaseInsensitive(true);
+    server_->getFilenameIndex().build(test_dir_);
+    TftpClient wds("127.0.0.1", test_port_);
+    EXPECT_EQ(wds.readFile("boot\\x64\\WDSNBP.COM", "octet"), data);
+    EXPECT_EQ(server_->getFilenameIndexStats().resolved, 1u);
+}
+
+// Remap rules rewrite legacy names before access checks and can deny requests
+TEST_F(IntegrationTestFixture, RemapRulesRewriteRequests) {
+    std::filesystem::create_directories(test_dir_ + "/images/legacy");
+    std::vector<uint8_t> data = helpers_->generateRandomData(1500);
+    helpers_->createTestFile("images/legacy/pxelinux.0", std::string(data.begin(), data.end()));
+    helpers_->createTestFile("secret.txt", "secret");
+
+    config_->setRemapRules({"rg \\\\ /", "r ^old/(.*) images/legacy/\\1", "a ^secret"});
+    TftpClient legacy("127.0.0.1", test_port_);
+    EXPECT_EQ(legacy.readFile("old\\pxelinux.0", "octet"), data);
+
+    TftpClient denied("127.0.0.1", test_port_);
+    denied.readFile("secret.txt", "octet");
+    EXPECT_FALSE(denied.isSuccess());
+
+    // Rule changes apply to the next request
+    config_->setRemapRules({});
+    TftpClient unmapped("127.0.0.1", test_port_);
+    EXPECT_EQ(unmapped.readFile("secret.txt", "octet"), std::vector<uint8_t>({'s', 'e', 'c', 'r', 'e', 't'}));
+}
+
+TEST_F(IntegrationTestFixture, SymlinksCannotLeaveRoot) {
+    std::string outside = test_dir_ + "-outside";
+    std::filesystem::create_directories(outside);
+    std::ofstream(outside + "/passwd") << "root:x:0:0";
+    std::filesystem::create_symlink(outside, test_dir_ + "/escape");
+    std::filesystem::create_symlink("data.txt", test_dir_ + "/alias.txt");
+    helpers_->createTestFile("data.txt", "inside");
+
+    TftpClient escaped("127.0.0.1", test_port_);
+    escaped.readFile("escape/passwd", "octet");
+    EXPECT_FALSE(escaped.isSuccess());
+
+    TftpClient upload("127.0.0.1", test_port_);
+    EXPECT_FALSE(upload.writeFile("escape/planted", std::vector<uint8_t>({'x'}), "octet"));
+    EXPECT_FALSE(std::filesystem::exists(outside + "/planted"));
+
+    // Links that stay inside the root are served
+    TftpClient alias("127.0.0.1", test_port_);
+    EXPECT_EQ(alias.readFile("alias.txt", "octet"), std::vector<uint8_t>({'i', 'n', 's', 'i', 'd', 'e'}));
+    std::filesystem::remove_all(outside);
+}
+
+// Origin pull: files missing from the root are fetched once and kept
+TEST_F(IntegrationTestFixture, OriginPullFillsRoot) {
+    TestHttpOrigin origin;
+    ASSERT_TRUE(origin.start());
+    std::vector<uint8_t> image = helpers_->generateRandomData(40 * 512 + 17);
+    origin.setFile("boot/image.bin", std::string(image.begin(), image.end()), "\"v1\"",
+                   "Sun, 06 Nov 1994 08:49:37 GMT");
+
+    config_->setOriginUrl(origin.getUrl());
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    TftpClient first("127.0.0.1", test_port_);
+    EXPECT_EQ(first.readFile("boot/image.bin", "octet"), image);
+    ASSERT_TRUE(first.isSuccess());
+    for (int i = 0; i < 100 && !std::filesystem::exists(test_dir_ + "/boot/image.bin"); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(helpers_->readFile(test_dir_ + "/boot/image.bin"), std::string(image.begin(), image.end()));
+
+    // The stored copy is served without asking the origin again
+    TftpClient second("127.0.0.1", test_port_);
+    EXPECT_EQ(second.readFile("boot/image.bin", "octet"), image);
+    EXPECT_EQ(origin.getRequestCount(), 1u);
+
+    TftpClient missing("127.0.0.1", test_port_);
+    missing.readFile("boot/absent.bin", "octet");
+    EXPECT_FALSE(missing.isSuccess());
+    EXPECT_EQ(server_->getOriginStats().not_found, 1u);
+
+    server_->stop();
+    origin.stop();
+}
+
+// Setup runs on the pool: a request stalled on its file does not hold up other clients
+TEST_F(IntegrationTestFixture, StalledSetupDoesNotBlockListener) {
+    TestHttpOrigin origin;
+    ASSERT_TRUE(origin.start());
+    std::vector<uint8_t> image = helpers_->generateRandomData(8 * 512 + 3);
+    origin.setFile("slow.bin", std::string(image.begin(), image.end()));
+    origin.holdAfter(0);
+    helpers_->createTestFile("fast.txt", "served while another request waits");
+
+    config_->setOriginUrl(origin.getUrl());
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<uint8_t> slow_data;
+    bool slow_success = false;
+    std::thread slow([&] {
+        TftpClient reader("127.0.0.1", test_port_);
+        slow_data = reader.readFile("slow.bin", "octet");
+        slow_success = reader.isSuccess();
+    });
+    ASSERT_TRUE(origin.waitUntilHeld());
+
+    auto started = std::chrono::steady_clock::now();
+    TftpClient fast("127.0.0.1", test_port_);
+    std::vector<uint8_t> fast_data = fast.readFile("fast.txt", "octet");
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    EXPECT_TRUE(fast.isSuccess()) << fast.getLastError();
+    EXPECT_EQ(std::string(fast_data.begin(), fast_data.end()), "served while another request waits");
+    EXPECT_LT(elapsed, std::chrono::seconds(1));
+
+    origin.release();
+    slow.join();
+    EXPECT_TRUE(slow_success);
+    EXPECT_EQ(slow_data, image);
+
+    TftpSetupPoolStats stats = server_->getSetupPoolStats();
+    EXPECT_EQ(stats.completed, 2u);
+    EXPECT_EQ(stats.rejected, 0u);
+    EXPECT_NE(server_->getStatus().find("Setup Pool: 4 threads"), std::string::npos);
+
+    server_->stop();
+    origin.stop();
+}
+
+// Cluster mode: two nodes on localhost, each file cached only by its owner
+TEST_F(IntegrationTestFixture, ClusterServesFromOwningNode) {
+    uint16_t peer_a = helpers_->findAvailablePort(17800);
+    uint16_t peer_b = helpers_->findAvailablePort(peer_a + 1);
+    uint16_t tftp_b = helpers_->findAvailablePort(test_port_ + 1);
+    std::vector<std::string> nodes = {"127.0.0.1:" + std::to_string(peer_a), "127.0.0.1:" + std::to_string(peer_b)};
+
+    std::string root_b = test_dir_ + "-node-b";
+    std::filesystem::create_directories(root_b);
+    auto config_b = std::make_shared<TftpConfig>();
+    config_b->setListenAddress("127.0.0.1");
+    config_b->setListenPort(tftp_b);
+    config_b->setRootDirectory(root_b);
+    config_b->setClusterNodes(nodes);
+    config_b->setClusterNode(nodes[1]);
+    auto server_b = std::make_shared<TftpServer>(config_b, logger_);
+    ASSERT_TRUE(server_b->start());
+
+    config_->setClusterNodes(nodes);
+    config_->setClusterNode(nodes[0]);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    ASSERT_TRUE(server_->start());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::string name;
+    for (int i = 0; name.empty(); ++i) {
+        std::string candidate = "image-" + std::to_string(i) + ".bin";
+        if (server_->getCluster().ownerOf(candidate) == nodes[1]) {
+            name = candidate;
+        }
+    }
+    std::vector<uint8_t> image = helpers_->generateRandomData(30 * 512 + 7);
+    std::ofstream(root_b + "/" + name, std::ios::binary)
+        .write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+
+    // Asked of the node that does not own it
+    TftpClient client("127.0.0.1", test_port_);
+    EXPECT_EQ(client.readFile(name, "octet"), image);
+    EXPECT_TRUE(client.isSuccess());
+    EXPECT_FALSE(std::filesystem::exists(test_dir_ + "/" + name));
+    EXPECT_EQ(server_->getClusterStats().peer_fetches, 1u);
+    EXPECT_EQ(server_b->getClusterStats().requests_served, 1u);
+    EXPECT_NE(server_->getStatus().find("Cluster: 2 nodes"), std::string::npos);
+
+    server_b->stop();
+    std::filesystem::remove_all(root_b);
+}
+
+// Prefork workers: two servers share the port and one content cache
+TEST_F(IntegrationTestFixture, PreforkWorkersShareCache) {
+    std::shared_ptr<TftpSharedContentCache> shared_cache = TftpSharedContentCache::create(64 * 64 * 1024);
+    if (!shared_cache) {
+        GTEST_SKIP() << "Shared content cache not supported on this platform";
+    }
+    config_->setWorkers(2);
+    server_->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    server_ = std::make_shared<TftpServer>(config_, logger_);
+    server_->setSharedCache(shared_cache);
+    ASSERT_TRUE(server_->start());
+    auto worker_b = std::make_shared<TftpServer>(config_, logger_);
+    worker_b->setSharedCache(shared_cache);
+    ASSERT_TRUE(worker_b->start()) << "Second worker could not bind the shared port";
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<uint8_t> image = helpers_->generateRandomData(200000);
+    helpers_->createTestFile("shared.img", std::string(image.begin(), image.end()));
+    for (int i = 0; i < 4; ++i) {
+        TftpClient reader("127.0.0.1", test_port_);
+        ASSERT_EQ(reader.readFile("shared.img", "octet"), image);
+        ASSERT_TRUE(reader.isSuccess()) << "Read failed: " << reader.getLastError();
+    }
+
+    // Whichever worker answered, the file was read from disk once
+    TftpSharedCacheStats stats = shared_cache->getStats();
+    EXPECT_EQ(stats.insertions, 4u);
+    EXPECT_GT(stats.hits, 0u);
+    EXPECT_EQ(server_->getBlockCacheStats().misses + worker_b->getBlockCacheStats().misses, 0u);
+    EXPECT_NE(server_->getStatus().find("Shared Cache:"), std::string::npos);
+
+    worker_b->stop();
+}
+
+// Multicast (RFC 2090) Tests
+class MulticastIntegrationTest : public IntegrationTestFixture {
+protected:
+    void SetUp() override {
+        IntegrationTestFixture::SetUp();
+        config_->setMulticastEnabled(true);
+        config_->setMulticastGroupAddress("239.255.69.11");
+        config_->setMulticastBasePort(helpers_->findAvailablePort(17580));
+        config_->setMulticastInterface("127.0.0.1");
+
+        file_data_ = helpers_->generateRandomData(100 * 512 + 100);
+        helpers_->createTestFile("image.bin", std::string(file_data_.begin(), file_data_.end()));
+        total_blocks_ = file_data_.size() / 512 + 1;
+    }
+
+    std::vector<uint8_t> file_data_;
+    uint64_t total_blocks_ = 0;
+};
+
+TEST_F(MulticastIntegrationTest, SingleClient) {
+    MulticastTestClient client(test_port_, "image.bin");
+    ASSERT_TRUE(client.join());
+    EXPECT_TRUE(client.wasMaster());
+    ASSERT_TRUE(pumpUntilDone({&client}, std::chrono::seconds(10)));
+    EXPECT_EQ(client.data(), file_data_);
+}
+
+TEST_F(MulticastIntegrationTest, ConcurrentClientsShareOneStream) {
+    MulticastTestClient first(test_port_, "image.bin");
+    MulticastTestClient second(test_port_, "image.bin");
+    MulticastTestClient third(test_port_, "image.bin");
+    ASSERT_TRUE(first.join());
+    ASSERT_TRUE(second.join());
+    ASSERT_TRUE(third.join());
+    EXPECT_TRUE(first.wasMaster());
+    EXPECT_FALSE(second.wasMaster());
+    EXPECT_EQ(server_->getMulticastSessionCount(), 1u);
+
+    ASSERT_TRUE(pumpUntilDone({&first, &second, &third}, std::chrono::seconds(10)));
+    EXPECT_EQ(first.data(), file_data_);
+    EXPECT_EQ(second.data(), file_data_);
+    EXPECT_EQ(third.data(), file_data_);
+
+    // Egress follows the file, not the number of receivers
+    TftpMulticastStats stats = server_->getMulticastStats();
+    EXPECT_EQ(stats.clients_joined, 3u);
+    EXPECT_LT(stats.blocks_sent, total_blocks_ * 3 / 2);
+}
+
+TEST_F(MulticastIntegrationTest, LateJoinerCatchesUp) {
+    MulticastTestClient early(test_port_, "image.bin");
+    ASSERT_TRUE(early.join());
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (early.blockCount() < total_blocks_ / 2 && std::chrono::steady_clock::now() < deadline) {
+        early.pump();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_GE(early.blockCount(), total_blocks_ / 2);
+
+    MulticastTestClient late(test_port_, "image.bin");
+    ASSERT_TRUE(late.join());
+    EXPECT_FALSE(late.wasMaster());
+
+    ASSERT_TRUE(pumpUntilDone({&early, &late}, std::chrono::seconds(10)));
+    EXPECT_EQ(early.data(), file_data_);
+    EXPECT_EQ(late.data(), file_data_);
+    EXPECT_TRUE(late.wasMaster());
+
+    // The late joiner is re-sent only the half it missed
+    TftpMulticastStats stats = server_->getMulticastStats();
+    EXPECT_LT(stats.blocks_sent, total_blocks_ * 2);
+}
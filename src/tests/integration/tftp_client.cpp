@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/select.h>
 #endif
 
 namespace simple_tftpd {
@@ -176,7 +177,19 @@ std::vector<uint8_t> TftpClient::receivePacket(std::chrono::milliseconds timeout
         }
 #endif
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        // Wait for the socket to become readable rather than polling on a fixed sleep
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+            timeout - (std::chrono::steady_clock::now() - start));
+        if (remaining.count() <= 0) {
+            continue;
+        }
+        fd_set read_fds;
+        FD_ZERO(&read_fds);
+        FD_SET(client_socket_, &read_fds);
+        struct timeval tv;
+        tv.tv_sec = static_cast<long>(remaining.count() / 1000000);
+        tv.tv_usec = static_cast<long>(remaining.count() % 1000000);
+        select(static_cast<int>(client_socket_) + 1, &read_fds, nullptr, nullptr, &tv);
     }
 }
 
@@ -246,6 +259,7 @@ bool TftpClient::handleOack(const std::vector<uint8_t>& packet, TftpOptions& neg
         }
     }
     
+    negotiated_options_ = negotiated_options;
     return true;
 }
 
@@ -356,7 +370,7 @@ std::vector<uint8_t> TftpClient::readFile(const std::string& filename,
         }
         
         uint16_t block_num = data_packet.getBlockNumber();
-        std::vector<uint8_t> block_data = data_packet.getData();
+        std::vector<uint8_t> block_data = data_packet.getFileData();
         
         // Handle windowed transfers
         if (window_size_ > 1) {
@@ -379,11 +393,12 @@ std::vector<uint8_t> TftpClient::readFile(const std::string& filename,
                 while (received_blocks.find(expected_block) != received_blocks.end()) {
                     const auto& block = received_blocks[expected_block];
                     file_data.insert(file_data.end(), block.begin(), block.end());
+                    bool last_block = block.size() < block_size_;
                     received_blocks.erase(expected_block);
                     expected_block++;
                     
                     // Check if this was the last block
-                    if (block.size() < block_size_) {
+                    if (last_block) {
                         last_success_ = true;
                         return file_data;
                     }
@@ -503,7 +518,8 @@ bool TftpClient::writeFile(const std::string& filename,
     uint16_t block_num = 1;
     size_t offset = 0;
     
-    while (offset < data.size()) {
+    while (true) {
+        // A file that is an exact multiple of block_size ends with an empty block
         size_t block_len = std::min<size_t>(block_size_, data.size() - offset);
         std::vector<uint8_t> block_data(data.begin() + offset, data.begin() + offset + block_len);
         
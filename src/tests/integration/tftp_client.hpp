@@ -68,6 +68,11 @@ public:
      * @brief Check if last operation was successful
      */
     bool isSuccess() const { return last_success_; }
+    
+    /**
+     * @brief Get the options acknowledged in the last OACK
+     */
+    const TftpOptions& getNegotiatedOptions() const { return negotiated_options_; }
 
 private:
     bool initializeSocket();
@@ -91,6 +96,7 @@ private:
     uint16_t block_size_;
     uint16_t window_size_;
     std::chrono::seconds transfer_timeout_;
+    TftpOptions negotiated_options_;
 };
 
 } // namespace test
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/ack_coalescer.hpp"
+
+using namespace simple_tftpd;
+
+// Each session keeps its newest ACK, in the order the sessions appeared
+TEST(TftpAckCoalescerTest, KeepsNewestAckPerSession) {
+    TftpAckCoalescer acks;
+    EXPECT_FALSE(acks.add("10.0.0.1:2000", 4, 0));
+    EXPECT_FALSE(acks.add("10.0.0.2:2000", 9, 1));
+    EXPECT_TRUE(acks.add("10.0.0.1:2000", 8, 2));
+    // Reordered: an older ACK after a newer one is dropped
+    EXPECT_TRUE(acks.add("10.0.0.1:2000", 6, 3));
+    EXPECT_TRUE(acks.add("10.0.0.2:2000", 9, 4));
+
+    ASSERT_EQ(acks.pending().size(), 2u);
+    EXPECT_EQ(acks.pending()[0].key, "10.0.0.1:2000");
+    EXPECT_EQ(acks.pending()[0].block, 8);
+    EXPECT_EQ(acks.pending()[0].packet, 2u);
+    EXPECT_EQ(acks.pending()[1].block, 9);
+    EXPECT_EQ(acks.pending()[1].packet, 1u);
+
+    acks.clear();
+    EXPECT_TRUE(acks.pending().empty());
+}
+
+// Block numbers wrap, so 2 is newer than 65534
+TEST(TftpAckCoalescerTest, NewestAcrossWrap) {
+    TftpAckCoalescer acks;
+    acks.add("peer", 65534, 0);
+    acks.add("peer", 2, 1);
+    acks.add("peer", 65535, 2);
+    ASSERT_EQ(acks.pending().size(), 1u);
+    EXPECT_EQ(acks.pending()[0].block, 2);
+    EXPECT_EQ(acks.pending()[0].packet, 1u);
+}
+
+// Another packet from a session takes its pending ACK so it is handled first
+TEST(TftpAckCoalescerTest, TakeEndsRun) {
+    TftpAckCoalescer acks;
+    acks.add("a", 1, 0);
+    acks.add("b", 5, 1);
+    TftpPendingAck ack;
+    EXPECT_FALSE(acks.take("c", ack));
+    ASSERT_TRUE(acks.take("a", ack));
+    EXPECT_EQ(ack.block, 1);
+    EXPECT_EQ(ack.packet, 0u);
+    EXPECT_FALSE(acks.take("a", ack));
+
+    // A later ACK from the session starts a new run
+    EXPECT_FALSE(acks.add("a", 3, 3));
+    ASSERT_EQ(acks.pending().size(), 2u);
+    EXPECT_EQ(acks.pending()[1].key, "a");
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/block_cache.hpp"
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+using namespace simple_tftpd;
+
+// Test fixture for block cache tests
+class TftpBlockCacheTest : public ::testing::Test {
+protected:
+    static TftpBlockCacheKey makeKey(const std::string& path, uint64_t size, uint16_t block_size = 512) {
+        TftpBlockCacheKey key;
+        key.path = path;
+        key.file_size = size;
+        key.block_size = block_size;
+        return key;
+    }
+
+    static TftpBlockCache::Loader fill(size_t size, std::atomic<int>& calls) {
+        return [size, &calls](std::vector<uint8_t>& stream) {
+            calls++;
+            stream.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                stream[i] = static_cast<uint8_t>(i);
+            }
+            return true;
+        };
+    }
+};
+
+// Frames carry their final header and split at the block size
+TEST_F(TftpBlockCacheTest, FramesArePreSerialized) {
+    std::vector<uint8_t> stream(1030);
+    for (size_t i = 0; i < stream.size(); ++i) {
+        stream[i] = static_cast<uint8_t>(i * 7);
+    }
+    TftpBlockStream frames(stream, 512);
+    ASSERT_EQ(frames.frameCount(), 3u);
+    EXPECT_EQ(frames.streamSize(), 1030u);
+
+    TftpDataView view;
+    ASSERT_TRUE(TftpCodec::decodeData(frames.frame(1).data, frames.frame(1).size, view));
+    EXPECT_EQ(view.block, 2);
+    ASSERT_EQ(view.payload.size, 512u);
+    EXPECT_EQ(view.payload.data[0], stream[512]);
+
+    ASSERT_TRUE(TftpCodec::decodeData(frames.frame(2).data, frames.frame(2).size, view));
+    EXPECT_EQ(view.block, 3);
+    EXPECT_EQ(view.payload.size, 6u);
+    EXPECT_TRUE(frames.frame(3).empty());
+
+    // An exact multiple ends with an empty final block
+    TftpBlockStream exact(std::vector<uint8_t>(1024), 512);
+    ASSERT_EQ(exact.frameCount(), 3u);
+    EXPECT_EQ(exact.frame(2).size, TftpCodec::HEADER_SIZE);
+}
+
+// Block numbers wrap exactly like the 16-bit wire field
+TEST_F(TftpBlockCacheTest, BlockNumbersWrap) {
+    TftpBlockStream frames(std::vector<uint8_t>(65536 * 8), 8);
+    TftpDataView view;
+    ASSERT_TRUE(TftpCodec::decodeData(frames.frame(65534).data, frames.frame(65534).size, view));
+    EXPECT_EQ(view.block, 65535);
+    ASSERT_TRUE(TftpCodec::decodeData(frames.frame(65535).data, frames.frame(65535).size, view));
+    EXPECT_EQ(view.block, 0);
+}
+
+// Concurrent cold lookups collapse into a single load
+TEST_F(TftpBlockCacheTest, SingleFlightLoad) {
+    TftpBlockCache cache(1024 * 1024);
+    std::atomic<int> calls{0};
+    auto slow_loader = [&calls](std::vector<uint8_t>& stream) {
+        calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        stream.assign(4000, 0x5A);
+        return true;
+    };
+
+    std::vector<std::thread> readers;
+    std::atomic<int> served{0};
+    std::atomic<int> cached{0};
+    for (int i = 0; i < 16; ++i) {
+        readers.emplace_back([&]() {
+            bool was_cached = false;
+            auto stream = cache.acquire(makeKey("/srv/tftp/kernel", 4000), slow_loader, was_cached);
+            if (stream && stream->streamSize() == 4000) {
+                served++;
+            }
+            if (was_cached) {
+                cached++;
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(served.load(), 16);
+    EXPECT_EQ(cached.load(), 15);
+
+    TftpBlockCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 15u);
+    EXPECT_EQ(stats.entries, 1u);
+}
+
+// A load that throws fails its waiters and leaves the key free for the next lookup
+TEST_F(TftpBlockCacheTest, ThrowingLoadIsNotCached) {
+    TftpBlockCache cache(1024 * 1024);
+    std::atomic<int> calls{0};
+    auto failing_loader = [&calls](std::vector<uint8_t>&) -> bool {
+        calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        throw std::bad_alloc();
+    };
+
+    std::vector<std::thread> readers;
+    std::atomic<int> served{0};
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            bool was_cached = false;
+            if (cache.acquire(makeKey("/srv/tftp/huge", 4000), failing_loader, was_cached)) {
+                served++;
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(served.load(), 0);
+
+    bool was_cached = true;
+    auto stream = cache.acquire(makeKey("/srv/tftp/huge", 4000), [](std::vector<uint8_t>& data) {
+        data.assign(4000, 0x11);
+        return true;
+    }, was_cached);
+    ASSERT_NE(stream, nullptr);
+    EXPECT_FALSE(was_cached);
+    EXPECT_EQ(stream->streamSize(), 4000u);
+}
+
+// Least recently used entries are evicted once over budget
+TEST_F(TftpBlockCacheTest, EvictsLeastRecentlyUsed) {
+    std::atomic<int> calls{0};
+    TftpBlockCache cache(2500);
+    bool was_cached = false;
+
+    auto a = cache.acquire(makeKey("a", 1000), fill(1000, calls), was_cached);
+    auto b = cache.acquire(makeKey("b", 1000), fill(1000, calls), was_cached);
+    ASSERT_TRUE(a && b);
+    cache.acquire(makeKey("a", 1000), fill(1000, calls), was_cached);
+    EXPECT_TRUE(was_cached);
+
+    // Loading "c" pushes out "b", the least recently used
+    cache.acquire(makeKey("c", 1000), fill(1000, calls), was_cached);
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+    cache.acquire(makeKey("a", 1000), fill(1000, calls), was_cached);
+    EXPECT_TRUE(was_cached);
+    cache.acquire(makeKey("b", 1000), fill(1000, calls), was_cached);
+    EXPECT_FALSE(was_cached);
+    EXPECT_EQ(calls.load(), 4);
+
+    // Evicted entries stay valid for transfers still holding them
+    EXPECT_EQ(b->streamSize(), 1000u);
+    EXPECT_LE(cache.getStats().bytes_used, 2500u);
+}
+
+// Disabled cache and oversized files fall back to the caller
+TEST_F(TftpBlockCacheTest, BypassWhenDisabledOrTooLarge) {
+    std::atomic<int> calls{0};
+    bool was_cached = true;
+
+    TftpBlockCache disabled(0);
+    EXPECT_EQ(disabled.acquire(makeKey("a", 10), fill(10, calls), was_cached), nullptr);
+    EXPECT_FALSE(was_cached);
+
+    TftpBlockCache small(100);
+    EXPECT_EQ(small.acquire(makeKey("big", 1000), fill(1000, calls), was_cached), nullptr);
+    EXPECT_EQ(calls.load(), 0);
+
+    // A failed load is not cached
+    auto failing = [](std::vector<uint8_t>&) { return false; };
+    EXPECT_EQ(small.acquire(makeKey("missing", 10), failing, was_cached), nullptr);
+    EXPECT_EQ(small.getStats().entries, 0u);
+}
+
+// Whole-file conversions share the single-flight LRU with byte accounting
+TEST_F(TftpBlockCacheTest, NetasciiConversionSharedAcrossReaders) {
+    TftpNetasciiCache cache(100);
+    std::atomic<int> calls{0};
+    auto convert = [&calls]() {
+        calls++;
+        auto converted = std::make_shared<TftpConvertedStream>();
+        converted->bytes.assign(60, 'x');
+        return std::shared_ptr<const TftpConvertedStream>(converted);
+    };
+
+    bool was_cached = true;
+    auto first = cache.acquire(makeKey("a.txt", 50, 0), 50, convert, was_cached);
+    ASSERT_NE(first, nullptr);
+    EXPECT_FALSE(was_cached);
+    auto second = cache.acquire(makeKey("a.txt", 50, 0), 50, convert, was_cached);
+    EXPECT_TRUE(was_cached);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(cache.getStats().bytes_used, 60u);
+
+    // A second file exceeds the budget and evicts the first
+    ASSERT_NE(cache.acquire(makeKey("b.txt", 50, 0), 50, convert, was_cached), nullptr);
+    TftpCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.hits, 1u);
+
+    // Source larger than the budget is never converted
+    EXPECT_EQ(cache.acquire(makeKey("c.txt", 200, 0), 200, convert, was_cached), nullptr);
+    EXPECT_EQ(calls.load(), 2);
+}
+
+// Cached-block ratio covers blocks sent by all transfers
+TEST_F(TftpBlockCacheTest, HitRatio) {
+    TftpBlockCache cache(1024);
+    EXPECT_DOUBLE_EQ(cache.getStats().hitRatio(), 0.0);
+    cache.recordBlocks(1, false);
+    cache.recordBlocks(3, true);
+    EXPECT_DOUBLE_EQ(cache.getStats().hitRatio(), 0.75);
+}
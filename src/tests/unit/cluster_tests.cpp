@@ -0,0 +1,251 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/cluster.hpp"
+#include "utils/http_origin.hpp"
+#include "utils/test_helpers.hpp"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <thread>
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+namespace {
+
+std::string readAll(const std::shared_ptr<const TftpOriginFetch>& fetch) {
+    TftpOriginReader reader(fetch);
+    std::string content;
+    uint8_t buffer[1000];
+    for (;;) {
+        int64_t count = reader.read(buffer, sizeof(buffer));
+        if (count < 0) {
+            return "<failed>";
+        }
+        content.append(reinterpret_cast<char*>(buffer), static_cast<size_t>(count));
+        if (static_cast<size_t>(count) < sizeof(buffer)) {
+            return content;
+        }
+    }
+}
+
+bool waitForComplete(const std::shared_ptr<const TftpOriginFetch>& fetch) {
+    for (int i = 0; i < 500 && !fetch->complete(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return fetch->complete();
+}
+
+} // namespace
+
+// Names spread evenly, and a new node takes names only for itself
+TEST(TftpHashRingTest, BalanceAndMinimalMovement) {
+    TftpHashRing three({"10.0.0.1:7000", "10.0.0.2:7000", "10.0.0.3:7000"}, 128);
+    TftpHashRing four({"10.0.0.1:7000", "10.0.0.2:7000", "10.0.0.3:7000", "10.0.0.4:7000"}, 128);
+
+    const size_t names = 30000;
+    std::map<size_t, size_t> shares;
+    size_t moved = 0;
+    for (size_t i = 0; i < names; ++i) {
+        std::string name = "images/host-" + std::to_string(i) + "/pxelinux.cfg";
+        size_t before = three.owner(name);
+        size_t after = four.owner(name);
+        EXPECT_EQ(before, three.owner(name));
+        shares[before]++;
+        if (after != before) {
+            EXPECT_EQ(after, 3u) << name;
+            moved++;
+        }
+    }
+    for (const auto& share : shares) {
+        EXPECT_GT(share.second, names / 4) << "node " << share.first;
+        EXPECT_LT(share.second, names * 5 / 12) << "node " << share.first;
+    }
+    EXPECT_GT(moved, names / 6);
+    EXPECT_LT(moved, names / 3);
+
+    TftpHashRing empty({}, 128);
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty.owner("anything"), 0u);
+}
+
+class TftpClusterTest : public ::testing::Test {
+protected:
+    struct Node {
+        std::string root_dir;
+        std::shared_ptr<TftpConfig> config;
+        std::shared_ptr<TftpRootHandle> root;
+        std::unique_ptr<TftpOriginStore> origin;
+        std::unique_ptr<TftpCluster> cluster;
+    };
+
+    void SetUp() override {
+        ASSERT_TRUE(http_.start());
+        uint16_t first = helpers_.findAvailablePort(17700);
+        uint16_t second = helpers_.findAvailablePort(first + 1);
+        ASSERT_NE(first, 0);
+        ASSERT_NE(second, 0);
+        endpoints_ = {"127.0.0.1:" + std::to_string(first), "127.0.0.1:" + std::to_string(second)};
+        for (size_t i = 0; i < 2; ++i) {
+            nodes_[i] = makeNode(i);
+        }
+    }
+
+    void TearDown() override {
+        for (auto& node : nodes_) {
+            node.cluster.reset();
+            node.origin.reset();
+        }
+        http_.stop();
+    }
+
+    Node makeNode(size_t index) {
+        Node node;
+        node.root_dir = helpers_.getTestDirectory() + "/node" + std::to_string(index);
+        std::filesystem::create_directories(node.root_dir);
+        node.config = std::make_shared<TftpConfig>();
+        node.config->setRootDirectory(node.root_dir);
+        node.config->setOriginUrl(http_.getUrl());
+        node.config->setOriginTimeout(2);
+        node.config->setClusterNodes(endpoints_);
+        node.config->setClusterNode(endpoints_[index]);
+        node.root = std::make_shared<TftpRootHandle>();
+        EXPECT_TRUE(node.root->open(node.root_dir));
+        node.origin = std::make_unique<TftpOriginStore>(node.config);
+        node.cluster = std::make_unique<TftpCluster>(node.config, nullptr, *node.origin);
+        std::shared_ptr<const TftpRootHandle> root = node.root;
+        EXPECT_TRUE(node.cluster->start([root] { return root; }));
+        return node;
+    }
+
+    // A name the second node owns
+    std::string ownedBySecond(const std::string& prefix) {
+        for (int i = 0;; ++i) {
+            std::string name = prefix + std::to_string(i) + ".bin";
+            if (nodes_[0].cluster->ownerOf(name) == endpoints_[1]) {
+                return name;
+            }
+        }
+    }
+
+    TestHelpers helpers_;
+    TestHttpOrigin http_;
+    std::vector<std::string> endpoints_;
+    Node nodes_[2];
+};
+
+// Misses for files another node owns come from that node and are not kept
+TEST_F(TftpClusterTest, FetchesFromOwningPeer) {
+    EXPECT_TRUE(nodes_[0].cluster->isEnabled());
+    EXPECT_NE(nodes_[0].cluster->getPeerPort(), 0);
+
+    std::string name = ownedBySecond("boot/held-");
+    EXPECT_EQ(nodes_[1].cluster->ownerOf(name), endpoints_[1]);
+    std::string content = helpers_.generateRandomString(150000);
+    std::filesystem::create_directories(nodes_[1].root_dir + "/boot");
+    std::ofstream(nodes_[1].root_dir + "/" + name, std::ios::binary) << content;
+
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    ASSERT_EQ(nodes_[0].cluster->fetch(nodes_[0].root, name, fetch), TftpOriginStore::Result::FETCHING);
+    EXPECT_EQ(readAll(fetch), content);
+    ASSERT_TRUE(waitForComplete(fetch));
+
+    // Cached once in the fleet: nothing is left on the asking node
+    EXPECT_FALSE(std::filesystem::exists(nodes_[0].root_dir + "/boot"));
+    EXPECT_TRUE(std::filesystem::is_empty(nodes_[0].root_dir));
+    EXPECT_EQ(http_.getRequestCount(), 0u);
+    EXPECT_EQ(nodes_[0].cluster->getStats().peer_fetches, 1u);
+    EXPECT_EQ(nodes_[1].cluster->getStats().requests_served, 1u);
+    EXPECT_EQ(nodes_[1].cluster->getStats().bytes_served, content.size());
+
+    // Missing everywhere
+    EXPECT_EQ(nodes_[0].cluster->fetch(nodes_[0].root, ownedBySecond("absent-"), fetch),
+              TftpOriginStore::Result::NOT_FOUND);
+}
+
+// The owner fills its cache from the origin while streaming to the peer
+TEST_F(TftpClusterTest, OwnerFillsFromOrigin) {
+    std::string name = ownedBySecond("image-");
+    std::string content = helpers_.generateRandomString(20000);
+    http_.setFile(name, content, "\"v1\"");
+
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    ASSERT_EQ(nodes_[0].cluster->fetch(nodes_[0].root, name, fetch), TftpOriginStore::Result::FETCHING);
+    EXPECT_EQ(readAll(fetch), content);
+    ASSERT_TRUE(waitForComplete(fetch));
+    for (int i = 0; i < 100 && !std::filesystem::exists(nodes_[1].root_dir + "/" + name); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(helpers_.readFile(nodes_[1].root_dir + "/" + name), content);
+    EXPECT_FALSE(std::filesystem::exists(nodes_[0].root_dir + "/" + name));
+
+    // The second request is answered from the owner's copy
+    ASSERT_EQ(nodes_[0].cluster->fetch(nodes_[0].root, name, fetch), TftpOriginStore::Result::FETCHING);
+    EXPECT_EQ(readAll(fetch), content);
+    EXPECT_EQ(http_.getRequestCount(), 1u);
+    EXPECT_EQ(nodes_[1].cluster->getStats().owned_misses, 1u);
+}
+
+// With the owner down the origin is asked directly
+TEST_F(TftpClusterTest, FallsBackToOriginWhenOwnerIsDown) {
+    std::string name = ownedBySecond("fallback-");
+    http_.setFile(name, "from origin");
+    nodes_[1].cluster->stop();
+
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    ASSERT_EQ(nodes_[0].cluster->fetch(nodes_[0].root, name, fetch), TftpOriginStore::Result::FETCHING);
+    EXPECT_EQ(readAll(fetch), "from origin");
+    EXPECT_EQ(nodes_[0].cluster->getStats().peer_failures, 1u);
+
+    // Files this node owns never go to a peer
+    for (int i = 0;; ++i) {
+        std::string own = "own-" + std::to_string(i);
+        if (nodes_[0].cluster->ownerOf(own) == endpoints_[0]) {
+            EXPECT_EQ(nodes_[0].cluster->fetch(nodes_[0].root, own, fetch), TftpOriginStore::Result::NOT_FOUND);
+            break;
+        }
+    }
+    EXPECT_EQ(nodes_[0].cluster->getStats().owned_misses, 1u);
+}
+
+// Configuration keys
+TEST(TftpClusterConfigTest, Config) {
+    TftpConfig config;
+    EXPECT_TRUE(config.getClusterNodes().empty());
+    ASSERT_TRUE(config.loadFromJson("{\"cluster\": {\"nodes\": [\"10.0.0.1:7000\", \"[fd00::2]:7000\"], "
+                                    "\"node\": \"[fd00::2]:7000\", \"virtual_nodes\": 64}}"));
+    EXPECT_EQ(config.getClusterNodes().size(), 2u);
+    EXPECT_EQ(config.getClusterNode(), "[fd00::2]:7000");
+    EXPECT_EQ(config.getClusterVirtualNodes(), 64u);
+    EXPECT_TRUE(config.validate());
+
+    config.setClusterNode("10.0.0.3:7000");
+    EXPECT_FALSE(config.validate());
+    config.setClusterNodes({"10.0.0.3"});
+    EXPECT_FALSE(config.validate());
+    config.setClusterNodes({"10.0.0.3:70000"});
+    EXPECT_FALSE(config.validate());
+    config.setClusterNodes({});
+    EXPECT_TRUE(config.validate());
+
+    auto standalone = std::make_shared<TftpConfig>();
+    TftpOriginStore origin(standalone);
+    TftpCluster cluster(standalone, nullptr, origin);
+    EXPECT_FALSE(cluster.isEnabled());
+    EXPECT_TRUE(cluster.ownerOf("x").empty());
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/compressed_store.hpp"
+#include "utils/test_helpers.hpp"
+#include <chrono>
+#include <filesystem>
+
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+// Test fixture for compressed store tests (gzip; zstd depends on the build)
+class TftpCompressedStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        if (!TftpCompressedStore::isSupported(TftpCompression::GZIP)) {
+            GTEST_SKIP() << "Built without zlib";
+        }
+        // The root sits one level down so tests can place files outside it
+        base_ = helpers_.getTestDirectory();
+        std::filesystem::create_directories(base_ + "/root");
+        config_ = std::make_shared<TftpConfig>();
+        config_->setRootDirectory(base_ + "/root");
+        config_->setCompressedFilesEnabled(true);
+        auto root = std::make_shared<TftpRootHandle>();
+        ASSERT_TRUE(root->open(base_ + "/root"));
+        root_ = root;
+
+        // Compressible text with some variation
+        for (int i = 0; i < 4000; ++i) {
+            std::string line = "initrd line " + std::to_string(i * 7919 % 1000) + "\n";
+            original_.insert(original_.end(), line.begin(), line.end());
+        }
+    }
+
+    std::string writeFile(const std::string& name, const std::vector<uint8_t>& data) {
+        std::filesystem::create_directories(std::filesystem::path(base_ + "/root/" + name).parent_path());
+        return helpers_.createTestFile("root/" + name, std::string(data.begin(), data.end()));
+    }
+
+    static std::vector<uint8_t> readAll(TftpCompressedReader& reader, size_t chunk) {
+        std::vector<uint8_t> out;
+        std::vector<uint8_t> buffer(chunk);
+        while (!reader.eof() && !reader.failed()) {
+            size_t count = reader.read(buffer.data(), buffer.size());
+            out.insert(out.end(), buffer.begin(), buffer.begin() + count);
+        }
+        return out;
+    }
+
+    TestHelpers helpers_;
+    std::string base_;
+    std::shared_ptr<TftpConfig> config_;
+    std::shared_ptr<const TftpRootHandle> root_;
+    std::vector<uint8_t> original_;
+};
+
+// Reads of any size reassemble the original and feed the I/O/CPU counters
+TEST_F(TftpCompressedStoreTest, GzipStreamingRead) {
+    std::vector<uint8_t> compressed = helpers_.gzipData(original_);
+    ASSERT_FALSE(compressed.empty());
+    writeFile("boot.img.gz", compressed);
+
+    TftpCompressedStore store(config_);
+    TftpCompressedCopy copy;
+    ASSERT_TRUE(store.resolve(root_, "boot.img", copy));
+    for (size_t chunk : {1u, 511u, 512u, 70000u}) {
+        auto reader = store.open(copy, original_.size());
+        ASSERT_NE(reader, nullptr);
+        EXPECT_EQ(readAll(*reader, chunk), original_) << "chunk " << chunk;
+        EXPECT_FALSE(reader->failed());
+    }
+
+    TftpCompressionStats stats = store.getStats();
+    EXPECT_EQ(stats.files_opened, 4u);
+    EXPECT_EQ(stats.bytes_decompressed, 4 * original_.size());
+    EXPECT_EQ(stats.compressed_bytes_read, 4 * compressed.size());
+    EXPECT_GT(stats.bytesSaved(), 0u);
+}
+
+// Concatenated members decode back to back; truncation is an error
+TEST_F(TftpCompressedStoreTest, GzipMembersAndTruncation) {
+    std::vector<uint8_t> first(original_.begin(), original_.begin() + original_.size() / 2);
+    std::vector<uint8_t> second(original_.begin() + original_.size() / 2, original_.end());
+    std::vector<uint8_t> joined = helpers_.gzipData(first);
+    std::vector<uint8_t> tail = helpers_.gzipData(second);
+    joined.insert(joined.end(), tail.begin(), tail.end());
+    std::string path = writeFile("joined.gz", joined);
+
+    TftpCompressedReader reader(TftpCompression::GZIP, nullptr);
+    ASSERT_TRUE(reader.open(TftpFileHandle::openPath(path)));
+    EXPECT_EQ(readAll(reader, 4096), original_);
+
+    // Rewind starts over from the first member
+    ASSERT_TRUE(reader.rewind());
+    EXPECT_EQ(readAll(reader, 1000), original_);
+
+    joined.resize(joined.size() - 10);
+    TftpCompressedReader truncated(TftpCompression::GZIP, nullptr);
+    ASSERT_TRUE(truncated.open(TftpFileHandle::openPath(writeFile("truncated.gz", joined))));
+    readAll(truncated, 4096);
+    EXPECT_TRUE(truncated.failed());
+}
+
+// Copies are found next to the request or in the configured store
+TEST_F(TftpCompressedStoreTest, ResolveCompressedCopy) {
+    writeFile("images/fw.bin.gz", helpers_.gzipData(original_));
+    TftpCompressedStore store(config_);
+
+    TftpCompressedCopy copy;
+    copy.codec = TftpCompression::ZSTD;
+    ASSERT_TRUE(store.resolve(root_, "images/fw.bin", copy));
+    EXPECT_EQ(copy.path, base_ + "/root/images/fw.bin.gz");
+    EXPECT_EQ(copy.name, "images/fw.bin.gz");
+    EXPECT_EQ(copy.codec, TftpCompression::GZIP);
+    EXPECT_TRUE(copy.metadata.regular);
+    EXPECT_FALSE(store.resolve(root_, "images/missing.bin", copy));
+
+    config_->setCompressedDirectory(base_ + "/root/images");
+    EXPECT_TRUE(store.resolve(root_, "fw.bin", copy));
+    EXPECT_EQ(copy.path, base_ + "/root/images/fw.bin.gz");
+    EXPECT_FALSE(store.resolve(root_, "images/fw.bin", copy));
+
+    config_->setCompressedFilesEnabled(false);
+    EXPECT_FALSE(store.resolve(root_, "fw.bin", copy));
+}
+
+#ifndef PLATFORM_WINDOWS
+// A symlinked copy or sidecar is only followed while it stays beneath the directory
+TEST_F(TftpCompressedStoreTest, SymlinkedCopyStaysBeneathRoot) {
+    std::vector<uint8_t> secret(original_.begin(), original_.begin() + 100);
+    std::vector<uint8_t> outside = helpers_.gzipData(secret);
+    helpers_.createTestFile("outside.gz", std::string(outside.begin(), outside.end()));
+    helpers_.createTestFile("outside.size", "99");
+    std::filesystem::create_symlink("../outside.gz", base_ + "/root/escape.gz");
+    std::filesystem::create_symlink(base_ + "/outside.gz", base_ + "/root/absolute.gz");
+
+    TftpCompressedStore store(config_);
+    TftpCompressedCopy copy;
+    EXPECT_FALSE(store.resolve(root_, "escape", copy));
+    EXPECT_FALSE(store.resolve(root_, "absolute", copy));
+
+    // A copy inside the root is served; its sidecar may not point outside
+    writeFile("kernel.gz", helpers_.gzipData(original_));
+    std::filesystem::create_symlink("../outside.size", base_ + "/root/kernel.gz.size");
+    std::filesystem::create_symlink("kernel.gz", base_ + "/root/alias.gz");
+    ASSERT_TRUE(store.resolve(root_, "alias", copy));
+    uint64_t size = 0;
+    ASSERT_TRUE(store.resolve(root_, "kernel", copy));
+    ASSERT_TRUE(store.contentSize(copy, size));
+    EXPECT_EQ(size, original_.size());
+
+    // A configured compressed directory confines its copies the same way
+    config_->setCompressedDirectory(base_ + "/root");
+    EXPECT_FALSE(store.resolve(root_, "escape", copy));
+    EXPECT_TRUE(store.resolve(nullptr, "kernel", copy));
+}
+#endif
+
+// Sizes come from a fresh sidecar, else one remembered counting pass
+TEST_F(TftpCompressedStoreTest, ContentSize) {
+    std::string path = writeFile("kernel.gz", helpers_.gzipData(original_));
+    TftpCompressedStore store(config_);
+    TftpCompressedCopy copy;
+    ASSERT_TRUE(store.resolve(root_, "kernel", copy));
+
+    uint64_t size = 0;
+    ASSERT_TRUE(store.contentSize(copy, size));
+    EXPECT_EQ(size, original_.size());
+    ASSERT_TRUE(store.contentSize(copy, size));
+    EXPECT_EQ(size, original_.size());
+    EXPECT_EQ(store.getStats().size_scans, 1u);
+
+    helpers_.createTestFile("root/kernel.gz.size", "12345\n");
+    ASSERT_TRUE(store.contentSize(copy, size));
+    EXPECT_EQ(size, 12345u);
+
+    // A sidecar older than the copy is stale
+    auto copy_time = std::filesystem::last_write_time(path);
+    std::filesystem::last_write_time(path + ".size", copy_time - std::chrono::hours(1));
+    ASSERT_TRUE(store.contentSize(copy, size));
+    EXPECT_EQ(size, original_.size());
+    EXPECT_EQ(store.getStats().size_scans, 1u);
+}
+
+// A copy holding more than the size it was advertised with fails instead of overrunning
+TEST_F(TftpCompressedStoreTest, ReaderStopsAtAdvertisedSize) {
+    writeFile("grown.gz", helpers_.gzipData(original_));
+    TftpCompressedStore store(config_);
+    TftpCompressedCopy copy;
+    ASSERT_TRUE(store.resolve(root_, "grown", copy));
+
+    auto reader = store.open(copy, 1000);
+    ASSERT_NE(reader, nullptr);
+    std::vector<uint8_t> out = readAll(*reader, 512);
+    EXPECT_TRUE(reader->failed());
+    ASSERT_EQ(out.size(), 1000u);
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), original_.begin()));
+
+    // Exactly the advertised size is fine
+    auto exact = store.open(copy, original_.size());
+    ASSERT_NE(exact, nullptr);
+    EXPECT_EQ(readAll(*exact, 512), original_);
+    EXPECT_FALSE(exact->failed());
+}
+
+#ifdef SIMPLE_TFTPD_HAVE_ZSTD
+// The size of a multi-frame copy (pzstd, concatenated files) covers every frame
+TEST_F(TftpCompressedStoreTest, ZstdMultiFrameSize) {
+    auto compress = [](const uint8_t* data, size_t size) {
+        std::vector<uint8_t> frame(ZSTD_compressBound(size));
+        size_t length = ZSTD_compress(frame.data(), frame.size(), data, size, 3);
+        frame.resize(ZSTD_isError(length) ? 0 : length);
+        return frame;
+    };
+    size_t half = original_.size() / 2;
+    std::vector<uint8_t> joined = compress(original_.data(), half);
+    std::vector<uint8_t> second = compress(original_.data() + half, original_.size() - half);
+    ASSERT_FALSE(joined.empty());
+    ASSERT_FALSE(second.empty());
+    joined.insert(joined.end(), second.begin(), second.end());
+    writeFile("multi.img.zst", joined);
+
+    TftpCompressedStore store(config_);
+    TftpCompressedCopy copy;
+    ASSERT_TRUE(store.resolve(root_, "multi.img", copy));
+    EXPECT_EQ(copy.codec, TftpCompression::ZSTD);
+    uint64_t size = 0;
+    ASSERT_TRUE(store.contentSize(copy, size));
+    EXPECT_EQ(size, original_.size());
+    // Read from the frame headers, not by decompressing
+    EXPECT_EQ(store.getStats().size_scans, 0u);
+
+    auto reader = store.open(copy, size);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(readAll(*reader, 4096), original_);
+    EXPECT_FALSE(reader->failed());
+
+    // A trailing partial frame is not trusted; the counting pass rejects it
+    joined.insert(joined.end(), second.begin(), second.begin() + 10);
+    writeFile("broken.img.zst", joined);
+    ASSERT_TRUE(store.resolve(root_, "broken.img", copy));
+    EXPECT_FALSE(store.contentSize(copy, size));
+}
+#endif
@@ -254,6 +254,55 @@ TEST_F(TftpConfigTest, LoggingConfiguration) {
     EXPECT_FALSE(config->isConsoleLoggingEnabled());
 }
 
+// Test monitoring configuration
+TEST_F(TftpConfigTest, MonitoringConfiguration) {
+    EXPECT_TRUE(config->getConnectionsFile().empty());
+
+    std::string json_config = R"({
+        "monitoring": {
+            "connections_file": "/run/simple-tftpd/connections.json"
+        }
+    })";
+    EXPECT_TRUE(config->loadFromJson(json_config));
+    EXPECT_EQ(config->getConnectionsFile(), "/run/simple-tftpd/connections.json");
+
+    TftpConfig reloaded;
+    EXPECT_TRUE(reloaded.loadFromJson(config->toJson()));
+    EXPECT_EQ(reloaded.getConnectionsFile(), "/run/simple-tftpd/connections.json");
+}
+
+// Test multicast configuration
+TEST_F(TftpConfigTest, MulticastConfiguration) {
+    EXPECT_FALSE(config->isMulticastEnabled());
+
+    std::string json_config = R"({
+        "multicast": {
+            "enabled": true,
+            "group_address": "239.255.70.1",
+            "base_port": 2000,
+            "max_sessions": 4,
+            "ttl": 4,
+            "interface": "10.0.0.1"
+        }
+    })";
+    EXPECT_TRUE(config->loadFromJson(json_config));
+    EXPECT_TRUE(config->isMulticastEnabled());
+    EXPECT_EQ(config->getMulticastGroupAddress(), "239.255.70.1");
+    EXPECT_EQ(config->getMulticastBasePort(), 2000);
+    EXPECT_EQ(config->getMulticastMaxSessions(), 4);
+    EXPECT_EQ(config->getMulticastTtl(), 4);
+    EXPECT_EQ(config->getMulticastInterface(), "10.0.0.1");
+    EXPECT_TRUE(config->validate());
+
+    TftpConfig reloaded;
+    EXPECT_TRUE(reloaded.loadFromJson(config->toJson()));
+    EXPECT_EQ(reloaded.getMulticastBasePort(), 2000);
+
+    // Groups must be IPv4 multicast addresses
+    config->setMulticastGroupAddress("10.1.1.1");
+    EXPECT_FALSE(config->validate());
+}
+
 // Test overwrite protection
 TEST_F(TftpConfigTest, OverwriteProtection) {
     config->setOverwriteProtection(true);
@@ -262,3 +311,45 @@ TEST_F(TftpConfigTest, OverwriteProtection) {
     config->setOverwriteProtection(false);
     EXPECT_FALSE(config->isOverwriteProtectionEnabled());
 }
+
+TEST_F(TftpConfigTest, CompressedFilesConfiguration) {
+    EXPECT_FALSE(config->isCompressedFilesEnabled());
+    EXPECT_TRUE(config->getCompressedDirectory().empty());
+
+    std::string json_config = R"({
+        "filesystem": {
+            "compressed_files": true,
+            "compressed_directory": "/srv/tftp-compressed"
+        }
+    })";
+    EXPECT_TRUE(config->loadFromJson(json_config));
+    EXPECT_TRUE(config->isCompressedFilesEnabled());
+    EXPECT_EQ(config->getCompressedDirectory(), "/srv/tftp-compressed");
+
+    TftpConfig reloaded;
+    EXPECT_TRUE(reloaded.loadFromJson(config->toJson()));
+    EXPECT_TRUE(reloaded.isCompressedFilesEnabled());
+    EXPECT_EQ(reloaded.getCompressedDirectory(), "/srv/tftp-compressed");
+}
+
+TEST_F(TftpConfigTest, RetransmitFromFileConfiguration) {
+    EXPECT_FALSE(config->isRetransmitFromFileEnabled());
+
+    EXPECT_TRUE(config->loadFromJson(R"({"performance": {"retransmit_from_file": true}})"));
+    EXPECT_TRUE(config->isRetransmitFromFileEnabled());
+
+    TftpConfig reloaded;
+    EXPECT_TRUE(reloaded.loadFromJson(config->toJson()));
+    EXPECT_TRUE(reloaded.isRetransmitFromFileEnabled());
+}
+
+TEST_F(TftpConfigTest, UdpGsoConfiguration) {
+    EXPECT_FALSE(config->isUdpGsoEnabled());
+
+    EXPECT_TRUE(config->loadFromJson(R"({"performance": {"udp_gso": true}})"));
+    EXPECT_TRUE(config->isUdpGsoEnabled());
+
+    TftpConfig reloaded;
+    EXPECT_TRUE(reloaded.loadFromJson(config->toJson()));
+    EXPECT_TRUE(reloaded.isUdpGsoEnabled());
+}
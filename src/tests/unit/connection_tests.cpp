@@ -23,6 +23,9 @@
 #include <memory>
 #include <thread>
 #include <chrono>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
 
 using namespace simple_tftpd;
 
@@ -235,3 +238,72 @@ TEST_F(TftpConnectionTest, FilenameTracking) {
     // Should not crash, may be empty initially
     EXPECT_TRUE(filename.empty() || !filename.empty());
 }
+
+// Test telemetry snapshot of an idle connection
+TEST_F(TftpConnectionTest, TelemetrySnapshot) {
+    connection = std::make_unique<TftpConnection>(
+        *server, "127.0.0.1", 12345, config, logger);
+
+    TftpConnectionTelemetry telemetry = connection->getTelemetry();
+    EXPECT_EQ(telemetry.client_address, "127.0.0.1");
+    EXPECT_EQ(telemetry.client_port, 12345);
+    EXPECT_EQ(telemetry.state, TftpConnectionState::INITIALIZED);
+    EXPECT_EQ(telemetry.bytes_transferred, 0u);
+    EXPECT_EQ(telemetry.total_bytes, 0u);
+    EXPECT_LT(telemetry.percent_complete, 0.0); // Unknown without tsize
+    EXPECT_EQ(telemetry.block_size, config->getBlockSize());
+    EXPECT_EQ(telemetry.effective_window, config->getWindowSize());
+    EXPECT_EQ(telemetry.in_flight, 0u);
+    EXPECT_EQ(telemetry.retransmits, 0u);
+    EXPECT_EQ(telemetry.duplicate_acks, 0u);
+    EXPECT_EQ(telemetry.duplicate_data, 0u);
+    EXPECT_EQ(telemetry.rtt_us, 0u);
+}
+
+// Test telemetry JSON serialization
+TEST_F(TftpConnectionTest, TelemetryJson) {
+    TftpConnectionTelemetry telemetry;
+    telemetry.client_address = "10.0.0.1";
+    telemetry.client_port = 4000;
+    telemetry.filename = "boot/\"pxe\".0";
+    telemetry.state = TftpConnectionState::TRANSFERRING;
+    telemetry.bytes_transferred = 512;
+    telemetry.total_bytes = 1024;
+    telemetry.percent_complete = 50.0;
+    telemetry.retransmits = 3;
+
+    std::string json = telemetry.toJson();
+    EXPECT_NE(json.find("\"client\":\"10.0.0.1:4000\""), std::string::npos);
+    EXPECT_NE(json.find("\"filename\":\"boot/\\\"pxe\\\".0\""), std::string::npos);
+    EXPECT_NE(json.find("\"state\":\"transferring\""), std::string::npos);
+    EXPECT_NE(json.find("\"direction\":\"read\""), std::string::npos);
+    EXPECT_NE(json.find("\"percent_complete\":50.0"), std::string::npos);
+    EXPECT_NE(json.find("\"retransmits\":3"), std::string::npos);
+}
+
+// Test connection state names
+TEST_F(TftpConnectionTest, StateNames) {
+    EXPECT_EQ(connectionStateToString(TftpConnectionState::TRANSFERRING), "transferring");
+    EXPECT_EQ(connectionStateToString(TftpConnectionState::COMPLETED), "completed");
+    EXPECT_EQ(transferDirectionToString(TftpTransferDirection::WRITE), "write");
+}
+
+// Test live connections view on the server
+TEST_F(TftpConnectionTest, ServerConnectionsJson) {
+    EXPECT_TRUE(server->listConnections().empty());
+    EXPECT_TRUE(server->getConnectionTelemetry().empty());
+
+    std::string json = server->getConnectionsJson();
+    EXPECT_NE(json.find("\"connections\":[]"), std::string::npos);
+    EXPECT_NE(json.find("\"timestamp_ms\":"), std::string::npos);
+
+    std::string status_file = "/tmp/simple-tftpd-connections-test.json";
+    config->setConnectionsFile(status_file);
+    EXPECT_TRUE(server->writeConnectionsSnapshot());
+
+    std::ifstream file(status_file);
+    ASSERT_TRUE(file.is_open());
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_NE(contents.find("\"connections\":[]"), std::string::npos);
+    std::remove(status_file.c_str());
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/filename_index.hpp"
+#include "utils/test_helpers.hpp"
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+// Test fixture for filename index tests
+class TftpFilenameIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root_ = helpers_.getTestDirectory();
+        std::filesystem::create_directories(root_ + "/Boot/x64");
+        helpers_.createTestFile("Boot/x64/wdsnbp.com", "wds");
+        helpers_.createTestFile("pxelinux.0", "pxe");
+    }
+
+    static bool waitForResolve(TftpFilenameIndex& index, const std::string& name, bool expected) {
+        std::string resolved;
+        for (int i = 0; i < 200 && index.resolve(name, resolved) != expected; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return index.resolve(name, resolved) == expected;
+    }
+
+    TestHelpers helpers_;
+    std::string root_;
+};
+
+// Keys ignore case and separator style
+TEST_F(TftpFilenameIndexTest, NormalizeAndFold) {
+    EXPECT_EQ(TftpFilenameIndex::normalizeName("Boot\\x64\\wdsnbp.com"), "Boot/x64/wdsnbp.com");
+    EXPECT_EQ(TftpFilenameIndex::normalizeName("\\\\boot//./x64\\"), "boot/x64");
+    EXPECT_EQ(TftpFilenameIndex::fold("BOOT\\X64\\WdsNbp.COM"), "boot/x64/wdsnbp.com");
+    EXPECT_EQ(TftpFilenameIndex::fold("pxelinux.cfg/01-AA-BB"), "pxelinux.cfg/01-aa-bb");
+}
+
+// Requests in any case and with backslashes find the stored file
+TEST_F(TftpFilenameIndexTest, ResolvesStoredSpelling) {
+    TftpFilenameIndex index(nullptr);
+    std::string resolved;
+    EXPECT_FALSE(index.resolve("pxelinux.0", resolved));  // Not built yet
+
+    EXPECT_EQ(index.build(root_, 4), 2u);
+    EXPECT_TRUE(index.isBuilt());
+    EXPECT_TRUE(index.resolve("BOOT\\X64\\WDSNBP.COM", resolved));
+    EXPECT_EQ(resolved, "Boot/x64/wdsnbp.com");
+    EXPECT_TRUE(index.resolve("PXELinux.0", resolved));
+    EXPECT_EQ(resolved, "pxelinux.0");
+    EXPECT_FALSE(index.resolve("Boot\\x64\\bootmgr.exe", resolved));
+
+    TftpFilenameIndexStats stats = index.getStats();
+    EXPECT_EQ(stats.files, 2u);
+    EXPECT_EQ(stats.directories, 2u);
+    EXPECT_EQ(stats.resolved, 2u);
+    EXPECT_EQ(stats.builds, 1u);
+
+    index.clear();
+    EXPECT_FALSE(index.resolve("pxelinux.0", resolved));
+}
+
+// Names differing only in case prefer the exact spelling
+TEST_F(TftpFilenameIndexTest, CaseCollisions) {
+    helpers_.createTestFile("README", "upper");
+    helpers_.createTestFile("readme", "lower");
+    TftpFilenameIndex index(nullptr);
+    index.build(root_, 1);
+
+    std::string resolved;
+    EXPECT_TRUE(index.resolve("readme", resolved));
+    EXPECT_EQ(resolved, "readme");
+    EXPECT_TRUE(index.resolve("README", resolved));
+    EXPECT_EQ(resolved, "README");
+    EXPECT_TRUE(index.resolve("ReadMe", resolved));
+    EXPECT_EQ(resolved, "README");  // First in byte order
+}
+
+// A parallel build over a wide and deep tree sees every file
+TEST_F(TftpFilenameIndexTest, ParallelBuild) {
+    for (int d = 0; d < 20; ++d) {
+        std::string dir = "tree/d" + std::to_string(d) + "/sub";
+        std::filesystem::create_directories(root_ + "/" + dir);
+        for (int f = 0; f < 25; ++f) {
+            helpers_.createTestFile(dir + "/F" + std::to_string(f) + ".BIN", "x");
+        }
+    }
+
+    TftpFilenameIndex index(nullptr);
+    EXPECT_EQ(index.build(root_, 8), 502u);
+    std::string resolved;
+    EXPECT_TRUE(index.resolve("TREE\\D7\\SUB\\f24.bin", resolved));
+    EXPECT_EQ(resolved, "tree/d7/sub/F24.BIN");
+}
+
+// Change notifications keep the index current
+TEST_F(TftpFilenameIndexTest, IncrementalUpdates) {
+    TftpDirectoryWatcher watcher;
+    TftpFilenameIndex index(&watcher);
+    if (!watcher.start()) {
+        GTEST_SKIP() << "Directory change notifications unavailable";
+    }
+    index.build(root_, 2);
+
+    helpers_.createTestFile("Boot/x64/Bootmgr.EXE", "mgr");
+    EXPECT_TRUE(waitForResolve(index, "boot\\x64\\bootmgr.exe", true));
+
+    // New directories are indexed with their contents
+    std::filesystem::create_directories(root_ + "/EFI/Boot");
+    helpers_.createTestFile("EFI/Boot/bootx64.efi", "efi");
+    EXPECT_TRUE(waitForResolve(index, "efi\\boot\\BOOTX64.EFI", true));
+
+    std::filesystem::remove(root_ + "/pxelinux.0");
+    EXPECT_TRUE(waitForResolve(index, "pxelinux.0", false));
+
+    // Renaming a directory moves everything below it
+    std::filesystem::rename(root_ + "/Boot", root_ + "/Sources");
+    EXPECT_TRUE(waitForResolve(index, "boot\\x64\\wdsnbp.com", false));
+    EXPECT_TRUE(waitForResolve(index, "sources\\x64\\wdsnbp.com", true));
+    EXPECT_GT(index.getStats().updates, 0u);
+    watcher.stop();
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/metadata_cache.hpp"
+#include "utils/test_helpers.hpp"
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+// Test fixture for metadata cache tests
+class TftpMetadataCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root_ = helpers_.getTestDirectory() + "/root";
+        std::filesystem::create_directories(root_);
+        helpers_.createTestFile("root/pxelinux.0", "0123456789");
+        ASSERT_TRUE(handle_.open(root_));
+    }
+
+    static bool waitForEntries(const TftpMetadataCache& cache, uint64_t entries) {
+        for (int i = 0; i < 200 && cache.getStats().entries != entries; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return cache.getStats().entries == entries;
+    }
+
+    TestHelpers helpers_;
+    std::string root_;
+    TftpRootHandle handle_;
+};
+
+// A single stat() describes the file; directories and missing paths are told apart
+TEST_F(TftpMetadataCacheTest, LookupDescribesFile) {
+    TftpMetadataCache cache(0, nullptr);
+    TftpFileMetadata metadata;
+    ASSERT_TRUE(cache.lookup(handle_, "pxelinux.0", metadata));
+    EXPECT_TRUE(metadata.regular);
+    EXPECT_EQ(metadata.size, 10u);
+    EXPECT_GT(metadata.modified, 0);
+    EXPECT_NE(metadata.permissions & 0400, 0u);
+
+    ASSERT_TRUE(cache.lookup(handle_, "", metadata));
+    EXPECT_FALSE(metadata.regular);
+    EXPECT_FALSE(cache.lookup(handle_, "missing", metadata));
+}
+
+#ifndef PLATFORM_WINDOWS
+// Nothing outside the root is described, even through a symlink inside it
+TEST_F(TftpMetadataCacheTest, LookupStaysBeneathRoot) {
+    helpers_.createTestFile("outside.img", "outside");
+    std::filesystem::create_symlink("../outside.img", root_ + "/escape.img");
+    std::filesystem::create_symlink("pxelinux.0", root_ + "/alias.0");
+
+    TftpMetadataCache cache(0, nullptr);
+    TftpFileMetadata metadata;
+    EXPECT_FALSE(cache.lookup(handle_, "escape.img", metadata));
+    EXPECT_FALSE(cache.lookup(handle_, "../outside.img", metadata));
+    ASSERT_TRUE(cache.lookup(handle_, "alias.0", metadata));
+    EXPECT_EQ(metadata.size, 10u);
+}
+#endif
+
+// Without change notifications nothing is kept and every lookup stats the file
+TEST_F(TftpMetadataCacheTest, UnwatchedLookupsAreNotCached) {
+    TftpDirectoryWatcher watcher;  // Never started
+    TftpMetadataCache cache(16, &watcher);
+    TftpFileMetadata metadata;
+    EXPECT_TRUE(cache.lookup(handle_, "pxelinux.0", metadata));
+    EXPECT_TRUE(cache.lookup(handle_, "pxelinux.0", metadata));
+    EXPECT_FALSE(cache.lookup(handle_, "missing", metadata));
+
+    TftpMetadataCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.hits, 0u);
+    EXPECT_EQ(stats.stat_calls, 3u);
+    EXPECT_EQ(stats.entries, 0u);
+
+    cache.recordOpen();
+    EXPECT_EQ(cache.getStats().file_opens, 1u);
+}
+
+// Watched files are answered from the cache until they change
+TEST_F(TftpMetadataCacheTest, ChangeNotificationsInvalidate) {
+    TftpDirectoryWatcher watcher;
+    TftpMetadataCache cache(16, &watcher);
+    if (!watcher.start()) {
+        GTEST_SKIP() << "Directory change notifications unavailable";
+    }
+
+    TftpFileMetadata metadata;
+    EXPECT_TRUE(cache.lookup(handle_, "pxelinux.0", metadata));
+    EXPECT_TRUE(cache.lookup(handle_, "/./pxelinux.0", metadata));
+    EXPECT_EQ(metadata.size, 10u);
+    EXPECT_EQ(cache.getStats().hits, 1u);
+    EXPECT_EQ(cache.getStats().stat_calls, 1u);
+
+    helpers_.createTestFile("root/pxelinux.0", "01234567890123456789");
+    EXPECT_TRUE(waitForEntries(cache, 0));
+    EXPECT_TRUE(cache.lookup(handle_, "pxelinux.0", metadata));
+    EXPECT_EQ(metadata.size, 20u);
+    EXPECT_GT(cache.getStats().invalidations, 0u);
+    watcher.stop();
+}
+
+// The size bound drops the oldest entry; invalidation covers subtrees
+TEST_F(TftpMetadataCacheTest, SizeBoundAndInvalidate) {
+    TftpDirectoryWatcher watcher;
+    TftpMetadataCache cache(2, &watcher);
+    if (!watcher.start()) {
+        GTEST_SKIP() << "Directory change notifications unavailable";
+    }
+
+    std::filesystem::create_directories(root_ + "/boot");
+    helpers_.createTestFile("root/boot/a", "a");
+    helpers_.createTestFile("root/boot/b", "b");
+    TftpFileMetadata metadata;
+    EXPECT_TRUE(cache.lookup(handle_, "pxelinux.0", metadata));
+    EXPECT_TRUE(cache.lookup(handle_, "boot/a", metadata));
+    EXPECT_TRUE(cache.lookup(handle_, "boot/b", metadata));
+    EXPECT_EQ(cache.getStats().entries, 2u);
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+
+    cache.invalidate(root_ + "/boot");
+    EXPECT_EQ(cache.getStats().entries, 0u);
+
+    cache.setMaxEntries(0);
+    EXPECT_TRUE(cache.lookup(handle_, "pxelinux.0", metadata));
+    EXPECT_EQ(cache.getStats().entries, 0u);
+    watcher.stop();
+}
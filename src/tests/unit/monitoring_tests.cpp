@@ -252,3 +252,38 @@ TEST_F(MonitoringTest, UptimeTracking) {
     // Uptime should have increased
     EXPECT_GE(uptime2, uptime1);
 }
+
+// Test merging the metrics of several worker processes
+TEST_F(MonitoringTest, MergeMetrics) {
+    monitoring->recordTransfer(1000, true, 10);
+    monitoring->recordConnection(true);
+    monitoring->updateActiveConnections(2);
+
+    Monitoring worker;
+    worker.recordTransfer(3000, true, 30);
+    worker.recordTransfer(0, false, 30);
+    worker.recordConnection(false);
+    worker.recordError();
+    worker.recordTimeout();
+    worker.updateActiveConnections(3);
+    monitoring->mergeMetrics(worker.getMetrics());
+
+    auto metrics = monitoring->getMetrics();
+    EXPECT_EQ(metrics.transfers.total_transfers, 3);
+    EXPECT_EQ(metrics.transfers.successful_transfers, 2);
+    EXPECT_EQ(metrics.transfers.failed_transfers, 1);
+    EXPECT_EQ(metrics.transfers.total_bytes_sent, 4000);
+    EXPECT_EQ(metrics.transfers.average_transfer_time_ms, 23); // (10 + 2 * 30) / 3
+    EXPECT_EQ(metrics.connections.total_connections, 2);
+    EXPECT_EQ(metrics.connections.failed_connections, 1);
+    EXPECT_EQ(metrics.connections.active_connections, 5);
+    EXPECT_EQ(metrics.connections.peak_connections, 5);
+    EXPECT_EQ(metrics.total_errors, 1);
+    EXPECT_EQ(metrics.total_timeouts, 1);
+
+    // The earliest start time wins, so uptime is the longest-running process's
+    ServerMetrics older;
+    older.server_start_time = std::chrono::steady_clock::now() - std::chrono::seconds(60);
+    monitoring->mergeMetrics(older);
+    EXPECT_GE(monitoring->getMetrics().uptime.count(), 60);
+}
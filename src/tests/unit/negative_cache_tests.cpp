@@ -0,0 +1,134 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/negative_cache.hpp"
+#include "utils/test_helpers.hpp"
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+// Test fixture for negative cache tests
+class TftpNegativeCacheTest : public ::testing::Test {
+protected:
+    static void remember(TftpNegativeCache& cache, const std::string& path, uint32_t probes = 1) {
+        cache.insert(path, "/srv/tftp", probes, cache.generation());
+    }
+
+    static bool waitForEntries(const TftpNegativeCache& cache, uint64_t entries) {
+        for (int i = 0; i < 200 && cache.getStats().entries != entries; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return cache.getStats().entries == entries;
+    }
+};
+
+// Hits are counted with the probes they avoided
+TEST_F(TftpNegativeCacheTest, HitsAndSavedProbes) {
+    TftpNegativeCache cache(16, std::chrono::seconds(30), nullptr);
+    EXPECT_FALSE(cache.contains("/srv/tftp/pxelinux.cfg/01-52-54-00-12-34-56"));
+    remember(cache, "/srv/tftp/pxelinux.cfg/01-52-54-00-12-34-56", 3);
+
+    // Keys are normalized, so equivalent spellings share the entry
+    EXPECT_TRUE(cache.contains("/srv/tftp//pxelinux.cfg/./01-52-54-00-12-34-56"));
+    EXPECT_TRUE(cache.contains("/srv/tftp/pxelinux.cfg/01-52-54-00-12-34-56"));
+    EXPECT_FALSE(cache.contains("/srv/tftp/pxelinux.cfg/default"));
+
+    TftpNegativeCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.syscalls_saved, 6u);
+    EXPECT_DOUBLE_EQ(stats.hitRatio(), 0.5);
+
+    EXPECT_EQ(TftpNegativeCache::normalize("/a//b/./c/"), "/a/b/c");
+    EXPECT_EQ(TftpNegativeCache::normalize("a/./b"), "a/b");
+    EXPECT_EQ(TftpNegativeCache::normalize("//"), "/");
+}
+
+// Entries expire, and the oldest go first once the bound is reached
+TEST_F(TftpNegativeCacheTest, TtlAndSizeBound) {
+    TftpNegativeCache cache(2, std::chrono::milliseconds(50), nullptr);
+    remember(cache, "/srv/tftp/a");
+    remember(cache, "/srv/tftp/b");
+    remember(cache, "/srv/tftp/c");
+    EXPECT_FALSE(cache.contains("/srv/tftp/a"));
+    EXPECT_TRUE(cache.contains("/srv/tftp/b"));
+    EXPECT_EQ(cache.getStats().evictions, 1u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    EXPECT_FALSE(cache.contains("/srv/tftp/c"));
+    EXPECT_EQ(cache.getStats().expirations, 1u);
+
+    cache.setLimits(0, std::chrono::seconds(30));
+    remember(cache, "/srv/tftp/d");
+    EXPECT_FALSE(cache.contains("/srv/tftp/d"));
+}
+
+// Invalidating a path drops it and everything below it, nothing else
+TEST_F(TftpNegativeCacheTest, InvalidateSubtree) {
+    TftpNegativeCache cache(16, std::chrono::seconds(30), nullptr);
+    remember(cache, "/srv/tftp/pxelinux.cfg/01-aa");
+    remember(cache, "/srv/tftp/pxelinux.cfg/C0A8");
+    remember(cache, "/srv/tftp/pxelinux.cfg.bak");
+    remember(cache, "/srv/tftp/pxelinux.cfg");
+
+    cache.invalidate("/srv/tftp/pxelinux.cfg");
+    EXPECT_FALSE(cache.contains("/srv/tftp/pxelinux.cfg/01-aa"));
+    EXPECT_FALSE(cache.contains("/srv/tftp/pxelinux.cfg/C0A8"));
+    EXPECT_FALSE(cache.contains("/srv/tftp/pxelinux.cfg"));
+    EXPECT_TRUE(cache.contains("/srv/tftp/pxelinux.cfg.bak"));
+    EXPECT_EQ(cache.getStats().invalidations, 3u);
+}
+
+// A miss probed before an invalidation is not remembered
+TEST_F(TftpNegativeCacheTest, InsertAfterInvalidationIsSkipped) {
+    TftpNegativeCache cache(16, std::chrono::seconds(30), nullptr);
+    uint64_t generation = cache.generation();
+    cache.invalidate("/srv/tftp/boot");
+    cache.insert("/srv/tftp/boot/grubx64.efi", "/srv/tftp", 1, generation);
+    EXPECT_FALSE(cache.contains("/srv/tftp/boot/grubx64.efi"));
+    EXPECT_EQ(cache.getStats().insertions, 0u);
+}
+
+// Creating a file (or a missing parent) in the watched tree drops the entry
+TEST_F(TftpNegativeCacheTest, ChangeNotificationsInvalidate) {
+    TftpDirectoryWatcher watcher;
+    TftpNegativeCache cache(16, std::chrono::seconds(30), &watcher);
+    if (!watcher.start()) {
+        GTEST_SKIP() << "Directory change notifications unavailable";
+    }
+
+    TestHelpers helpers;
+    std::string root = helpers.getTestDirectory();
+    std::string flat = root + "/ldlinux.c32";
+    std::string nested = root + "/pxelinux.cfg/01-aa-bb";
+    cache.insert(flat, root, 1, cache.generation());
+    cache.insert(nested, root, 1, cache.generation());
+    EXPECT_EQ(cache.getStats().entries, 2u);
+    EXPECT_EQ(watcher.watchCount(), 1u);  // pxelinux.cfg does not exist: the root is watched
+
+    helpers.createTestFile("ldlinux.c32", "x");
+    EXPECT_TRUE(waitForEntries(cache, 1));
+    EXPECT_TRUE(cache.contains(nested));
+
+    std::filesystem::create_directories(root + "/pxelinux.cfg");
+    EXPECT_TRUE(waitForEntries(cache, 0));
+    EXPECT_GT(watcher.eventCount(), 0u);
+    watcher.stop();
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/origin_store.hpp"
+#include "utils/http_origin.hpp"
+#include "utils/test_helpers.hpp"
+#include <filesystem>
+#include <sys/stat.h>
+#include <thread>
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+namespace {
+
+const std::string LAST_MODIFIED = "Sun, 06 Nov 1994 08:49:37 GMT";
+constexpr int64_t LAST_MODIFIED_EPOCH = 784111777;
+
+std::string readAll(const std::shared_ptr<const TftpOriginFetch>& fetch) {
+    TftpOriginReader reader(fetch);
+    std::string content;
+    uint8_t buffer[700];
+    for (;;) {
+        int64_t count = reader.read(buffer, sizeof(buffer));
+        if (count < 0) {
+            return "<failed>";
+        }
+        content.append(reinterpret_cast<char*>(buffer), static_cast<size_t>(count));
+        if (static_cast<size_t>(count) < sizeof(buffer)) {
+            return content;
+        }
+    }
+}
+
+bool waitForComplete(const std::shared_ptr<const TftpOriginFetch>& fetch) {
+    for (int i = 0; i < 500 && !fetch->complete(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return fetch->complete();
+}
+
+} // namespace
+
+class TftpOriginStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(origin_.start());
+        root_dir_ = helpers_.getTestDirectory() + "/edge";
+        std::filesystem::create_directories(root_dir_);
+        config_ = std::make_shared<TftpConfig>();
+        config_->setRootDirectory(root_dir_);
+        config_->setOriginUrl(origin_.getUrl() + "/images/");
+        config_->setOriginTimeout(2);
+        root_ = std::make_shared<TftpRootHandle>();
+        ASSERT_TRUE(root_->open(root_dir_));
+        store_ = std::make_unique<TftpOriginStore>(config_);
+    }
+
+    void TearDown() override {
+        origin_.release();
+        store_.reset();
+        origin_.stop();
+    }
+
+    TestHelpers helpers_;
+    TestHttpOrigin origin_;
+    std::string root_dir_;
+    std::shared_ptr<TftpConfig> config_;
+    std::shared_ptr<TftpRootHandle> root_;
+    std::unique_ptr<TftpOriginStore> store_;
+};
+
+// A miss is streamed from the origin and stored with the origin's timestamp
+TEST_F(TftpOriginStoreTest, FetchesAndStoresMissingFile) {
+    std::string content = helpers_.generateRandomString(5000);
+    origin_.setFile("images/boot/pxe linux.0", content, "\"v1\"", LAST_MODIFIED);
+
+    std::vector<std::string> stored;
+    store_->setStoredCallback([&stored](const std::string& path) { stored.push_back(path); });
+
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    ASSERT_EQ(store_->fetch(root_, "boot/pxe linux.0", fetch), TftpOriginStore::Result::FETCHING);
+    uint64_t size = 0;
+    ASSERT_TRUE(fetch->waitForSize(size));
+    EXPECT_EQ(size, content.size());
+    EXPECT_EQ(readAll(fetch), content);
+    ASSERT_TRUE(waitForComplete(fetch));
+
+    std::string path = root_dir_ + "/boot/pxe linux.0";
+    EXPECT_EQ(helpers_.readFile(path), content);
+    ASSERT_EQ(stored.size(), 1u);
+    EXPECT_EQ(stored[0], path);
+    struct stat info {};
+    ASSERT_EQ(stat(path.c_str(), &info), 0);
+    EXPECT_EQ(info.st_mtime, LAST_MODIFIED_EPOCH);
+
+    // No partial files are left behind
+    size_t entries = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(root_dir_ + "/boot")) {
+        (void)entry;
+        entries++;
+    }
+    EXPECT_EQ(entries, 1u);
+
+    EXPECT_EQ(store_->fetch(root_, "boot/missing", fetch), TftpOriginStore::Result::NOT_FOUND);
+    TftpOriginStats stats = store_->getStats();
+    EXPECT_EQ(stats.fetches, 1u);
+    EXPECT_EQ(stats.not_found, 1u);
+    EXPECT_EQ(stats.bytes_fetched, content.size());
+}
+
+// Readers get the first bytes while the rest of the body is still on its way
+TEST_F(TftpOriginStoreTest, StreamsBeforeDownloadCompletes) {
+    std::string content = helpers_.generateRandomString(64 * 1024);
+    origin_.setFile("images/large.img", content, "\"v1\"");
+    origin_.holdAfter(4096);
+
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    ASSERT_EQ(store_->fetch(root_, "large.img", fetch), TftpOriginStore::Result::FETCHING);
+    ASSERT_TRUE(origin_.waitUntilHeld());
+
+    TftpOriginReader reader(fetch);
+    uint8_t first[512];
+    ASSERT_EQ(reader.read(first, sizeof(first)), 512);
+    EXPECT_EQ(std::string(reinterpret_cast<char*>(first), sizeof(first)), content.substr(0, 512));
+    EXPECT_FALSE(fetch->complete());
+    EXPECT_FALSE(std::filesystem::exists(root_dir_ + "/large.img"));
+
+    origin_.release();
+    EXPECT_EQ(readAll(fetch), content);
+    ASSERT_TRUE(waitForComplete(fetch));
+    EXPECT_EQ(helpers_.readFile(root_dir_ + "/large.img"), content);
+}
+
+// Concurrent requests for one file share a single download
+TEST_F(TftpOriginStoreTest, SingleFlight) {
+    std::string content = helpers_.generateRandomString(20000);
+    origin_.setFile("images/shared.bin", content, "\"v1\"");
+    origin_.holdAfter(1000);
+
+    std::vector<std::thread> clients;
+    std::vector<std::string> results(8);
+    for (size_t i = 0; i < results.size(); ++i) {
+        clients.emplace_back([this, &results, i] {
+            std::shared_ptr<const TftpOriginFetch> fetch;
+            if (store_->fetch(root_, "shared.bin", fetch) == TftpOriginStore::Result::FETCHING) {
+                results[i] = readAll(fetch);
+            }
+        });
+    }
+    ASSERT_TRUE(origin_.waitUntilHeld());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    origin_.release();
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    for (const auto& result : results) {
+        EXPECT_EQ(result, content);
+    }
+    EXPECT_EQ(origin_.getRequestCount(), 1u);
+    EXPECT_EQ(store_->getStats().joined, results.size() - 1);
+}
+
+// Local copies are checked with conditional requests once per interval
+TEST_F(TftpOriginStoreTest, Revalidation) {
+    origin_.setFile("images/menu.cfg", "first", "\"v1\"", LAST_MODIFIED);
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    ASSERT_EQ(store_->fetch(root_, "menu.cfg", fetch), TftpOriginStore::Result::FETCHING);
+    ASSERT_TRUE(waitForComplete(fetch));
+    int64_t modified = LAST_MODIFIED_EPOCH * 1000000000LL;
+
+    // Within the interval nothing is asked
+    EXPECT_EQ(store_->revalidate(root_, "menu.cfg", modified, fetch), TftpOriginStore::Result::FRESH);
+    EXPECT_EQ(origin_.getRequestCount(), 1u);
+
+    config_->setOriginRevalidateInterval(0);
+    EXPECT_EQ(store_->revalidate(root_, "menu.cfg", modified, fetch), TftpOriginStore::Result::FRESH);
+    EXPECT_EQ(origin_.getNotModifiedCount(), 1u);
+    EXPECT_EQ(origin_.getLastHeader("if-none-match"), "\"v1\"");
+    EXPECT_EQ(origin_.getLastHeader("if-modified-since"), LAST_MODIFIED);
+
+    // A changed file is downloaded again and replaces the local copy
+    origin_.setFile("images/menu.cfg", "second version", "\"v2\"", LAST_MODIFIED);
+    ASSERT_EQ(store_->revalidate(root_, "menu.cfg", modified, fetch), TftpOriginStore::Result::FETCHING);
+    EXPECT_EQ(readAll(fetch), "second version");
+    ASSERT_TRUE(waitForComplete(fetch));
+    EXPECT_EQ(helpers_.readFile(root_dir_ + "/menu.cfg"), "second version");
+
+    // Without remembered validators (after a restart) the file's mtime is sent
+    helpers_.createTestFile("edge/local.cfg", "local");
+    origin_.setFile("images/local.cfg", "local", "", LAST_MODIFIED);
+    EXPECT_EQ(store_->revalidate(root_, "local.cfg", modified, fetch), TftpOriginStore::Result::FRESH);
+    EXPECT_EQ(origin_.getLastHeader("if-modified-since"), LAST_MODIFIED);
+    EXPECT_EQ(origin_.getNotModifiedCount(), 2u);
+
+    // Files the origin does not have are served as they are
+    helpers_.createTestFile("edge/only-here", "x");
+    EXPECT_EQ(store_->revalidate(root_, "only-here", modified, fetch), TftpOriginStore::Result::FRESH);
+}
+
+// Chunked bodies, size limits and an unreachable origin
+TEST_F(TftpOriginStoreTest, ChunkedLimitsAndFailures) {
+    std::string content = helpers_.generateRandomString(3500);
+    origin_.setChunked(true);
+    origin_.setFile("images/chunked.bin", content);
+    std::shared_ptr<const TftpOriginFetch> fetch;
+    ASSERT_EQ(store_->fetch(root_, "chunked.bin", fetch), TftpOriginStore::Result::FETCHING);
+    uint64_t size = 0;
+    ASSERT_TRUE(fetch->waitForSize(size));
+    EXPECT_EQ(size, content.size());
+    EXPECT_EQ(readAll(fetch), content);
+
+    origin_.setChunked(false);
+    origin_.setFile("images/huge.bin", std::string(2048, 'x'));
+    config_->setMaxFileSize(1024);
+    EXPECT_EQ(store_->fetch(root_, "huge.bin", fetch), TftpOriginStore::Result::TOO_LARGE);
+    EXPECT_FALSE(std::filesystem::exists(root_dir_ + "/huge.bin"));
+
+    origin_.stop();
+    EXPECT_EQ(store_->fetch(root_, "other.bin", fetch), TftpOriginStore::Result::FAILED);
+    helpers_.createTestFile("edge/stale.bin", "stale");
+    EXPECT_EQ(store_->revalidate(root_, "stale.bin", 0, fetch), TftpOriginStore::Result::FRESH);
+    EXPECT_GE(store_->getStats().errors, 2u);
+
+    // Disabled without an origin
+    config_->setOriginUrl("");
+    store_->setConfig(config_);
+    EXPECT_FALSE(store_->isEnabled());
+    EXPECT_EQ(store_->fetch(root_, "other.bin", fetch), TftpOriginStore::Result::NOT_FOUND);
+}
+
+// Configuration keys
+TEST_F(TftpOriginStoreTest, Config) {
+    TftpConfig config;
+    EXPECT_TRUE(config.getOriginUrl().empty());
+    ASSERT_TRUE(config.loadFromJson("{\"filesystem\": {\"origin_url\": \"http://origin.example:8080/tftp\", "
+                                    "\"origin_revalidate_interval\": 60, \"origin_timeout\": 3}}"));
+    EXPECT_EQ(config.getOriginUrl(), "http://origin.example:8080/tftp");
+    EXPECT_EQ(config.getOriginRevalidateInterval(), 60u);
+    EXPECT_EQ(config.getOriginTimeout(), 3u);
+    EXPECT_TRUE(config.validate());
+
+    config.setOriginUrl("https://origin.example/tftp");
+    EXPECT_FALSE(config.validate());
+    config.setOriginUrl("http://origin.example");
+    config.setOriginTimeout(0);
+    EXPECT_FALSE(config.validate());
+}
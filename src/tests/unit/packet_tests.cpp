@@ -10,6 +10,7 @@
 
 #include <gtest/gtest.h>
 #include "simple-tftpd/core/tftp/packet.hpp"
+#include "simple-tftpd/core/tftp/codec.hpp"
 #include <vector>
 #include <cstring>
 
@@ -105,6 +106,29 @@ TEST_F(TftpRequestPacketTest, PacketWithOptions) {
     EXPECT_EQ(retrieved.timeout, 10);
 }
 
+TEST_F(TftpRequestPacketTest, OptionsRoundTrip) {
+    TftpRequestPacket packet(TftpOpcode::RRQ, "test.txt", TftpMode::OCTET);
+    TftpOptions options;
+    options.has_blksize = true;
+    options.blksize = 1428;
+    options.has_tsize = true;
+    options.tsize = 0;
+    options.has_windowsize = true;
+    options.windowsize = 8;
+    packet.setOptions(options);
+    
+    std::vector<uint8_t> data = packet.serialize();
+    TftpRequestPacket parsed(data.data(), data.size());
+    TftpOptions retrieved = parsed.getOptions();
+    EXPECT_TRUE(retrieved.has_blksize);
+    EXPECT_EQ(retrieved.blksize, 1428);
+    EXPECT_TRUE(retrieved.has_tsize);
+    EXPECT_EQ(retrieved.tsize, 0u);
+    EXPECT_TRUE(retrieved.has_windowsize);
+    EXPECT_EQ(retrieved.windowsize, 8);
+    EXPECT_FALSE(retrieved.has_timeout);
+}
+
 TEST_F(TftpRequestPacketTest, InvalidPacketFromCorruptedData) {
     uint8_t corrupted[] = {0x00, 0x01, 0xFF, 0xFF}; // Invalid format
     TftpRequestPacket packet(corrupted, sizeof(corrupted));
@@ -341,3 +365,228 @@ TEST_F(TftpPacketEdgeCasesTest, RoundTripSerialization) {
     EXPECT_EQ(parsed.getFilename(), original.getFilename());
     EXPECT_EQ(parsed.getMode(), original.getMode());
 }
+
+// Test TftpCodec (allocation-free views and encoders)
+class TftpCodecTest : public ::testing::Test {
+protected:
+    void SetUp() override {}
+    void TearDown() override {}
+};
+
+TEST_F(TftpCodecTest, OpcodeTable) {
+    static_assert(findOpcodeInfo(0) == nullptr, "opcode 0 is not defined");
+    static_assert(findOpcodeInfo(7) == nullptr, "opcode 7 is not defined");
+    static_assert(findOpcodeInfo(4)->max_size == 4, "ACK is exactly four bytes");
+    static_assert(modeToWireName(TftpMode::NETASCII) == "netascii", "mode table");
+
+    uint8_t ack[] = {0x00, 0x04, 0x00, 0x01};
+    TftpOpcode opcode;
+    EXPECT_TRUE(TftpCodec::peekOpcode(ack, sizeof(ack), opcode));
+    EXPECT_EQ(opcode, TftpOpcode::ACK);
+    EXPECT_FALSE(TftpCodec::peekOpcode(ack, 3, opcode));
+
+    uint8_t unknown[] = {0x00, 0x09, 0x00, 0x01};
+    EXPECT_FALSE(TftpCodec::peekOpcode(unknown, sizeof(unknown), opcode));
+}
+
+TEST_F(TftpCodecTest, DataViewBorrowsBuffer) {
+    std::vector<uint8_t> payload(1428, 0x5A);
+    std::vector<uint8_t> wire(TftpCodec::HEADER_SIZE + payload.size());
+    size_t length = TftpCodec::encodeData(wire.data(), wire.size(), 513,
+                                          ByteView(payload.data(), payload.size()));
+    ASSERT_EQ(length, wire.size());
+
+    TftpDataView view;
+    ASSERT_TRUE(TftpCodec::decodeData(wire.data(), length, view));
+    EXPECT_EQ(view.block, 513);
+    EXPECT_EQ(view.payload.size, payload.size());
+    EXPECT_EQ(view.payload.data, wire.data() + TftpCodec::HEADER_SIZE);
+
+    // Empty terminating block
+    uint8_t last[TftpCodec::HEADER_SIZE];
+    ASSERT_EQ(TftpCodec::encodeDataHeader(last, sizeof(last), 7), TftpCodec::HEADER_SIZE);
+    ASSERT_TRUE(TftpCodec::decodeData(last, sizeof(last), view));
+    EXPECT_EQ(view.block, 7);
+    EXPECT_TRUE(view.payload.empty());
+}
+
+TEST_F(TftpCodecTest, EncodeRejectsShortBuffer) {
+    uint8_t payload[16] = {};
+    uint8_t out[TftpCodec::HEADER_SIZE + 15];
+    EXPECT_EQ(TftpCodec::encodeData(out, sizeof(out), 1, ByteView(payload, sizeof(payload))), 0u);
+    EXPECT_EQ(TftpCodec::encodeAck(out, 3, 1), 0u);
+    EXPECT_EQ(TftpCodec::encodeError(out, 5, TftpError::FILE_NOT_FOUND, "missing"), 0u);
+}
+
+TEST_F(TftpCodecTest, RequestMatchesPacketClass) {
+    TftpOptions options;
+    options.blksize = 1428;
+    options.has_blksize = true;
+    options.windowsize = 4;
+    options.has_windowsize = true;
+
+    TftpRequestPacket packet(TftpOpcode::WRQ, "images/boot.img", TftpMode::NETASCII);
+    packet.setOptions(options);
+    std::vector<uint8_t> expected = packet.serialize();
+
+    uint8_t out[256];
+    size_t length = TftpCodec::encodeRequest(out, sizeof(out), TftpOpcode::WRQ,
+                                             "images/boot.img", TftpMode::NETASCII, options);
+    ASSERT_EQ(length, expected.size());
+    EXPECT_EQ(std::memcmp(out, expected.data(), length), 0);
+
+    TftpRequestView view;
+    ASSERT_TRUE(TftpCodec::decodeRequest(out, length, view));
+    EXPECT_EQ(view.opcode, TftpOpcode::WRQ);
+    EXPECT_EQ(view.filename, "images/boot.img");
+    EXPECT_EQ(view.mode, TftpMode::NETASCII);
+    EXPECT_FALSE(view.options.empty());
+}
+
+TEST_F(TftpCodecTest, MalformedRequests) {
+    TftpRequestView view;
+    const uint8_t no_mode_nul[] = {0x00, 0x01, 'a', 0x00, 'o', 'c', 't', 'e', 't'};
+    EXPECT_FALSE(TftpCodec::decodeRequest(no_mode_nul, sizeof(no_mode_nul), view));
+
+    const uint8_t empty_name[] = {0x00, 0x01, 0x00, 'o', 'c', 't', 'e', 't', 0x00};
+    EXPECT_FALSE(TftpCodec::decodeRequest(empty_name, sizeof(empty_name), view));
+
+    const uint8_t bad_mode[] = {0x00, 0x01, 'a', 0x00, 'b', 'i', 'n', 0x00};
+    EXPECT_FALSE(TftpCodec::decodeRequest(bad_mode, sizeof(bad_mode), view));
+
+    const uint8_t not_request[] = {0x00, 0x03, 'a', 0x00, 'o', 'c', 't', 'e', 't', 0x00};
+    EXPECT_FALSE(TftpCodec::decodeRequest(not_request, sizeof(not_request), view));
+}
+
+TEST_F(TftpCodecTest, ErrorMessageView) {
+    uint8_t out[64];
+    size_t length = TftpCodec::encodeError(out, sizeof(out), TftpError::ACCESS_VIOLATION, "Access denied");
+    ASSERT_EQ(length, TftpCodec::HEADER_SIZE + 14);
+
+    TftpErrorView view;
+    ASSERT_TRUE(TftpCodec::decodeError(out, length, view));
+    EXPECT_EQ(view.code, static_cast<uint16_t>(TftpError::ACCESS_VIOLATION));
+    EXPECT_EQ(view.message, "Access denied");
+
+    // Unterminated message runs to the end of the datagram
+    ASSERT_TRUE(TftpCodec::decodeError(out, length - 1, view));
+    EXPECT_EQ(view.message, "Access denied");
+}
+
+TEST_F(TftpCodecTest, OptionsCaseInsensitive) {
+    const uint8_t raw[] = "BlkSize\0" "1428\0" "TSIZE\0" "0\0" "WindowSize\0" "8\0";
+    TftpOptions options;
+    ASSERT_TRUE(TftpCodec::decodeOptions(ByteView(raw, sizeof(raw) - 1), options));
+    EXPECT_TRUE(options.has_blksize);
+    EXPECT_EQ(options.blksize, 1428);
+    EXPECT_TRUE(options.has_tsize);
+    EXPECT_EQ(options.tsize, 0u);
+    EXPECT_TRUE(options.has_windowsize);
+    EXPECT_EQ(options.windowsize, 8);
+    EXPECT_FALSE(options.has_timeout);
+
+    const uint8_t request[] = "\0\1" "boot.img\0" "OCTET\0" "blksize\0" "512\0";
+    TftpRequestPacket packet(request, sizeof(request) - 1);
+    ASSERT_TRUE(packet.isValid());
+    EXPECT_EQ(packet.getMode(), TftpMode::OCTET);
+    EXPECT_TRUE(packet.getOptions().has_blksize);
+}
+
+TEST_F(TftpCodecTest, OptionsMalformedValuesSkipped) {
+    // Unknown names, signs, trailing junk and empty values are ignored
+    const uint8_t raw[] = "utimeout\0" "500\0" "blksize\0" "-8\0" "timeout\0" "3s\0"
+                          "windowsize\0" "\0" "tsize\0" "1024\0";
+    TftpOptions options;
+    ASSERT_TRUE(TftpCodec::decodeOptions(ByteView(raw, sizeof(raw) - 1), options));
+    EXPECT_FALSE(options.has_blksize);
+    EXPECT_FALSE(options.has_timeout);
+    EXPECT_FALSE(options.has_windowsize);
+    EXPECT_TRUE(options.has_tsize);
+    EXPECT_EQ(options.tsize, 1024u);
+}
+
+TEST_F(TftpCodecTest, OptionsRangeHandling) {
+    // Negotiated sizes saturate; an exact size that does not fit is dropped
+    const uint8_t raw[] = "blksize\0" "99999999999999999999999\0" "timeout\0" "1000\0"
+                          "tsize\0" "4294967296\0";
+    TftpOptions options;
+    ASSERT_TRUE(TftpCodec::decodeOptions(ByteView(raw, sizeof(raw) - 1), options));
+    EXPECT_TRUE(options.has_blksize);
+    EXPECT_EQ(options.blksize, 65535);
+    EXPECT_TRUE(options.has_timeout);
+    EXPECT_EQ(options.timeout, 255);
+    EXPECT_FALSE(options.has_tsize);
+}
+
+TEST_F(TftpCodecTest, OptionsTruncatedPair) {
+    const uint8_t raw[] = "blksize\0" "1024\0" "tsize\0" "12";
+    TftpOptions options;
+    EXPECT_FALSE(TftpCodec::decodeOptions(ByteView(raw, sizeof(raw) - 1), options));
+    EXPECT_TRUE(options.has_blksize);
+    EXPECT_EQ(options.blksize, 1024);
+    EXPECT_FALSE(options.has_tsize);
+}
+
+TEST_F(TftpCodecTest, MulticastOption) {
+    // RFC 2090: empty value in the request, "addr,port,mc" in the OACK
+    const uint8_t request[] = "multicast\0" "\0";
+    TftpOptions options;
+    ASSERT_TRUE(TftpCodec::decodeOptions(ByteView(request, sizeof(request) - 1), options));
+    EXPECT_TRUE(options.multicast);
+    EXPECT_TRUE(options.multicast_ip.empty());
+
+    TftpOptions response;
+    response.multicast = true;
+    response.multicast_ip = "239.255.68.1";
+    response.multicast_port = 1758;
+    response.multicast_master = true;
+    uint8_t out[2 + TftpCodec::MAX_OPTIONS_SIZE];
+    size_t length = TftpCodec::encodeOptionAck(out, sizeof(out), response);
+    ASSERT_GT(length, 0u);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(out + 2), length - 2),
+              std::string("multicast\0" "239.255.68.1,1758,1\0", 30));
+
+    TftpOptions decoded;
+    ASSERT_TRUE(TftpCodec::decodeOptions(ByteView(out + 2, length - 2), decoded));
+    EXPECT_TRUE(decoded.multicast);
+    EXPECT_EQ(decoded.multicast_ip, "239.255.68.1");
+    EXPECT_EQ(decoded.multicast_port, 1758);
+    EXPECT_TRUE(decoded.multicast_master);
+
+    // Address and port may be omitted when only the master role moves
+    const uint8_t promote[] = "multicast\0" ",,1\0" "multicast\0" "1.2.3.4,1758\0";
+    TftpOptions handover;
+    ASSERT_TRUE(TftpCodec::decodeOptions(ByteView(promote, sizeof(promote) - 1), handover));
+    EXPECT_TRUE(handover.multicast_master);
+    EXPECT_TRUE(handover.multicast_ip.empty());
+    EXPECT_EQ(handover.multicast_port, 0);
+}
+
+TEST_F(TftpCodecTest, NetasciiEncoderMatchesWholeFileAcrossChunks) {
+    const std::string text = "a\nb\r\nc\r\r\n\nd\n";
+    const std::string expected = "a\r\nb\r\nc\r\r\n\r\nd\r\n";
+    auto bytes = reinterpret_cast<const uint8_t*>(text.data());
+
+    // Every split point, including a CR ending one chunk and its LF starting the next
+    for (size_t split = 0; split <= text.size(); ++split) {
+        NetasciiEncoder encoder;
+        std::vector<uint8_t> out;
+        encoder.encode(ByteView(bytes, split), out);
+        encoder.encode(ByteView(bytes + split, text.size() - split), out);
+        EXPECT_EQ(std::string(out.begin(), out.end()), expected) << "split at " << split;
+
+        NetasciiEncoder counter;
+        uint64_t length = counter.measure(ByteView(bytes, split)) +
+                          counter.measure(ByteView(bytes + split, text.size() - split));
+        EXPECT_EQ(length, expected.size()) << "split at " << split;
+    }
+
+    // reset() starts a new stream
+    NetasciiEncoder encoder;
+    std::vector<uint8_t> out;
+    encoder.encode(ByteView(reinterpret_cast<const uint8_t*>("\r"), 1), out);
+    encoder.reset();
+    out.clear();
+    encoder.encode(ByteView(reinterpret_cast<const uint8_t*>("\n"), 1), out);
+    EXPECT_EQ(std::string(out.begin(), out.end()), "\r\n");
+}
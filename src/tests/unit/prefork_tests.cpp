@@ -0,0 +1,87 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/prefork.hpp"
+#include <signal.h>
+#include <unistd.h>
+#include <thread>
+
+using namespace simple_tftpd;
+
+namespace {
+
+// Publishes fixed counters, then waits to be stopped
+int publishingWorker(TftpPreforkSupervisor& supervisor, size_t index) {
+    ServerMetrics metrics;
+    metrics.transfers.total_transfers = 10 + index;
+    metrics.transfers.successful_transfers = 10 + index;
+    metrics.transfers.total_bytes_sent = 1000;
+    metrics.connections.active_connections = 1;
+    supervisor.publish(index, metrics);
+    for (;;) {
+        pause();
+    }
+}
+
+bool waitForTransfers(TftpPreforkSupervisor& supervisor, uint64_t expected) {
+    for (int i = 0; i < 500; ++i) {
+        supervisor.supervise();
+        if (supervisor.getMetrics().transfers.total_transfers == expected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+} // namespace
+
+// Worker counters are summed, and kept when a worker is replaced
+TEST(TftpPreforkSupervisorTest, AggregatesAndRestartsWorkers) {
+    TftpPreforkSupervisor supervisor(2, nullptr);
+    ASSERT_TRUE(supervisor.start([&supervisor](size_t index) { return publishingWorker(supervisor, index); }));
+    std::vector<int> pids = supervisor.getWorkerPids();
+    ASSERT_EQ(pids.size(), 2u);
+    EXPECT_GT(pids[0], 0);
+    EXPECT_GT(pids[1], 0);
+
+    ASSERT_TRUE(waitForTransfers(supervisor, 21));
+    ServerMetrics metrics = supervisor.getMetrics();
+    EXPECT_EQ(metrics.transfers.total_bytes_sent, 2000u);
+    EXPECT_EQ(metrics.connections.active_connections, 2u);
+    EXPECT_NE(supervisor.getMetricsJson().find("\"total\": 21"), std::string::npos);
+
+    // A crashed worker is replaced; what it counted stays in the totals
+    kill(pids[0], SIGKILL);
+    ASSERT_TRUE(waitForTransfers(supervisor, 31));
+    EXPECT_EQ(supervisor.getRestarts(), 1u);
+    std::vector<int> replaced = supervisor.getWorkerPids();
+    EXPECT_NE(replaced[0], pids[0]);
+    EXPECT_EQ(replaced[1], pids[1]);
+    EXPECT_EQ(supervisor.getMetrics().connections.active_connections, 2u);
+
+    supervisor.stop(std::chrono::milliseconds(500));
+    for (int pid : supervisor.getWorkerPids()) {
+        EXPECT_EQ(pid, 0);
+    }
+    EXPECT_EQ(supervisor.getMetrics().transfers.total_transfers, 31u);
+    EXPECT_EQ(supervisor.getMetrics().connections.active_connections, 0u);
+
+    // Nothing is restarted once stopped
+    supervisor.supervise();
+    EXPECT_EQ(supervisor.getRestarts(), 1u);
+}
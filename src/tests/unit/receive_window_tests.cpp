@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/receive_window.hpp"
+
+using namespace simple_tftpd;
+
+namespace {
+
+ByteView view(const std::vector<uint8_t>& data) {
+    return ByteView(data.data(), data.size());
+}
+
+} // namespace
+
+// Blocks past a gap are held until released in order
+TEST(TftpReceiveWindowTest, HoldsBlocksPastGap) {
+    TftpReceiveWindow window;
+    window.reset(8);
+    EXPECT_TRUE(window.empty());
+    EXPECT_EQ(window.find(3), nullptr);
+
+    std::vector<uint8_t> third(512, 3);
+    std::vector<uint8_t> fifth(100, 5);
+    EXPECT_TRUE(window.store(3, view(third)));
+    EXPECT_TRUE(window.store(5, view(fifth)));
+    EXPECT_FALSE(window.store(3, view(third)));
+    EXPECT_EQ(window.size(), 2u);
+
+    ASSERT_NE(window.find(3), nullptr);
+    EXPECT_EQ(*window.find(3), third);
+    EXPECT_EQ(window.find(4), nullptr);
+    // Same slot, different block
+    EXPECT_EQ(window.find(11), nullptr);
+
+    window.release(3);
+    window.release(3);
+    EXPECT_EQ(window.find(3), nullptr);
+    EXPECT_EQ(window.size(), 1u);
+    ASSERT_NE(window.find(5), nullptr);
+    EXPECT_EQ(window.find(5)->size(), 100u);
+}
+
+// Block numbers wrap at 65536, and a new transfer starts empty
+TEST(TftpReceiveWindowTest, WrapsAndResets) {
+    TftpReceiveWindow window;
+    window.reset(4);
+    std::vector<uint8_t> empty;
+    std::vector<uint8_t> data(16, 7);
+    EXPECT_TRUE(window.store(65535, view(data)));
+    EXPECT_TRUE(window.store(1, view(empty)));
+    ASSERT_NE(window.find(1), nullptr);
+    EXPECT_TRUE(window.find(1)->empty());
+    EXPECT_NE(window.find(65535), nullptr);
+
+    window.reset(16);
+    EXPECT_TRUE(window.empty());
+    EXPECT_EQ(window.find(65535), nullptr);
+    EXPECT_TRUE(window.store(20, view(data)));
+    EXPECT_TRUE(window.store(35, view(data)));
+    EXPECT_EQ(window.size(), 2u);
+}
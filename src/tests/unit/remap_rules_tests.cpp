@@ -0,0 +1,198 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/config/remap_rules.hpp"
+#include "utils/test_helpers.hpp"
+#include <thread>
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+namespace {
+
+std::string remapRead(const TftpRemapRules& rules, const std::string& filename,
+                      const std::string& client = "192.168.0.1") {
+    std::string result;
+    EXPECT_TRUE(rules.remap(filename, client, false, result)) << filename;
+    return result;
+}
+
+} // namespace
+
+// Malformed rules are dropped and reported, the rest still apply
+TEST(TftpRemapRulesTest, ParsesAndRejects) {
+    TftpRemapRules rules({
+        "# legacy layout",
+        "",
+        "rg \\\\ /          # backslashes",
+        "r ^/+(.*) \\1",
+        "x foo bar",
+        "r foo",
+        "e ba(r",
+        "~r foo bar",
+        "a [z-a]",
+        "e a{3,1}",
+        "a ^secret$",
+    });
+    EXPECT_EQ(rules.ruleCount(), 3u);
+    EXPECT_EQ(rules.getRejectedRules().size(), 6u);
+    EXPECT_EQ(remapRead(rules, "boot\\pxelinux.0"), "boot/pxelinux.0");
+
+    std::string result;
+    EXPECT_FALSE(rules.remap("secret", "10.0.0.1", false, result));
+    EXPECT_TRUE(rules.remap("secret2", "10.0.0.1", false, result));
+}
+
+// Groups, whole-match references and global replacement
+TEST(TftpRemapRulesTest, RewritesWithGroups) {
+    TftpRemapRules rules({
+        "r ^legacy/([a-z]+)/([0-9]+)\\.img$ images/\\2/\\1.img",
+        "r ^(pxe) <\\0>",
+        "rg x X",
+    });
+    EXPECT_EQ(remapRead(rules, "legacy/alpha/42.img"), "images/42/alpha.img");
+    EXPECT_EQ(remapRead(rules, "xaxbx"), "XaXbX");
+    EXPECT_EQ(remapRead(rules, "pxelinux"), "<pXe>linuX");
+    EXPECT_EQ(remapRead(rules, "legacy/Alpha/42.img"), "legacy/Alpha/42.img");
+}
+
+// Client address references
+TEST(TftpRemapRulesTest, ClientAddress) {
+    TftpRemapRules rules({"r ^config$ hosts/\\i/\\x.cfg"});
+    EXPECT_EQ(remapRead(rules, "config", "192.168.1.10"), "hosts/192.168.1.10/C0A8010A.cfg");
+    EXPECT_EQ(remapRead(rules, "config", "::ffff:10.0.0.1"), "hosts/::ffff:10.0.0.1/0A000001.cfg");
+}
+
+// Flags: case, end, restart, invert, abort and request direction
+TEST(TftpRemapRulesTest, Flags) {
+    TftpRemapRules rules({
+        "ri ^BOOT/ boot/",
+        "re ^boot/old/ boot/new/",
+        "r ^boot/new/ wrong/",
+        "rs ^tmp/(.*) \\1",
+        "Pa ^boot/",
+        "G~a ^(boot|tmp|pub)/",
+    });
+
+    EXPECT_EQ(remapRead(rules, "Boot/pxelinux.0"), "boot/pxelinux.0");
+    EXPECT_EQ(remapRead(rules, "boot/old/x"), "boot/new/x");
+    EXPECT_EQ(remapRead(rules, "tmp/tmp/boot/old/y"), "boot/new/y");
+
+    std::string result;
+    EXPECT_FALSE(rules.remap("etc/passwd", "10.0.0.1", false, result));
+    EXPECT_TRUE(rules.remap("etc/passwd", "10.0.0.1", true, result));
+    EXPECT_FALSE(rules.remap("boot/upload", "10.0.0.1", true, result));
+    EXPECT_TRUE(rules.remap("pub/upload", "10.0.0.1", true, result));
+}
+
+// Anchors, classes, bounded repeats and empty matches
+TEST(TftpRemapRulesTest, RegexSyntax) {
+    TftpRemapRules rules({
+        "rg [[:upper:]] _",
+        "r ^a{2,3}$ triple",
+        "rg ^|$ |",
+        "r \\.(cfg|conf)$ .config",
+        "r [^/]*\\.bak$ backup",
+    });
+    EXPECT_EQ(remapRead(rules, "aaa"), "|triple|");
+    EXPECT_EQ(remapRead(rules, "aaaa"), "|aaaa|");
+    EXPECT_EQ(remapRead(rules, "AbC"), "|_b_|");
+    EXPECT_EQ(remapRead(rules, "host.cfg"), "|host.cfg|");
+    EXPECT_EQ(remapRead(rules, "dir/file.bak"), "|dir/file.bak|");
+
+    TftpRemapRules suffix({"r \\.(cfg|conf)$ .config", "r [^/]*\\.bak$ backup"});
+    EXPECT_EQ(remapRead(suffix, "host.conf"), "host.config");
+    EXPECT_EQ(remapRead(suffix, "dir/file.bak"), "dir/backup");
+}
+
+#ifndef PLATFORM_WINDOWS
+// Matches are leftmost-longest, as with tftpd-hpa's regexec(), not first alternative wins
+TEST(TftpRemapRulesTest, PosixMatchSemantics) {
+    TftpRemapRules rules({"r boot|bootx64 pxe"});
+    EXPECT_EQ(remapRead(rules, "bootx64.efi"), "pxe.efi");
+    EXPECT_EQ(remapRead(rules, "boot.efi"), "pxe.efi");
+
+    TftpRemapRules global({"rg a|ab _", "ri (X|XY)Z <\\1>"});
+    EXPECT_EQ(remapRead(global, "abab"), "__");
+    EXPECT_EQ(remapRead(global, "xyz"), "<xy>");
+}
+#endif
+
+// Rules that keep restarting each other are cut off
+TEST(TftpRemapRulesTest, LoopsAreDenied) {
+    TftpRemapRules rules({"rs ^a b", "rs ^b a"});
+    std::string result;
+    EXPECT_FALSE(rules.remap("a", "10.0.0.1", false, result));
+    EXPECT_EQ(remapRead(rules, "c"), "c");
+}
+
+// Many rules are matched in one pass and stay correct across threads
+TEST(TftpRemapRulesTest, ManyRulesConcurrently) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000; ++i) {
+        lines.push_back("re ^old" + std::to_string(i) + "/(.*)$ new" + std::to_string(i) + "/\\1");
+    }
+    TftpRemapRules rules(lines);
+    ASSERT_EQ(rules.ruleCount(), 1000u);
+
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&rules, &failures, t] {
+            for (int i = t; i < 1000; i += 7) {
+                std::string result;
+                std::string n = std::to_string(i);
+                if (!rules.remap("old" + n + "/file", "10.0.0.1", false, result) || result != "new" + n + "/file") {
+                    failures[static_cast<size_t>(t)]++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int count : failures) {
+        EXPECT_EQ(count, 0);
+    }
+    EXPECT_EQ(remapRead(rules, "other/file"), "other/file");
+    EXPECT_GT(rules.stateCount(), 1u);
+}
+
+// Configuration carries rules from JSON and from a tftpd-hpa map file
+TEST(TftpRemapRulesTest, ConfigRules) {
+    TestHelpers helpers;
+    std::string map_file = helpers.createTestFile("tftpd.map", "# hpa map\nrg \\\\ /\nx bad\n");
+
+    TftpConfig config;
+    EXPECT_TRUE(config.getFilenameRemap()->empty());
+    ASSERT_TRUE(config.loadFromJson(
+        "{\"filesystem\": {\"remap_file\": \"" + map_file + "\", \"remap_rules\": [\"r ^/+(.*) \\\\1\"]}}"));
+    EXPECT_EQ(config.getRemapRules().size(), 1u);
+    EXPECT_EQ(config.getRemapFile(), map_file);
+
+    std::shared_ptr<const TftpRemapRules> remap = config.getFilenameRemap();
+    EXPECT_EQ(remap->ruleCount(), 2u);
+    EXPECT_EQ(remap->getRejectedRules().size(), 1u);
+    EXPECT_EQ(remapRead(*remap, "/boot\\x64\\wdsnbp.com"), "boot/x64/wdsnbp.com");
+    EXPECT_TRUE(config.validate());
+
+    config.setRemapFile(helpers.getTestDirectory() + "/missing.map");
+    EXPECT_FALSE(config.validate());
+    config.setRemapFile("");
+    EXPECT_EQ(config.getFilenameRemap()->ruleCount(), 1u);
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/root_handle.hpp"
+#include "utils/test_helpers.hpp"
+#include <filesystem>
+
+using namespace simple_tftpd;
+using namespace simple_tftpd::test;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string readAll(TftpFileHandle& file) {
+    char buffer[256];
+    int64_t count = file.read(buffer, sizeof(buffer));
+    return count < 0 ? std::string() : std::string(buffer, static_cast<size_t>(count));
+}
+
+} // namespace
+
+// Every case runs against the kernel resolver (where available) and the userspace walk
+class TftpRootHandleTest : public ::testing::TestWithParam<TftpRootHandle::Resolution> {
+protected:
+    void SetUp() override {
+        base_ = helpers_.getTestDirectory();
+        root_ = base_ + "/root";
+        fs::create_directories(root_ + "/boot/x64");
+        fs::create_directories(root_ + "/public");
+        fs::create_directories(root_ + "/private");
+        helpers_.createTestFile("root/boot/x64/wdsnbp.com", "wds");
+        helpers_.createTestFile("root/private/key", "private");
+        helpers_.createTestFile("outside.txt", "outside");
+    }
+
+    TestHelpers helpers_;
+    std::string base_;
+    std::string root_;
+};
+
+TEST_P(TftpRootHandleTest, OpensBelowRoot) {
+    TftpRootHandle root(GetParam());
+    ASSERT_TRUE(root.open(root_));
+    EXPECT_EQ(root.anchorCount(), 1u);
+
+    TftpFileHandle file = root.openRead("boot/x64/wdsnbp.com");
+    ASSERT_TRUE(file.isOpen());
+    EXPECT_EQ(readAll(file), "wds");
+    ASSERT_TRUE(file.rewind());
+    EXPECT_EQ(readAll(file), "wds");
+
+    char byte = 0;
+    EXPECT_EQ(file.readAt(1, &byte, 1), 1);
+    EXPECT_EQ(byte, 'd');
+
+    TftpFileHandle leading = root.openRead("/boot/./x64/../x64/wdsnbp.com");
+    EXPECT_TRUE(leading.isOpen());
+    EXPECT_FALSE(root.openRead("boot/missing").isOpen());
+    EXPECT_EQ(errno, ENOENT);
+
+    TftpRootHandle missing(GetParam());
+    EXPECT_FALSE(missing.open(base_ + "/missing"));
+    EXPECT_FALSE(missing.openRead("boot/x64/wdsnbp.com").isOpen());
+}
+
+TEST_P(TftpRootHandleTest, RefusesEscapes) {
+    fs::create_symlink("../../outside.txt", root_ + "/boot/relative-escape");
+    fs::create_symlink(base_ + "/outside.txt", root_ + "/boot/absolute");
+    fs::create_symlink("..", root_ + "/up");
+    fs::create_symlink("x64/wdsnbp.com", root_ + "/boot/inside");
+    fs::create_symlink("boot/x64", root_ + "/x64");
+
+    TftpRootHandle root(GetParam());
+    ASSERT_TRUE(root.open(root_));
+
+    EXPECT_FALSE(root.openRead("../outside.txt").isOpen());
+    EXPECT_EQ(errno, EXDEV);
+    EXPECT_FALSE(root.openRead("boot/../../outside.txt").isOpen());
+    EXPECT_FALSE(root.openRead("boot/relative-escape").isOpen());
+    EXPECT_EQ(errno, EXDEV);
+    EXPECT_FALSE(root.openRead("boot/absolute").isOpen());
+    EXPECT_FALSE(root.openRead("up/outside.txt").isOpen());
+
+    // Symlinks that stay below the root still work
+    TftpFileHandle inside = root.openRead("boot/inside");
+    ASSERT_TRUE(inside.isOpen());
+    EXPECT_EQ(readAll(inside), "wds");
+    TftpFileHandle through = root.openRead("x64/wdsnbp.com");
+    ASSERT_TRUE(through.isOpen());
+    EXPECT_EQ(readAll(through), "wds");
+}
+
+TEST_P(TftpRootHandleTest, StatReachesWhatOpenReaches) {
+    fs::create_symlink("../../outside.txt", root_ + "/boot/escape.zst");
+    fs::create_symlink("x64/wdsnbp.com", root_ + "/boot/inside");
+
+    TftpRootHandle root(GetParam());
+    ASSERT_TRUE(root.open(root_));
+
+    TftpFileMetadata metadata;
+    ASSERT_TRUE(root.stat("boot/x64/wdsnbp.com", metadata));
+    EXPECT_TRUE(metadata.regular);
+    EXPECT_EQ(metadata.size, 3u);
+    EXPECT_GT(metadata.modified, 0);
+
+    // A symlink is described by its target, and only while that stays below the root
+    ASSERT_TRUE(root.stat("boot/inside", metadata));
+    EXPECT_TRUE(metadata.regular);
+    EXPECT_EQ(metadata.size, 3u);
+    EXPECT_FALSE(root.stat("boot/escape.zst", metadata));
+    EXPECT_EQ(errno, EXDEV);
+    EXPECT_FALSE(root.stat("../outside.txt", metadata));
+    EXPECT_FALSE(root.stat("boot/missing", metadata));
+    EXPECT_EQ(errno, ENOENT);
+
+    ASSERT_TRUE(root.stat("boot", metadata));
+    EXPECT_FALSE(metadata.regular);
+
+    // The same description comes from the open file
+    TftpFileMetadata opened;
+    TftpFileHandle file = root.openRead("boot/inside");
+    ASSERT_TRUE(file.stat(opened));
+    ASSERT_TRUE(root.stat("boot/x64/wdsnbp.com", metadata));
+    EXPECT_EQ(opened.inode, metadata.inode);
+    EXPECT_EQ(opened.modified, metadata.modified);
+}
+
+TEST_P(TftpRootHandleTest, WritesCreateParents) {
+    TftpRootHandle root(GetParam());
+    ASSERT_TRUE(root.open(root_));
+
+    TftpFileHandle file = root.openWrite("uploads/2024/log.txt");
+    ASSERT_TRUE(file.isOpen());
+    ASSERT_TRUE(file.write("uploaded", 8));
+    file.close();
+    EXPECT_EQ(helpers_.readFile(root_ + "/uploads/2024/log.txt"), "uploaded");
+
+    // Truncates an existing file
+    TftpFileHandle again = root.openWrite("uploads/2024/log.txt");
+    ASSERT_TRUE(again.write("new", 3));
+    again.close();
+    EXPECT_EQ(helpers_.readFile(root_ + "/uploads/2024/log.txt"), "new");
+
+    // Neither the file nor missing directories may land outside the root
+    fs::create_symlink(base_, root_ + "/escape");
+    fs::create_symlink("../planted.txt", root_ + "/dangling");
+    EXPECT_FALSE(root.openWrite("escape/created/file").isOpen());
+    EXPECT_FALSE(root.openWrite("dangling").isOpen());
+    EXPECT_FALSE(root.openWrite("../planted.txt").isOpen());
+    EXPECT_FALSE(fs::exists(base_ + "/created"));
+    EXPECT_FALSE(fs::exists(base_ + "/planted.txt"));
+}
+
+TEST_P(TftpRootHandleTest, CreateRefusesExistingNames) {
+    TftpRootHandle root(GetParam());
+    ASSERT_TRUE(root.open(root_));
+
+    TftpFileHandle file = root.openCreate("uploads/new.txt");
+    ASSERT_TRUE(file.isOpen());
+    ASSERT_TRUE(file.write("first", 5));
+    file.close();
+
+    // Taken names are left alone, whatever they are
+    EXPECT_FALSE(root.openCreate("uploads/new.txt").isOpen());
+    EXPECT_EQ(errno, EEXIST);
+    EXPECT_EQ(helpers_.readFile(root_ + "/uploads/new.txt"), "first");
+    fs::create_symlink("../planted.txt", root_ + "/dangling");
+    EXPECT_FALSE(root.openCreate("dangling").isOpen());
+    EXPECT_EQ(errno, EEXIST);
+    EXPECT_FALSE(fs::exists(base_ + "/planted.txt"));
+}
+
+TEST_P(TftpRootHandleTest, AllowedDirectoriesAreAnchors) {
+    fs::create_symlink("../private/key", root_ + "/public/key");
+    fs::create_symlink("boot/x64/wdsnbp.com", root_ + "/wds");
+    helpers_.createTestFile("root/public/readme", "public");
+
+    TftpRootHandle root(GetParam());
+    ASSERT_TRUE(root.open(root_, {root_ + "/public/", root_ + "/missing", base_, root_}));
+    EXPECT_EQ(root.anchorCount(), 2u);
+    ASSERT_EQ(root.getRejectedDirectories().size(), 1u);
+    EXPECT_EQ(root.getRejectedDirectories()[0], root_ + "/missing");
+
+    TftpFileHandle readme = root.openRead("public/readme");
+    ASSERT_TRUE(readme.isOpen());
+    EXPECT_EQ(readAll(readme), "public");
+
+    // An allowed directory cannot reach into a sibling, though the root still can
+    EXPECT_FALSE(root.openRead("public/key").isOpen());
+    EXPECT_EQ(errno, EXDEV);
+    EXPECT_TRUE(root.openRead("wds").isOpen());
+}
+
+INSTANTIATE_TEST_SUITE_P(Resolution, TftpRootHandleTest,
+                         ::testing::Values(TftpRootHandle::Resolution::AUTO,
+                                           TftpRootHandle::Resolution::USERSPACE),
+                         [](const ::testing::TestParamInfo<TftpRootHandle::Resolution>& info) {
+                             return info.param == TftpRootHandle::Resolution::AUTO ? "Auto" : "Userspace";
+                         });
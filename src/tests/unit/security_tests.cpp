@@ -22,6 +22,9 @@
 #include "simple-tftpd/core/config/config.hpp"
 #include "simple-tftpd/core/tftp/server.hpp"
 #include "simple-tftpd/core/utils/logger.hpp"
+#include "simple-tftpd/production/security/manager.hpp"
+#include <atomic>
+#include <thread>
 
 using namespace simple_tftpd;
 
@@ -234,6 +237,120 @@ TEST_F(SecurityTest, ClientFilteringEdgeCases) {
     EXPECT_EQ(allowed.size(), 2);
 }
 
+// CIDR rules match on prefix bits, never on the text
+TEST_F(SecurityTest, CidrClientMatching) {
+    config->setAllowedClients({"10.1.1.10/32", "192.168.0.0/16", "172.16.5.4"});
+    EXPECT_TRUE(config->isClientAllowed("10.1.1.10"));
+    EXPECT_FALSE(config->isClientAllowed("10.1.1.1"));
+    EXPECT_FALSE(config->isClientAllowed("10.1.1.100"));
+    EXPECT_TRUE(config->isClientAllowed("192.168.200.7"));
+    EXPECT_FALSE(config->isClientAllowed("192.169.0.1"));
+    EXPECT_TRUE(config->isClientAllowed("172.16.5.4"));
+    EXPECT_FALSE(config->isClientAllowed("not-an-address"));
+
+    // Dual-stack sockets report IPv4 peers as mapped addresses
+    EXPECT_TRUE(config->isClientAllowed("::ffff:192.168.1.1"));
+    EXPECT_FALSE(config->isClientAllowed("::ffff:10.1.1.1"));
+
+    config->setAllowedClients({"10.0.0.0/8", "*"});
+    EXPECT_TRUE(config->isClientAllowed("203.0.113.9"));
+    config->setAllowedClients({});
+    EXPECT_TRUE(config->isClientAllowed("203.0.113.9"));
+}
+
+TEST_F(SecurityTest, Ipv6ClientPrefixes) {
+    config->setAllowedClients({"2001:db8::/32", "fe80::1", "0.0.0.0/0"});
+    EXPECT_TRUE(config->isClientAllowed("2001:db8:ffff::1"));
+    EXPECT_FALSE(config->isClientAllowed("2001:db9::1"));
+    EXPECT_TRUE(config->isClientAllowed("fe80::1%eth0"));
+    EXPECT_FALSE(config->isClientAllowed("fe80::2"));
+    EXPECT_TRUE(config->isClientAllowed("198.51.100.1"));
+
+    // Malformed rules are reported and match nothing
+    config->setAllowedClients({"10.0.0.0/33", "2001:db8::/129", "10.0.0.0/", "host.example", "10.0.0.1"});
+    auto policy = config->getAccessPolicy();
+    EXPECT_EQ(policy->getRejectedClients().size(), 4u);
+    EXPECT_EQ(policy->clientRuleCount(), 1u);
+    EXPECT_TRUE(config->isClientAllowed("10.0.0.1"));
+    EXPECT_FALSE(config->isClientAllowed("10.0.0.2"));
+
+    struct sockaddr_storage peer = {};
+    auto* peer4 = reinterpret_cast<struct sockaddr_in*>(&peer);
+    peer4->sin_family = AF_INET;
+    inet_pton(AF_INET, "10.0.0.1", &peer4->sin_addr);
+    EXPECT_TRUE(policy->isClientAllowed(peer));
+    inet_pton(AF_INET, "10.0.0.3", &peer4->sin_addr);
+    EXPECT_FALSE(policy->isClientAllowed(peer));
+}
+
+// Directories allow their subtree by whole components
+TEST_F(SecurityTest, CompiledDirectoryAndExtensionSets) {
+    config->setAllowedDirectories({"/var/tftp/pub/", "/srv/boot"});
+    EXPECT_TRUE(config->isDirectoryAllowed("/var/tftp/pub"));
+    EXPECT_TRUE(config->isDirectoryAllowed("/var/tftp/pub/images/x86"));
+    EXPECT_FALSE(config->isDirectoryAllowed("/var/tftp/public"));
+    EXPECT_FALSE(config->isDirectoryAllowed("/var/tftp"));
+    EXPECT_TRUE(config->isDirectoryAllowed("/srv/boot/pxelinux.cfg"));
+
+    config->setAllowedExtensions({".BIN", "img"});
+    EXPECT_TRUE(config->isExtensionAllowed("bin"));
+    EXPECT_TRUE(config->isExtensionAllowed(".Img"));
+    EXPECT_FALSE(config->isExtensionAllowed("exe"));
+    EXPECT_FALSE(config->isExtensionAllowed(""));
+}
+
+TEST_F(SecurityTest, SecurityManagerUsesCompiledPolicy) {
+    config->setRootDirectory("/var/tftp");
+    config->setAllowedClients({"10.1.1.10/32"});
+    ProductionSecurityManager manager(config, logger);
+    EXPECT_TRUE(manager.isClientAllowed("10.1.1.10"));
+    EXPECT_FALSE(manager.isClientAllowed("10.1.1.1"));
+    EXPECT_TRUE(manager.validateFileAccess("boot.bin", "10.1.1.10", false));
+    EXPECT_FALSE(manager.validateFileAccess("boot.bin", "10.1.1.1", false));
+
+    // A reloaded configuration replaces the policy in one step
+    auto reloaded = std::make_shared<TftpConfig>();
+    reloaded->setRootDirectory("/var/tftp");
+    reloaded->setAllowedClients({"10.1.1.0/24"});
+    reloaded->setAllowedExtensions({"img"});
+    ASSERT_TRUE(manager.reloadConfiguration(reloaded));
+    EXPECT_TRUE(manager.validateFileAccess("boot.img", "10.1.1.1", false));
+    EXPECT_FALSE(manager.validateFileAccess("boot.bin", "10.1.1.1", false));
+}
+
+// Readers see either the old or the new policy while it is swapped
+TEST_F(SecurityTest, PolicySwapUnderConcurrentReaders) {
+    TftpAtomicSnapshot<TftpAccessPolicy> snapshot(
+        std::make_shared<const TftpAccessPolicy>(std::vector<std::string>{"10.0.0.1"},
+                                                 std::vector<std::string>{}, std::vector<std::string>{}));
+    std::atomic<bool> done(false);
+    std::atomic<int> failures(0);
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                auto policy = snapshot.load();
+                if (!policy || policy->isClientAllowed("10.0.0.1") == policy->isClientAllowed("10.0.0.2")) {
+                    failures++;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+        std::string client = (i % 2) ? "10.0.0.1" : "10.0.0.2";
+        snapshot.store(std::make_shared<const TftpAccessPolicy>(
+            std::vector<std::string>{client}, std::vector<std::string>{}, std::vector<std::string>{}));
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_TRUE(snapshot.load()->isClientAllowed("10.0.0.1"));
+}
+
 // Test file size limit edge cases
 TEST_F(SecurityTest, FileSizeLimitEdgeCases) {
     // Test zero size (unlimited)
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/send_window.hpp"
+
+using namespace simple_tftpd;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void send(TftpSendWindow& window, uint32_t size, Clock::time_point at, bool final = false) {
+    TftpInFlightBlock& block = window.next();
+    block.payload_size = size;
+    block.is_final = final;
+    block.last_sent = at;
+    block.retries = 0;
+    window.push();
+}
+
+} // namespace
+
+// An ACK releases its block and every block before it
+TEST(TftpSendWindowTest, CumulativeAcknowledgement) {
+    TftpSendWindow window;
+    window.reset(4, 1);
+    EXPECT_TRUE(window.empty());
+    auto now = Clock::now();
+    for (int i = 0; i < 4; ++i) {
+        send(window, 512, now, i == 3);
+    }
+    EXPECT_TRUE(window.full());
+    EXPECT_EQ(window.find(5), nullptr);
+    ASSERT_NE(window.find(3), nullptr);
+
+    // Lost ACKs for 1 and 2 are covered by the ACK for 3
+    TftpWindowAck ack = window.acknowledge(3);
+    EXPECT_EQ(ack.blocks, 3u);
+    EXPECT_EQ(ack.bytes, 3u * 512);
+    EXPECT_FALSE(ack.final);
+    EXPECT_EQ(window.base(), 4);
+    EXPECT_EQ(window.size(), 1u);
+
+    // Already released, or never sent
+    EXPECT_EQ(window.acknowledge(2).blocks, 0u);
+    EXPECT_EQ(window.acknowledge(7).blocks, 0u);
+
+    ack = window.acknowledge(4);
+    EXPECT_EQ(ack.blocks, 1u);
+    EXPECT_TRUE(ack.final);
+    EXPECT_TRUE(window.empty());
+}
+
+// Block numbers wrap at 65536 and slots are reused around the ring
+TEST(TftpSendWindowTest, WrapsAroundBlockNumbers) {
+    TftpSendWindow window;
+    window.reset(3, 65534);
+    auto now = Clock::now();
+    for (int i = 0; i < 3; ++i) {
+        send(window, 100, now);
+    }
+    ASSERT_NE(window.find(0), nullptr);
+    EXPECT_EQ(window.find(1), nullptr);
+
+    EXPECT_EQ(window.acknowledge(65535).blocks, 2u);
+    EXPECT_EQ(window.base(), 0);
+    send(window, 100, now);
+    send(window, 100, now);
+    EXPECT_TRUE(window.full());
+    EXPECT_EQ(window.acknowledge(2).blocks, 3u);
+    EXPECT_TRUE(window.empty());
+}
+
+// The oldest send time lets a timer tick skip the scan
+TEST(TftpSendWindowTest, ExpiryLowerBound) {
+    TftpSendWindow window;
+    window.reset(8, 1);
+    auto start = Clock::now();
+    auto timeout = std::chrono::seconds(5);
+    EXPECT_FALSE(window.mayHaveExpired(start + std::chrono::hours(1), timeout));
+
+    send(window, 512, start);
+    send(window, 512, start + std::chrono::seconds(2));
+    EXPECT_FALSE(window.mayHaveExpired(start + std::chrono::seconds(4), timeout));
+    EXPECT_TRUE(window.mayHaveExpired(start + std::chrono::seconds(5), timeout));
+
+    // After block 1 is resent, a refresh finds block 2 is now the oldest
+    window.at(0).last_sent = start + std::chrono::seconds(5);
+    window.refreshOldest();
+    EXPECT_FALSE(window.mayHaveExpired(start + std::chrono::seconds(6), timeout));
+    EXPECT_TRUE(window.mayHaveExpired(start + std::chrono::seconds(7), timeout));
+
+    // Resizing for a new transfer empties the window
+    window.reset(64, 1);
+    EXPECT_TRUE(window.empty());
+    EXPECT_FALSE(window.full());
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/setup_pool.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+using namespace simple_tftpd;
+
+namespace {
+
+// Holds pool threads until released
+class Gate {
+public:
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiting_++;
+        changed_.notify_all();
+        changed_.wait(lock, [this] { return open_; });
+    }
+
+    bool waitForWaiters(int count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return changed_.wait_for(lock, std::chrono::seconds(5), [&] { return waiting_ >= count; });
+    }
+
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        changed_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    int waiting_ = 0;
+    bool open_ = false;
+};
+
+} // namespace
+
+// Jobs run on the pool threads, several at a time
+TEST(TftpSetupPoolTest, RunsJobsConcurrently) {
+    TftpSetupPool pool(2, 16);
+    EXPECT_FALSE(pool.submit([] {}));
+    pool.start();
+    EXPECT_TRUE(pool.isRunning());
+
+    Gate gate;
+    std::atomic<int> finished{0};
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_TRUE(pool.submit([&] {
+            gate.wait();
+            finished++;
+        }));
+    }
+    // Both are blocked at once, so neither waits for the other
+    ASSERT_TRUE(gate.waitForWaiters(2));
+    gate.open();
+    pool.stop();
+
+    EXPECT_EQ(finished.load(), 2);
+    TftpSetupPoolStats stats = pool.getStats();
+    EXPECT_EQ(stats.threads, 2u);
+    EXPECT_EQ(stats.submitted, 2u);
+    EXPECT_EQ(stats.completed, 2u);
+    EXPECT_FALSE(pool.isRunning());
+}
+
+// A full queue refuses work, and stop() discards what is still queued
+TEST(TftpSetupPoolTest, BoundedQueue) {
+    TftpSetupPool pool(1, 2);
+    pool.start();
+
+    Gate gate;
+    std::atomic<int> ran{0};
+    ASSERT_TRUE(pool.submit([&] {
+        gate.wait();
+        ran++;
+    }));
+    ASSERT_TRUE(gate.waitForWaiters(1));
+    EXPECT_TRUE(pool.submit([&] { ran++; }));
+    EXPECT_TRUE(pool.submit([&] { ran++; }));
+    EXPECT_FALSE(pool.submit([&] { ran++; }));
+
+    TftpSetupPoolStats stats = pool.getStats();
+    EXPECT_EQ(stats.queued, 2u);
+    EXPECT_EQ(stats.peak_queued, 2u);
+    EXPECT_EQ(stats.rejected, 1u);
+
+    std::thread opener([&gate] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        gate.open();
+    });
+    pool.stop();
+    opener.join();
+
+    stats = pool.getStats();
+    EXPECT_EQ(stats.completed + stats.dropped, 3u);
+    EXPECT_EQ(stats.queued, 0u);
+    EXPECT_EQ(ran.load(), static_cast<int>(stats.completed));
+}
+
+// A pool without threads never accepts work
+TEST(TftpSetupPoolTest, DisabledPool) {
+    TftpSetupPool pool(0, 16);
+    pool.start();
+    EXPECT_FALSE(pool.isRunning());
+    EXPECT_FALSE(pool.submit([] {}));
+}
+
+// Configuration keys
+TEST(TftpSetupPoolTest, Config) {
+    TftpConfig config;
+    EXPECT_EQ(config.getSetupThreads(), 4u);
+    EXPECT_EQ(config.getSetupQueueLimit(), 1024u);
+    ASSERT_TRUE(config.loadFromJson("{\"performance\": {\"setup_threads\": 16, \"setup_queue_limit\": 64}}"));
+    EXPECT_EQ(config.getSetupThreads(), 16u);
+    EXPECT_EQ(config.getSetupQueueLimit(), 64u);
+    EXPECT_TRUE(config.validate());
+
+    config.setSetupQueueLimit(0);
+    EXPECT_FALSE(config.validate());
+    config.setSetupThreads(0);
+    EXPECT_TRUE(config.validate());
+    config.setSetupThreads(257);
+    EXPECT_FALSE(config.validate());
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include "simple-tftpd/core/tftp/shared_cache.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace simple_tftpd;
+
+namespace {
+
+constexpr size_t CHUNK = TftpSharedContentCache::CHUNK_SIZE;
+
+std::vector<uint8_t> pattern(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+    return data;
+}
+
+} // namespace
+
+#ifdef PLATFORM_LINUX
+
+// Chunks are found by file version and offset
+TEST(TftpSharedContentCacheTest, ReadInsertAndVersions) {
+    auto cache = TftpSharedContentCache::create(16 * CHUNK);
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(cache->getStats().chunks, 16u);
+    EXPECT_EQ(cache->getStats().capacity, 16 * CHUNK);
+
+    TftpSharedCacheKey key{"/srv/tftp/boot.img", CHUNK + 100, 42};
+    uint8_t buffer[1024];
+    EXPECT_EQ(cache->read(key, 0, buffer, sizeof(buffer)), -1);
+
+    std::vector<uint8_t> first = pattern(CHUNK, 1);
+    std::vector<uint8_t> last = pattern(100, 9);
+    cache->insert(key, 0, first.data(), first.size());
+    cache->insert(key, 1, last.data(), last.size());
+
+    ASSERT_EQ(cache->read(key, 512, buffer, 512), 512);
+    EXPECT_EQ(std::vector<uint8_t>(buffer, buffer + 512), std::vector<uint8_t>(first.begin() + 512, first.begin() + 1024));
+    // A read stops at the end of its chunk, and of the file
+    EXPECT_EQ(cache->read(key, CHUNK - 10, buffer, sizeof(buffer)), 10);
+    ASSERT_EQ(cache->read(key, CHUNK + 40, buffer, sizeof(buffer)), 60);
+    EXPECT_EQ(buffer[0], last[40]);
+    EXPECT_EQ(cache->read(key, CHUNK + 100, buffer, sizeof(buffer)), 0);
+
+    // Another version or path of the file does not match
+    TftpSharedCacheKey rewritten{key.path, key.file_size, 43};
+    EXPECT_EQ(cache->read(rewritten, 0, buffer, sizeof(buffer)), -1);
+    TftpSharedCacheKey other{"/srv/tftp/boot.im", key.file_size, key.modified};
+    EXPECT_EQ(cache->read(other, 0, buffer, sizeof(buffer)), -1);
+
+    // Loading a chunk twice keeps one copy
+    cache->insert(key, 0, first.data(), first.size());
+    TftpSharedCacheStats stats = cache->getStats();
+    EXPECT_EQ(stats.insertions, 2u);
+    EXPECT_EQ(stats.hits, 3u);
+    EXPECT_EQ(stats.misses, 3u);
+
+    EXPECT_EQ(TftpSharedContentCache::create(CHUNK - 1), nullptr);
+}
+
+// Recently read chunks survive a CLOCK sweep
+TEST(TftpSharedContentCacheTest, ClockEviction) {
+    auto cache = TftpSharedContentCache::create(4 * CHUNK);
+    ASSERT_NE(cache, nullptr);
+    TftpSharedCacheKey key{"/srv/tftp/large.img", 10 * CHUNK, 1};
+    std::vector<uint8_t> data = pattern(CHUNK, 3);
+    uint8_t byte;
+
+    for (uint64_t chunk = 0; chunk < 5; ++chunk) {
+        cache->insert(key, chunk, data.data(), data.size());
+    }
+    // The fifth chunk replaced the first after one sweep
+    EXPECT_EQ(cache->read(key, 0, &byte, 1), -1);
+    EXPECT_EQ(cache->read(key, 4 * CHUNK, &byte, 1), 1);
+
+    EXPECT_EQ(cache->read(key, CHUNK, &byte, 1), 1);
+    cache->insert(key, 5, data.data(), data.size());
+    EXPECT_EQ(cache->read(key, CHUNK, &byte, 1), 1);
+    EXPECT_EQ(cache->read(key, 2 * CHUNK, &byte, 1), -1);
+    EXPECT_EQ(cache->getStats().evictions, 2u);
+}
+
+// Processes forked after create() see each other's chunks
+TEST(TftpSharedContentCacheTest, SharedAcrossProcesses) {
+    auto cache = TftpSharedContentCache::create(64 * CHUNK);
+    ASSERT_NE(cache, nullptr);
+    TftpSharedCacheKey key{"/srv/tftp/shared.img", 3 * CHUNK, 7};
+    std::vector<uint8_t> parent_chunk = pattern(CHUNK, 5);
+    cache->insert(key, 0, parent_chunk.data(), parent_chunk.size());
+
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        uint8_t byte = 0;
+        bool seen = cache->read(key, 100, &byte, 1) == 1 && byte == parent_chunk[100];
+        std::vector<uint8_t> child_chunk = pattern(CHUNK, 11);
+        cache->insert(key, 2, child_chunk.data(), child_chunk.size());
+        _exit(seen ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    uint8_t byte = 0;
+    ASSERT_EQ(cache->read(key, 2 * CHUNK + 5, &byte, 1), 1);
+    EXPECT_EQ(byte, pattern(CHUNK, 11)[5]);
+    EXPECT_EQ(cache->getStats().insertions, 2u);
+}
+
+#endif
+
+// Configuration keys
+TEST(TftpSharedContentCacheTest, Config) {
+    TftpConfig config;
+    EXPECT_EQ(config.getWorkers(), 1u);
+    EXPECT_EQ(config.getSharedCacheSize(), 256u * 1024 * 1024);
+    ASSERT_TRUE(config.loadFromJson("{\"performance\": {\"workers\": 8, \"shared_cache_size\": 1073741824}}"));
+    EXPECT_EQ(config.getWorkers(), 8u);
+    EXPECT_EQ(config.getSharedCacheSize(), 1073741824u);
+    EXPECT_TRUE(config.validate());
+
+    config.setWorkers(0);
+    EXPECT_FALSE(config.validate());
+    config.setWorkers(257);
+    EXPECT_FALSE(config.validate());
+}
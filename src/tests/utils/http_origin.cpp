@@ -0,0 +1,260 @@
+#include "http_origin.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+
+namespace simple_tftpd {
+namespace test {
+
+namespace {
+
+bool sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool sendAll(int fd, const std::string& data) {
+    return sendAll(fd, data.data(), data.size());
+}
+
+std::string decodePath(const std::string& path) {
+    std::string decoded;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '%' && i + 2 < path.size()) {
+            decoded += static_cast<char>(std::stoi(path.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += path[i];
+        }
+    }
+    return decoded;
+}
+
+} // namespace
+
+TestHttpOrigin::TestHttpOrigin()
+    : listen_fd_(-1), port_(0), running_(false), chunked_(false), hold_after_(0), holding_(false), held_(0),
+      requests_(0), not_modified_(0) {}
+
+TestHttpOrigin::~TestHttpOrigin() {
+    stop();
+}
+
+bool TestHttpOrigin::start() {
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (::bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listen_fd_, 64) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&address), &length) != 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    port_ = ntohs(address.sin_port);
+    running_ = true;
+    accept_thread_ = std::thread(&TestHttpOrigin::acceptLoop, this);
+    return true;
+}
+
+void TestHttpOrigin::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    release();
+    if (accept_thread_.joinable()) {
+        accept_thread_.join();
+    }
+    for (auto& handler : handlers_) {
+        if (handler.joinable()) {
+            handler.join();
+        }
+    }
+    handlers_.clear();
+    ::close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+std::string TestHttpOrigin::getUrl() const {
+    return "http://127.0.0.1:" + std::to_string(port_);
+}
+
+void TestHttpOrigin::setFile(const std::string& path, const std::string& content, const std::string& etag,
+                             const std::string& last_modified) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_[path] = File{content, etag, last_modified};
+}
+
+void TestHttpOrigin::removeFile(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.erase(path);
+}
+
+void TestHttpOrigin::holdAfter(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    hold_after_ = bytes;
+    holding_ = true;
+    held_ = 0;
+}
+
+void TestHttpOrigin::release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        holding_ = false;
+    }
+    held_changed_.notify_all();
+}
+
+bool TestHttpOrigin::waitUntilHeld(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return held_changed_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return held_ > 0; });
+}
+
+std::string TestHttpOrigin::getLastHeader(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = last_headers_.find(name);
+    return it == last_headers_.end() ? std::string() : it->second;
+}
+
+void TestHttpOrigin::acceptLoop() {
+    while (running_) {
+        struct pollfd descriptor {listen_fd_, POLLIN, 0};
+        if (::poll(&descriptor, 1, 50) <= 0) {
+            continue;
+        }
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd >= 0) {
+            handlers_.emplace_back(&TestHttpOrigin::handle, this, fd);
+        }
+    }
+}
+
+void TestHttpOrigin::handle(int fd) {
+    std::string request;
+    char buffer[4096];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+        ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) {
+            ::close(fd);
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(count));
+    }
+    requests_++;
+
+    std::map<std::string, std::string> headers;
+    size_t line_end = request.find("\r\n");
+    std::string request_line = request.substr(0, line_end);
+    size_t position = line_end + 2;
+    while (position < request.size()) {
+        size_t end = request.find("\r\n", position);
+        if (end == std::string::npos || end == position) {
+            break;
+        }
+        std::string line = request.substr(position, end - position);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            headers[name] = line.substr(line.find_first_not_of(' ', colon + 1));
+        }
+        position = end + 2;
+    }
+
+    size_t first = request_line.find(' ');
+    size_t second = request_line.find(' ', first + 1);
+    std::string path = decodePath(request_line.substr(first + 2, second - first - 2));
+
+    File file;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_headers_ = headers;
+        auto it = files_.find(path);
+        if (it != files_.end()) {
+            file = it->second;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        sendAll(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    } else if ((!file.etag.empty() && headers["if-none-match"] == file.etag) ||
+               (headers.count("if-none-match") == 0 && !file.last_modified.empty() &&
+                headers["if-modified-since"] == file.last_modified)) {
+        not_modified_++;
+        sendAll(fd, "HTTP/1.1 304 Not Modified\r\nETag: " + file.etag + "\r\nConnection: close\r\n\r\n");
+    } else {
+        std::string head = "HTTP/1.1 200 OK\r\nConnection: close\r\n";
+        if (!file.etag.empty()) {
+            head += "ETag: " + file.etag + "\r\n";
+        }
+        if (!file.last_modified.empty()) {
+            head += "Last-Modified: " + file.last_modified + "\r\n";
+        }
+        head += chunked_ ? "Transfer-Encoding: chunked\r\n\r\n"
+                         : "Content-Length: " + std::to_string(file.content.size()) + "\r\n\r\n";
+        if (sendAll(fd, head)) {
+            sendBody(fd, file.content);
+        }
+    }
+    ::shutdown(fd, SHUT_WR);
+    ::close(fd);
+}
+
+bool TestHttpOrigin::sendBody(int fd, const std::string& content) {
+    size_t hold_at = SIZE_MAX;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (holding_) {
+            hold_at = hold_after_;
+        }
+    }
+
+    size_t offset = 0;
+    while (offset < content.size()) {
+        if (offset == hold_at) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            held_++;
+            held_changed_.notify_all();
+            held_changed_.wait(lock, [this] { return !holding_; });
+        }
+        size_t piece = std::min<size_t>({1000, content.size() - offset,
+                                         hold_at > offset ? hold_at - offset : SIZE_MAX});
+        if (chunked_) {
+            char size_line[32];
+            std::snprintf(size_line, sizeof(size_line), "%zx\r\n", piece);
+            if (!sendAll(fd, size_line) || !sendAll(fd, content.data() + offset, piece) || !sendAll(fd, "\r\n")) {
+                return false;
+            }
+        } else if (!sendAll(fd, content.data() + offset, piece)) {
+            return false;
+        }
+        offset += piece;
+    }
+    return !chunked_ || sendAll(fd, "0\r\n\r\n");
+}
+
+} // namespace test
+} // namespace simple_tftpd
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace simple_tftpd {
+namespace test {
+
+/**
+ * @brief Minimal HTTP/1.1 origin on 127.0.0.1 for origin pull tests
+ *
+ * Serves files from memory with ETag and Last-Modified, answers
+ * conditional requests with 304, and can hold a response part way through
+ * the body to observe streaming.
+ */
+class TestHttpOrigin {
+public:
+    TestHttpOrigin();
+    ~TestHttpOrigin();
+
+    bool start();
+    void stop();
+    uint16_t getPort() const { return port_; }
+    std::string getUrl() const;
+
+    void setFile(const std::string& path, const std::string& content, const std::string& etag = "",
+                 const std::string& last_modified = "");
+    void removeFile(const std::string& path);
+
+    /** Send bodies with chunked transfer encoding instead of Content-Length */
+    void setChunked(bool chunked) { chunked_ = chunked; }
+
+    /** Pause every body after this many bytes until release() */
+    void holdAfter(size_t bytes);
+    void release();
+
+    /** Wait until a held response has sent its first part */
+    bool waitUntilHeld(int timeout_ms = 5000);
+
+    size_t getRequestCount() const { return requests_.load(); }
+    size_t getNotModifiedCount() const { return not_modified_.load(); }
+    std::string getLastHeader(const std::string& name) const;
+
+private:
+    struct File {
+        std::string content;
+        std::string etag;
+        std::string last_modified;
+    };
+
+    int listen_fd_;
+    uint16_t port_;
+    std::atomic<bool> running_;
+    std::atomic<bool> chunked_;
+    std::thread accept_thread_;
+    std::vector<std::thread> handlers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable held_changed_;
+    std::map<std::string, File> files_;
+    std::map<std::string, std::string> last_headers_;
+    size_t hold_after_;
+    bool holding_;
+    size_t held_;
+
+    std::atomic<size_t> requests_;
+    std::atomic<size_t> not_modified_;
+
+    void acceptLoop();
+    void handle(int fd);
+    bool sendBody(int fd, const std::string& content);
+};
+
+} // namespace test
+} // namespace simple_tftpd
@@ -10,6 +10,9 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <ifaddrs.h>
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 namespace simple_tftpd {
 namespace test {
@@ -138,6 +141,28 @@ std::vector<uint8_t> TestHelpers::generateRandomData(size_t size) {
     return data;
 }
 
+std::vector<uint8_t> TestHelpers::gzipData(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> out;
+#ifdef SIMPLE_TFTPD_HAVE_ZLIB
+    z_stream stream{};
+    // 15 + 16: gzip wrapper instead of zlib
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return out;
+    }
+    out.resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+    stream.next_in = const_cast<Bytef*>(data.data());
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = out.data();
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(result == Z_STREAM_END ? stream.total_out : 0);
+    deflateEnd(&stream);
+#else
+    (void)data;
+#endif
+    return out;
+}
+
 bool TestHelpers::compareFiles(const std::string& file1, const std::string& file2) {
     std::ifstream f1(file1, std::ios::binary);
     std::ifstream f2(file2, std::ios::binary);
@@ -22,6 +22,8 @@ public:
     std::string getTestDirectory() const;
     std::string generateRandomString(size_t length);
     std::vector<uint8_t> generateRandomData(size_t size);
+    /** gzip-compress data (empty when built without zlib) */
+    std::vector<uint8_t> gzipData(const std::vector<uint8_t>& data);
     bool compareFiles(const std::string& file1, const std::string& file2);
     std::string getNetworkInterface();
     bool isPortAvailable(uint16_t port);
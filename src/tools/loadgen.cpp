@@ -0,0 +1,1254 @@
+/*
+ * Copyright 2024 SimpleDaemons
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file loadgen.cpp
+ * @brief Load generator driving many concurrent virtual TFTP clients
+ *
+ * Every virtual client owns a UDP socket (its transfer ID) and runs a small
+ * RRQ/WRQ state machine. All clients are multiplexed on one poll() event
+ * loop, so thousands of transfers can be in flight from a single thread.
+ * Loss and delay are injected in the loop itself, which keeps runs
+ * reproducible against localhost without tc/netem.
+ */
+
+#include "simple-tftpd/core/tftp/server.hpp"
+#include "simple-tftpd/core/tftp/packet.hpp"
+#include "simple-tftpd/core/config/config.hpp"
+#include "simple-tftpd/core/utils/logger.hpp"
+#include "simple-tftpd/core/utils/platform.hpp"
+#include <json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace simple_tftpd {
+namespace loadgen {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief File size distribution for generated transfers
+ */
+struct SizeDistribution {
+    enum class Kind { FIXED, UNIFORM, CHOICE };
+    Kind kind = Kind::FIXED;
+    std::vector<uint64_t> values{65536};
+
+    /**
+     * @brief Parse "fixed:N", "uniform:MIN:MAX" or "choice:A,B,C" (sizes accept K/M suffixes)
+     */
+    static bool parse(const std::string& spec, SizeDistribution& out);
+
+    /**
+     * @brief Sizes to materialize as server-side files for RRQ
+     * @param count Number of files for continuous distributions
+     */
+    std::vector<uint64_t> fileSizes(size_t count) const;
+
+    uint64_t sample(std::mt19937_64& rng) const;
+};
+
+/**
+ * @brief Client ramp-up profile
+ */
+struct RampProfile {
+    enum class Kind { NONE, LINEAR, STEP };
+    Kind kind = Kind::NONE;
+    double seconds = 0.0;     // LINEAR: ramp duration, STEP: interval between steps
+    size_t step_clients = 0;  // STEP: clients added per step
+
+    /**
+     * @brief Parse "none", "linear:SECONDS" or "step:CLIENTS:SECONDS"
+     */
+    static bool parse(const std::string& spec, RampProfile& out);
+
+    /**
+     * @brief Number of clients that should be running after elapsed seconds
+     */
+    size_t targetClients(double elapsed, size_t total) const;
+};
+
+/**
+ * @brief Load generator options
+ */
+struct Options {
+    std::string server = "127.0.0.1";
+    port_t port = 0;
+    bool self_host = false;
+    std::string root_directory;     // Self-host root (temporary directory when empty)
+    size_t clients = 100;
+    double duration_s = 10.0;
+    size_t transfers_per_client = 0; // 0 = unlimited until duration elapses
+    double read_ratio = 0.8;
+    uint16_t blksize = 512;
+    uint16_t windowsize = 1;
+    bool request_tsize = true;
+    bool ack_every_block = false;
+    SizeDistribution sizes;
+    size_t file_count = 8;
+    double loss = 0.0;
+    double delay_ms = 0.0;
+    double jitter_ms = 0.0;
+    RampProfile ramp;
+    uint32_t timeout_ms = 1000;
+    uint32_t retries = 5;
+    double drain_s = 15.0;
+    bool seed_files = false;
+    uint64_t seed = 1;
+    std::string report_file;
+    double max_error_rate = 1.0;
+};
+
+/**
+ * @brief Deterministic payload byte for file index/offset
+ *
+ * Lets RRQ payloads be verified and WRQ payloads produced without holding
+ * whole files in memory.
+ */
+inline uint8_t patternByte(uint32_t file_id, uint64_t offset) {
+    uint64_t x = offset * 0x9E3779B97F4A7C15ULL + file_id * 0xBF58476D1CE4E5B9ULL;
+    return static_cast<uint8_t>((x >> 32) ^ (x >> 56));
+}
+
+std::string fileName(uint32_t file_id) {
+    return "loadgen-" + std::to_string(file_id) + ".bin";
+}
+
+/**
+ * @brief Aggregated results of a run
+ */
+struct Report {
+    uint64_t started = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t aborted = 0;
+    uint64_t bytes = 0;
+    uint64_t packets_sent = 0;
+    uint64_t packets_received = 0;
+    uint64_t packets_dropped = 0;
+    uint64_t retransmits = 0;
+    std::map<std::string, uint64_t> errors;
+    std::vector<double> read_ms;
+    std::vector<double> write_ms;
+    double elapsed_s = 0.0;
+    size_t peak_clients = 0;
+};
+
+/**
+ * @brief Outgoing datagram held back by delay injection
+ */
+struct DelayedPacket {
+    Clock::time_point due;
+    size_t client;
+    uint64_t generation;
+    std::vector<uint8_t> data;
+
+    bool operator>(const DelayedPacket& other) const { return due > other.due; }
+};
+
+/**
+ * @brief One virtual TFTP client
+ */
+struct VirtualClient {
+    enum class Phase { IDLE, REQUESTED, TRANSFERRING };
+
+    int fd = -1;
+    Phase phase = Phase::IDLE;
+    bool is_read = true;
+    uint32_t file_id = 0;
+    uint64_t file_size = 0;
+    uint64_t generation = 0;      // Bumped per transfer to discard stale delayed packets
+    size_t transfers_done = 0;
+    Clock::time_point started;
+    Clock::time_point deadline;   // Retransmission deadline
+    uint32_t retries = 0;
+    struct sockaddr_in peer{};    // Server TID, learned from the first reply
+    bool peer_known = false;
+
+    // Negotiated transfer parameters
+    uint16_t blksize = 512;
+    uint16_t windowsize = 1;
+
+    // RRQ state
+    uint16_t expected_block = 1;
+    uint64_t received = 0;
+    uint16_t since_ack = 0;
+
+    // WRQ state
+    uint64_t acked_blocks = 0;    // Highest block acknowledged (64-bit, unwrapped)
+    uint64_t sent_blocks = 0;     // Highest block sent
+    uint64_t total_blocks = 0;    // Includes the terminating short block
+
+    std::vector<uint8_t> last_packet; // For RRQ retransmission (request or last ACK)
+};
+
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const Options& options)
+        : options_(options), rng_(options.seed) {}
+
+    ~LoadGenerator() {
+        for (auto& client : clients_) {
+            if (client.fd >= 0) {
+                close(client.fd);
+            }
+        }
+        if (server_) {
+            server_->stop();
+        }
+        if (owns_root_ && !root_.empty()) {
+            std::error_code ec;
+            std::filesystem::remove_all(root_, ec);
+        }
+    }
+
+    bool setUp();
+    Report run();
+
+    /**
+     * @brief Effective options (self-host fills in the chosen port)
+     */
+    const Options& options() const { return options_; }
+
+private:
+    Options options_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> unit_{0.0, 1.0};
+    std::vector<VirtualClient> clients_;
+    std::vector<uint64_t> file_sizes_;
+    struct sockaddr_in server_addr_{};
+    std::shared_ptr<TftpServer> server_;
+    std::string root_;
+    bool owns_root_ = false;
+    Report report_;
+    std::priority_queue<DelayedPacket, std::vector<DelayedPacket>, std::greater<DelayedPacket>> delayed_;
+    uint32_t next_write_id_ = 1000000;
+    bool draining_ = false;
+    std::vector<uint8_t> scratch_;
+    std::vector<struct pollfd> pfds_;
+
+    bool startSelfHostedServer();
+    bool seedFiles();
+    bool openSocket(VirtualClient& client);
+    void beginTransfer(size_t index, Clock::time_point now);
+    void startTransfer(size_t index, Clock::time_point now, bool is_read, uint32_t file_id, uint64_t file_size);
+    void finishTransfer(size_t index, bool success, const std::string& error, Clock::time_point now);
+    void onDatagram(size_t index, const uint8_t* data, size_t size, const struct sockaddr_in& from, Clock::time_point now);
+    void onTimeout(size_t index, Clock::time_point now);
+    void sendWriteWindow(size_t index, Clock::time_point now);
+    void sendDataBlock(size_t index, uint64_t block);
+    void sendAck(size_t index, uint16_t block);
+    void transmit(size_t index, const uint8_t* data, size_t size, bool to_listen_port);
+    void flushDelayed(Clock::time_point now);
+    bool dropped();
+};
+
+// ---------------------------------------------------------------------------
+// Option parsing helpers
+// ---------------------------------------------------------------------------
+
+bool parseSize(const std::string& text, uint64_t& out) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value < 0) {
+        return false;
+    }
+    std::string suffix(end);
+    if (suffix == "K" || suffix == "k" || suffix == "KiB") {
+        value *= 1024.0;
+    } else if (suffix == "M" || suffix == "m" || suffix == "MiB") {
+        value *= 1024.0 * 1024.0;
+    } else if (suffix == "G" || suffix == "g" || suffix == "GiB") {
+        value *= 1024.0 * 1024.0 * 1024.0;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    out = static_cast<uint64_t>(value);
+    return true;
+}
+
+std::vector<std::string> split(const std::string& text, char delimiter) {
+    std::vector<std::string> parts;
+    std::stringstream ss(text);
+    std::string part;
+    while (std::getline(ss, part, delimiter)) {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+bool SizeDistribution::parse(const std::string& spec, SizeDistribution& out) {
+    auto parts = split(spec, ':');
+    if (parts.empty()) {
+        return false;
+    }
+
+    out.values.clear();
+    if (parts[0] == "fixed" && parts.size() == 2) {
+        out.kind = Kind::FIXED;
+        uint64_t size = 0;
+        if (!parseSize(parts[1], size)) {
+            return false;
+        }
+        out.values.push_back(size);
+    } else if (parts[0] == "uniform" && parts.size() == 3) {
+        out.kind = Kind::UNIFORM;
+        uint64_t low = 0;
+        uint64_t high = 0;
+        if (!parseSize(parts[1], low) || !parseSize(parts[2], high) || high < low) {
+            return false;
+        }
+        out.values = {low, high};
+    } else if (parts[0] == "choice" && parts.size() == 2) {
+        out.kind = Kind::CHOICE;
+        for (const auto& item : split(parts[1], ',')) {
+            uint64_t size = 0;
+            if (!parseSize(item, size)) {
+                return false;
+            }
+            out.values.push_back(size);
+        }
+    } else {
+        return false;
+    }
+    return !out.values.empty();
+}
+
+std::vector<uint64_t> SizeDistribution::fileSizes(size_t count) const {
+    if (kind != Kind::UNIFORM) {
+        return values;
+    }
+    std::vector<uint64_t> sizes;
+    count = std::max<size_t>(count, 1);
+    for (size_t i = 0; i < count; ++i) {
+        double fraction = count == 1 ? 0.0 : static_cast<double>(i) / static_cast<double>(count - 1);
+        sizes.push_back(values[0] + static_cast<uint64_t>(fraction * static_cast<double>(values[1] - values[0])));
+    }
+    return sizes;
+}
+
+uint64_t SizeDistribution::sample(std::mt19937_64& rng) const {
+    switch (kind) {
+        case Kind::FIXED:
+            return values[0];
+        case Kind::UNIFORM:
+            return std::uniform_int_distribution<uint64_t>(values[0], values[1])(rng);
+        case Kind::CHOICE:
+            return values[std::uniform_int_distribution<size_t>(0, values.size() - 1)(rng)];
+    }
+    return values[0];
+}
+
+bool RampProfile::parse(const std::string& spec, RampProfile& out) {
+    auto parts = split(spec, ':');
+    if (parts.empty()) {
+        return false;
+    }
+    try {
+        if (parts[0] == "none" && parts.size() == 1) {
+            out.kind = Kind::NONE;
+        } else if (parts[0] == "linear" && parts.size() == 2) {
+            out.kind = Kind::LINEAR;
+            out.seconds = std::stod(parts[1]);
+        } else if (parts[0] == "step" && parts.size() == 3) {
+            out.kind = Kind::STEP;
+            out.step_clients = static_cast<size_t>(std::stoul(parts[1]));
+            out.seconds = std::stod(parts[2]);
+        } else {
+            return false;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return out.seconds >= 0.0;
+}
+
+size_t RampProfile::targetClients(double elapsed, size_t total) const {
+    switch (kind) {
+        case Kind::NONE:
+            return total;
+        case Kind::LINEAR:
+            if (seconds <= 0.0 || elapsed >= seconds) {
+                return total;
+            }
+            return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(total) * elapsed / seconds));
+        case Kind::STEP: {
+            if (seconds <= 0.0) {
+                return total;
+            }
+            size_t steps = static_cast<size_t>(elapsed / seconds) + 1;
+            return std::min(total, steps * std::max<size_t>(1, step_clients));
+        }
+    }
+    return total;
+}
+
+// ---------------------------------------------------------------------------
+// Setup
+// ---------------------------------------------------------------------------
+
+bool LoadGenerator::startSelfHostedServer() {
+    root_ = options_.root_directory;
+    if (root_.empty()) {
+        char templ[] = "/tmp/simple-tftpd-loadgen-XXXXXX";
+        if (!mkdtemp(templ)) {
+            std::cerr << "Error: Failed to create temporary root directory" << std::endl;
+            return false;
+        }
+        root_ = templ;
+        owns_root_ = true;
+    }
+
+    for (size_t i = 0; i < file_sizes_.size(); ++i) {
+        std::ofstream file(root_ + "/" + fileName(static_cast<uint32_t>(i)), std::ios::binary);
+        std::vector<uint8_t> chunk(64 * 1024);
+        for (uint64_t offset = 0; offset < file_sizes_[i]; offset += chunk.size()) {
+            size_t len = static_cast<size_t>(std::min<uint64_t>(chunk.size(), file_sizes_[i] - offset));
+            for (size_t j = 0; j < len; ++j) {
+                chunk[j] = patternByte(static_cast<uint32_t>(i), offset + j);
+            }
+            file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(len));
+        }
+        if (!file) {
+            std::cerr << "Error: Failed to create " << fileName(static_cast<uint32_t>(i)) << std::endl;
+            return false;
+        }
+    }
+
+    if (options_.port == 0) {
+        // Let the kernel pick a free port, then hand it to the server
+        int probe = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (probe < 0 || bind(probe, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            getsockname(probe, reinterpret_cast<struct sockaddr*>(&addr), &len) != 0) {
+            std::cerr << "Error: Failed to find a free port" << std::endl;
+            if (probe >= 0) {
+                close(probe);
+            }
+            return false;
+        }
+        options_.port = ntohs(addr.sin_port);
+        close(probe);
+    }
+
+    auto config = std::make_shared<TftpConfig>();
+    config->setListenAddress("127.0.0.1");
+    config->setListenPort(options_.port);
+    config->setIpv6Enabled(false);
+    config->setRootDirectory(root_);
+    config->setReadEnabled(true);
+    config->setWriteEnabled(true);
+    config->setOverwriteProtection(false);
+    config->setMaxFileSize(std::max<uint64_t>(config->getMaxFileSize(), 4ULL * 1024 * 1024 * 1024));
+    config->setBlockSize(std::max<uint16_t>(options_.blksize, 512));
+    config->setWindowSize(std::max<uint16_t>(options_.windowsize, 1));
+    config->setTimeout(1);
+    config->setMaxRetries(static_cast<uint16_t>(options_.retries));
+
+    auto logger = std::make_shared<Logger>("", LogLevel::FATAL, false);
+    server_ = std::make_shared<TftpServer>(config, logger);
+    if (!server_->start()) {
+        std::cerr << "Error: Failed to start in-process server on port " << options_.port << std::endl;
+        return false;
+    }
+    options_.server = "127.0.0.1";
+    return true;
+}
+
+bool LoadGenerator::setUp() {
+    // Each virtual client needs its own descriptor
+    struct rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    file_sizes_ = options_.sizes.fileSizes(options_.file_count);
+
+    if (options_.self_host && !startSelfHostedServer()) {
+        return false;
+    }
+
+    server_addr_.sin_family = AF_INET;
+    server_addr_.sin_port = htons(options_.port == 0 ? TFTP_DEFAULT_PORT : options_.port);
+    if (inet_pton(AF_INET, options_.server.c_str(), &server_addr_.sin_addr) != 1) {
+        std::cerr << "Error: Invalid server address: " << options_.server << std::endl;
+        return false;
+    }
+
+    clients_.resize(options_.clients);
+    for (auto& client : clients_) {
+        if (!openSocket(client)) {
+            std::cerr << "Error: Failed to open client socket (" << std::strerror(errno)
+                      << "); lower --clients or raise the open file limit" << std::endl;
+            return false;
+        }
+    }
+
+    scratch_.resize(TFTP_MAX_DATAGRAM_SIZE + 4);
+
+    if (options_.seed_files && !options_.self_host && !seedFiles()) {
+        return false;
+    }
+
+    pfds_.resize(clients_.size());
+    for (size_t i = 0; i < clients_.size(); ++i) {
+        pfds_[i].fd = clients_[i].fd;
+        pfds_[i].events = POLLIN;
+    }
+    return true;
+}
+
+bool LoadGenerator::seedFiles() {
+    // Upload the read set through the server itself, one file at a time
+    Options saved = options_;
+    options_.loss = 0.0;
+    options_.delay_ms = 0.0;
+    options_.jitter_ms = 0.0;
+    auto& client = clients_[0];
+    bool ok = true;
+    for (size_t i = 0; i < file_sizes_.size() && ok; ++i) {
+        uint64_t failed_before = report_.failed;
+        startTransfer(0, Clock::now(), false, static_cast<uint32_t>(i), file_sizes_[i]);
+        while (client.phase != VirtualClient::Phase::IDLE) {
+            struct pollfd pfd{client.fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, 50);
+            auto now = Clock::now();
+            if (ready > 0) {
+                struct sockaddr_in from{};
+                socklen_t len = sizeof(from);
+                ssize_t n = recvfrom(client.fd, scratch_.data(), scratch_.size(), 0,
+                                     reinterpret_cast<struct sockaddr*>(&from), &len);
+                if (n > 0) {
+                    onDatagram(0, scratch_.data(), static_cast<size_t>(n), from, now);
+                }
+            }
+            if (client.phase != VirtualClient::Phase::IDLE && now >= client.deadline) {
+                onTimeout(0, now);
+            }
+        }
+        ok = report_.failed == failed_before;
+    }
+    options_ = saved;
+    report_ = Report();
+    client.transfers_done = 0;
+    if (!ok) {
+        std::cerr << "Error: Failed to seed read-set files on the server (is write enabled?)" << std::endl;
+    }
+    return ok;
+}
+
+bool LoadGenerator::openSocket(VirtualClient& client) {
+    client.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (client.fd < 0) {
+        return false;
+    }
+    int flags = fcntl(client.fd, F_GETFL, 0);
+    fcntl(client.fd, F_SETFL, flags | O_NONBLOCK);
+    int rcvbuf = 256 * 1024;
+    setsockopt(client.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Transfer state machine
+// ---------------------------------------------------------------------------
+
+bool LoadGenerator::dropped() {
+    if (options_.loss > 0.0 && unit_(rng_) < options_.loss) {
+        ++report_.packets_dropped;
+        return true;
+    }
+    return false;
+}
+
+void LoadGenerator::transmit(size_t index, const uint8_t* data, size_t size, bool to_listen_port) {
+    auto& client = clients_[index];
+    if (to_listen_port) {
+        client.peer = server_addr_;
+        client.peer_known = false;
+    }
+    if (dropped()) {
+        return;
+    }
+
+    if (options_.delay_ms > 0.0 || options_.jitter_ms > 0.0) {
+        double delay = options_.delay_ms;
+        if (options_.jitter_ms > 0.0) {
+            delay += (unit_(rng_) * 2.0 - 1.0) * options_.jitter_ms;
+        }
+        auto due = Clock::now() + std::chrono::microseconds(static_cast<int64_t>(std::max(0.0, delay) * 1000.0));
+        delayed_.push(DelayedPacket{due, index, client.generation, std::vector<uint8_t>(data, data + size)});
+        return;
+    }
+
+    ++report_.packets_sent;
+    sendto(client.fd, data, size, 0, reinterpret_cast<const struct sockaddr*>(&client.peer), sizeof(client.peer));
+}
+
+void LoadGenerator::flushDelayed(Clock::time_point now) {
+    while (!delayed_.empty() && delayed_.top().due <= now) {
+        const auto& packet = delayed_.top();
+        auto& client = clients_[packet.client];
+        if (packet.generation == client.generation) {
+            ++report_.packets_sent;
+            sendto(client.fd, packet.data.data(), packet.data.size(), 0,
+                   reinterpret_cast<const struct sockaddr*>(&client.peer), sizeof(client.peer));
+        }
+        delayed_.pop();
+    }
+}
+
+void LoadGenerator::beginTransfer(size_t index, Clock::time_point now) {
+    bool is_read = unit_(rng_) < options_.read_ratio;
+    if (is_read) {
+        uint32_t file_id = static_cast<uint32_t>(std::uniform_int_distribution<size_t>(0, file_sizes_.size() - 1)(rng_));
+        startTransfer(index, now, true, file_id, file_sizes_[file_id]);
+    } else {
+        startTransfer(index, now, false, next_write_id_++, options_.sizes.sample(rng_));
+    }
+}
+
+void LoadGenerator::startTransfer(size_t index, Clock::time_point now, bool is_read,
+                                  uint32_t file_id, uint64_t file_size) {
+    auto& client = clients_[index];
+    if (client.transfers_done > 0) {
+        // Fresh transfer ID per transfer (RFC 1350), so late packets of the
+        // previous transfer cannot leak into this one
+        close(client.fd);
+        if (!openSocket(client)) {
+            finishTransfer(index, false, "socket_error", now);
+            return;
+        }
+        if (index < pfds_.size()) {
+            pfds_[index].fd = client.fd;
+        }
+    }
+    client.generation++;
+    client.is_read = is_read;
+    client.file_id = file_id;
+    client.file_size = file_size;
+    client.started = now;
+    client.retries = 0;
+    client.blksize = 512;
+    client.windowsize = 1;
+    client.expected_block = 1;
+    client.received = 0;
+    client.since_ack = 0;
+    client.acked_blocks = 0;
+    client.sent_blocks = 0;
+
+    TftpRequestPacket request(client.is_read ? TftpOpcode::RRQ : TftpOpcode::WRQ,
+                              fileName(client.file_id), TftpMode::OCTET);
+    TftpOptions request_options;
+    if (options_.blksize != 512) {
+        request_options.has_blksize = true;
+        request_options.blksize = options_.blksize;
+    }
+    if (options_.windowsize != 1) {
+        request_options.has_windowsize = true;
+        request_options.windowsize = options_.windowsize;
+    }
+    if (options_.request_tsize) {
+        request_options.has_tsize = true;
+        request_options.tsize = client.is_read ? 0 : static_cast<uint32_t>(client.file_size);
+    }
+    request.setOptions(request_options);
+
+    client.last_packet = request.serialize();
+    client.phase = VirtualClient::Phase::REQUESTED;
+    client.deadline = now + std::chrono::milliseconds(options_.timeout_ms);
+    ++report_.started;
+    transmit(index, client.last_packet.data(), client.last_packet.size(), true);
+}
+
+void LoadGenerator::finishTransfer(size_t index, bool success, const std::string& error, Clock::time_point now) {
+    auto& client = clients_[index];
+    double ms = std::chrono::duration<double, std::milli>(now - client.started).count();
+    if (success) {
+        ++report_.completed;
+        report_.bytes += client.file_size;
+        (client.is_read ? report_.read_ms : report_.write_ms).push_back(ms);
+    } else {
+        ++report_.failed;
+        report_.errors[error]++;
+    }
+    client.generation++;
+    client.transfers_done++;
+    client.phase = VirtualClient::Phase::IDLE;
+}
+
+void LoadGenerator::sendAck(size_t index, uint16_t block) {
+    auto& client = clients_[index];
+    client.last_packet = {0, static_cast<uint8_t>(TftpOpcode::ACK),
+                          static_cast<uint8_t>(block >> 8), static_cast<uint8_t>(block & 0xFF)};
+    transmit(index, client.last_packet.data(), client.last_packet.size(), false);
+}
+
+void LoadGenerator::sendDataBlock(size_t index, uint64_t block) {
+    auto& client = clients_[index];
+    uint64_t offset = (block - 1) * client.blksize;
+    size_t len = static_cast<size_t>(std::min<uint64_t>(client.blksize, client.file_size - std::min(offset, client.file_size)));
+    uint16_t wire_block = static_cast<uint16_t>(block & 0xFFFF);
+    std::vector<uint8_t> packet(4 + len);
+    packet[0] = 0;
+    packet[1] = static_cast<uint8_t>(TftpOpcode::DATA);
+    packet[2] = static_cast<uint8_t>(wire_block >> 8);
+    packet[3] = static_cast<uint8_t>(wire_block & 0xFF);
+    for (size_t i = 0; i < len; ++i) {
+        packet[4 + i] = patternByte(client.file_id, offset + i);
+    }
+    transmit(index, packet.data(), packet.size(), false);
+}
+
+void LoadGenerator::sendWriteWindow(size_t index, Clock::time_point now) {
+    auto& client = clients_[index];
+    while (client.sent_blocks < client.total_blocks &&
+           client.sent_blocks < client.acked_blocks + client.windowsize) {
+        sendDataBlock(index, ++client.sent_blocks);
+    }
+    client.deadline = now + std::chrono::milliseconds(options_.timeout_ms);
+}
+
+void LoadGenerator::onDatagram(size_t index, const uint8_t* data, size_t size,
+                               const struct sockaddr_in& from, Clock::time_point now) {
+    auto& client = clients_[index];
+    if (client.phase == VirtualClient::Phase::IDLE || size < 4) {
+        return;
+    }
+    if (dropped()) {
+        return;
+    }
+    ++report_.packets_received;
+
+    if (!client.peer_known) {
+        // RFC 1350: replies come from the server's transfer ID
+        client.peer = from;
+        client.peer_known = true;
+    }
+
+    uint16_t opcode = static_cast<uint16_t>((data[0] << 8) | data[1]);
+    switch (static_cast<TftpOpcode>(opcode)) {
+        case TftpOpcode::OACK: {
+            if (client.phase != VirtualClient::Phase::REQUESTED) {
+                return;
+            }
+            size_t offset = 2;
+            while (offset < size) {
+                const char* key = reinterpret_cast<const char*>(data + offset);
+                size_t key_len = strnlen(key, size - offset);
+                offset += key_len + 1;
+                if (offset >= size) {
+                    break;
+                }
+                const char* value = reinterpret_cast<const char*>(data + offset);
+                size_t value_len = strnlen(value, size - offset);
+                offset += value_len + 1;
+                std::string name(key, key_len);
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                unsigned long parsed = std::strtoul(std::string(value, value_len).c_str(), nullptr, 10);
+                if (name == "blksize") {
+                    client.blksize = static_cast<uint16_t>(parsed);
+                } else if (name == "windowsize") {
+                    client.windowsize = static_cast<uint16_t>(std::max<unsigned long>(parsed, 1));
+                } else if (name == "tsize" && client.is_read && parsed != client.file_size) {
+                    finishTransfer(index, false, "tsize_mismatch", now);
+                    return;
+                }
+            }
+            client.phase = VirtualClient::Phase::TRANSFERRING;
+            client.retries = 0;
+            if (client.is_read) {
+                sendAck(index, 0);
+                client.deadline = now + std::chrono::milliseconds(options_.timeout_ms);
+            } else {
+                client.total_blocks = client.file_size / client.blksize + 1;
+                sendWriteWindow(index, now);
+            }
+            return;
+        }
+
+        case TftpOpcode::DATA: {
+            if (!client.is_read) {
+                return;
+            }
+            client.phase = VirtualClient::Phase::TRANSFERRING;
+            uint16_t block = static_cast<uint16_t>((data[2] << 8) | data[3]);
+            size_t payload = size - 4;
+            if (block != client.expected_block) {
+                // Gap or duplicate: re-acknowledge the last in-order block
+                sendAck(index, static_cast<uint16_t>(client.expected_block - 1));
+                client.since_ack = 0;
+                return;
+            }
+
+            uint64_t offset = client.received;
+            for (size_t i = 0; i < payload; ++i) {
+                if (data[4 + i] != patternByte(client.file_id, offset + i)) {
+                    finishTransfer(index, false, "payload_mismatch", now);
+                    return;
+                }
+            }
+            client.received += payload;
+            client.expected_block++;
+            client.since_ack++;
+            client.retries = 0;
+            client.deadline = now + std::chrono::milliseconds(options_.timeout_ms);
+
+            bool last = payload < client.blksize;
+            if (last || options_.ack_every_block || client.since_ack >= client.windowsize) {
+                sendAck(index, block);
+                client.since_ack = 0;
+            }
+            if (last) {
+                if (client.received != client.file_size) {
+                    finishTransfer(index, false, "size_mismatch", now);
+                } else {
+                    finishTransfer(index, true, "", now);
+                }
+            }
+            return;
+        }
+
+        case TftpOpcode::ACK: {
+            if (client.is_read) {
+                return;
+            }
+            uint16_t block = static_cast<uint16_t>((data[2] << 8) | data[3]);
+            if (client.phase == VirtualClient::Phase::REQUESTED) {
+                if (block != 0) {
+                    return;
+                }
+                // No OACK: server ignored our options
+                client.phase = VirtualClient::Phase::TRANSFERRING;
+                client.blksize = 512;
+                client.windowsize = 1;
+                client.total_blocks = client.file_size / client.blksize + 1;
+                client.retries = 0;
+                sendWriteWindow(index, now);
+                return;
+            }
+
+            // Map the 16-bit ACK onto the unwrapped block window
+            uint64_t base = client.acked_blocks;
+            uint16_t delta = static_cast<uint16_t>(block - static_cast<uint16_t>(base & 0xFFFF));
+            if (delta == 0 || base + delta > client.sent_blocks) {
+                return; // Duplicate or stray ACK
+            }
+            client.acked_blocks = base + delta;
+            client.retries = 0;
+            if (client.acked_blocks >= client.total_blocks) {
+                finishTransfer(index, true, "", now);
+                return;
+            }
+            sendWriteWindow(index, now);
+            return;
+        }
+
+        case TftpOpcode::ERROR: {
+            uint16_t code = static_cast<uint16_t>((data[2] << 8) | data[3]);
+            finishTransfer(index, false, "server_error_" + std::to_string(code), now);
+            return;
+        }
+
+        default:
+            return;
+    }
+}
+
+void LoadGenerator::onTimeout(size_t index, Clock::time_point now) {
+    auto& client = clients_[index];
+    if (client.retries >= options_.retries) {
+        finishTransfer(index, false, client.phase == VirtualClient::Phase::REQUESTED ? "request_timeout" : "timeout", now);
+        return;
+    }
+    client.retries++;
+    report_.retransmits++;
+    client.deadline = now + std::chrono::milliseconds(options_.timeout_ms);
+
+    if (!client.is_read && client.phase == VirtualClient::Phase::TRANSFERRING) {
+        // Go back N: resend everything past the last acknowledged block
+        client.sent_blocks = client.acked_blocks;
+        sendWriteWindow(index, now);
+        return;
+    }
+    transmit(index, client.last_packet.data(), client.last_packet.size(),
+             client.phase == VirtualClient::Phase::REQUESTED);
+}
+
+// ---------------------------------------------------------------------------
+// Event loop
+// ---------------------------------------------------------------------------
+
+Report LoadGenerator::run() {
+    auto start = Clock::now();
+    auto run_until = start + std::chrono::microseconds(static_cast<int64_t>(options_.duration_s * 1e6));
+    auto drain_until = run_until + std::chrono::microseconds(static_cast<int64_t>(options_.drain_s * 1e6));
+    size_t running = 0;
+
+    while (true) {
+        auto now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        draining_ = now >= run_until;
+
+        // Ramp up: bring more virtual clients online
+        if (!draining_) {
+            size_t target = options_.ramp.targetClients(elapsed, clients_.size());
+            running = std::max(running, target);
+            report_.peak_clients = std::max(report_.peak_clients, running);
+        }
+
+        // Start new transfers on idle clients
+        size_t busy = 0;
+        for (size_t i = 0; i < running; ++i) {
+            auto& client = clients_[i];
+            if (client.phase == VirtualClient::Phase::IDLE && !draining_ &&
+                (options_.transfers_per_client == 0 || client.transfers_done < options_.transfers_per_client)) {
+                beginTransfer(i, now);
+            }
+            if (client.phase != VirtualClient::Phase::IDLE) {
+                ++busy;
+            }
+        }
+
+        bool all_done = options_.transfers_per_client > 0 && running == clients_.size() && busy == 0;
+        if ((draining_ && busy == 0) || all_done || now >= drain_until) {
+            break;
+        }
+
+        // Sleep until the next retransmission or delayed send is due
+        auto next = now + std::chrono::milliseconds(50);
+        for (size_t i = 0; i < running; ++i) {
+            if (clients_[i].phase != VirtualClient::Phase::IDLE) {
+                next = std::min(next, clients_[i].deadline);
+            }
+        }
+        if (!delayed_.empty()) {
+            next = std::min(next, delayed_.top().due);
+        }
+        int wait_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count());
+        int ready = poll(pfds_.data(), static_cast<nfds_t>(running), std::max(0, wait_ms));
+
+        now = Clock::now();
+        if (ready > 0) {
+            for (size_t i = 0; i < running; ++i) {
+                if (!(pfds_[i].revents & POLLIN)) {
+                    continue;
+                }
+                // Drain the socket; windowed transfers deliver bursts
+                while (true) {
+                    struct sockaddr_in from{};
+                    socklen_t len = sizeof(from);
+                    ssize_t n = recvfrom(clients_[i].fd, scratch_.data(), scratch_.size(), 0,
+                                         reinterpret_cast<struct sockaddr*>(&from), &len);
+                    if (n <= 0) {
+                        break;
+                    }
+                    onDatagram(i, scratch_.data(), static_cast<size_t>(n), from, now);
+                }
+            }
+        }
+
+        flushDelayed(now);
+
+        for (size_t i = 0; i < running; ++i) {
+            if (clients_[i].phase != VirtualClient::Phase::IDLE && now >= clients_[i].deadline) {
+                onTimeout(i, now);
+            }
+        }
+    }
+
+    for (auto& client : clients_) {
+        if (client.phase != VirtualClient::Phase::IDLE) {
+            ++report_.aborted;
+            client.phase = VirtualClient::Phase::IDLE;
+        }
+    }
+
+    report_.elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+    return report_;
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    // Nearest-rank percentile
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+    return samples[std::min(samples.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+Json::Value latencyJson(const std::vector<double>& samples) {
+    Json::Value latency;
+    latency["count"] = static_cast<Json::UInt64>(samples.size());
+    latency["p50_ms"] = percentile(samples, 50.0);
+    latency["p99_ms"] = percentile(samples, 99.0);
+    latency["p999_ms"] = percentile(samples, 99.9);
+    latency["max_ms"] = samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end());
+    return latency;
+}
+
+Json::Value reportJson(const Options& options, const Report& report) {
+    Json::Value root;
+
+    auto& config = root["config"];
+    config["server"] = options.server;
+    config["port"] = options.port;
+    config["self_host"] = options.self_host;
+    config["clients"] = static_cast<Json::UInt64>(options.clients);
+    config["duration_s"] = options.duration_s;
+    config["read_ratio"] = options.read_ratio;
+    config["blksize"] = options.blksize;
+    config["windowsize"] = options.windowsize;
+    config["loss"] = options.loss;
+    config["delay_ms"] = options.delay_ms;
+    config["jitter_ms"] = options.jitter_ms;
+    config["seed"] = static_cast<Json::UInt64>(options.seed);
+
+    auto& totals = root["transfers"];
+    totals["started"] = static_cast<Json::UInt64>(report.started);
+    totals["completed"] = static_cast<Json::UInt64>(report.completed);
+    totals["failed"] = static_cast<Json::UInt64>(report.failed);
+    totals["aborted"] = static_cast<Json::UInt64>(report.aborted);
+
+    double elapsed = std::max(report.elapsed_s, 1e-9);
+    auto& throughput = root["throughput"];
+    throughput["bytes"] = static_cast<Json::UInt64>(report.bytes);
+    throughput["bytes_per_second"] = static_cast<double>(report.bytes) / elapsed;
+    throughput["transfers_per_second"] = static_cast<double>(report.completed) / elapsed;
+
+    std::vector<double> all = report.read_ms;
+    all.insert(all.end(), report.write_ms.begin(), report.write_ms.end());
+    auto& completion = root["completion_time"];
+    completion["all"] = latencyJson(all);
+    completion["read"] = latencyJson(report.read_ms);
+    completion["write"] = latencyJson(report.write_ms);
+
+    auto& packets = root["packets"];
+    packets["sent"] = static_cast<Json::UInt64>(report.packets_sent);
+    packets["received"] = static_cast<Json::UInt64>(report.packets_received);
+    packets["dropped_injected"] = static_cast<Json::UInt64>(report.packets_dropped);
+    packets["retransmits"] = static_cast<Json::UInt64>(report.retransmits);
+
+    auto& errors = root["errors"];
+    errors = Json::Value(Json::objectValue);
+    for (const auto& entry : report.errors) {
+        errors[entry.first] = static_cast<Json::UInt64>(entry.second);
+    }
+
+    root["elapsed_s"] = report.elapsed_s;
+    root["peak_clients"] = static_cast<Json::UInt64>(report.peak_clients);
+    return root;
+}
+
+void printUsage() {
+    std::cout << "\nUsage: simple-tftpd-loadgen [OPTIONS]" << std::endl;
+    std::cout << "\nTarget:" << std::endl;
+    std::cout << "  --server ADDR          Server IPv4 address (default: 127.0.0.1)" << std::endl;
+    std::cout << "  --port PORT            Server port (default: 69, or a free port with --self-host)" << std::endl;
+    std::cout << "  --self-host            Run an in-process server on localhost with generated files" << std::endl;
+    std::cout << "  --root DIR             Root directory for --self-host (default: temporary)" << std::endl;
+    std::cout << "  --seed-files           Upload the read set via WRQ before the run (external server)" << std::endl;
+    std::cout << "\nWorkload:" << std::endl;
+    std::cout << "  --clients N            Concurrent virtual clients (default: 100)" << std::endl;
+    std::cout << "  --duration SECS        Time to keep starting transfers (default: 10)" << std::endl;
+    std::cout << "  --transfers N          Stop each client after N transfers (default: unlimited)" << std::endl;
+    std::cout << "  --read-ratio R         Fraction of RRQ vs WRQ, 0.0-1.0 (default: 0.8)" << std::endl;
+    std::cout << "  --blksize N            Requested blksize (default: 512)" << std::endl;
+    std::cout << "  --windowsize N         Requested windowsize (default: 1)" << std::endl;
+    std::cout << "  --sizes SPEC           fixed:N | uniform:MIN:MAX | choice:A,B,... (K/M suffixes)" << std::endl;
+    std::cout << "  --files N              Read-set files for uniform sizes (default: 8)" << std::endl;
+    std::cout << "  --no-tsize             Do not request tsize" << std::endl;
+    std::cout << "  --ack-every-block      ACK each DATA block instead of once per window" << std::endl;
+    std::cout << "  --ramp SPEC            none | linear:SECS | step:CLIENTS:SECS (default: none)" << std::endl;
+    std::cout << "\nImpairment:" << std::endl;
+    std::cout << "  --loss P               Drop probability per packet, both directions" << std::endl;
+    std::cout << "  --delay MS             Added one-way delay on client transmissions" << std::endl;
+    std::cout << "  --jitter MS            Uniform +/- jitter around --delay" << std::endl;
+    std::cout << "  --timeout-ms MS        Client retransmission timeout (default: 1000)" << std::endl;
+    std::cout << "  --retries N            Client retry limit (default: 5)" << std::endl;
+    std::cout << "\nOutput:" << std::endl;
+    std::cout << "  --report FILE          Write the JSON report to FILE (default: stdout)" << std::endl;
+    std::cout << "  --max-error-rate R     Exit non-zero when failed/started exceeds R" << std::endl;
+    std::cout << "  --rng-seed N           Random seed (default: 1)" << std::endl;
+    std::cout << "\nExample:" << std::endl;
+    std::cout << "  simple-tftpd-loadgen --self-host --clients 2000 --ramp linear:5 --duration 30 \\" << std::endl;
+    std::cout << "      --blksize 1428 --windowsize 8 --sizes choice:32K,1M,16M --loss 0.01" << std::endl;
+}
+
+bool parseArguments(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&](std::string& value) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " requires a value" << std::endl;
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+
+        std::string value;
+        try {
+            if (arg == "--help" || arg == "-h") {
+                printUsage();
+                return false;
+            } else if (arg == "--self-host") {
+                options.self_host = true;
+            } else if (arg == "--seed-files") {
+                options.seed_files = true;
+            } else if (arg == "--no-tsize") {
+                options.request_tsize = false;
+            } else if (arg == "--ack-every-block") {
+                options.ack_every_block = true;
+            } else if (!next(value)) {
+                return false;
+            } else if (arg == "--server") {
+                options.server = value;
+            } else if (arg == "--port") {
+                options.port = static_cast<port_t>(std::stoul(value));
+            } else if (arg == "--root") {
+                options.root_directory = value;
+            } else if (arg == "--clients") {
+                options.clients = std::max<size_t>(1, std::stoul(value));
+            } else if (arg == "--duration") {
+                options.duration_s = std::stod(value);
+            } else if (arg == "--transfers") {
+                options.transfers_per_client = std::stoul(value);
+            } else if (arg == "--read-ratio") {
+                options.read_ratio = std::clamp(std::stod(value), 0.0, 1.0);
+            } else if (arg == "--blksize") {
+                options.blksize = static_cast<uint16_t>(std::clamp<unsigned long>(std::stoul(value), 8, 65464));
+            } else if (arg == "--windowsize") {
+                options.windowsize = static_cast<uint16_t>(std::clamp<unsigned long>(std::stoul(value), 1, 65535));
+            } else if (arg == "--sizes") {
+                if (!SizeDistribution::parse(value, options.sizes)) {
+                    std::cerr << "Error: Invalid size distribution: " << value << std::endl;
+                    return false;
+                }
+            } else if (arg == "--files") {
+                options.file_count = std::max<size_t>(1, std::stoul(value));
+            } else if (arg == "--ramp") {
+                if (!RampProfile::parse(value, options.ramp)) {
+                    std::cerr << "Error: Invalid ramp profile: " << value << std::endl;
+                    return false;
+                }
+            } else if (arg == "--loss") {
+                options.loss = std::clamp(std::stod(value), 0.0, 1.0);
+            } else if (arg == "--delay") {
+                options.delay_ms = std::max(0.0, std::stod(value));
+            } else if (arg == "--jitter") {
+                options.jitter_ms = std::max(0.0, std::stod(value));
+            } else if (arg == "--timeout-ms") {
+                options.timeout_ms = static_cast<uint32_t>(std::max<unsigned long>(1, std::stoul(value)));
+            } else if (arg == "--retries") {
+                options.retries = static_cast<uint32_t>(std::stoul(value));
+            } else if (arg == "--report") {
+                options.report_file = value;
+            } else if (arg == "--max-error-rate") {
+                options.max_error_rate = std::stod(value);
+            } else if (arg == "--rng-seed") {
+                options.seed = std::stoull(value);
+            } else {
+                std::cerr << "Error: Unknown option: " << arg << std::endl;
+                printUsage();
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+
+    if (!options.self_host && options.port == 0) {
+        options.port = TFTP_DEFAULT_PORT;
+    }
+    return true;
+}
+
+} // namespace loadgen
+} // namespace simple_tftpd
+
+int main(int argc, char* argv[]) {
+    using namespace simple_tftpd::loadgen;
+
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        return 2;
+    }
+
+    LoadGenerator generator(options);
+    if (!generator.setUp()) {
+        return 2;
+    }
+
+    Report report = generator.run();
+    Json::Value json = reportJson(generator.options(), report);
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "  ";
+    std::string text = Json::writeString(builder, json);
+    if (options.report_file.empty()) {
+        std::cout << text << std::endl;
+    } else {
+        std::ofstream file(options.report_file);
+        file << text << std::endl;
+        if (!file) {
+            std::cerr << "Error: Failed to write report: " << options.report_file << std::endl;
+            return 2;
+        }
+    }
+
+    uint64_t attempted = report.started;
+    double error_rate = attempted == 0 ? 1.0
+        : static_cast<double>(report.failed + report.aborted) / static_cast<double>(attempted);
+    if (report.completed == 0 || error_rate > options.max_error_rate) {
+        std::cerr << "Load test failed: " << report.completed << " completed, error rate " << error_rate << std::endl;
+        return 1;
+    }
+    return 0;
+}